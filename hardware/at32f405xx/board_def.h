@@ -24,6 +24,11 @@
 #define ADC_NUM_SAMPLE_CYCLES ADC_SAMPLETIME_7_5
 #endif
 
+#if !defined(ADC_CONVERSION_CYCLES)
+// ADC clock cycles of each conversion, including the sample cycles
+#define ADC_CONVERSION_CYCLES 20
+#endif
+
 // ADC resolution in bits, set by `scripts/make.py`
 #if ADC_RESOLUTION != 12
 #error "Unsupported ADC resolution"
@@ -55,8 +55,8 @@ typedef enum {
 
 // Tap-Hold state
 typedef struct {
-  // Time when the key was pressed
-  uint32_t since;
+  // Time in microseconds when the key was pressed
+  uint64_t since;
   // Tap-Hold stage
   uint8_t stage;
   // Whether another key was pressed during the hold
@@ -78,8 +78,8 @@ typedef enum {
 
 // Toggle state
 typedef struct {
-  // Time when the key was pressed
-  uint32_t since;
+  // Time in microseconds when the key was pressed
+  uint64_t since;
   // Toggle stage
   uint8_t stage;
   // Whether the key is toggled
@@ -92,8 +92,8 @@ typedef struct {
 
 // Combo state
 typedef struct {
-  // Time when the first key in the combo was pressed
-  uint32_t since;
+  // Time in microseconds when the first key in the combo was pressed
+  uint64_t since;
   // Whether the combo is active
   bool is_active;
 } ak_state_combo_t;
@@ -104,8 +104,8 @@ typedef struct {
 
 // Macro state
 typedef struct {
-  // Timestamp for delay tracking
-  uint32_t delay_until;
+  // Time in microseconds until which the macro waits
+  uint64_t delay_until;
   // Current event index in the macro sequence
   uint8_t event_index;
   // Keycode currently being tapped
@@ -116,6 +116,20 @@ typedef struct {
   bool is_playing;
 } ak_state_macro_t;
 
+//--------------------------------------------------------------------+
+// Rapid Fire State
+//--------------------------------------------------------------------+
+
+// Rapid Fire state
+typedef struct {
+  // Keyboard reports completed since the keycode was last toggled
+  uint8_t reports;
+  // Whether the key is held
+  bool is_active;
+  // Whether the keycode is registered
+  bool is_pressed;
+} ak_state_rapid_fire_t;
+
 // Advanced key state
 typedef union {
   ak_state_null_bind_t null_bind;
@@ -124,6 +138,7 @@ typedef union {
   ak_state_toggle_t toggle;
   ak_state_combo_t combo;
   ak_state_macro_t macro;
+  ak_state_rapid_fire_t rapid_fire;
 } advanced_key_state_t;
 
 //--------------------------------------------------------------------+
@@ -145,7 +160,7 @@ typedef struct {
   // Key event type
   uint8_t type;
   // Key index
-  uint8_t key;
+  key_index_t key;
   // Underlying keycode. Only for Null Bind advanced keys
   uint8_t keycode;
   // Advanced key index associated with the key
@@ -202,16 +217,27 @@ void advanced_key_process(const advanced_key_event_t *event);
 void advanced_key_tick(bool has_non_tap_hold_press,
                        bool has_non_tap_hold_release);
 
+/**
+ * @brief Keyboard report completion
+ *
+ * This function is called each time the host has read a keyboard report, to
+ * update the advanced keys that are timed in keyboard reports (e.g., Rapid
+ * Fire keys).
+ *
+ * @return None
+ */
+void advanced_key_keyboard_report_complete(void);
+
 /**
  * @brief Process a key event for combo detection
  *
  * @param key Key index
  * @param pressed Whether the key is pressed
- * @param time Time of the event
+ * @param time Time of the event in microseconds
  *
  * @return true if the event is consumed (buffered), false otherwise
  */
-bool advanced_key_combo_process(uint8_t key, bool pressed, uint32_t time);
+bool advanced_key_combo_process(key_index_t key, bool pressed, uint64_t time);
 
 /**
  * @brief Combo task
@@ -230,11 +256,11 @@ void advanced_key_combo_invalidate_cache(void);
  * by the Tap-Hold `require_prior_idle_ms` feature to determine if the hold-tap
  * should be bypassed.
  *
- * @param time Time of the key press
+ * @param time Time of the key press in microseconds
  *
  * @return None
  */
-void advanced_key_update_last_key_time(uint32_t time);
+void advanced_key_update_last_key_time(uint64_t time);
 
 /**
  * @brief Check if any Tap-Hold key is in undecided (TAP) stage
@@ -0,0 +1,167 @@
+/*
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "analog_scan.h"
+
+#if defined(ADC_SWEEP_RATE_HZ)
+//--------------------------------------------------------------------+
+// Timer-Triggered Sweeps
+//--------------------------------------------------------------------+
+
+// A hardware timer paces the sweeps without any CPU work. Every timer period
+// is one step of a sweep: the overflow makes a DMA channel write the next
+// multiplexer select pattern to the GPIO set/clear register, and a compare
+// event, once the multiplexer outputs have settled, triggers the conversion of
+// the ADC sequence. The ADC DMA writes the samples to a circular buffer of two
+// sweeps, and the main loop processes each sweep as soon as it is complete.
+// The half and full transfer interrupts of the ADC DMA only wake the main loop
+// from `wfi`.
+
+#if ADC_NUM_MUX_INPUTS > 0
+// Steps of a sweep, one for each multiplexer input channel
+#define ADC_SWEEP_NUM_STEPS (1 << ADC_NUM_MUX_SELECT_PINS)
+#else
+#define ADC_SWEEP_NUM_STEPS 1
+#endif
+
+// Samples converted at each step
+#define ADC_SWEEP_NUM_INPUTS (ADC_NUM_MUX_INPUTS + ADC_NUM_RAW_INPUTS)
+// Samples of a sweep
+#define ADC_SWEEP_NUM_SAMPLES (ADC_SWEEP_NUM_STEPS * ADC_SWEEP_NUM_INPUTS)
+
+#if !defined(ADC_SWEEP_TIMEOUT_SWEEPS)
+// Sweep periods without a completed sweep after which the sweeps are restarted
+#define ADC_SWEEP_TIMEOUT_SWEEPS 4
+#endif
+
+_Static_assert(ADC_SWEEP_RATE_HZ > 0, "Invalid ADC sweep rate");
+_Static_assert(2 * ADC_SWEEP_NUM_SAMPLES <= 65535,
+               "ADC sweep buffer exceeds maximum DMA transfer count");
+
+typedef struct {
+  // Timer clock divider minus one
+  uint16_t prescaler;
+  // Timer ticks of a step minus one
+  uint16_t period;
+  // Timer tick of a step at which the ADC sequence is triggered
+  uint16_t trigger;
+} analog_sweep_timing_t;
+
+/**
+ * @brief Compute the timer configuration of the sweeps
+ *
+ * The step period is stretched if the requested sweep rate leaves less than
+ * the settle and conversion times in a step, so the sweeps run as fast as
+ * possible instead.
+ *
+ * @param timer_clock_hz Timer input clock frequency
+ * @param sweep_rate_hz Requested number of sweeps per second
+ * @param settle_ns Time for the multiplexer outputs to settle in nanoseconds
+ * @param conversion_ns Conversion time of the ADC sequence in nanoseconds
+ * @param timing Timer configuration
+ *
+ * @return true if the requested sweep rate is achieved, false otherwise
+ */
+bool analog_sweep_compute_timing(uint32_t timer_clock_hz,
+                                 uint32_t sweep_rate_hz, uint32_t settle_ns,
+                                 uint32_t conversion_ns,
+                                 analog_sweep_timing_t *timing);
+
+/**
+ * @brief Get the sweep rate of a timer configuration
+ *
+ * @param timer_clock_hz Timer input clock frequency
+ * @param timing Timer configuration
+ *
+ * @return Number of sweeps per second
+ */
+uint32_t analog_sweep_rate_hz(uint32_t timer_clock_hz,
+                              const analog_sweep_timing_t *timing);
+
+/**
+ * @brief Get the CPU cycles to wait for a sweep before restarting the sweeps
+ *
+ * The timer is assumed to be clocked at the CPU clock.
+ *
+ * @param timing Timer configuration
+ *
+ * @return Number of CPU cycles of `ADC_SWEEP_TIMEOUT_SWEEPS` sweeps
+ */
+uint32_t analog_sweep_timeout_cycles(const analog_sweep_timing_t *timing);
+
+#if ADC_NUM_MUX_INPUTS > 0
+/**
+ * @brief Build the multiplexer select patterns written by the timer DMA
+ *
+ * The patterns are GPIO set/clear register values, with the pins to set in
+ * the lower 16 bits and the pins to clear in the upper 16 bits. The select
+ * pins must share one GPIO port. The pattern of the first step is applied
+ * before starting the timer, and the timer overflow at the end of step `i`
+ * writes `patterns[i]`, which selects the multiplexer input channel of the
+ * following step.
+ *
+ * @param select_pins GPIO pin mask of each multiplexer select pin
+ * @param patterns Select patterns, in the order of the timer overflows
+ *
+ * @return Set/clear register value of the first step
+ */
+uint32_t analog_sweep_build_mux_patterns(
+    const uint16_t select_pins[ADC_NUM_MUX_SELECT_PINS],
+    uint32_t patterns[ADC_SWEEP_NUM_STEPS]);
+#endif
+
+/**
+ * @brief Reset the sweep tracking
+ *
+ * Called when the ADC DMA is started at the beginning of the sample buffer.
+ *
+ * @return None
+ */
+void analog_sweep_reset(void);
+
+/**
+ * @brief Store the latest sweep if a new one has been completed
+ *
+ * Called with the DMA transfer count remaining until the end of the sample
+ * buffer. A sweep is complete once the DMA has moved on to the other half of
+ * the buffer, so polling this function paces the caller to the sweeps.
+ *
+ * @param buffer Sample buffer of two sweeps
+ * @param dma_remaining Remaining DMA transfer count
+ *
+ * @return true if a new sweep has been stored, false otherwise
+ */
+bool analog_sweep_store(const volatile uint16_t *buffer,
+                        uint32_t dma_remaining);
+
+/**
+ * @brief Wait for the next sweep and store it
+ *
+ * The wait is bounded with `board_cycle_count()`, so that an ADC overrun or
+ * a stopped DMA does not hang the firmware. The caller restarts the sweeps
+ * on timeout.
+ *
+ * @param buffer Sample buffer of two sweeps
+ * @param dma_remaining Function returning the remaining DMA transfer count
+ * @param timeout_cycles Maximum number of CPU cycles to wait
+ *
+ * @return true if a new sweep has been stored, false on timeout
+ */
+bool analog_sweep_wait(const volatile uint16_t *buffer,
+                       uint32_t (*dma_remaining)(void),
+                       uint32_t timeout_cycles);
+#endif
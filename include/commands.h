@@ -63,6 +63,7 @@ typedef enum {
   COMMAND_GET_JOYSTICK_CONFIG,
   COMMAND_SET_JOYSTICK_CONFIG,
   COMMAND_SET_HOST_TIME,
+  COMMAND_RGB_STREAM,
 
   COMMAND_UNKNOWN = 255,
 } command_id_t;
@@ -71,8 +72,12 @@ typedef enum {
 // Input Report Structures
 //---------------------------------------------------------------------+
 
+// Key offsets are `key_index_t`, so they take 2 bytes on keyboards with more
+// than 255 keys, and the key payloads are shortened to keep the reports within
+// `RAW_HID_EP_SIZE`.
+
 typedef struct __attribute__((packed)) {
-  uint8_t offset;
+  key_index_t offset;
 } command_in_analog_info_t;
 
 typedef eeconfig_calibration_t command_in_calibration_t;
@@ -95,23 +100,23 @@ typedef struct __attribute__((packed)) {
 typedef struct __attribute__((packed)) {
   uint8_t profile;
   uint8_t layer;
-  uint8_t offset;
+  key_index_t offset;
   uint8_t len;
-  uint8_t keymap[59];
+  uint8_t keymap[60 - sizeof(key_index_t)];
 } command_in_keymap_t;
 
 typedef struct __attribute__((packed)) {
   uint8_t profile;
-  uint8_t offset;
+  key_index_t offset;
   uint8_t len;
-  actuation_t actuation_map[15];
+  actuation_t actuation_map[(61 - sizeof(key_index_t)) / sizeof(actuation_t)];
 } command_in_actuation_map_t;
 
 typedef struct __attribute__((packed)) {
   uint8_t profile;
   uint8_t offset;
   uint8_t len;
-  advanced_key_t advanced_keys[4]; // 4 * 13 bytes = 52 bytes, fits in 64-byte RAW_HID buffer
+  advanced_key_t advanced_keys[4]; // 4 * 13 (or 15) bytes
 } command_in_advanced_keys_t;
 
 typedef struct __attribute__((packed)) {
@@ -121,9 +126,9 @@ typedef struct __attribute__((packed)) {
 
 typedef struct __attribute__((packed)) {
   uint8_t profile;
-  uint8_t offset;
+  key_index_t offset;
   uint8_t len;
-  uint8_t gamepad_buttons[60];
+  uint8_t gamepad_buttons[61 - sizeof(key_index_t)];
 } command_in_gamepad_buttons_t;
 
 typedef struct __attribute__((packed)) {
@@ -156,6 +161,15 @@ typedef struct __attribute__((packed)) {
   uint8_t seconds;
 } command_in_host_time_t;
 
+typedef struct __attribute__((packed)) {
+  uint16_t sequence;
+  uint8_t flags;
+  uint8_t encoding;
+  uint8_t offset;
+  uint8_t len;
+  uint8_t data[57];
+} command_in_rgb_stream_t;
+
 // Command input buffer type
 typedef struct __attribute__((packed)) {
   uint8_t command_id;
@@ -177,6 +191,7 @@ typedef struct __attribute__((packed)) {
     command_in_rgb_config_t rgb_config;
     command_in_joystick_config_t joystick_config;
     command_in_host_time_t host_time;
+    command_in_rgb_stream_t rgb_stream;
   };
 } command_in_buffer_t;
 
@@ -214,6 +229,11 @@ typedef struct __attribute__((packed)) {
   uint8_t data[sizeof(joystick_config_t)];
 } command_out_joystick_config_t;
 
+typedef struct __attribute__((packed)) {
+  uint16_t presented_sequence;
+  uint16_t dropped_frames;
+} command_out_rgb_stream_t;
+
 // Command output buffer type
 typedef struct __attribute__((packed)) {
   uint8_t command_id;
@@ -238,7 +258,7 @@ typedef struct __attribute__((packed)) {
     // For `COMMAND_GET_ACTUATION_MAP`
     actuation_t actuation_map[15];
     // For `COMMAND_GET_ADVANCED_KEYS`
-    advanced_key_t advanced_keys[4]; // 4 * 13 bytes = 52 bytes, fits in 64-byte RAW_HID buffer
+    advanced_key_t advanced_keys[4]; // 4 * 13 (or 15) bytes
     // For `COMMAND_GET_TICK_RATE`
     uint8_t tick_rate;
     // For `COMMAND_GET_GAMEPAD_BUTTONS`
@@ -253,6 +273,8 @@ typedef struct __attribute__((packed)) {
     command_out_joystick_state_t joystick_state;
     // For `COMMAND_GET_JOYSTICK_CONFIG`
     command_out_joystick_config_t joystick_config;
+    // For `COMMAND_RGB_STREAM`
+    command_out_rgb_stream_t rgb_stream;
   };
 } command_out_buffer_t;
 
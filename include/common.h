@@ -73,8 +73,8 @@
 #error "NUM_PROFILES is not defined"
 #endif
 
-_Static_assert(1 <= NUM_PROFILES && NUM_PROFILES <= 8,
-               "NUM_PROFILES must be between 1 and 8");
+_Static_assert(1 <= NUM_PROFILES && NUM_PROFILES <= 16,
+               "NUM_PROFILES must be between 1 and 16");
 
 #if !defined(NUM_LAYERS)
 #error "NUM_LAYERS is not defined"
@@ -87,8 +87,8 @@ _Static_assert(1 <= NUM_LAYERS && NUM_LAYERS <= 8,
 #error "NUM_KEYS is not defined"
 #endif
 
-_Static_assert(1 <= NUM_KEYS && NUM_KEYS <= 256,
-               "NUM_KEYS must be between 1 and 256");
+_Static_assert(1 <= NUM_KEYS && NUM_KEYS <= 1024,
+               "NUM_KEYS must be between 1 and 1024");
 
 #if !defined(NUM_ADVANCED_KEYS)
 #error "NUM_ADVANCED_KEYS is not defined"
@@ -101,6 +101,21 @@ _Static_assert(1 <= NUM_ADVANCED_KEYS && NUM_ADVANCED_KEYS <= 64,
 // Keyboard Types
 //--------------------------------------------------------------------+
 
+// Key index. Keyboards with up to 255 keys keep 8-bit indices, so that their
+// configuration layout and raw HID protocol are unchanged, and larger ones use
+// 16-bit indices. The largest index is reserved for `KEY_INDEX_NONE`.
+#if NUM_KEYS > 255
+#define KEY_INDEX_16BIT
+typedef uint16_t key_index_t;
+#define KEY_INDEX_NONE UINT16_MAX
+#else
+typedef uint8_t key_index_t;
+#define KEY_INDEX_NONE UINT8_MAX
+#endif
+
+_Static_assert(NUM_KEYS - 1 != KEY_INDEX_NONE,
+               "The last key index must not be KEY_INDEX_NONE");
+
 // Actuation configuration for a key. If `rt_down` is non-zero, Rapid Trigger is
 // enabled. If `rt_up` is non-zero, both `rt_down` and `rt_up` are used to
 // configure the Rapid Trigger press and release sensitivity, respectively.
@@ -124,6 +139,7 @@ typedef enum {
   AK_TYPE_TOGGLE,
   AK_TYPE_COMBO,
   AK_TYPE_MACRO,
+  AK_TYPE_RAPID_FIRE,
   AK_TYPE_COUNT,
 } ak_type_t;
 
@@ -144,7 +160,7 @@ typedef enum {
 
 // Null Bind configuration
 typedef struct __attribute__((packed)) {
-  uint8_t secondary_key;
+  key_index_t secondary_key;
   uint8_t behavior;
   // Bottom-out point (0-255). If non-zero, both keys will be registered if both
   // of them are pressed past this point, regardless of the behavior.
@@ -228,8 +244,8 @@ typedef struct __attribute__((packed)) {
 
 // Combo configuration
 typedef struct __attribute__((packed)) {
-  // Trigger key indices (0-255)
-  uint8_t keys[4];
+  // Trigger key indices, or `KEY_INDEX_NONE` for unused slots
+  key_index_t keys[4];
   // Resulting keycode
   uint8_t output_keycode;
   // Combo term in milliseconds (0 = use default)
@@ -264,10 +280,23 @@ typedef struct __attribute__((packed)) {
   uint8_t macro_index;
 } macro_key_t;
 
+// Rapid Fire configuration
+typedef struct __attribute__((packed)) {
+  uint8_t keycode;
+  // Keyboard reports sent with the keycode pressed, then released, per
+  // repetition (0 = 1)
+  uint8_t press_reports;
+  uint8_t release_reports;
+  // Keyboard reports sent with the keycode released at full travel, linearly
+  // interpolated from `release_reports` by the key travel distance (0 = not
+  // modulated by the key travel distance)
+  uint8_t bottom_out_release_reports;
+} rapid_fire_t;
+
 // Advanced key configuration
 typedef struct __attribute__((packed)) {
   uint8_t layer;
-  uint8_t key;
+  key_index_t key;
   uint8_t type;
   union __attribute__((packed)) {
     null_bind_t null_bind;
@@ -276,6 +305,7 @@ typedef struct __attribute__((packed)) {
     toggle_t toggle;
     combo_t combo;
     macro_key_t macro_key;
+    rapid_fire_t rapid_fire;
   };
 } advanced_key_t;
 
@@ -45,3 +45,38 @@ void crc32_init(void);
  * @return CRC32 value
  */
 uint32_t crc32_compute(const void *buf, uint32_t len, uint32_t crc);
+
+/**
+ * @brief Compute the CRC32 of a buffer of zeros
+ *
+ * A default implementation is provided but must be overridden along with
+ * `crc32_compute()`. The result is what `crc32_compute()` returns for `len`
+ * zero bytes, computed without reading them.
+ *
+ * @param len Length of the buffer in bytes
+ * @param crc Initial CRC value
+ *
+ * @return CRC32 value
+ */
+uint32_t crc32_compute_zeros(uint32_t len, uint32_t crc);
+
+/**
+ * @brief Update the CRC32 of a buffer after a range of it changed
+ *
+ * A default implementation is provided but must be overridden along with
+ * `crc32_compute()`. The result is what `crc32_compute()` returns for the
+ * changed buffer with the same initial CRC value, computed in time
+ * proportional to the changed range rather than the buffer.
+ *
+ * @param crc CRC32 of the buffer before the change
+ * @param len Length of the buffer in bytes
+ * @param offset Offset of the changed range in bytes
+ * @param old_data Bytes of the range before the change
+ * @param new_data Bytes of the range after the change
+ * @param range_len Length of the range in bytes
+ *
+ * @return CRC32 of the buffer after the change
+ */
+uint32_t crc32_update_range(uint32_t crc, uint32_t len, uint32_t offset,
+                            const void *old_data, const void *new_data,
+                            uint32_t range_len);
@@ -44,7 +44,7 @@ typedef struct {
   // Action to perform
   uint8_t type;
   // Key index, or INPUT_ROUTING_VIRTUAL_KEY for synthetic keycodes
-  uint8_t key;
+  key_index_t key;
   // Keycode associated with the action
   uint8_t keycode;
   // Number of matrix scans to wait before executing the action
@@ -89,14 +89,43 @@ typedef struct __attribute__((packed)) {
 #endif
 } eeconfig_profile_t;
 
+_Static_assert(sizeof(eeconfig_profile_t) < UINT16_MAX,
+               "eeconfig_profile_t must be addressable by a delta record.");
+
+// Location of the delta records of a profile in `profile_deltas`
+typedef struct __attribute__((packed)) {
+  // Offset of the records
+  uint16_t offset;
+  // Size of the records in bytes. The profile is the base profile if it is 0,
+  // and stored as a whole if it is `sizeof(eeconfig_profile_t)`.
+  uint16_t size;
+} eeconfig_profile_slot_t;
+
+// Delta record header, followed by `len` bytes replacing the bytes of the base
+// profile at `offset`
+typedef struct __attribute__((packed)) {
+  uint16_t offset;
+  uint8_t len;
+} eeconfig_delta_header_t;
+
+// Size of the global configurations
+#define EECONFIG_GLOBAL_SIZE                                                   \
+  (4 + 2 + sizeof(eeconfig_calibration_t) + NUM_KEYS * 2 +                     \
+   sizeof(eeconfig_options_t) + 2)
+// The delta records take the rest of the virtual storage
+#define EECONFIG_PROFILE_DELTAS_SIZE                                           \
+  M_MIN(WL_VIRTUAL_SIZE - EECONFIG_GLOBAL_SIZE - sizeof(eeconfig_profile_t) -  \
+            NUM_PROFILES * sizeof(eeconfig_profile_slot_t) - 4,                \
+        UINT16_MAX)
+
 // Persistent configuration version. The size of the configuration must be
 // non-decreasing, so that the migration can assume that the new version is at
 // least as large as the previous version.
-#define EECONFIG_VERSION 0x0112
+#define EECONFIG_VERSION 0x0114
 
 // Keyboard configuration
 // Whenever there is a change in the configuration, `EECONFIG_VERSION` must be
-// bumped. Make sure to update `eeconfig_reset()`, and add a migration function
+// bumped. Make sure to update `eeconfig_reset()`, and add a migration script
 // in `migration.c`.
 typedef struct __attribute__((packed)) {
   // Global configurations
@@ -119,19 +148,37 @@ typedef struct __attribute__((packed)) {
   // End of global configurations
 
   // Profiles
-  eeconfig_profile_t profiles[NUM_PROFILES];
+  // Profile every profile is encoded against
+  eeconfig_profile_t base_profile;
+  // Delta records of the profiles. Each profile is stored as a sequence of
+  // records, in ascending order of offset, that turn the base profile into the
+  // profile. Profiles that do not differ enough from the base profile to make
+  // it worthwhile are stored as a whole instead.
+  uint8_t profile_deltas[EECONFIG_PROFILE_DELTAS_SIZE];
+  // Location of the records of each profile
+  eeconfig_profile_slot_t profile_slots[NUM_PROFILES];
 
   // Magic number to identify the end of the configuration
   uint32_t magic_end;
 } eeconfig_t;
 
+_Static_assert(EECONFIG_GLOBAL_SIZE == offsetof(eeconfig_t, base_profile),
+               "EECONFIG_GLOBAL_SIZE must match eeconfig_t.");
 _Static_assert(
     sizeof(eeconfig_t) <= WL_VIRTUAL_SIZE,
     "Keyboard configuration size must be at most the virtual storage size.");
+_Static_assert(EECONFIG_GLOBAL_SIZE <= WL_CACHE_SIZE,
+               "The global configurations must fit in WL_CACHE_SIZE.");
 
+// Keyboard configuration in the wear leveling cache. Only the global
+// configurations are read through it, since the rest of the virtual storage
+// may not be kept in RAM.
 extern const eeconfig_t *eeconfig;
+// Current profile, materialised from its delta records in RAM. Only the current
+// profile is kept materialised, and a switch decodes the new one in its place.
+extern const eeconfig_profile_t *eeconfig_profile;
 
-#define CURRENT_PROFILE (eeconfig->profiles[eeconfig->current_profile])
+#define CURRENT_PROFILE (*eeconfig_profile)
 
 //--------------------------------------------------------------------+
 // Default Keyboard Configuration
@@ -237,6 +284,104 @@ bool eeconfig_reset_profile(uint8_t profile);
  */
 bool eeconfig_reset_profile_rgb(uint8_t profile);
 
+/**
+ * @brief Get the current profile index
+ *
+ * This may differ from `eeconfig->current_profile` until the profile switch
+ * has been saved.
+ *
+ * @return Current profile index
+ */
+uint8_t eeconfig_get_current_profile(void);
+
+/**
+ * @brief Get the last non-default profile index, used for profile swapping
+ *
+ * @return Last non-default profile index
+ */
+uint8_t eeconfig_get_last_non_default_profile(void);
+
+/**
+ * @brief Get the materialised view of a profile
+ *
+ * Any other profile than the current one is decoded into a scratch buffer, so
+ * the view is only valid until the next call to the persistent configuration
+ * API.
+ *
+ * @param profile Profile index
+ *
+ * @return View of the profile
+ */
+const eeconfig_profile_t *eeconfig_get_profile(uint8_t profile);
+
+/**
+ * @brief Switch the current profile without saving it
+ *
+ * The profile is materialised behind `CURRENT_PROFILE` from its delta records,
+ * and remembered as the last non-default profile if it is not the default one.
+ *
+ * @param profile Profile index
+ *
+ * @return true if successful, false otherwise
+ */
+bool eeconfig_switch_profile(uint8_t profile);
+
+/**
+ * @brief Save the current and last non-default profiles
+ *
+ * @return true if successful, false otherwise
+ */
+bool eeconfig_save_current_profile(void);
+
+/**
+ * @brief Switch the current profile, and save it
+ *
+ * @param profile Profile index
+ *
+ * @return true if successful, false otherwise
+ */
+bool eeconfig_set_current_profile(uint8_t profile);
+
+/**
+ * @brief Read bytes of a profile
+ *
+ * @param profile Profile index
+ * @param offset Offset in `eeconfig_profile_t`
+ * @param buf Buffer to read into
+ * @param len Length of the data in bytes
+ *
+ * @return true if successful, false otherwise
+ */
+bool eeconfig_read_profile(uint8_t profile, uint32_t offset, void *buf,
+                           uint32_t len);
+
+/**
+ * @brief Write bytes of a profile
+ *
+ * The profile is encoded again against the base profile, and its delta records
+ * are rewritten. `CURRENT_PROFILE` is updated if the profile is the current
+ * profile.
+ *
+ * @param profile Profile index
+ * @param offset Offset in `eeconfig_profile_t`
+ * @param buf Buffer to write from
+ * @param len Length of the data in bytes
+ *
+ * @return true if successful, false if the profile does not fit in the storage
+ */
+bool eeconfig_write_profile(uint8_t profile, uint32_t offset, const void *buf,
+                            uint32_t len);
+
+/**
+ * @brief Copy a profile to another profile
+ *
+ * @param profile Profile index to copy to
+ * @param src_profile Profile index to copy from
+ *
+ * @return true if successful, false otherwise
+ */
+bool eeconfig_copy_profile(uint8_t profile, uint8_t src_profile);
+
 /**
  * @brief Write a value to a field in the persistent configuration
  *
@@ -260,3 +405,16 @@ bool eeconfig_reset_profile_rgb(uint8_t profile);
  */
 #define EECONFIG_WRITE_N(field, value, len)                                    \
   wear_leveling_write(offsetof(eeconfig_t, field), value, len)
+
+/**
+ * @brief Write a value to a field of a profile
+ *
+ * @param profile Profile index
+ * @param field Field to write to
+ * @param value Value to write
+ *
+ * @return true if successful, false otherwise
+ */
+#define EECONFIG_WRITE_PROFILE(profile, field, value)                          \
+  eeconfig_write_profile(profile, offsetof(eeconfig_profile_t, field), value,  \
+                         sizeof(((eeconfig_profile_t *)0)->field))
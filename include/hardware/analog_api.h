@@ -140,7 +140,7 @@ void analog_task(void);
  *
  * @return Raw sampled value
  */
-uint16_t analog_read(uint8_t key);
+uint16_t analog_read(key_index_t key);
 
 #if ADC_NUM_RAW_INPUTS > 0
 /**
@@ -67,3 +67,13 @@ bool flash_read(uint32_t addr, void *buf, uint32_t len);
  * @return true if successful, false otherwise
  */
 bool flash_write(uint32_t addr, const void *buf, uint32_t len);
+
+/**
+ * @brief Get a pointer to memory-mapped flash
+ *
+ * @param addr Address to map
+ * @param len Length of the data in 32-bit words (4 bytes)
+ *
+ * @return Pointer to the data, or NULL if the range is invalid
+ */
+const void *flash_map(uint32_t addr, uint32_t len);
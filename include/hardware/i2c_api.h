@@ -30,6 +30,16 @@
 // SCL_PIN_SOURCE/SDA_PORT/SDA_PIN/SDA_PIN_SOURCE/PIN_MUX.
 // STM32 backends expect I2C_BUSn_INSTANCE/CLOCK_ENABLE()/SCL_PORT/SCL_PIN/
 // SDA_PORT/SDA_PIN/PIN_AF.
+// Queued writes on a bus go through DMA when its DMA macros are defined, and
+// are polled otherwise. AT32 backends expect I2C_BUSn_DMA_TX_CHANNEL/
+// DMA_TX_MUX/DMA_TX_REQ/EVT_IRQ/EVT_IRQ_HANDLER/ERR_IRQ/ERR_IRQ_HANDLER.
+// STM32 backends expect I2C_BUSn_DMA_TX_STREAM/DMA_TX_CHANNEL/
+// DMA_CLOCK_ENABLE()/DMA_TX_IRQ/DMA_TX_IRQ_HANDLER/EV_IRQ/EV_IRQ_HANDLER/
+// ER_IRQ/ER_IRQ_HANDLER.
+
+// Maximum length of a queued write, limited by the transfer counter of the
+// AT32 I2C peripherals
+#define I2C_MAX_TRANSFER_SIZE 255u
 
 typedef struct {
   uint8_t bus;
@@ -56,3 +66,55 @@ bool i2c_bus_read_register(const i2c_bus_config_t *config, uint8_t address,
                            uint16_t reg,
                            i2c_register_width_t register_width, uint8_t *rx,
                            size_t len);
+
+typedef struct i2c_transaction i2c_transaction_t;
+
+// Called when a transaction has completed, from the interrupt of the bus
+// unless the bus is polled
+typedef void (*i2c_transaction_callback_t)(i2c_transaction_t *transaction,
+                                           bool success);
+
+typedef enum {
+  I2C_TRANSACTION_IDLE = 0,
+  I2C_TRANSACTION_QUEUED,
+  I2C_TRANSACTION_ACTIVE,
+  I2C_TRANSACTION_DONE,
+  I2C_TRANSACTION_FAILED,
+} i2c_transaction_state_t;
+
+struct i2c_transaction {
+  const i2c_bus_config_t *config;
+  uint8_t address;
+  // Data to write, starting with the register address for register writes
+  const uint8_t *tx;
+  size_t len;
+  i2c_transaction_callback_t callback;
+  void *user_data;
+
+  // Managed by the I2C queue
+  i2c_transaction_t *queue_next;
+  volatile i2c_transaction_state_t state;
+};
+
+/**
+ * @brief Queue a write transaction on its bus
+ *
+ * The transaction starts once the transactions queued before it on the same
+ * bus have completed, and must stay valid until then. The blocking transfers
+ * wait for the queue of their bus to be empty.
+ *
+ * @param transaction Transaction to queue
+ *
+ * @return true if the transaction has been queued, false if it is invalid or
+ * already queued
+ */
+bool i2c_bus_submit(i2c_transaction_t *transaction);
+
+/**
+ * @brief Check whether a bus has transactions queued or in progress
+ *
+ * @param bus Bus to check
+ *
+ * @return true if the bus is busy, false otherwise
+ */
+bool i2c_bus_busy(uint8_t bus);
@@ -26,6 +26,14 @@
 // SCK_PIN_SOURCE/PIN_MUX. STM32 backends expect SPI_BUSn_INSTANCE/
 // CLOCK_ENABLE()/CLOCK_HZ/SCK_PORT/SCK_PIN/PIN_AF. MISO and MOSI are optional:
 // define *_PORT as NULL and *_PIN as 0 when they are unused.
+// Transfers on a bus go through DMA when its DMA macros are defined, and are
+// polled otherwise. AT32 backends expect SPI_BUSn_DMA_TX_CHANNEL/TX_MUX/TX_REQ/
+// RX_CHANNEL/RX_MUX/RX_REQ/RX_IRQ/RX_IRQ_HANDLER/RX_DONE_FLAG/RX_ERROR_FLAG.
+// STM32 backends expect SPI_BUSn_DMA_TX_STREAM/TX_CHANNEL/RX_STREAM/
+// RX_CHANNEL/CLOCK_ENABLE()/TX_IRQ/TX_IRQ_HANDLER/RX_IRQ/RX_IRQ_HANDLER.
+
+// Maximum length of a transfer, limited by the DMA transfer counters
+#define SPI_MAX_TRANSFER_SIZE 65535u
 
 typedef enum {
   SPI_BUS_MODE_0 = 0,
@@ -47,11 +55,76 @@ typedef struct {
   bool active_low;
 } spi_chip_select_t;
 
+typedef struct spi_transaction spi_transaction_t;
+
+// Called when a transaction has completed, from the DMA interrupt of the bus
+// unless the bus is polled
+typedef void (*spi_transaction_callback_t)(spi_transaction_t *transaction,
+                                           bool success);
+
+typedef enum {
+  SPI_TRANSACTION_IDLE = 0,
+  SPI_TRANSACTION_QUEUED,
+  SPI_TRANSACTION_ACTIVE,
+  SPI_TRANSACTION_DONE,
+  SPI_TRANSACTION_FAILED,
+} spi_transaction_state_t;
+
+struct spi_transaction {
+  const spi_bus_config_t *config;
+  // Chip select asserted during the transaction, or NULL
+  const spi_chip_select_t *chip_select;
+  // Data to transmit, or NULL to transmit 0xFF
+  const uint8_t *tx;
+  // Buffer for the received data, or NULL to discard it
+  uint8_t *rx;
+  size_t len;
+  // Keep the chip select asserted after the transaction, so the next one on
+  // the bus continues it
+  bool keep_selected;
+  spi_transaction_callback_t callback;
+  void *user_data;
+  // Transaction queued once this one has completed successfully. A chain
+  // linked back to its first transaction samples a device continuously, until
+  // a callback clears the link.
+  spi_transaction_t *chain;
+
+  // Managed by the SPI queue
+  spi_transaction_t *queue_next;
+  volatile spi_transaction_state_t state;
+};
+
 void spi_bus_init(void);
 bool spi_bus_acquire(const spi_bus_config_t *config);
 void spi_bus_release(const spi_bus_config_t *config);
+// Queues a transfer without chip select and waits for it to complete. Must not
+// be called from a transaction callback.
 bool spi_bus_transfer(const spi_bus_config_t *config, const uint8_t *tx,
                       uint8_t *rx, size_t len);
+
+/**
+ * @brief Queue a transaction on its bus
+ *
+ * The transaction starts once the transactions queued before it on the same
+ * bus have completed, and must stay valid until then. It may be submitted again
+ * from its callback.
+ *
+ * @param transaction Transaction to queue
+ *
+ * @return true if the transaction has been queued, false if it is invalid or
+ * already queued
+ */
+bool spi_bus_submit(spi_transaction_t *transaction);
+
+/**
+ * @brief Check whether a bus has transactions queued or in progress
+ *
+ * @param bus Bus to check
+ *
+ * @return true if the bus is busy, false otherwise
+ */
+bool spi_bus_busy(uint8_t bus);
+
 void spi_cs_init(const spi_chip_select_t *chip_select);
 void spi_cs_select(const spi_chip_select_t *chip_select);
 void spi_cs_deselect(const spi_chip_select_t *chip_select);
@@ -47,6 +47,28 @@ timer_elapsed(uint32_t since) {
   return timer_read() - since;
 }
 
+/**
+ * @brief Read the current time in microseconds
+ *
+ * The time is monotonic and does not wrap around in practice, so it can be
+ * used to order events that happen within the same millisecond.
+ *
+ * @return Current time in microseconds
+ */
+uint64_t timer_read_us(void);
+
+/**
+ * @brief Get the elapsed time in microseconds since a given time
+ *
+ * @param since Time to compare against, read with `timer_read_us()`
+ *
+ * @return Elapsed time in microseconds
+ */
+__attribute__((always_inline)) static inline uint64_t
+timer_elapsed_us(uint64_t since) {
+  return timer_read_us() - since;
+}
+
 /**
  * @brief Delay for a given amount of time
  *
@@ -78,6 +78,18 @@ void hid_mouse_scroll(int8_t wheel, int8_t pan, uint8_t buttons);
  */
 void hid_clear_runtime_state(void);
 
+/**
+ * @brief Keep the keyboard reports going
+ *
+ * While enabled, the last keyboard report is sent again whenever there is no
+ * new one, so that a keyboard report is completed on every poll of the host.
+ *
+ * @param enabled Whether to keep the keyboard reports going
+ *
+ * @return None
+ */
+void hid_set_keyboard_report_clock(bool enabled);
+
 /**
  * @brief Send all HID reports
  *
@@ -18,14 +18,14 @@
 #include "hid.h"
 #include "layout.h"
 
-#define INPUT_ROUTING_VIRTUAL_KEY UINT8_MAX
+#define INPUT_ROUTING_VIRTUAL_KEY KEY_INDEX_NONE
 
 // Key-backed inputs participate in the normal layout/keymap pipeline.
-static inline bool input_key_press(uint8_t key) {
+static inline bool input_key_press(key_index_t key) {
   return layout_process_key(key, true);
 }
 
-static inline bool input_key_release(uint8_t key) {
+static inline bool input_key_release(key_index_t key) {
   return layout_process_key(key, false);
 }
 
@@ -38,14 +38,14 @@ static inline void input_keycode_release(uint8_t keycode) {
   layout_unregister(INPUT_ROUTING_VIRTUAL_KEY, keycode);
 }
 
-static inline void input_layout_press(uint8_t key, uint8_t keycode) {
+static inline void input_layout_press(key_index_t key, uint8_t keycode) {
   if (key == INPUT_ROUTING_VIRTUAL_KEY)
     input_keycode_press(keycode);
   else
     layout_register(key, keycode);
 }
 
-static inline void input_layout_release(uint8_t key, uint8_t keycode) {
+static inline void input_layout_release(key_index_t key, uint8_t keycode) {
   if (key == INPUT_ROUTING_VIRTUAL_KEY)
     input_keycode_release(keycode);
   else
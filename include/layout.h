@@ -41,16 +41,6 @@ void layout_init(void);
  */
 void layout_reset_runtime_state(void);
 
-/**
- * @brief Load advanced keys
- *
- * This function loads the advanced keys from the current profile. It should be
- * called whenever the profile changes or the advanced keys are updated.
- *
- * @return None
- */
-void layout_load_advanced_keys(void);
-
 /**
  * @brief Layout task
  *
@@ -66,7 +56,7 @@ void layout_task(void);
  *
  * @return None
  */
-void layout_register(uint8_t key, uint8_t keycode);
+void layout_register(key_index_t key, uint8_t keycode);
 
 /**
  * @brief Manually register a key release
@@ -76,7 +66,7 @@ void layout_register(uint8_t key, uint8_t keycode);
  *
  * @return None
  */
-void layout_unregister(uint8_t key, uint8_t keycode);
+void layout_unregister(key_index_t key, uint8_t keycode);
 
 /**
  * @brief Process key event
@@ -86,7 +76,7 @@ void layout_unregister(uint8_t key, uint8_t keycode);
  *
  * @return true if a non-Tap-Hold key event occurred
  */
-bool layout_process_key(uint8_t key, bool pressed);
+bool layout_process_key(key_index_t key, bool pressed);
 
 /**
  * @brief Get the current layer
@@ -103,4 +93,4 @@ uint8_t layout_get_current_layer(void);
  *
  * @return Keycode
  */
-uint8_t layout_get_keycode(uint8_t current_layer, uint8_t key);
+uint8_t layout_get_keycode(uint8_t current_layer, key_index_t key);
@@ -0,0 +1,106 @@
+/*
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "common.h"
+
+//--------------------------------------------------------------------+
+// Word-Wise CRC32 Arithmetic
+// Models the CRC units of the STM32 and AT32 MCUs, which shift in 32-bit words
+// from the most significant bit with the polynomial 0x04C11DB7
+//--------------------------------------------------------------------+
+
+#define CRC32_WORD_POLY 0x04C11DB7
+
+// Shift a word into the CRC register
+static inline uint32_t crc32_word_step(uint32_t crc, uint32_t word) {
+  crc ^= word;
+  for (uint32_t i = 0; i < 32; i++)
+    crc = (crc << 1) ^ (CRC32_WORD_POLY & (uint32_t)(-(int32_t)(crc >> 31)));
+
+  return crc;
+}
+
+// Multiply two polynomials modulo the CRC polynomial. Bit `i` holds the
+// coefficient of x^i.
+static inline uint32_t crc32_word_multiply(uint32_t a, uint32_t b) {
+  uint32_t product = 0;
+
+  for (uint32_t m = 1u << 31; m != 0; m >>= 1) {
+    product = (product << 1) ^
+              (CRC32_WORD_POLY & (uint32_t)(-(int32_t)(product >> 31)));
+    if (a & m)
+      product ^= b;
+  }
+
+  return product;
+}
+
+// Compute x^(32 * num_words) modulo the CRC polynomial. Multiplying a CRC
+// register by it shifts in `num_words` zero words.
+static inline uint32_t crc32_word_zeros_operator(uint32_t num_words) {
+  // x^0, and x^32 squared once per bit of `num_words`
+  uint32_t op = 1, power = CRC32_WORD_POLY;
+
+  for (; num_words != 0; num_words >>= 1) {
+    if (num_words & 1)
+      op = crc32_word_multiply(op, power);
+    power = crc32_word_multiply(power, power);
+  }
+
+  return op;
+}
+
+// `crc32_compute_zeros()` for a `crc32_compute()` which resets the CRC unit,
+// then shifts in the initial value and the buffer one word at a time
+static inline uint32_t crc32_word_compute_zeros(uint32_t len, uint32_t crc) {
+  return crc32_word_multiply(crc32_word_step(0xFFFFFFFF, crc),
+                             crc32_word_zeros_operator((len + 3) / 4));
+}
+
+// `crc32_update_range()` for a `crc32_compute()` which shifts the buffer into
+// the CRC unit one little endian word at a time, the last one padded with
+// zeros
+static inline uint32_t crc32_word_update_range(uint32_t crc, uint32_t len,
+                                               uint32_t offset,
+                                               const void *old_data,
+                                               const void *new_data,
+                                               uint32_t range_len) {
+  const uint8_t *old8 = old_data, *new8 = new_data;
+  uint32_t delta = 0;
+
+  if (range_len == 0)
+    return crc;
+
+  // The CRC is affine in the data, so the change is the CRC register of the
+  // XOR of the old and new words followed by the rest of the buffer
+  const uint32_t first = offset / 4, last = (offset + range_len - 1) / 4;
+  for (uint32_t w = first; w <= last; w++) {
+    uint32_t word = 0;
+    for (uint32_t b = 0; b < 4; b++) {
+      const uint32_t i = w * 4 + b - offset;
+      if (w * 4 + b >= offset && i < range_len)
+        word |= (uint32_t)(old8[i] ^ new8[i]) << (8 * b);
+    }
+    delta = crc32_word_step(delta, word);
+  }
+
+  if (delta == 0)
+    return crc;
+
+  return crc ^ crc32_word_multiply(
+                   delta, crc32_word_zeros_operator((len + 3) / 4 - last - 1));
+}
@@ -0,0 +1,101 @@
+/*
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "common.h"
+
+//--------------------------------------------------------------------+
+// Main Loop Profiling
+//--------------------------------------------------------------------+
+
+// With `LOOP_PROFILE_ENABLED`, each stage of the main loop is timed with the
+// CPU cycle counter, and the longest run of each stage is kept. The native
+// cycle budget harness drives the stages through the same hooks with worst
+// case inputs. Otherwise, the hooks are plain calls.
+
+// Main loop stages, in the order they run
+typedef enum {
+  LOOP_STAGE_USB = 0,
+  LOOP_STAGE_USB_RUNTIME,
+  LOOP_STAGE_ANALOG,
+  LOOP_STAGE_MATRIX_SCAN,
+  LOOP_STAGE_ENCODER,
+  LOOP_STAGE_LAYOUT,
+  LOOP_STAGE_RGB,
+  LOOP_STAGE_JOYSTICK,
+  LOOP_STAGE_SLIDER,
+  LOOP_STAGE_XINPUT,
+  LOOP_STAGE_COMMAND,
+  LOOP_STAGE_WEAR_LEVELING,
+  LOOP_STAGE_COUNT,
+} loop_stage_t;
+
+#if defined(LOOP_PROFILE_ENABLED)
+#include "hardware/hardware.h"
+
+// Run a main loop stage and record its cycle count
+#define LOOP_PROFILE(stage, call)                                              \
+  do {                                                                         \
+    const uint32_t _start = board_cycle_count();                               \
+    call;                                                                      \
+    loop_profile_record(stage, board_cycle_count() - _start);                  \
+  } while (0)
+#else
+#define LOOP_PROFILE(stage, call) call
+#endif
+
+//--------------------------------------------------------------------+
+// Main Loop Profiling API
+//--------------------------------------------------------------------+
+
+#if defined(LOOP_PROFILE_ENABLED)
+/**
+ * @brief Record a run of a main loop stage
+ *
+ * @param stage Main loop stage
+ * @param cycles Number of CPU cycles the run took
+ *
+ * @return None
+ */
+void loop_profile_record(loop_stage_t stage, uint32_t cycles);
+
+/**
+ * @brief Get the longest run of a main loop stage
+ *
+ * @param stage Main loop stage
+ *
+ * @return Number of CPU cycles of the longest run since the last reset
+ */
+uint32_t loop_profile_max_cycles(loop_stage_t stage);
+
+/**
+ * @brief Get the name of a main loop stage
+ *
+ * The names are the keys of `cycle_budget` in `keyboard.json`.
+ *
+ * @param stage Main loop stage
+ *
+ * @return Name of the stage
+ */
+const char *loop_profile_stage_name(loop_stage_t stage);
+
+/**
+ * @brief Forget the recorded runs
+ *
+ * @return None
+ */
+void loop_profile_reset(void);
+#endif
@@ -122,8 +122,9 @@ typedef struct {
   bool is_pressed;
   // Timestamp when the key last left a stable resting state
   uint32_t rest_stable_since;
-  // Timestamp when is_pressed last changed (used for event ordering)
-  uint32_t event_time;
+  // Time in microseconds when is_pressed last changed (used for event
+  // ordering)
+  uint64_t event_time;
 } key_state_t;
 
 // Key matrix
@@ -170,7 +171,7 @@ void matrix_scan(void);
  *
  * @return None
  */
-void matrix_disable_rapid_trigger(uint8_t key, bool disable);
+void matrix_disable_rapid_trigger(key_index_t key, bool disable);
 
 /**
  * @brief Get the duration in milliseconds since the keyboard was last active
@@ -21,9 +21,29 @@
 // Migration Types
 //---------------------------------------------------------------------+
 
+// Migration script operation. Converts `count` consecutive elements of
+// `src_size` bytes in the previous configuration into elements of `dst_size`
+// bytes. Without a transform function, the first `src_size` bytes of each
+// element are copied and the rest is filled with `value`.
+typedef struct {
+  uint32_t count;
+  uint8_t src_size;
+  uint8_t dst_size;
+  uint8_t value;
+  // Transform function for each element. `src` points to the element in the
+  // previous configuration, and `dst` to the `dst_size` bytes to fill.
+  void (*transform)(uint8_t *dst, const uint8_t *src);
+} migration_op_t;
+
+// Sequence of operations converting one section of the configuration
+typedef struct {
+  const migration_op_t *ops;
+  uint32_t num_ops;
+} migration_script_t;
+
 // Migration metadata. Each configuration version should have a
 // corresponding migration metadata structure.
-typedef struct __attribute__((packed)) {
+typedef struct {
   // Configuration version this migration applies to
   uint16_t version;
   // Size of the global configuration part of the configuration in bytes. This
@@ -31,15 +51,13 @@ typedef struct __attribute__((packed)) {
   uint32_t global_config_size;
   // Size of each profile configuration in bytes
   uint32_t profile_config_size;
-  // Migration function for the global configuration. This function should
-  // return true if the migration was successful, false otherwise. `dst` and
-  // `src` point to the start of the global configuration.
-  bool (*global_config_func)(uint8_t *dst, const uint8_t *src);
-  // Migration function for each profile configuration. This function should
-  // return true if the migration was successful, false otherwise. `dst` and
-  // `src` point to the start of the profile configuration.
-  bool (*profile_config_func)(uint8_t profile, uint8_t *dst,
-                              const uint8_t *src);
+  // Script converting the global configuration of the previous version
+  migration_script_t global_config_script;
+  // Script converting each profile configuration of the previous version
+  migration_script_t profile_config_script;
+  // Function completing the conversion once the sections have been
+  // converted, or NULL
+  bool (*finalize)(void);
 } migration_t;
 
 //--------------------------------------------------------------------+
@@ -49,6 +67,10 @@ typedef struct __attribute__((packed)) {
 /**
  * @brief Try to migrate the persistent configuration to the latest format
  *
+ * The configuration is converted in place, one version at a time. Each section
+ * is streamed through a small window from the last profile to the global
+ * configuration, and written back through the wear leveling module.
+ *
  * @return true if migration was successful, false otherwise
  */
 bool migration_try_migrate(void);
@@ -103,6 +103,32 @@ typedef struct {
     rgb_color_t trigger_state_colors[RGB_TRIGGER_STATE_COLOR_COUNT];
 } rgb_config_t;
 
+// Host stream packet encodings
+typedef enum {
+    // `data` holds R, G, B triplets for consecutive LEDs from `offset`
+    RGB_STREAM_ENCODING_RAW = 0,
+    // `data` holds (count, R, G, B) runs for consecutive LEDs from `offset`
+    RGB_STREAM_ENCODING_RLE,
+    // `data` holds 4-bit palette indices for consecutive LEDs from `offset`,
+    // low nibble first
+    RGB_STREAM_ENCODING_PALETTE,
+    // `data` holds R, G, B triplets for palette entries from `offset`
+    RGB_STREAM_ENCODING_SET_PALETTE,
+    RGB_STREAM_ENCODING_COUNT,
+} rgb_stream_encoding_t;
+
+// Present the frame once this packet is applied
+#define RGB_STREAM_FLAG_PRESENT 0x01
+// Stop streaming and return to the stored effect
+#define RGB_STREAM_FLAG_STOP 0x02
+
+#define RGB_STREAM_PALETTE_SIZE 16
+
+typedef struct {
+    uint16_t presented_sequence;
+    uint16_t dropped_frames;
+} rgb_stream_status_t;
+
 // API
 void rgb_init(void);
 void rgb_task(void);
@@ -110,9 +136,30 @@ void rgb_set_color(uint8_t index, uint8_t r, uint8_t g, uint8_t b);
 void rgb_set_all_color(uint8_t r, uint8_t g, uint8_t b);
 void rgb_update(void);
 rgb_color_t hsv_to_rgb(hsv_t hsv);
-void rgb_matrix_record_keypress(uint8_t index);
+void rgb_matrix_record_keypress(key_index_t index);
 void rgb_set_clock_time(uint8_t hours, uint8_t minutes, uint8_t seconds);
 
+/**
+ * @brief Apply a host stream packet to the stream framebuffer
+ *
+ * Packets of the same frame share `sequence`. A packet with a sequence not
+ * newer than the last presented frame is ignored. The stream only lives in RAM
+ * and falls back to the stored effect once no packet arrived for
+ * `RGB_STREAM_TIMEOUT_MS`.
+ *
+ * @param sequence Frame sequence number
+ * @param flags `RGB_STREAM_FLAG_*`
+ * @param encoding Encoding of `data`
+ * @param offset First LED or palette entry
+ * @param data Encoded payload
+ * @param len Payload length in bytes
+ *
+ * @return `false` if the packet is malformed, in which case nothing is applied
+ */
+bool rgb_stream_write(uint16_t sequence, uint8_t flags, uint8_t encoding,
+                      uint8_t offset, const uint8_t *data, uint8_t len);
+rgb_stream_status_t rgb_stream_get_status(void);
+
 // Provide access to the configuration block for EEPROM
 rgb_config_t* rgb_get_config(void);
 void rgb_apply_config(void);
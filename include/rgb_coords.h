@@ -52,6 +52,54 @@ const led_point_t rgb_led_coords[NUM_LEDS] = {
     {0, 0}
 };
 
+typedef struct {
+    uint8_t distance;
+    uint8_t angle;
+} led_polar_t;
+
+const led_polar_t rgb_led_polar[NUM_LEDS] = {
+    {178, 222},
+    {160, 217},
+    {139, 207},
+    {128, 195},
+    {128, 186},
+    {139, 174},
+    {160, 165},
+    {178, 159},
+    {135, 140},
+    {112, 143},
+    {91, 147},
+    {72, 153},
+    {55, 163},
+    {55, 218},
+    {72, 229},
+    {91, 235},
+    {112, 239},
+    {134, 241},
+    {133, 12},
+    {112, 15},
+    {91, 19},
+    {71, 25},
+    {54, 35},
+    {54, 91},
+    {71, 102},
+    {91, 108},
+    {112, 111},
+    {134, 114},
+    {180, 95},
+    {164, 91},
+    {150, 86},
+    {139, 81},
+    {131, 74},
+    {127, 67},
+    {127, 59},
+    {131, 52},
+    {139, 46},
+    {150, 40},
+    {164, 35},
+    {179, 31}
+};
+
 const uint8_t rgb_led_is_mod[NUM_LEDS] = {
     1,
     1,
@@ -95,7 +143,7 @@ const uint8_t rgb_led_is_mod[NUM_LEDS] = {
     0
 };
 
-const uint8_t rgb_led_key_index[NUM_LEDS] = {
+const key_index_t rgb_led_key_index[NUM_LEDS] = {
     38,
     36,
     32,
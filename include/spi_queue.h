@@ -0,0 +1,81 @@
+/*
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "hardware/spi_api.h"
+
+//--------------------------------------------------------------------+
+// SPI Driver Interface
+//--------------------------------------------------------------------+
+
+// The SPI queue runs the transactions of each bus in order, and leaves the
+// transfers themselves to the hardware backend through this interface.
+
+typedef enum {
+  // The transfer could not be started
+  SPI_DRIVER_ERROR = 0,
+  // The transfer runs in the background, and the backend calls
+  // `spi_queue_complete()` once it is done
+  SPI_DRIVER_PENDING,
+  // The transfer has been done before returning
+  SPI_DRIVER_DONE,
+} spi_driver_status_t;
+
+/**
+ * @brief Start the transfer of a transaction
+ *
+ * Implemented by the hardware backend. The bus is configured for the
+ * transaction, and its chip select has already been asserted.
+ *
+ * @param bus Bus of the transaction
+ * @param transaction Transaction to transfer
+ *
+ * @return Status of the transfer
+ */
+spi_driver_status_t spi_driver_start(uint8_t bus,
+                                     const spi_transaction_t *transaction);
+
+/**
+ * @brief Mask the completion interrupt of a bus
+ *
+ * Implemented by the hardware backend. The queue masks the interrupt while it
+ * updates the queue of the bus outside of it.
+ *
+ * @param bus Bus to mask the interrupt of
+ * @param masked true to mask the interrupt, false to unmask it
+ *
+ * @return None
+ */
+void spi_driver_mask_irq(uint8_t bus, bool masked);
+
+//--------------------------------------------------------------------+
+// SPI Queue API
+//--------------------------------------------------------------------+
+
+/**
+ * @brief Complete the transaction in progress on a bus
+ *
+ * Called by the hardware backend from the completion interrupt of a transfer
+ * started with `SPI_DRIVER_PENDING`. The chip select is released unless the
+ * transaction keeps it, the callback is called, and the next transaction is
+ * started.
+ *
+ * @param bus Bus of the transaction
+ * @param success true if the transfer was successful, false otherwise
+ *
+ * @return None
+ */
+void spi_queue_complete(uint8_t bus, bool success);
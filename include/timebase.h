@@ -0,0 +1,71 @@
+/*
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include "common.h"
+
+//--------------------------------------------------------------------+
+// Timebase Configuration
+//--------------------------------------------------------------------+
+
+// The microsecond time is built from the 32-bit CPU cycle counter, which wraps
+// around every 2^32 / F_CPU seconds, about 20 seconds at 216 MHz. The wraps
+// are counted by `timebase_update()`, which must run at least once between
+// two wraps, for example from the millisecond timer interrupt.
+
+_Static_assert(F_CPU % 1000000 == 0, "F_CPU must be a whole number of MHz");
+
+// CPU cycles per microsecond
+#define TIMEBASE_CYCLES_PER_US (F_CPU / 1000000)
+
+//--------------------------------------------------------------------+
+// Timebase API
+//--------------------------------------------------------------------+
+
+/**
+ * @brief Initialize the timebase
+ *
+ * The cycle counter must be running. The time starts from its current value.
+ *
+ * @return None
+ */
+void timebase_init(void);
+
+/**
+ * @brief Count the cycle counter wraps
+ *
+ * Called from the timer interrupt, at least once per cycle counter wrap.
+ *
+ * @return None
+ */
+void timebase_update(void);
+
+/**
+ * @brief Read the cycle counter extended to 64 bits
+ *
+ * Safe to call from both the main loop and interrupts.
+ *
+ * @return Current cycle count
+ */
+uint64_t timebase_read_cycles(void);
+
+/**
+ * @brief Read the current time in microseconds
+ *
+ * @return Current time in microseconds
+ */
+uint64_t timebase_read_us(void);
@@ -43,6 +43,8 @@ void usb_runtime_mount(void);
 /**
  * @brief Record that the USB bus entered suspend
  *
+ * The wear leveling cache is flushed by the next `usb_runtime_task()` call.
+ *
  * @return None
  */
 void usb_runtime_suspend(void);
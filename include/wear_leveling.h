@@ -21,46 +21,153 @@
 // Wear Leveling Configuration
 //--------------------------------------------------------------------+
 
-_Static_assert(WL_VIRTUAL_SIZE <= 8192,
-               "WL_VIRTUAL_SIZE must be at most 8192.");
+// Number of bits of the virtual address in a write log entry
+#define WL_LOG_ENTRY_ADDR_BITS 18
+
+_Static_assert(WL_VIRTUAL_SIZE <= (1 << WL_LOG_ENTRY_ADDR_BITS),
+               "WL_VIRTUAL_SIZE must be at most 256 KB.");
 _Static_assert(WL_VIRTUAL_SIZE % 4 == 0,
                "WL_VIRTUAL_SIZE must be word-aligned.");
 
 _Static_assert(WL_WRITE_LOG_SIZE % 4 == 0,
                "WL_WRITE_LOG_SIZE must be word-aligned.");
 
-// Flash space in bytes used by the wear leveling module
+// Flash space in bytes used by each bank of the wear leveling module
 #define WL_BACKING_STORE_SIZE (WL_VIRTUAL_SIZE + WL_WRITE_LOG_SIZE)
+// The backing store alternates between two banks so the consolidated data is
+// never erased before a newer copy has been committed
+#define WL_NUM_BANKS 2
 
-_Static_assert(WL_BACKING_STORE_SIZE <= FLASH_SIZE,
+_Static_assert(WL_NUM_BANKS * WL_BACKING_STORE_SIZE <= FLASH_SIZE,
                "The wear leveling backing store must fit in flash.");
 
+#if !defined(WL_WRITE_BACK_DELAY_MS)
+// Idle time after the last write before the changed bytes are logged. With 0,
+// every write is logged immediately.
+#define WL_WRITE_BACK_DELAY_MS 1000
+#endif
+
+#if !defined(WL_WRITE_BACK_MAX_RANGES)
+// Maximum number of disjoint changed byte ranges held before they are logged
+#define WL_WRITE_BACK_MAX_RANGES 8
+#endif
+
+_Static_assert(WL_WRITE_BACK_MAX_RANGES > 0,
+               "WL_WRITE_BACK_MAX_RANGES must be positive.");
+
+#if defined(WL_XIP_ENABLED)
+// With execute-in-place, only the start of the virtual storage is kept in RAM.
+// The rest is read in place from the consolidated data of the active bank, and
+// the pages of it written since it was committed are held in an overlay.
+
+#if !defined(WL_CACHE_SIZE)
+// Bytes at the start of the virtual storage kept in `wl_cache`
+#define WL_CACHE_SIZE 512
+#endif
+
+#if !defined(WL_OVERLAY_NUM_PAGES)
+// Number of pages the overlay holds. Once most of them are in use, the virtual
+// storage is consolidated to free them.
+#define WL_OVERLAY_NUM_PAGES 32
+#endif
+
+// Size of an overlay page in bytes
+#define WL_OVERLAY_PAGE_SIZE 64
+
+_Static_assert(WL_CACHE_SIZE % WL_OVERLAY_PAGE_SIZE == 0 &&
+                   WL_CACHE_SIZE <= WL_VIRTUAL_SIZE,
+               "WL_CACHE_SIZE must be a multiple of WL_OVERLAY_PAGE_SIZE "
+               "within WL_VIRTUAL_SIZE.");
+_Static_assert(WL_VIRTUAL_SIZE % WL_OVERLAY_PAGE_SIZE == 0,
+               "WL_VIRTUAL_SIZE must be a multiple of WL_OVERLAY_PAGE_SIZE.");
+_Static_assert(WL_OVERLAY_NUM_PAGES > 0,
+               "WL_OVERLAY_NUM_PAGES must be positive.");
+#else
+// The whole virtual storage is kept in `wl_cache`
+#define WL_CACHE_SIZE WL_VIRTUAL_SIZE
+#endif
+
+//--------------------------------------------------------------------+
+// Wear Leveling Bank Layout
+//--------------------------------------------------------------------+
+
+// Each bank starts with the consolidated data, followed by a header and the
+// write log. The sequence number is programmed last and commits the bank. The
+// retired word is programmed once a newer bank has been committed.
+#define WL_HEADER_SEQUENCE (WL_VIRTUAL_SIZE)
+#define WL_HEADER_CHECKSUM (WL_VIRTUAL_SIZE + 4)
+#define WL_HEADER_RETIRED (WL_VIRTUAL_SIZE + 8)
+#define WL_HEADER_FORMAT (WL_VIRTUAL_SIZE + 12)
+#define WL_WRITE_LOG_START (WL_VIRTUAL_SIZE + 16)
+
+// Format of the write log. Banks without it hold `wl_legacy_log_entry_t`
+// entries, whose first word can never be this value since its length is 0.
+#define WL_LOG_FORMAT 0x574C0002
+
 //--------------------------------------------------------------------+
 // Wear Leveling Write Log Entry
 //--------------------------------------------------------------------+
 
-#define WL_LOG_ENTRY_SIZE 8
-#define WL_MAX_BYTES_PER_ENTRY 6
+#define WL_MAX_BYTES_PER_ENTRY 64
+// An entry takes one word for the address, the length and the first data
+// byte, followed by as many words as needed for the rest of the data
+#define WL_LOG_ENTRY_NUM_WORDS(len) (1 + ((len) + 2) / 4)
+#define WL_LOG_ENTRY_MAX_SIZE                                                  \
+  (WL_LOG_ENTRY_NUM_WORDS(WL_MAX_BYTES_PER_ENTRY) * 4)
+
+typedef union __attribute__((packed)) {
+  struct __attribute__((packed)) {
+    uint32_t addr : WL_LOG_ENTRY_ADDR_BITS;
+    // Length of the data minus 1
+    uint32_t len : 6;
+    uint8_t data[WL_MAX_BYTES_PER_ENTRY];
+  } fields;
+  uint32_t raw[WL_LOG_ENTRY_MAX_SIZE / 4];
+} wl_log_entry_t;
+
+_Static_assert(sizeof(wl_log_entry_t) == WL_LOG_ENTRY_MAX_SIZE,
+               "wl_log_entry_t must be WL_LOG_ENTRY_MAX_SIZE bytes.");
+
+// Checkpoint in the write log, recording that the consolidated data of the
+// bank has been verified against the checksum in the following word. As an
+// entry, it would write 64 bytes from the highest address, which never fits.
+#define WL_LOG_CHECKPOINT 0x01FFFFFF
+#define WL_LOG_CHECKPOINT_NUM_WORDS 2
+
+_Static_assert((WL_LOG_CHECKPOINT & ((1 << WL_LOG_ENTRY_ADDR_BITS) - 1)) +
+                       WL_MAX_BYTES_PER_ENTRY >
+                   WL_VIRTUAL_SIZE,
+               "WL_LOG_CHECKPOINT must not be a valid write log entry.");
+
+_Static_assert(WL_WRITE_LOG_START + WL_LOG_ENTRY_MAX_SIZE <=
+                   WL_BACKING_STORE_SIZE,
+               "WL_WRITE_LOG_SIZE is too small for the bank header.");
+
+// Write log entry of the format used before `WL_LOG_FORMAT`, only replayed to
+// migrate the store. Entries with more than 2 bytes of data take 2 words.
+#define WL_LEGACY_MAX_BYTES_PER_ENTRY 6
 
 typedef union __attribute__((packed)) {
   struct __attribute__((packed)) {
     uint16_t addr : 13;
     uint8_t len : 3;
-    uint8_t data[WL_MAX_BYTES_PER_ENTRY];
+    uint8_t data[WL_LEGACY_MAX_BYTES_PER_ENTRY];
   } fields;
   uint32_t raw[2];
-} wl_log_entry_t;
+} wl_legacy_log_entry_t;
 
-_Static_assert(sizeof(wl_log_entry_t) == WL_LOG_ENTRY_SIZE,
-               "wl_log_entry_t must be 8 bytes.");
+_Static_assert(sizeof(wl_legacy_log_entry_t) == 8,
+               "wl_legacy_log_entry_t must be 8 bytes.");
 
 //--------------------------------------------------------------------+
 // Wear Leveling Cache
 //--------------------------------------------------------------------+
 
-// The virtual storage of the wear leveling module. It is automatically
-// updated when the wear leveling module is initialized and a write operation
-// is performed. Do not modify this array directly.
+// The first `WL_CACHE_SIZE` bytes of the virtual storage of the wear leveling
+// module, which is all of it unless `WL_XIP_ENABLED` is defined. It is
+// automatically updated when the wear leveling module is initialized and a
+// write operation is performed. Do not modify this array directly, and use
+// `wear_leveling_read()` for the rest of the virtual storage.
 extern uint8_t wl_cache[];
 
 //--------------------------------------------------------------------+
@@ -70,6 +177,10 @@ extern uint8_t wl_cache[];
 /**
  * @brief Initialize the wear leveling module
  *
+ * The cache is loaded from the newest committed bank and its write log. The
+ * data of the bank is checked against its checksum later by
+ * `wear_leveling_task()`, unless a previous boot has already done it.
+ *
  * @return None
  */
 void wear_leveling_init(void);
@@ -77,6 +188,10 @@ void wear_leveling_init(void);
 /**
  * @brief Erase the virtual storage
  *
+ * The cache is cleared immediately, and the cleared storage is committed to the
+ * idle bank in the background by `wear_leveling_task()`. The previous data
+ * remains in flash until then.
+ *
  * @return true if the erase was successful, false otherwise
  */
 bool wear_leveling_erase(void);
@@ -95,6 +210,10 @@ bool wear_leveling_read(uint32_t addr, void *buf, uint32_t len);
 /**
  * @brief Write data to the virtual storage
  *
+ * The cache is updated immediately. The changed bytes are merged with the
+ * other changes not logged yet, and logged once no write has been made for
+ * `WL_WRITE_BACK_DELAY_MS`.
+ *
  * @param addr Address to write to
  * @param buf Buffer to write from
  * @param len Length of the data in bytes
@@ -102,3 +221,37 @@ bool wear_leveling_read(uint32_t addr, void *buf, uint32_t len);
  * @return true if the write was successful, false otherwise
  */
 bool wear_leveling_write(uint32_t addr, const void *buf, uint32_t len);
+
+/**
+ * @brief Wear leveling task
+ *
+ * Verifies the active bank once after it has been loaded or committed,
+ * `WL_VERIFY_BYTES_PER_STEP` bytes per call, and appends a checkpoint to the
+ * write log so later boots skip it. If the data loaded at boot turns out to be
+ * corrupted, the bank is retired and the virtual storage is loaded again in
+ * place from the other bank, or cleared if no intact data is left. The caller
+ * must then reload whatever it derived from the virtual storage. Settings
+ * applied once at boot by other modules keep their previous values until the
+ * next reset.
+ *
+ * Logs the changes held in the cache once the writes have been idle for
+ * `WL_WRITE_BACK_DELAY_MS`. When the write log is full, the cache is
+ * consolidated into the idle bank in the background. Each call performs at
+ * most one step of it: erasing one sector, or programming
+ * `WL_CONSOLIDATE_WORDS_PER_STEP` words. Writes made in the meantime are held
+ * in the cache and persisted once the consolidation is done.
+ *
+ * @return true if the virtual storage has been loaded again, false otherwise
+ */
+bool wear_leveling_task(void);
+
+/**
+ * @brief Log the changes held in the cache and finish any consolidation in
+ * progress
+ *
+ * This function must be called before resetting the MCU or when the power may
+ * be removed, or the changes held in the cache are lost.
+ *
+ * @return true if everything has been persisted, false otherwise
+ */
+bool wear_leveling_flush(void);
@@ -96,7 +96,7 @@ void xinput_init(void);
  *
  * @return None
  */
-void xinput_process(uint8_t key);
+void xinput_process(key_index_t key);
 
 /**
  * @brief Reset runtime gamepad/XInput state.
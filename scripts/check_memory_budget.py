@@ -60,6 +60,18 @@ def load_sections(elf_path: str) -> dict[str, dict[str, int]]:
     return sections
 
 
+def load_symbol_sizes(elf_path: str) -> dict[str, int]:
+    output = subprocess.check_output(
+        ["nm", "--print-size", elf_path], text=True, encoding="utf-8"
+    )
+    sizes: dict[str, int] = {}
+    for line in output.splitlines():
+        fields = line.split()
+        if len(fields) == 4:
+            sizes[fields[3]] = int(fields[1], 16)
+    return sizes
+
+
 def main() -> int:
     parser = argparse.ArgumentParser(description="Check firmware memory headroom")
     parser.add_argument("--keyboard", required=True)
@@ -87,7 +99,7 @@ def main() -> int:
     wl_virtual_size = wl_cfg.get("virtual_size", 8192)
     wl_write_log_size = wl_cfg.get("write_log_size", 65536)
     reserved_flash = driver.metadata.flash.round_up_to_flash_sectors(
-        wl_virtual_size + wl_write_log_size
+        wl_virtual_size + wl_write_log_size, utils.WL_NUM_BANKS
     )
     flash_limit = driver.metadata.flash.get_flash_size() - reserved_flash
 
@@ -122,6 +134,20 @@ def main() -> int:
         f"headroom={ram_headroom} reserved_heap_stack={heap_stack_reserved}"
     )
 
+    # With execute-in-place, the wear leveling module keeps only part of the
+    # virtual storage in RAM
+    symbol_sizes = load_symbol_sizes(args.elf)
+    wl_ram = sum(
+        size
+        for name, size in symbol_sizes.items()
+        if name in ("wl_cache", "wl_overlay", "wl_overlay_pages")
+    )
+    print(
+        f"[size] {keyboard}: wear_leveling_ram={wl_ram} "
+        f"virtual_size={wl_virtual_size} "
+        f"saved={max(wl_virtual_size - wl_ram, 0)}"
+    )
+
     failures: list[str] = []
     if flash_headroom < min_flash_headroom:
         failures.append(
@@ -56,6 +56,10 @@ class UniformSectors:
     num_sectors: int
 
 
+# Number of wear leveling banks, which must match `WL_NUM_BANKS`
+WL_NUM_BANKS = 2
+
+
 @dataclass
 class Flash:
     sector_sizes: NonUniformSectors | UniformSectors
@@ -88,14 +92,18 @@ class Flash:
                 assert sector < num_sectors
                 return size
 
-    # Round up the required size to the minimum number of flash sectors (from the end)
-    def round_up_to_flash_sectors(self, required_size: int):
-        assert required_size <= self.get_flash_size()
+    # Round up the required size of each bank to the minimum number of flash
+    # sectors (from the end), and return the total size of the banks
+    def round_up_to_flash_sectors(self, required_size: int, num_banks: int = 1):
+        assert required_size * num_banks <= self.get_flash_size()
         total = 0
-        for i in range(self.get_num_sectors() - 1, -1, -1):
-            total += self.get_sector_size(i)
-            if total >= required_size:
-                return total
+        sector = self.get_num_sectors()
+        for _ in range(num_banks):
+            bank_size = 0
+            while bank_size < required_size and sector > 0:
+                sector -= 1
+                bank_size += self.get_sector_size(sector)
+            total += bank_size
         return total
 
 
@@ -77,6 +77,16 @@ def gen_rgb_coords(keyboard_dir):
         if isinstance(key_index, int) and 0 <= key_index < num_keys:
             key_to_led[key_index] = led_index
 
+    # Polar coordinates around the center of the keyboard, matching the
+    # integer distance and 8-bit angle the effects used to compute per frame
+    led_polar = []
+    for x, y in led_coords:
+        dx = x - 127
+        dy = y - 127
+        distance = math.isqrt(dx * dx + dy * dy) & 0xFF
+        angle = int(((math.atan2(dy, dx) + math.pi) * 255.0) / (2.0 * math.pi))
+        led_polar.append((distance, angle & 0xFF))
+
     for key_index, (x, y) in key_coords.items():
         key_data = None
         for row in layout:
@@ -146,12 +156,18 @@ def gen_rgb_coords(keyboard_dir):
             f.write(f"    {{{x}, {y}}}{comma}\n")
         
         f.write("};\n\n")
+        f.write("typedef struct {\n    uint8_t distance;\n    uint8_t angle;\n} led_polar_t;\n\n")
+        f.write(f"const led_polar_t rgb_led_polar[NUM_LEDS] = {{\n")
+        for i, (distance, angle) in enumerate(led_polar):
+            comma = "," if i < len(led_polar) - 1 else ""
+            f.write(f"    {{{distance}, {angle}}}{comma}\n")
+        f.write("};\n\n")
         f.write(f"const uint8_t rgb_led_is_mod[NUM_LEDS] = {{\n")
         for i, is_mod in enumerate(led_is_mod):
             comma = "," if i < len(led_is_mod) - 1 else ""
             f.write(f"    {is_mod}{comma}\n")
         f.write("};\n\n")
-        f.write(f"const uint8_t rgb_led_key_index[NUM_LEDS] = {{\n")
+        f.write(f"const key_index_t rgb_led_key_index[NUM_LEDS] = {{\n")
         for i, key_index in enumerate(led_map):
             comma = "," if i < len(led_map) - 1 else ""
             f.write(f"    {key_index}{comma}\n")
@@ -242,6 +242,10 @@ def generate_ts(structs: Dict[str, dict], macros: Dict[str, str]) -> str:
       result.macroKey = parseMacroKey(reader)
       reader.offset += 9 // 13 - 3 - 1 = 9 skips
       break
+    case 7: // AK_TYPE_RAPID_FIRE
+      result.rapidFire = parseRapidFire(reader)
+      reader.offset += 6 // 13 - 3 - 4 = 6 skips
+      break
     default:
       reader.offset += 10 // exhaust empty action bytes
       break
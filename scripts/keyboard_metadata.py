@@ -32,6 +32,11 @@ def build_keyboard_metadata(kb_json: dict, driver):
     for key in raw.get("vector", []):
         add_analog_key(key)
 
+    spi_adc = analog.get("spi_adc", {})
+    for channels in spi_adc.get("matrix", []):
+        for key in channels:
+            add_analog_key(key)
+
     analog_keys = sorted(analog_keys)
 
     led_map = []
@@ -81,18 +81,69 @@ build_flags.define("USB_PRODUCT_ID", kb_json["usb"]["pid"])
 # Analog Configuration
 analog = kb_json["analog"]
 analog_backend = analog.get("backend", "mcu_adc")
+# Key of each mux channel and input, and of each raw input
+mux_matrix = []
+raw_vector = []
 
 match analog_backend:
     case "mcu_adc":
         build_flags.define("ANALOG_BACKEND_MCU_ADC")
+        build_flags.define("ADC_NUM_CHANNELS", len(driver.metadata.adc.input_pins))
     case "spi_adc":
-        raise ValueError(
-            "analog.backend='spi_adc' is reserved for future external SPI ADC support and is not implemented yet"
+        if "spi_adc" not in analog:
+            raise ValueError("analog.spi_adc is required by analog.backend='spi_adc'")
+        if "raw" in analog or "mux" in analog or "digital" in kb_json:
+            raise ValueError(
+                "analog.raw, analog.mux and digital cannot be used with analog.backend='spi_adc'"
+            )
+
+        spi_adc = analog["spi_adc"]
+        device = utils.SPI_ADC_DEVICES[spi_adc["device"]]
+        num_devices = len(spi_adc["chip_select"])
+        if "adc_resolution" in analog and analog["adc_resolution"] != device["resolution"]:
+            raise ValueError(
+                f"{spi_adc['device']} has a fixed resolution of {device['resolution']} bits"
+            )
+        if len(spi_adc["matrix"]) != num_devices or any(
+            len(channels) > device["num_channels"] for channels in spi_adc["matrix"]
+        ):
+            raise ValueError(
+                f"analog.spi_adc.matrix must have one row of at most {device['num_channels']} channels for each chip select"
+            )
+
+        build_flags.define("ANALOG_BACKEND_SPI_ADC")
+        build_flags.define(f"SPI_ADC_DEVICE_{spi_adc['device'].upper()}")
+        build_flags.define("SPI_ADC_BUS", spi_adc.get("bus", 0))
+        build_flags.define("SPI_ADC_FREQUENCY_HZ", spi_adc["frequency"])
+        if "mode" in spi_adc:
+            build_flags.define("SPI_ADC_MODE", f"SPI_BUS_MODE_{spi_adc['mode']}")
+        build_flags.define("SPI_ADC_NUM_DEVICES", num_devices)
+
+        ports, pin_nums = driver.metadata.adc.to_gpio_array(spi_adc["chip_select"])
+        build_flags.define("SPI_ADC_CS_PORTS", utils.to_c_array(ports))
+        build_flags.define("SPI_ADC_CS_PINS", utils.to_c_array(pin_nums))
+
+        # The connected channels are sampled as raw inputs, numbered across the
+        # devices
+        inputs = [
+            (i * device["num_channels"] + channel, key)
+            for i, channels in enumerate(spi_adc["matrix"])
+            for channel, key in enumerate(channels)
+            if key != 0
+        ]
+        build_flags.define("ADC_NUM_CHANNELS", num_devices * device["num_channels"])
+        build_flags.define("ADC_NUM_RAW_INPUTS", len(inputs))
+        build_flags.define(
+            "ADC_RAW_INPUT_CHANNELS", utils.to_c_array([x for x, _ in inputs])
         )
+        raw_vector = [x for _, x in inputs]
+        build_flags.define("ADC_RAW_INPUT_VECTOR", utils.to_c_array(raw_vector))
+
+        # The external ADCs replace the MCU ADC backend of the driver
+        env.Append(SRC_FILTER=[f"-<hardware/{driver_name}/analog.c>"])
     case _:
         raise ValueError(f"Unsupported analog backend: {analog_backend}")
 
-build_flags.define("ADC_NUM_CHANNELS", len(driver.metadata.adc.input_pins))
 build_flags.define("ADC_RESOLUTION", utils.get_adc_resolution(kb_json, driver))
 
 if analog.get("invert_adc", False):
@@ -110,7 +161,8 @@ if "raw" in analog:
         "ADC_RAW_INPUT_CHANNELS",
         utils.to_c_array(driver.metadata.adc.to_adc_inputs(raw["input"])),
     )
-    build_flags.define("ADC_RAW_INPUT_VECTOR", utils.to_c_array(raw["vector"]))
+    raw_vector = raw["vector"]
+    build_flags.define("ADC_RAW_INPUT_VECTOR", utils.to_c_array(raw_vector))
 
 # Analog Multiplexer ADC Input Configuration
 if "mux" in analog:
@@ -127,9 +179,30 @@ if "mux" in analog:
     build_flags.define("ADC_MUX_SELECT_PORTS", utils.to_c_array(ports))
     build_flags.define("ADC_MUX_SELECT_PINS", utils.to_c_array(pin_nums))
 
-    build_flags.define(
-        "ADC_MUX_INPUT_MATRIX", utils.to_c_array(list(map(list, zip(*mux["matrix"]))))
-    )
+    mux_matrix = list(map(list, zip(*mux["matrix"])))
+    build_flags.define("ADC_MUX_INPUT_MATRIX", utils.to_c_array(mux_matrix))
+
+# Sample Store Kernel
+for name, value in utils.get_scan_kernel_defines(
+    kb_json["keyboard"]["num_keys"], mux_matrix, raw_vector
+).items():
+    build_flags.define(name, value)
+
+# Timer-Triggered ADC Sweep Configuration
+if "sweep_rate" in analog:
+    if analog_backend != "mcu_adc" or driver_name != "at32f405xx":
+        raise ValueError(
+            "analog.sweep_rate is only supported by the MCU ADC of the at32f405xx driver"
+        )
+    if "mux" in analog:
+        # The select patterns are written to one GPIO set/clear register
+        ports, _ = driver.metadata.adc.to_gpio_array(analog["mux"]["select"])
+        if len(set(ports)) > 1:
+            raise ValueError(
+                "analog.sweep_rate requires the multiplexer select pins to be on one GPIO port"
+            )
+
+    build_flags.define("ADC_SWEEP_RATE_HZ", analog["sweep_rate"])
 
 # Digital GPIO Input Configuration
 if "digital" in kb_json:
@@ -162,10 +235,17 @@ wl_backing_store_size = wl_virtual_size + wl_write_log_size
 
 build_flags.define("WL_VIRTUAL_SIZE", wl_virtual_size)
 build_flags.define("WL_WRITE_LOG_SIZE", wl_write_log_size)
+if wear_leveling.get("execute_in_place", False):
+    build_flags.define("WL_XIP_ENABLED")
+    build_flags.define("WL_CACHE_SIZE", wear_leveling.get("cache_size", 512))
+    build_flags.define(
+        "WL_OVERLAY_NUM_PAGES", wear_leveling.get("overlay_pages", 32)
+    )
 
-# Reserve flash for wear leveling (round up to whole sectors from the end)
+# Reserve flash for both wear leveling banks (each rounded up to whole sectors
+# from the end)
 wl_base_address = flash_size - driver.metadata.flash.round_up_to_flash_sectors(
-    wl_backing_store_size
+    wl_backing_store_size, utils.WL_NUM_BANKS
 )
 build_flags.define("WL_BASE_ADDRESS", wl_base_address)
 build_flags.linker_defsym("WL_BASE_ADDRESS", wl_base_address)
@@ -202,5 +282,49 @@ if "actuation" in kb_json:
     if "actuation_point" in actuation:
         build_flags.define("ACTUATION_POINT", actuation["actuation_point"])
 
+# RGB Output Configuration
+rgb = kb_json.get("rgb", {})
+if "gamma" in rgb:
+    build_flags.define("RGB_GAMMA", f"{float(rgb['gamma'])}f")
+if "white_balance" in rgb:
+    build_flags.define("RGB_WHITE_BALANCE", utils.to_c_array(rgb["white_balance"]))
+if "max_current_ma" in rgb:
+    build_flags.define("RGB_MAX_CURRENT_MA", rgb["max_current_ma"])
+if "led_channel_current_ma" in rgb:
+    build_flags.define("RGB_LED_CHANNEL_CURRENT_MA", rgb["led_channel_current_ma"])
+
+rgb_driver = rgb.get("driver", "ws2812")
+if rgb_driver in utils.I2C_LED_MATRIX_DEVICES:
+    if "i2c_matrix" not in rgb:
+        raise ValueError(f"rgb.i2c_matrix is required by rgb.driver='{rgb_driver}'")
+
+    i2c_matrix = rgb["i2c_matrix"]
+    device = utils.I2C_LED_MATRIX_DEVICES[rgb_driver]
+    addresses = i2c_matrix["addresses"]
+    leds = i2c_matrix["leds"]
+    if len(leds) != len(rgb["led_map"]):
+        raise ValueError("rgb.i2c_matrix.leds must have one entry for each LED of rgb.led_map")
+    for index, (led_device, *registers) in enumerate(leds):
+        if led_device >= len(addresses):
+            raise ValueError(f"LED {index} is on device {led_device}, which has no address")
+        for register in registers:
+            if register // 16 >= device["rows"] or register % 16 not in device["columns"]:
+                raise ValueError(
+                    f"LED {index} uses register {register:#04x}, which is not a PWM register of {rgb_driver}"
+                )
+
+    build_flags.define("RGB_DRIVER_I2C_MATRIX")
+    build_flags.define("RGB_I2C_MATRIX_BUS", i2c_matrix.get("bus", 0))
+    build_flags.define("RGB_I2C_MATRIX_FREQUENCY_HZ", i2c_matrix.get("frequency", 400000))
+    build_flags.define("RGB_I2C_MATRIX_ADDRESSES", utils.to_c_array(addresses))
+    build_flags.define("RGB_I2C_MATRIX_LED_MAP", utils.to_c_array(leds))
+    if "global_current" in i2c_matrix:
+        build_flags.define("RGB_I2C_MATRIX_GLOBAL_CURRENT", i2c_matrix["global_current"])
+
+    # The controllers replace the WS2812 driver of the MCU driver
+    env.Append(SRC_FILTER=[f"-<hardware/{driver_name}/rgb.c>"])
+elif rgb_driver != "ws2812":
+    raise ValueError(f"Unsupported RGB driver: {rgb_driver}")
+
 # Add source build flags
 env.Append(BUILD_FLAGS=build_flags.get_flags())
@@ -1,6 +1,7 @@
 #!/usr/bin/env python3
 
 import argparse
+import os
 import subprocess
 import sys
 from pathlib import Path
@@ -9,7 +10,15 @@ from pathlib import Path
 NATIVE_TEST_ENVS = [
     "native_test_advanced_keys",
     "native_test_analog_scan",
+    "native_test_analog_scan_kernel",
+    "native_test_analog_sweep",
+    "native_test_analog_spi_adc",
+    "native_test_analog_spi_adc_ad7490",
+    "native_test_commands",
+    "native_test_crc32",
     "native_test_deferred_actions",
+    "native_test_eeconfig",
+    "native_test_eeconfig_wide",
     "native_test_encoder",
     "native_test_event_pipeline",
     "native_test_hid",
@@ -18,16 +27,52 @@ NATIVE_TEST_ENVS = [
     "native_test_layout",
     "native_test_matrix",
     "native_test_migration",
+    "native_test_rapid_fire",
+    "native_test_rgb",
     "native_test_rgb_animated",
+    "native_test_rgb_golden",
+    "native_test_rgb_golden_sliced",
+    "native_test_rgb_i2c_matrix",
+    "native_test_rgb_power",
+    "native_test_rgb_stream",
     "native_test_stm32_rgb",
+    "native_test_spi_queue",
+    "native_test_timebase",
     "native_test_usb_runtime",
+    "native_test_wear_leveling",
+    "native_test_wear_leveling_large",
+    "native_test_wear_leveling_xip",
     "native_test_xinput",
 ]
 
+# Main loop stages checked against the cycle budget of the keyboard
+NATIVE_CYCLE_BUDGET_ENVS = [
+    "native_test_cycle_budget_input",
+    "native_test_cycle_budget_rgb",
+    "native_test_cycle_budget_storage",
+]
+
+NATIVE_BENCH_ENVS = [
+    "native_bench_analog_scan_he16",
+    "native_bench_analog_scan_he60",
+    "native_bench_analog_scan_he60-v2",
+    "native_bench_analog_scan_m256-whe",
+    "native_bench_analog_scan_mochiko39he",
+    "native_bench_analog_scan_mochiko40he",
+    "native_bench_crc32",
+    "native_bench_eeconfig",
+    "native_bench_flash_wear_at32f405xx",
+    "native_bench_flash_wear_at32f405xx_xip",
+    "native_bench_flash_wear_stm32f446xx",
+    "native_bench_layout",
+    "native_bench_rgb",
+    "native_bench_rgb_full_frame",
+]
 
-def run_command(cmd, cwd):
+
+def run_command(cmd, cwd, env=None):
     print("+", " ".join(cmd), flush=True)
-    subprocess.run(cmd, cwd=cwd, check=True)
+    subprocess.run(cmd, cwd=cwd, env=env, check=True)
 
 
 def main():
@@ -48,11 +93,22 @@ def main():
         action="store_true",
         help="Skip native unit test environments",
     )
+    parser.add_argument(
+        "--bench",
+        action="store_true",
+        help="Also run native benchmark environments",
+    )
     parser.add_argument(
         "--skip-build",
         action="store_true",
         help="Skip firmware build environments",
     )
+    parser.add_argument(
+        "--num-keys",
+        type=int,
+        help="Also run the native unit tests with this many keys, for example "
+        "300 for 16-bit key indices",
+    )
     args = parser.parse_args()
 
     repo_root = Path(__file__).resolve().parent.parent
@@ -63,6 +119,18 @@ def main():
     if not args.skip_native:
         for env in NATIVE_TEST_ENVS:
             run_command(["pio", "test", "-e", env], repo_root)
+        for env in NATIVE_CYCLE_BUDGET_ENVS:
+            run_command(["pio", "test", "-v", "-e", env], repo_root)
+
+    if not args.skip_native and args.num_keys is not None:
+        env = dict(os.environ)
+        env["PLATFORMIO_BUILD_FLAGS"] = f"-DNUM_KEYS={args.num_keys}"
+        for test_env in NATIVE_TEST_ENVS:
+            run_command(["pio", "test", "-e", test_env], repo_root, env)
+
+    if args.bench:
+        for env in NATIVE_BENCH_ENVS:
+            run_command(["pio", "test", "-v", "-e", env], repo_root)
 
     if not args.skip_build:
         for env in [args.keyboard, f"{args.keyboard}_recovery"]:
@@ -94,9 +94,54 @@ def to_slice_def(name: str, arr: list | bytes):
     return f"#define {name.upper()} {', '.join(str(x) for x in arr)}"
 
 
+# External ADCs supported by the `spi_adc` analog backend
+SPI_ADC_DEVICES = {
+    "ads7953": {"num_channels": 16, "resolution": 12},
+    "ad7490": {"num_channels": 16, "resolution": 12},
+}
+
+
+# LED matrix controllers supported by the I2C RGB driver. Their PWM registers
+# are numbered `row * 16 + column`, and only the listed columns exist.
+I2C_LED_MATRIX_DEVICES = {
+    "is31fl3733": {"rows": 12, "columns": list(range(16))},
+    "is31fl3737": {"rows": 12, "columns": [*range(6), *range(8, 14)]},
+}
+
+
+# Generate the sample store kernel of `analog_scan.c` for a board. The mux
+# matrix is indexed by mux channel then input, and the keys are numbered from 1
+# with 0 for no key, as in `ADC_MUX_INPUT_MATRIX` and `ADC_RAW_INPUT_VECTOR`.
+# Each mux channel stores the samples of its keys in key order, and inputs
+# without a key are left out.
+def get_scan_kernel_defines(num_keys: int, mux_matrix: list, raw_vector: list):
+    def stores(inputs):
+        connected = sorted(
+            (key - 1, input) for input, key in inputs if 0 < key <= num_keys
+        )
+        return " ".join(f"ANALOG_SCAN_STORE({input}, {key})" for key, input in connected)
+
+    defines = {}
+    num_mux_inputs = len(mux_matrix[0]) if mux_matrix else 0
+    if mux_matrix:
+        defines["ANALOG_SCAN_MUX_KERNEL"] = " ".join(
+            f"ANALOG_SCAN_MUX_CHANNEL({channel}, {stores(enumerate(keys))})"
+            for channel, keys in enumerate(mux_matrix)
+        )
+    if raw_vector:
+        defines["ANALOG_SCAN_RAW_KERNEL"] = stores(
+            (num_mux_inputs + i, key) for i, key in enumerate(raw_vector)
+        )
+
+    return defines
+
+
 # Get the ADC resolution, or default to the maximum resolution supported by the MCU
 def get_adc_resolution(kb_json: dict, driver: Driver):
-    return kb_json["analog"].get("adc_resolution", driver.metadata.adc.max_resolution)
+    analog = kb_json["analog"]
+    if analog.get("backend", "mcu_adc") == "spi_adc":
+        return SPI_ADC_DEVICES[analog["spi_adc"]["device"]]["resolution"]
+    return analog.get("adc_resolution", driver.metadata.adc.max_resolution)
 
 
 # Resolve per-profile default keymaps
@@ -101,14 +101,22 @@ if __name__ == "__main__":
             "build_flags": "\n".join([*flags, *(extra_flags or [])]),
         }
 
+    def scan_kernel_flags(num_keys, mux_matrix, raw_vector):
+        return [
+            f"-D{name}='{value}'"
+            for name, value in utils.get_scan_kernel_defines(
+                num_keys, mux_matrix, raw_vector
+            ).items()
+        ]
+
     # Native unit test environments
     common_test_flags = "-I include\n-include test/test_config.h"
     pio_config["env:native_test_advanced_keys"] = native_test_env(
         "test_advanced_keys",
         "+<advanced_keys.c> +<advanced_key_combo.c> "
         "+<advanced_key_dynamic_keystroke.c> +<advanced_key_macro.c> "
-        "+<advanced_key_null_bind.c> +<advanced_key_tap_hold.c> "
-        "+<advanced_key_toggle.c>",
+        "+<advanced_key_null_bind.c> +<advanced_key_rapid_fire.c> "
+        "+<advanced_key_tap_hold.c> +<advanced_key_toggle.c>",
     )
     pio_config["env:native_test_layout"] = native_test_env(
         "test_layout",
@@ -119,8 +127,10 @@ if __name__ == "__main__":
         "test_event_pipeline",
         "+<advanced_keys.c> +<advanced_key_combo.c> "
         "+<advanced_key_dynamic_keystroke.c> +<advanced_key_macro.c> "
-        "+<advanced_key_null_bind.c> +<advanced_key_tap_hold.c> "
-        "+<advanced_key_toggle.c> +<deferred_actions.c> +<layout.c>",
+        "+<advanced_key_null_bind.c> +<advanced_key_rapid_fire.c> "
+        "+<advanced_key_tap_hold.c> +<advanced_key_toggle.c> "
+        "+<deferred_actions.c> +<layout.c> "
+        "+<profile_runtime.c> +<hardware/native/timer.c>",
     )
     pio_config["env:native_test_hid"] = native_test_env(
         "test_hid",
@@ -141,6 +151,18 @@ if __name__ == "__main__":
             "-DUSBMON_DIAGNOSTIC_RAW_HID_STREAM=1",
         ],
     )
+    pio_config["env:native_test_rapid_fire"] = native_test_env(
+        "test_rapid_fire",
+        "+<advanced_keys.c> +<advanced_key_combo.c> "
+        "+<advanced_key_dynamic_keystroke.c> +<advanced_key_macro.c> "
+        "+<advanced_key_null_bind.c> +<advanced_key_rapid_fire.c> "
+        "+<advanced_key_tap_hold.c> +<advanced_key_toggle.c> +<hid.c>",
+        [
+            "-I test/test_hid",
+            "-DCFG_TUSB_MCU=0",
+            "-DBOARD_USB_FS=1",
+        ],
+    )
     pio_config["env:native_test_xinput"] = native_test_env(
         "test_xinput",
         "+<xinput.c>",
@@ -155,20 +177,176 @@ if __name__ == "__main__":
         "test_matrix",
         "+<matrix.c>",
     )
+    pio_config["env:native_test_crc32"] = native_test_env(
+        "test_crc32",
+        "+<crc32.c>",
+    )
+    pio_config["env:native_test_timebase"] = native_test_env(
+        "test_timebase",
+        "+<timebase.c>",
+    )
+    pio_config["env:native_bench_crc32"] = {
+        "platform": "native",
+        "test_framework": "unity",
+        "test_filter": "test_crc32_bench",
+        "test_build_src": "yes",
+        "build_src_filter": "+<crc32.c>",
+        "build_flags": "\n".join([common_test_flags, "-O2"]),
+    }
+    pio_config["env:native_bench_eeconfig"] = {
+        "platform": "native",
+        "test_framework": "unity",
+        "test_filter": "test_eeconfig_bench",
+        "test_build_src": "yes",
+        "build_src_filter": "+<eeconfig.c>",
+        "build_flags": "\n".join(
+            [
+                common_test_flags,
+                "-O2",
+                "-DNUM_PROFILES=16",
+                "-DRGB_ENABLED=1",
+                "-DJOYSTICK_ENABLED=1",
+            ]
+        ),
+    }
+    pio_config["env:native_bench_layout"] = {
+        "platform": "native",
+        "test_framework": "unity",
+        "test_filter": "test_layout_bench",
+        "test_build_src": "yes",
+        "build_src_filter": "+<advanced_keys.c> +<advanced_key_combo.c> "
+        "+<advanced_key_dynamic_keystroke.c> +<advanced_key_macro.c> "
+        "+<advanced_key_null_bind.c> +<advanced_key_rapid_fire.c> "
+        "+<advanced_key_tap_hold.c> +<advanced_key_toggle.c> "
+        "+<deferred_actions.c> +<layout.c> "
+        "+<profile_runtime.c> +<hardware/native/timer.c>",
+        "build_flags": "\n".join(
+            [common_test_flags, "-O2", "-DNUM_KEYS=64", "-DNUM_ADVANCED_KEYS=32"]
+        ),
+    }
+    pio_config["env:native_test_wear_leveling"] = native_test_env(
+        "test_wear_leveling",
+        "+<wear_leveling.c> +<flash.c> +<crc32.c> +<hardware/native/flash.c>",
+        [
+            "-DFLASH_NUM_SECTORS=16",
+            "-DFLASH_SECTOR_SIZE=4096",
+            "-DFLASH_EMPTY_VAL=0xFFFFFFFF",
+        ],
+    )
+    # Virtual storage beyond the 8 KB reach of the legacy write log format
+    pio_config["env:native_test_wear_leveling_large"] = native_test_env(
+        "test_wear_leveling",
+        "+<wear_leveling.c> +<flash.c> +<crc32.c> +<hardware/native/flash.c>",
+        [
+            "-DFLASH_SIZE=262144",
+            "-DFLASH_NUM_SECTORS=64",
+            "-DFLASH_SECTOR_SIZE=4096",
+            "-DFLASH_EMPTY_VAL=0xFFFFFFFF",
+            "-DWL_VIRTUAL_SIZE=32768",
+            "-DWL_WRITE_LOG_SIZE=4096",
+        ],
+    )
+    # Only the start of the virtual storage in RAM, with a small overlay so the
+    # tests fill it
+    pio_config["env:native_test_wear_leveling_xip"] = native_test_env(
+        "test_wear_leveling_xip",
+        "+<eeconfig.c> +<wear_leveling.c> +<flash.c> +<crc32.c> "
+        "+<hardware/native/flash.c>",
+        [
+            "-DFLASH_NUM_SECTORS=16",
+            "-DFLASH_SECTOR_SIZE=4096",
+            "-DFLASH_EMPTY_VAL=0xFFFFFFFF",
+            "-DWL_XIP_ENABLED",
+            "-DWL_CACHE_SIZE=1024",
+            "-DWL_OVERLAY_NUM_PAGES=8",
+        ],
+    )
+    # Simulated flash of each MCU
+    mcu_flash_flags = {
+        "at32f405xx": [
+            "-DFLASH_SIZE=262144",
+            "-DFLASH_NUM_SECTORS=128",
+            "-DFLASH_SECTOR_SIZE=2048",
+        ],
+        "stm32f446xx": [
+            "-DFLASH_SIZE=524288",
+            "-DFLASH_NUM_SECTORS=8",
+            "-DFLASH_SECTOR_SIZES='{16384, 16384, 16384, 16384, 65536, "
+            "131072, 131072, 131072}'",
+            "-DFLASH_SIM_ERASE_US_PER_KB=8000",
+            "-DFLASH_SIM_PROGRAM_WORD_US=16",
+        ],
+    }
+    # Configurator sessions replayed onto the simulated flash of each MCU
+    for env_name, flash_flags in (
+        ("native_bench_flash_wear_at32f405xx", mcu_flash_flags["at32f405xx"]),
+        # The same board with only the start of the virtual storage in RAM
+        (
+            "native_bench_flash_wear_at32f405xx_xip",
+            [*mcu_flash_flags["at32f405xx"], "-DWL_XIP_ENABLED"],
+        ),
+        ("native_bench_flash_wear_stm32f446xx", mcu_flash_flags["stm32f446xx"]),
+    ):
+        pio_config[f"env:{env_name}"] = {
+            "platform": "native",
+            "test_framework": "unity",
+            "test_filter": "test_flash_wear_bench",
+            "test_build_src": "yes",
+            "build_src_filter": "+<eeconfig.c> +<wear_leveling.c> +<flash.c> "
+            "+<crc32.c> +<hardware/native/flash.c>",
+            "build_flags": "\n".join(
+                [
+                    common_test_flags,
+                    "-O2",
+                    "-DRGB_ENABLED=1",
+                    "-DJOYSTICK_ENABLED=1",
+                    "-DFLASH_EMPTY_VAL=0xFFFFFFFF",
+                    "-DWL_WRITE_LOG_SIZE=65536",
+                    *flash_flags,
+                ]
+            ),
+        }
+    analog_scan_test_flags = [
+        "-DADC_NUM_CHANNELS=4",
+        "-DADC_NUM_MUX_INPUTS=2",
+        "-DADC_MUX_INPUT_CHANNELS='{0, 1}'",
+        "-DADC_NUM_MUX_SELECT_PINS=1",
+        "-DADC_MUX_SELECT_PORTS='{0}'",
+        "-DADC_MUX_SELECT_PINS='{0}'",
+        "-DADC_MUX_INPUT_MATRIX='{{1, 3}, {2, 0}}'",
+        "-DADC_NUM_RAW_INPUTS=2",
+        "-DADC_RAW_INPUT_CHANNELS='{0, 0}'",
+        "-DADC_RAW_INPUT_VECTOR='{4, 0}'",
+    ]
     pio_config["env:native_test_analog_scan"] = native_test_env(
         "test_analog_scan",
         "+<analog_scan.c>",
+        analog_scan_test_flags,
+    )
+    # The same tests with the sample store generated for the tables
+    pio_config["env:native_test_analog_scan_kernel"] = native_test_env(
+        "test_analog_scan",
+        "+<analog_scan.c>",
+        [
+            *analog_scan_test_flags,
+            *scan_kernel_flags(10, [[1, 3], [2, 0]], [4, 0]),
+        ],
+    )
+    pio_config["env:native_test_analog_sweep"] = native_test_env(
+        "test_analog_sweep",
+        "+<analog_scan.c> +<analog_sweep.c>",
         [
+            "-DADC_SWEEP_RATE_HZ=4000",
             "-DADC_NUM_CHANNELS=4",
             "-DADC_NUM_MUX_INPUTS=2",
             "-DADC_MUX_INPUT_CHANNELS='{0, 1}'",
-            "-DADC_NUM_MUX_SELECT_PINS=1",
-            "-DADC_MUX_SELECT_PORTS='{0}'",
-            "-DADC_MUX_SELECT_PINS='{0}'",
-            "-DADC_MUX_INPUT_MATRIX='{{1, 3}, {2, 0}}'",
-            "-DADC_NUM_RAW_INPUTS=2",
-            "-DADC_RAW_INPUT_CHANNELS='{0, 0}'",
-            "-DADC_RAW_INPUT_VECTOR='{4, 0}'",
+            "-DADC_NUM_MUX_SELECT_PINS=2",
+            "-DADC_MUX_SELECT_PORTS='{0, 0}'",
+            "-DADC_MUX_SELECT_PINS='{0x10, 0x20}'",
+            "-DADC_MUX_INPUT_MATRIX='{{1, 5}, {2, 6}, {3, 7}, {4, 8}}'",
+            "-DADC_NUM_RAW_INPUTS=1",
+            "-DADC_RAW_INPUT_CHANNELS='{2}'",
+            "-DADC_RAW_INPUT_VECTOR='{9}'",
         ],
     )
     pio_config["env:native_test_commands"] = native_test_env(
@@ -181,6 +359,26 @@ if __name__ == "__main__":
             "-DRGB_ENABLED=1",
         ],
     )
+    pio_config["env:native_test_eeconfig"] = native_test_env(
+        "test_eeconfig",
+        "+<eeconfig.c>",
+        [
+            "-DNUM_PROFILES=16",
+            "-DRGB_ENABLED=1",
+            "-DJOYSTICK_ENABLED=1",
+        ],
+    )
+    # A keyboard with 16-bit key indices resets any earlier configuration
+    pio_config["env:native_test_eeconfig_wide"] = native_test_env(
+        "test_eeconfig",
+        "+<eeconfig.c> +<migration.c>",
+        [
+            "-DNUM_KEYS=300",
+            "-DNUM_PROFILES=16",
+            "-DRGB_ENABLED=1",
+            "-DJOYSTICK_ENABLED=1",
+        ],
+    )
     pio_config["env:native_test_migration"] = native_test_env(
         "test_migration",
         "+<migration.c>",
@@ -232,6 +430,187 @@ if __name__ == "__main__":
         "build_src_filter": "+<rgb.c>",
         "build_flags": "\n".join(rgb_test_flags),
     }
+    pio_config["env:native_test_rgb_stream"] = {
+        "platform": "native",
+        "test_framework": "unity",
+        "test_filter": "test_rgb_stream",
+        "test_build_src": "yes",
+        "build_src_filter": "+<rgb_stream.c>",
+        "build_flags": "\n".join(rgb_test_flags),
+    }
+    # Golden images of every effect, rendered whole and one 3-LED slice per
+    # `rgb_task()` call, which must produce the same frames
+    for env_name, extra_flags in (
+        ("native_test_rgb_golden", []),
+        (
+            "native_test_rgb_golden_sliced",
+            ["-DRGB_RENDER_CYCLE_BUDGET=0", "-DRGB_RENDER_CHUNK_LEDS=3"],
+        ),
+    ):
+        pio_config[f"env:{env_name}"] = {
+            "platform": "native",
+            "test_framework": "unity",
+            "test_filter": "test_rgb_golden",
+            "test_build_src": "yes",
+            "build_src_filter": "+<rgb.c> +<rgb_animated.c> +<rgb_reactive.c> "
+            "+<rgb_static.c> +<rgb_stream.c>",
+            "build_flags": "\n".join([*rgb_test_flags, "-lm", *extra_flags]),
+        }
+    # Output stage with gamma, white balance and a current budget, checked
+    # against every effect
+    pio_config["env:native_test_rgb_power"] = {
+        "platform": "native",
+        "test_framework": "unity",
+        "test_filter": "test_rgb_power",
+        "test_build_src": "yes",
+        "build_src_filter": "+<rgb.c> +<rgb_animated.c> +<rgb_reactive.c> "
+        "+<rgb_static.c> +<rgb_stream.c>",
+        "build_flags": "\n".join(
+            [
+                *rgb_test_flags,
+                "-lm",
+                "-DRGB_GAMMA=2.2f",
+                "-DRGB_WHITE_BALANCE='{255, 200, 180}'",
+                "-DRGB_MAX_CURRENT_MA=500",
+                "-DRGB_LED_CHANNEL_CURRENT_MA=20",
+            ]
+        ),
+    }
+    # Host benchmarks of the worst single `rgb_task()` call and the worst frame
+    # per effect, with time-sliced rendering and with whole-frame rendering for
+    # comparison
+    for env_name, extra_flags in (
+        ("native_bench_rgb", []),
+        ("native_bench_rgb_full_frame", ["-DRGB_RENDER_CHUNK_LEDS=NUM_LEDS"]),
+    ):
+        pio_config[f"env:{env_name}"] = {
+            "platform": "native",
+            "test_framework": "unity",
+            "test_filter": "test_rgb_bench",
+            "test_build_src": "yes",
+            "build_src_filter": "+<rgb.c> +<rgb_animated.c> +<rgb_reactive.c> "
+            "+<rgb_static.c> +<rgb_stream.c>",
+            "build_flags": "\n".join(
+                [*rgb_test_flags, "-lm", "-DRGB_RENDER_CYCLE_BUDGET=0", *extra_flags]
+            ),
+        }
+    # Host benchmarks of the generic and generated sample stores with the
+    # tables of each keyboard
+    for bench_keyboard in sorted(keyboards):
+        bench_kb_json = utils.get_kb_json(bench_keyboard)
+        analog = bench_kb_json["analog"]
+        if analog.get("backend", "mcu_adc") != "mcu_adc":
+            continue
+
+        num_keys = bench_kb_json["keyboard"]["num_keys"]
+        mux_matrix = []
+        raw_vector = []
+        # Only the tables matter, so the inputs are numbered from channel 0
+        # and the select pins are left unassigned
+        bench_flags = [common_test_flags, "-O2", f"-DNUM_KEYS={num_keys}"]
+        if "mux" in analog:
+            mux = analog["mux"]
+            mux_matrix = list(map(list, zip(*mux["matrix"])))
+            bench_flags += [
+                f"-DADC_NUM_MUX_INPUTS={len(mux['input'])}",
+                f"-DADC_MUX_INPUT_CHANNELS='{utils.to_c_array(list(range(len(mux['input']))))}'",
+                f"-DADC_NUM_MUX_SELECT_PINS={len(mux['select'])}",
+                f"-DADC_MUX_SELECT_PORTS='{utils.to_c_array([0] * len(mux['select']))}'",
+                f"-DADC_MUX_SELECT_PINS='{utils.to_c_array([0] * len(mux['select']))}'",
+                f"-DADC_MUX_INPUT_MATRIX='{utils.to_c_array(mux_matrix)}'",
+            ]
+        if "raw" in analog:
+            raw_vector = analog["raw"]["vector"]
+            bench_flags += [
+                f"-DADC_RAW_INPUT_CHANNELS='{utils.to_c_array([0] * len(raw_vector))}'",
+                f"-DADC_RAW_INPUT_VECTOR='{utils.to_c_array(raw_vector)}'",
+            ]
+        num_mux_inputs = len(analog.get("mux", {}).get("input", []))
+        bench_flags += [
+            f"-DADC_NUM_RAW_INPUTS={len(raw_vector)}",
+            f"-DADC_NUM_CHANNELS={num_mux_inputs + len(raw_vector)}",
+        ]
+
+        pio_config[f"env:native_bench_analog_scan_{bench_keyboard}"] = {
+            "platform": "native",
+            "test_framework": "unity",
+            "test_filter": "test_analog_scan_bench",
+            "test_build_src": "yes",
+            "build_src_filter": "+<analog_scan.c>",
+            "build_flags": "\n".join(
+                [*bench_flags, *scan_kernel_flags(num_keys, mux_matrix, raw_vector)]
+            ),
+        }
+    # Main loop stages driven with worst case inputs, checked against the cycle
+    # budget of the selected keyboard
+    kb_json = utils.get_kb_json(keyboard)
+    cycle_budget_flags = [
+        "-O2",
+        "-DLOOP_PROFILE_ENABLED",
+        "-DCYCLE_BUDGET='{%s}'"
+        % ", ".join(
+            f"[LOOP_STAGE_{stage.upper()}] = {cycles}"
+            for stage, cycles in kb_json.get("cycle_budget", {}).items()
+        ),
+    ]
+    pio_config["env:native_test_cycle_budget_input"] = native_test_env(
+        "test_cycle_budget",
+        "+<advanced_keys.c> +<advanced_key_combo.c> "
+        "+<advanced_key_dynamic_keystroke.c> +<advanced_key_macro.c> "
+        "+<advanced_key_null_bind.c> +<advanced_key_rapid_fire.c> "
+        "+<advanced_key_tap_hold.c> +<advanced_key_toggle.c> "
+        "+<deferred_actions.c> +<layout.c> "
+        "+<loop_profile.c> +<matrix.c> +<profile_runtime.c> "
+        "+<hardware/native/timer.c>",
+        [
+            *cycle_budget_flags,
+            "-DCYCLE_BUDGET_HARNESS_INPUT",
+            f"-DNUM_KEYS={kb_json['keyboard']['num_keys']}",
+            f"-DNUM_LAYERS={kb_json['keyboard']['num_layers']}",
+            f"-DNUM_ADVANCED_KEYS={kb_json['keyboard']['num_advanced_keys']}",
+        ],
+    )
+    # The coordinates of the RGB tests stand in for those of the keyboard,
+    # since the cost of a call is bounded by the LEDs rendered per call
+    pio_config["env:native_test_cycle_budget_rgb"] = {
+        "platform": "native",
+        "test_framework": "unity",
+        "test_filter": "test_cycle_budget",
+        "test_build_src": "yes",
+        "build_src_filter": "+<loop_profile.c> +<rgb.c> +<rgb_animated.c> "
+        "+<rgb_reactive.c> +<rgb_static.c> +<rgb_stream.c>",
+        "build_flags": "\n".join(
+            [
+                *rgb_test_flags,
+                "-lm",
+                *cycle_budget_flags,
+                "-DCYCLE_BUDGET_HARNESS_RGB",
+            ]
+        ),
+    }
+    wear_leveling = kb_json.get("wear_leveling", {})
+    storage_flags = [
+        *mcu_flash_flags[kb_json["hardware"]["driver"]],
+        "-DFLASH_EMPTY_VAL=0xFFFFFFFF",
+        f"-DWL_VIRTUAL_SIZE={wear_leveling.get('virtual_size', 8192)}",
+        f"-DWL_WRITE_LOG_SIZE={wear_leveling.get('write_log_size', 65536)}",
+    ]
+    if wear_leveling.get("execute_in_place", False):
+        storage_flags += [
+            "-DWL_XIP_ENABLED",
+            f"-DWL_CACHE_SIZE={wear_leveling.get('cache_size', 512)}",
+            f"-DWL_OVERLAY_NUM_PAGES={wear_leveling.get('overlay_pages', 32)}",
+        ]
+    pio_config["env:native_test_cycle_budget_storage"] = native_test_env(
+        "test_cycle_budget",
+        "+<crc32.c> +<flash.c> +<loop_profile.c> +<wear_leveling.c> "
+        "+<hardware/native/flash.c>",
+        [
+            *cycle_budget_flags,
+            "-DCYCLE_BUDGET_HARNESS_STORAGE",
+            *storage_flags,
+        ],
+    )
     pio_config["env:native_test_encoder"] = native_test_env(
         "test_encoder",
         "+<encoder.c>",
@@ -262,6 +641,58 @@ if __name__ == "__main__":
             "-DRGB_DATA_PIN=GPIO_PIN_8",
         ],
     )
+    spi_adc_test_flags = [
+        "-DANALOG_BACKEND_SPI_ADC",
+        "-DSPI_NUM_BUSES=1",
+        "-DSPI_ADC_BUS=0",
+        "-DSPI_ADC_NUM_DEVICES=2",
+        "-DSPI_ADC_CS_PORTS='{NULL, NULL}'",
+        "-DSPI_ADC_CS_PINS='{1, 2}'",
+        "-DADC_NUM_CHANNELS=32",
+        "-DADC_NUM_RAW_INPUTS=10",
+        "-DADC_RAW_INPUT_CHANNELS='{0, 1, 2, 5, 6, 19, 20, 25, 28, 31}'",
+        "-DADC_RAW_INPUT_VECTOR='{1, 2, 3, 4, 5, 6, 7, 8, 0, 9}'",
+    ]
+    pio_config["env:native_test_analog_spi_adc"] = native_test_env(
+        "test_analog_spi_adc",
+        "+<analog_scan.c> +<analog_spi_adc.c> +<spi_queue.c>",
+        [
+            *spi_adc_test_flags,
+            "-DSPI_ADC_DEVICE_ADS7953",
+            "-DSPI_ADC_FREQUENCY_HZ=16000000",
+        ],
+    )
+    pio_config["env:native_test_analog_spi_adc_ad7490"] = native_test_env(
+        "test_analog_spi_adc",
+        "+<analog_scan.c> +<analog_spi_adc.c> +<spi_queue.c>",
+        [
+            *spi_adc_test_flags,
+            "-DSPI_ADC_DEVICE_AD7490",
+            "-DSPI_ADC_FREQUENCY_HZ=20000000",
+        ],
+    )
+    pio_config["env:native_test_rgb_i2c_matrix"] = native_test_env(
+        "test_rgb_i2c_matrix",
+        "+<i2c_queue.c> +<rgb_i2c_matrix.c>",
+        [
+            "-DRGB_ENABLED=1",
+            "-DRGB_DRIVER_I2C_MATRIX",
+            "-DNUM_LEDS=6",
+            "-DI2C_NUM_BUSES=1",
+            "-DRGB_I2C_MATRIX_BUS=0",
+            "-DRGB_I2C_MATRIX_GLOBAL_CURRENT=0x80",
+            "-DRGB_I2C_MATRIX_ADDRESSES='{0x50, 0x53}'",
+            "-DRGB_I2C_MATRIX_LED_MAP='{{0, 0x10, 0x00, 0x20}, "
+            "{0, 0x11, 0x01, 0x21}, {0, 0x12, 0x02, 0x22}, "
+            "{0, 0x16, 0x06, 0x26}, {1, 0x45, 0x35, 0x55}, "
+            "{1, 0x46, 0x36, 0x56}}'",
+        ],
+    )
+    pio_config["env:native_test_spi_queue"] = native_test_env(
+        "test_spi_queue",
+        "+<spi_queue.c>",
+        ["-DSPI_NUM_BUSES=2"],
+    )
     pio_config["env:native_test_usb_runtime"] = native_test_env(
         "test_usb_runtime",
         "+<usb_runtime.c>",
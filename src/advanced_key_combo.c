@@ -25,12 +25,14 @@
 
 #define COMBO_QUEUE_SIZE 16
 #define DEFAULT_COMBO_TERM 50
-#define COMBO_KEY_NONE 255
+// Layer of the combo key bitmap when it has to be rebuilt
+#define COMBO_LAYER_NONE UINT8_MAX
 
 typedef struct {
-  uint8_t key;
+  key_index_t key;
   bool pressed;
-  uint32_t time;
+  // Time in microseconds
+  uint64_t time;
   // Whether the event has been consumed by a combo match.
   bool consumed;
 } combo_event_t;
@@ -44,7 +46,7 @@ static bool flush_in_progress;
 
 // Bit N is set when key N participates in any combo on the current layer.
 static uint8_t combo_key_bitmap[(NUM_KEYS + 7) / 8];
-static uint8_t combo_key_bitmap_layer = COMBO_KEY_NONE;
+static uint8_t combo_key_bitmap_layer = COMBO_LAYER_NONE;
 
 static uint16_t combo_term_ms(const advanced_key_t *ak) {
   return ak->combo.term > 0 ? ak->combo.term : DEFAULT_COMBO_TERM;
@@ -54,7 +56,7 @@ static int combo_key_count(const advanced_key_t *ak) {
   int count = 0;
 
   for (int k = 0; k < 4; k++) {
-    if (ak->combo.keys[k] != COMBO_KEY_NONE && ak->combo.keys[k] < NUM_KEYS)
+    if (ak->combo.keys[k] != KEY_INDEX_NONE && ak->combo.keys[k] < NUM_KEYS)
       count++;
   }
 
@@ -73,7 +75,7 @@ static void combo_key_bitmap_rebuild(uint8_t layer) {
       continue;
 
     for (int k = 0; k < 4; k++) {
-      const uint8_t key = ak->combo.keys[k];
+      const key_index_t key = ak->combo.keys[k];
       if (key >= NUM_KEYS)
         continue;
 
@@ -84,7 +86,7 @@ static void combo_key_bitmap_rebuild(uint8_t layer) {
   combo_key_bitmap_layer = layer;
 }
 
-static bool is_key_in_any_combo(uint8_t key) {
+static bool is_key_in_any_combo(key_index_t key) {
   if (key >= NUM_KEYS)
     return false;
 
@@ -98,7 +100,7 @@ static combo_event_t *queue_peek(uint8_t offset) {
   return &event_queue[(queue_head + offset) % COMBO_QUEUE_SIZE];
 }
 
-static bool queue_has_unconsumed_press(uint8_t key) {
+static bool queue_has_unconsumed_press(key_index_t key) {
   for (uint8_t i = 0; i < queue_count; i++) {
     combo_event_t *ev = queue_peek(i);
     if (!ev || ev->consumed)
@@ -120,7 +122,7 @@ static void queue_pop(void) {
 
 static void flush_events(uint8_t count_to_flush);
 
-static void queue_push(uint8_t key, bool pressed, uint32_t time) {
+static void queue_push(key_index_t key, bool pressed, uint64_t time) {
   if (queue_count >= COMBO_QUEUE_SIZE) {
     // Try to free one slot first so overflow does not silently corrupt order.
     flush_events(1);
@@ -161,11 +163,11 @@ static void flush_events(uint8_t count_to_flush) {
 // 0 = no match
 // 1 = candidate (partial match still within term)
 // 2 = full match
-static int check_combo_match(const advanced_key_t *ak, uint32_t current_time) {
+static int check_combo_match(const advanced_key_t *ak, uint64_t current_time) {
   int keys_found = 0;
   const int keys_required = combo_key_count(ak);
   bool active_part[4] = {0};
-  uint32_t key_times[4] = {0};
+  uint64_t key_times[4] = {0};
 
   if (keys_required == 0)
     return 0;
@@ -197,11 +199,11 @@ static int check_combo_match(const advanced_key_t *ak, uint32_t current_time) {
       keys_found++;
   }
 
-  const uint16_t term = combo_term_ms(ak);
+  const uint32_t term = combo_term_ms(ak) * 1000u;
 
   if (keys_found == keys_required) {
-    uint32_t min_t = 0;
-    uint32_t max_t = 0;
+    uint64_t min_t = 0;
+    uint64_t max_t = 0;
     bool first = true;
 
     for (int k = 0; k < 4; k++) {
@@ -224,7 +226,7 @@ static int check_combo_match(const advanced_key_t *ak, uint32_t current_time) {
   }
 
   if (keys_found > 0) {
-    uint32_t min_t = 0;
+    uint64_t min_t = 0;
     bool first = true;
 
     for (int k = 0; k < 4; k++) {
@@ -275,7 +277,7 @@ static void execute_combo_match(const advanced_key_t *ak) {
   flush_events(queue_count);
 }
 
-static void process_combo_logic(uint32_t current_time) {
+static void process_combo_logic(uint64_t current_time) {
   const uint8_t current_layer = layout_get_current_layer();
   const advanced_key_t *best_match = NULL;
   int best_match_len = 0;
@@ -310,7 +312,7 @@ static void process_combo_logic(uint32_t current_time) {
   if (best_match) {
     combo_event_t *head = queue_peek(0);
     if (pending_candidates && head &&
-        (current_time - head->time) <= max_pending_term)
+        (current_time - head->time) <= max_pending_term * 1000u)
       return;
 
     execute_combo_match(best_match);
@@ -319,7 +321,7 @@ static void process_combo_logic(uint32_t current_time) {
 
   if (pending_candidates) {
     combo_event_t *head = queue_peek(0);
-    if (head && (current_time - head->time) > max_pending_term)
+    if (head && (current_time - head->time) > max_pending_term * 1000u)
       flush_events(1);
     return;
   }
@@ -335,10 +337,10 @@ void advanced_key_combo_clear(void) {
   flush_in_progress = false;
   memset(event_queue, 0, sizeof(event_queue));
   memset(combo_key_bitmap, 0, sizeof(combo_key_bitmap));
-  combo_key_bitmap_layer = COMBO_KEY_NONE;
+  combo_key_bitmap_layer = COMBO_LAYER_NONE;
 }
 
-bool advanced_key_combo_process(uint8_t key, bool pressed, uint32_t time) {
+bool advanced_key_combo_process(key_index_t key, bool pressed, uint64_t time) {
   const uint8_t current_layer = layout_get_current_layer();
 
   combo_key_bitmap_rebuild(current_layer);
@@ -377,11 +379,11 @@ bool advanced_key_combo_task(void) {
   pending_activity = false;
 
   if (queue_count > 0)
-    process_combo_logic(timer_read());
+    process_combo_logic(timer_read_us());
 
   return pending_activity;
 }
 
 void advanced_key_combo_invalidate_cache(void) {
-  combo_key_bitmap_layer = COMBO_KEY_NONE;
+  combo_key_bitmap_layer = COMBO_LAYER_NONE;
 }
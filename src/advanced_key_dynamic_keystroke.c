@@ -27,7 +27,7 @@ static bitmap_t dks_rt_disabled_keys[BITMAP_SIZE(NUM_KEYS)] = {0};
 void advanced_key_dynamic_keystroke_clear(void) {
   for (uint32_t key = 0; key < NUM_KEYS; key++) {
     if (bitmap_get(dks_rt_disabled_keys, key))
-      matrix_disable_rapid_trigger((uint8_t)key, false);
+      matrix_disable_rapid_trigger((key_index_t)key, false);
   }
 
   memset(dks_rt_disabled_keys, 0, sizeof(dks_rt_disabled_keys));
@@ -23,13 +23,21 @@
 #define MACRO_RELEASE_GAP_MS 15U
 #define MACRO_DELAY_UNIT_MS 10U
 
+// Number of macros being played, so that a key press only walks the advanced
+// keys to abort them when there is one
+static uint8_t num_playing;
+
 static void advanced_key_macro_stop(ak_state_macro_t *state) {
+  if (state->is_playing)
+    num_playing--;
   state->is_playing = false;
 }
 
 static void advanced_key_macro_start(ak_state_macro_t *state) {
   state->event_index = 0;
-  state->delay_until = timer_read();
+  state->delay_until = timer_read_us();
+  if (!state->is_playing)
+    num_playing++;
   state->is_playing = true;
   state->is_tapping = false;
 }
@@ -40,7 +48,7 @@ static bool advanced_key_macro_release_tap(ak_state_macro_t *state) {
 
   input_keycode_release(state->tap_keycode);
   state->is_tapping = false;
-  state->delay_until = timer_read() + MACRO_RELEASE_GAP_MS;
+  state->delay_until = timer_read_us() + MACRO_RELEASE_GAP_MS * 1000u;
   return true;
 }
 
@@ -55,22 +63,22 @@ static bool advanced_key_macro_execute_event(const macro_event_t *event,
     input_keycode_press(event->keycode);
     state->tap_keycode = event->keycode;
     state->is_tapping = true;
-    state->delay_until = timer_read() + MACRO_TAP_HOLD_MS;
+    state->delay_until = timer_read_us() + MACRO_TAP_HOLD_MS * 1000u;
     return true;
 
   case MACRO_ACTION_PRESS:
     input_keycode_press(event->keycode);
-    state->delay_until = timer_read() + MACRO_TAP_HOLD_MS;
+    state->delay_until = timer_read_us() + MACRO_TAP_HOLD_MS * 1000u;
     return true;
 
   case MACRO_ACTION_RELEASE:
     input_keycode_release(event->keycode);
-    state->delay_until = timer_read() + MACRO_RELEASE_GAP_MS;
+    state->delay_until = timer_read_us() + MACRO_RELEASE_GAP_MS * 1000u;
     return true;
 
   case MACRO_ACTION_DELAY:
-    state->delay_until =
-        timer_read() + ((uint32_t)event->keycode * MACRO_DELAY_UNIT_MS);
+    state->delay_until = timer_read_us() + (uint32_t)event->keycode *
+                                               MACRO_DELAY_UNIT_MS * 1000u;
     return true;
 
   default:
@@ -78,7 +86,12 @@ static bool advanced_key_macro_execute_event(const macro_event_t *event,
   }
 }
 
+void advanced_key_macro_clear(void) { num_playing = 0; }
+
 void advanced_key_macro_abort_all(advanced_key_state_t *states) {
+  if (num_playing == 0)
+    return;
+
   for (uint8_t i = 0; i < NUM_ADVANCED_KEYS; i++) {
     if (CURRENT_PROFILE.advanced_keys[i].type != AK_TYPE_MACRO)
       continue;
@@ -113,7 +126,7 @@ void advanced_key_macro_process(const advanced_key_event_t *event,
 }
 
 void advanced_key_macro_tick(const advanced_key_t *ak, ak_state_macro_t *state) {
-  if (!state->is_playing || timer_read() < state->delay_until)
+  if (!state->is_playing || timer_read_us() < state->delay_until)
     return;
 
   if (advanced_key_macro_release_tap(state))
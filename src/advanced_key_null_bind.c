@@ -26,7 +26,7 @@ void advanced_key_null_bind_process(const advanced_key_event_t *event,
       &CURRENT_PROFILE.advanced_keys[event->ak_index].null_bind;
   ak_state_null_bind_t *state = &states[event->ak_index].null_bind;
 
-  const uint8_t keys[] = {
+  const key_index_t keys[] = {
       CURRENT_PROFILE.advanced_keys[event->ak_index].key,
       null_bind->secondary_key,
   };
@@ -0,0 +1,118 @@
+/*
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "advanced_key_rapid_fire.h"
+
+#include "eeconfig.h"
+#include "hid.h"
+#include "layout.h"
+#include "matrix.h"
+
+// Number of Rapid Fire keys being held, so that the keyboard reports are only
+// kept going and walked while there is one
+static uint8_t num_active;
+
+/**
+ * @brief Get the number of keyboard reports to hold the keycode released
+ *
+ * @param ak Rapid Fire advanced key
+ *
+ * @return Number of keyboard reports, at least 1
+ */
+static uint32_t advanced_key_rapid_fire_release_reports(
+    const advanced_key_t *ak) {
+  const rapid_fire_t *rapid_fire = &ak->rapid_fire;
+  uint32_t reports = rapid_fire->release_reports;
+
+  if (rapid_fire->bottom_out_release_reports != 0) {
+    const uint32_t distance = key_matrix[ak->key].distance;
+    const uint32_t bottom_out = rapid_fire->bottom_out_release_reports;
+
+    if (bottom_out >= reports)
+      reports += ((bottom_out - reports) * distance + 127u) / 255u;
+    else
+      reports -= ((reports - bottom_out) * distance + 127u) / 255u;
+  }
+
+  return M_MAX(reports, 1u);
+}
+
+void advanced_key_rapid_fire_clear(void) {
+  num_active = 0;
+  hid_set_keyboard_report_clock(false);
+}
+
+void advanced_key_rapid_fire_process(const advanced_key_event_t *event,
+                                     advanced_key_state_t *states) {
+  const rapid_fire_t *rapid_fire =
+      &CURRENT_PROFILE.advanced_keys[event->ak_index].rapid_fire;
+  ak_state_rapid_fire_t *state = &states[event->ak_index].rapid_fire;
+
+  switch (event->type) {
+  case AK_EVENT_TYPE_PRESS:
+    if (state->is_active)
+      break;
+    layout_register(event->key, rapid_fire->keycode);
+    state->reports = 0;
+    state->is_active = true;
+    state->is_pressed = true;
+    if (num_active++ == 0)
+      // The keycode is toggled on report completions, so the keyboard reports
+      // must be sent even while the keycode is held
+      hid_set_keyboard_report_clock(true);
+    break;
+
+  case AK_EVENT_TYPE_RELEASE:
+    if (!state->is_active)
+      break;
+    if (state->is_pressed)
+      layout_unregister(event->key, rapid_fire->keycode);
+    state->is_active = false;
+    state->is_pressed = false;
+    if (--num_active == 0)
+      hid_set_keyboard_report_clock(false);
+    break;
+
+  default:
+    break;
+  }
+}
+
+void advanced_key_rapid_fire_report_complete(advanced_key_state_t *states) {
+  if (num_active == 0)
+    return;
+
+  for (uint32_t i = 0; i < NUM_ADVANCED_KEYS; i++) {
+    const advanced_key_t *ak = &CURRENT_PROFILE.advanced_keys[i];
+    ak_state_rapid_fire_t *state = &states[i].rapid_fire;
+
+    if (ak->type != AK_TYPE_RAPID_FIRE || !state->is_active)
+      continue;
+
+    const uint32_t limit = state->is_pressed
+                               ? M_MAX(ak->rapid_fire.press_reports, 1u)
+                               : advanced_key_rapid_fire_release_reports(ak);
+    if (++state->reports < limit)
+      continue;
+
+    state->reports = 0;
+    state->is_pressed = !state->is_pressed;
+    if (state->is_pressed)
+      layout_register(ak->key, ak->rapid_fire.keycode);
+    else
+      layout_unregister(ak->key, ak->rapid_fire.keycode);
+  }
+}
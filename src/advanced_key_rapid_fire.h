@@ -0,0 +1,8 @@
+#pragma once
+
+#include "advanced_keys.h"
+
+void advanced_key_rapid_fire_clear(void);
+void advanced_key_rapid_fire_process(const advanced_key_event_t *event,
+                                     advanced_key_state_t *states);
+void advanced_key_rapid_fire_report_complete(advanced_key_state_t *states);
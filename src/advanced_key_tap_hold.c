@@ -21,10 +21,22 @@
 #include "keycodes.h"
 #include "layout.h"
 
-static uint32_t last_tap_hold_tap_time[NUM_ADVANCED_KEYS];
-static uint32_t last_non_mod_key_time;
+// Times in microseconds
+static uint64_t last_tap_hold_tap_time[NUM_ADVANCED_KEYS];
+static uint64_t last_non_mod_key_time;
+// Number of Tap-Hold keys in `TAP_HOLD_STAGE_TAP`, so that the layout can check
+// for undecided keys without walking the advanced keys
+static uint8_t num_undecided;
+
+static void tap_hold_set_stage(ak_state_tap_hold_t *state, uint8_t stage) {
+  if (state->stage == TAP_HOLD_STAGE_TAP)
+    num_undecided--;
+  if (stage == TAP_HOLD_STAGE_TAP)
+    num_undecided++;
+  state->stage = stage;
+}
 
-static void tap_hold_register_tap(uint8_t key, uint8_t keycode) {
+static void tap_hold_register_tap(key_index_t key, uint8_t keycode) {
   deferred_action_t deferred_action = {
       .type = DEFERRED_ACTION_TYPE_RELEASE,
       .key = key,
@@ -36,7 +48,7 @@ static void tap_hold_register_tap(uint8_t key, uint8_t keycode) {
 }
 
 static void tap_hold_record_tap(uint8_t ak_index) {
-  last_tap_hold_tap_time[ak_index] = timer_read();
+  last_tap_hold_tap_time[ak_index] = timer_read_us();
 }
 
 static uint16_t tap_hold_double_tap_window(const tap_hold_t *tap_hold) {
@@ -48,7 +60,8 @@ static bool tap_hold_should_resolve_as_hold(const tap_hold_t *tap_hold,
                                             const ak_state_tap_hold_t *state,
                                             bool has_non_tap_hold_press) {
   const uint8_t flavor = TH_GET_FLAVOR(tap_hold->flags);
-  const bool expired = timer_elapsed(state->since) >= tap_hold->tapping_term;
+  const bool expired =
+      timer_elapsed_us(state->since) >= tap_hold->tapping_term * 1000u;
 
   switch (flavor) {
   case TAP_HOLD_FLAVOR_HOLD_PREFERRED:
@@ -77,27 +90,28 @@ static void tap_hold_handle_press(const advanced_key_event_t *event,
 
   if (state->stage == TAP_HOLD_STAGE_DOUBLE_TAP_WAIT) {
     tap_hold_register_tap(event->key, tap_hold->double_tap_keycode);
-    state->stage = TAP_HOLD_STAGE_QUICK_TAP;
+    tap_hold_set_stage(state, TAP_HOLD_STAGE_QUICK_TAP);
     return;
   }
 
   if (tap_hold->require_prior_idle_ms > 0 &&
-      (timer_read() - last_non_mod_key_time) < tap_hold->require_prior_idle_ms) {
+      timer_elapsed_us(last_non_mod_key_time) <
+          tap_hold->require_prior_idle_ms * 1000u) {
     tap_hold_register_tap(event->key, tap_hold->tap_keycode);
-    state->stage = TAP_HOLD_STAGE_NONE;
+    tap_hold_set_stage(state, TAP_HOLD_STAGE_NONE);
     return;
   }
 
   if (!has_double_tap && tap_hold->quick_tap_ms > 0 &&
-      (timer_read() - last_tap_hold_tap_time[event->ak_index]) <
-          tap_hold->quick_tap_ms) {
+      timer_elapsed_us(last_tap_hold_tap_time[event->ak_index]) <
+          tap_hold->quick_tap_ms * 1000u) {
     layout_register(event->key, tap_hold->tap_keycode);
-    state->stage = TAP_HOLD_STAGE_QUICK_TAP;
+    tap_hold_set_stage(state, TAP_HOLD_STAGE_QUICK_TAP);
     return;
   }
 
-  state->since = timer_read();
-  state->stage = TAP_HOLD_STAGE_TAP;
+  state->since = timer_read_us();
+  tap_hold_set_stage(state, TAP_HOLD_STAGE_TAP);
   state->interrupted = false;
   state->other_key_released = false;
 
@@ -114,17 +128,19 @@ static void tap_hold_handle_release(const advanced_key_event_t *event,
   const bool retro = TH_GET_RETRO_TAPPING(tap_hold->flags);
 
   if (state->stage == TAP_HOLD_STAGE_TAP) {
+    const bool expired =
+        timer_elapsed_us(state->since) >= tap_hold->tapping_term * 1000u;
+
     if (TH_GET_HOLD_WHILE_UNDECIDED(tap_hold->flags))
       layout_unregister(event->key, tap_hold->hold_keycode);
 
-    if (retro && !state->interrupted &&
-        timer_elapsed(state->since) >= tap_hold->tapping_term) {
+    if (retro && !state->interrupted && expired) {
       tap_hold_register_tap(event->key, tap_hold->tap_keycode);
       tap_hold_record_tap(event->ak_index);
-    } else if (!retro || timer_elapsed(state->since) < tap_hold->tapping_term) {
+    } else if (!retro || !expired) {
       if (has_double_tap) {
-        state->stage = TAP_HOLD_STAGE_DOUBLE_TAP_WAIT;
-        state->since = timer_read();
+        tap_hold_set_stage(state, TAP_HOLD_STAGE_DOUBLE_TAP_WAIT);
+        state->since = timer_read_us();
         tap_hold_record_tap(event->ak_index);
         return;
       }
@@ -140,12 +156,13 @@ static void tap_hold_handle_release(const advanced_key_event_t *event,
     tap_hold_record_tap(event->ak_index);
   }
 
-  state->stage = TAP_HOLD_STAGE_NONE;
+  tap_hold_set_stage(state, TAP_HOLD_STAGE_NONE);
 }
 
 void advanced_key_tap_hold_clear(void) {
   memset(last_tap_hold_tap_time, 0, sizeof(last_tap_hold_tap_time));
   last_non_mod_key_time = 0;
+  num_undecided = 0;
 }
 
 void advanced_key_tap_hold_process(const advanced_key_event_t *event,
@@ -174,9 +191,10 @@ void advanced_key_tap_hold_tick(const advanced_key_t *ak, uint8_t ak_index,
     state->other_key_released = true;
 
   if (state->stage == TAP_HOLD_STAGE_DOUBLE_TAP_WAIT) {
-    if (timer_elapsed(state->since) >= tap_hold_double_tap_window(&ak->tap_hold)) {
+    if (timer_elapsed_us(state->since) >=
+        tap_hold_double_tap_window(&ak->tap_hold) * 1000u) {
       tap_hold_register_tap(ak->key, ak->tap_hold.tap_keycode);
-      state->stage = TAP_HOLD_STAGE_NONE;
+      tap_hold_set_stage(state, TAP_HOLD_STAGE_NONE);
     }
     return;
   }
@@ -188,32 +206,24 @@ void advanced_key_tap_hold_tick(const advanced_key_t *ak, uint8_t ak_index,
                                       has_non_tap_hold_press)) {
     if (!TH_GET_HOLD_WHILE_UNDECIDED(ak->tap_hold.flags))
       layout_register(ak->key, ak->tap_hold.hold_keycode);
-    state->stage = TAP_HOLD_STAGE_HOLD;
+    tap_hold_set_stage(state, TAP_HOLD_STAGE_HOLD);
     return;
   }
 
   if (TH_GET_FLAVOR(ak->tap_hold.flags) == TAP_HOLD_FLAVOR_TAP_UNLESS_INTERRUPTED &&
-      timer_elapsed(state->since) >= ak->tap_hold.tapping_term &&
+      timer_elapsed_us(state->since) >= ak->tap_hold.tapping_term * 1000u &&
       !state->interrupted) {
     if (TH_GET_HOLD_WHILE_UNDECIDED(ak->tap_hold.flags))
       layout_unregister(ak->key, ak->tap_hold.hold_keycode);
 
     tap_hold_register_tap(ak->key, ak->tap_hold.tap_keycode);
     tap_hold_record_tap(ak_index);
-    state->stage = TAP_HOLD_STAGE_NONE;
+    tap_hold_set_stage(state, TAP_HOLD_STAGE_NONE);
   }
 }
 
-void advanced_key_tap_hold_update_last_key_time(uint32_t time) {
+void advanced_key_tap_hold_update_last_key_time(uint64_t time) {
   last_non_mod_key_time = time;
 }
 
-bool advanced_key_tap_hold_has_undecided(const advanced_key_state_t *states) {
-  for (uint32_t i = 0; i < NUM_ADVANCED_KEYS; i++) {
-    if (CURRENT_PROFILE.advanced_keys[i].type == AK_TYPE_TAP_HOLD &&
-        states[i].tap_hold.stage == TAP_HOLD_STAGE_TAP)
-      return true;
-  }
-
-  return false;
-}
+bool advanced_key_tap_hold_has_undecided(void) { return num_undecided > 0; }
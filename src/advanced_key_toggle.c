@@ -29,7 +29,7 @@ void advanced_key_toggle_process(const advanced_key_event_t *event,
     layout_register(event->key, toggle->keycode);
     state->is_toggled = !state->is_toggled;
     if (state->is_toggled) {
-      state->since = timer_read();
+      state->since = timer_read_us();
       state->stage = TOGGLE_STAGE_TOGGLE;
     } else
       state->stage = TOGGLE_STAGE_NORMAL;
@@ -49,7 +49,7 @@ void advanced_key_toggle_process(const advanced_key_event_t *event,
 void advanced_key_toggle_tick(const advanced_key_t *ak,
                               ak_state_toggle_t *state) {
   if (state->stage == TOGGLE_STAGE_TOGGLE &&
-      timer_elapsed(state->since) >= ak->toggle.tapping_term) {
+      timer_elapsed_us(state->since) >= ak->toggle.tapping_term * 1000u) {
     state->stage = TOGGLE_STAGE_NORMAL;
     state->is_toggled = false;
   }
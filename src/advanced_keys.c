@@ -19,6 +19,7 @@
 #include "advanced_key_dynamic_keystroke.h"
 #include "advanced_key_macro.h"
 #include "advanced_key_null_bind.h"
+#include "advanced_key_rapid_fire.h"
 #include "advanced_key_tap_hold.h"
 #include "advanced_key_toggle.h"
 #include "eeconfig.h"
@@ -32,8 +33,10 @@ void advanced_key_abort_macros(void) { advanced_key_macro_abort_all(ak_states);
 void advanced_key_clear(void) {
   advanced_key_dynamic_keystroke_clear();
   memset(ak_states, 0, sizeof(ak_states));
+  advanced_key_macro_clear();
   advanced_key_tap_hold_clear();
   advanced_key_combo_clear();
+  advanced_key_rapid_fire_clear();
 }
 
 void advanced_key_process(const advanced_key_event_t *event) {
@@ -61,6 +64,10 @@ void advanced_key_process(const advanced_key_event_t *event) {
     advanced_key_macro_process(event, ak_states);
     break;
 
+  case AK_TYPE_RAPID_FIRE:
+    advanced_key_rapid_fire_process(event, ak_states);
+    break;
+
   default:
     break;
   }
@@ -93,10 +100,14 @@ void advanced_key_tick(bool has_non_tap_hold_press,
   }
 }
 
-void advanced_key_update_last_key_time(uint32_t time) {
+void advanced_key_keyboard_report_complete(void) {
+  advanced_key_rapid_fire_report_complete(ak_states);
+}
+
+void advanced_key_update_last_key_time(uint64_t time) {
   advanced_key_tap_hold_update_last_key_time(time);
 }
 
 bool advanced_key_has_undecided(void) {
-  return advanced_key_tap_hold_has_undecided(ak_states);
+  return advanced_key_tap_hold_has_undecided();
 }
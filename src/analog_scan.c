@@ -24,6 +24,16 @@ _Static_assert(M_ARRAY_SIZE(analog_raw_input_vector) == ADC_NUM_RAW_INPUTS,
 
 static volatile uint16_t analog_key_values[NUM_KEYS];
 
+// The build can generate the sample store of the board, so that each mux
+// channel stores its samples directly to its keys, without looking up the
+// tables or storing the inputs that have no key. `ANALOG_SCAN_MUX_KERNEL` is
+// a list of `ANALOG_SCAN_MUX_CHANNEL(channel, stores)` for each mux channel,
+// and `ANALOG_SCAN_RAW_KERNEL` is the stores of the raw inputs.
+#define ANALOG_SCAN_STORE(input, key) analog_key_values[key] = samples[input];
+#define ANALOG_SCAN_MUX_CHANNEL(channel, stores)                               \
+  case channel:                                                                \
+    stores break;
+
 #if ADC_NUM_RAW_INPUTS > 0
 static volatile uint16_t analog_raw_values[ADC_NUM_RAW_INPUTS];
 #endif
@@ -37,7 +47,13 @@ void analog_scan_reset(void) {
 
 void analog_scan_store_samples(const volatile uint16_t *samples,
                                uint8_t mux_channel) {
-#if ADC_NUM_MUX_INPUTS > 0
+#if ADC_NUM_MUX_INPUTS > 0 && defined(ANALOG_SCAN_MUX_KERNEL)
+  switch (mux_channel) {
+    ANALOG_SCAN_MUX_KERNEL
+  default:
+    break;
+  }
+#elif ADC_NUM_MUX_INPUTS > 0
   for (uint32_t i = 0; i < ADC_NUM_MUX_INPUTS; i++) {
     const uint16_t key = analog_mux_input_matrix[mux_channel][i];
     if (key != 0 && key <= NUM_KEYS) {
@@ -48,7 +64,11 @@ void analog_scan_store_samples(const volatile uint16_t *samples,
   (void)mux_channel;
 #endif
 
-#if ADC_NUM_RAW_INPUTS > 0
+#if ADC_NUM_RAW_INPUTS > 0 && defined(ANALOG_SCAN_RAW_KERNEL)
+  for (uint32_t i = 0; i < ADC_NUM_RAW_INPUTS; i++)
+    analog_raw_values[i] = samples[ADC_NUM_MUX_INPUTS + i];
+  ANALOG_SCAN_RAW_KERNEL
+#elif ADC_NUM_RAW_INPUTS > 0
   for (uint32_t i = 0; i < ADC_NUM_RAW_INPUTS; i++) {
     const uint16_t sample = samples[ADC_NUM_MUX_INPUTS + i];
     const uint16_t key = analog_raw_input_vector[i];
@@ -61,7 +81,7 @@ void analog_scan_store_samples(const volatile uint16_t *samples,
 #endif
 }
 
-uint16_t analog_scan_read_key(uint8_t key) {
+uint16_t analog_scan_read_key(key_index_t key) {
   return key < NUM_KEYS ? analog_key_values[key] : 0;
 }
 
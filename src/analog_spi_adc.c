@@ -0,0 +1,270 @@
+/*
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "hardware/hardware.h"
+
+#include "analog_scan.h"
+
+#if defined(ANALOG_BACKEND_SPI_ADC)
+
+// The keys are sampled by external ADCs sharing one SPI bus. Every scanned
+// channel is converted by its own chip-select framed transaction, and the
+// transactions are chained into a ring, so the SPI queue samples the channels
+// round robin from the DMA interrupt without the main loop. The ADCs are
+// exposed to the rest of the firmware as raw inputs numbered
+// `device * SPI_ADC_DEVICE_CHANNELS + channel`.
+
+#if !defined(SPI_ADC_BUS)
+#error "SPI_ADC_BUS is not defined"
+#endif
+
+#if SPI_ADC_BUS >= SPI_NUM_BUSES
+#error "SPI_ADC_BUS is not an enabled SPI bus"
+#endif
+
+#if !defined(SPI_ADC_FREQUENCY_HZ)
+#error "SPI_ADC_FREQUENCY_HZ is not defined"
+#endif
+
+#if !defined(SPI_ADC_NUM_DEVICES)
+#error "SPI_ADC_NUM_DEVICES is not defined"
+#endif
+
+#if !defined(SPI_ADC_CS_PORTS)
+#error "SPI_ADC_CS_PORTS is not defined"
+#endif
+
+#if !defined(SPI_ADC_CS_PINS)
+#error "SPI_ADC_CS_PINS is not defined"
+#endif
+
+#if ADC_NUM_MUX_INPUTS > 0
+#error "Analog multiplexers are not supported by the SPI ADC backend"
+#endif
+
+#if ADC_NUM_RAW_INPUTS == 0
+#error "The SPI ADC backend requires ADC_NUM_RAW_INPUTS"
+#endif
+
+#if !defined(SPI_ADC_INIT_TIMEOUT_MS)
+// Time to wait for the first samples before giving up on the ADCs
+#define SPI_ADC_INIT_TIMEOUT_MS 100
+#endif
+
+#if !defined(SPI_ADC_MAX_RETRIES)
+// Failed transfers in a row after which the sampling is stopped
+#define SPI_ADC_MAX_RETRIES 8
+#endif
+
+//--------------------------------------------------------------------+
+// Device Protocols
+//--------------------------------------------------------------------+
+
+// Both devices are 16-channel 12-bit ADCs with 16-bit frames. The command in
+// a frame selects the channel of a later conversion, and the result comes
+// back a few frames later with its channel address in the upper 4 bits, so
+// the results are matched to their channel by that address rather than by
+// counting the pipeline latency.
+#define SPI_ADC_DEVICE_CHANNELS 16
+#define SPI_ADC_FRAME_SIZE 2
+// Frames sent to each device before sampling, whose results are discarded
+#define SPI_ADC_NUM_PRIME_FRAMES 2
+
+#if defined(SPI_ADC_DEVICE_ADS7953)
+#if !defined(SPI_ADC_MODE)
+#define SPI_ADC_MODE SPI_BUS_MODE_0
+#endif
+
+// Manual mode, program the channel of the conversion two frames later, 0V to
+// VREF range and channel address in the result
+#define SPI_ADC_REQUEST(channel) (0x1800u | ((uint16_t)(channel) << 7))
+// The device powers up in manual mode, so priming only fills the pipeline
+#define SPI_ADC_PRIME_REQUEST SPI_ADC_REQUEST(0)
+#elif defined(SPI_ADC_DEVICE_AD7490)
+#if !defined(SPI_ADC_MODE)
+#define SPI_ADC_MODE SPI_BUS_MODE_2
+#endif
+
+// Write the control register: channel of the next conversion, normal power
+// mode, 0V to REFIN range and straight binary coding
+#define SPI_ADC_REQUEST(channel) (0x8330u | ((uint16_t)(channel) << 10))
+// DIN must be kept high during the first two conversions after power-up
+#define SPI_ADC_PRIME_REQUEST 0xFFFFu
+#else
+#error "Unsupported SPI ADC device"
+#endif
+
+#define SPI_ADC_RESULT_CHANNEL(word) ((word) >> 12)
+#define SPI_ADC_RESULT_VALUE(word) ((word) & 0x0FFFu)
+
+_Static_assert(ADC_RESOLUTION <= 12, "Invalid SPI ADC resolution");
+
+//--------------------------------------------------------------------+
+// Configuration
+//--------------------------------------------------------------------+
+
+// GPIO ports for each device chip select
+static void *const cs_ports[] = SPI_ADC_CS_PORTS;
+
+_Static_assert(M_ARRAY_SIZE(cs_ports) == SPI_ADC_NUM_DEVICES,
+               "Invalid number of SPI ADC chip selects");
+
+// GPIO pins for each device chip select
+static const uint32_t cs_pins[] = SPI_ADC_CS_PINS;
+
+_Static_assert(M_ARRAY_SIZE(cs_pins) == SPI_ADC_NUM_DEVICES,
+               "Invalid number of SPI ADC chip selects");
+
+// Device channel sampled for each raw input, in sampling order
+static const uint8_t raw_input_channels[] = ADC_RAW_INPUT_CHANNELS;
+
+_Static_assert(M_ARRAY_SIZE(raw_input_channels) == ADC_NUM_RAW_INPUTS,
+               "Invalid number of ADC raw inputs");
+_Static_assert(ADC_NUM_CHANNELS ==
+                   SPI_ADC_NUM_DEVICES * SPI_ADC_DEVICE_CHANNELS,
+               "Invalid number of ADC channels");
+
+#define SPI_ADC_NUM_PRIME_TRANSACTIONS                                         \
+  (SPI_ADC_NUM_DEVICES * SPI_ADC_NUM_PRIME_FRAMES)
+#define SPI_ADC_NUM_TRANSACTIONS                                               \
+  (SPI_ADC_NUM_PRIME_TRANSACTIONS + ADC_NUM_RAW_INPUTS)
+
+static const spi_bus_config_t spi_adc_config = {
+    .bus = SPI_ADC_BUS,
+    .frequency_hz = SPI_ADC_FREQUENCY_HZ,
+    .mode = SPI_ADC_MODE,
+};
+
+static spi_chip_select_t spi_adc_chip_selects[SPI_ADC_NUM_DEVICES];
+
+//--------------------------------------------------------------------+
+// Sampling
+//--------------------------------------------------------------------+
+
+// The priming transactions come first, followed by one transaction per raw
+// input. The last one links back to the first raw input.
+static spi_transaction_t spi_adc_transactions[SPI_ADC_NUM_TRANSACTIONS];
+static uint8_t spi_adc_tx[SPI_ADC_NUM_TRANSACTIONS][SPI_ADC_FRAME_SIZE];
+static uint8_t spi_adc_rx[SPI_ADC_NUM_TRANSACTIONS][SPI_ADC_FRAME_SIZE];
+
+// Raw input of each device channel plus one, or 0 if it is not sampled
+static uint16_t spi_adc_channel_inputs[SPI_ADC_NUM_DEVICES]
+                                      [SPI_ADC_DEVICE_CHANNELS];
+// Latest result of each raw input
+static volatile uint16_t spi_adc_samples[ADC_NUM_RAW_INPUTS];
+// Number of completed sweeps over the raw inputs
+static volatile uint32_t spi_adc_sweeps;
+// Failed transfers since the last successful one
+static uint32_t spi_adc_failures;
+
+static spi_transaction_t *const spi_adc_first_sample =
+    &spi_adc_transactions[SPI_ADC_NUM_PRIME_TRANSACTIONS];
+
+static void spi_adc_sample_done(spi_transaction_t *transaction, bool success) {
+  const uint32_t input = (uint32_t)(transaction - spi_adc_first_sample);
+
+  if (!success) {
+    // The chain stops at a failed transaction, so the sweep is restarted
+    if (++spi_adc_failures < SPI_ADC_MAX_RETRIES)
+      spi_bus_submit(spi_adc_first_sample);
+    return;
+  }
+  spi_adc_failures = 0;
+
+  const uint8_t device = raw_input_channels[input] / SPI_ADC_DEVICE_CHANNELS;
+  const uint8_t *rx = spi_adc_rx[transaction - spi_adc_transactions];
+  const uint16_t word = (uint16_t)(rx[0] << 8 | rx[1]);
+  const uint16_t index =
+      spi_adc_channel_inputs[device][SPI_ADC_RESULT_CHANNEL(word)];
+
+  if (index != 0)
+    spi_adc_samples[index - 1] = SPI_ADC_RESULT_VALUE(word);
+
+  if (input == ADC_NUM_RAW_INPUTS - 1) {
+    analog_scan_store_samples(spi_adc_samples, 0);
+    spi_adc_sweeps++;
+  }
+}
+
+static void spi_adc_prime_done(spi_transaction_t *transaction, bool success) {
+  (void)transaction;
+
+  if (!success && ++spi_adc_failures < SPI_ADC_MAX_RETRIES)
+    spi_bus_submit(&spi_adc_transactions[0]);
+}
+
+static void spi_adc_init_transaction(uint32_t index, uint8_t device,
+                                     uint16_t request) {
+  spi_transaction_t *transaction = &spi_adc_transactions[index];
+
+  spi_adc_tx[index][0] = (uint8_t)(request >> 8);
+  spi_adc_tx[index][1] = (uint8_t)request;
+
+  transaction->config = &spi_adc_config;
+  transaction->chip_select = &spi_adc_chip_selects[device];
+  transaction->tx = spi_adc_tx[index];
+  transaction->rx = spi_adc_rx[index];
+  transaction->len = SPI_ADC_FRAME_SIZE;
+  transaction->chain = index + 1 < SPI_ADC_NUM_TRANSACTIONS
+                           ? &spi_adc_transactions[index + 1]
+                           : spi_adc_first_sample;
+}
+
+void analog_init(void) {
+  spi_bus_init();
+  analog_scan_reset();
+
+  for (uint8_t i = 0; i < SPI_ADC_NUM_DEVICES; i++) {
+    spi_adc_chip_selects[i].port = cs_ports[i];
+    spi_adc_chip_selects[i].pin = cs_pins[i];
+    spi_adc_chip_selects[i].active_low = true;
+    spi_cs_init(&spi_adc_chip_selects[i]);
+  }
+
+  for (uint32_t i = 0; i < SPI_ADC_NUM_PRIME_TRANSACTIONS; i++) {
+    spi_adc_init_transaction(i, (uint8_t)(i / SPI_ADC_NUM_PRIME_FRAMES),
+                             SPI_ADC_PRIME_REQUEST);
+    spi_adc_transactions[i].callback = spi_adc_prime_done;
+  }
+
+  for (uint16_t i = 0; i < ADC_NUM_RAW_INPUTS; i++) {
+    const uint8_t device = raw_input_channels[i] / SPI_ADC_DEVICE_CHANNELS;
+    const uint8_t channel = raw_input_channels[i] % SPI_ADC_DEVICE_CHANNELS;
+
+    spi_adc_channel_inputs[device][channel] = i + 1;
+    spi_adc_init_transaction(SPI_ADC_NUM_PRIME_TRANSACTIONS + i, device,
+                             SPI_ADC_REQUEST(channel));
+    spi_adc_transactions[SPI_ADC_NUM_PRIME_TRANSACTIONS + i].callback =
+        spi_adc_sample_done;
+  }
+
+  spi_adc_sweeps = 0;
+  spi_adc_failures = 0;
+  spi_bus_submit(&spi_adc_transactions[0]);
+
+  // Wait for every raw input to be sampled. A result can arrive a sweep after
+  // its request, so the first sweep is not enough.
+  const uint32_t start = timer_read();
+  while (spi_adc_sweeps < 2 && timer_elapsed(start) < SPI_ADC_INIT_TIMEOUT_MS)
+    ;
+}
+
+void analog_task(void) {}
+
+uint16_t analog_read(key_index_t key) { return analog_scan_read_key(key); }
+
+uint16_t analog_read_raw(uint8_t index) { return analog_scan_read_raw(index); }
+
+#endif
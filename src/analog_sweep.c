@@ -0,0 +1,142 @@
+/*
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "analog_sweep.h"
+
+#include "hardware/hardware.h"
+
+#if defined(ADC_SWEEP_RATE_HZ)
+// Number of ticks of a 16-bit timer period
+#define TIMER_MAX_TICKS 65536u
+
+// Half of the sample buffer that the DMA was writing at the last poll
+static uint8_t sweep_writing_half;
+
+static uint64_t ns_to_ticks(uint32_t ns, uint32_t clock_hz) {
+  return ((uint64_t)ns * clock_hz + 999999999u) / 1000000000u;
+}
+
+bool analog_sweep_compute_timing(uint32_t timer_clock_hz,
+                                 uint32_t sweep_rate_hz, uint32_t settle_ns,
+                                 uint32_t conversion_ns,
+                                 analog_sweep_timing_t *timing) {
+  const uint64_t steps_per_second =
+      (uint64_t)M_MAX(sweep_rate_hz, 1u) * ADC_SWEEP_NUM_STEPS;
+  const uint64_t requested_ticks = M_MAX(
+      (timer_clock_hz + steps_per_second / 2) / steps_per_second, 1u);
+  // The ADC is triggered at least one tick after the overflow, so that the
+  // select pattern is written first
+  const uint64_t settle_ticks =
+      M_MAX(ns_to_ticks(settle_ns, timer_clock_hz), 1u);
+  const uint64_t conversion_ticks = ns_to_ticks(conversion_ns, timer_clock_hz);
+  const uint64_t step_ticks =
+      M_MAX(requested_ticks, settle_ticks + conversion_ticks);
+  // Divide the clock so that the step, rounded up in prescaled ticks, fits in
+  // the timer period
+  const uint64_t divider = M_MIN(
+      (step_ticks + TIMER_MAX_TICKS - 2) / (TIMER_MAX_TICKS - 1), 65536u);
+  const uint64_t trigger = (settle_ticks + divider - 1) / divider;
+  const uint64_t busy =
+      (settle_ticks + conversion_ticks + divider - 1) / divider;
+  const uint64_t period =
+      M_MIN(M_MAX((step_ticks + divider / 2) / divider, busy), TIMER_MAX_TICKS);
+
+  timing->prescaler = (uint16_t)(divider - 1);
+  timing->period = (uint16_t)(period - 1);
+  timing->trigger = (uint16_t)M_MIN(trigger, period - 1);
+
+  return step_ticks == requested_ticks;
+}
+
+uint32_t analog_sweep_rate_hz(uint32_t timer_clock_hz,
+                              const analog_sweep_timing_t *timing) {
+  const uint64_t sweep_ticks = ((uint64_t)timing->prescaler + 1) *
+                               ((uint64_t)timing->period + 1) *
+                               ADC_SWEEP_NUM_STEPS;
+
+  return (uint32_t)((timer_clock_hz + sweep_ticks / 2) / sweep_ticks);
+}
+
+uint32_t analog_sweep_timeout_cycles(const analog_sweep_timing_t *timing) {
+  const uint64_t cycles = ((uint64_t)timing->prescaler + 1) *
+                          ((uint64_t)timing->period + 1) *
+                          ADC_SWEEP_NUM_STEPS * ADC_SWEEP_TIMEOUT_SWEEPS;
+
+  return (uint32_t)M_MIN(cycles, UINT32_MAX);
+}
+
+#if ADC_NUM_MUX_INPUTS > 0
+static uint32_t
+analog_sweep_mux_pattern(const uint16_t select_pins[ADC_NUM_MUX_SELECT_PINS],
+                         uint32_t mux_channel) {
+  uint32_t pattern = 0;
+
+  for (uint32_t i = 0; i < ADC_NUM_MUX_SELECT_PINS; i++) {
+    if ((mux_channel >> i) & 1)
+      pattern |= select_pins[i];
+    else
+      pattern |= (uint32_t)select_pins[i] << 16;
+  }
+
+  return pattern;
+}
+
+uint32_t analog_sweep_build_mux_patterns(
+    const uint16_t select_pins[ADC_NUM_MUX_SELECT_PINS],
+    uint32_t patterns[ADC_SWEEP_NUM_STEPS]) {
+  for (uint32_t i = 0; i < ADC_SWEEP_NUM_STEPS; i++)
+    patterns[i] =
+        analog_sweep_mux_pattern(select_pins, (i + 1) % ADC_SWEEP_NUM_STEPS);
+
+  return analog_sweep_mux_pattern(select_pins, 0);
+}
+#endif
+
+void analog_sweep_reset(void) { sweep_writing_half = 0; }
+
+bool analog_sweep_store(const volatile uint16_t *buffer,
+                        uint32_t dma_remaining) {
+  // The transfer count is reloaded when it reaches 0, so 0 is the same as
+  // the beginning of the buffer
+  const uint32_t position = (2 * ADC_SWEEP_NUM_SAMPLES - dma_remaining) %
+                            (2 * ADC_SWEEP_NUM_SAMPLES);
+  const uint8_t writing_half = position >= ADC_SWEEP_NUM_SAMPLES;
+
+  if (writing_half == sweep_writing_half)
+    return false;
+  sweep_writing_half = writing_half;
+
+  // The other half holds the sweep that has just been completed. It is
+  // overwritten one sweep later, which is the time to process it.
+  const volatile uint16_t *sweep =
+      &buffer[(writing_half ^ 1u) * ADC_SWEEP_NUM_SAMPLES];
+  for (uint32_t i = 0; i < ADC_SWEEP_NUM_STEPS; i++)
+    analog_scan_store_samples(&sweep[i * ADC_SWEEP_NUM_INPUTS], (uint8_t)i);
+
+  return true;
+}
+
+bool analog_sweep_wait(const volatile uint16_t *buffer,
+                       uint32_t (*dma_remaining)(void),
+                       uint32_t timeout_cycles) {
+  const uint32_t start = board_cycle_count();
+
+  while (!analog_sweep_store(buffer, dma_remaining()))
+    if (board_cycle_count() - start >= timeout_cycles)
+      return false;
+
+  return true;
+}
+#endif
@@ -51,25 +51,18 @@ static bool command_validate_gamepad_options(
   return true;
 }
 
-static uint32_t command_profile_base_addr(uint8_t profile) {
-  return offsetof(eeconfig_t, profiles) +
-         (uint32_t)profile * sizeof(eeconfig_profile_t);
-}
-
-static bool command_write_profile_bytes(uint8_t profile, uint32_t field_offset,
-                                        const void *data, uint32_t len) {
-  return wear_leveling_write(command_profile_base_addr(profile) + field_offset,
-                             data, len);
-}
-
 static void command_reset_if_current_profile(uint8_t profile) {
-  if (profile == eeconfig->current_profile)
+  if (profile == eeconfig_get_current_profile())
     layout_reset_runtime_state();
 }
 
-static void command_reload_if_current_profile(uint8_t profile) {
-  if (profile == eeconfig->current_profile)
+// Rebuild the runtime image of a profile after its advanced keys or gamepad
+// buttons changed, so that switching to it stays instant
+static void command_reload_profile(uint8_t profile) {
+  if (profile == eeconfig_get_current_profile())
     profile_runtime_reload_current();
+  else
+    profile_runtime_build(profile);
 }
 
 void command_init(void) {
@@ -99,17 +92,23 @@ void command_process(const uint8_t *buf) {
     break;
   }
   case COMMAND_REBOOT: {
+    (void)eeconfig_save_current_profile();
+    (void)wear_leveling_flush();
     board_reset();
     break;
   }
   case COMMAND_BOOTLOADER: {
+    (void)eeconfig_save_current_profile();
+    (void)wear_leveling_flush();
     board_enter_bootloader();
     break;
   }
   case COMMAND_FACTORY_RESET: {
     success = eeconfig_reset();
-    if (success)
-      profile_runtime_reload_current();
+    if (success) {
+      for (uint8_t i = 0; i < NUM_PROFILES; i++)
+        command_reload_profile(i);
+    }
     break;
   }
   case COMMAND_RECALIBRATE: {
@@ -151,7 +150,7 @@ void command_process(const uint8_t *buf) {
     break;
   }
   case COMMAND_GET_PROFILE: {
-    out->current_profile = eeconfig->current_profile;
+    out->current_profile = eeconfig_get_current_profile();
     break;
   }
   case COMMAND_GET_OPTIONS: {
@@ -168,8 +167,8 @@ void command_process(const uint8_t *buf) {
     COMMAND_VERIFY(p->profile < NUM_PROFILES);
 
     success = eeconfig_reset_profile(p->profile);
-    if (success && p->profile == eeconfig->current_profile)
-      profile_runtime_reload_current();
+    if (success)
+      command_reload_profile(p->profile);
     break;
   }
   case COMMAND_DUPLICATE_PROFILE: {
@@ -178,10 +177,9 @@ void command_process(const uint8_t *buf) {
     COMMAND_VERIFY(p->profile < NUM_PROFILES);
     COMMAND_VERIFY(p->src_profile < NUM_PROFILES);
 
-    success = EECONFIG_WRITE(profiles[p->profile],
-                             &eeconfig->profiles[p->src_profile]);
-    if (success && p->profile == eeconfig->current_profile)
-      profile_runtime_reload_current();
+    success = eeconfig_copy_profile(p->profile, p->src_profile);
+    if (success)
+      command_reload_profile(p->profile);
     break;
   }
   case COMMAND_GET_KEYMAP: {
@@ -191,10 +189,14 @@ void command_process(const uint8_t *buf) {
     COMMAND_VERIFY(p->layer < NUM_LAYERS);
     COMMAND_VERIFY(p->offset < NUM_KEYS);
 
-    memcpy(out->keymap,
-           eeconfig->profiles[p->profile].keymap[p->layer] + p->offset,
-           M_MIN(M_ARRAY_SIZE(out->keymap), (uint32_t)(NUM_KEYS - p->offset)) *
-               sizeof(uint8_t));
+    success = eeconfig_read_profile(
+        p->profile,
+        offsetof(eeconfig_profile_t, keymap) +
+            p->layer * sizeof(CURRENT_PROFILE.keymap[0]) +
+            p->offset * sizeof(uint8_t),
+        out->keymap,
+        M_MIN(M_ARRAY_SIZE(out->keymap), (uint32_t)(NUM_KEYS - p->offset)) *
+            sizeof(uint8_t));
     break;
   }
   case COMMAND_GET_METADATA: {
@@ -234,11 +236,10 @@ void command_process(const uint8_t *buf) {
                    p->len <= NUM_KEYS - p->offset);
 
     const uint32_t field_offset = offsetof(eeconfig_profile_t, keymap) +
-                                  p->layer *
-                                      sizeof(eeconfig->profiles[0].keymap[0]) +
+                                  p->layer * sizeof(CURRENT_PROFILE.keymap[0]) +
                                   p->offset * sizeof(uint8_t);
-    success = command_write_profile_bytes(p->profile, field_offset, p->keymap,
-                                          sizeof(uint8_t) * p->len);
+    success = eeconfig_write_profile(p->profile, field_offset, p->keymap,
+                                     sizeof(uint8_t) * p->len);
     if (success)
       command_reset_if_current_profile(p->profile);
     break;
@@ -249,11 +250,14 @@ void command_process(const uint8_t *buf) {
     COMMAND_VERIFY(p->profile < NUM_PROFILES);
     COMMAND_VERIFY(p->offset < NUM_KEYS);
 
-    memcpy(out->actuation_map,
-           eeconfig->profiles[p->profile].actuation_map + p->offset,
-           M_MIN(M_ARRAY_SIZE(out->actuation_map),
-                 (uint32_t)(NUM_KEYS - p->offset)) *
-               sizeof(actuation_t));
+    success = eeconfig_read_profile(
+        p->profile,
+        offsetof(eeconfig_profile_t, actuation_map) +
+            p->offset * sizeof(actuation_t),
+        out->actuation_map,
+        M_MIN(M_ARRAY_SIZE(out->actuation_map),
+              (uint32_t)(NUM_KEYS - p->offset)) *
+            sizeof(actuation_t));
     break;
   }
   case COMMAND_SET_ACTUATION_MAP: {
@@ -266,7 +270,7 @@ void command_process(const uint8_t *buf) {
 
     const uint32_t field_offset = offsetof(eeconfig_profile_t, actuation_map) +
                                   p->offset * sizeof(actuation_t);
-    success = command_write_profile_bytes(
+    success = eeconfig_write_profile(
         p->profile, field_offset, p->actuation_map,
         sizeof(actuation_t) * p->len);
     break;
@@ -277,11 +281,14 @@ void command_process(const uint8_t *buf) {
     COMMAND_VERIFY(p->profile < NUM_PROFILES);
     COMMAND_VERIFY(p->offset < NUM_ADVANCED_KEYS);
 
-    memcpy(out->advanced_keys,
-           eeconfig->profiles[p->profile].advanced_keys + p->offset,
-           M_MIN(M_ARRAY_SIZE(out->advanced_keys),
-                 (uint32_t)(NUM_ADVANCED_KEYS - p->offset)) *
-               sizeof(advanced_key_t));
+    success = eeconfig_read_profile(
+        p->profile,
+        offsetof(eeconfig_profile_t, advanced_keys) +
+            p->offset * sizeof(advanced_key_t),
+        out->advanced_keys,
+        M_MIN(M_ARRAY_SIZE(out->advanced_keys),
+              (uint32_t)(NUM_ADVANCED_KEYS - p->offset)) *
+            sizeof(advanced_key_t));
     break;
   }
   case COMMAND_SET_ADVANCED_KEYS: {
@@ -294,11 +301,11 @@ void command_process(const uint8_t *buf) {
 
     const uint32_t field_offset = offsetof(eeconfig_profile_t, advanced_keys) +
                                   p->offset * sizeof(advanced_key_t);
-    success = command_write_profile_bytes(
+    success = eeconfig_write_profile(
         p->profile, field_offset, p->advanced_keys,
         sizeof(advanced_key_t) * p->len);
     if (success)
-      command_reload_if_current_profile(p->profile);
+      command_reload_profile(p->profile);
     break;
   }
   case COMMAND_GET_TICK_RATE: {
@@ -306,7 +313,9 @@ void command_process(const uint8_t *buf) {
 
     COMMAND_VERIFY(p->profile < NUM_PROFILES);
 
-    out->tick_rate = eeconfig->profiles[p->profile].tick_rate;
+    success = eeconfig_read_profile(p->profile,
+                                    offsetof(eeconfig_profile_t, tick_rate),
+                                    &out->tick_rate, sizeof(out->tick_rate));
     break;
   }
   case COMMAND_SET_TICK_RATE: {
@@ -314,9 +323,7 @@ void command_process(const uint8_t *buf) {
 
     COMMAND_VERIFY(p->profile < NUM_PROFILES);
 
-    success = command_write_profile_bytes(p->profile,
-                                          offsetof(eeconfig_profile_t, tick_rate),
-                                          &p->tick_rate, sizeof(p->tick_rate));
+    success = EECONFIG_WRITE_PROFILE(p->profile, tick_rate, &p->tick_rate);
     break;
   }
   case COMMAND_GET_GAMEPAD_BUTTONS: {
@@ -325,11 +332,14 @@ void command_process(const uint8_t *buf) {
     COMMAND_VERIFY(p->profile < NUM_PROFILES);
     COMMAND_VERIFY(p->offset < NUM_KEYS);
 
-    memcpy(out->gamepad_buttons,
-           eeconfig->profiles[p->profile].gamepad_buttons + p->offset,
-           M_MIN(M_ARRAY_SIZE(out->gamepad_buttons),
-                 (uint32_t)(NUM_KEYS - p->offset)) *
-               sizeof(uint8_t));
+    success = eeconfig_read_profile(
+        p->profile,
+        offsetof(eeconfig_profile_t, gamepad_buttons) +
+            p->offset * sizeof(uint8_t),
+        out->gamepad_buttons,
+        M_MIN(M_ARRAY_SIZE(out->gamepad_buttons),
+              (uint32_t)(NUM_KEYS - p->offset)) *
+            sizeof(uint8_t));
     break;
   }
   case COMMAND_SET_GAMEPAD_BUTTONS: {
@@ -342,11 +352,11 @@ void command_process(const uint8_t *buf) {
 
     const uint32_t field_offset = offsetof(eeconfig_profile_t, gamepad_buttons) +
                                   p->offset * sizeof(uint8_t);
-    success = command_write_profile_bytes(
+    success = eeconfig_write_profile(
         p->profile, field_offset, p->gamepad_buttons,
         sizeof(uint8_t) * p->len);
     if (success)
-      command_reset_if_current_profile(p->profile);
+      command_reload_profile(p->profile);
     break;
   }
   case COMMAND_GET_GAMEPAD_OPTIONS: {
@@ -354,7 +364,9 @@ void command_process(const uint8_t *buf) {
 
     COMMAND_VERIFY(p->profile < NUM_PROFILES);
 
-    out->gamepad_options = eeconfig->profiles[p->profile].gamepad_options;
+    success = eeconfig_read_profile(
+        p->profile, offsetof(eeconfig_profile_t, gamepad_options),
+        &out->gamepad_options, sizeof(out->gamepad_options));
     break;
   }
   case COMMAND_SET_GAMEPAD_OPTIONS: {
@@ -363,9 +375,8 @@ void command_process(const uint8_t *buf) {
     COMMAND_VERIFY(p->profile < NUM_PROFILES);
     COMMAND_VERIFY(command_validate_gamepad_options(&p->gamepad_options));
 
-    success = command_write_profile_bytes(
-        p->profile, offsetof(eeconfig_profile_t, gamepad_options),
-        &p->gamepad_options, sizeof(p->gamepad_options));
+    success = EECONFIG_WRITE_PROFILE(p->profile, gamepad_options,
+                                     &p->gamepad_options);
     if (success)
       command_reset_if_current_profile(p->profile);
     break;
@@ -376,10 +387,12 @@ void command_process(const uint8_t *buf) {
     COMMAND_VERIFY(p->profile < NUM_PROFILES);
     COMMAND_VERIFY(p->offset < NUM_MACROS);
 
-    memcpy(out->macros, eeconfig->profiles[p->profile].macros + p->offset,
-           M_MIN(M_ARRAY_SIZE(out->macros),
-                 (uint32_t)(NUM_MACROS - p->offset)) *
-               sizeof(macro_t));
+    success = eeconfig_read_profile(
+        p->profile,
+        offsetof(eeconfig_profile_t, macros) + p->offset * sizeof(macro_t),
+        out->macros,
+        M_MIN(M_ARRAY_SIZE(out->macros), (uint32_t)(NUM_MACROS - p->offset)) *
+            sizeof(macro_t));
     break;
   }
   case COMMAND_SET_MACROS: {
@@ -390,12 +403,12 @@ void command_process(const uint8_t *buf) {
     COMMAND_VERIFY(p->len <= M_ARRAY_SIZE(p->macros) &&
                    p->len <= NUM_MACROS - p->offset);
 
-    // EECONFIG_WRITE_N cannot be used here because the field contains variables
-    // (p->profile, p->offset), which are not allowed in offsetof().
+    // EECONFIG_WRITE_PROFILE cannot be used here because the field contains a
+    // variable (p->offset), which is not allowed in offsetof().
     const uint32_t field_offset = offsetof(eeconfig_profile_t, macros) +
                                   p->offset * sizeof(macro_t);
-    success = command_write_profile_bytes(p->profile, field_offset, p->macros,
-                                          sizeof(macro_t) * p->len);
+    success = eeconfig_write_profile(p->profile, field_offset, p->macros,
+                                     sizeof(macro_t) * p->len);
     if (success)
       command_reset_if_current_profile(p->profile);
     break;
@@ -407,10 +420,11 @@ void command_process(const uint8_t *buf) {
     COMMAND_VERIFY(p->profile < NUM_PROFILES);
     COMMAND_VERIFY(p->offset < sizeof(rgb_config_t));
 
-    const rgb_config_t *config = &eeconfig->profiles[p->profile].rgb_config;
-    memcpy(out->rgb_config_data, ((const uint8_t *)config) + p->offset,
-           M_MIN(M_ARRAY_SIZE(out->rgb_config_data),
-                 (uint32_t)(sizeof(rgb_config_t) - p->offset)));
+    success = eeconfig_read_profile(
+        p->profile, offsetof(eeconfig_profile_t, rgb_config) + p->offset,
+        out->rgb_config_data,
+        M_MIN(M_ARRAY_SIZE(out->rgb_config_data),
+              (uint32_t)(sizeof(rgb_config_t) - p->offset)));
     break;
   }
   case COMMAND_SET_RGB_CONFIG: {
@@ -423,11 +437,11 @@ void command_process(const uint8_t *buf) {
 
     const uint32_t field_offset = offsetof(eeconfig_profile_t, rgb_config) +
                                   p->offset * sizeof(uint8_t);
-    success = command_write_profile_bytes(p->profile, field_offset, p->data,
-                                          sizeof(uint8_t) * p->len);
+    success = eeconfig_write_profile(p->profile, field_offset, p->data,
+                                     sizeof(uint8_t) * p->len);
 
-    if (success && p->profile == eeconfig->current_profile) {
-      memcpy(rgb_get_config(), &eeconfig->profiles[p->profile].rgb_config,
+    if (success && p->profile == eeconfig_get_current_profile()) {
+      memcpy(rgb_get_config(), &CURRENT_PROFILE.rgb_config,
              sizeof(rgb_config_t));
       rgb_apply_config();
     }
@@ -437,7 +451,7 @@ void command_process(const uint8_t *buf) {
 #if defined(JOYSTICK_ENABLED)
   case COMMAND_GET_JOYSTICK_STATE: {
     joystick_state_t state = joystick_get_state();
-    out->joystick_state.profile = eeconfig->current_profile;
+    out->joystick_state.profile = eeconfig_get_current_profile();
     out->joystick_state.raw_x = state.raw_x;
     out->joystick_state.raw_y = state.raw_y;
     out->joystick_state.out_x = state.out_x;
@@ -452,10 +466,9 @@ void command_process(const uint8_t *buf) {
   case COMMAND_GET_JOYSTICK_CONFIG: {
     const command_in_joystick_config_t *p = &in->joystick_config;
     COMMAND_VERIFY(p->profile < NUM_PROFILES);
-    joystick_config_t config;
-    memcpy(&config, &eeconfig->profiles[p->profile].joystick_config,
-           sizeof(config));
-    memcpy(out->joystick_config.data, &config, sizeof(joystick_config_t));
+    success = eeconfig_read_profile(
+        p->profile, offsetof(eeconfig_profile_t, joystick_config),
+        out->joystick_config.data, sizeof(joystick_config_t));
     break;
   }
   case COMMAND_SET_JOYSTICK_CONFIG: {
@@ -465,9 +478,8 @@ void command_process(const uint8_t *buf) {
     memcpy(&joystick_config, &p->joystick_config, sizeof(joystick_config));
     joystick_config = joystick_normalize_config(joystick_config);
 
-    success = command_write_profile_bytes(
-        p->profile, offsetof(eeconfig_profile_t, joystick_config),
-        &joystick_config, sizeof(joystick_config_t));
+    success = EECONFIG_WRITE_PROFILE(p->profile, joystick_config,
+                                     &joystick_config);
 
     if (success)
       command_reset_if_current_profile(p->profile);
@@ -485,6 +497,18 @@ void command_process(const uint8_t *buf) {
     rgb_set_clock_time(p->hours, p->minutes, p->seconds);
     break;
   }
+  case COMMAND_RGB_STREAM: {
+    const command_in_rgb_stream_t *p = &in->rgb_stream;
+
+    COMMAND_VERIFY(p->len <= M_ARRAY_SIZE(p->data));
+    COMMAND_VERIFY(rgb_stream_write(p->sequence, p->flags, p->encoding,
+                                    p->offset, p->data, p->len));
+
+    const rgb_stream_status_t status = rgb_stream_get_status();
+    out->rgb_stream.presented_sequence = status.presented_sequence;
+    out->rgb_stream.dropped_frames = status.dropped_frames;
+    break;
+  }
 #endif
   default: {
     // Unknown command
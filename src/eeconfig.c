@@ -19,6 +19,7 @@
 #include "migration.h"
 
 const eeconfig_t *eeconfig;
+const eeconfig_profile_t *eeconfig_profile;
 
 // Default configuration values
 static eeconfig_options_t default_options = DEFAULT_OPTIONS;
@@ -28,39 +29,420 @@ static const uint8_t
 #if defined(RGB_ENABLED)
 static const rgb_config_t default_rgb_config = (rgb_config_t)DEFAULT_RGB_CONFIG;
 #endif
-static eeconfig_profile_t default_profile = {0};
 
-static bool eeconfig_write_default_profile(uint8_t profile) {
-  if (profile >= NUM_PROFILES)
-    return false;
+// Current profile, materialised from its delta records. It is decoded again
+// on a switch, so that the RAM used does not grow with `NUM_PROFILES`.
+static eeconfig_profile_t current_profile_view;
+// Any other profile being read or written
+static eeconfig_profile_t profile_scratch;
+// Current profile, and last non-default profile. They are switched at once,
+// and written to the configuration by `eeconfig_save_current_profile()`.
+static uint8_t current_profile;
+static uint8_t last_non_default_profile;
+
+// Address of the base profile and the delta records in the virtual storage
+#define EECONFIG_BASE_ADDR offsetof(eeconfig_t, base_profile)
+#define EECONFIG_DELTAS_ADDR offsetof(eeconfig_t, profile_deltas)
+// Size of a profile stored as a whole
+#define EECONFIG_PROFILE_SIZE sizeof(eeconfig_profile_t)
+// Unchanged bytes between two changed runs are kept in the same record, unless
+// there are more of them than a record header
+#define EECONFIG_DELTA_MAX_GAP sizeof(eeconfig_delta_header_t)
+// Bytes moved at once while compacting the delta records
+#define EECONFIG_COMPACT_CHUNK_SIZE WL_MAX_BYTES_PER_ENTRY
 
-  default_profile.gamepad_options = (gamepad_options_t)DEFAULT_GAMEPAD_OPTIONS;
-  default_profile.tick_rate = DEFAULT_TICK_RATE;
-  memcpy(default_profile.keymap, default_keymaps[profile],
-         sizeof(default_profile.keymap));
+static void eeconfig_init_default_profile(eeconfig_profile_t *profile,
+                                          uint8_t index) {
+  memset(profile, 0, sizeof(*profile));
+  for (uint32_t i = 0; i < NUM_KEYS; i++)
+    profile->actuation_map[i].actuation_point = DEFAULT_ACTUATION_POINT;
+  profile->gamepad_options = (gamepad_options_t)DEFAULT_GAMEPAD_OPTIONS;
+  profile->tick_rate = DEFAULT_TICK_RATE;
+  memcpy(profile->keymap, default_keymaps[index], sizeof(profile->keymap));
 #if defined(RGB_ENABLED)
-  default_profile.rgb_config = default_rgb_config;
+  profile->rgb_config = default_rgb_config;
 #endif
 #if defined(JOYSTICK_ENABLED)
-  joystick_init_default_config(&default_profile.joystick_config);
+  joystick_init_default_config(&profile->joystick_config);
 #endif
-  return EECONFIG_WRITE(profiles[profile], &default_profile);
 }
 
+//--------------------------------------------------------------------+
+// Delta Records
+//--------------------------------------------------------------------+
+
+// The profiles are read through the wear leveling module rather than
+// `eeconfig`, since only the start of the virtual storage is kept in RAM with
+// `WL_XIP_ENABLED`
+#if defined(WL_XIP_ENABLED)
+static uint8_t eeconfig_read_base_byte(uint32_t offset) {
+  uint8_t value = 0;
+
+  (void)wear_leveling_read(EECONFIG_BASE_ADDR + offset, &value, 1);
+  return value;
+}
+
+#define EECONFIG_BASE_BYTE(offset) eeconfig_read_base_byte(offset)
+#else
+#define EECONFIG_BASE_BYTE(offset)                                             \
+  (((const uint8_t *)&eeconfig->base_profile)[offset])
+#endif
+
+static eeconfig_profile_slot_t eeconfig_read_slot(uint32_t profile) {
+  eeconfig_profile_slot_t slot = {0};
+
+  (void)wear_leveling_read(offsetof(eeconfig_t, profile_slots) +
+                               profile * sizeof(slot),
+                           &slot, sizeof(slot));
+  return slot;
+}
+
+/**
+ * @brief Find the next record of a profile
+ *
+ * @param profile Profile to encode
+ * @param offset Offset to search from. Set to the offset of the record.
+ * @param len Set to the length of the record
+ *
+ * @return true if a record has been found, false if the rest of the profile
+ * matches the base profile
+ */
+static bool eeconfig_next_delta(const eeconfig_profile_t *profile,
+                                uint32_t *offset, uint32_t *len) {
+  const uint8_t *data = (const uint8_t *)profile;
+
+  uint32_t start = *offset;
+  while (start < EECONFIG_PROFILE_SIZE &&
+         data[start] == EECONFIG_BASE_BYTE(start))
+    start++;
+  if (start == EECONFIG_PROFILE_SIZE)
+    return false;
+
+  uint32_t end = start + 1;
+  for (uint32_t i = end; i < EECONFIG_PROFILE_SIZE && i - start < UINT8_MAX;
+       i++) {
+    if (data[i] != EECONFIG_BASE_BYTE(i))
+      end = i + 1;
+    else if (i - end >= EECONFIG_DELTA_MAX_GAP)
+      break;
+  }
+
+  *offset = start;
+  *len = end - start;
+  return true;
+}
+
+/**
+ * @brief Get the size of the delta records of a profile
+ *
+ * @param profile Profile to encode
+ *
+ * @return Size of the records in bytes, or `EECONFIG_PROFILE_SIZE` if the
+ * profile is smaller stored as a whole
+ */
+static uint32_t eeconfig_delta_size(const eeconfig_profile_t *profile) {
+  uint32_t size = 0;
+
+  for (uint32_t offset = 0, len; eeconfig_next_delta(profile, &offset, &len);
+       offset += len) {
+    size += sizeof(eeconfig_delta_header_t) + len;
+    if (size >= EECONFIG_PROFILE_SIZE)
+      return EECONFIG_PROFILE_SIZE;
+  }
+
+  return size;
+}
+
+/**
+ * @brief Write the delta records of a profile
+ *
+ * @param profile Profile to encode
+ * @param addr Address to write the records to
+ * @param size Size of the records returned by `eeconfig_delta_size()`
+ *
+ * @return true if successful, false otherwise
+ */
+static bool eeconfig_write_deltas(const eeconfig_profile_t *profile,
+                                  uint32_t addr, uint32_t size) {
+  const uint8_t *data = (const uint8_t *)profile;
+
+  if (size == EECONFIG_PROFILE_SIZE)
+    return wear_leveling_write(addr, data, size);
+
+  for (uint32_t offset = 0, len; eeconfig_next_delta(profile, &offset, &len);
+       offset += len) {
+    const eeconfig_delta_header_t header = {
+        .offset = (uint16_t)offset,
+        .len = (uint8_t)len,
+    };
+
+    if (!wear_leveling_write(addr, &header, sizeof(header)) ||
+        !wear_leveling_write(addr + sizeof(header), data + offset, len))
+      return false;
+    addr += sizeof(header) + len;
+  }
+
+  return true;
+}
+
+/**
+ * @brief Check whether a profile has records inside the delta area
+ *
+ * @param slot Location of the records
+ *
+ * @return true if the profile has records, false if it is the base profile or
+ * its slot is corrupted
+ */
+static bool eeconfig_slot_has_records(const eeconfig_profile_slot_t *slot) {
+  return slot->size > 0 &&
+         (uint32_t)slot->offset + slot->size <= EECONFIG_PROFILE_DELTAS_SIZE;
+}
+
+/**
+ * @brief Materialise a profile from its delta records
+ *
+ * Invalid records are ignored, leaving the profile as far as it has been
+ * decoded.
+ *
+ * @param profile Profile index
+ * @param dst Buffer to materialise the profile into
+ *
+ * @return true if the records are valid, false otherwise
+ */
+static bool eeconfig_load_profile(uint8_t profile, eeconfig_profile_t *dst) {
+  const eeconfig_profile_slot_t slot = eeconfig_read_slot(profile);
+  const uint32_t records = EECONFIG_DELTAS_ADDR + slot.offset;
+  uint8_t *data = (uint8_t *)dst;
+
+  (void)wear_leveling_read(EECONFIG_BASE_ADDR, dst, EECONFIG_PROFILE_SIZE);
+  if (!eeconfig_slot_has_records(&slot))
+    return slot.size == 0;
+
+  if (slot.size == EECONFIG_PROFILE_SIZE)
+    return wear_leveling_read(records, dst, EECONFIG_PROFILE_SIZE);
+
+  for (uint32_t i = 0; i < slot.size;) {
+    eeconfig_delta_header_t header;
+
+    if (slot.size - i < sizeof(header) ||
+        !wear_leveling_read(records + i, &header, sizeof(header)))
+      return false;
+    i += sizeof(header);
+    if (header.len > slot.size - i ||
+        (uint32_t)header.offset + header.len > EECONFIG_PROFILE_SIZE ||
+        !wear_leveling_read(records + i, data + header.offset, header.len))
+      return false;
+    i += header.len;
+  }
+
+  return true;
+}
+
+/**
+ * @brief Get the end of the delta records of the other profiles
+ *
+ * @param exclude Profile index to exclude
+ *
+ * @return Offset past the last record of the other profiles
+ */
+static uint32_t eeconfig_deltas_end(uint8_t exclude) {
+  uint32_t end = 0;
+
+  for (uint32_t i = 0; i < NUM_PROFILES; i++) {
+    const eeconfig_profile_slot_t slot = eeconfig_read_slot(i);
+    if (i != exclude && eeconfig_slot_has_records(&slot))
+      end = M_MAX(end, (uint32_t)slot.offset + slot.size);
+  }
+
+  return end;
+}
+
+/**
+ * @brief Get the size of the delta records of the other profiles
+ *
+ * @param exclude Profile index to exclude
+ *
+ * @return End of the records of the other profiles once compacted
+ */
+static uint32_t eeconfig_deltas_used(uint8_t exclude) {
+  uint32_t used = 0;
+
+  for (uint32_t i = 0; i < NUM_PROFILES; i++) {
+    const eeconfig_profile_slot_t slot = eeconfig_read_slot(i);
+    if (i != exclude && eeconfig_slot_has_records(&slot))
+      used += slot.size;
+  }
+
+  return used;
+}
+
+/**
+ * @brief Move the delta records of the other profiles to the start of the
+ * delta area, closing the gaps between them
+ *
+ * @param exclude Profile index whose records are left out
+ *
+ * @return true if successful, false otherwise
+ */
+static bool eeconfig_compact_deltas(uint8_t exclude) {
+  uint8_t buf[EECONFIG_COMPACT_CHUNK_SIZE];
+
+  // The records are moved towards the start in the order they are stored, so
+  // none of them is overwritten before it has been moved.
+  for (uint32_t end = 0;;) {
+    uint32_t next = NUM_PROFILES;
+    eeconfig_profile_slot_t slot = {0};
+    for (uint32_t i = 0; i < NUM_PROFILES; i++) {
+      const eeconfig_profile_slot_t candidate = eeconfig_read_slot(i);
+      if (i != exclude && eeconfig_slot_has_records(&candidate) &&
+          candidate.offset >= end &&
+          (next == NUM_PROFILES || candidate.offset < slot.offset)) {
+        next = i;
+        slot = candidate;
+      }
+    }
+    if (next == NUM_PROFILES)
+      return true;
+
+    for (uint32_t i = 0; i < slot.size && slot.offset != end;
+         i += sizeof(buf)) {
+      const uint32_t len = M_MIN(slot.size - i, sizeof(buf));
+      if (!wear_leveling_read(EECONFIG_DELTAS_ADDR + slot.offset + i, buf,
+                              len) ||
+          !wear_leveling_write(EECONFIG_DELTAS_ADDR + end + i, buf, len))
+        return false;
+    }
+    slot.offset = end;
+    if (!EECONFIG_WRITE(profile_slots[next], &slot))
+      return false;
+    end += slot.size;
+  }
+}
+
+/**
+ * @brief Encode a profile against the base profile and write its records
+ *
+ * The records are rewritten in place if they fit, or appended after the
+ * records of the other profiles otherwise. The delta area is compacted if
+ * there is no room left at its end. Compacting may move the records of the
+ * other profiles over those of the profile, so nothing is moved unless the new
+ * records fit afterwards.
+ *
+ * @param profile Profile index
+ * @param src Profile to store
+ *
+ * @return true if successful, false if there is no room for the records
+ */
+static bool eeconfig_store_profile(uint8_t profile,
+                                   const eeconfig_profile_t *src) {
+  eeconfig_profile_slot_t slot = eeconfig_read_slot(profile);
+  const uint32_t size = eeconfig_delta_size(src);
+  uint32_t end = eeconfig_deltas_end(profile);
+
+  if (!eeconfig_slot_has_records(&slot))
+    slot.size = 0;
+
+  if (size > slot.size &&
+      (slot.offset < end || slot.offset + size > EECONFIG_PROFILE_DELTAS_SIZE)) {
+    if (end + size > EECONFIG_PROFILE_DELTAS_SIZE) {
+      if (eeconfig_deltas_used(profile) + size >
+              EECONFIG_PROFILE_DELTAS_SIZE ||
+          !eeconfig_compact_deltas(profile))
+        return false;
+      end = eeconfig_deltas_end(profile);
+    }
+    slot.offset = end;
+  }
+  slot.size = size;
+
+  return eeconfig_write_deltas(src, EECONFIG_DELTAS_ADDR + slot.offset, size) &&
+         EECONFIG_WRITE(profile_slots[profile], &slot);
+}
+
+/**
+ * @brief Select the saved current profile, and materialise it
+ *
+ * @return None
+ */
+static void eeconfig_load_profiles(void) {
+  current_profile = eeconfig->current_profile;
+  last_non_default_profile = eeconfig->last_non_default_profile;
+  eeconfig_load_profile(current_profile, &current_profile_view);
+}
+
+/**
+ * @brief Get the buffer holding a materialised profile
+ *
+ * @param profile Profile index
+ *
+ * @return The current profile view, or the scratch buffer loaded with the
+ * profile
+ */
+static eeconfig_profile_t *eeconfig_get_profile_buffer(uint8_t profile) {
+  if (profile == current_profile)
+    return &current_profile_view;
+
+  eeconfig_load_profile(profile, &profile_scratch);
+  return &profile_scratch;
+}
+
+/**
+ * @brief Store a materialised profile
+ *
+ * If the profile cannot be stored, the current profile view is reloaded so
+ * that it keeps matching the storage.
+ *
+ * @param profile Profile index
+ * @param src Profile to store
+ *
+ * @return true if successful, false otherwise
+ */
+static bool eeconfig_commit_profile(uint8_t profile,
+                                    const eeconfig_profile_t *src) {
+  if (eeconfig_store_profile(profile, src))
+    return true;
+
+  if (profile == current_profile)
+    eeconfig_load_profile(profile, &current_profile_view);
+  return false;
+}
+
+//--------------------------------------------------------------------+
+// Persistent Configuration API
+//--------------------------------------------------------------------+
+
 static bool eeconfig_is_latest_version(void) {
+  uint32_t magic_end = 0;
+
+  (void)wear_leveling_read(offsetof(eeconfig_t, magic_end), &magic_end,
+                           sizeof(magic_end));
   return eeconfig->magic_start == EECONFIG_MAGIC_START &&
-         eeconfig->magic_end == EECONFIG_MAGIC_END &&
+         magic_end == EECONFIG_MAGIC_END &&
          eeconfig->version == EECONFIG_VERSION;
 }
 
 void eeconfig_init(void) {
-  // Update default profile with its default values
-  for (uint32_t i = 0; i < NUM_KEYS; i++)
-    default_profile.actuation_map[i].actuation_point = DEFAULT_ACTUATION_POINT;
-
   eeconfig = (const eeconfig_t *)wl_cache;
-  if (!eeconfig_is_latest_version() && !migration_try_migrate())
-    eeconfig_reset();
+  eeconfig_profile = &current_profile_view;
+  if (!eeconfig_is_latest_version()) {
+    if (migration_try_migrate()) {
+      // Migrated profiles are stored as a whole. Encode them against the base
+      // profile to make room for the profiles written later.
+      for (uint32_t i = 0; i < NUM_PROFILES; i++) {
+        eeconfig_load_profile(i, &profile_scratch);
+        eeconfig_store_profile(i, &profile_scratch);
+      }
+      eeconfig_compact_deltas(NUM_PROFILES);
+    } else {
+      eeconfig_reset();
+    }
+  }
+
+  if (eeconfig->current_profile >= NUM_PROFILES) {
+    const uint8_t profile = 0;
+    EECONFIG_WRITE(current_profile, &profile);
+  }
+  eeconfig_load_profiles();
 }
 
 // Helper macro for writing rvalue
@@ -71,6 +453,7 @@ void eeconfig_init(void) {
   } while (0)
 
 bool eeconfig_reset(void) {
+  static const eeconfig_profile_slot_t empty_slots[NUM_PROFILES] = {{0}};
   uint16_t bottom_out_threshold[NUM_KEYS] = {0};
 
   // We must not perform any action here that requires reading from
@@ -83,9 +466,16 @@ bool eeconfig_reset(void) {
   status &= EECONFIG_WRITE(options, &default_options);
   EECONFIG_WRITE_LOCAL(current_profile, 0);
   EECONFIG_WRITE_LOCAL(last_non_default_profile, M_MIN(1, NUM_PROFILES - 1));
-  for (uint32_t i = 0; i < NUM_PROFILES; i++)
-    status &= eeconfig_write_default_profile(i);
+  // The default first profile is the base profile of the others
+  eeconfig_init_default_profile(&profile_scratch, 0);
+  status &= EECONFIG_WRITE(base_profile, &profile_scratch);
+  status &= EECONFIG_WRITE(profile_slots, empty_slots);
+  for (uint32_t i = 1; i < NUM_PROFILES; i++) {
+    eeconfig_init_default_profile(&profile_scratch, i);
+    status &= eeconfig_store_profile(i, &profile_scratch);
+  }
   EECONFIG_WRITE_LOCAL(magic_end, EECONFIG_MAGIC_END);
+  eeconfig_load_profiles();
 
   return status;
 }
@@ -96,7 +486,9 @@ bool eeconfig_reset_profile(uint8_t profile) {
   if (profile >= NUM_PROFILES)
     return false;
 
-  return eeconfig_write_default_profile(profile);
+  eeconfig_profile_t *buf = eeconfig_get_profile_buffer(profile);
+  eeconfig_init_default_profile(buf, profile);
+  return eeconfig_commit_profile(profile, buf);
 }
 
 bool eeconfig_reset_profile_rgb(uint8_t profile) {
@@ -104,9 +496,71 @@ bool eeconfig_reset_profile_rgb(uint8_t profile) {
   (void)profile;
   return false;
 #else
+  return EECONFIG_WRITE_PROFILE(profile, rgb_config, &default_rgb_config);
+#endif
+}
+
+uint8_t eeconfig_get_current_profile(void) { return current_profile; }
+
+uint8_t eeconfig_get_last_non_default_profile(void) {
+  return last_non_default_profile;
+}
+
+const eeconfig_profile_t *eeconfig_get_profile(uint8_t profile) {
+  return eeconfig_get_profile_buffer(profile);
+}
+
+bool eeconfig_switch_profile(uint8_t profile) {
   if (profile >= NUM_PROFILES)
     return false;
 
-  return EECONFIG_WRITE(profiles[profile].rgb_config, &default_rgb_config);
-#endif
+  if (profile != current_profile)
+    eeconfig_load_profile(profile, &current_profile_view);
+  current_profile = profile;
+  if (profile != 0)
+    last_non_default_profile = profile;
+  return true;
+}
+
+bool eeconfig_save_current_profile(void) {
+  return EECONFIG_WRITE(current_profile, &current_profile) &&
+         EECONFIG_WRITE(last_non_default_profile, &last_non_default_profile);
+}
+
+bool eeconfig_set_current_profile(uint8_t profile) {
+  return eeconfig_switch_profile(profile) && eeconfig_save_current_profile();
+}
+
+bool eeconfig_read_profile(uint8_t profile, uint32_t offset, void *buf,
+                           uint32_t len) {
+  if (profile >= NUM_PROFILES || offset > EECONFIG_PROFILE_SIZE ||
+      len > EECONFIG_PROFILE_SIZE - offset)
+    return false;
+
+  memcpy(buf, (const uint8_t *)eeconfig_get_profile_buffer(profile) + offset,
+         len);
+  return true;
+}
+
+bool eeconfig_write_profile(uint8_t profile, uint32_t offset, const void *buf,
+                            uint32_t len) {
+  if (profile >= NUM_PROFILES || offset > EECONFIG_PROFILE_SIZE ||
+      len > EECONFIG_PROFILE_SIZE - offset)
+    return false;
+
+  eeconfig_profile_t *dst = eeconfig_get_profile_buffer(profile);
+  memmove((uint8_t *)dst + offset, buf, len);
+  return eeconfig_commit_profile(profile, dst);
+}
+
+bool eeconfig_copy_profile(uint8_t profile, uint8_t src_profile) {
+  if (profile >= NUM_PROFILES || src_profile >= NUM_PROFILES)
+    return false;
+
+  const eeconfig_profile_t *src = eeconfig_get_profile_buffer(src_profile);
+  if (profile != current_profile)
+    return eeconfig_store_profile(profile, src);
+
+  current_profile_view = *src;
+  return eeconfig_commit_profile(profile, &current_profile_view);
 }
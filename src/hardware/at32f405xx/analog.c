@@ -17,6 +17,7 @@
 
 #include "at32f402_405.h"
 #include "analog_scan.h"
+#include "analog_sweep.h"
 
 // GPIO ports for each ADC channel
 static gpio_type *channel_ports[] = {
@@ -157,7 +158,7 @@ static bool analog_digital_input_pressed(uint32_t index) {
 #endif
 }
 
-static bool analog_read_digital_input(uint8_t key, uint16_t *value) {
+static bool analog_read_digital_input(key_index_t key, uint16_t *value) {
   const uint16_t physical_key = (uint16_t)key + 1u;
 
   for (uint32_t i = 0; i < DIGITAL_NUM_INPUTS; i++) {
@@ -177,11 +178,125 @@ static adc_base_config_type adc_base_struct;
 static dma_init_type dma_init_struct;
 static gpio_init_type gpio_init_struct;
 
+#if defined(ADC_SWEEP_RATE_HZ)
+// Conversion time of the ADC sequence, with the ADC clocked at F_CPU / 8
+#define ADC_SEQUENCE_TIME_NS                                                   \
+  ((uint32_t)((uint64_t)ADC_SWEEP_NUM_INPUTS * ADC_CONVERSION_CYCLES * 8 *     \
+                  1000000000ULL / F_CPU +                                      \
+              1))
+
+#if ADC_NUM_MUX_INPUTS > 0
+#define ADC_SETTLE_TIME_NS (ADC_SAMPLE_DELAY * 1000u)
+#else
+#define ADC_SETTLE_TIME_NS 0
+#endif
+
+#define ADC_BUFFER_SIZE (2 * ADC_SWEEP_NUM_SAMPLES)
+
+#if ADC_NUM_MUX_INPUTS > 0
+// Select patterns written to the GPIO set/clear register by the timer DMA
+static uint32_t mux_patterns[ADC_SWEEP_NUM_STEPS];
+#endif
+
+// CPU cycles to wait for a sweep before restarting the sweeps
+static uint32_t sweep_timeout_cycles;
+#else
+#define ADC_BUFFER_SIZE (ADC_NUM_MUX_INPUTS + ADC_NUM_RAW_INPUTS)
+
 // Set to true when `adc_values` is filled for the first time
 static volatile bool adc_initialized = false;
+#endif
+
 // Buffer for DMA transfer
 __attribute__((aligned(8))) static volatile uint16_t
-    adc_buffer[ADC_NUM_MUX_INPUTS + ADC_NUM_RAW_INPUTS];
+    adc_buffer[ADC_BUFFER_SIZE];
+
+#if defined(ADC_SWEEP_RATE_HZ)
+static void analog_init_sweep_timer(void) {
+  analog_sweep_timing_t timing;
+  tmr_output_config_type tmr_output_struct;
+
+  // The timer is clocked at F_CPU like TMR6. A sweep rate that leaves too
+  // little time for the settle delay and the conversions runs at the highest
+  // achievable rate instead.
+  analog_sweep_compute_timing(F_CPU, ADC_SWEEP_RATE_HZ, ADC_SETTLE_TIME_NS,
+                              ADC_SEQUENCE_TIME_NS, &timing);
+  sweep_timeout_cycles = analog_sweep_timeout_cycles(&timing);
+
+  crm_periph_clock_enable(CRM_TMR3_PERIPH_CLOCK, TRUE);
+  tmr_base_init(TMR3, timing.period, timing.prescaler);
+  tmr_cnt_dir_set(TMR3, TMR_COUNT_UP);
+
+  // The channel 1 compare event triggers the ADC sequence once the
+  // multiplexer outputs have settled
+  tmr_output_default_para_init(&tmr_output_struct);
+  tmr_output_struct.oc_mode = TMR_OUTPUT_CONTROL_PWM_MODE_A;
+  tmr_output_struct.oc_output_state = FALSE;
+  tmr_output_channel_config(TMR3, TMR_SELECT_CHANNEL_1, &tmr_output_struct);
+  tmr_channel_value_set(TMR3, TMR_SELECT_CHANNEL_1, timing.trigger);
+  tmr_primary_mode_select(TMR3, TMR_PRIMARY_SEL_C1ORAW);
+
+#if ADC_NUM_MUX_INPUTS > 0
+  // The overflow writes the select pattern of the next step. All the select
+  // pins are on one port, which is checked by `scripts/make.py`.
+  dma_reset(DMA1_CHANNEL2);
+  dma_default_para_init(&dma_init_struct);
+  dma_init_struct.buffer_size = ADC_SWEEP_NUM_STEPS;
+  dma_init_struct.direction = DMA_DIR_MEMORY_TO_PERIPHERAL;
+  dma_init_struct.memory_base_addr = (uint32_t)mux_patterns;
+  dma_init_struct.memory_data_width = DMA_MEMORY_DATA_WIDTH_WORD;
+  dma_init_struct.memory_inc_enable = TRUE;
+  dma_init_struct.peripheral_base_addr = (uint32_t)&mux_select_ports[0]->scr;
+  dma_init_struct.peripheral_data_width = DMA_PERIPHERAL_DATA_WIDTH_WORD;
+  dma_init_struct.peripheral_inc_enable = FALSE;
+  dma_init_struct.priority = DMA_PRIORITY_VERY_HIGH;
+  dma_init_struct.loop_mode_enable = TRUE;
+  dma_init(DMA1_CHANNEL2, &dma_init_struct);
+  dmamux_init(DMA1MUX_CHANNEL2, DMAMUX_DMAREQ_ID_TMR3_OVERFLOW);
+  tmr_dma_request_enable(TMR3, TMR_OVERFLOW_DMA_REQUEST, TRUE);
+#endif
+}
+
+static uint32_t analog_sweep_dma_remaining(void) {
+  return dma_data_number_get(DMA1_CHANNEL1);
+}
+
+static void analog_start_sweeps(void) {
+  // Clear an overrun, which stops the ADC DMA requests
+  adc_flag_clear(ADC1, ADC_OCCO_FLAG);
+  adc_dma_mode_enable(ADC1, TRUE);
+
+  dma_data_number_set(DMA1_CHANNEL1, ADC_BUFFER_SIZE);
+  dma_channel_enable(DMA1_CHANNEL1, TRUE);
+  analog_sweep_reset();
+#if ADC_NUM_MUX_INPUTS > 0
+  // Select the multiplexer input channel of the first step, which is the
+  // pattern written by the last overflow of a sweep
+  mux_select_ports[0]->scr = mux_patterns[ADC_SWEEP_NUM_STEPS - 1];
+  dma_data_number_set(DMA1_CHANNEL2, ADC_SWEEP_NUM_STEPS);
+  dma_channel_enable(DMA1_CHANNEL2, TRUE);
+#endif
+
+  // Start the sweeps
+  tmr_counter_value_set(TMR3, 0);
+  tmr_counter_enable(TMR3, TRUE);
+}
+
+static void analog_restart_sweeps(void) {
+  tmr_counter_enable(TMR3, FALSE);
+  dma_channel_enable(DMA1_CHANNEL1, FALSE);
+#if ADC_NUM_MUX_INPUTS > 0
+  dma_channel_enable(DMA1_CHANNEL2, FALSE);
+#endif
+  // Abort a partial sequence, so that the samples of the first sweep start at
+  // the beginning of the buffer
+  adc_enable(ADC1, FALSE);
+  adc_enable(ADC1, TRUE);
+
+  analog_start_sweeps();
+}
+#endif
+
 void analog_init(void) {
   // Enable peripheral clocks
   crm_periph_clock_enable(CRM_ADC1_PERIPH_CLOCK, TRUE);
@@ -189,7 +304,7 @@ void analog_init(void) {
   crm_periph_clock_enable(CRM_GPIOA_PERIPH_CLOCK, TRUE);
   crm_periph_clock_enable(CRM_GPIOB_PERIPH_CLOCK, TRUE);
   crm_periph_clock_enable(CRM_GPIOC_PERIPH_CLOCK, TRUE);
-#if ADC_NUM_MUX_INPUTS > 0
+#if ADC_NUM_MUX_INPUTS > 0 && !defined(ADC_SWEEP_RATE_HZ)
   crm_periph_clock_enable(CRM_TMR6_PERIPH_CLOCK, TRUE);
 #endif
 
@@ -233,6 +348,11 @@ void analog_init(void) {
 
     gpio_bits_write(mux_select_ports[i], mux_select_pins[i], TRUE);
   }
+
+#if defined(ADC_SWEEP_RATE_HZ)
+  // The select pattern of the first step is applied when starting the sweeps
+  analog_sweep_build_mux_patterns(mux_select_pins, mux_patterns);
+#endif
 #endif
 
 #if ADC_NUM_RAW_INPUTS > 0
@@ -250,13 +370,19 @@ void analog_init(void) {
   }
 #endif
 
+#if defined(ADC_SWEEP_RATE_HZ)
+  // Configure the ADC trigger source as the sweep timer
+  adc_ordinary_conversion_trigger_set(ADC1, ADC12_ORDINARY_TRIG_TMR3TRGOUT,
+                                      TRUE);
+#else
   // Configure the ADC trigger source as software
   adc_ordinary_conversion_trigger_set(ADC1, ADC12_ORDINARY_TRIG_SOFTWARE, TRUE);
+#endif
 
   // Initialize the DMA peripheral
   dma_reset(DMA1_CHANNEL1);
   dma_default_para_init(&dma_init_struct);
-  dma_init_struct.buffer_size = ADC_NUM_MUX_INPUTS + ADC_NUM_RAW_INPUTS;
+  dma_init_struct.buffer_size = ADC_BUFFER_SIZE;
   dma_init_struct.direction = DMA_DIR_PERIPHERAL_TO_MEMORY;
   dma_init_struct.memory_base_addr = (uint32_t)adc_buffer;
   dma_init_struct.memory_data_width = DMA_MEMORY_DATA_WIDTH_HALFWORD;
@@ -271,12 +397,24 @@ void analog_init(void) {
   // Configure the DMA multiplexer to use ADC1
   dmamux_enable(DMA1, TRUE);
   dmamux_init(DMA1MUX_CHANNEL1, DMAMUX_DMAREQ_ID_ADC1);
+#if defined(ADC_SWEEP_RATE_HZ)
+  // Enable DMA half and full transfer interrupts to wake the main loop at the
+  // end of each sweep
+  dma_interrupt_enable(DMA1_CHANNEL1, DMA_HDT_INT | DMA_FDT_INT, TRUE);
+#else
   // Enable DMA transfer complete interrupt
   dma_interrupt_enable(DMA1_CHANNEL1, DMA_FDT_INT, TRUE);
+#endif
 
   // Enable ADC DMA mode
   adc_dma_mode_enable(ADC1, TRUE);
 
+#if defined(ADC_SWEEP_RATE_HZ)
+  analog_init_sweep_timer();
+
+  // Enable interrupts
+  nvic_irq_enable(DMA1_Channel1_IRQn, 0, 0);
+#else
 #if ADC_NUM_MUX_INPUTS > 0
   // Initialize the timer peripheral
   tmr_base_init(TMR6, (F_CPU / 1000000) * ADC_SAMPLE_DELAY - 1, 0);
@@ -289,6 +427,7 @@ void analog_init(void) {
   nvic_irq_enable(DMA1_Channel1_IRQn, 0, 0);
 #if ADC_NUM_MUX_INPUTS > 0
   nvic_irq_enable(TMR6_GLOBAL_IRQn, 0, 0);
+#endif
 #endif
 
   // Enable the ADC peripheral
@@ -302,19 +441,40 @@ void analog_init(void) {
   while (adc_calibration_status_get(ADC1) == SET)
     ;
 
+#if defined(ADC_SWEEP_RATE_HZ)
+  // Enable DMA after ADC initialization
+  analog_start_sweeps();
+
+  // Wait for the first sweep
+  analog_task();
+#else
   // Enable DMA after ADC initialization
   dma_channel_enable(DMA1_CHANNEL1, TRUE);
+
   // Start the ADC conversion
   adc_ordinary_software_trigger_enable(ADC1, TRUE);
 
   // Wait for the ADC values to be initialized
   while (!adc_initialized)
     ;
+#endif
 }
 
+#if defined(ADC_SWEEP_RATE_HZ)
+void analog_task(void) {
+  // Wait for the next sweep, so that the matrix scan that follows is
+  // phase-locked to the sweeps and always sees fresh samples. If no sweep
+  // completes in time, the ADC or the DMA has stopped, so the sweeps are
+  // restarted and the matrix scan runs on the previous samples.
+  if (!analog_sweep_wait(adc_buffer, analog_sweep_dma_remaining,
+                         sweep_timeout_cycles))
+    analog_restart_sweeps();
+}
+#else
 void analog_task(void) {}
+#endif
 
-uint16_t analog_read(uint8_t key) { 
+uint16_t analog_read(key_index_t key) { 
 #if defined(JOYSTICK_SW_KEY_INDEX) && defined(JOYSTICK_SW_PIN) && defined(JOYSTICK_SW_PORT)
   if (key == JOYSTICK_SW_KEY_INDEX) {
     return gpio_input_data_bit_read(JOYSTICK_SW_PORT, JOYSTICK_SW_PIN) == RESET ? ADC_MAX_VALUE : 0;
@@ -339,6 +499,12 @@ uint16_t analog_read_raw(uint8_t index) { return analog_scan_read_raw(index); }
 // Interrupt Handlers
 //--------------------------------------------------------------------+
 
+#if defined(ADC_SWEEP_RATE_HZ)
+void DMA1_Channel1_IRQHandler(void) {
+  // The sweeps are processed by `analog_task()`, this only wakes the CPU
+  dma_flag_clear(DMA1_HDT1_FLAG | DMA1_FDT1_FLAG);
+}
+#else
 void DMA1_Channel1_IRQHandler(void) {
 #if ADC_NUM_MUX_INPUTS > 0
   static uint8_t current_mux_channel = 0;
@@ -389,3 +555,4 @@ void TMR6_GLOBAL_IRQHandler(void) {
   }
 }
 #endif
+#endif
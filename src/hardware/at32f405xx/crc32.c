@@ -17,6 +17,7 @@
 
 #include "at32f402_405.h"
 #include "hardware/hardware.h"
+#include "lib/crc32_word.h"
 
 void crc32_init(void) { crm_periph_clock_enable(CRM_CRC_PERIPH_CLOCK, TRUE); }
 
@@ -34,3 +35,14 @@ uint32_t crc32_compute(const void *buf, uint32_t len, uint32_t crc) {
 
   return crc;
 }
+
+uint32_t crc32_compute_zeros(uint32_t len, uint32_t crc) {
+  return crc32_word_compute_zeros(len, crc);
+}
+
+uint32_t crc32_update_range(uint32_t crc, uint32_t len, uint32_t offset,
+                            const void *old_data, const void *new_data,
+                            uint32_t range_len) {
+  return crc32_word_update_range(crc, len, offset, old_data, new_data,
+                                 range_len);
+}
@@ -14,6 +14,7 @@
  */
 
 #include "hardware/hardware.h"
+#include "i2c_queue.h"
 
 #include "at32f402_405.h"
 
@@ -29,6 +30,19 @@
     !defined(I2C_BUS0_PIN_MUX)
 #error "I2C bus 0 configuration macros are incomplete"
 #endif
+#if defined(I2C_BUS0_DMA_TX_CHANNEL)
+#if !defined(I2C_BUS0_DMA_TX_MUX) || !defined(I2C_BUS0_DMA_TX_REQ) ||          \
+    !defined(I2C_BUS0_EVT_IRQ) || !defined(I2C_BUS0_EVT_IRQ_HANDLER) ||        \
+    !defined(I2C_BUS0_ERR_IRQ) || !defined(I2C_BUS0_ERR_IRQ_HANDLER)
+#error "I2C bus 0 DMA configuration macros are incomplete"
+#endif
+#else
+#define I2C_BUS0_DMA_TX_CHANNEL NULL
+#define I2C_BUS0_DMA_TX_MUX NULL
+#define I2C_BUS0_DMA_TX_REQ 0
+#define I2C_BUS0_EVT_IRQ 0
+#define I2C_BUS0_ERR_IRQ 0
+#endif
 #endif
 
 #if I2C_NUM_BUSES > 1
@@ -39,6 +53,19 @@
     !defined(I2C_BUS1_PIN_MUX)
 #error "I2C bus 1 configuration macros are incomplete"
 #endif
+#if defined(I2C_BUS1_DMA_TX_CHANNEL)
+#if !defined(I2C_BUS1_DMA_TX_MUX) || !defined(I2C_BUS1_DMA_TX_REQ) ||          \
+    !defined(I2C_BUS1_EVT_IRQ) || !defined(I2C_BUS1_EVT_IRQ_HANDLER) ||        \
+    !defined(I2C_BUS1_ERR_IRQ) || !defined(I2C_BUS1_ERR_IRQ_HANDLER)
+#error "I2C bus 1 DMA configuration macros are incomplete"
+#endif
+#else
+#define I2C_BUS1_DMA_TX_CHANNEL NULL
+#define I2C_BUS1_DMA_TX_MUX NULL
+#define I2C_BUS1_DMA_TX_REQ 0
+#define I2C_BUS1_EVT_IRQ 0
+#define I2C_BUS1_ERR_IRQ 0
+#endif
 #endif
 
 #if I2C_NUM_BUSES > 2
@@ -49,6 +76,19 @@
     !defined(I2C_BUS2_PIN_MUX)
 #error "I2C bus 2 configuration macros are incomplete"
 #endif
+#if defined(I2C_BUS2_DMA_TX_CHANNEL)
+#if !defined(I2C_BUS2_DMA_TX_MUX) || !defined(I2C_BUS2_DMA_TX_REQ) ||          \
+    !defined(I2C_BUS2_EVT_IRQ) || !defined(I2C_BUS2_EVT_IRQ_HANDLER) ||        \
+    !defined(I2C_BUS2_ERR_IRQ) || !defined(I2C_BUS2_ERR_IRQ_HANDLER)
+#error "I2C bus 2 DMA configuration macros are incomplete"
+#endif
+#else
+#define I2C_BUS2_DMA_TX_CHANNEL NULL
+#define I2C_BUS2_DMA_TX_MUX NULL
+#define I2C_BUS2_DMA_TX_REQ 0
+#define I2C_BUS2_EVT_IRQ 0
+#define I2C_BUS2_ERR_IRQ 0
+#endif
 #endif
 
 #if I2C_NUM_BUSES > 3
@@ -59,6 +99,19 @@
     !defined(I2C_BUS3_PIN_MUX)
 #error "I2C bus 3 configuration macros are incomplete"
 #endif
+#if defined(I2C_BUS3_DMA_TX_CHANNEL)
+#if !defined(I2C_BUS3_DMA_TX_MUX) || !defined(I2C_BUS3_DMA_TX_REQ) ||          \
+    !defined(I2C_BUS3_EVT_IRQ) || !defined(I2C_BUS3_EVT_IRQ_HANDLER) ||        \
+    !defined(I2C_BUS3_ERR_IRQ) || !defined(I2C_BUS3_ERR_IRQ_HANDLER)
+#error "I2C bus 3 DMA configuration macros are incomplete"
+#endif
+#else
+#define I2C_BUS3_DMA_TX_CHANNEL NULL
+#define I2C_BUS3_DMA_TX_MUX NULL
+#define I2C_BUS3_DMA_TX_REQ 0
+#define I2C_BUS3_EVT_IRQ 0
+#define I2C_BUS3_ERR_IRQ 0
+#endif
 #endif
 
 #if I2C_NUM_BUSES > 0
@@ -117,6 +170,12 @@ typedef struct {
   uint16_t sda_pin;
   uint16_t sda_pin_source;
   uint16_t pin_mux;
+  // DMA channel of the bus, or NULL if the bus is polled
+  dma_channel_type *dma_tx_channel;
+  dmamux_channel_type *dma_tx_mux;
+  dmamux_requst_id_sel_type dma_tx_req;
+  IRQn_Type evt_irq;
+  IRQn_Type err_irq;
   bool configured;
   uint32_t last_frequency_hz;
 } i2c_bus_state_t;
@@ -131,6 +190,11 @@ typedef struct {
       .sda_pin = I2C_BUS##index##_SDA_PIN,                                     \
       .sda_pin_source = I2C_BUS##index##_SDA_PIN_SOURCE,                       \
       .pin_mux = I2C_BUS##index##_PIN_MUX,                                     \
+      .dma_tx_channel = I2C_BUS##index##_DMA_TX_CHANNEL,                       \
+      .dma_tx_mux = I2C_BUS##index##_DMA_TX_MUX,                               \
+      .dma_tx_req = I2C_BUS##index##_DMA_TX_REQ,                               \
+      .evt_irq = I2C_BUS##index##_EVT_IRQ,                                     \
+      .err_irq = I2C_BUS##index##_ERR_IRQ,                                     \
       .configured = false,                                                     \
       .last_frequency_hz = 0,                                                  \
   }
@@ -470,6 +534,94 @@ static bool i2c_send_register_address(i2c_type *instance, uint8_t address,
 
   return i2c_wait_for_flag(instance, I2C_TDC_FLAG, true);
 }
+
+static void i2c_init_dma(i2c_bus_state_t *bus_state) {
+  dma_init_type dma_init_struct;
+
+  if (bus_state->dma_tx_channel == NULL) {
+    return;
+  }
+
+  crm_periph_clock_enable(CRM_DMA1_PERIPH_CLOCK, TRUE);
+  dmamux_enable(DMA1, TRUE);
+  dma_reset(bus_state->dma_tx_channel);
+  dma_default_para_init(&dma_init_struct);
+  dma_init_struct.direction = DMA_DIR_MEMORY_TO_PERIPHERAL;
+  dma_init_struct.memory_data_width = DMA_MEMORY_DATA_WIDTH_BYTE;
+  dma_init_struct.memory_inc_enable = TRUE;
+  dma_init_struct.peripheral_base_addr = (uint32_t)&bus_state->instance->txdt;
+  dma_init_struct.peripheral_data_width = DMA_PERIPHERAL_DATA_WIDTH_BYTE;
+  dma_init_struct.peripheral_inc_enable = FALSE;
+  dma_init_struct.priority = DMA_PRIORITY_MEDIUM;
+  dma_init_struct.loop_mode_enable = FALSE;
+  dma_init(bus_state->dma_tx_channel, &dma_init_struct);
+  dmamux_init(bus_state->dma_tx_mux, bus_state->dma_tx_req);
+  // The interrupts of the peripheral are only enabled during DMA transfers, so
+  // the blocking transfers keep polling its flags
+  nvic_irq_enable(bus_state->evt_irq, 1, 0);
+  nvic_irq_enable(bus_state->err_irq, 1, 0);
+}
+
+static void i2c_finish_dma(i2c_bus_state_t *bus_state) {
+  i2c_interrupt_enable(bus_state->instance, I2C_STOP_INT | I2C_ERR_INT, FALSE);
+  i2c_dma_enable(bus_state->instance, I2C_DMA_REQUEST_TX, FALSE);
+  dma_channel_enable(bus_state->dma_tx_channel, FALSE);
+}
+
+static __attribute__((unused)) void i2c_evt_irq(uint8_t bus) {
+  i2c_bus_state_t *bus_state = &i2c_buses[bus];
+  i2c_type *instance = bus_state->instance;
+  bool success;
+
+  if (i2c_flag_get(instance, I2C_STOPF_FLAG) == RESET) {
+    return;
+  }
+
+  // A NACK also ends the transfer with a stop condition
+  success = i2c_flag_get(instance, I2C_ACKFAIL_FLAG) == RESET;
+  i2c_finish_dma(bus_state);
+  i2c_clear_flag_if_set(instance, I2C_ACKFAIL_FLAG);
+  i2c_flag_clear(instance, I2C_STOPF_FLAG);
+  i2c_reset_ctrl2(instance);
+  i2c_queue_complete(bus, success);
+}
+
+static __attribute__((unused)) void i2c_err_irq(uint8_t bus) {
+  i2c_bus_state_t *bus_state = &i2c_buses[bus];
+
+  i2c_finish_dma(bus_state);
+  i2c_abort_transfer(bus_state->instance);
+  i2c_queue_complete(bus, false);
+}
+
+// Blocking transfers wait for the queued transfers of the bus to complete
+static bool i2c_acquire_idle(const i2c_bus_config_t *config) {
+  if (config == NULL) {
+    return false;
+  }
+
+  while (i2c_bus_busy(config->bus)) {
+  }
+
+  return i2c_bus_acquire(config);
+}
+
+#if I2C_NUM_BUSES > 0 && defined(I2C_BUS0_EVT_IRQ_HANDLER)
+void I2C_BUS0_EVT_IRQ_HANDLER(void) { i2c_evt_irq(0); }
+void I2C_BUS0_ERR_IRQ_HANDLER(void) { i2c_err_irq(0); }
+#endif
+#if I2C_NUM_BUSES > 1 && defined(I2C_BUS1_EVT_IRQ_HANDLER)
+void I2C_BUS1_EVT_IRQ_HANDLER(void) { i2c_evt_irq(1); }
+void I2C_BUS1_ERR_IRQ_HANDLER(void) { i2c_err_irq(1); }
+#endif
+#if I2C_NUM_BUSES > 2 && defined(I2C_BUS2_EVT_IRQ_HANDLER)
+void I2C_BUS2_EVT_IRQ_HANDLER(void) { i2c_evt_irq(2); }
+void I2C_BUS2_ERR_IRQ_HANDLER(void) { i2c_err_irq(2); }
+#endif
+#if I2C_NUM_BUSES > 3 && defined(I2C_BUS3_EVT_IRQ_HANDLER)
+void I2C_BUS3_EVT_IRQ_HANDLER(void) { i2c_evt_irq(3); }
+void I2C_BUS3_ERR_IRQ_HANDLER(void) { i2c_err_irq(3); }
+#endif
 #endif
 
 void i2c_bus_init(void) {
@@ -485,6 +637,7 @@ void i2c_bus_init(void) {
                           bus_state->scl_pin_source, bus_state->pin_mux);
     i2c_configure_mux_pin(bus_state->sda_port, bus_state->sda_pin,
                           bus_state->sda_pin_source, bus_state->pin_mux);
+    i2c_init_dma(bus_state);
   }
 
   i2c_driver_initialized = true;
@@ -513,7 +666,8 @@ void i2c_bus_release(const i2c_bus_config_t *config) { (void)config; }
 bool i2c_bus_write(const i2c_bus_config_t *config, uint8_t address,
                    const uint8_t *tx, size_t len) {
 #if I2C_NUM_BUSES > 0
-  if (address > 0x7Fu || (len > 0u && tx == NULL) || !i2c_bus_acquire(config)) {
+  if (address > 0x7Fu || (len > 0u && tx == NULL) ||
+      !i2c_acquire_idle(config)) {
     return false;
   }
 
@@ -531,7 +685,8 @@ bool i2c_bus_write(const i2c_bus_config_t *config, uint8_t address,
 bool i2c_bus_read(const i2c_bus_config_t *config, uint8_t address, uint8_t *rx,
                   size_t len) {
 #if I2C_NUM_BUSES > 0
-  if (address > 0x7Fu || (len > 0u && rx == NULL) || !i2c_bus_acquire(config)) {
+  if (address > 0x7Fu || (len > 0u && rx == NULL) ||
+      !i2c_acquire_idle(config)) {
     return false;
   }
 
@@ -554,7 +709,7 @@ bool i2c_bus_write_register(const i2c_bus_config_t *config, uint8_t address,
   size_t reg_len = (size_t)register_width;
 
   if (address > 0x7Fu || register_width > I2C_REGISTER_16BIT ||
-      (len > 0u && tx == NULL) || !i2c_bus_acquire(config)) {
+      (len > 0u && tx == NULL) || !i2c_acquire_idle(config)) {
     return false;
   }
 
@@ -587,7 +742,7 @@ bool i2c_bus_read_register(const i2c_bus_config_t *config, uint8_t address,
   size_t read = 0;
 
   if (address > 0x7Fu || register_width > I2C_REGISTER_16BIT ||
-      (len > 0u && rx == NULL) || !i2c_bus_acquire(config)) {
+      (len > 0u && rx == NULL) || !i2c_acquire_idle(config)) {
     return false;
   }
   if (len == 0u) {
@@ -633,3 +788,61 @@ bool i2c_bus_read_register(const i2c_bus_config_t *config, uint8_t address,
   return false;
 #endif
 }
+
+i2c_driver_status_t i2c_driver_start(uint8_t bus,
+                                     const i2c_transaction_t *transaction) {
+#if I2C_NUM_BUSES > 0
+  i2c_bus_state_t *bus_state = &i2c_buses[bus];
+  i2c_type *instance = bus_state->instance;
+
+  if (bus_state->dma_tx_channel == NULL) {
+    return i2c_write_bytes(instance, transaction->address, transaction->tx,
+                           transaction->len, NULL, 0u)
+               ? I2C_DRIVER_DONE
+               : I2C_DRIVER_ERROR;
+  }
+
+  if (i2c_flag_get(instance, I2C_BUSYF_FLAG) != RESET) {
+    return I2C_DRIVER_ERROR;
+  }
+
+  // Queued writes fit in the transfer counter, so the stop condition is
+  // generated by the peripheral once the DMA has sent the last byte
+  dma_channel_enable(bus_state->dma_tx_channel, FALSE);
+  bus_state->dma_tx_channel->maddr = (uint32_t)transaction->tx;
+  dma_data_number_set(bus_state->dma_tx_channel, (uint16_t)transaction->len);
+  dma_channel_enable(bus_state->dma_tx_channel, TRUE);
+  i2c_dma_enable(instance, I2C_DMA_REQUEST_TX, TRUE);
+  i2c_interrupt_enable(instance, I2C_STOP_INT | I2C_ERR_INT, TRUE);
+  i2c_transmit_set(instance, transaction->address,
+                   (uint8_t)transaction->len, I2C_AUTO_STOP_MODE,
+                   I2C_GEN_START_WRITE);
+
+  return I2C_DRIVER_PENDING;
+#else
+  (void)bus;
+  (void)transaction;
+  return I2C_DRIVER_ERROR;
+#endif
+}
+
+void i2c_driver_mask_irq(uint8_t bus, bool masked) {
+#if I2C_NUM_BUSES > 0
+  const i2c_bus_state_t *bus_state = &i2c_buses[bus];
+
+  if (bus_state->dma_tx_channel == NULL) {
+    return;
+  }
+
+  if (masked) {
+    NVIC_DisableIRQ(bus_state->evt_irq);
+    NVIC_DisableIRQ(bus_state->err_irq);
+  } else {
+    NVIC_EnableIRQ(bus_state->evt_irq);
+    NVIC_EnableIRQ(bus_state->err_irq);
+  }
+#else
+  (void)bus;
+  (void)masked;
+#endif
+}
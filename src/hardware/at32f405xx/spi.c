@@ -14,6 +14,7 @@
  */
 
 #include "hardware/hardware.h"
+#include "spi_queue.h"
 
 #include "at32f402_405.h"
 
@@ -38,6 +39,26 @@
 #define SPI_BUS0_MOSI_PIN 0
 #define SPI_BUS0_MOSI_PIN_SOURCE 0
 #endif
+#if defined(SPI_BUS0_DMA_TX_CHANNEL)
+#if !defined(SPI_BUS0_DMA_TX_MUX) || !defined(SPI_BUS0_DMA_TX_REQ) ||          \
+    !defined(SPI_BUS0_DMA_RX_CHANNEL) || !defined(SPI_BUS0_DMA_RX_MUX) ||      \
+    !defined(SPI_BUS0_DMA_RX_REQ) || !defined(SPI_BUS0_DMA_RX_IRQ) ||          \
+    !defined(SPI_BUS0_DMA_RX_IRQ_HANDLER) ||                                   \
+    !defined(SPI_BUS0_DMA_RX_DONE_FLAG) ||                                     \
+    !defined(SPI_BUS0_DMA_RX_ERROR_FLAG)
+#error "SPI bus 0 DMA configuration macros are incomplete"
+#endif
+#else
+#define SPI_BUS0_DMA_TX_CHANNEL NULL
+#define SPI_BUS0_DMA_TX_MUX NULL
+#define SPI_BUS0_DMA_TX_REQ 0
+#define SPI_BUS0_DMA_RX_CHANNEL NULL
+#define SPI_BUS0_DMA_RX_MUX NULL
+#define SPI_BUS0_DMA_RX_REQ 0
+#define SPI_BUS0_DMA_RX_IRQ 0
+#define SPI_BUS0_DMA_RX_DONE_FLAG 0
+#define SPI_BUS0_DMA_RX_ERROR_FLAG 0
+#endif
 #endif
 
 #if SPI_NUM_BUSES > 1
@@ -57,6 +78,26 @@
 #define SPI_BUS1_MOSI_PIN 0
 #define SPI_BUS1_MOSI_PIN_SOURCE 0
 #endif
+#if defined(SPI_BUS1_DMA_TX_CHANNEL)
+#if !defined(SPI_BUS1_DMA_TX_MUX) || !defined(SPI_BUS1_DMA_TX_REQ) ||          \
+    !defined(SPI_BUS1_DMA_RX_CHANNEL) || !defined(SPI_BUS1_DMA_RX_MUX) ||      \
+    !defined(SPI_BUS1_DMA_RX_REQ) || !defined(SPI_BUS1_DMA_RX_IRQ) ||          \
+    !defined(SPI_BUS1_DMA_RX_IRQ_HANDLER) ||                                   \
+    !defined(SPI_BUS1_DMA_RX_DONE_FLAG) ||                                     \
+    !defined(SPI_BUS1_DMA_RX_ERROR_FLAG)
+#error "SPI bus 1 DMA configuration macros are incomplete"
+#endif
+#else
+#define SPI_BUS1_DMA_TX_CHANNEL NULL
+#define SPI_BUS1_DMA_TX_MUX NULL
+#define SPI_BUS1_DMA_TX_REQ 0
+#define SPI_BUS1_DMA_RX_CHANNEL NULL
+#define SPI_BUS1_DMA_RX_MUX NULL
+#define SPI_BUS1_DMA_RX_REQ 0
+#define SPI_BUS1_DMA_RX_IRQ 0
+#define SPI_BUS1_DMA_RX_DONE_FLAG 0
+#define SPI_BUS1_DMA_RX_ERROR_FLAG 0
+#endif
 #endif
 
 #if SPI_NUM_BUSES > 2
@@ -76,6 +117,26 @@
 #define SPI_BUS2_MOSI_PIN 0
 #define SPI_BUS2_MOSI_PIN_SOURCE 0
 #endif
+#if defined(SPI_BUS2_DMA_TX_CHANNEL)
+#if !defined(SPI_BUS2_DMA_TX_MUX) || !defined(SPI_BUS2_DMA_TX_REQ) ||          \
+    !defined(SPI_BUS2_DMA_RX_CHANNEL) || !defined(SPI_BUS2_DMA_RX_MUX) ||      \
+    !defined(SPI_BUS2_DMA_RX_REQ) || !defined(SPI_BUS2_DMA_RX_IRQ) ||          \
+    !defined(SPI_BUS2_DMA_RX_IRQ_HANDLER) ||                                   \
+    !defined(SPI_BUS2_DMA_RX_DONE_FLAG) ||                                     \
+    !defined(SPI_BUS2_DMA_RX_ERROR_FLAG)
+#error "SPI bus 2 DMA configuration macros are incomplete"
+#endif
+#else
+#define SPI_BUS2_DMA_TX_CHANNEL NULL
+#define SPI_BUS2_DMA_TX_MUX NULL
+#define SPI_BUS2_DMA_TX_REQ 0
+#define SPI_BUS2_DMA_RX_CHANNEL NULL
+#define SPI_BUS2_DMA_RX_MUX NULL
+#define SPI_BUS2_DMA_RX_REQ 0
+#define SPI_BUS2_DMA_RX_IRQ 0
+#define SPI_BUS2_DMA_RX_DONE_FLAG 0
+#define SPI_BUS2_DMA_RX_ERROR_FLAG 0
+#endif
 #endif
 
 #if SPI_NUM_BUSES > 3
@@ -95,6 +156,26 @@
 #define SPI_BUS3_MOSI_PIN 0
 #define SPI_BUS3_MOSI_PIN_SOURCE 0
 #endif
+#if defined(SPI_BUS3_DMA_TX_CHANNEL)
+#if !defined(SPI_BUS3_DMA_TX_MUX) || !defined(SPI_BUS3_DMA_TX_REQ) ||          \
+    !defined(SPI_BUS3_DMA_RX_CHANNEL) || !defined(SPI_BUS3_DMA_RX_MUX) ||      \
+    !defined(SPI_BUS3_DMA_RX_REQ) || !defined(SPI_BUS3_DMA_RX_IRQ) ||          \
+    !defined(SPI_BUS3_DMA_RX_IRQ_HANDLER) ||                                   \
+    !defined(SPI_BUS3_DMA_RX_DONE_FLAG) ||                                     \
+    !defined(SPI_BUS3_DMA_RX_ERROR_FLAG)
+#error "SPI bus 3 DMA configuration macros are incomplete"
+#endif
+#else
+#define SPI_BUS3_DMA_TX_CHANNEL NULL
+#define SPI_BUS3_DMA_TX_MUX NULL
+#define SPI_BUS3_DMA_TX_REQ 0
+#define SPI_BUS3_DMA_RX_CHANNEL NULL
+#define SPI_BUS3_DMA_RX_MUX NULL
+#define SPI_BUS3_DMA_RX_REQ 0
+#define SPI_BUS3_DMA_RX_IRQ 0
+#define SPI_BUS3_DMA_RX_DONE_FLAG 0
+#define SPI_BUS3_DMA_RX_ERROR_FLAG 0
+#endif
 #endif
 
 static void spi_enable_gpio_clock(gpio_type *port) {
@@ -153,6 +234,16 @@ typedef struct {
   uint16_t mosi_pin;
   uint16_t mosi_pin_source;
   uint16_t pin_mux;
+  // DMA channels of the bus, or NULL if the bus is polled
+  dma_channel_type *dma_tx_channel;
+  dmamux_channel_type *dma_tx_mux;
+  dmamux_requst_id_sel_type dma_tx_req;
+  dma_channel_type *dma_rx_channel;
+  dmamux_channel_type *dma_rx_mux;
+  dmamux_requst_id_sel_type dma_rx_req;
+  IRQn_Type dma_rx_irq;
+  uint32_t dma_rx_done_flag;
+  uint32_t dma_rx_error_flag;
   bool configured;
   uint32_t last_frequency_hz;
   spi_bus_mode_t last_mode;
@@ -173,6 +264,15 @@ typedef struct {
       .mosi_pin = SPI_BUS##index##_MOSI_PIN,                                   \
       .mosi_pin_source = SPI_BUS##index##_MOSI_PIN_SOURCE,                     \
       .pin_mux = SPI_BUS##index##_PIN_MUX,                                     \
+      .dma_tx_channel = SPI_BUS##index##_DMA_TX_CHANNEL,                       \
+      .dma_tx_mux = SPI_BUS##index##_DMA_TX_MUX,                               \
+      .dma_tx_req = SPI_BUS##index##_DMA_TX_REQ,                               \
+      .dma_rx_channel = SPI_BUS##index##_DMA_RX_CHANNEL,                       \
+      .dma_rx_mux = SPI_BUS##index##_DMA_RX_MUX,                               \
+      .dma_rx_req = SPI_BUS##index##_DMA_RX_REQ,                               \
+      .dma_rx_irq = SPI_BUS##index##_DMA_RX_IRQ,                               \
+      .dma_rx_done_flag = SPI_BUS##index##_DMA_RX_DONE_FLAG,                   \
+      .dma_rx_error_flag = SPI_BUS##index##_DMA_RX_ERROR_FLAG,                 \
       .configured = false,                                                     \
       .last_frequency_hz = 0,                                                  \
       .last_mode = SPI_BUS_MODE_0,                                             \
@@ -196,6 +296,10 @@ static spi_bus_state_t spi_buses[] = {
 
 static bool spi_driver_initialized = false;
 
+// Source and sink of the transfers without data to transmit or receive
+static const uint8_t spi_dma_dummy_tx = 0xFF;
+static uint8_t spi_dma_dummy_rx;
+
 static void spi_enable_bus_clock(uint8_t bus) {
   switch (bus) {
 #if SPI_NUM_BUSES > 0
@@ -319,6 +423,106 @@ static bool spi_configure_bus(spi_bus_state_t *bus_state,
   bus_state->last_lsb_first = config->lsb_first;
   return true;
 }
+
+static void spi_init_dma_channel(dma_channel_type *channel,
+                                 dmamux_channel_type *mux,
+                                 dmamux_requst_id_sel_type req,
+                                 dma_dir_type direction, spi_type *instance) {
+  dma_init_type dma_init_struct;
+
+  dma_reset(channel);
+  dma_default_para_init(&dma_init_struct);
+  dma_init_struct.direction = direction;
+  dma_init_struct.memory_data_width = DMA_MEMORY_DATA_WIDTH_BYTE;
+  dma_init_struct.memory_inc_enable = TRUE;
+  dma_init_struct.peripheral_base_addr = (uint32_t)&instance->dt;
+  dma_init_struct.peripheral_data_width = DMA_PERIPHERAL_DATA_WIDTH_BYTE;
+  dma_init_struct.peripheral_inc_enable = FALSE;
+  dma_init_struct.priority = DMA_PRIORITY_MEDIUM;
+  dma_init_struct.loop_mode_enable = FALSE;
+  dma_init(channel, &dma_init_struct);
+  dmamux_init(mux, req);
+}
+
+static void spi_init_dma(spi_bus_state_t *bus_state) {
+  if (bus_state->dma_tx_channel == NULL) {
+    return;
+  }
+
+  crm_periph_clock_enable(CRM_DMA1_PERIPH_CLOCK, TRUE);
+  dmamux_enable(DMA1, TRUE);
+  spi_init_dma_channel(bus_state->dma_tx_channel, bus_state->dma_tx_mux,
+                       bus_state->dma_tx_req, DMA_DIR_MEMORY_TO_PERIPHERAL,
+                       bus_state->instance);
+  spi_init_dma_channel(bus_state->dma_rx_channel, bus_state->dma_rx_mux,
+                       bus_state->dma_rx_req, DMA_DIR_PERIPHERAL_TO_MEMORY,
+                       bus_state->instance);
+  // The receive channel completes after the last byte has been shifted in
+  dma_interrupt_enable(bus_state->dma_rx_channel, DMA_FDT_INT | DMA_DTERR_INT,
+                       TRUE);
+  nvic_irq_enable(bus_state->dma_rx_irq, 1, 0);
+}
+
+static void spi_start_dma_channel(dma_channel_type *channel, uint32_t addr,
+                                  bool increment, uint16_t len) {
+  dma_channel_enable(channel, FALSE);
+  channel->maddr = addr;
+  channel->ctrl_bit.mincm = increment;
+  dma_data_number_set(channel, len);
+  dma_channel_enable(channel, TRUE);
+}
+
+static void spi_transfer_polled(spi_type *instance,
+                                const spi_transaction_t *transaction) {
+  for (size_t i = 0; i < transaction->len; i++) {
+    uint16_t tx_word =
+        transaction->tx != NULL ? transaction->tx[i] : spi_dma_dummy_tx;
+    while (spi_i2s_flag_get(instance, SPI_I2S_TDBE_FLAG) == RESET) {
+    }
+    spi_i2s_data_transmit(instance, tx_word);
+    while (spi_i2s_flag_get(instance, SPI_I2S_RDBF_FLAG) == RESET) {
+    }
+    if (transaction->rx != NULL) {
+      transaction->rx[i] = (uint8_t)spi_i2s_data_receive(instance);
+    } else {
+      (void)spi_i2s_data_receive(instance);
+    }
+  }
+}
+
+static __attribute__((unused)) void spi_dma_irq(uint8_t bus) {
+  spi_bus_state_t *bus_state = &spi_buses[bus];
+  bool success;
+
+  if (dma_interrupt_flag_get(bus_state->dma_rx_error_flag) == SET) {
+    dma_flag_clear(bus_state->dma_rx_error_flag);
+    success = false;
+  } else if (dma_interrupt_flag_get(bus_state->dma_rx_done_flag) == SET) {
+    dma_flag_clear(bus_state->dma_rx_done_flag);
+    success = true;
+  } else {
+    return;
+  }
+
+  dma_channel_enable(bus_state->dma_tx_channel, FALSE);
+  dma_channel_enable(bus_state->dma_rx_channel, FALSE);
+  spi_i2s_dma_transmitter_enable(bus_state->instance, FALSE);
+  spi_i2s_dma_receiver_enable(bus_state->instance, FALSE);
+  spi_queue_complete(bus, success);
+}
+
+#if SPI_NUM_BUSES > 0 && defined(SPI_BUS0_DMA_RX_IRQ_HANDLER)
+void SPI_BUS0_DMA_RX_IRQ_HANDLER(void) { spi_dma_irq(0); }
+#endif
+#if SPI_NUM_BUSES > 1 && defined(SPI_BUS1_DMA_RX_IRQ_HANDLER)
+void SPI_BUS1_DMA_RX_IRQ_HANDLER(void) { spi_dma_irq(1); }
+#endif
+#if SPI_NUM_BUSES > 2 && defined(SPI_BUS2_DMA_RX_IRQ_HANDLER)
+void SPI_BUS2_DMA_RX_IRQ_HANDLER(void) { spi_dma_irq(2); }
+#endif
+#if SPI_NUM_BUSES > 3 && defined(SPI_BUS3_DMA_RX_IRQ_HANDLER)
+void SPI_BUS3_DMA_RX_IRQ_HANDLER(void) { spi_dma_irq(3); }
+#endif
 #endif
 
 void spi_bus_init(void) {
@@ -328,7 +532,7 @@ void spi_bus_init(void) {
   }
 
   for (uint8_t bus = 0; bus < M_ARRAY_SIZE(spi_buses); bus++) {
-    const spi_bus_state_t *bus_state = &spi_buses[bus];
+    spi_bus_state_t *bus_state = &spi_buses[bus];
     spi_enable_bus_clock(bus);
     spi_configure_mux_pin(bus_state->sck_port, bus_state->sck_pin,
                           bus_state->sck_pin_source, bus_state->pin_mux);
@@ -336,6 +540,7 @@ void spi_bus_init(void) {
                           bus_state->miso_pin_source, bus_state->pin_mux);
     spi_configure_mux_pin(bus_state->mosi_port, bus_state->mosi_pin,
                           bus_state->mosi_pin_source, bus_state->pin_mux);
+    spi_init_dma(bus_state);
   }
 
   spi_driver_initialized = true;
@@ -361,41 +566,54 @@ bool spi_bus_acquire(const spi_bus_config_t *config) {
 
 void spi_bus_release(const spi_bus_config_t *config) { (void)config; }
 
-bool spi_bus_transfer(const spi_bus_config_t *config, const uint8_t *tx,
-                      uint8_t *rx, size_t len) {
+spi_driver_status_t spi_driver_start(uint8_t bus,
+                                     const spi_transaction_t *transaction) {
 #if SPI_NUM_BUSES > 0
-  spi_type *instance;
+  spi_bus_state_t *bus_state = &spi_buses[bus];
+
+  if (bus_state->dma_tx_channel == NULL) {
+    spi_transfer_polled(bus_state->instance, transaction);
+    return SPI_DRIVER_DONE;
+  }
+
+  // Start receiving before transmitting so no byte is missed
+  spi_start_dma_channel(bus_state->dma_rx_channel,
+                        transaction->rx != NULL
+                            ? (uint32_t)transaction->rx
+                            : (uint32_t)&spi_dma_dummy_rx,
+                        transaction->rx != NULL, (uint16_t)transaction->len);
+  spi_i2s_dma_receiver_enable(bus_state->instance, TRUE);
+  spi_start_dma_channel(bus_state->dma_tx_channel,
+                        transaction->tx != NULL
+                            ? (uint32_t)transaction->tx
+                            : (uint32_t)&spi_dma_dummy_tx,
+                        transaction->tx != NULL, (uint16_t)transaction->len);
+  spi_i2s_dma_transmitter_enable(bus_state->instance, TRUE);
+
+  return SPI_DRIVER_PENDING;
+#else
+  (void)bus;
+  (void)transaction;
+  return SPI_DRIVER_ERROR;
+#endif
+}
 
-  if (len == 0u) {
-    return true;
-  }
+void spi_driver_mask_irq(uint8_t bus, bool masked) {
+#if SPI_NUM_BUSES > 0
+  const spi_bus_state_t *bus_state = &spi_buses[bus];
 
-  if (!spi_bus_acquire(config)) {
-    return false;
+  if (bus_state->dma_tx_channel == NULL) {
+    return;
   }
 
-  instance = spi_buses[config->bus].instance;
-  for (size_t i = 0; i < len; i++) {
-    uint16_t tx_word = tx != NULL ? tx[i] : 0xFFu;
-    while (spi_i2s_flag_get(instance, SPI_I2S_TDBE_FLAG) == RESET) {
-    }
-    spi_i2s_data_transmit(instance, tx_word);
-    while (spi_i2s_flag_get(instance, SPI_I2S_RDBF_FLAG) == RESET) {
-    }
-    if (rx != NULL) {
-      rx[i] = (uint8_t)spi_i2s_data_receive(instance);
-    } else {
-      (void)spi_i2s_data_receive(instance);
-    }
+  if (masked) {
+    NVIC_DisableIRQ(bus_state->dma_rx_irq);
+  } else {
+    NVIC_EnableIRQ(bus_state->dma_rx_irq);
   }
-
-  return true;
 #else
-  (void)config;
-  (void)tx;
-  (void)rx;
-  (void)len;
-  return false;
+  (void)bus;
+  (void)masked;
 #endif
 }
 
@@ -16,15 +16,25 @@
 #include "hardware/hardware.h"
 
 #include "at32f402_405.h"
+#include "timebase.h"
 
 static volatile uint32_t counter;
 
-void timer_init(void) { SysTick_Config(system_core_clock / 1000); }
+void timer_init(void) {
+  timebase_init();
+  SysTick_Config(system_core_clock / 1000);
+}
 
 uint32_t timer_read(void) { return counter; }
 
+uint64_t timer_read_us(void) { return timebase_read_us(); }
+
 //--------------------------------------------------------------------+
 // Interrupt Handlers
 //--------------------------------------------------------------------+
 
-void SysTick_Handler(void) { counter++; }
+void SysTick_Handler(void) {
+  counter++;
+  // The cycle counter wraps about every 20 seconds, far less often than this
+  timebase_update();
+}
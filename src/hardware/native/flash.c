@@ -0,0 +1,209 @@
+/*
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "hardware/native/flash_sim.h"
+
+#if defined(FLASH_SECTOR_SIZE)
+_Static_assert(FLASH_NUM_SECTORS * FLASH_SECTOR_SIZE == FLASH_SIZE,
+               "The flash sectors must cover FLASH_SIZE.");
+#endif
+
+static uint8_t flash_sim_image[FLASH_SIZE];
+static flash_sim_stats_t flash_sim_stats_data;
+static bool flash_sim_failed_sectors[FLASH_NUM_SECTORS];
+static uint32_t flash_sim_power_budget;
+static bool flash_sim_power_cut;
+
+/**
+ * @brief Consume one flash operation from the power budget
+ *
+ * @return true if the operation completes, false if the power is cut before it
+ */
+static bool flash_sim_power_consume(void) {
+  if (flash_sim_power_cut)
+    return false;
+  if (flash_sim_power_budget == 0) {
+    flash_sim_power_cut = true;
+    return false;
+  }
+
+  if (flash_sim_power_budget != FLASH_SIM_POWER_UNLIMITED)
+    flash_sim_power_budget--;
+  flash_sim_stats_data.operations++;
+  return true;
+}
+
+/**
+ * @brief Find the sector holding an address
+ *
+ * @param addr Address to look up
+ *
+ * @return Sector holding the address, or `FLASH_NUM_SECTORS` if none
+ */
+static uint32_t flash_sim_sector_of(uint32_t addr) {
+  uint32_t end = 0;
+
+  for (uint32_t i = 0; i < FLASH_NUM_SECTORS; i++) {
+    end += flash_sector_size(i);
+    if (addr < end)
+      return i;
+  }
+
+  return FLASH_NUM_SECTORS;
+}
+
+static void flash_sim_account(uint32_t us) {
+  flash_sim_stats_data.busy_us += us;
+  flash_sim_stats_data.max_operation_us =
+      M_MAX(flash_sim_stats_data.max_operation_us, us);
+}
+
+void flash_sim_reset(void) {
+  uint32_t *image32 = (uint32_t *)flash_sim_image;
+  for (uint32_t i = 0; i < FLASH_SIZE / 4; i++)
+    image32[i] = FLASH_EMPTY_VAL;
+
+  memset(flash_sim_failed_sectors, 0, sizeof(flash_sim_failed_sectors));
+  flash_sim_restore_power();
+  flash_sim_clear_stats();
+}
+
+void flash_sim_clear_stats(void) {
+  memset(&flash_sim_stats_data, 0, sizeof(flash_sim_stats_data));
+}
+
+const flash_sim_stats_t *flash_sim_stats(void) {
+  return &flash_sim_stats_data;
+}
+
+uint32_t flash_sim_max_sector_erases(void) {
+  uint32_t max_erases = 0;
+
+  for (uint32_t i = 0; i < FLASH_NUM_SECTORS; i++)
+    max_erases = M_MAX(max_erases, flash_sim_stats_data.sector_erases[i]);
+
+  return max_erases;
+}
+
+uint8_t *flash_sim_memory(void) { return flash_sim_image; }
+
+uint32_t flash_sim_sector_address(uint32_t sector) {
+  if (sector >= FLASH_NUM_SECTORS)
+    return FLASH_SIZE;
+
+  uint32_t addr = 0;
+  for (uint32_t i = 0; i < sector; i++)
+    addr += flash_sector_size(i);
+
+  return addr;
+}
+
+void flash_sim_cut_power_after(uint32_t num_operations) {
+  flash_sim_power_budget = num_operations;
+}
+
+void flash_sim_restore_power(void) {
+  flash_sim_power_budget = FLASH_SIM_POWER_UNLIMITED;
+  flash_sim_power_cut = false;
+}
+
+bool flash_sim_power_lost(void) { return flash_sim_power_cut; }
+
+void flash_sim_set_sector_failed(uint32_t sector, bool failed) {
+  if (sector < FLASH_NUM_SECTORS)
+    flash_sim_failed_sectors[sector] = failed;
+}
+
+//--------------------------------------------------------------------+
+// Flash API
+//--------------------------------------------------------------------+
+
+void flash_init(void) {}
+
+bool flash_erase(uint32_t sector) {
+  if (sector >= FLASH_NUM_SECTORS || flash_sim_failed_sectors[sector])
+    return false;
+
+  const uint32_t size = flash_sector_size(sector);
+  uint8_t *start = flash_sim_image + flash_sim_sector_address(sector);
+  if (!flash_sim_power_cut && !flash_sim_power_consume()) {
+    // The erase is interrupted half way through the sector
+    memset(start, 0xFF, size / 2);
+    return true;
+  }
+  if (flash_sim_power_cut)
+    return true;
+
+  memset(start, 0xFF, size);
+  flash_sim_stats_data.erases++;
+  flash_sim_stats_data.sector_erases[sector]++;
+  flash_sim_account(size / 1024 * FLASH_SIM_ERASE_US_PER_KB);
+
+  return true;
+}
+
+bool flash_read(uint32_t addr, void *buf, uint32_t len) {
+  if (addr + len * 4 > FLASH_SIZE)
+    return false;
+
+  memcpy(buf, flash_sim_image + addr, len * 4);
+  flash_sim_stats_data.read_words += len;
+
+  return true;
+}
+
+const void *flash_map(uint32_t addr, uint32_t len) {
+  if (addr + len * 4 > FLASH_SIZE)
+    return NULL;
+
+  return flash_sim_image + addr;
+}
+
+bool flash_write(uint32_t addr, const void *buf, uint32_t len) {
+  if (addr + len * 4 > FLASH_SIZE)
+    return false;
+
+  const uint8_t *buf8 = buf;
+  bool success = true;
+  uint32_t programmed = 0;
+
+  for (uint32_t i = 0; i < len; i++) {
+    const uint32_t word_addr = addr + i * 4;
+    if (flash_sim_failed_sectors[flash_sim_sector_of(word_addr)]) {
+      success = false;
+      break;
+    }
+    // Words are programmed atomically, and not at all after a power cut
+    if (!flash_sim_power_consume())
+      break;
+
+    bool violation = false;
+    for (uint32_t j = 0; j < 4; j++) {
+      // Programming can only clear bits
+      violation |= (flash_sim_image[word_addr + j] & buf8[i * 4 + j]) !=
+                   buf8[i * 4 + j];
+      flash_sim_image[word_addr + j] &= buf8[i * 4 + j];
+    }
+    if (violation) {
+      flash_sim_stats_data.program_violations++;
+      success = false;
+    }
+    programmed++;
+  }
+  flash_sim_stats_data.programmed_words += programmed;
+  flash_sim_account(programmed * FLASH_SIM_PROGRAM_WORD_US);
+
+  return success;
+}
@@ -0,0 +1,152 @@
+/*
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "hardware/hardware.h"
+
+//--------------------------------------------------------------------+
+// Flash Simulator Configuration
+// Host builds implement `flash_api.h` over a RAM image of the flash, laid out
+// in the sectors given by `FLASH_SECTOR_SIZE` or `FLASH_SECTOR_SIZES`
+//--------------------------------------------------------------------+
+
+#if !defined(FLASH_SIM_ERASE_US_PER_KB)
+// Simulated time to erase 1 KB of a sector in microseconds
+#define FLASH_SIM_ERASE_US_PER_KB 5000
+#endif
+
+#if !defined(FLASH_SIM_PROGRAM_WORD_US)
+// Simulated time to program a word in microseconds
+#define FLASH_SIM_PROGRAM_WORD_US 30
+#endif
+
+#if !defined(FLASH_SIM_ENDURANCE_CYCLES)
+// Erase cycles each sector is rated for, used for lifetime projections
+#define FLASH_SIM_ENDURANCE_CYCLES 10000
+#endif
+
+// Power budget that is never exhausted
+#define FLASH_SIM_POWER_UNLIMITED UINT32_MAX
+
+typedef struct {
+  // Number of times each sector has been erased
+  uint32_t sector_erases[FLASH_NUM_SECTORS];
+  // Number of sector erases
+  uint32_t erases;
+  // Number of words programmed
+  uint32_t programmed_words;
+  // Number of words read with `flash_read()`
+  uint32_t read_words;
+  // Number of sector erases and word programs that reached the flash
+  uint32_t operations;
+  // Programmed words that would have set a bit from 0 to 1
+  uint32_t program_violations;
+  // Simulated time spent erasing and programming in microseconds
+  uint64_t busy_us;
+  // Longest single `flash_erase()` or `flash_write()` call in microseconds
+  uint32_t max_operation_us;
+} flash_sim_stats_t;
+
+//--------------------------------------------------------------------+
+// Flash Simulator API
+//--------------------------------------------------------------------+
+
+/**
+ * @brief Erase the whole simulated flash and clear the statistics and faults
+ *
+ * @return None
+ */
+void flash_sim_reset(void);
+
+/**
+ * @brief Clear the statistics, keeping the flash contents
+ *
+ * @return None
+ */
+void flash_sim_clear_stats(void);
+
+/**
+ * @brief Get the statistics since the last reset or clear
+ *
+ * @return Pointer to the statistics
+ */
+const flash_sim_stats_t *flash_sim_stats(void);
+
+/**
+ * @brief Get the most erase cycles any sector has been through
+ *
+ * @return Number of erases of the most erased sector
+ */
+uint32_t flash_sim_max_sector_erases(void);
+
+/**
+ * @brief Get the simulated flash contents
+ *
+ * Changes made through the pointer bypass the programming rules, which lets
+ * tests lay out older stores or corrupt data.
+ *
+ * @return Pointer to the `FLASH_SIZE` bytes of the flash
+ */
+uint8_t *flash_sim_memory(void);
+
+/**
+ * @brief Get the address of a sector
+ *
+ * @param sector Sector to get the address of
+ *
+ * @return Address of the sector, or `FLASH_SIZE` if invalid
+ */
+uint32_t flash_sim_sector_address(uint32_t sector);
+
+/**
+ * @brief Cut the power after a number of flash operations
+ *
+ * Each sector erase and each programmed word is one operation. The operation
+ * that exhausts the budget is interrupted: an erase clears only the first half
+ * of the sector, and a word is not programmed at all. Once the power is cut,
+ * nothing reaches the flash anymore, although the calls still succeed since the
+ * firmware would not live to see them fail.
+ *
+ * @param num_operations Number of operations that complete, or
+ * `FLASH_SIM_POWER_UNLIMITED`
+ *
+ * @return None
+ */
+void flash_sim_cut_power_after(uint32_t num_operations);
+
+/**
+ * @brief Restore the power after it has been cut
+ *
+ * @return None
+ */
+void flash_sim_restore_power(void);
+
+/**
+ * @brief Check if the power has been cut
+ *
+ * @return true if the power has been cut, false otherwise
+ */
+bool flash_sim_power_lost(void);
+
+/**
+ * @brief Make a sector fail to erase and program, as a worn out sector does
+ *
+ * @param sector Sector to fail
+ * @param failed Whether the operations on the sector fail
+ *
+ * @return None
+ */
+void flash_sim_set_sector_failed(uint32_t sector, bool failed);
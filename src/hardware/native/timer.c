@@ -0,0 +1,29 @@
+/*
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "hardware/native/timer_sim.h"
+
+static uint64_t timer_sim_us;
+
+void timer_init(void) { timer_sim_us = 0; }
+
+uint32_t timer_read(void) { return (uint32_t)(timer_sim_us / 1000u); }
+
+uint64_t timer_read_us(void) { return timer_sim_us; }
+
+void timer_sim_set_us(uint64_t us) { timer_sim_us = us; }
+
+void timer_sim_advance_us(uint64_t us) { timer_sim_us += us; }
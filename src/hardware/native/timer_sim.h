@@ -0,0 +1,43 @@
+/*
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include "hardware/hardware.h"
+
+//--------------------------------------------------------------------+
+// Timer Simulator API
+// Host builds implement `timer_api.h` over a simulated clock, which only
+// moves when the test moves it
+//--------------------------------------------------------------------+
+
+/**
+ * @brief Set the simulated time
+ *
+ * @param us Time in microseconds
+ *
+ * @return None
+ */
+void timer_sim_set_us(uint64_t us);
+
+/**
+ * @brief Advance the simulated time
+ *
+ * @param us Time to advance by in microseconds
+ *
+ * @return None
+ */
+void timer_sim_advance_us(uint64_t us);
@@ -175,7 +175,7 @@ static bool analog_digital_input_pressed(uint32_t index) {
 #endif
 }
 
-static bool analog_read_digital_input(uint8_t key, uint16_t *value) {
+static bool analog_read_digital_input(key_index_t key, uint16_t *value) {
   const uint16_t physical_key = (uint16_t)key + 1u;
 
   for (uint32_t i = 0; i < DIGITAL_NUM_INPUTS; i++) {
@@ -332,7 +332,7 @@ void analog_init(void) {
 
 void analog_task(void) {}
 
-uint16_t analog_read(uint8_t key) {
+uint16_t analog_read(key_index_t key) {
 #if defined(JOYSTICK_SW_KEY_INDEX) && defined(JOYSTICK_SW_PIN) &&                \
     defined(JOYSTICK_SW_PORT)
   if (key == JOYSTICK_SW_KEY_INDEX) {
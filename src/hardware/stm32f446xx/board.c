@@ -16,6 +16,7 @@
 #include "hardware/hardware.h"
 
 #include "stm32f4xx_hal.h"
+#include "timebase.h"
 #include "tusb.h"
 
 /**
@@ -203,7 +204,10 @@ uint32_t board_cycle_count(void) { return DWT->CYCCNT; }
 // Interrupt Handlers
 //--------------------------------------------------------------------+
 
-void SysTick_Handler(void) { HAL_IncTick(); }
+void SysTick_Handler(void) {
+  HAL_IncTick();
+  timebase_update();
+}
 
 void OTG_FS_IRQHandler(void) { tud_int_handler(0); }
 
@@ -16,6 +16,7 @@
 #include "crc32.h"
 
 #include "hardware/hardware.h"
+#include "lib/crc32_word.h"
 #include "stm32f4xx_hal.h"
 
 static CRC_HandleTypeDef crc_handle;
@@ -41,3 +42,14 @@ uint32_t crc32_compute(const void *buf, uint32_t len, uint32_t crc) {
 
   return crc;
 }
+
+uint32_t crc32_compute_zeros(uint32_t len, uint32_t crc) {
+  return crc32_word_compute_zeros(len, crc);
+}
+
+uint32_t crc32_update_range(uint32_t crc, uint32_t len, uint32_t offset,
+                            const void *old_data, const void *new_data,
+                            uint32_t range_len) {
+  return crc32_word_update_range(crc, len, offset, old_data, new_data,
+                                 range_len);
+}
@@ -14,6 +14,7 @@
  */
 
 #include "hardware/hardware.h"
+#include "i2c_queue.h"
 
 #include "stm32f4xx_hal.h"
 
@@ -28,6 +29,22 @@
     !defined(I2C_BUS0_PIN_AF)
 #error "I2C bus 0 configuration macros are incomplete"
 #endif
+#if defined(I2C_BUS0_DMA_TX_STREAM)
+#if !defined(I2C_BUS0_DMA_TX_CHANNEL) ||                                       \
+    !defined(I2C_BUS0_DMA_CLOCK_ENABLE) || !defined(I2C_BUS0_DMA_TX_IRQ) ||    \
+    !defined(I2C_BUS0_DMA_TX_IRQ_HANDLER) || !defined(I2C_BUS0_EV_IRQ) ||      \
+    !defined(I2C_BUS0_EV_IRQ_HANDLER) || !defined(I2C_BUS0_ER_IRQ) ||          \
+    !defined(I2C_BUS0_ER_IRQ_HANDLER)
+#error "I2C bus 0 DMA configuration macros are incomplete"
+#endif
+#else
+#define I2C_BUS0_DMA_TX_STREAM NULL
+#define I2C_BUS0_DMA_TX_CHANNEL 0
+#define I2C_BUS0_DMA_TX_IRQ 0
+#define I2C_BUS0_EV_IRQ 0
+#define I2C_BUS0_ER_IRQ 0
+#define I2C_BUS0_DMA_CLOCK_ENABLE() ((void)0)
+#endif
 #endif
 
 #if I2C_NUM_BUSES > 1
@@ -37,6 +54,22 @@
     !defined(I2C_BUS1_PIN_AF)
 #error "I2C bus 1 configuration macros are incomplete"
 #endif
+#if defined(I2C_BUS1_DMA_TX_STREAM)
+#if !defined(I2C_BUS1_DMA_TX_CHANNEL) ||                                       \
+    !defined(I2C_BUS1_DMA_CLOCK_ENABLE) || !defined(I2C_BUS1_DMA_TX_IRQ) ||    \
+    !defined(I2C_BUS1_DMA_TX_IRQ_HANDLER) || !defined(I2C_BUS1_EV_IRQ) ||      \
+    !defined(I2C_BUS1_EV_IRQ_HANDLER) || !defined(I2C_BUS1_ER_IRQ) ||          \
+    !defined(I2C_BUS1_ER_IRQ_HANDLER)
+#error "I2C bus 1 DMA configuration macros are incomplete"
+#endif
+#else
+#define I2C_BUS1_DMA_TX_STREAM NULL
+#define I2C_BUS1_DMA_TX_CHANNEL 0
+#define I2C_BUS1_DMA_TX_IRQ 0
+#define I2C_BUS1_EV_IRQ 0
+#define I2C_BUS1_ER_IRQ 0
+#define I2C_BUS1_DMA_CLOCK_ENABLE() ((void)0)
+#endif
 #endif
 
 #if I2C_NUM_BUSES > 2
@@ -46,6 +79,22 @@
     !defined(I2C_BUS2_PIN_AF)
 #error "I2C bus 2 configuration macros are incomplete"
 #endif
+#if defined(I2C_BUS2_DMA_TX_STREAM)
+#if !defined(I2C_BUS2_DMA_TX_CHANNEL) ||                                       \
+    !defined(I2C_BUS2_DMA_CLOCK_ENABLE) || !defined(I2C_BUS2_DMA_TX_IRQ) ||    \
+    !defined(I2C_BUS2_DMA_TX_IRQ_HANDLER) || !defined(I2C_BUS2_EV_IRQ) ||      \
+    !defined(I2C_BUS2_EV_IRQ_HANDLER) || !defined(I2C_BUS2_ER_IRQ) ||          \
+    !defined(I2C_BUS2_ER_IRQ_HANDLER)
+#error "I2C bus 2 DMA configuration macros are incomplete"
+#endif
+#else
+#define I2C_BUS2_DMA_TX_STREAM NULL
+#define I2C_BUS2_DMA_TX_CHANNEL 0
+#define I2C_BUS2_DMA_TX_IRQ 0
+#define I2C_BUS2_EV_IRQ 0
+#define I2C_BUS2_ER_IRQ 0
+#define I2C_BUS2_DMA_CLOCK_ENABLE() ((void)0)
+#endif
 #endif
 
 #if I2C_NUM_BUSES > 3
@@ -55,6 +104,22 @@
     !defined(I2C_BUS3_PIN_AF)
 #error "I2C bus 3 configuration macros are incomplete"
 #endif
+#if defined(I2C_BUS3_DMA_TX_STREAM)
+#if !defined(I2C_BUS3_DMA_TX_CHANNEL) ||                                       \
+    !defined(I2C_BUS3_DMA_CLOCK_ENABLE) || !defined(I2C_BUS3_DMA_TX_IRQ) ||    \
+    !defined(I2C_BUS3_DMA_TX_IRQ_HANDLER) || !defined(I2C_BUS3_EV_IRQ) ||      \
+    !defined(I2C_BUS3_EV_IRQ_HANDLER) || !defined(I2C_BUS3_ER_IRQ) ||          \
+    !defined(I2C_BUS3_ER_IRQ_HANDLER)
+#error "I2C bus 3 DMA configuration macros are incomplete"
+#endif
+#else
+#define I2C_BUS3_DMA_TX_STREAM NULL
+#define I2C_BUS3_DMA_TX_CHANNEL 0
+#define I2C_BUS3_DMA_TX_IRQ 0
+#define I2C_BUS3_EV_IRQ 0
+#define I2C_BUS3_ER_IRQ 0
+#define I2C_BUS3_DMA_CLOCK_ENABLE() ((void)0)
+#endif
 #endif
 
 #if I2C_NUM_BUSES > 0
@@ -125,7 +190,14 @@ typedef struct {
   GPIO_TypeDef *sda_port;
   uint16_t sda_pin;
   uint32_t pin_af;
+  // DMA stream of the bus, or NULL if the bus is polled
+  DMA_Stream_TypeDef *dma_tx_stream;
+  uint32_t dma_tx_channel;
+  IRQn_Type dma_tx_irq;
+  IRQn_Type ev_irq;
+  IRQn_Type er_irq;
   I2C_HandleTypeDef handle;
+  DMA_HandleTypeDef dma_tx;
   bool configured;
   uint32_t last_frequency_hz;
 } i2c_bus_state_t;
@@ -138,7 +210,13 @@ typedef struct {
       .sda_port = I2C_BUS##index##_SDA_PORT,                                   \
       .sda_pin = I2C_BUS##index##_SDA_PIN,                                     \
       .pin_af = I2C_BUS##index##_PIN_AF,                                       \
+      .dma_tx_stream = I2C_BUS##index##_DMA_TX_STREAM,                         \
+      .dma_tx_channel = I2C_BUS##index##_DMA_TX_CHANNEL,                       \
+      .dma_tx_irq = I2C_BUS##index##_DMA_TX_IRQ,                               \
+      .ev_irq = I2C_BUS##index##_EV_IRQ,                                       \
+      .er_irq = I2C_BUS##index##_ER_IRQ,                                       \
       .handle = {0},                                                           \
+      .dma_tx = {0},                                                           \
       .configured = false,                                                     \
       .last_frequency_hz = 0,                                                  \
   }
@@ -187,6 +265,33 @@ static void i2c_enable_bus_clock(uint8_t bus) {
   }
 }
 
+static void i2c_enable_dma_clock(uint8_t bus) {
+  switch (bus) {
+#if I2C_NUM_BUSES > 0
+    case 0:
+      I2C_BUS0_DMA_CLOCK_ENABLE();
+      return;
+#endif
+#if I2C_NUM_BUSES > 1
+    case 1:
+      I2C_BUS1_DMA_CLOCK_ENABLE();
+      return;
+#endif
+#if I2C_NUM_BUSES > 2
+    case 2:
+      I2C_BUS2_DMA_CLOCK_ENABLE();
+      return;
+#endif
+#if I2C_NUM_BUSES > 3
+    case 3:
+      I2C_BUS3_DMA_CLOCK_ENABLE();
+      return;
+#endif
+    default:
+      return;
+  }
+}
+
 static void i2c_configure_af_pin(GPIO_TypeDef *port, uint16_t pin,
                                  uint32_t alternate_function) {
   GPIO_InitTypeDef gpio_init = {0};
@@ -231,6 +336,111 @@ static bool i2c_configure_bus(i2c_bus_state_t *bus_state,
   bus_state->last_frequency_hz = config->frequency_hz;
   return true;
 }
+
+static void i2c_init_dma(uint8_t bus) {
+  i2c_bus_state_t *bus_state = &i2c_buses[bus];
+  DMA_HandleTypeDef *dma = &bus_state->dma_tx;
+
+  if (bus_state->dma_tx_stream == NULL) {
+    return;
+  }
+
+  i2c_enable_dma_clock(bus);
+  dma->Instance = bus_state->dma_tx_stream;
+  dma->Init.Channel = bus_state->dma_tx_channel;
+  dma->Init.Direction = DMA_MEMORY_TO_PERIPH;
+  dma->Init.PeriphInc = DMA_PINC_DISABLE;
+  dma->Init.MemInc = DMA_MINC_ENABLE;
+  dma->Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+  dma->Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+  dma->Init.Mode = DMA_NORMAL;
+  dma->Init.Priority = DMA_PRIORITY_MEDIUM;
+  dma->Init.FIFOMode = DMA_FIFOMODE_DISABLE;
+  (void)HAL_DMA_Init(dma);
+  __HAL_LINKDMA(&bus_state->handle, hdmatx, bus_state->dma_tx);
+  // The stop condition is generated from the event interrupt after the DMA
+  // has sent the last byte
+  HAL_NVIC_SetPriority(bus_state->dma_tx_irq, 1, 0);
+  HAL_NVIC_EnableIRQ(bus_state->dma_tx_irq);
+  HAL_NVIC_SetPriority(bus_state->ev_irq, 1, 0);
+  HAL_NVIC_EnableIRQ(bus_state->ev_irq);
+  HAL_NVIC_SetPriority(bus_state->er_irq, 1, 0);
+  HAL_NVIC_EnableIRQ(bus_state->er_irq);
+}
+
+// Blocking transfers wait for the queued transfers of the bus to complete
+static bool i2c_acquire_idle(const i2c_bus_config_t *config) {
+  if (config == NULL) {
+    return false;
+  }
+
+  while (i2c_bus_busy(config->bus)) {
+  }
+
+  return i2c_bus_acquire(config);
+}
+
+static void i2c_dma_complete(I2C_HandleTypeDef *handle, bool success) {
+  for (uint8_t bus = 0; bus < M_ARRAY_SIZE(i2c_buses); bus++) {
+    if (&i2c_buses[bus].handle == handle) {
+      i2c_queue_complete(bus, success);
+      return;
+    }
+  }
+}
+
+void HAL_I2C_MasterTxCpltCallback(I2C_HandleTypeDef *hi2c) {
+  i2c_dma_complete(hi2c, true);
+}
+
+void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *hi2c) {
+  i2c_dma_complete(hi2c, false);
+}
+
+#if I2C_NUM_BUSES > 0 && defined(I2C_BUS0_DMA_TX_IRQ_HANDLER)
+void I2C_BUS0_DMA_TX_IRQ_HANDLER(void) {
+  HAL_DMA_IRQHandler(&i2c_buses[0].dma_tx);
+}
+void I2C_BUS0_EV_IRQ_HANDLER(void) {
+  HAL_I2C_EV_IRQHandler(&i2c_buses[0].handle);
+}
+void I2C_BUS0_ER_IRQ_HANDLER(void) {
+  HAL_I2C_ER_IRQHandler(&i2c_buses[0].handle);
+}
+#endif
+#if I2C_NUM_BUSES > 1 && defined(I2C_BUS1_DMA_TX_IRQ_HANDLER)
+void I2C_BUS1_DMA_TX_IRQ_HANDLER(void) {
+  HAL_DMA_IRQHandler(&i2c_buses[1].dma_tx);
+}
+void I2C_BUS1_EV_IRQ_HANDLER(void) {
+  HAL_I2C_EV_IRQHandler(&i2c_buses[1].handle);
+}
+void I2C_BUS1_ER_IRQ_HANDLER(void) {
+  HAL_I2C_ER_IRQHandler(&i2c_buses[1].handle);
+}
+#endif
+#if I2C_NUM_BUSES > 2 && defined(I2C_BUS2_DMA_TX_IRQ_HANDLER)
+void I2C_BUS2_DMA_TX_IRQ_HANDLER(void) {
+  HAL_DMA_IRQHandler(&i2c_buses[2].dma_tx);
+}
+void I2C_BUS2_EV_IRQ_HANDLER(void) {
+  HAL_I2C_EV_IRQHandler(&i2c_buses[2].handle);
+}
+void I2C_BUS2_ER_IRQ_HANDLER(void) {
+  HAL_I2C_ER_IRQHandler(&i2c_buses[2].handle);
+}
+#endif
+#if I2C_NUM_BUSES > 3 && defined(I2C_BUS3_DMA_TX_IRQ_HANDLER)
+void I2C_BUS3_DMA_TX_IRQ_HANDLER(void) {
+  HAL_DMA_IRQHandler(&i2c_buses[3].dma_tx);
+}
+void I2C_BUS3_EV_IRQ_HANDLER(void) {
+  HAL_I2C_EV_IRQHandler(&i2c_buses[3].handle);
+}
+void I2C_BUS3_ER_IRQ_HANDLER(void) {
+  HAL_I2C_ER_IRQHandler(&i2c_buses[3].handle);
+}
+#endif
 #endif
 
 void i2c_bus_init(void) {
@@ -247,6 +457,7 @@ void i2c_bus_init(void) {
     i2c_configure_af_pin(bus_state->sda_port, bus_state->sda_pin,
                          bus_state->pin_af);
     bus_state->handle.Instance = bus_state->instance;
+    i2c_init_dma(bus);
   }
 
   i2c_driver_initialized = true;
@@ -276,7 +487,7 @@ bool i2c_bus_write(const i2c_bus_config_t *config, uint8_t address,
                    const uint8_t *tx, size_t len) {
 #if I2C_NUM_BUSES > 0
   if (address > 0x7Fu || len > UINT16_MAX ||
-      (len > 0u && tx == NULL) || !i2c_bus_acquire(config)) {
+      (len > 0u && tx == NULL) || !i2c_acquire_idle(config)) {
     return false;
   }
   if (len == 0u) {
@@ -300,7 +511,7 @@ bool i2c_bus_read(const i2c_bus_config_t *config, uint8_t address, uint8_t *rx,
                   size_t len) {
 #if I2C_NUM_BUSES > 0
   if (address > 0x7Fu || len > UINT16_MAX ||
-      (len > 0u && rx == NULL) || !i2c_bus_acquire(config)) {
+      (len > 0u && rx == NULL) || !i2c_acquire_idle(config)) {
     return false;
   }
   if (len == 0u) {
@@ -329,7 +540,7 @@ bool i2c_bus_write_register(const i2c_bus_config_t *config, uint8_t address,
 
   if (address > 0x7Fu || len > UINT16_MAX ||
       register_width > I2C_REGISTER_16BIT ||
-      (len > 0u && tx == NULL) || !i2c_bus_acquire(config)) {
+      (len > 0u && tx == NULL) || !i2c_acquire_idle(config)) {
     return false;
   }
 
@@ -373,7 +584,7 @@ bool i2c_bus_read_register(const i2c_bus_config_t *config, uint8_t address,
 
   if (address > 0x7Fu || len > UINT16_MAX ||
       register_width > I2C_REGISTER_16BIT ||
-      (len > 0u && rx == NULL) || !i2c_bus_acquire(config)) {
+      (len > 0u && rx == NULL) || !i2c_acquire_idle(config)) {
     return false;
   }
   if (len == 0u) {
@@ -395,3 +606,55 @@ bool i2c_bus_read_register(const i2c_bus_config_t *config, uint8_t address,
   return false;
 #endif
 }
+
+i2c_driver_status_t i2c_driver_start(uint8_t bus,
+                                     const i2c_transaction_t *transaction) {
+#if I2C_NUM_BUSES > 0
+  i2c_bus_state_t *bus_state = &i2c_buses[bus];
+  const uint16_t address = (uint16_t)(transaction->address << 1);
+
+  if (bus_state->dma_tx_stream == NULL) {
+    return HAL_I2C_Master_Transmit(&bus_state->handle, address,
+                                   (uint8_t *)transaction->tx,
+                                   (uint16_t)transaction->len,
+                                   I2C_TRANSFER_TIMEOUT_MS) == HAL_OK
+               ? I2C_DRIVER_DONE
+               : I2C_DRIVER_ERROR;
+  }
+
+  if (HAL_I2C_Master_Transmit_DMA(&bus_state->handle, address,
+                                  (uint8_t *)transaction->tx,
+                                  (uint16_t)transaction->len) != HAL_OK) {
+    return I2C_DRIVER_ERROR;
+  }
+
+  return I2C_DRIVER_PENDING;
+#else
+  (void)bus;
+  (void)transaction;
+  return I2C_DRIVER_ERROR;
+#endif
+}
+
+void i2c_driver_mask_irq(uint8_t bus, bool masked) {
+#if I2C_NUM_BUSES > 0
+  const i2c_bus_state_t *bus_state = &i2c_buses[bus];
+
+  if (bus_state->dma_tx_stream == NULL) {
+    return;
+  }
+
+  if (masked) {
+    HAL_NVIC_DisableIRQ(bus_state->dma_tx_irq);
+    HAL_NVIC_DisableIRQ(bus_state->ev_irq);
+    HAL_NVIC_DisableIRQ(bus_state->er_irq);
+  } else {
+    HAL_NVIC_EnableIRQ(bus_state->dma_tx_irq);
+    HAL_NVIC_EnableIRQ(bus_state->ev_irq);
+    HAL_NVIC_EnableIRQ(bus_state->er_irq);
+  }
+#else
+  (void)bus;
+  (void)masked;
+#endif
+}
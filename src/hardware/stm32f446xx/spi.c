@@ -14,6 +14,7 @@
  */
 
 #include "hardware/hardware.h"
+#include "spi_queue.h"
 
 #include "stm32f4xx_hal.h"
 
@@ -35,6 +36,23 @@
 #define SPI_BUS0_MOSI_PORT NULL
 #define SPI_BUS0_MOSI_PIN 0
 #endif
+#if defined(SPI_BUS0_DMA_TX_STREAM)
+#if !defined(SPI_BUS0_DMA_TX_CHANNEL) || !defined(SPI_BUS0_DMA_RX_STREAM) ||   \
+    !defined(SPI_BUS0_DMA_RX_CHANNEL) ||                                       \
+    !defined(SPI_BUS0_DMA_CLOCK_ENABLE) || !defined(SPI_BUS0_DMA_TX_IRQ) ||    \
+    !defined(SPI_BUS0_DMA_TX_IRQ_HANDLER) || !defined(SPI_BUS0_DMA_RX_IRQ) ||  \
+    !defined(SPI_BUS0_DMA_RX_IRQ_HANDLER)
+#error "SPI bus 0 DMA configuration macros are incomplete"
+#endif
+#else
+#define SPI_BUS0_DMA_TX_STREAM NULL
+#define SPI_BUS0_DMA_TX_CHANNEL 0
+#define SPI_BUS0_DMA_RX_STREAM NULL
+#define SPI_BUS0_DMA_RX_CHANNEL 0
+#define SPI_BUS0_DMA_TX_IRQ 0
+#define SPI_BUS0_DMA_RX_IRQ 0
+#define SPI_BUS0_DMA_CLOCK_ENABLE() ((void)0)
+#endif
 #endif
 
 #if SPI_NUM_BUSES > 1
@@ -51,6 +69,23 @@
 #define SPI_BUS1_MOSI_PORT NULL
 #define SPI_BUS1_MOSI_PIN 0
 #endif
+#if defined(SPI_BUS1_DMA_TX_STREAM)
+#if !defined(SPI_BUS1_DMA_TX_CHANNEL) || !defined(SPI_BUS1_DMA_RX_STREAM) ||   \
+    !defined(SPI_BUS1_DMA_RX_CHANNEL) ||                                       \
+    !defined(SPI_BUS1_DMA_CLOCK_ENABLE) || !defined(SPI_BUS1_DMA_TX_IRQ) ||    \
+    !defined(SPI_BUS1_DMA_TX_IRQ_HANDLER) || !defined(SPI_BUS1_DMA_RX_IRQ) ||  \
+    !defined(SPI_BUS1_DMA_RX_IRQ_HANDLER)
+#error "SPI bus 1 DMA configuration macros are incomplete"
+#endif
+#else
+#define SPI_BUS1_DMA_TX_STREAM NULL
+#define SPI_BUS1_DMA_TX_CHANNEL 0
+#define SPI_BUS1_DMA_RX_STREAM NULL
+#define SPI_BUS1_DMA_RX_CHANNEL 0
+#define SPI_BUS1_DMA_TX_IRQ 0
+#define SPI_BUS1_DMA_RX_IRQ 0
+#define SPI_BUS1_DMA_CLOCK_ENABLE() ((void)0)
+#endif
 #endif
 
 #if SPI_NUM_BUSES > 2
@@ -67,6 +102,23 @@
 #define SPI_BUS2_MOSI_PORT NULL
 #define SPI_BUS2_MOSI_PIN 0
 #endif
+#if defined(SPI_BUS2_DMA_TX_STREAM)
+#if !defined(SPI_BUS2_DMA_TX_CHANNEL) || !defined(SPI_BUS2_DMA_RX_STREAM) ||   \
+    !defined(SPI_BUS2_DMA_RX_CHANNEL) ||                                       \
+    !defined(SPI_BUS2_DMA_CLOCK_ENABLE) || !defined(SPI_BUS2_DMA_TX_IRQ) ||    \
+    !defined(SPI_BUS2_DMA_TX_IRQ_HANDLER) || !defined(SPI_BUS2_DMA_RX_IRQ) ||  \
+    !defined(SPI_BUS2_DMA_RX_IRQ_HANDLER)
+#error "SPI bus 2 DMA configuration macros are incomplete"
+#endif
+#else
+#define SPI_BUS2_DMA_TX_STREAM NULL
+#define SPI_BUS2_DMA_TX_CHANNEL 0
+#define SPI_BUS2_DMA_RX_STREAM NULL
+#define SPI_BUS2_DMA_RX_CHANNEL 0
+#define SPI_BUS2_DMA_TX_IRQ 0
+#define SPI_BUS2_DMA_RX_IRQ 0
+#define SPI_BUS2_DMA_CLOCK_ENABLE() ((void)0)
+#endif
 #endif
 
 #if SPI_NUM_BUSES > 3
@@ -83,6 +135,23 @@
 #define SPI_BUS3_MOSI_PORT NULL
 #define SPI_BUS3_MOSI_PIN 0
 #endif
+#if defined(SPI_BUS3_DMA_TX_STREAM)
+#if !defined(SPI_BUS3_DMA_TX_CHANNEL) || !defined(SPI_BUS3_DMA_RX_STREAM) ||   \
+    !defined(SPI_BUS3_DMA_RX_CHANNEL) ||                                       \
+    !defined(SPI_BUS3_DMA_CLOCK_ENABLE) || !defined(SPI_BUS3_DMA_TX_IRQ) ||    \
+    !defined(SPI_BUS3_DMA_TX_IRQ_HANDLER) || !defined(SPI_BUS3_DMA_RX_IRQ) ||  \
+    !defined(SPI_BUS3_DMA_RX_IRQ_HANDLER)
+#error "SPI bus 3 DMA configuration macros are incomplete"
+#endif
+#else
+#define SPI_BUS3_DMA_TX_STREAM NULL
+#define SPI_BUS3_DMA_TX_CHANNEL 0
+#define SPI_BUS3_DMA_RX_STREAM NULL
+#define SPI_BUS3_DMA_RX_CHANNEL 0
+#define SPI_BUS3_DMA_TX_IRQ 0
+#define SPI_BUS3_DMA_RX_IRQ 0
+#define SPI_BUS3_DMA_CLOCK_ENABLE() ((void)0)
+#endif
 #endif
 
 static void spi_enable_gpio_clock(GPIO_TypeDef *port) {
@@ -156,7 +225,16 @@ typedef struct {
   GPIO_TypeDef *mosi_port;
   uint16_t mosi_pin;
   uint32_t pin_af;
+  // DMA streams of the bus, or NULL if the bus is polled
+  DMA_Stream_TypeDef *dma_tx_stream;
+  uint32_t dma_tx_channel;
+  IRQn_Type dma_tx_irq;
+  DMA_Stream_TypeDef *dma_rx_stream;
+  uint32_t dma_rx_channel;
+  IRQn_Type dma_rx_irq;
   SPI_HandleTypeDef handle;
+  DMA_HandleTypeDef dma_tx;
+  DMA_HandleTypeDef dma_rx;
   bool configured;
   uint32_t last_frequency_hz;
   spi_bus_mode_t last_mode;
@@ -174,7 +252,15 @@ typedef struct {
       .mosi_port = SPI_BUS##index##_MOSI_PORT,                                 \
       .mosi_pin = SPI_BUS##index##_MOSI_PIN,                                   \
       .pin_af = SPI_BUS##index##_PIN_AF,                                       \
+      .dma_tx_stream = SPI_BUS##index##_DMA_TX_STREAM,                         \
+      .dma_tx_channel = SPI_BUS##index##_DMA_TX_CHANNEL,                       \
+      .dma_tx_irq = SPI_BUS##index##_DMA_TX_IRQ,                               \
+      .dma_rx_stream = SPI_BUS##index##_DMA_RX_STREAM,                         \
+      .dma_rx_channel = SPI_BUS##index##_DMA_RX_CHANNEL,                       \
+      .dma_rx_irq = SPI_BUS##index##_DMA_RX_IRQ,                               \
       .handle = {0},                                                           \
+      .dma_tx = {0},                                                           \
+      .dma_rx = {0},                                                           \
       .configured = false,                                                     \
       .last_frequency_hz = 0,                                                  \
       .last_mode = SPI_BUS_MODE_0,                                             \
@@ -198,6 +284,10 @@ static spi_bus_state_t spi_buses[] = {
 
 static bool spi_driver_initialized = false;
 
+// Source and sink of the transfers without data to transmit or receive
+static uint8_t spi_dma_dummy_tx = 0xFFu;
+static uint8_t spi_dma_dummy_rx;
+
 static void spi_enable_bus_clock(uint8_t bus) {
   switch (bus) {
 #if SPI_NUM_BUSES > 0
@@ -225,6 +315,33 @@ static void spi_enable_bus_clock(uint8_t bus) {
   }
 }
 
+static void spi_enable_dma_clock(uint8_t bus) {
+  switch (bus) {
+#if SPI_NUM_BUSES > 0
+    case 0:
+      SPI_BUS0_DMA_CLOCK_ENABLE();
+      return;
+#endif
+#if SPI_NUM_BUSES > 1
+    case 1:
+      SPI_BUS1_DMA_CLOCK_ENABLE();
+      return;
+#endif
+#if SPI_NUM_BUSES > 2
+    case 2:
+      SPI_BUS2_DMA_CLOCK_ENABLE();
+      return;
+#endif
+#if SPI_NUM_BUSES > 3
+    case 3:
+      SPI_BUS3_DMA_CLOCK_ENABLE();
+      return;
+#endif
+    default:
+      return;
+  }
+}
+
 static void spi_configure_af_pin(GPIO_TypeDef *port, uint16_t pin,
                                  uint32_t alternate_function) {
   GPIO_InitTypeDef gpio_init = {0};
@@ -312,6 +429,110 @@ static bool spi_configure_bus(spi_bus_state_t *bus_state,
   bus_state->last_lsb_first = config->lsb_first;
   return true;
 }
+
+static void spi_init_dma_stream(DMA_HandleTypeDef *dma,
+                                DMA_Stream_TypeDef *stream, uint32_t channel,
+                                uint32_t direction) {
+  dma->Instance = stream;
+  dma->Init.Channel = channel;
+  dma->Init.Direction = direction;
+  dma->Init.PeriphInc = DMA_PINC_DISABLE;
+  dma->Init.MemInc = DMA_MINC_ENABLE;
+  dma->Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+  dma->Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+  dma->Init.Mode = DMA_NORMAL;
+  dma->Init.Priority = DMA_PRIORITY_MEDIUM;
+  dma->Init.FIFOMode = DMA_FIFOMODE_DISABLE;
+  (void)HAL_DMA_Init(dma);
+}
+
+static void spi_init_dma(uint8_t bus) {
+  spi_bus_state_t *bus_state = &spi_buses[bus];
+
+  if (bus_state->dma_tx_stream == NULL) {
+    return;
+  }
+
+  spi_enable_dma_clock(bus);
+  spi_init_dma_stream(&bus_state->dma_tx, bus_state->dma_tx_stream,
+                      bus_state->dma_tx_channel, DMA_MEMORY_TO_PERIPH);
+  spi_init_dma_stream(&bus_state->dma_rx, bus_state->dma_rx_stream,
+                      bus_state->dma_rx_channel, DMA_PERIPH_TO_MEMORY);
+  __HAL_LINKDMA(&bus_state->handle, hdmatx, bus_state->dma_tx);
+  __HAL_LINKDMA(&bus_state->handle, hdmarx, bus_state->dma_rx);
+  HAL_NVIC_SetPriority(bus_state->dma_tx_irq, 1, 0);
+  HAL_NVIC_EnableIRQ(bus_state->dma_tx_irq);
+  HAL_NVIC_SetPriority(bus_state->dma_rx_irq, 1, 0);
+  HAL_NVIC_EnableIRQ(bus_state->dma_rx_irq);
+}
+
+static bool spi_transfer_polled(SPI_HandleTypeDef *handle,
+                                const spi_transaction_t *transaction) {
+  for (size_t i = 0; i < transaction->len; i++) {
+    uint8_t tx_byte =
+        transaction->tx != NULL ? transaction->tx[i] : spi_dma_dummy_tx;
+    uint8_t rx_byte = 0;
+    if (HAL_SPI_TransmitReceive(handle, &tx_byte, &rx_byte, 1u,
+                                HAL_MAX_DELAY) != HAL_OK) {
+      return false;
+    }
+    if (transaction->rx != NULL) {
+      transaction->rx[i] = rx_byte;
+    }
+  }
+
+  return true;
+}
+
+static void spi_dma_complete(SPI_HandleTypeDef *handle, bool success) {
+  for (uint8_t bus = 0; bus < M_ARRAY_SIZE(spi_buses); bus++) {
+    if (&spi_buses[bus].handle == handle) {
+      spi_queue_complete(bus, success);
+      return;
+    }
+  }
+}
+
+void HAL_SPI_TxRxCpltCallback(SPI_HandleTypeDef *hspi) {
+  spi_dma_complete(hspi, true);
+}
+
+void HAL_SPI_ErrorCallback(SPI_HandleTypeDef *hspi) {
+  spi_dma_complete(hspi, false);
+}
+
+#if SPI_NUM_BUSES > 0 && defined(SPI_BUS0_DMA_TX_IRQ_HANDLER)
+void SPI_BUS0_DMA_TX_IRQ_HANDLER(void) {
+  HAL_DMA_IRQHandler(&spi_buses[0].dma_tx);
+}
+void SPI_BUS0_DMA_RX_IRQ_HANDLER(void) {
+  HAL_DMA_IRQHandler(&spi_buses[0].dma_rx);
+}
+#endif
+#if SPI_NUM_BUSES > 1 && defined(SPI_BUS1_DMA_TX_IRQ_HANDLER)
+void SPI_BUS1_DMA_TX_IRQ_HANDLER(void) {
+  HAL_DMA_IRQHandler(&spi_buses[1].dma_tx);
+}
+void SPI_BUS1_DMA_RX_IRQ_HANDLER(void) {
+  HAL_DMA_IRQHandler(&spi_buses[1].dma_rx);
+}
+#endif
+#if SPI_NUM_BUSES > 2 && defined(SPI_BUS2_DMA_TX_IRQ_HANDLER)
+void SPI_BUS2_DMA_TX_IRQ_HANDLER(void) {
+  HAL_DMA_IRQHandler(&spi_buses[2].dma_tx);
+}
+void SPI_BUS2_DMA_RX_IRQ_HANDLER(void) {
+  HAL_DMA_IRQHandler(&spi_buses[2].dma_rx);
+}
+#endif
+#if SPI_NUM_BUSES > 3 && defined(SPI_BUS3_DMA_TX_IRQ_HANDLER)
+void SPI_BUS3_DMA_TX_IRQ_HANDLER(void) {
+  HAL_DMA_IRQHandler(&spi_buses[3].dma_tx);
+}
+void SPI_BUS3_DMA_RX_IRQ_HANDLER(void) {
+  HAL_DMA_IRQHandler(&spi_buses[3].dma_rx);
+}
+#endif
 #endif
 
 void spi_bus_init(void) {
@@ -330,6 +551,7 @@ void spi_bus_init(void) {
     spi_configure_af_pin(bus_state->mosi_port, bus_state->mosi_pin,
                          bus_state->pin_af);
     bus_state->handle.Instance = bus_state->instance;
+    spi_init_dma(bus);
   }
 
   spi_driver_initialized = true;
@@ -355,39 +577,57 @@ bool spi_bus_acquire(const spi_bus_config_t *config) {
 
 void spi_bus_release(const spi_bus_config_t *config) { (void)config; }
 
-bool spi_bus_transfer(const spi_bus_config_t *config, const uint8_t *tx,
-                      uint8_t *rx, size_t len) {
+spi_driver_status_t spi_driver_start(uint8_t bus,
+                                     const spi_transaction_t *transaction) {
 #if SPI_NUM_BUSES > 0
-  SPI_HandleTypeDef *handle;
+  spi_bus_state_t *bus_state = &spi_buses[bus];
 
-  if (len == 0u) {
-    return true;
+  if (bus_state->dma_tx_stream == NULL) {
+    return spi_transfer_polled(&bus_state->handle, transaction)
+               ? SPI_DRIVER_DONE
+               : SPI_DRIVER_ERROR;
   }
 
-  if (!spi_bus_acquire(config)) {
-    return false;
+  // The dummy bytes are repeated rather than read or written as a buffer
+  MODIFY_REG(bus_state->dma_tx_stream->CR, DMA_SxCR_MINC,
+             transaction->tx != NULL ? DMA_SxCR_MINC : 0u);
+  MODIFY_REG(bus_state->dma_rx_stream->CR, DMA_SxCR_MINC,
+             transaction->rx != NULL ? DMA_SxCR_MINC : 0u);
+  if (HAL_SPI_TransmitReceive_DMA(
+          &bus_state->handle,
+          transaction->tx != NULL ? (uint8_t *)transaction->tx
+                                  : &spi_dma_dummy_tx,
+          transaction->rx != NULL ? transaction->rx : &spi_dma_dummy_rx,
+          (uint16_t)transaction->len) != HAL_OK) {
+    return SPI_DRIVER_ERROR;
   }
 
-  handle = &spi_buses[config->bus].handle;
-  for (size_t i = 0; i < len; i++) {
-    uint8_t tx_byte = tx != NULL ? tx[i] : 0xFFu;
-    uint8_t rx_byte = 0;
-    if (HAL_SPI_TransmitReceive(handle, &tx_byte, &rx_byte, 1u,
-                                HAL_MAX_DELAY) != HAL_OK) {
-      return false;
-    }
-    if (rx != NULL) {
-      rx[i] = rx_byte;
-    }
+  return SPI_DRIVER_PENDING;
+#else
+  (void)bus;
+  (void)transaction;
+  return SPI_DRIVER_ERROR;
+#endif
+}
+
+void spi_driver_mask_irq(uint8_t bus, bool masked) {
+#if SPI_NUM_BUSES > 0
+  const spi_bus_state_t *bus_state = &spi_buses[bus];
+
+  if (bus_state->dma_tx_stream == NULL) {
+    return;
   }
 
-  return true;
+  if (masked) {
+    HAL_NVIC_DisableIRQ(bus_state->dma_tx_irq);
+    HAL_NVIC_DisableIRQ(bus_state->dma_rx_irq);
+  } else {
+    HAL_NVIC_EnableIRQ(bus_state->dma_tx_irq);
+    HAL_NVIC_EnableIRQ(bus_state->dma_rx_irq);
+  }
 #else
-  (void)config;
-  (void)tx;
-  (void)rx;
-  (void)len;
-  return false;
+  (void)bus;
+  (void)masked;
 #endif
 }
 
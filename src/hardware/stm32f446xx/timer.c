@@ -16,7 +16,12 @@
 #include "hardware/hardware.h"
 
 #include "stm32f4xx_hal.h"
+#include "timebase.h"
 
-void timer_init(void) {}
+// The wraps of the cycle counter are counted by the SysTick handler in
+// `board.c`
+void timer_init(void) { timebase_init(); }
 
 uint32_t timer_read(void) { return HAL_GetTick(); }
+
+uint64_t timer_read_us(void) { return timebase_read_us(); }
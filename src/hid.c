@@ -15,6 +15,7 @@
 
 #include "hid.h"
 
+#include "advanced_keys.h"
 #include "commands.h"
 #include "event_trace.h"
 #include "hardware/hardware.h"
@@ -33,6 +34,8 @@ static hid_nkro_kb_report_t kb_report_last_sent;
 static hid_nkro_kb_report_t kb_report_queue[MAX_PENDING_KB_REPORTS];
 static uint8_t kb_report_queue_head;
 static uint8_t kb_report_queue_size;
+// Whether the last keyboard report is sent again when there is no new one
+static bool kb_report_clock_enabled;
 
 static uint16_t system_report;
 static uint16_t consumer_report;
@@ -190,8 +193,13 @@ static void hid_send_keyboard_report(void) {
     hid_keyboard_queue_report();
   }
 
-  if (kb_report_queue_size == 0u)
+  if (kb_report_queue_size == 0u) {
+    if (kb_report_clock_enabled &&
+        tud_hid_n_report(USB_ITF_KEYBOARD, 0, &kb_report_last_sent,
+                         sizeof(kb_report_last_sent)))
+      EVENT_TRACE("[event] hid resend keyboard\n");
     return;
+  }
 
   hid_nkro_kb_report_t *report = &kb_report_queue[kb_report_queue_head];
 
@@ -291,6 +299,7 @@ void hid_init(void) {
   memset(&kb_report_last_sent, 0, sizeof(kb_report_last_sent));
   kb_report_queue_head = 0;
   kb_report_queue_size = 0;
+  kb_report_clock_enabled = false;
   system_report = 0;
   consumer_report = 0;
   memset(&mouse_report, 0, sizeof(mouse_report));
@@ -448,6 +457,10 @@ void hid_keycode_remove(uint8_t keycode) {
   }
 }
 
+void hid_set_keyboard_report_clock(bool enabled) {
+  kb_report_clock_enabled = enabled;
+}
+
 void hid_send_reports(void) {
 #if !defined(HID_DISABLED)
   if (tud_suspended()) {
@@ -500,9 +513,12 @@ void tud_hid_set_report_cb(uint8_t instance, uint8_t report_id,
 
 void tud_hid_report_complete_cb(uint8_t instance, const uint8_t *report,
                                 uint16_t len) {
-  if (instance == USB_ITF_KEYBOARD)
+  if (instance == USB_ITF_KEYBOARD) {
+    // The advanced keys timed in keyboard reports are updated first, so that
+    // their changes are sent in the next report
+    advanced_key_keyboard_report_complete();
     hid_send_keyboard_report();
-  else if (instance == USB_ITF_MOUSE)
+  } else if (instance == USB_ITF_MOUSE)
     hid_send_mouse_report();
   else if (instance == USB_ITF_HID)
     // Start from the next report ID
@@ -0,0 +1,144 @@
+/*
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "i2c_queue.h"
+
+static bool i2c_queue_is_pending(const i2c_transaction_t *transaction) {
+  return transaction->state == I2C_TRANSACTION_QUEUED ||
+         transaction->state == I2C_TRANSACTION_ACTIVE;
+}
+
+#if I2C_NUM_BUSES > 0
+typedef struct {
+  // Transactions of the bus in order. The first one is in progress while
+  // `running` is set.
+  i2c_transaction_t *volatile head;
+  i2c_transaction_t *tail;
+  // Set while the queue is being advanced or a transfer is pending
+  volatile bool running;
+} i2c_queue_t;
+
+static i2c_queue_t i2c_queues[I2C_NUM_BUSES];
+
+static void i2c_queue_append(i2c_queue_t *queue,
+                             i2c_transaction_t *transaction) {
+  transaction->queue_next = NULL;
+  transaction->state = I2C_TRANSACTION_QUEUED;
+  if (queue->tail != NULL)
+    queue->tail->queue_next = transaction;
+  else
+    queue->head = transaction;
+  queue->tail = transaction;
+}
+
+/**
+ * @brief Remove the first transaction of a bus and report its result
+ *
+ * @param queue Queue of the bus
+ * @param success true if the transfer was successful, false otherwise
+ *
+ * @return None
+ */
+static void i2c_queue_finish(i2c_queue_t *queue, bool success) {
+  i2c_transaction_t *transaction = queue->head;
+
+  queue->head = transaction->queue_next;
+  if (queue->head == NULL)
+    queue->tail = NULL;
+
+  transaction->state =
+      success ? I2C_TRANSACTION_DONE : I2C_TRANSACTION_FAILED;
+  if (transaction->callback != NULL)
+    transaction->callback(transaction, success);
+}
+
+/**
+ * @brief Start the transactions of a bus until one is pending
+ *
+ * Transfers done before `i2c_driver_start()` returns are finished in this
+ * loop rather than recursively, so polled buses run any number of queued
+ * transactions in constant stack space.
+ *
+ * @param bus Bus to advance
+ *
+ * @return None
+ */
+static void i2c_queue_advance(uint8_t bus) {
+  i2c_queue_t *queue = &i2c_queues[bus];
+
+  queue->running = true;
+  while (queue->head != NULL) {
+    i2c_transaction_t *transaction = queue->head;
+    i2c_driver_status_t status = I2C_DRIVER_ERROR;
+
+    transaction->state = I2C_TRANSACTION_ACTIVE;
+    if (i2c_bus_acquire(transaction->config))
+      status = i2c_driver_start(bus, transaction);
+    if (status == I2C_DRIVER_PENDING)
+      // `i2c_queue_complete()` continues from here
+      return;
+
+    i2c_queue_finish(queue, status == I2C_DRIVER_DONE);
+  }
+  queue->running = false;
+}
+#endif
+
+bool i2c_bus_submit(i2c_transaction_t *transaction) {
+#if I2C_NUM_BUSES > 0
+  if (transaction == NULL || transaction->config == NULL ||
+      transaction->config->bus >= I2C_NUM_BUSES ||
+      transaction->address > 0x7Fu || transaction->tx == NULL ||
+      transaction->len == 0 || transaction->len > I2C_MAX_TRANSFER_SIZE ||
+      i2c_queue_is_pending(transaction))
+    return false;
+
+  const uint8_t bus = transaction->config->bus;
+  i2c_queue_t *queue = &i2c_queues[bus];
+
+  i2c_driver_mask_irq(bus, true);
+  i2c_queue_append(queue, transaction);
+  if (!queue->running)
+    i2c_queue_advance(bus);
+  i2c_driver_mask_irq(bus, false);
+
+  return true;
+#else
+  (void)transaction;
+  return false;
+#endif
+}
+
+bool i2c_bus_busy(uint8_t bus) {
+#if I2C_NUM_BUSES > 0
+  return bus < I2C_NUM_BUSES && i2c_queues[bus].head != NULL;
+#else
+  (void)bus;
+  return false;
+#endif
+}
+
+void i2c_queue_complete(uint8_t bus, bool success) {
+#if I2C_NUM_BUSES > 0
+  if (bus >= I2C_NUM_BUSES || i2c_queues[bus].head == NULL)
+    return;
+
+  i2c_queue_finish(&i2c_queues[bus], success);
+  i2c_queue_advance(bus);
+#else
+  (void)bus;
+  (void)success;
+#endif
+}
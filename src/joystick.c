@@ -8,7 +8,6 @@
 #include "joystick_math.h"
 #include "keycodes.h"
 #include "lib/usqrt.h"
-#include "wear_leveling.h"
 
 #if defined(JOYSTICK_ENABLED)
 
@@ -697,10 +696,8 @@ void joystick_apply_config(joystick_config_t config) {
 void joystick_set_config(joystick_config_t config) {
   config = joystick_normalize_config(config);
   if (eeconfig != NULL) {
-    uint32_t addr = offsetof(eeconfig_t, profiles) +
-                    eeconfig->current_profile * sizeof(eeconfig_profile_t) +
-                    offsetof(eeconfig_profile_t, joystick_config);
-    (void)wear_leveling_write(addr, &config, sizeof(config));
+    (void)EECONFIG_WRITE_PROFILE(eeconfig_get_current_profile(),
+                                 joystick_config, &config);
   }
   joystick_apply_config(config);
 }
@@ -38,6 +38,21 @@ typedef uint16_t layout_event_count_t;
 #define RGB_BRIGHTNESS_STEP 17
 #endif
 
+#if !defined(LAYOUT_AK_TICK_INTERVAL_US)
+// Interval between the ticks of the advanced keys in microseconds, one report
+// interval at 8 kHz polling
+#define LAYOUT_AK_TICK_INTERVAL_US 125
+#endif
+
+// Idle time before a profile switch is saved, so that switching profiles does
+// not write to the storage while typing
+#define LAYOUT_PROFILE_SAVE_IDLE_MS 3000u
+
+// Advanced key types that act on ticks
+#define LAYOUT_TICKED_AK_TYPES                                                 \
+  (PROFILE_AK_TYPE_BIT(AK_TYPE_TAP_HOLD) |                                     \
+   PROFILE_AK_TYPE_BIT(AK_TYPE_TOGGLE) | PROFILE_AK_TYPE_BIT(AK_TYPE_MACRO))
+
 /**
  * @brief Get the current layer
  *
@@ -89,7 +104,7 @@ __attribute__((always_inline)) static inline void layout_layer_lock(void) {
  *
  * @return Keycode
  */
-uint8_t layout_get_keycode(uint8_t current_layer, uint8_t key) {
+uint8_t layout_get_keycode(uint8_t current_layer, key_index_t key) {
   // Find the first active layer with a non-transparent keycode
   for (uint32_t i = (uint32_t)current_layer + 1; i-- > 0;) {
     if (((layer_mask >> i) & 1) == 0)
@@ -114,16 +129,13 @@ static bitmap_t key_press_states[BITMAP_SIZE(NUM_KEYS)] = {0};
 // we need to remember the keycodes we pressed to release them correctly.
 static uint8_t active_keycodes[NUM_KEYS];
 
-// Store the indices of the advanced keys bind to each key. If no advanced key
-// is bind to a key, the index is 0. Otherwise, the index is added by 1.
-static uint8_t advanced_key_indices[NUM_LAYERS][NUM_KEYS];
 // Same as `active_keycodes` but for advanced keys
 static uint8_t active_advanced_keys[NUM_KEYS];
 
 typedef struct {
-  uint8_t key;
+  key_index_t key;
   bool pressed;
-  uint32_t event_time;
+  uint64_t event_time;
   uint8_t distance;
 } layout_event_t;
 
@@ -136,10 +148,10 @@ static void layout_trace_events(const char *stage, const layout_event_t *events,
   EVENT_TRACE("[event] %s count=%u\n", stage, event_count);
   for (layout_event_count_t i = 0; i < event_count; i++) {
     EVENT_TRACE(
-        "[event] %s[%u] key=%u action=%s time=%lu distance=%u\n", stage,
+        "[event] %s[%u] key=%u action=%s time=%llu distance=%u\n", stage,
         (unsigned int)i, events[i].key,
         events[i].pressed ? "press" : "release",
-        (unsigned long)events[i].event_time, events[i].distance);
+        (unsigned long long)events[i].event_time, events[i].distance);
   }
 }
 #else
@@ -151,11 +163,14 @@ static void layout_trace_events(const char *stage, const layout_event_t *events,
 // here and replayed after the hold-tap resolves.
 #define MAX_PENDING_EVENTS 32
 static struct {
-  uint8_t key;
+  key_index_t key;
   bool pressed;
 } pending_events[MAX_PENDING_EVENTS];
 static uint8_t pending_count;
 
+// Whether a profile switch has not been saved yet
+static bool profile_save_pending;
+
 bool is_sniper_active = false;
 
 #if defined(JOYSTICK_ENABLED)
@@ -196,11 +211,10 @@ static void joystick_scroll_mo_unregister(void) {
 static bool layout_write_current_profile_rgb_field(uint32_t field_offset,
                                                    const void *value,
                                                    uint32_t len) {
-  const uint32_t addr =
-      offsetof(eeconfig_t, profiles) +
-      (uint32_t)eeconfig->current_profile * sizeof(eeconfig_profile_t) +
-      offsetof(eeconfig_profile_t, rgb_config) + field_offset;
-  return wear_leveling_write(addr, value, len);
+  return eeconfig_write_profile(eeconfig_get_current_profile(),
+                                offsetof(eeconfig_profile_t, rgb_config) +
+                                    field_offset,
+                                value, len);
 }
 
 static void layout_set_rgb_enabled(bool enabled) {
@@ -347,11 +361,12 @@ static void layout_select_previous_rgb_effect(void) {
 static void layout_toggle_polling_rate(void) {
   eeconfig_options_t options = eeconfig->options;
   options.high_polling_rate_enabled = !options.high_polling_rate_enabled;
-  if (EECONFIG_WRITE(options, &options))
+  (void)eeconfig_save_current_profile();
+  if (EECONFIG_WRITE(options, &options) && wear_leveling_flush())
     board_reset();
 }
 
-void layout_init(void) { profile_runtime_apply_current(); }
+void layout_init(void) { profile_runtime_init(); }
 
 void layout_reset_runtime_state(void) {
   advanced_key_clear();
@@ -380,38 +395,7 @@ void layout_reset_runtime_state(void) {
     bitmap_set(key_press_states, i, key_matrix[i].is_pressed);
 }
 
-/**
- * @brief Reload advanced key indices from the current profile.
- *
- * DESIGN INVARIANT: All code paths that modify CURRENT_PROFILE.advanced_keys
- * (profile switch, reset, duplicate, hmkconf update) MUST call this function.
- * This is the sole gateway for config changes that affect combo bitmap cache.
- * If a new config-change path is added without calling this function,
- * the combo bitmap cache will become stale and produce incorrect behavior.
- */
-void layout_load_advanced_keys(void) {
-  memset(advanced_key_indices, 0, sizeof(advanced_key_indices));
-  for (uint32_t i = 0; i < NUM_ADVANCED_KEYS; i++) {
-    const advanced_key_t *ak = &CURRENT_PROFILE.advanced_keys[i];
-
-    if (ak->type == AK_TYPE_NONE || ak->type == AK_TYPE_COMBO ||
-        ak->layer >= NUM_LAYERS || ak->key >= NUM_KEYS)
-      continue;
-
-    advanced_key_indices[ak->layer][ak->key] = i + 1;
-    if (ak->type == AK_TYPE_NULL_BIND && ak->null_bind.secondary_key < NUM_KEYS)
-      // Null Bind advanced keys also have a secondary key
-      advanced_key_indices[ak->layer][ak->null_bind.secondary_key] = i + 1;
-  }
-
-  // Invalidate combo bitmap cache so it's rebuilt with updated definitions.
-  // Layer changes are handled lazily by combo_key_bitmap_rebuild() checking
-  // combo_key_bitmap_layer != current_layer. This invalidation covers the
-  // case where definitions change but the layer stays the same.
-  advanced_key_combo_invalidate_cache();
-}
-
-bool layout_process_key(uint8_t key, bool pressed) {
+bool layout_process_key(key_index_t key, bool pressed) {
   const uint8_t current_layer = layout_get_current_layer();
   bool has_non_tap_hold_event = false;
 
@@ -420,7 +404,8 @@ bool layout_process_key(uint8_t key, bool pressed) {
     advanced_key_abort_macros();
 
     const uint8_t keycode = layout_get_keycode(current_layer, key);
-    const uint8_t ak_index = advanced_key_indices[current_layer][key];
+    const uint8_t ak_index =
+        profile_runtime->advanced_key_indices[current_layer][key];
 
     if (ak_index) {
       EVENT_TRACE(
@@ -446,7 +431,7 @@ bool layout_process_key(uint8_t key, bool pressed) {
       has_non_tap_hold_event |= (keycode != KC_NO);
       // Update last key time for require_prior_idle_ms feature
       if (keycode != KC_NO)
-        advanced_key_update_last_key_time(timer_read());
+        advanced_key_update_last_key_time(timer_read_us());
     }
   } else {
     const uint8_t keycode = active_keycodes[key];
@@ -492,7 +477,7 @@ static void layout_flush_pending_events(void) {
   pending_count = 0;
 }
 
-static void layout_buffer_pending_event(uint8_t key, bool pressed) {
+static void layout_buffer_pending_event(key_index_t key, bool pressed) {
   if (pending_count >= MAX_PENDING_EVENTS)
     layout_flush_pending_events();
 
@@ -502,7 +487,7 @@ static void layout_buffer_pending_event(uint8_t key, bool pressed) {
               pressed ? "press" : "release", pending_count);
 }
 
-static bool layout_pending_has_press(uint8_t key) {
+static bool layout_pending_has_press(key_index_t key) {
   for (uint8_t i = 0; i < pending_count; i++) {
     if (pending_events[i].key == key && pending_events[i].pressed)
       return true;
@@ -511,18 +496,20 @@ static bool layout_pending_has_press(uint8_t key) {
   return false;
 }
 
-static bool layout_key_is_tap_hold(uint8_t key) {
+static bool layout_key_is_tap_hold(key_index_t key) {
   const uint8_t current_layer = layout_get_current_layer();
-  const uint8_t ak_index = advanced_key_indices[current_layer][key];
+  const uint8_t ak_index =
+      profile_runtime->advanced_key_indices[current_layer][key];
 
   return ak_index &&
          CURRENT_PROFILE.advanced_keys[ak_index - 1].type == AK_TYPE_TAP_HOLD;
 }
 
-static bool layout_should_skip_key_processing(uint8_t key,
+static bool layout_should_skip_key_processing(key_index_t key,
                                               const key_state_t *state,
                                               uint8_t current_layer) {
-  if (CURRENT_PROFILE.gamepad_buttons[key] != GP_BUTTON_NONE) {
+  if (profile_runtime->capabilities.has_gamepad_buttons &&
+      CURRENT_PROFILE.gamepad_buttons[key] != GP_BUTTON_NONE) {
     xinput_process(key);
 
     if (CURRENT_PROFILE.gamepad_options.gamepad_override) {
@@ -555,7 +542,7 @@ static void layout_collect_events(layout_event_t *events,
     const key_state_t *state = &key_matrix[i];
     const bool last_key_press = bitmap_get(key_press_states, i);
 
-    if (layout_should_skip_key_processing((uint8_t)i, state, current_layer))
+    if (layout_should_skip_key_processing((key_index_t)i, state, current_layer))
       continue;
 
     if (state->is_pressed && !last_key_press) {
@@ -563,7 +550,7 @@ static void layout_collect_events(layout_event_t *events,
         continue;
       }
       events[(*event_count)++] = (layout_event_t){
-          .key = (uint8_t)i,
+          .key = (key_index_t)i,
           .pressed = true,
           .event_time = state->event_time,
           .distance = state->distance,
@@ -574,7 +561,7 @@ static void layout_collect_events(layout_event_t *events,
         continue;
       }
       events[(*event_count)++] = (layout_event_t){
-          .key = (uint8_t)i,
+          .key = (key_index_t)i,
           .pressed = false,
           .event_time = state->event_time,
           .distance = state->distance,
@@ -587,7 +574,7 @@ static void layout_collect_events(layout_event_t *events,
       if (ak_index) {
         advanced_key_event_t ak_event = (advanced_key_event_t){
             .type = AK_EVENT_TYPE_HOLD,
-            .key = (uint8_t)i,
+            .key = (key_index_t)i,
             .keycode = keycode,
             .ak_index = ak_index - 1,
         };
@@ -633,10 +620,12 @@ static void layout_sort_events(layout_event_t *events,
 }
 
 static bool layout_handle_press_event(const layout_event_t *event) {
-  if (advanced_key_combo_process(event->key, true, event->event_time))
+  // The combo queue stays empty without combos, so there is nothing to flush
+  if (profile_runtime->capabilities.num_combos > 0 &&
+      advanced_key_combo_process(event->key, true, event->event_time))
     return false;
 
-  if (!layout_key_is_tap_hold(event->key) && advanced_key_has_undecided()) {
+  if (advanced_key_has_undecided() && !layout_key_is_tap_hold(event->key)) {
     layout_buffer_pending_event(event->key, true);
     return true;
   }
@@ -645,7 +634,8 @@ static bool layout_handle_press_event(const layout_event_t *event) {
 }
 
 static bool layout_handle_release_event(const layout_event_t *event) {
-  if (advanced_key_combo_process(event->key, false, event->event_time))
+  if (profile_runtime->capabilities.num_combos > 0 &&
+      advanced_key_combo_process(event->key, false, event->event_time))
     return false;
 
   if (layout_pending_has_press(event->key)) {
@@ -676,7 +666,7 @@ static void layout_process_events(const layout_event_t *events,
 }
 
 void layout_task(void) {
-  static uint32_t last_ak_tick = 0;
+  static uint64_t last_ak_tick = 0;
 
   const uint8_t current_layer = layout_get_current_layer();
   bool has_non_tap_hold_press = false;
@@ -689,15 +679,18 @@ void layout_task(void) {
   layout_process_events(events, event_count, &has_non_tap_hold_press,
                         &has_non_tap_hold_release);
 
-  if (advanced_key_combo_task())
+  if (profile_runtime->capabilities.num_combos > 0 && advanced_key_combo_task())
     has_non_tap_hold_press = true;
 
-  if (has_non_tap_hold_press || timer_elapsed(last_ak_tick) > 0) {
-    // We only need to tick the advanced keys every 1ms, or when there is a
-    // non-Tap-Hold key press event since these are the only cases that
-    // the advanced keys might perform an action.
+  if ((profile_runtime->capabilities.ak_types & LAYOUT_TICKED_AK_TYPES) &&
+      (has_non_tap_hold_press ||
+       timer_elapsed_us(last_ak_tick) >= LAYOUT_AK_TICK_INTERVAL_US)) {
+    // We only need to tick the advanced keys every report interval, or when
+    // there is a non-Tap-Hold key press event since these are the only cases
+    // that the advanced keys might perform an action. Profiles without
+    // advanced keys that act on ticks are not ticked at all.
     advanced_key_tick(has_non_tap_hold_press, has_non_tap_hold_release);
-    last_ak_tick = timer_read();
+    last_ak_tick = timer_read_us();
   }
 
   // After tick, if no hold-tap is undecided anymore, flush pending events
@@ -708,35 +701,34 @@ void layout_task(void) {
 
   // Process deferred actions for the next matrix scan
   deferred_action_process();
+
+  if (profile_save_pending &&
+      matrix_get_idle_time() >= LAYOUT_PROFILE_SAVE_IDLE_MS &&
+      eeconfig_save_current_profile())
+    profile_save_pending = false;
 }
 
 /**
  * @brief Set the current profile
  *
- * This function also refreshes the advanced keys, and saves the last
- * non-default profile for profile swapping.
+ * This function switches to the prebuilt runtime image of the profile. The
+ * profile, and the last non-default profile for profile swapping, are saved
+ * once the keyboard is idle.
  *
  * @param profile Profile index
  *
  * @return true if successful, false otherwise
  */
 static bool layout_set_profile(uint8_t profile) {
-  if (profile >= NUM_PROFILES)
+  if (!eeconfig_switch_profile(profile))
     return false;
 
-  const bool current_profile_written = EECONFIG_WRITE(current_profile, &profile);
-  bool status = current_profile_written;
-  if (status && profile != 0)
-    status = EECONFIG_WRITE(last_non_default_profile, &profile);
-
-  if (current_profile_written) {
-    profile_runtime_reload_current();
-  }
-
-  return status;
+  profile_save_pending = true;
+  profile_runtime_switch_current();
+  return true;
 }
 
-void layout_register(uint8_t key, uint8_t keycode) {
+void layout_register(key_index_t key, uint8_t keycode) {
   if (keycode == KC_NO)
     return;
 
@@ -763,15 +755,18 @@ void layout_register(uint8_t key, uint8_t keycode) {
     break;
 
   case SP_PROFILE_SWAP:
-    layout_set_profile(
-        eeconfig->current_profile ? 0 : eeconfig->last_non_default_profile);
+    layout_set_profile(eeconfig_get_current_profile()
+                           ? 0
+                           : eeconfig_get_last_non_default_profile());
     break;
 
   case SP_PROFILE_NEXT:
-    layout_set_profile((eeconfig->current_profile + 1) % NUM_PROFILES);
+    layout_set_profile((eeconfig_get_current_profile() + 1) % NUM_PROFILES);
     break;
 
   case SP_BOOT:
+    (void)eeconfig_save_current_profile();
+    (void)wear_leveling_flush();
     board_enter_bootloader();
     break;
 
@@ -827,7 +822,7 @@ void layout_register(uint8_t key, uint8_t keycode) {
   }
 }
 
-void layout_unregister(uint8_t key, uint8_t keycode) {
+void layout_unregister(key_index_t key, uint8_t keycode) {
   if (keycode == KC_NO)
     return;
 
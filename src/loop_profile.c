@@ -0,0 +1,53 @@
+/*
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "loop_profile.h"
+
+#if defined(LOOP_PROFILE_ENABLED)
+// Longest run of each stage in CPU cycles
+static uint32_t loop_profile_max[LOOP_STAGE_COUNT];
+
+static const char *const loop_profile_names[LOOP_STAGE_COUNT] = {
+    [LOOP_STAGE_USB] = "usb",
+    [LOOP_STAGE_USB_RUNTIME] = "usb_runtime",
+    [LOOP_STAGE_ANALOG] = "analog",
+    [LOOP_STAGE_MATRIX_SCAN] = "matrix_scan",
+    [LOOP_STAGE_ENCODER] = "encoder",
+    [LOOP_STAGE_LAYOUT] = "layout",
+    [LOOP_STAGE_RGB] = "rgb",
+    [LOOP_STAGE_JOYSTICK] = "joystick",
+    [LOOP_STAGE_SLIDER] = "slider",
+    [LOOP_STAGE_XINPUT] = "xinput",
+    [LOOP_STAGE_COMMAND] = "command",
+    [LOOP_STAGE_WEAR_LEVELING] = "wear_leveling",
+};
+
+void loop_profile_record(loop_stage_t stage, uint32_t cycles) {
+  if (cycles > loop_profile_max[stage])
+    loop_profile_max[stage] = cycles;
+}
+
+uint32_t loop_profile_max_cycles(loop_stage_t stage) {
+  return loop_profile_max[stage];
+}
+
+const char *loop_profile_stage_name(loop_stage_t stage) {
+  return loop_profile_names[stage];
+}
+
+void loop_profile_reset(void) {
+  memset(loop_profile_max, 0, sizeof(loop_profile_max));
+}
+#endif
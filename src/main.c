@@ -23,6 +23,7 @@
 #include "hid.h"
 #include "joystick.h"
 #include "layout.h"
+#include "loop_profile.h"
 #include "matrix.h"
 #include "rgb.h"
 #include "tusb.h"
@@ -43,7 +44,7 @@ int main(void) {
   wear_leveling_init();
   eeconfig_init();
 #if defined(RECOVERY_RESET_CURRENT_PROFILE_RGB) && defined(RGB_ENABLED)
-  (void)eeconfig_reset_profile_rgb(eeconfig->current_profile);
+  (void)eeconfig_reset_profile_rgb(eeconfig_get_current_profile());
 #endif
 
   // Initialize the core modules
@@ -67,22 +68,32 @@ int main(void) {
   tud_init(BOARD_TUD_RHPORT);
 
   while (1) {
-    tud_task();
-    usb_runtime_task();
+    bool storage_reloaded = false;
 
-    analog_task();
-    matrix_scan();
-    encoder_task();
-    layout_task();
+    LOOP_PROFILE(LOOP_STAGE_USB, tud_task());
+    LOOP_PROFILE(LOOP_STAGE_USB_RUNTIME, usb_runtime_task());
+
+    LOOP_PROFILE(LOOP_STAGE_ANALOG, analog_task());
+    LOOP_PROFILE(LOOP_STAGE_MATRIX_SCAN, matrix_scan());
+    LOOP_PROFILE(LOOP_STAGE_ENCODER, encoder_task());
+    LOOP_PROFILE(LOOP_STAGE_LAYOUT, layout_task());
 #if defined(RGB_ENABLED)
-    rgb_task();
+    LOOP_PROFILE(LOOP_STAGE_RGB, rgb_task());
 #endif
 #if defined(JOYSTICK_ENABLED)
-    joystick_task();
+    LOOP_PROFILE(LOOP_STAGE_JOYSTICK, joystick_task());
 #endif
-    slider_task();
-    xinput_task();
-    command_task();
+    LOOP_PROFILE(LOOP_STAGE_SLIDER, slider_task());
+    LOOP_PROFILE(LOOP_STAGE_XINPUT, xinput_task());
+    LOOP_PROFILE(LOOP_STAGE_COMMAND, command_task());
+    LOOP_PROFILE(LOOP_STAGE_WEAR_LEVELING,
+                 storage_reloaded = wear_leveling_task());
+    if (storage_reloaded) {
+      // The persistent configuration has been recovered from older data
+      eeconfig_init();
+      layout_reset_runtime_state();
+      layout_init();
+    }
 #if defined(__arm__)
     __asm__ volatile ("wfi");
 #endif
@@ -32,7 +32,7 @@ matrix_ema(uint16_t sample, uint16_t filtered, uint8_t exponent) {
 }
 
 __attribute__((always_inline)) static inline uint16_t
-matrix_filter_adc(uint8_t key, uint16_t sample) {
+matrix_filter_adc(key_index_t key, uint16_t sample) {
   const key_state_t *state = &key_matrix[key];
   const uint16_t filtered = state->adc_filtered;
   const uint16_t delta =
@@ -48,7 +48,7 @@ matrix_filter_adc(uint8_t key, uint16_t sample) {
 }
 
 __attribute__((always_inline)) static inline uint16_t
-matrix_analog_read(uint8_t key) {
+matrix_analog_read(key_index_t key) {
 #if defined(MATRIX_INVERT_ADC_VALUES)
   return ADC_MAX_VALUE - analog_read(key);
 #else
@@ -57,7 +57,7 @@ matrix_analog_read(uint8_t key) {
 }
 
 __attribute__((always_inline)) static inline uint16_t
-matrix_bottom_out_value(uint8_t key, uint16_t rest_value) {
+matrix_bottom_out_value(key_index_t key, uint16_t rest_value) {
   return M_MIN(rest_value +
                    M_MAX(eeconfig->calibration.initial_bottom_out_threshold,
                          eeconfig->bottom_out_threshold[key]),
@@ -65,7 +65,7 @@ matrix_bottom_out_value(uint8_t key, uint16_t rest_value) {
 }
 
 __attribute__((always_inline)) static inline void
-matrix_apply_continuous_calibration(uint8_t key, uint16_t sample) {
+matrix_apply_continuous_calibration(key_index_t key, uint16_t sample) {
   key_state_t *state = &key_matrix[key];
   const int32_t diff = (int32_t)sample - (int32_t)state->adc_rest_value;
   const uint16_t diff_abs =
@@ -164,12 +164,15 @@ void matrix_recalibrate(bool reset_bottom_out_threshold) {
 
 void matrix_scan(void) {
   const uint32_t scan_time = timer_read();
+  // Events are timed in microseconds, so that the events of consecutive scans
+  // within the same millisecond are still ordered
+  const uint64_t scan_time_us = timer_read_us();
   for (uint32_t i = 0; i < NUM_KEYS; i++) {
     key_state_t *state = &key_matrix[i];
     const uint16_t previous_filtered = state->adc_filtered;
-    const uint16_t raw_adc = matrix_analog_read((uint8_t)i);
+    const uint16_t raw_adc = matrix_analog_read((key_index_t)i);
     const uint16_t new_adc_filtered =
-        matrix_filter_adc((uint8_t)i, raw_adc);
+        matrix_filter_adc((key_index_t)i, raw_adc);
     const actuation_t *actuation = &CURRENT_PROFILE.actuation_map[i];
 
     state->adc_raw = raw_adc;
@@ -254,19 +257,20 @@ void matrix_scan(void) {
     else if (eeconfig->options.continuous_calibration &&
              scan_time - state->rest_stable_since >=
                  MATRIX_CONTINUOUS_CALIBRATION_IDLE_MS)
-      matrix_apply_continuous_calibration((uint8_t)i, new_adc_filtered);
+      matrix_apply_continuous_calibration((key_index_t)i, new_adc_filtered);
 
     // Record the time when the key state changes. This is used by
     // layout_task to process key events in chronological order instead of
     // preventing key input swapping on simultaneous presses.
     if (state->is_pressed != was_pressed) {
-      state->event_time = scan_time;
+      state->event_time = scan_time_us;
       matrix_last_activity_time = scan_time;
       EVENT_TRACE(
-          "[event] matrix key=%u action=%s time=%lu distance=%u raw=%u "
+          "[event] matrix key=%u action=%s time=%llu distance=%u raw=%u "
           "filtered=%u\n",
           (unsigned int)i, state->is_pressed ? "press" : "release",
-          (unsigned long)scan_time, state->distance, raw_adc, new_adc_filtered);
+          (unsigned long long)scan_time_us, state->distance, raw_adc,
+          new_adc_filtered);
 #if defined(RGB_ENABLED)
       if (state->is_pressed) {
         rgb_matrix_record_keypress(i);
@@ -291,7 +295,7 @@ void matrix_scan(void) {
   }
 }
 
-void matrix_disable_rapid_trigger(uint8_t key, bool disable) {
+void matrix_disable_rapid_trigger(key_index_t key, bool disable) {
   bitmap_set(rapid_trigger_disabled, key, disable);
 }
 
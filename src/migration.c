@@ -102,785 +102,382 @@
   (MIGRATION_PROFILE_SIZE_WITH_MACROS(13) +                                  \
    MIGRATION_PROFILE_RGB_SIZE_V1_12 + MIGRATION_PROFILE_JOYSTICK_SIZE_CURRENT)
 
-static uint8_t migration_bufs[2][sizeof(eeconfig_t)];
-
-static bool v1_1_global_config_func(uint8_t *dst, const uint8_t *src);
-static bool v1_1_profile_config_func(uint8_t profile, uint8_t *dst,
-                                     const uint8_t *src);
-
-static bool v1_2_global_config_func(uint8_t *dst, const uint8_t *src);
-static bool v1_2_profile_config_func(uint8_t profile, uint8_t *dst,
-                                     const uint8_t *src);
-
-static bool v1_3_global_config_func(uint8_t *dst, const uint8_t *src);
-static bool v1_3_profile_config_func(uint8_t profile, uint8_t *dst,
-                                     const uint8_t *src);
-
-static bool v1_4_global_config_func(uint8_t *dst, const uint8_t *src);
-static bool v1_4_profile_config_func(uint8_t profile, uint8_t *dst,
-                                     const uint8_t *src);
-
-static bool v1_5_global_config_func(uint8_t *dst, const uint8_t *src);
-static bool v1_5_profile_config_func(uint8_t profile, uint8_t *dst,
-                                     const uint8_t *src);
-
-static bool v1_6_global_config_func(uint8_t *dst, const uint8_t *src);
-static bool v1_6_profile_config_func(uint8_t profile, uint8_t *dst,
-                                     const uint8_t *src);
-
-static bool v1_7_global_config_func(uint8_t *dst, const uint8_t *src);
-static bool v1_7_profile_config_func(uint8_t profile, uint8_t *dst,
-                                     const uint8_t *src);
-
-static bool v1_A_global_config_func(uint8_t *dst, const uint8_t *src);
-static bool v1_A_profile_config_func(uint8_t profile, uint8_t *dst,
-                                     const uint8_t *src);
-
-static bool v1_B_global_config_func(uint8_t *dst, const uint8_t *src);
-static bool v1_B_profile_config_func(uint8_t profile, uint8_t *dst,
-                                     const uint8_t *src);
-
-static bool v1_C_global_config_func(uint8_t *dst, const uint8_t *src);
-static bool v1_C_profile_config_func(uint8_t profile, uint8_t *dst,
-                                     const uint8_t *src);
-
-static bool v1_D_global_config_func(uint8_t *dst, const uint8_t *src);
-static bool v1_D_profile_config_func(uint8_t profile, uint8_t *dst,
-                                     const uint8_t *src);
-static bool v1_E_global_config_func(uint8_t *dst, const uint8_t *src);
-static bool v1_E_profile_config_func(uint8_t profile, uint8_t *dst,
-                                     const uint8_t *src);
-static bool v1_F_global_config_func(uint8_t *dst, const uint8_t *src);
-static bool v1_F_profile_config_func(uint8_t profile, uint8_t *dst,
-                                     const uint8_t *src);
-static bool v1_10_global_config_func(uint8_t *dst, const uint8_t *src);
-static bool v1_10_profile_config_func(uint8_t profile, uint8_t *dst,
-                                      const uint8_t *src);
-static bool v1_11_global_config_func(uint8_t *dst, const uint8_t *src);
-static bool v1_11_profile_config_func(uint8_t profile, uint8_t *dst,
-                                     const uint8_t *src);
-static bool v1_12_global_config_func(uint8_t *dst, const uint8_t *src);
-static bool v1_12_profile_config_func(uint8_t profile, uint8_t *dst,
-                                      const uint8_t *src);
-static void migration_copy_unchanged(uint8_t *dst, const uint8_t *src,
-                                     uint32_t old_size, uint32_t new_size);
-
-// Migration metadata for each configuration version. The first entry is
-// reserved for the initial version (v1.0) which does not require migration.
-static const migration_t migrations[] = {
-    {
-        .version = 0x0100,
-        .global_config_size = MIGRATION_GLOBAL_CONFIG_SIZE_V1_0,
-        .profile_config_size = NUM_LAYERS * NUM_KEYS    // Keymap
-                               + NUM_KEYS * 4           // Actuation map
-                               + NUM_ADVANCED_KEYS * 12 // Advanced keys
-                               + 1                      // Tick rate
-        ,
-    },
-    {
-        .version = 0x0101,
-        .global_config_size = MIGRATION_GLOBAL_CONFIG_SIZE_V1_1,
-        .profile_config_size = MIGRATION_PROFILE_BASE_SIZE(12),
-        .global_config_func = v1_1_global_config_func,
-        .profile_config_func = v1_1_profile_config_func,
-    },
-    {
-        .version = 0x0102,
-        .global_config_size = MIGRATION_GLOBAL_CONFIG_SIZE_WITH_BOTTOM_OUT,
-        .profile_config_size = MIGRATION_PROFILE_BASE_SIZE(12),
-        .global_config_func = v1_2_global_config_func,
-        .profile_config_func = v1_2_profile_config_func,
-    },
-    {
-        .version = 0x0103,
-        .global_config_size = MIGRATION_GLOBAL_CONFIG_SIZE_WITH_BOTTOM_OUT,
-        .profile_config_size = MIGRATION_PROFILE_BASE_SIZE(12),
-        .global_config_func = v1_3_global_config_func,
-        .profile_config_func = v1_3_profile_config_func,
-    },
-    {
-        .version = 0x0104,
-        .global_config_size = MIGRATION_GLOBAL_CONFIG_SIZE_WITH_BOTTOM_OUT,
-        .profile_config_size = MIGRATION_PROFILE_BASE_SIZE(12),
-        .global_config_func = v1_4_global_config_func,
-        .profile_config_func = v1_4_profile_config_func,
-    },
-    {
-        .version = 0x0105,
-        .global_config_size = MIGRATION_GLOBAL_CONFIG_SIZE_WITH_BOTTOM_OUT,
-        .profile_config_size = MIGRATION_PROFILE_SIZE_WITH_MACROS(12),
-        .global_config_func = v1_5_global_config_func,
-        .profile_config_func = v1_5_profile_config_func,
-    },
-    {
-        // v1.5 -> v1.6: Added TAP_DANCE (same advanced_key size = 12 bytes)
-        .version = 0x0106,
-        .global_config_size = MIGRATION_GLOBAL_CONFIG_SIZE_WITH_BOTTOM_OUT,
-        .profile_config_size = MIGRATION_PROFILE_SIZE_WITH_MACROS(12),
-        .global_config_func = v1_6_global_config_func,
-        .profile_config_func = v1_6_profile_config_func,
-    },
-    {
-        // v1.6 -> v1.7: Removed TAP_DANCE, added double_tap_keycode to tap_hold.
-        //               Each advanced_key grew from 12 to 13 bytes.
-        .version = 0x0107,
-        .global_config_size = MIGRATION_GLOBAL_CONFIG_SIZE_WITH_BOTTOM_OUT,
-        .profile_config_size = MIGRATION_PROFILE_SIZE_WITH_MACROS(13),
-        .global_config_func = v1_7_global_config_func,
-        .profile_config_func = v1_7_profile_config_func,
-    },
-    {
-        .version = 0x0108,
-        .global_config_size = MIGRATION_GLOBAL_CONFIG_SIZE_WITH_BOTTOM_OUT,
-        .profile_config_size = MIGRATION_PROFILE_SIZE_V1_8_PLUS,
-        .global_config_func = NULL,
-        .profile_config_func = NULL,
-    },
-    {
-        .version = 0x0109,
-        .global_config_size = MIGRATION_GLOBAL_CONFIG_SIZE_WITH_BOTTOM_OUT,
-        .profile_config_size = MIGRATION_PROFILE_SIZE_V1_8_PLUS,
-        .global_config_func = NULL,
-        .profile_config_func = NULL,
-    },
-    {
-        .version = 0x010A,
-        .global_config_size = MIGRATION_GLOBAL_CONFIG_SIZE_WITH_BOTTOM_OUT,
-        .profile_config_size = MIGRATION_PROFILE_SIZE_V1_A_PLUS,
-        .global_config_func = v1_A_global_config_func,
-        .profile_config_func = v1_A_profile_config_func,
-    },
-    {
-        .version = 0x010B,
-        .global_config_size = MIGRATION_GLOBAL_CONFIG_SIZE_WITH_BOTTOM_OUT,
-        .profile_config_size = MIGRATION_PROFILE_SIZE_V1_A_PLUS,
-        .global_config_func = v1_B_global_config_func,
-        .profile_config_func = v1_B_profile_config_func,
-    },
-    {
-        .version = 0x010C,
-        .global_config_size = MIGRATION_GLOBAL_CONFIG_SIZE_WITH_OPTIONS32,
-        .profile_config_size = MIGRATION_PROFILE_SIZE_V1_A_PLUS,
-        .global_config_func = v1_C_global_config_func,
-        .profile_config_func = v1_C_profile_config_func,
-    },
-    {
-        .version = 0x010D,
-        .global_config_size = MIGRATION_GLOBAL_CONFIG_SIZE_WITH_OPTIONS32,
-        .profile_config_size = MIGRATION_PROFILE_SIZE_V1_D_PLUS,
-        .global_config_func = v1_D_global_config_func,
-        .profile_config_func = v1_D_profile_config_func,
-    },
-    {
-        .version = 0x010E,
-        .global_config_size = MIGRATION_GLOBAL_CONFIG_SIZE_WITH_OPTIONS32,
-        .profile_config_size = MIGRATION_PROFILE_SIZE_V1_D_PLUS,
-        .global_config_func = v1_E_global_config_func,
-        .profile_config_func = v1_E_profile_config_func,
-    },
-    {
-        .version = 0x010F,
-        .global_config_size = MIGRATION_GLOBAL_CONFIG_SIZE_WITH_OPTIONS32,
-        .profile_config_size = MIGRATION_PROFILE_SIZE_V1_F_PLUS,
-        .global_config_func = v1_F_global_config_func,
-        .profile_config_func = v1_F_profile_config_func,
-    },
-    {
-        .version = 0x0110,
-        .global_config_size = MIGRATION_GLOBAL_CONFIG_SIZE_WITH_OPTIONS32,
-        .profile_config_size = MIGRATION_PROFILE_SIZE_V1_10_PLUS,
-        .global_config_func = v1_10_global_config_func,
-        .profile_config_func = v1_10_profile_config_func,
-    },
-    {
-        .version = 0x0111,
-        .global_config_size = MIGRATION_GLOBAL_CONFIG_SIZE_WITH_OPTIONS32,
-        .profile_config_size = MIGRATION_PROFILE_SIZE_V1_11_PLUS,
-        .global_config_func = v1_11_global_config_func,
-        .profile_config_func = v1_11_profile_config_func,
-    },
-    {
-        .version = 0x0112,
-        .global_config_size = MIGRATION_GLOBAL_CONFIG_SIZE_WITH_OPTIONS32,
-        .profile_config_size = MIGRATION_PROFILE_SIZE_V1_12_PLUS,
-        .global_config_func = v1_12_global_config_func,
-        .profile_config_func = v1_12_profile_config_func,
-    },
-};
-
-bool migration_try_migrate(void) {
-  if (eeconfig->magic_start != EECONFIG_MAGIC_START)
-    // The magic start is always the same for any version.
-    return false;
-
-  const uint16_t config_version = eeconfig->version;
-  // We alternate between two buffers to save the memory.
-  uint8_t current_buf = 0;
-
-  // Let `migration_bufs[0]` be the current configuration.
-  memcpy(migration_bufs[0], eeconfig, sizeof(eeconfig_t));
-  // Skip v1.0 migration since it is the initial version
-  for (uint32_t i = 1; i < M_ARRAY_SIZE(migrations); i++) {
-    const migration_t *m = &migrations[i];
-    const migration_t *prev_m = &migrations[i - 1];
-
-    if (m->version <= config_version)
-      // Skip migrations that are not applicable
-      continue;
-
-    const uint8_t *src = migration_bufs[current_buf];
-    uint8_t *dst = migration_bufs[current_buf ^ 1];
-    memset(dst, 0, sizeof(migration_bufs[0]));
+// The scripts describe the layouts with 8-bit key indices. Keyboards with more
+// than 255 keys have no earlier configuration in their layout to migrate: they
+// could not be built before key indices were widened, or the index of their
+// last key was `KEY_INDEX_NONE`.
+#if !defined(KEY_INDEX_16BIT)
+_Static_assert(MIGRATION_GLOBAL_CONFIG_SIZE_WITH_OPTIONS32 ==
+                       offsetof(eeconfig_t, base_profile) &&
+                   MIGRATION_PROFILE_SIZE_V1_12_PLUS ==
+                       sizeof(eeconfig_profile_t),
+               "The latest migration must produce the current eeconfig_t.");
+#endif
 
-    if (m->global_config_func) {
-      if (!m->global_config_func(dst, src))
-        // Migration failed for the global configuration
-        return false;
-    } else {
-      migration_copy_unchanged(dst, src, prev_m->global_config_size,
-                               m->global_config_size);
-    }
+// Size of the window each migrated element is assembled in before it is
+// written back
+#define MIGRATION_WINDOW_SIZE WL_MAX_BYTES_PER_ENTRY
 
-    for (uint8_t p = 0; p < NUM_PROFILES; p++) {
-      // Move the pointers to the start of each profile configuration
-      const uint8_t *profile_src =
-          src + prev_m->global_config_size + p * prev_m->profile_config_size;
-      uint8_t *profile_dst =
-          dst + m->global_config_size + p * m->profile_config_size;
-
-      if (m->profile_config_func) {
-        if (!m->profile_config_func(p, profile_dst, profile_src))
-          // Migration failed for the profile configuration
-          return false;
-      } else {
-        migration_copy_unchanged(profile_dst, profile_src,
-                                 prev_m->profile_config_size,
-                                 m->profile_config_size);
-      }
-    }
+#if defined(JOYSTICK_ENABLED)
+_Static_assert(sizeof(joystick_config_t) <= MIGRATION_WINDOW_SIZE,
+               "joystick_config_t must fit in the migration window.");
+#endif
 
-    // Update the version in the destination buffer
-    ((eeconfig_t *)dst)->version = m->version;
-    // Switch to the next buffer for the next migration
-    current_buf ^= 1;
-  }
+// Bytes before an element that its transform may read, such as the legacy RGB
+// config the trigger state colors are derived from
+#define MIGRATION_SOURCE_LOOKBEHIND MIGRATION_PROFILE_RGB_SIZE_V1_D
 
-  // Make sure the configuration is valid after migration
-  ((eeconfig_t *)migration_bufs[current_buf])->magic_end = EECONFIG_MAGIC_END;
-  // We reflect the update in the flash.
-  return wear_leveling_write(0, migration_bufs[current_buf],
-                             sizeof(eeconfig_t));
-}
+static uint8_t migration_window[MIGRATION_WINDOW_SIZE];
+// Source of each batch, read through the wear leveling module since the
+// configuration may not be kept in RAM past the global configurations
+static uint8_t
+    migration_source[MIGRATION_SOURCE_LOOKBEHIND + MIGRATION_WINDOW_SIZE];
 
 //--------------------------------------------------------------------+
-// Helper Functions
+// Migration Script Operations
 //--------------------------------------------------------------------+
 
-static void migration_memcpy(uint8_t **dst, const uint8_t **src, uint32_t len) {
-  memcpy(*dst, *src, len);
-  *dst += len;
-  *src += len;
-}
+// Copy `len` bytes
+#define MIGRATION_COPY(len) {.count = (len), .src_size = 1, .dst_size = 1}
+// Fill `len` new bytes with `val`
+#define MIGRATION_FILL(val, len)                                               \
+  {.count = (len), .src_size = 0, .dst_size = 1, .value = (val)}
+// Extend each of `n` elements from `old_size` to `new_size` bytes with zeros
+#define MIGRATION_EXTEND(n, old_size, new_size)                                \
+  {.count = (n), .src_size = (old_size), .dst_size = (new_size)}
+// Convert each of `n` elements from `old_size` to `new_size` bytes with `func`
+#define MIGRATION_TRANSFORM(n, old_size, new_size, func)                       \
+  {.count = (n),                                                               \
+   .src_size = (old_size),                                                     \
+   .dst_size = (new_size),                                                     \
+   .transform = (func)}
 
-static void migration_memset(uint8_t **dst, uint8_t value, uint32_t len) {
-  memset(*dst, value, len);
-  *dst += len;
-}
+#define MIGRATION_SCRIPT(script)                                               \
+  {.ops = (script), .num_ops = M_ARRAY_SIZE(script)}
 
-static void migration_copy_unchanged(uint8_t *dst, const uint8_t *src,
-                                     uint32_t old_size, uint32_t new_size) {
-  const uint32_t common_size = M_MIN(old_size, new_size);
-  memcpy(dst, src, common_size);
-  if (new_size > common_size) {
-    memset(dst + common_size, 0, new_size - common_size);
-  }
-}
+static const migration_op_t global_config_with_bottom_out_unchanged[] = {
+    MIGRATION_COPY(MIGRATION_GLOBAL_CONFIG_SIZE_WITH_BOTTOM_OUT),
+};
 
-#define MAKE_MIGRATION_ASSIGN(type)                                            \
-  static void migration_assign_##type(uint8_t **dst, type value) {             \
-    *(type *)(*dst) = value;                                                   \
-    *dst = (uint8_t *)((type *)(*dst) + 1);                                    \
-  }
+static const migration_op_t global_config_with_options32_unchanged[] = {
+    MIGRATION_COPY(MIGRATION_GLOBAL_CONFIG_SIZE_WITH_OPTIONS32),
+};
+
+static const migration_op_t profile_config_base_unchanged[] = {
+    MIGRATION_COPY(MIGRATION_PROFILE_BASE_SIZE(12)),
+};
 
-MAKE_MIGRATION_ASSIGN(uint8_t)
-MAKE_MIGRATION_ASSIGN(uint16_t)
+static const migration_op_t profile_config_v1_A_plus_unchanged[] = {
+    MIGRATION_COPY(MIGRATION_PROFILE_SIZE_V1_A_PLUS),
+};
 
 #if defined(RGB_ENABLED)
 static void migration_assign_rgb_color(uint8_t **dst, rgb_color_t color) {
   memcpy(*dst, &color, sizeof(color));
   *dst += sizeof(color);
 }
-
-static void migration_append_trigger_state_colors(uint8_t **dst,
-                                                  rgb_color_t solid_color,
-                                                  rgb_color_t secondary_color) {
-  migration_assign_rgb_color(
-      dst, (rgb_color_t){.r = secondary_color.r >> 2,
-                         .g = secondary_color.g >> 2,
-                         .b = secondary_color.b >> 2});
-  migration_assign_rgb_color(dst, secondary_color);
-  migration_assign_rgb_color(dst, solid_color);
-  migration_assign_rgb_color(dst, solid_color);
-}
 #endif
 
 //--------------------------------------------------------------------+
 // v1.0 -> v1.1 Migration
 //--------------------------------------------------------------------+
 
-bool v1_1_global_config_func(uint8_t *dst, const uint8_t *src) {
-  if (((eeconfig_t *)src)->version != 0x0100)
-    // Expected version v1.0
-    return false;
+static void v1_1_keycode(uint8_t *dst, const uint8_t *src) {
+  // Update keycodes to include `KC_INT1` ... `KC_LNG6`
+  if (0x70 <= *src && *src <= 0x71)
+    // `KC_LNG1` and `KC_LNG2`
+    *dst = *src + 0x06;
+  else if (0x72 <= *src && *src <= 0x96)
+    // `KC_LEFT_CTRL` ... `SP_MOUSE_BUTTON_5`
+    *dst = *src + 0x09;
+  else
+    *dst = *src;
+}
+
+static void v1_1_advanced_key(uint8_t *dst, const uint8_t *src) {
+  memcpy(dst, src, 12);
+  // Default `hold_on_other_key_press` to 0
+  if (dst[2] == AK_TYPE_TAP_HOLD)
+    dst[7] = 0;
+}
 
-  // Copy `magic_start` to `calibration`
-  migration_memcpy(&dst, &src, 10);
-  // Default `options` to 0
-  migration_assign_uint16_t(&dst, 0);
-  // Copy `current_profile` and `last_non_default_profile`
-  migration_memcpy(&dst, &src, 2);
+static void v1_1_gamepad_options(uint8_t *dst, const uint8_t *src) {
+  static const uint8_t default_gamepad_options[] = {
+      // Default `analog_curve` to linear
+      4, 20, 85, 95, 165, 170, 255, 255,
+      // Default `keyboard_enabled` and `snappy_joystick` to true
+      0b00001001,
+  };
 
-  return true;
+  (void)src;
+  memcpy(dst, default_gamepad_options, sizeof(default_gamepad_options));
 }
 
-bool v1_1_profile_config_func(uint8_t profile, uint8_t *dst,
-                              const uint8_t *src) {
-  // Save the `keymap` offset
-  uint8_t *keymap = dst;
-  // Copy `keymap` to `actuation_map`
-  migration_memcpy(&dst, &src, (NUM_LAYERS * NUM_KEYS) + (NUM_KEYS * 4));
-  // Update keycodes to include `KC_INT1` ... `KC_LNG6`
-  for (uint32_t i = 0; i < NUM_LAYERS * NUM_KEYS; i++) {
-    if (0x70 <= keymap[i] && keymap[i] <= 0x71)
-      // `KC_LNG1` and `KC_LNG2`
-      keymap[i] += 0x06;
-    else if (0x72 <= keymap[i] && keymap[i] <= 0x96)
-      // `KC_LEFT_CTRL` ... `SP_MOUSE_BUTTON_5`
-      keymap[i] += 0x09;
-  }
-  // Save the `advanced_keys` offset
-  uint8_t *advanced_keys = dst;
-  // Copy `advanced_keys`
-  migration_memcpy(&dst, &src, MIGRATION_PROFILE_ADVANCED_KEYS_SIZE(12));
-  // Default `hold_on_other_key_press` to 0
-  for (uint8_t i = 0; i < NUM_ADVANCED_KEYS; i++) {
-    uint8_t *ak = advanced_keys + i * 12;
-    if (ak[2] == AK_TYPE_TAP_HOLD)
-      ak[7] = 0;
-  }
-  // Set `gamepad_buttons` to 0
-  migration_memset(&dst, 0, NUM_KEYS);
-  // Default `analog_curve` to linear
-  migration_assign_uint8_t(&dst, 4), migration_assign_uint8_t(&dst, 20);
-  migration_assign_uint8_t(&dst, 85), migration_assign_uint8_t(&dst, 95);
-  migration_assign_uint8_t(&dst, 165), migration_assign_uint8_t(&dst, 170);
-  migration_assign_uint8_t(&dst, 255), migration_assign_uint8_t(&dst, 255);
-  // Default `keyboard_enabled` and `snappy_joystick` to true
-  migration_assign_uint8_t(&dst, 0b00001001);
-  // Copy `tick_rate`
-  migration_memcpy(&dst, &src, 1);
+static const migration_op_t v1_1_global_config_script[] = {
+    // Copy `magic_start` to `calibration`
+    MIGRATION_COPY(10),
+    // Default `options` to 0
+    MIGRATION_FILL(0, 2),
+    // Copy `current_profile` and `last_non_default_profile`
+    MIGRATION_COPY(2),
+};
 
-  return true;
-}
+static const migration_op_t v1_1_profile_config_script[] = {
+    MIGRATION_TRANSFORM(NUM_LAYERS * NUM_KEYS, 1, 1, v1_1_keycode),
+    // Copy `actuation_map`
+    MIGRATION_COPY(NUM_KEYS * 4),
+    MIGRATION_TRANSFORM(NUM_ADVANCED_KEYS, 12, 12, v1_1_advanced_key),
+    // Set `gamepad_buttons` to 0
+    MIGRATION_FILL(0, NUM_KEYS),
+    MIGRATION_TRANSFORM(1, 0, 9, v1_1_gamepad_options),
+    // Copy `tick_rate`
+    MIGRATION_COPY(1),
+};
 
 //--------------------------------------------------------------------+
 // v1.1 -> v1.2 Migration
 //--------------------------------------------------------------------+
 
-bool v1_2_global_config_func(uint8_t *dst, const uint8_t *src) {
-  if (((eeconfig_t *)src)->version != 0x0101)
-    // Expected version v1.1
-    return false;
-
-  // Copy `magic_start` to `calibration`
-  migration_memcpy(&dst, &src, 10);
-  // Set `bottom_out_threshold` to 0
-  migration_memset(&dst, 0, NUM_KEYS * 2);
-  // Copy `options` to `last_non_default_profile`
-  migration_memcpy(&dst, &src, 4);
-
-  return true;
-}
-
-bool v1_2_profile_config_func(uint8_t profile, uint8_t *dst,
-                              const uint8_t *src) {
-  // Copy the entire profile
-  migration_memcpy(&dst, &src, MIGRATION_PROFILE_BASE_SIZE(12));
-
-  return true;
-}
+static const migration_op_t v1_2_global_config_script[] = {
+    // Copy `magic_start` to `calibration`
+    MIGRATION_COPY(10),
+    // Set `bottom_out_threshold` to 0
+    MIGRATION_FILL(0, NUM_KEYS * 2),
+    // Copy `options` to `last_non_default_profile`
+    MIGRATION_COPY(4),
+};
 
 //--------------------------------------------------------------------+
 // v1.2 -> v1.3 Migration
 //--------------------------------------------------------------------+
 
-bool v1_3_global_config_func(uint8_t *dst, const uint8_t *src) {
-  if (((eeconfig_t *)src)->version != 0x0102)
-    // Expected version v1.2
-    return false;
-
-  // Copy `magic_start` to `bottom_out_threshold`
-  migration_memcpy(&dst, &src, 10 + NUM_KEYS * 2);
+static void v1_3_options(uint8_t *dst, const uint8_t *src) {
+  uint16_t options;
+  memcpy(&options, src, sizeof(options));
   // Default `save_bottom_out_threshold` to true
-  uint16_t options = *((uint16_t *)src) | (1 << 1);
-  migration_assign_uint16_t(&dst, options);
-  src += sizeof(options);
-  // Copy `current_profile` to `last_non_default_profile`
-  migration_memcpy(&dst, &src, 2);
-
-  return true;
+  options |= 1 << 1;
+  memcpy(dst, &options, sizeof(options));
 }
 
-bool v1_3_profile_config_func(uint8_t profile, uint8_t *dst,
-                              const uint8_t *src) {
-  // Copy the entire profile
-  migration_memcpy(&dst, &src, MIGRATION_PROFILE_BASE_SIZE(12));
-
-  return true;
-}
+static const migration_op_t v1_3_global_config_script[] = {
+    // Copy `magic_start` to `bottom_out_threshold`
+    MIGRATION_COPY(10 + NUM_KEYS * 2),
+    MIGRATION_TRANSFORM(1, 2, 2, v1_3_options),
+    // Copy `current_profile` to `last_non_default_profile`
+    MIGRATION_COPY(2),
+};
 
 //--------------------------------------------------------------------+
 // v1.3 -> v1.4 Migration
 //--------------------------------------------------------------------+
 
-bool v1_4_global_config_func(uint8_t *dst, const uint8_t *src) {
-  if (((eeconfig_t *)src)->version != 0x0103)
-    // Expected version v1.3
-    return false;
-
-  // Copy `magic_start` to `bottom_out_threshold`
-  migration_memcpy(&dst, &src, 10 + NUM_KEYS * 2);
+static void v1_4_options(uint8_t *dst, const uint8_t *src) {
+  uint16_t options;
+  memcpy(&options, src, sizeof(options));
   // Default `high_polling_rate_enabled` to true
-  uint16_t options = *((uint16_t *)src) | (1 << 2);
-  migration_assign_uint16_t(&dst, options);
-  src += sizeof(options);
-  // Copy `current_profile` to `last_non_default_profile`
-  migration_memcpy(&dst, &src, 2);
-
-  return true;
+  options |= 1 << 2;
+  memcpy(dst, &options, sizeof(options));
 }
 
-bool v1_4_profile_config_func(uint8_t profile, uint8_t *dst,
-                               const uint8_t *src) {
-  // Copy the entire profile
-  migration_memcpy(&dst, &src, MIGRATION_PROFILE_BASE_SIZE(12));
-
-  return true;
-}
+static const migration_op_t v1_4_global_config_script[] = {
+    // Copy `magic_start` to `bottom_out_threshold`
+    MIGRATION_COPY(10 + NUM_KEYS * 2),
+    MIGRATION_TRANSFORM(1, 2, 2, v1_4_options),
+    // Copy `current_profile` to `last_non_default_profile`
+    MIGRATION_COPY(2),
+};
 
 //--------------------------------------------------------------------+
 // v1.4 -> v1.5 Migration
 //--------------------------------------------------------------------+
 
-bool v1_5_global_config_func(uint8_t *dst, const uint8_t *src) {
-  if (((eeconfig_t *)src)->version != 0x0104)
-    // Expected version v1.4
-    return false;
-
-  // Global config unchanged, copy everything
-  migration_memcpy(&dst, &src, MIGRATION_GLOBAL_CONFIG_SIZE_WITH_BOTTOM_OUT);
-
-  return true;
-}
-
-bool v1_5_profile_config_func(uint8_t profile, uint8_t *dst,
-                               const uint8_t *src) {
-  // Copy existing profile data (keymap + actuation + advanced_keys +
-  // gamepad_buttons + gamepad_options + tick_rate)
-  migration_memcpy(&dst, &src, MIGRATION_PROFILE_BASE_SIZE(12));
-  // Initialize macros to zero (MACRO_ACTION_END)
-  migration_memset(&dst, 0, NUM_MACROS * sizeof(macro_t));
-
-  return true;
-}
+static const migration_op_t v1_5_profile_config_script[] = {
+    // Copy existing profile data (keymap + actuation + advanced_keys +
+    // gamepad_buttons + gamepad_options + tick_rate)
+    MIGRATION_COPY(MIGRATION_PROFILE_BASE_SIZE(12)),
+    // Initialize macros to zero (MACRO_ACTION_END)
+    MIGRATION_FILL(0, NUM_MACROS * sizeof(macro_t)),
+};
 
 //--------------------------------------------------------------------+
 // v1.5 -> v1.6 Migration
 //--------------------------------------------------------------------+
 
-bool v1_6_global_config_func(uint8_t *dst, const uint8_t *src) {
-  if (((eeconfig_t *)src)->version != 0x0105)
-    return false;
-
-  // Global config unchanged
-  migration_memcpy(&dst, &src, MIGRATION_GLOBAL_CONFIG_SIZE_WITH_BOTTOM_OUT);
-  return true;
-}
-
-bool v1_6_profile_config_func(uint8_t profile, uint8_t *dst,
-                               const uint8_t *src) {
-  // Profile layout unchanged: advanced_key size is still 12 bytes
-  migration_memcpy(&dst, &src, MIGRATION_PROFILE_SIZE_WITH_MACROS(12));
-  return true;
-}
+// Added TAP_DANCE, but the advanced_key size is still 12 bytes
+static const migration_op_t v1_6_profile_config_script[] = {
+    MIGRATION_COPY(MIGRATION_PROFILE_SIZE_WITH_MACROS(12)),
+};
 
 //--------------------------------------------------------------------+
 // v1.6 -> v1.7 Migration
 //--------------------------------------------------------------------+
 
-bool v1_7_global_config_func(uint8_t *dst, const uint8_t *src) {
-  if (((eeconfig_t *)src)->version != 0x0106)
-    return false;
-
-  // Global config unchanged
-  migration_memcpy(&dst, &src, MIGRATION_GLOBAL_CONFIG_SIZE_WITH_BOTTOM_OUT);
-  return true;
-}
+static const migration_op_t v1_7_profile_config_script[] = {
+    // Copy keymap and actuation map (unchanged)
+    MIGRATION_COPY(NUM_LAYERS * NUM_KEYS + NUM_KEYS * 4),
+    // Expand each advanced key from 12 bytes to 13 bytes. The extra byte is
+    // double_tap_keycode (appended at the end of tap_hold data), defaulted to
+    // 0 (KC_NO).
+    MIGRATION_EXTEND(NUM_ADVANCED_KEYS, 12, 13),
+    // Copy remaining profile data unchanged
+    MIGRATION_COPY(MIGRATION_PROFILE_TRAILING_SIZE_WITH_MACROS(13)),
+};
 
-bool v1_7_profile_config_func(uint8_t profile, uint8_t *dst,
-                               const uint8_t *src) {
-  // Copy keymap and actuation map (unchanged)
-  migration_memcpy(&dst, &src, NUM_LAYERS * NUM_KEYS + NUM_KEYS * 4);
-
-  // Expand each advanced key from 12 bytes to 13 bytes.
-  // The extra byte is double_tap_keycode (appended at the end of tap_hold data),
-  // defaulted to 0 (KC_NO).
-  for (uint32_t i = 0; i < NUM_ADVANCED_KEYS; i++) {
-    // Copy 12 bytes of old entry as-is
-    migration_memcpy(&dst, &src, 12);
-    // Append 1 byte of zero for the new double_tap_keycode field
-    migration_memset(&dst, 0, 1);
-  }
+//--------------------------------------------------------------------+
+// v1.7 -> v1.8 Migration
+//--------------------------------------------------------------------+
 
-  // Copy remaining profile data unchanged
-  migration_memcpy(
-      &dst, &src, MIGRATION_PROFILE_TRAILING_SIZE_WITH_MACROS(13));
-  return true;
-}
+static const migration_op_t v1_8_profile_config_script[] = {
+    MIGRATION_COPY(MIGRATION_PROFILE_SIZE_WITH_MACROS(13)),
+    // Initialize `rgb_config` and `joystick_config` to zero
+    MIGRATION_FILL(0, MIGRATION_PROFILE_RGB_SIZE_V1_8 +
+                          MIGRATION_PROFILE_JOYSTICK_SIZE_LEGACY),
+};
 
 //--------------------------------------------------------------------+
-// v1.9 -> v1.A Migration
+// v1.8 -> v1.9 Migration
 //--------------------------------------------------------------------+
 
-bool v1_A_global_config_func(uint8_t *dst, const uint8_t *src) {
-  if (((eeconfig_t *)src)->version != 0x0109)
-    return false;
-
-  // Global config unchanged
-  migration_memcpy(&dst, &src, MIGRATION_GLOBAL_CONFIG_SIZE_WITH_BOTTOM_OUT);
-  return true;
-}
+static const migration_op_t v1_9_profile_config_script[] = {
+    MIGRATION_COPY(MIGRATION_PROFILE_SIZE_V1_8_PLUS),
+};
 
-bool v1_A_profile_config_func(uint8_t profile, uint8_t *dst,
-                               const uint8_t *src) {
-  // Pre-RGB stuff remains the same
-  migration_memcpy(&dst, &src, MIGRATION_PROFILE_SIZE_WITH_MACROS(13));
+//--------------------------------------------------------------------+
+// v1.9 -> v1.A Migration
+//--------------------------------------------------------------------+
 
+static const migration_op_t v1_A_profile_config_script[] = {
+    // Pre-RGB stuff remains the same
+    MIGRATION_COPY(MIGRATION_PROFILE_SIZE_WITH_MACROS(13)),
 #if defined(RGB_ENABLED)
-  // At v1.9 rgb_config was: enabled(1)+brightness(1)+effect(1)+solid(3)+speed(1) = 7 bytes
-  migration_memcpy(&dst, &src, 7);
-
-  // New fields at v1.A: sleep_timeout(1) + layer_indicator_mode(1) + layer_indicator_key(1) + layer_colors(3*NUM_LAYERS)
-  migration_memset(&dst, 0, 1 + 2 + 3 * NUM_LAYERS);
-
-  // Copy per_key_colors (3*NUM_KEYS)
-  migration_memcpy(&dst, &src, MIGRATION_PROFILE_RGB_PER_KEY_COLORS_SIZE);
+    // At v1.9 rgb_config was: enabled(1)+brightness(1)+effect(1)+solid(3)+speed(1) = 7 bytes
+    MIGRATION_COPY(7),
+    // New fields at v1.A: sleep_timeout(1) + layer_indicator_mode(1) + layer_indicator_key(1) + layer_colors(3*NUM_LAYERS)
+    MIGRATION_FILL(0, 1 + 2 + 3 * NUM_LAYERS),
+    // Copy per_key_colors (3*NUM_KEYS)
+    MIGRATION_COPY(MIGRATION_PROFILE_RGB_PER_KEY_COLORS_SIZE),
 #endif
-
 #if defined(JOYSTICK_ENABLED)
-  migration_memcpy(&dst, &src, MIGRATION_PROFILE_JOYSTICK_SIZE_LEGACY);
+    MIGRATION_COPY(MIGRATION_PROFILE_JOYSTICK_SIZE_LEGACY),
 #endif
-
-  return true;
-}
+};
 
 //--------------------------------------------------------------------+
 // v1.A -> v1.B Migration
 //--------------------------------------------------------------------+
 
-bool v1_B_global_config_func(uint8_t *dst, const uint8_t *src) {
-  if (((eeconfig_t *)src)->version != 0x010A)
-    return false;
-
-  eeconfig_t *new_config = (eeconfig_t *)dst;
-
-  // Global config size remains unchanged
-  migration_memcpy(&dst, &src, MIGRATION_GLOBAL_CONFIG_SIZE_WITH_BOTTOM_OUT);
-
+static void v1_B_options(uint8_t *dst, const uint8_t *src) {
+  eeconfig_options_t options = {.raw = 0};
+  memcpy(&options, src, 2);
   // Initialize new sniper_mode_multiplier to 50% (128)
-  new_config->options.sniper_mode_multiplier = 128;
-
-  return true;
+  options.sniper_mode_multiplier = 128;
+  memcpy(dst, &options, 2);
 }
 
-bool v1_B_profile_config_func(uint8_t profile, uint8_t *dst,
-                               const uint8_t *src) {
-  // Entire profile config size remains unchanged
-  migration_memcpy(&dst, &src, MIGRATION_PROFILE_SIZE_V1_A_PLUS);
-  return true;
-}
+static const migration_op_t v1_B_global_config_script[] = {
+    // Copy `magic_start` to `bottom_out_threshold`
+    MIGRATION_COPY(10 + NUM_KEYS * 2),
+    MIGRATION_TRANSFORM(1, 2, 2, v1_B_options),
+    // Copy `current_profile` to `last_non_default_profile`
+    MIGRATION_COPY(2),
+};
 
 //--------------------------------------------------------------------+
 // v1.B -> v1.C Migration
 //--------------------------------------------------------------------+
 
-bool v1_C_global_config_func(uint8_t *dst, const uint8_t *src) {
-  if (((eeconfig_t *)src)->version != 0x010B)
-    return false;
-
-  eeconfig_t *new_config = (eeconfig_t *)dst;
-
-  // Copy everything before options (10 + NUM_KEYS * 2 bytes)
-  migration_memcpy(&dst, &src, 10 + NUM_KEYS * 2);
-
-  // Copy old options (2 bytes)
-  uint16_t old_options;
-  memcpy(&old_options, src, 2);
-  src += 2;
-
-  // Assign to new 32-bit options
-  new_config->options.raw = (uint32_t)old_options;
-  dst += 4;
-
-  // Copy remaining global fields: current_profile and last_non_default_profile
-  migration_memcpy(&dst, &src, 2);
-
-  return true;
-}
-
-bool v1_C_profile_config_func(uint8_t profile, uint8_t *dst,
-                               const uint8_t *src) {
-  // Entire profile config size remains unchanged
-  migration_memcpy(&dst, &src, MIGRATION_PROFILE_SIZE_V1_A_PLUS);
-  return true;
-}
+static const migration_op_t v1_C_global_config_script[] = {
+    // Copy everything before options (10 + NUM_KEYS * 2 bytes)
+    MIGRATION_COPY(10 + NUM_KEYS * 2),
+    // Widen `options` to 32 bits
+    MIGRATION_EXTEND(1, 2, 4),
+    // Copy remaining global fields: current_profile and last_non_default_profile
+    MIGRATION_COPY(2),
+};
 
 //--------------------------------------------------------------------+
 // v1.C -> v1.D Migration
 //--------------------------------------------------------------------+
 
-bool v1_D_global_config_func(uint8_t *dst, const uint8_t *src) {
-  if (((eeconfig_t *)src)->version != 0x010C)
-    return false;
-
-  // Global config unchanged
-  migration_memcpy(&dst, &src, MIGRATION_GLOBAL_CONFIG_SIZE_WITH_OPTIONS32);
-  return true;
-}
-
-bool v1_D_profile_config_func(uint8_t profile, uint8_t *dst,
-                              const uint8_t *src) {
-  // Profile fields before rgb_config are unchanged.
-  migration_memcpy(&dst, &src, MIGRATION_PROFILE_SIZE_WITH_MACROS(13));
-
+static const migration_op_t v1_D_profile_config_script[] = {
+    // Profile fields before rgb_config are unchanged.
+    MIGRATION_COPY(MIGRATION_PROFILE_SIZE_WITH_MACROS(13)),
 #if defined(RGB_ENABLED)
-  // v1.C RGB layout:
-  // enabled(1), brightness(1), effect(1), solid(3), effect_speed(1),
-  // sleep_timeout(1), layer_indicator_mode(1), layer_indicator_key(1),
-  // layer_colors(3*NUM_LAYERS), per_key_colors(3*NUM_KEYS)
-  //
-  // v1.D inserts secondary_color(3) after solid_color.
-  migration_memcpy(&dst, &src, 6); // enabled..solid_color
-  migration_assign_uint8_t(&dst, 255);
-  migration_assign_uint8_t(&dst, 255);
-  migration_assign_uint8_t(&dst, 255);
-  migration_memcpy(&dst, &src, MIGRATION_PROFILE_RGB_V1_A_TAIL_SIZE);
+    // v1.C RGB layout:
+    // enabled(1), brightness(1), effect(1), solid(3), effect_speed(1),
+    // sleep_timeout(1), layer_indicator_mode(1), layer_indicator_key(1),
+    // layer_colors(3*NUM_LAYERS), per_key_colors(3*NUM_KEYS)
+    //
+    // v1.D inserts secondary_color(3) after solid_color.
+    MIGRATION_COPY(6), // enabled..solid_color
+    MIGRATION_FILL(255, 3),
+    MIGRATION_COPY(MIGRATION_PROFILE_RGB_V1_A_TAIL_SIZE),
 #endif
-
 #if defined(JOYSTICK_ENABLED)
-  // Joystick config unchanged.
-  migration_memcpy(&dst, &src, MIGRATION_PROFILE_JOYSTICK_SIZE_LEGACY);
+    // Joystick config unchanged.
+    MIGRATION_COPY(MIGRATION_PROFILE_JOYSTICK_SIZE_LEGACY),
 #endif
-
-  return true;
-}
+};
 
 //--------------------------------------------------------------------+
 // v1.D -> v1.E Migration
 //--------------------------------------------------------------------+
 
-bool v1_E_global_config_func(uint8_t *dst, const uint8_t *src) {
-  if (((eeconfig_t *)src)->version != 0x010D)
-    return false;
-
-  // Global config unchanged
-  migration_memcpy(&dst, &src, MIGRATION_GLOBAL_CONFIG_SIZE_WITH_OPTIONS32);
-  return true;
+#if defined(JOYSTICK_ENABLED)
+static void v1_E_joystick_config(uint8_t *dst, const uint8_t *src) {
+  memcpy(dst, src, MIGRATION_PROFILE_JOYSTICK_SIZE_LEGACY);
+  // Initialize the new debounce field from the old reserved byte if it was
+  // zero.
+  if (dst[offsetof(joystick_config_t, sw_debounce_ms)] == 0)
+    dst[offsetof(joystick_config_t, sw_debounce_ms)] = 5;
 }
+#endif
 
-bool v1_E_profile_config_func(uint8_t profile, uint8_t *dst,
-                              const uint8_t *src) {
-  // Profile fields before rgb_config are unchanged.
-  migration_memcpy(&dst, &src, MIGRATION_PROFILE_SIZE_WITH_MACROS(13));
-
+static const migration_op_t v1_E_profile_config_script[] = {
+    // Profile fields before rgb_config are unchanged.
+    MIGRATION_COPY(MIGRATION_PROFILE_SIZE_WITH_MACROS(13)),
 #if defined(RGB_ENABLED)
-  // RGB config unchanged.
-  migration_memcpy(&dst, &src, MIGRATION_PROFILE_RGB_SIZE_V1_D);
+    // RGB config unchanged.
+    MIGRATION_COPY(MIGRATION_PROFILE_RGB_SIZE_V1_D),
 #endif
-
 #if defined(JOYSTICK_ENABLED)
-  // Preserve joystick config, but initialize the new debounce field from the
-  // old reserved byte if it was zero.
-  uint8_t joystick_config[MIGRATION_PROFILE_JOYSTICK_SIZE_LEGACY];
-  migration_memcpy(&dst, &src, MIGRATION_PROFILE_JOYSTICK_SIZE_LEGACY);
-  memcpy(joystick_config, dst - MIGRATION_PROFILE_JOYSTICK_SIZE_LEGACY,
-         sizeof(joystick_config));
-  if (joystick_config[offsetof(joystick_config_t, sw_debounce_ms)] == 0)
-    joystick_config[offsetof(joystick_config_t, sw_debounce_ms)] = 5;
-  memcpy(dst - MIGRATION_PROFILE_JOYSTICK_SIZE_LEGACY, joystick_config,
-         sizeof(joystick_config));
+    MIGRATION_TRANSFORM(1, MIGRATION_PROFILE_JOYSTICK_SIZE_LEGACY,
+                        MIGRATION_PROFILE_JOYSTICK_SIZE_LEGACY,
+                        v1_E_joystick_config),
 #endif
-
-  return true;
-}
+};
 
 //--------------------------------------------------------------------+
 // v1.E -> v1.F Migration
 //--------------------------------------------------------------------+
 
-bool v1_F_global_config_func(uint8_t *dst, const uint8_t *src) {
-  if (((eeconfig_t *)src)->version != 0x010E)
-    return false;
-
-  migration_memcpy(&dst, &src, MIGRATION_GLOBAL_CONFIG_SIZE_WITH_OPTIONS32);
-  return true;
-}
-
-bool v1_F_profile_config_func(uint8_t profile, uint8_t *dst,
-                              const uint8_t *src) {
-  (void)profile;
-
-  migration_memcpy(&dst, &src, MIGRATION_PROFILE_SIZE_WITH_MACROS(13));
-
-#if defined(RGB_ENABLED)
-  migration_memcpy(&dst, &src, MIGRATION_PROFILE_RGB_SIZE_V1_D);
-#endif
-
 #if defined(JOYSTICK_ENABLED)
+static void v1_F_joystick_config(uint8_t *dst, const uint8_t *src) {
   joystick_config_t joystick_config;
   joystick_init_default_config(&joystick_config);
   memcpy(&joystick_config, src, MIGRATION_PROFILE_JOYSTICK_SIZE_LEGACY);
-  memcpy(dst, &joystick_config, sizeof(joystick_config));
-  dst += sizeof(joystick_config);
-  src += MIGRATION_PROFILE_JOYSTICK_SIZE_LEGACY;
+  memcpy(dst, &joystick_config, MIGRATION_PROFILE_JOYSTICK_SIZE_V1_F);
+}
 #endif
 
-  return true;
-}
+static const migration_op_t v1_F_profile_config_script[] = {
+    MIGRATION_COPY(MIGRATION_PROFILE_SIZE_WITH_MACROS(13)),
+#if defined(RGB_ENABLED)
+    MIGRATION_COPY(MIGRATION_PROFILE_RGB_SIZE_V1_D),
+#endif
+#if defined(JOYSTICK_ENABLED)
+    MIGRATION_TRANSFORM(1, MIGRATION_PROFILE_JOYSTICK_SIZE_LEGACY,
+                        MIGRATION_PROFILE_JOYSTICK_SIZE_V1_F,
+                        v1_F_joystick_config),
+#endif
+};
 
 //--------------------------------------------------------------------+
 // v1.F -> v1.10 Migration
 //--------------------------------------------------------------------+
 
-bool v1_10_global_config_func(uint8_t *dst, const uint8_t *src) {
-  if (((eeconfig_t *)src)->version != 0x010F)
-    return false;
-
-  migration_memcpy(&dst, &src, MIGRATION_GLOBAL_CONFIG_SIZE_WITH_OPTIONS32);
-  return true;
-}
-
-bool v1_10_profile_config_func(uint8_t profile, uint8_t *dst,
-                               const uint8_t *src) {
-  (void)profile;
-
-  migration_memcpy(&dst, &src, MIGRATION_PROFILE_SIZE_WITH_MACROS(13));
-
-#if defined(RGB_ENABLED)
-  migration_memcpy(&dst, &src, MIGRATION_PROFILE_RGB_SIZE_V1_D);
-#endif
-
 #if defined(JOYSTICK_ENABLED)
+static void v1_10_joystick_config(uint8_t *dst, const uint8_t *src) {
   joystick_config_t joystick_config;
   joystick_init_default_config(&joystick_config);
   memcpy(&joystick_config, src, MIGRATION_PROFILE_JOYSTICK_SIZE_V1_F);
@@ -889,79 +486,449 @@ bool v1_10_profile_config_func(uint8_t profile, uint8_t *dst,
                                       joystick_config.mouse_acceleration);
   joystick_config.active_mouse_preset = 0u;
   memcpy(dst, &joystick_config, sizeof(joystick_config));
-  dst += sizeof(joystick_config);
-  src += MIGRATION_PROFILE_JOYSTICK_SIZE_V1_F;
+}
 #endif
 
-  return true;
-}
+static const migration_op_t v1_10_profile_config_script[] = {
+    MIGRATION_COPY(MIGRATION_PROFILE_SIZE_WITH_MACROS(13)),
+#if defined(RGB_ENABLED)
+    MIGRATION_COPY(MIGRATION_PROFILE_RGB_SIZE_V1_D),
+#endif
+#if defined(JOYSTICK_ENABLED)
+    MIGRATION_TRANSFORM(1, MIGRATION_PROFILE_JOYSTICK_SIZE_V1_F,
+                        MIGRATION_PROFILE_JOYSTICK_SIZE_CURRENT,
+                        v1_10_joystick_config),
+#endif
+};
 
 //--------------------------------------------------------------------+
 // v1.10 -> v1.11 Migration
 //--------------------------------------------------------------------+
 
-bool v1_11_global_config_func(uint8_t *dst, const uint8_t *src) {
-  if (((eeconfig_t *)src)->version != 0x0110)
-    return false;
+#if defined(RGB_ENABLED)
+static void v1_11_trigger_state_colors(uint8_t *dst, const uint8_t *src) {
+  // `src` points right after the legacy RGB config
+  const rgb_config_t *legacy_rgb =
+      (const rgb_config_t *)(src - MIGRATION_PROFILE_RGB_SIZE_V1_D);
+  const rgb_color_t solid_color = legacy_rgb->solid_color;
+  const rgb_color_t secondary_color = legacy_rgb->secondary_color;
 
-  migration_memcpy(&dst, &src, MIGRATION_GLOBAL_CONFIG_SIZE_WITH_OPTIONS32);
-  return true;
+  migration_assign_rgb_color(
+      &dst, (rgb_color_t){.r = secondary_color.r >> 2,
+                          .g = secondary_color.g >> 2,
+                          .b = secondary_color.b >> 2});
+  migration_assign_rgb_color(&dst, secondary_color);
+  migration_assign_rgb_color(&dst, solid_color);
+  migration_assign_rgb_color(&dst, solid_color);
 }
+#endif
 
-bool v1_11_profile_config_func(uint8_t profile, uint8_t *dst,
-                               const uint8_t *src) {
-  (void)profile;
+static const migration_op_t v1_11_profile_config_script[] = {
+    MIGRATION_COPY(MIGRATION_PROFILE_SIZE_WITH_MACROS(13)),
+#if defined(RGB_ENABLED)
+    MIGRATION_COPY(MIGRATION_PROFILE_RGB_SIZE_V1_D),
+    MIGRATION_TRANSFORM(1, 0, MIGRATION_PROFILE_RGB_TRIGGER_STATE_COLORS_SIZE,
+                        v1_11_trigger_state_colors),
+#endif
+#if defined(JOYSTICK_ENABLED)
+    MIGRATION_COPY(MIGRATION_PROFILE_JOYSTICK_SIZE_CURRENT),
+#endif
+};
 
-  migration_memcpy(&dst, &src, MIGRATION_PROFILE_SIZE_WITH_MACROS(13));
+//--------------------------------------------------------------------+
+// v1.11 -> v1.12 Migration
+//--------------------------------------------------------------------+
 
 #if defined(RGB_ENABLED)
-  migration_memcpy(&dst, &src, MIGRATION_PROFILE_RGB_SIZE_V1_D);
-
-  const rgb_config_t *legacy_rgb =
-      (const rgb_config_t *)(dst - MIGRATION_PROFILE_RGB_SIZE_V1_D);
-  migration_append_trigger_state_colors(
-      &dst, legacy_rgb->solid_color, legacy_rgb->secondary_color);
+static void v1_12_background_color(uint8_t *dst, const uint8_t *src) {
+  // `src` points right after the legacy secondary color
+  memcpy(dst, src - sizeof(rgb_color_t), sizeof(rgb_color_t));
+}
 #endif
 
+static const migration_op_t v1_12_profile_config_script[] = {
+    MIGRATION_COPY(MIGRATION_PROFILE_SIZE_WITH_MACROS(13)),
+#if defined(RGB_ENABLED)
+    MIGRATION_COPY(9), // enabled..secondary_color
+    MIGRATION_TRANSFORM(1, 0, sizeof(rgb_color_t), v1_12_background_color),
+    MIGRATION_COPY(MIGRATION_PROFILE_RGB_V1_11_TAIL_SIZE),
+#endif
 #if defined(JOYSTICK_ENABLED)
-  migration_memcpy(&dst, &src, MIGRATION_PROFILE_JOYSTICK_SIZE_CURRENT);
+    MIGRATION_COPY(MIGRATION_PROFILE_JOYSTICK_SIZE_CURRENT),
 #endif
+};
 
-  return true;
+//--------------------------------------------------------------------+
+// v1.12 -> v1.13 Migration
+//--------------------------------------------------------------------+
+
+static const migration_op_t profile_config_v1_12_plus_unchanged[] = {
+    MIGRATION_COPY(MIGRATION_PROFILE_SIZE_V1_12_PLUS),
+};
+
+static bool v1_13_write_profile_slots(void) {
+  // The first profile stays in place as the base profile, and the others are
+  // at the start of the delta area, stored as a whole.
+  eeconfig_profile_slot_t slots[NUM_PROFILES] = {{0}};
+
+  if ((NUM_PROFILES - 1) * sizeof(eeconfig_profile_t) >
+      EECONFIG_PROFILE_DELTAS_SIZE)
+    return false;
+
+  for (uint32_t p = 1; p < NUM_PROFILES; p++) {
+    slots[p].offset = (uint16_t)((p - 1) * sizeof(eeconfig_profile_t));
+    slots[p].size = sizeof(eeconfig_profile_t);
+  }
+
+  return wear_leveling_write(offsetof(eeconfig_t, profile_slots), slots,
+                             sizeof(slots));
 }
 
 //--------------------------------------------------------------------+
-// v1.11 -> v1.12 Migration
+// Migration Metadata
 //--------------------------------------------------------------------+
 
-bool v1_12_global_config_func(uint8_t *dst, const uint8_t *src) {
-  if (((eeconfig_t *)src)->version != 0x0111)
-    return false;
+// Migration metadata for each configuration version. The first entry is
+// reserved for the initial version (v1.0) which does not require migration.
+static const migration_t migrations[] = {
+    {
+        .version = 0x0100,
+        .global_config_size = MIGRATION_GLOBAL_CONFIG_SIZE_V1_0,
+        .profile_config_size = NUM_LAYERS * NUM_KEYS    // Keymap
+                               + NUM_KEYS * 4           // Actuation map
+                               + NUM_ADVANCED_KEYS * 12 // Advanced keys
+                               + 1                      // Tick rate
+        ,
+    },
+    {
+        .version = 0x0101,
+        .global_config_size = MIGRATION_GLOBAL_CONFIG_SIZE_V1_1,
+        .profile_config_size = MIGRATION_PROFILE_BASE_SIZE(12),
+        .global_config_script = MIGRATION_SCRIPT(v1_1_global_config_script),
+        .profile_config_script = MIGRATION_SCRIPT(v1_1_profile_config_script),
+    },
+    {
+        .version = 0x0102,
+        .global_config_size = MIGRATION_GLOBAL_CONFIG_SIZE_WITH_BOTTOM_OUT,
+        .profile_config_size = MIGRATION_PROFILE_BASE_SIZE(12),
+        .global_config_script = MIGRATION_SCRIPT(v1_2_global_config_script),
+        .profile_config_script = MIGRATION_SCRIPT(profile_config_base_unchanged),
+    },
+    {
+        .version = 0x0103,
+        .global_config_size = MIGRATION_GLOBAL_CONFIG_SIZE_WITH_BOTTOM_OUT,
+        .profile_config_size = MIGRATION_PROFILE_BASE_SIZE(12),
+        .global_config_script = MIGRATION_SCRIPT(v1_3_global_config_script),
+        .profile_config_script = MIGRATION_SCRIPT(profile_config_base_unchanged),
+    },
+    {
+        .version = 0x0104,
+        .global_config_size = MIGRATION_GLOBAL_CONFIG_SIZE_WITH_BOTTOM_OUT,
+        .profile_config_size = MIGRATION_PROFILE_BASE_SIZE(12),
+        .global_config_script = MIGRATION_SCRIPT(v1_4_global_config_script),
+        .profile_config_script = MIGRATION_SCRIPT(profile_config_base_unchanged),
+    },
+    {
+        .version = 0x0105,
+        .global_config_size = MIGRATION_GLOBAL_CONFIG_SIZE_WITH_BOTTOM_OUT,
+        .profile_config_size = MIGRATION_PROFILE_SIZE_WITH_MACROS(12),
+        .global_config_script =
+            MIGRATION_SCRIPT(global_config_with_bottom_out_unchanged),
+        .profile_config_script = MIGRATION_SCRIPT(v1_5_profile_config_script),
+    },
+    {
+        // v1.5 -> v1.6: Added TAP_DANCE (same advanced_key size = 12 bytes)
+        .version = 0x0106,
+        .global_config_size = MIGRATION_GLOBAL_CONFIG_SIZE_WITH_BOTTOM_OUT,
+        .profile_config_size = MIGRATION_PROFILE_SIZE_WITH_MACROS(12),
+        .global_config_script =
+            MIGRATION_SCRIPT(global_config_with_bottom_out_unchanged),
+        .profile_config_script = MIGRATION_SCRIPT(v1_6_profile_config_script),
+    },
+    {
+        // v1.6 -> v1.7: Removed TAP_DANCE, added double_tap_keycode to tap_hold.
+        //               Each advanced_key grew from 12 to 13 bytes.
+        .version = 0x0107,
+        .global_config_size = MIGRATION_GLOBAL_CONFIG_SIZE_WITH_BOTTOM_OUT,
+        .profile_config_size = MIGRATION_PROFILE_SIZE_WITH_MACROS(13),
+        .global_config_script =
+            MIGRATION_SCRIPT(global_config_with_bottom_out_unchanged),
+        .profile_config_script = MIGRATION_SCRIPT(v1_7_profile_config_script),
+    },
+    {
+        .version = 0x0108,
+        .global_config_size = MIGRATION_GLOBAL_CONFIG_SIZE_WITH_BOTTOM_OUT,
+        .profile_config_size = MIGRATION_PROFILE_SIZE_V1_8_PLUS,
+        .global_config_script =
+            MIGRATION_SCRIPT(global_config_with_bottom_out_unchanged),
+        .profile_config_script = MIGRATION_SCRIPT(v1_8_profile_config_script),
+    },
+    {
+        .version = 0x0109,
+        .global_config_size = MIGRATION_GLOBAL_CONFIG_SIZE_WITH_BOTTOM_OUT,
+        .profile_config_size = MIGRATION_PROFILE_SIZE_V1_8_PLUS,
+        .global_config_script =
+            MIGRATION_SCRIPT(global_config_with_bottom_out_unchanged),
+        .profile_config_script = MIGRATION_SCRIPT(v1_9_profile_config_script),
+    },
+    {
+        .version = 0x010A,
+        .global_config_size = MIGRATION_GLOBAL_CONFIG_SIZE_WITH_BOTTOM_OUT,
+        .profile_config_size = MIGRATION_PROFILE_SIZE_V1_A_PLUS,
+        .global_config_script =
+            MIGRATION_SCRIPT(global_config_with_bottom_out_unchanged),
+        .profile_config_script = MIGRATION_SCRIPT(v1_A_profile_config_script),
+    },
+    {
+        .version = 0x010B,
+        .global_config_size = MIGRATION_GLOBAL_CONFIG_SIZE_WITH_BOTTOM_OUT,
+        .profile_config_size = MIGRATION_PROFILE_SIZE_V1_A_PLUS,
+        .global_config_script = MIGRATION_SCRIPT(v1_B_global_config_script),
+        .profile_config_script =
+            MIGRATION_SCRIPT(profile_config_v1_A_plus_unchanged),
+    },
+    {
+        .version = 0x010C,
+        .global_config_size = MIGRATION_GLOBAL_CONFIG_SIZE_WITH_OPTIONS32,
+        .profile_config_size = MIGRATION_PROFILE_SIZE_V1_A_PLUS,
+        .global_config_script = MIGRATION_SCRIPT(v1_C_global_config_script),
+        .profile_config_script =
+            MIGRATION_SCRIPT(profile_config_v1_A_plus_unchanged),
+    },
+    {
+        .version = 0x010D,
+        .global_config_size = MIGRATION_GLOBAL_CONFIG_SIZE_WITH_OPTIONS32,
+        .profile_config_size = MIGRATION_PROFILE_SIZE_V1_D_PLUS,
+        .global_config_script =
+            MIGRATION_SCRIPT(global_config_with_options32_unchanged),
+        .profile_config_script = MIGRATION_SCRIPT(v1_D_profile_config_script),
+    },
+    {
+        .version = 0x010E,
+        .global_config_size = MIGRATION_GLOBAL_CONFIG_SIZE_WITH_OPTIONS32,
+        .profile_config_size = MIGRATION_PROFILE_SIZE_V1_D_PLUS,
+        .global_config_script =
+            MIGRATION_SCRIPT(global_config_with_options32_unchanged),
+        .profile_config_script = MIGRATION_SCRIPT(v1_E_profile_config_script),
+    },
+    {
+        .version = 0x010F,
+        .global_config_size = MIGRATION_GLOBAL_CONFIG_SIZE_WITH_OPTIONS32,
+        .profile_config_size = MIGRATION_PROFILE_SIZE_V1_F_PLUS,
+        .global_config_script =
+            MIGRATION_SCRIPT(global_config_with_options32_unchanged),
+        .profile_config_script = MIGRATION_SCRIPT(v1_F_profile_config_script),
+    },
+    {
+        .version = 0x0110,
+        .global_config_size = MIGRATION_GLOBAL_CONFIG_SIZE_WITH_OPTIONS32,
+        .profile_config_size = MIGRATION_PROFILE_SIZE_V1_10_PLUS,
+        .global_config_script =
+            MIGRATION_SCRIPT(global_config_with_options32_unchanged),
+        .profile_config_script = MIGRATION_SCRIPT(v1_10_profile_config_script),
+    },
+    {
+        .version = 0x0111,
+        .global_config_size = MIGRATION_GLOBAL_CONFIG_SIZE_WITH_OPTIONS32,
+        .profile_config_size = MIGRATION_PROFILE_SIZE_V1_11_PLUS,
+        .global_config_script =
+            MIGRATION_SCRIPT(global_config_with_options32_unchanged),
+        .profile_config_script = MIGRATION_SCRIPT(v1_11_profile_config_script),
+    },
+    {
+        .version = 0x0112,
+        .global_config_size = MIGRATION_GLOBAL_CONFIG_SIZE_WITH_OPTIONS32,
+        .profile_config_size = MIGRATION_PROFILE_SIZE_V1_12_PLUS,
+        .global_config_script =
+            MIGRATION_SCRIPT(global_config_with_options32_unchanged),
+        .profile_config_script = MIGRATION_SCRIPT(v1_12_profile_config_script),
+    },
+    {
+        // v1.12 -> v1.13: Profiles are stored as delta records against the
+        //                 first profile. Later versions changing
+        //                 `eeconfig_profile_t` must convert the base profile
+        //                 and encode the delta records again.
+        .version = 0x0113,
+        .global_config_size = MIGRATION_GLOBAL_CONFIG_SIZE_WITH_OPTIONS32,
+        .profile_config_size = MIGRATION_PROFILE_SIZE_V1_12_PLUS,
+        .global_config_script =
+            MIGRATION_SCRIPT(global_config_with_options32_unchanged),
+        .profile_config_script =
+            MIGRATION_SCRIPT(profile_config_v1_12_plus_unchanged),
+        .finalize = v1_13_write_profile_slots,
+    },
+    {
+        // v1.13 -> v1.14: Added RAPID_FIRE (same advanced_key size = 13 bytes)
+        .version = 0x0114,
+        .global_config_size = MIGRATION_GLOBAL_CONFIG_SIZE_WITH_OPTIONS32,
+        .profile_config_size = MIGRATION_PROFILE_SIZE_V1_12_PLUS,
+        .global_config_script =
+            MIGRATION_SCRIPT(global_config_with_options32_unchanged),
+        .profile_config_script =
+            MIGRATION_SCRIPT(profile_config_v1_12_plus_unchanged),
+    },
+};
 
-  migration_memcpy(&dst, &src, MIGRATION_GLOBAL_CONFIG_SIZE_WITH_OPTIONS32);
-  return true;
+//--------------------------------------------------------------------+
+// Migration Engine
+//--------------------------------------------------------------------+
+
+/**
+ * @brief Check that a script converts a whole section in place
+ *
+ * Elements are never shrunk, so every element ends up at or after its source
+ * and the section can be converted from its end without overwriting data that
+ * has not been read yet.
+ *
+ * @param script Migration script
+ * @param old_size Size of the section in the previous version
+ * @param new_size Size of the section in the new version
+ *
+ * @return true if the script is valid, false otherwise
+ */
+static bool migration_script_is_valid(const migration_script_t *script,
+                                      uint32_t old_size, uint32_t new_size) {
+  uint32_t src_size = 0;
+  uint32_t dst_size = 0;
+
+  for (uint32_t i = 0; i < script->num_ops; i++) {
+    const migration_op_t *op = &script->ops[i];
+
+    if (op->dst_size == 0 || op->dst_size > MIGRATION_WINDOW_SIZE ||
+        op->dst_size < op->src_size)
+      return false;
+    src_size += op->count * op->src_size;
+    dst_size += op->count * op->dst_size;
+  }
+
+  return src_size == old_size && dst_size == new_size;
 }
 
-bool v1_12_profile_config_func(uint8_t profile, uint8_t *dst,
-                               const uint8_t *src) {
-  (void)profile;
+/**
+ * @brief Convert a section of the configuration in place
+ *
+ * The operations are applied from the end of the section. Each batch of
+ * elements is read through the wear leveling module, assembled in the window
+ * and written back.
+ *
+ * @param script Migration script
+ * @param dst_end End address of the section in the new version
+ * @param src_end End address of the section in the previous version
+ *
+ * @return true if the section has been written, false otherwise
+ */
+static bool migration_run_script(const migration_script_t *script,
+                                 uint32_t dst_end, uint32_t src_end) {
+  for (uint32_t i = script->num_ops; i-- > 0;) {
+    const migration_op_t *op = &script->ops[i];
+    const uint32_t dst_start = dst_end - op->count * op->dst_size;
+    const uint32_t src_start = src_end - op->count * op->src_size;
+
+    if (!op->transform && op->src_size == op->dst_size &&
+        src_start == dst_start) {
+      // Unchanged data already in place
+      dst_end = dst_start;
+      src_end = src_start;
+      continue;
+    }
 
-  migration_memcpy(&dst, &src, MIGRATION_PROFILE_SIZE_WITH_MACROS(13));
+    const uint32_t batch_size = MIGRATION_WINDOW_SIZE / op->dst_size;
+    for (uint32_t remaining = op->count; remaining > 0;) {
+      const uint32_t n = M_MIN(remaining, batch_size);
+      remaining -= n;
+      dst_end -= n * op->dst_size;
+      src_end -= n * op->src_size;
+
+      // Elements are never shrunk, so the source of a batch fits in the window
+      const uint32_t lookbehind = M_MIN(src_end, MIGRATION_SOURCE_LOOKBEHIND);
+      if (!wear_leveling_read(src_end - lookbehind, migration_source,
+                              lookbehind + n * op->src_size))
+        return false;
 
-#if defined(RGB_ENABLED)
-  migration_memcpy(&dst, &src, 9); // enabled..secondary_color
+      uint8_t *dst = migration_window;
+      const uint8_t *src = migration_source + lookbehind;
+      for (uint32_t j = 0; j < n; j++) {
+        if (op->transform) {
+          op->transform(dst, src);
+        } else {
+          memcpy(dst, src, op->src_size);
+          memset(dst + op->src_size, op->value, op->dst_size - op->src_size);
+        }
+        dst += op->dst_size;
+        src += op->src_size;
+      }
 
-  rgb_color_t legacy_background;
-  memcpy(&legacy_background, dst - sizeof(legacy_background),
-         sizeof(legacy_background));
-  migration_assign_rgb_color(&dst, legacy_background);
+      if (!wear_leveling_write(dst_end, migration_window, n * op->dst_size))
+        return false;
+    }
+  }
 
-  migration_memcpy(&dst, &src, MIGRATION_PROFILE_RGB_V1_11_TAIL_SIZE);
-#endif
+  return true;
+}
 
-#if defined(JOYSTICK_ENABLED)
-  migration_memcpy(&dst, &src, MIGRATION_PROFILE_JOYSTICK_SIZE_CURRENT);
+bool migration_try_migrate(void) {
+  if (eeconfig->magic_start != EECONFIG_MAGIC_START)
+    // The magic start is always the same for any version.
+    return false;
+
+#if defined(KEY_INDEX_16BIT)
+  // No earlier version has this layout, so the configuration is reset
+  return false;
 #endif
 
-  return true;
+  const uint16_t config_version = eeconfig->version;
+  // Skip v1.0 migration since it is the initial version
+  for (uint32_t i = 1; i < M_ARRAY_SIZE(migrations); i++) {
+    const migration_t *m = &migrations[i];
+    const migration_t *prev_m = &migrations[i - 1];
+
+    if (m->version <= config_version)
+      // Skip migrations that are not applicable
+      continue;
+
+    if (eeconfig->version != prev_m->version)
+      // The configuration must be at the previous version
+      return false;
+
+    if (m->global_config_size < prev_m->global_config_size ||
+        m->profile_config_size < prev_m->profile_config_size ||
+        !migration_script_is_valid(&m->global_config_script,
+                                   prev_m->global_config_size,
+                                   m->global_config_size) ||
+        !migration_script_is_valid(&m->profile_config_script,
+                                   prev_m->profile_config_size,
+                                   m->profile_config_size))
+      // The configuration cannot be converted in place
+      return false;
+
+    // Every section moves towards the end, so the sections are converted from
+    // the last profile to the global configuration.
+    for (uint32_t p = NUM_PROFILES; p-- > 0;) {
+      const uint32_t profile_dst_end =
+          m->global_config_size + (p + 1) * m->profile_config_size;
+      const uint32_t profile_src_end =
+          prev_m->global_config_size + (p + 1) * prev_m->profile_config_size;
+
+      if (!migration_run_script(&m->profile_config_script, profile_dst_end,
+                                profile_src_end))
+        return false;
+    }
+
+    if (!migration_run_script(&m->global_config_script, m->global_config_size,
+                              prev_m->global_config_size))
+      return false;
+
+    if (m->finalize && !m->finalize())
+      return false;
+
+    // Update the version once the whole configuration has been converted
+    if (!wear_leveling_write(offsetof(eeconfig_t, version), &m->version,
+                             sizeof(m->version)))
+      return false;
+  }
+
+  // Make sure the configuration is valid after migration
+  const uint32_t magic_end = EECONFIG_MAGIC_END;
+  return wear_leveling_write(offsetof(eeconfig_t, magic_end), &magic_end,
+                             sizeof(magic_end));
 }
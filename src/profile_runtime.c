@@ -17,13 +17,70 @@
 
 #include <string.h>
 
+#include "advanced_keys.h"
 #include "eeconfig.h"
 #include "joystick.h"
 #include "layout.h"
 #include "rgb.h"
 
-void profile_runtime_apply_current(void) {
-  layout_load_advanced_keys();
+static profile_runtime_image_t profile_runtime_images[NUM_PROFILES];
+const profile_runtime_image_t *profile_runtime = &profile_runtime_images[0];
+
+static void profile_runtime_load_advanced_keys(
+    const eeconfig_profile_t *profile, profile_runtime_image_t *image) {
+  memset(image->advanced_key_indices, 0, sizeof(image->advanced_key_indices));
+  for (uint32_t i = 0; i < NUM_ADVANCED_KEYS; i++) {
+    const advanced_key_t *ak = &profile->advanced_keys[i];
+
+    if (ak->type == AK_TYPE_NONE || ak->type == AK_TYPE_COMBO ||
+        ak->layer >= NUM_LAYERS || ak->key >= NUM_KEYS)
+      continue;
+
+    image->advanced_key_indices[ak->layer][ak->key] = i + 1;
+    if (ak->type == AK_TYPE_NULL_BIND && ak->null_bind.secondary_key < NUM_KEYS)
+      // Null Bind advanced keys also have a secondary key
+      image->advanced_key_indices[ak->layer][ak->null_bind.secondary_key] =
+          i + 1;
+  }
+}
+
+static void profile_runtime_summarize(const eeconfig_profile_t *profile,
+                                      profile_runtime_image_t *image) {
+  profile_capabilities_t capabilities = {0};
+
+  for (uint32_t i = 0; i < NUM_ADVANCED_KEYS; i++) {
+    const advanced_key_t *ak = &profile->advanced_keys[i];
+
+    if (ak->type == AK_TYPE_NONE || ak->type >= AK_TYPE_COUNT ||
+        ak->layer >= NUM_LAYERS)
+      continue;
+
+    capabilities.ak_types |= (uint16_t)PROFILE_AK_TYPE_BIT(ak->type);
+    if (ak->type == AK_TYPE_COMBO)
+      capabilities.num_combos++;
+  }
+
+  for (uint32_t i = 0; i < NUM_KEYS; i++) {
+    if (profile->gamepad_buttons[i] != GP_BUTTON_NONE) {
+      capabilities.has_gamepad_buttons = true;
+      break;
+    }
+  }
+
+  image->capabilities = capabilities;
+}
+
+/**
+ * @brief Select the runtime image of the current profile, and apply the RGB and
+ * joystick configurations
+ *
+ * @return None
+ */
+static void profile_runtime_select_current(void) {
+  profile_runtime = &profile_runtime_images[eeconfig_get_current_profile()];
+  // Invalidate combo bitmap cache so it's rebuilt with the definitions of the
+  // profile. Layer changes are handled lazily by combo_key_bitmap_rebuild().
+  advanced_key_combo_invalidate_cache();
 #if defined(RGB_ENABLED)
   memcpy(rgb_get_config(), &CURRENT_PROFILE.rgb_config, sizeof(rgb_config_t));
   rgb_apply_config();
@@ -36,7 +93,34 @@ void profile_runtime_apply_current(void) {
 #endif
 }
 
+void profile_runtime_init(void) {
+  for (uint32_t i = 0; i < NUM_PROFILES; i++)
+    profile_runtime_build((uint8_t)i);
+  profile_runtime_select_current();
+}
+
+void profile_runtime_build(uint8_t profile) {
+  if (profile >= NUM_PROFILES)
+    return;
+
+  const eeconfig_profile_t *config = eeconfig_get_profile(profile);
+  profile_runtime_image_t *image = &profile_runtime_images[profile];
+
+  profile_runtime_load_advanced_keys(config, image);
+  profile_runtime_summarize(config, image);
+}
+
+void profile_runtime_apply_current(void) {
+  profile_runtime_build(eeconfig_get_current_profile());
+  profile_runtime_select_current();
+}
+
 void profile_runtime_reload_current(void) {
   layout_reset_runtime_state();
   profile_runtime_apply_current();
 }
+
+void profile_runtime_switch_current(void) {
+  layout_reset_runtime_state();
+  profile_runtime_select_current();
+}
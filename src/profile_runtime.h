@@ -1,4 +1,82 @@
 #pragma once
 
+#include "common.h"
+
+#define PROFILE_AK_TYPE_BIT(type) (1u << (type))
+
+_Static_assert(AK_TYPE_COUNT <= 16, "Advanced key types must fit in ak_types");
+
+// Summary of the advanced keys and gamepad buttons of the current profile. The
+// layout reads it to skip the subsystems that the profile does not use.
+typedef struct {
+  // Bit `PROFILE_AK_TYPE_BIT(type)` is set if the profile has advanced keys of
+  // that type bound to a valid layer
+  uint16_t ak_types;
+  // Number of combos
+  uint8_t num_combos;
+  // Whether any key is mapped to a gamepad button
+  bool has_gamepad_buttons;
+} profile_capabilities_t;
+
+// Runtime image of a profile, built from its configuration ahead of time so
+// that switching to the profile does not rebuild its advanced key indices
+typedef struct {
+  // Indices of the advanced keys bound to each key. If no advanced key is bound
+  // to a key, the index is 0. Otherwise, the index is added by 1.
+  uint8_t advanced_key_indices[NUM_LAYERS][NUM_KEYS];
+  profile_capabilities_t capabilities;
+} profile_runtime_image_t;
+
+// Runtime image of the current profile
+extern const profile_runtime_image_t *profile_runtime;
+
+/**
+ * @brief Build the runtime images of every profile, and apply the current
+ * profile to the runtime
+ *
+ * @return None
+ */
+void profile_runtime_init(void);
+
+/**
+ * @brief Build the runtime image of a profile
+ *
+ * DESIGN INVARIANT: All code paths that modify the advanced keys or gamepad
+ * buttons of a profile (reset, duplicate, hmkconf update) MUST rebuild its
+ * image, through this function or `profile_runtime_reload_current()` for the
+ * current profile. Otherwise, switching to the profile selects a stale image.
+ *
+ * @param profile Profile index
+ *
+ * @return None
+ */
+void profile_runtime_build(uint8_t profile);
+
+/**
+ * @brief Apply the current profile to the runtime
+ *
+ * This function rebuilds the runtime image of the current profile, selects it,
+ * and applies the RGB and joystick configurations. It must be called whenever
+ * the advanced keys or gamepad buttons of the current profile change.
+ *
+ * @return None
+ */
 void profile_runtime_apply_current(void);
+
+/**
+ * @brief Reset the runtime state, then apply the current profile
+ *
+ * @return None
+ */
 void profile_runtime_reload_current(void);
+
+/**
+ * @brief Reset the runtime state, then select the runtime image of the current
+ * profile without rebuilding it
+ *
+ * This is what a profile switch costs besides materialising the profile, since
+ * the images of every profile are kept up to date.
+ *
+ * @return None
+ */
+void profile_runtime_switch_current(void);
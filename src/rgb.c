@@ -19,6 +19,7 @@
 #include "rgb_math.h"
 #include "rgb_reactive.h"
 #include "rgb_static.h"
+#include "rgb_stream.h"
 
 /*
  * Attribution:
@@ -33,9 +34,58 @@
  *   - RGB_EFFECT_TRIGGER_STATE
  */
 
+#if !defined(RGB_RENDER_CHUNK_LEDS)
+// Number of LEDs rendered per slice. A frame is spread across several
+// `rgb_task()` calls so a frame tick never stalls the scan loop.
+#define RGB_RENDER_CHUNK_LEDS 8
+#endif
+
+#if !defined(RGB_RENDER_CYCLE_BUDGET)
+// Number of CPU cycles a single `rgb_task()` call may keep rendering more
+// slices. The first slice of each call is always rendered, so 0 renders a
+// single slice per call.
+#define RGB_RENDER_CYCLE_BUDGET (F_CPU / 200000)
+#endif
+
+#if !defined(RGB_GAMMA)
+// Gamma applied to every channel on output. 1.0 sends the rendered values.
+#define RGB_GAMMA 1.0f
+#endif
+
+#if !defined(RGB_WHITE_BALANCE)
+// Output of the red, green and blue channels for a full-scale value
+#define RGB_WHITE_BALANCE {255, 255, 255}
+#endif
+
+#if !defined(RGB_MAX_CURRENT_MA)
+// Current budget of the LEDs in milliamps. 0 disables the limiter.
+#define RGB_MAX_CURRENT_MA 0
+#endif
+
+#if !defined(RGB_LED_CHANNEL_CURRENT_MA)
+// Current drawn by a single LED channel at full output, in milliamps
+#define RGB_LED_CHANNEL_CURRENT_MA 20
+#endif
+
+_Static_assert(RGB_RENDER_CHUNK_LEDS > 0, "Invalid RGB_RENDER_CHUNK_LEDS");
+_Static_assert(RGB_LED_CHANNEL_CURRENT_MA > 0,
+               "Invalid RGB_LED_CHANNEL_CURRENT_MA");
+
+// Current budget expressed as the sum of all channel outputs of a frame
+#define RGB_OUTPUT_BUDGET                                                      \
+    ((uint32_t)RGB_MAX_CURRENT_MA * 255u / RGB_LED_CHANNEL_CURRENT_MA)
+
 // We need an array to hold the current LED colors
 static rgb_color_t current_colors[NUM_LEDS];
-static uint8_t rgb_grb_data[NUM_LEDS * 3];
+// Packed GRB frames. Slices are packed into the back buffer as they are
+// rendered, and the buffers are swapped once the frame is complete.
+static uint8_t rgb_grb_data[2][NUM_LEDS * 3];
+static uint8_t rgb_grb_back;
+// Per-channel output curves combining gamma and white balance, indexed by
+// red, green and blue
+static uint8_t rgb_output_lut[3][256];
+// Sum of the channel outputs packed into the back buffer so far
+static uint32_t rgb_output_sum;
 static rgb_config_t rgb_config;
 static uint8_t rgb_clock_unique_y[NUM_LEDS];
 static uint8_t rgb_clock_row_leds[NUM_LEDS];
@@ -56,11 +106,42 @@ typedef struct {
     uint32_t sync_tick_ms;
 } rgb_clock_state_t;
 
+typedef struct {
+    rgb_color_t active_color;
+    rgb_color_t accent_color;
+    rgb_color_t background_color;
+    rgb_color_t pulse_color;
+    rgb_color_t separator_color;
+    rgb_color_t head_color;
+    uint8_t digits[4];
+    uint8_t second_step;
+} rgb_clock_frame_t;
+
 static rgb_clock_layout_t rgb_clock_layout;
 static rgb_clock_state_t rgb_clock_state;
+static rgb_clock_frame_t rgb_clock_frame;
+
+// Frame being rendered across `rgb_task()` calls
+typedef struct {
+    bool active;
+    uint8_t effect;
+    uint8_t next_led;
+    uint8_t effective_brightness;
+    uint32_t current_tick;
+    // Host stream frame shown instead of the stored effect, if any
+    const rgb_color_t *stream;
+    // Layer indicator override, applied on top of each slice
+    bool layer_fill;
+    uint8_t layer_led;
+    rgb_color_t layer_color;
+    rgb_animated_context_t animated_context;
+    rgb_static_context_t static_context;
+} rgb_frame_t;
+
+static rgb_frame_t rgb_frame;
 
 // Heatmap state
-void rgb_matrix_record_keypress(uint8_t index) {
+void rgb_matrix_record_keypress(key_index_t index) {
     rgb_reactive_record_keypress(index);
 }
 
@@ -82,12 +163,30 @@ void rgb_set_clock_time(uint8_t hours, uint8_t minutes, uint8_t seconds) {
     rgb_clock_state.sync_tick_ms = timer_read();
 }
 
+static void rgb_clock_build_layout(void);
+
+static void rgb_output_build_lut(void) {
+    static const uint8_t white_balance[3] = RGB_WHITE_BALANCE;
+
+    for (uint8_t channel = 0; channel < 3; channel++) {
+        for (uint16_t i = 0; i < 256; i++) {
+            const float level = powf((float)i / 255.0f, RGB_GAMMA);
+            rgb_output_lut[channel][i] =
+                (uint8_t)(level * (float)white_balance[channel] + 0.5f);
+        }
+    }
+}
+
 void rgb_init(void) {
     rgb_driver_init();
+    rgb_output_build_lut();
     memcpy(&rgb_config, &CURRENT_PROFILE.rgb_config, sizeof(rgb_config_t));
-    rgb_clock_reset_layout();
+    // Build the layout up front so the first clock frame does not pay for it
+    rgb_clock_build_layout();
     memset(&rgb_clock_state, 0, sizeof(rgb_clock_state));
+    memset(&rgb_frame, 0, sizeof(rgb_frame));
     rgb_static_reset();
+    rgb_stream_reset();
     rgb_update();
 }
 
@@ -108,32 +207,69 @@ void rgb_set_color(uint8_t index, uint8_t r, uint8_t g, uint8_t b) {
     }
 }
 
-void rgb_set_all_color(uint8_t r, uint8_t g, uint8_t b) {
-    for (uint8_t i = 0; i < NUM_LEDS; i++) {
+void rgb_set_range_color(uint8_t led_start, uint8_t led_end, uint8_t r,
+                         uint8_t g, uint8_t b) {
+    for (uint8_t i = led_start; i < led_end; i++) {
         rgb_set_color(i, r, g, b);
     }
 }
 
-// Function to trigger the DMA transfer of the PWM data buffer
-static void rgb_transmit_dma(void) {
-    uint16_t offset = 0;
+void rgb_set_all_color(uint8_t r, uint8_t g, uint8_t b) {
+    rgb_set_range_color(0, NUM_LEDS, r, g, b);
+}
+
+// Pass a slice through the output curves into the back buffer
+static void rgb_pack_range(uint8_t led_start, uint8_t led_end) {
+    uint8_t *grb = &rgb_grb_data[rgb_grb_back][(uint16_t)led_start * 3u];
+    uint32_t sum = 0;
 
-    for (uint8_t i = 0; i < NUM_LEDS; i++) {
-        rgb_grb_data[offset++] = current_colors[i].g;
-        rgb_grb_data[offset++] = current_colors[i].r;
-        rgb_grb_data[offset++] = current_colors[i].b;
+    for (uint8_t i = led_start; i < led_end; i++) {
+        const uint8_t r = rgb_output_lut[0][current_colors[i].r];
+        const uint8_t g = rgb_output_lut[1][current_colors[i].g];
+        const uint8_t b = rgb_output_lut[2][current_colors[i].b];
+
+        *grb++ = g;
+        *grb++ = r;
+        *grb++ = b;
+        sum += (uint32_t)r + g + b;
     }
+    rgb_output_sum += sum;
+}
+
+// Scale the whole back buffer down when its estimated current exceeds
+// `RGB_MAX_CURRENT_MA`. The LED current is modelled as linear in the channel
+// outputs, so scaling every output by budget / sum keeps the frame within it.
+static void rgb_limit_current(void) {
+    if (RGB_MAX_CURRENT_MA == 0 || rgb_output_sum <= RGB_OUTPUT_BUDGET)
+        return;
+
+    const uint32_t scale = (RGB_OUTPUT_BUDGET << 8) / rgb_output_sum;
+    uint8_t *grb = rgb_grb_data[rgb_grb_back];
+
+    for (uint16_t i = 0; i < sizeof(rgb_grb_data[0]); i++)
+        grb[i] = (uint8_t)(((uint32_t)grb[i] * scale) >> 8);
+}
+
+// Swap the completed back buffer to the front and hand it to the driver
+static void rgb_transmit_dma(void) {
+    const uint8_t *front = rgb_grb_data[rgb_grb_back];
 
-    rgb_driver_write(rgb_grb_data, offset);
+    rgb_limit_current();
+    rgb_output_sum = 0;
+    rgb_grb_back ^= 1u;
+    rgb_driver_write(front, (uint16_t)sizeof(rgb_grb_data[0]));
     rgb_driver_task();
 }
 
 void rgb_update(void) {
+    // An immediate update supersedes the frame being rendered
+    rgb_frame.active = false;
+    rgb_output_sum = 0;
+
     if (!rgb_config.enabled) {
         rgb_set_all_color(0, 0, 0);
-        rgb_transmit_dma();
-        return;
     }
+    rgb_pack_range(0, NUM_LEDS);
     rgb_transmit_dma();
 }
 
@@ -151,38 +287,135 @@ static uint8_t rgb_to_hue(rgb_color_t rgb) {
     return (uint8_t)h;
 }
 
+// Fully saturated colors at full value for every hue
+static const rgb_color_t rgb_hue_table[256] = {
+    {255, 0, 0}, {255, 6, 0}, {255, 12, 0}, {255, 18, 0},
+    {255, 24, 0}, {255, 30, 0}, {255, 36, 0}, {255, 42, 0},
+    {255, 48, 0}, {255, 54, 0}, {255, 60, 0}, {255, 66, 0},
+    {255, 72, 0}, {255, 78, 0}, {255, 84, 0}, {255, 90, 0},
+    {255, 96, 0}, {255, 102, 0}, {255, 108, 0}, {255, 114, 0},
+    {255, 120, 0}, {255, 126, 0}, {255, 132, 0}, {255, 138, 0},
+    {255, 144, 0}, {255, 150, 0}, {255, 156, 0}, {255, 162, 0},
+    {255, 168, 0}, {255, 174, 0}, {255, 180, 0}, {255, 186, 0},
+    {255, 192, 0}, {255, 198, 0}, {255, 204, 0}, {255, 210, 0},
+    {255, 216, 0}, {255, 222, 0}, {255, 228, 0}, {255, 234, 0},
+    {255, 240, 0}, {255, 246, 0}, {255, 252, 0}, {254, 255, 0},
+    {249, 255, 0}, {243, 255, 0}, {237, 255, 0}, {231, 255, 0},
+    {225, 255, 0}, {219, 255, 0}, {213, 255, 0}, {207, 255, 0},
+    {201, 255, 0}, {195, 255, 0}, {189, 255, 0}, {183, 255, 0},
+    {177, 255, 0}, {171, 255, 0}, {165, 255, 0}, {159, 255, 0},
+    {153, 255, 0}, {147, 255, 0}, {141, 255, 0}, {135, 255, 0},
+    {129, 255, 0}, {123, 255, 0}, {117, 255, 0}, {111, 255, 0},
+    {105, 255, 0}, {99, 255, 0}, {93, 255, 0}, {87, 255, 0},
+    {81, 255, 0}, {75, 255, 0}, {69, 255, 0}, {63, 255, 0},
+    {57, 255, 0}, {51, 255, 0}, {45, 255, 0}, {39, 255, 0},
+    {33, 255, 0}, {27, 255, 0}, {21, 255, 0}, {15, 255, 0},
+    {9, 255, 0}, {3, 255, 0}, {0, 255, 0}, {0, 255, 6},
+    {0, 255, 12}, {0, 255, 18}, {0, 255, 24}, {0, 255, 30},
+    {0, 255, 36}, {0, 255, 42}, {0, 255, 48}, {0, 255, 54},
+    {0, 255, 60}, {0, 255, 66}, {0, 255, 72}, {0, 255, 78},
+    {0, 255, 84}, {0, 255, 90}, {0, 255, 96}, {0, 255, 102},
+    {0, 255, 108}, {0, 255, 114}, {0, 255, 120}, {0, 255, 126},
+    {0, 255, 132}, {0, 255, 138}, {0, 255, 144}, {0, 255, 150},
+    {0, 255, 156}, {0, 255, 162}, {0, 255, 168}, {0, 255, 174},
+    {0, 255, 180}, {0, 255, 186}, {0, 255, 192}, {0, 255, 198},
+    {0, 255, 204}, {0, 255, 210}, {0, 255, 216}, {0, 255, 222},
+    {0, 255, 228}, {0, 255, 234}, {0, 255, 240}, {0, 255, 246},
+    {0, 255, 252}, {0, 254, 255}, {0, 249, 255}, {0, 243, 255},
+    {0, 237, 255}, {0, 231, 255}, {0, 225, 255}, {0, 219, 255},
+    {0, 213, 255}, {0, 207, 255}, {0, 201, 255}, {0, 195, 255},
+    {0, 189, 255}, {0, 183, 255}, {0, 177, 255}, {0, 171, 255},
+    {0, 165, 255}, {0, 159, 255}, {0, 153, 255}, {0, 147, 255},
+    {0, 141, 255}, {0, 135, 255}, {0, 129, 255}, {0, 123, 255},
+    {0, 117, 255}, {0, 111, 255}, {0, 105, 255}, {0, 99, 255},
+    {0, 93, 255}, {0, 87, 255}, {0, 81, 255}, {0, 75, 255},
+    {0, 69, 255}, {0, 63, 255}, {0, 57, 255}, {0, 51, 255},
+    {0, 45, 255}, {0, 39, 255}, {0, 33, 255}, {0, 27, 255},
+    {0, 21, 255}, {0, 15, 255}, {0, 9, 255}, {0, 3, 255},
+    {0, 0, 255}, {6, 0, 255}, {12, 0, 255}, {18, 0, 255},
+    {24, 0, 255}, {30, 0, 255}, {36, 0, 255}, {42, 0, 255},
+    {48, 0, 255}, {54, 0, 255}, {60, 0, 255}, {66, 0, 255},
+    {72, 0, 255}, {78, 0, 255}, {84, 0, 255}, {90, 0, 255},
+    {96, 0, 255}, {102, 0, 255}, {108, 0, 255}, {114, 0, 255},
+    {120, 0, 255}, {126, 0, 255}, {132, 0, 255}, {138, 0, 255},
+    {144, 0, 255}, {150, 0, 255}, {156, 0, 255}, {162, 0, 255},
+    {168, 0, 255}, {174, 0, 255}, {180, 0, 255}, {186, 0, 255},
+    {192, 0, 255}, {198, 0, 255}, {204, 0, 255}, {210, 0, 255},
+    {216, 0, 255}, {222, 0, 255}, {228, 0, 255}, {234, 0, 255},
+    {240, 0, 255}, {246, 0, 255}, {252, 0, 255}, {255, 0, 254},
+    {255, 0, 249}, {255, 0, 243}, {255, 0, 237}, {255, 0, 231},
+    {255, 0, 225}, {255, 0, 219}, {255, 0, 213}, {255, 0, 207},
+    {255, 0, 201}, {255, 0, 195}, {255, 0, 189}, {255, 0, 183},
+    {255, 0, 177}, {255, 0, 171}, {255, 0, 165}, {255, 0, 159},
+    {255, 0, 153}, {255, 0, 147}, {255, 0, 141}, {255, 0, 135},
+    {255, 0, 129}, {255, 0, 123}, {255, 0, 117}, {255, 0, 111},
+    {255, 0, 105}, {255, 0, 99}, {255, 0, 93}, {255, 0, 87},
+    {255, 0, 81}, {255, 0, 75}, {255, 0, 69}, {255, 0, 63},
+    {255, 0, 57}, {255, 0, 51}, {255, 0, 45}, {255, 0, 39},
+    {255, 0, 33}, {255, 0, 27}, {255, 0, 21}, {255, 0, 15}
+};
+
+// `rgb_hue_table` scaled by the brightness of the frame being rendered
+static rgb_color_t rgb_frame_hue_table[256];
+static uint8_t rgb_frame_hue_brightness;
+static bool rgb_frame_hue_valid;
+
+static void rgb_frame_hue_table_update(uint8_t brightness) {
+    if (rgb_frame_hue_valid && rgb_frame_hue_brightness == brightness) return;
+
+    for (uint16_t i = 0; i < 256; i++) {
+        rgb_frame_hue_table[i] = (rgb_color_t){
+            .r = scale8(rgb_hue_table[i].r, brightness),
+            .g = scale8(rgb_hue_table[i].g, brightness),
+            .b = scale8(rgb_hue_table[i].b, brightness),
+        };
+    }
+    rgb_frame_hue_brightness = brightness;
+    rgb_frame_hue_valid = true;
+}
+
 rgb_color_t hsv_to_rgb(hsv_t hsv) {
-    rgb_color_t rgb = {0, 0, 0};
     if (hsv.s == 0) {
-        rgb.r = rgb.g = rgb.b = hsv.v;
-        return rgb;
+        return (rgb_color_t){hsv.v, hsv.v, hsv.v};
     }
 
-    uint8_t region = hsv.h / 43;
-    uint8_t remainder = (hsv.h - (region * 43)) * 6; 
+    rgb_color_t rgb = rgb_hue_table[hsv.h];
+    if (hsv.s != 255) {
+        // Blend towards white as the saturation drops
+        const uint8_t white = (uint8_t)(255 - hsv.s);
+        rgb.r = (uint8_t)(scale8(rgb.r, hsv.s) + white);
+        rgb.g = (uint8_t)(scale8(rgb.g, hsv.s) + white);
+        rgb.b = (uint8_t)(scale8(rgb.b, hsv.s) + white);
+    }
 
-    uint8_t p = (hsv.v * (255 - hsv.s)) >> 8;
-    uint8_t q = (hsv.v * (255 - ((hsv.s * remainder) >> 8))) >> 8;
-    uint8_t t = (hsv.v * (255 - ((hsv.s * (255 - remainder)) >> 8))) >> 8;
+    return (rgb_color_t){
+        .r = scale8(rgb.r, hsv.v),
+        .g = scale8(rgb.g, hsv.v),
+        .b = scale8(rgb.b, hsv.v),
+    };
+}
 
-    switch (region) {
-        case 0:  rgb.r = hsv.v; rgb.g = t; rgb.b = p; break;
-        case 1:  rgb.r = q; rgb.g = hsv.v; rgb.b = p; break;
-        case 2:  rgb.r = p; rgb.g = hsv.v; rgb.b = t; break;
-        case 3:  rgb.r = p; rgb.g = q; rgb.b = hsv.v; break;
-        case 4:  rgb.r = t; rgb.g = p; rgb.b = hsv.v; break;
-        default: rgb.r = hsv.v; rgb.g = p; rgb.b = q; break;
-    }
-    return rgb;
+rgb_color_t rgb_hue_color(uint8_t hue) { return rgb_frame_hue_table[hue]; }
+
+rgb_color_t rgb_hue_color_value(uint8_t hue, uint8_t value) {
+    return (rgb_color_t){
+        .r = scale8(rgb_hue_table[hue].r, value),
+        .g = scale8(rgb_hue_table[hue].g, value),
+        .b = scale8(rgb_hue_table[hue].b, value),
+    };
 }
 
 uint8_t rgb_coord_x_at(uint8_t led) { return rgb_led_coords[led].x; }
 
 uint8_t rgb_coord_y_at(uint8_t led) { return rgb_led_coords[led].y; }
 
+uint8_t rgb_led_distance_at(uint8_t led) { return rgb_led_polar[led].distance; }
+
+uint8_t rgb_led_angle_at(uint8_t led) { return rgb_led_polar[led].angle; }
+
 bool rgb_led_is_mod_at(uint8_t led) { return rgb_led_is_mod[led] != 0u; }
 
-uint8_t rgb_key_to_led_at(uint8_t key) { return rgb_key_to_led[key]; }
+uint8_t rgb_key_to_led_at(key_index_t key) { return rgb_key_to_led[key]; }
 
 uint8_t rgb_reactive_clip_at(uint8_t source_led, uint8_t target_led) {
     return rgb_reactive_clip[source_led][target_led];
@@ -299,45 +532,38 @@ static void rgb_clock_build_layout(void) {
     rgb_clock_layout.valid = true;
 }
 
-static void rgb_clock_render(uint8_t effective_brightness,
-                             uint32_t current_tick) {
+static void rgb_clock_set_color_in_range(uint8_t led, uint8_t led_start,
+                                         uint8_t led_end, rgb_color_t color) {
+    if (led >= led_start && led < led_end)
+        rgb_set_color(led, color.r, color.g, color.b);
+}
+
+// Resolve the clock colors and digits once per frame, before the first slice
+static void rgb_clock_prepare_frame(uint8_t effective_brightness,
+                                    uint32_t current_tick) {
+    rgb_clock_frame_t *frame = &rgb_clock_frame;
+
     if (!rgb_clock_layout.initialized)
         rgb_clock_build_layout();
 
-    const rgb_color_t active_color =
+    frame->active_color =
         scale_rgb_color(rgb_config.solid_color, effective_brightness);
-    const rgb_color_t accent_color =
+    frame->accent_color =
         scale_rgb_color(rgb_config.secondary_color, effective_brightness);
-    const rgb_color_t background_color = scale_rgb_color(
+    frame->background_color = scale_rgb_color(
         rgb_config.background_color, effective_brightness);
 
     if (!rgb_clock_layout.valid) {
-        rgb_color_t pulse_color = ((current_tick / 500u) & 1u) == 0u
-                                      ? active_color
-                                      : (rgb_color_t){0, 0, 0};
-        rgb_set_all_color(pulse_color.r, pulse_color.g, pulse_color.b);
+        frame->pulse_color = ((current_tick / 500u) & 1u) == 0u
+                                 ? frame->active_color
+                                 : (rgb_color_t){0, 0, 0};
         return;
     }
 
-    rgb_set_all_color(background_color.r, background_color.g,
-                      background_color.b);
-
     if (!rgb_clock_state.synced) {
-        const rgb_color_t pulse_color = ((current_tick / 500u) & 1u) == 0u
-                                            ? active_color
-                                            : background_color;
-        for (uint8_t i = 0; i < M_ARRAY_SIZE(rgb_clock_layout.separator_leds);
-             i++) {
-            uint8_t led = rgb_clock_layout.separator_leds[i];
-            if (led != 0xFFu)
-                rgb_set_color(led, pulse_color.r, pulse_color.g, pulse_color.b);
-        }
-        for (uint8_t i = 0; i < M_ARRAY_SIZE(rgb_clock_layout.second_leds); i++) {
-            uint8_t led = rgb_clock_layout.second_leds[i];
-            if (led != 0xFFu)
-                rgb_set_color(led, background_color.r, background_color.g,
-                              background_color.b);
-        }
+        frame->pulse_color = ((current_tick / 500u) & 1u) == 0u
+                                 ? frame->active_color
+                                 : frame->background_color;
         return;
     }
 
@@ -350,96 +576,81 @@ static void rgb_clock_render(uint8_t effective_brightness,
     const uint8_t hours = (uint8_t)(total_seconds / 3600u);
     const uint8_t minutes = (uint8_t)((total_seconds % 3600u) / 60u);
     const uint8_t seconds = (uint8_t)(total_seconds % 60u);
-    const uint8_t digits[4] = {
-        (uint8_t)(hours / 10u),
-        (uint8_t)(hours % 10u),
-        (uint8_t)(minutes / 10u),
-        (uint8_t)(minutes % 10u),
-    };
-
-    for (uint8_t digit = 0; digit < M_ARRAY_SIZE(rgb_clock_layout.digit_leds);
-         digit++) {
-        for (uint8_t bit = 0; bit < M_ARRAY_SIZE(rgb_clock_layout.digit_leds[0]);
-             bit++) {
-            const uint8_t led = rgb_clock_layout.digit_leds[digit][bit];
-            if (led == 0xFFu)
-                continue;
+    frame->digits[0] = (uint8_t)(hours / 10u);
+    frame->digits[1] = (uint8_t)(hours % 10u);
+    frame->digits[2] = (uint8_t)(minutes / 10u);
+    frame->digits[3] = (uint8_t)(minutes % 10u);
 
-            const bool is_on = (digits[digit] & (uint8_t)(1u << (3u - bit))) != 0u;
-            const rgb_color_t color = is_on ? active_color : background_color;
-            rgb_set_color(led, color.r, color.g, color.b);
-        }
-    }
+    frame->separator_color =
+        (seconds & 1u) == 0u ? frame->accent_color : frame->background_color;
 
-    const rgb_color_t separator_color =
-        (seconds & 1u) == 0u ? accent_color : background_color;
-    for (uint8_t i = 0; i < M_ARRAY_SIZE(rgb_clock_layout.separator_leds); i++) {
-        uint8_t led = rgb_clock_layout.separator_leds[i];
-        if (led != 0xFFu)
-            rgb_set_color(led, separator_color.r, separator_color.g,
-                          separator_color.b);
-    }
-
-    const uint8_t second_step = seconds / 6u;
     const uint8_t second_phase =
         (uint8_t)((((uint32_t)(seconds % 6u)) + 1u) * effective_brightness / 6u);
-    const rgb_color_t head_color =
-        scale_rgb_color(rgb_config.solid_color, second_phase);
-
-    for (uint8_t i = 0; i < M_ARRAY_SIZE(rgb_clock_layout.second_leds); i++) {
-        uint8_t led = rgb_clock_layout.second_leds[i];
-        if (led == 0xFFu)
-            continue;
-
-        rgb_color_t color = background_color;
-        if (i < second_step)
-            color = accent_color;
-        else if (i == second_step)
-            color = head_color;
-
-        rgb_set_color(led, color.r, color.g, color.b);
-    }
+    frame->second_step = seconds / 6u;
+    frame->head_color = scale_rgb_color(rgb_config.solid_color, second_phase);
 }
 
-void rgb_task(void) {
-    rgb_driver_task();
-
-    if (!rgb_config.enabled) return;
+static void rgb_clock_render(uint8_t led_start, uint8_t led_end) {
+    const rgb_clock_frame_t *frame = &rgb_clock_frame;
 
-    static uint32_t last_render_tick = 0;
-    uint32_t current_tick = timer_read();
-
-    rgb_reactive_decay_heatmap(current_tick);
+    if (!rgb_clock_layout.valid) {
+        rgb_set_range_color(led_start, led_end, frame->pulse_color.r,
+                            frame->pulse_color.g, frame->pulse_color.b);
+        return;
+    }
 
-    // Limit render framerate to ~60fps (16ms)
-    if (timer_elapsed(last_render_tick) < 16) return;
-    last_render_tick = current_tick;
+    rgb_set_range_color(led_start, led_end, frame->background_color.r,
+                        frame->background_color.g, frame->background_color.b);
 
-    uint8_t effective_brightness = rgb_config.global_brightness;
-    uint32_t idle_time = matrix_get_idle_time();
-    uint32_t timeout_ms = (uint32_t)rgb_config.sleep_timeout * 60000u;
-    
-    static bool was_asleep = false;
-    if (timeout_ms > 0 && idle_time > timeout_ms) {
-        uint32_t fade_duration = 2000; // 2 seconds to fade out
-        if (idle_time >= timeout_ms + fade_duration) {
-            effective_brightness = 0;
-        } else {
-            uint32_t passed = idle_time - timeout_ms;
-            effective_brightness = (effective_brightness * (fade_duration - passed)) / fade_duration;
+    if (!rgb_clock_state.synced) {
+        for (uint8_t i = 0; i < M_ARRAY_SIZE(rgb_clock_layout.separator_leds);
+             i++) {
+            rgb_clock_set_color_in_range(rgb_clock_layout.separator_leds[i],
+                                         led_start, led_end,
+                                         frame->pulse_color);
         }
+        return;
     }
 
-    if (effective_brightness == 0) {
-        if (!was_asleep) {
-            rgb_set_all_color(0, 0, 0);
-            rgb_update();
-            was_asleep = true;
+    for (uint8_t digit = 0; digit < M_ARRAY_SIZE(rgb_clock_layout.digit_leds);
+         digit++) {
+        for (uint8_t bit = 0; bit < M_ARRAY_SIZE(rgb_clock_layout.digit_leds[0]);
+             bit++) {
+            const bool is_on =
+                (frame->digits[digit] & (uint8_t)(1u << (3u - bit))) != 0u;
+            rgb_clock_set_color_in_range(
+                rgb_clock_layout.digit_leds[digit][bit], led_start, led_end,
+                is_on ? frame->active_color : frame->background_color);
         }
-        return;
     }
-    was_asleep = false;
 
+    for (uint8_t i = 0; i < M_ARRAY_SIZE(rgb_clock_layout.separator_leds); i++) {
+        rgb_clock_set_color_in_range(rgb_clock_layout.separator_leds[i],
+                                     led_start, led_end,
+                                     frame->separator_color);
+    }
+
+    for (uint8_t i = 0; i < M_ARRAY_SIZE(rgb_clock_layout.second_leds); i++) {
+        rgb_color_t color = frame->background_color;
+        if (i < frame->second_step)
+            color = frame->accent_color;
+        else if (i == frame->second_step)
+            color = frame->head_color;
+
+        rgb_clock_set_color_in_range(rgb_clock_layout.second_leds[i],
+                                     led_start, led_end, color);
+    }
+}
+
+/**
+ * @brief Start rendering a new frame
+ *
+ * Everything that only depends on the frame tick (timers, hues, effect state
+ * changes and the layer indicator) is resolved here so the slices rendered by
+ * the following `rgb_task()` calls all draw the same frame.
+ */
+static void rgb_begin_frame(uint32_t current_tick,
+                            uint8_t effective_brightness) {
     // A generic rolling timer based on system ticks and effect_speed
     static uint32_t anim_timer = 0;
     static uint16_t scaled_timer = 0;
@@ -458,13 +669,22 @@ void rgb_task(void) {
     static uint8_t prev_effect = 0xff;
     bool effect_changed = (prev_effect != rgb_config.current_effect);
     prev_effect = rgb_config.current_effect;
-    rgb_animated_context_t animated_context = {
+
+    rgb_frame.active = true;
+    rgb_frame.effect = rgb_config.current_effect;
+    rgb_frame.next_led = 0;
+    rgb_output_sum = 0;
+    rgb_frame.effective_brightness = effective_brightness;
+    rgb_frame.current_tick = current_tick;
+    rgb_frame.stream = rgb_stream_begin_frame();
+    rgb_frame_hue_table_update(effective_brightness);
+    rgb_frame.animated_context = (rgb_animated_context_t){
         .base_hue = base_hue,
         .effective_brightness = effective_brightness,
         .effect_speed = rgb_config.effect_speed,
         .effect_changed = effect_changed,
     };
-    rgb_static_context_t static_context = {
+    rgb_frame.static_context = (rgb_static_context_t){
         .config = &rgb_config,
         .base_hue = base_hue,
         .secondary_hue = secondary_hue,
@@ -475,29 +695,93 @@ void rgb_task(void) {
         .prev_tick = prev_tick,
     };
 
-    switch (rgb_config.current_effect) {
+    if (rgb_frame.effect == RGB_EFFECT_BINARY_CLOCK)
+        rgb_clock_prepare_frame(effective_brightness, current_tick);
+
+    // Layer Indicator Override
+    static uint8_t previous_layer = 0;
+    static uint32_t layer_switch_time = 0;
+    uint8_t current_layer = layout_get_current_layer();
+    
+    if (current_layer != previous_layer) {
+        layer_switch_time = timer_read();
+        previous_layer = current_layer;
+    }
+
+    rgb_frame.layer_fill = false;
+    rgb_frame.layer_led = 0xFF;
+
+    if (current_layer > 0 && current_layer < NUM_LAYERS) {
+        rgb_color_t layer_color = rgb_config.layer_colors[current_layer];
+        if (layer_color.r > 0 || layer_color.g > 0 || layer_color.b > 0) {
+            rgb_frame.layer_color =
+                scale_rgb_color(layer_color, effective_brightness);
+
+            if (rgb_config.layer_indicator_mode == 0) {
+                // Mode 0: Fill entire keyboard
+                rgb_frame.layer_fill = true;
+            } else if (rgb_config.layer_indicator_mode == 1) {
+                // Mode 1: Flash entire keyboard for 500ms
+                rgb_frame.layer_fill = timer_elapsed(layer_switch_time) < 500;
+            } else if (rgb_config.layer_indicator_mode == 2) {
+                // Mode 2: Illuminate a specific key
+                if (rgb_config.layer_indicator_key < NUM_LEDS) {
+                    rgb_frame.layer_led = rgb_config.layer_indicator_key;
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @brief Render and pack the LEDs [led_start, led_end) of the current frame
+ */
+static void rgb_render_slice(uint8_t led_start, uint8_t led_end) {
+    const uint8_t effective_brightness = rgb_frame.effective_brightness;
+    rgb_animated_context_t *animated_context = &rgb_frame.animated_context;
+    rgb_static_context_t *static_context = &rgb_frame.static_context;
+
+    animated_context->led_start = led_start;
+    animated_context->led_end = led_end;
+    static_context->led_start = led_start;
+    static_context->led_end = led_end;
+
+    if (rgb_frame.stream) {
+        // The host owns every LED while streaming, so no layer indicator
+        for (uint8_t i = led_start; i < led_end; i++) {
+            const rgb_color_t c = rgb_frame.stream[i];
+            rgb_set_color(i, scale8(c.r, effective_brightness),
+                          scale8(c.g, effective_brightness),
+                          scale8(c.b, effective_brightness));
+        }
+        rgb_pack_range(led_start, led_end);
+        return;
+    }
+
+    switch (rgb_frame.effect) {
         case RGB_EFFECT_PIXEL_FLOW: {
-            rgb_animated_render(RGB_EFFECT_PIXEL_FLOW, &animated_context);
+            rgb_animated_render(RGB_EFFECT_PIXEL_FLOW, animated_context);
             break;
         }
 
         case RGB_EFFECT_PIXEL_FRACTAL: {
-            rgb_animated_render(RGB_EFFECT_PIXEL_FRACTAL, &animated_context);
+            rgb_animated_render(RGB_EFFECT_PIXEL_FRACTAL, animated_context);
             break;
         }
 
         case RGB_EFFECT_PIXEL_RAIN: {
-            rgb_animated_render(RGB_EFFECT_PIXEL_RAIN, &animated_context);
+            rgb_animated_render(RGB_EFFECT_PIXEL_RAIN, animated_context);
             break;
         }
 
         case RGB_EFFECT_TYPING_HEATMAP: {
-            rgb_reactive_render_heatmap(effective_brightness);
+            rgb_reactive_render_heatmap(effective_brightness, led_start,
+                                        led_end);
             break;
         }
 
         case RGB_EFFECT_DIGITAL_RAIN: {
-            rgb_animated_render(RGB_EFFECT_DIGITAL_RAIN, &animated_context);
+            rgb_animated_render(RGB_EFFECT_DIGITAL_RAIN, animated_context);
             break;
         }
 
@@ -508,8 +792,8 @@ void rgb_task(void) {
             uint8_t pressed_r = (uint8_t)(((uint32_t)rgb_config.solid_color.r * effective_brightness) / 255u);
             uint8_t pressed_g = (uint8_t)(((uint32_t)rgb_config.solid_color.g * effective_brightness) / 255u);
             uint8_t pressed_b = (uint8_t)(((uint32_t)rgb_config.solid_color.b * effective_brightness) / 255u);
-            for (uint8_t i = 0; i < NUM_LEDS; i++) {
-                uint8_t key_index = rgb_led_key_index[i];
+            for (uint8_t i = led_start; i < led_end; i++) {
+                key_index_t key_index = rgb_led_key_index[i];
                 uint8_t dist = (key_index < NUM_KEYS) ? key_matrix[key_index].distance : 0;
                 uint8_t final_r = (uint8_t)(((uint32_t)pressed_r * dist + (uint32_t)base_r * (uint32_t)(255u - dist)) / 255u);
                 uint8_t final_g = (uint8_t)(((uint32_t)pressed_g * dist + (uint32_t)base_g * (uint32_t)(255u - dist)) / 255u);
@@ -519,7 +803,7 @@ void rgb_task(void) {
             break;
         }
         case RGB_EFFECT_BINARY_CLOCK: {
-            rgb_clock_render(effective_brightness, current_tick);
+            rgb_clock_render(led_start, led_end);
             break;
         }
         case RGB_EFFECT_TRIGGER_STATE: {
@@ -529,9 +813,9 @@ void rgb_task(void) {
                     rgb_config.trigger_state_colors[state], effective_brightness);
             }
 
-            for (uint8_t i = 0; i < NUM_LEDS; i++) {
+            for (uint8_t i = led_start; i < led_end; i++) {
                 rgb_color_t color = {0, 0, 0};
-                uint8_t key_index = rgb_led_key_index[i];
+                key_index_t key_index = rgb_led_key_index[i];
 
                 if (key_index < NUM_KEYS) {
                     const key_state_t *state = &key_matrix[key_index];
@@ -551,22 +835,26 @@ void rgb_task(void) {
         case RGB_EFFECT_SOLID_REACTIVE_MULTICROSS:
         case RGB_EFFECT_SOLID_REACTIVE_NEXUS:
         case RGB_EFFECT_SOLID_REACTIVE_MULTINEXUS: {
-            rgb_reactive_render_effect(rgb_config.current_effect, base_hue,
+            rgb_reactive_render_effect(rgb_frame.effect,
+                                       animated_context->base_hue,
                                        effective_brightness,
-                                       rgb_config.effect_speed);
+                                       rgb_config.effect_speed, led_start,
+                                       led_end);
             break;
         }
         case RGB_EFFECT_SPLASH:
         case RGB_EFFECT_MULTISPLASH:
         case RGB_EFFECT_SOLID_SPLASH:
         case RGB_EFFECT_SOLID_MULTISPLASH: {
-            rgb_reactive_render_splash(rgb_config.current_effect, base_hue,
+            rgb_reactive_render_splash(rgb_frame.effect,
+                                       animated_context->base_hue,
                                        effective_brightness,
-                                       rgb_config.effect_speed);
+                                       rgb_config.effect_speed, led_start,
+                                       led_end);
             break;
         }
         case RGB_EFFECT_PER_KEY: {
-            for (uint8_t i = 0; i < NUM_LEDS; i++) {
+            for (uint8_t i = led_start; i < led_end; i++) {
                 rgb_color_t color = rgb_config.per_key_colors[i];
                 uint8_t r = ((uint32_t)color.r * effective_brightness) / 255;
                 uint8_t g = ((uint32_t)color.g * effective_brightness) / 255;
@@ -577,59 +865,99 @@ void rgb_task(void) {
         }
 
         default:
-            if (rgb_static_render(rgb_config.current_effect, &static_context)) {
+            if (rgb_static_render(rgb_frame.effect, static_context)) {
                 break;
             }
 
             // Rainbow wave as default for anything else
-            for (uint8_t i = 0; i < NUM_LEDS; i++) {
+            for (uint8_t i = led_start; i < led_end; i++) {
                 uint8_t x = rgb_led_coords[i].x;
-                hsv_t hsv = {
-                    .h = (uint8_t)((anim_timer / 16) + x),
-                    .s = 255,
-                    .v = effective_brightness
-                };
-                rgb_color_t c = hsv_to_rgb(hsv);
+                rgb_color_t c = rgb_hue_color(
+                    (uint8_t)((static_context->anim_timer / 16) + x));
                 rgb_set_color(i, c.r, c.g, c.b);
             }
             break;
     }
 
-    // Layer Indicator Override
-    static uint8_t previous_layer = 0;
-    static uint32_t layer_switch_time = 0;
-    uint8_t current_layer = layout_get_current_layer();
-    
-    if (current_layer != previous_layer) {
-        layer_switch_time = timer_read();
-        previous_layer = current_layer;
+    if (rgb_frame.layer_fill) {
+        rgb_set_range_color(led_start, led_end, rgb_frame.layer_color.r,
+                            rgb_frame.layer_color.g, rgb_frame.layer_color.b);
+    } else if (rgb_frame.layer_led >= led_start &&
+               rgb_frame.layer_led < led_end) {
+        rgb_set_color(rgb_frame.layer_led, rgb_frame.layer_color.r,
+                      rgb_frame.layer_color.g, rgb_frame.layer_color.b);
     }
 
-    if (current_layer > 0 && current_layer < NUM_LAYERS) {
-        rgb_color_t layer_color = rgb_config.layer_colors[current_layer];
-        if (layer_color.r > 0 || layer_color.g > 0 || layer_color.b > 0) {
-            uint8_t r = ((uint32_t)layer_color.r * effective_brightness) / 255;
-            uint8_t g = ((uint32_t)layer_color.g * effective_brightness) / 255;
-            uint8_t b = ((uint32_t)layer_color.b * effective_brightness) / 255;
+    rgb_pack_range(led_start, led_end);
+}
 
-            if (rgb_config.layer_indicator_mode == 0) {
-                // Mode 0: Fill entire keyboard
-                rgb_set_all_color(r, g, b);
-            } else if (rgb_config.layer_indicator_mode == 1) {
-                // Mode 1: Flash entire keyboard for 500ms
-                if (timer_elapsed(layer_switch_time) < 500) {
-                    rgb_set_all_color(r, g, b);
-                }
-            } else if (rgb_config.layer_indicator_mode == 2) {
-                // Mode 2: Illuminate a specific key
-                if (rgb_config.layer_indicator_key < NUM_LEDS) {
-                    rgb_set_color(rgb_config.layer_indicator_key, r, g, b);
-                }
+void rgb_task(void) {
+    rgb_driver_task();
+
+    if (!rgb_config.enabled) return;
+
+    static uint32_t last_render_tick = 0;
+    uint32_t current_tick = timer_read();
+
+    rgb_reactive_decay_heatmap(current_tick);
+
+    if (!rgb_frame.active) {
+        // Limit render framerate to ~60fps (16ms)
+        if (timer_elapsed(last_render_tick) < 16) return;
+        last_render_tick = current_tick;
+
+        uint8_t effective_brightness = rgb_config.global_brightness;
+        uint32_t idle_time = matrix_get_idle_time();
+        uint32_t timeout_ms = (uint32_t)rgb_config.sleep_timeout * 60000u;
+
+        static bool was_asleep = false;
+        if (timeout_ms > 0 && idle_time > timeout_ms) {
+            uint32_t fade_duration = 2000; // 2 seconds to fade out
+            if (idle_time >= timeout_ms + fade_duration) {
+                effective_brightness = 0;
+            } else {
+                uint32_t passed = idle_time - timeout_ms;
+                effective_brightness = (effective_brightness * (fade_duration - passed)) / fade_duration;
             }
         }
+
+        if (effective_brightness == 0) {
+            if (!was_asleep) {
+                rgb_set_all_color(0, 0, 0);
+                rgb_update();
+                was_asleep = true;
+            }
+            return;
+        }
+        was_asleep = false;
+
+        rgb_begin_frame(current_tick, effective_brightness);
     }
 
-    rgb_update();
+    // Render slices until the frame is complete or the cycle budget of this
+    // call is spent. The rest of the frame continues on the next call.
+#if RGB_RENDER_CYCLE_BUDGET > 0
+    const uint32_t start_cycle = board_cycle_count();
+#endif
+    do {
+        const uint8_t led_start = rgb_frame.next_led;
+        const uint8_t led_end = (NUM_LEDS - led_start > RGB_RENDER_CHUNK_LEDS)
+                                    ? (uint8_t)(led_start + RGB_RENDER_CHUNK_LEDS)
+                                    : (uint8_t)NUM_LEDS;
+
+        rgb_render_slice(led_start, led_end);
+        rgb_frame.next_led = led_end;
+#if RGB_RENDER_CYCLE_BUDGET > 0
+    } while (rgb_frame.next_led < NUM_LEDS &&
+             board_cycle_count() - start_cycle < RGB_RENDER_CYCLE_BUDGET);
+#else
+    } while (false);
+#endif
+
+    if (rgb_frame.next_led < NUM_LEDS) return;
+
+    rgb_frame.active = false;
+    rgb_transmit_dma();
 }
 
 #endif // RGB_ENABLED
@@ -32,6 +32,9 @@ static uint8_t digital_rain_state[NUM_LEDS];
 static uint8_t digital_rain_col_count = 0;
 static uint8_t digital_rain_col_x[NUM_LEDS];
 static uint8_t digital_rain_led_col[NUM_LEDS];
+// LEDs grouped by column, each column ordered from the bottom to the top
+static uint8_t digital_rain_col_leds[NUM_LEDS];
+static uint8_t digital_rain_col_start[NUM_LEDS + 1];
 static uint8_t pixel_rain_index = 0;
 static uint32_t pixel_flow_wait = 0;
 static uint32_t pixel_fractal_wait = 0;
@@ -50,6 +53,8 @@ void rgb_animated_reset(void) {
     memset(digital_rain_state, 0, sizeof(digital_rain_state));
     memset(digital_rain_col_x, 0, sizeof(digital_rain_col_x));
     memset(digital_rain_led_col, 0, sizeof(digital_rain_led_col));
+    memset(digital_rain_col_leds, 0, sizeof(digital_rain_col_leds));
+    memset(digital_rain_col_start, 0, sizeof(digital_rain_col_start));
     digital_rain_col_count = 0;
     pixel_rain_index = 0;
     pixel_flow_wait = 0;
@@ -76,13 +81,39 @@ static void digital_rain_build_columns(void) {
         }
         digital_rain_led_col[i] = (uint8_t)col;
     }
+
+    // Cache the column order so the drop step does not rescan and sort every
+    // LED on each frame
+    uint8_t offset = 0;
+    for (uint8_t c = 0; c < digital_rain_col_count; c++) {
+        uint8_t *col_leds = &digital_rain_col_leds[offset];
+        uint8_t count = 0;
+
+        for (uint8_t i = 0; i < NUM_LEDS; i++) {
+            if (digital_rain_led_col[i] == c) col_leds[count++] = i;
+        }
+
+        for (uint8_t a = 0; a < count; a++) {
+            for (uint8_t b = a + 1; b < count; b++) {
+                if (rgb_coord_y_at(col_leds[a]) < rgb_coord_y_at(col_leds[b])) {
+                    uint8_t temp = col_leds[a];
+                    col_leds[a] = col_leds[b];
+                    col_leds[b] = temp;
+                }
+            }
+        }
+
+        digital_rain_col_start[c] = offset;
+        offset += count;
+    }
+    digital_rain_col_start[digital_rain_col_count] = offset;
 }
 
 static void rgb_render_pixel_flow(const rgb_animated_context_t *context) {
     uint8_t speed = scale16by8(qadd8(context->effect_speed, 16), 16);
     uint16_t interval = 3000 / (speed ? speed : 1);
 
-    if (context->effect_changed) {
+    if (context->led_start == 0 && context->effect_changed) {
         for (uint8_t i = 0; i < NUM_LEDS; i++) {
             if (random8() & 2) {
                 pixel_flow_state[i] = (rgb_color_t){0, 0, 0};
@@ -95,11 +126,13 @@ static void rgb_render_pixel_flow(const rgb_animated_context_t *context) {
         pixel_flow_wait = timer_read();
     }
 
-    for (uint8_t i = 0; i < NUM_LEDS; i++) {
+    for (uint8_t i = context->led_start; i < context->led_end; i++) {
         rgb_set_color(i, pixel_flow_state[i].r, pixel_flow_state[i].g,
                       pixel_flow_state[i].b);
     }
 
+    // The flow only advances once the whole frame has been drawn
+    if (context->led_end < NUM_LEDS) return;
     if (timer_elapsed(pixel_flow_wait) < interval) return;
 
     for (uint8_t i = 0; i + 1 < NUM_LEDS; i++) {
@@ -117,14 +150,15 @@ static void rgb_render_pixel_fractal(const rgb_animated_context_t *context) {
     uint8_t speed = scale16by8(qadd8(context->effect_speed, 16), 16);
     uint16_t interval = 3000 / (speed ? speed : 1);
 
-    if (context->effect_changed) {
+    if (context->led_start == 0 && context->effect_changed) {
         for (uint8_t i = 0; i < NUM_LEDS; i++) {
             pixel_fractal_state[i] = 0;
         }
         pixel_fractal_wait = timer_read();
     }
 
-    if (timer_elapsed(pixel_fractal_wait) >= interval) {
+    if (context->led_start == 0 &&
+        timer_elapsed(pixel_fractal_wait) >= interval) {
         uint8_t next[NUM_LEDS];
         memset(next, 0, sizeof(next));
 
@@ -142,7 +176,7 @@ static void rgb_render_pixel_fractal(const rgb_animated_context_t *context) {
 
     rgb_color_t base =
         hsv_to_rgb((hsv_t){context->base_hue, 255, context->effective_brightness});
-    for (uint8_t i = 0; i < NUM_LEDS; i++) {
+    for (uint8_t i = context->led_start; i < context->led_end; i++) {
         if (pixel_fractal_state[i]) {
             rgb_set_color(i, base.r, base.g, base.b);
         } else {
@@ -152,6 +186,9 @@ static void rgb_render_pixel_fractal(const rgb_animated_context_t *context) {
 }
 
 static void rgb_render_pixel_rain(const rgb_animated_context_t *context) {
+    // A single pixel is drawn per frame, so only the first slice does work
+    if (context->led_start != 0) return;
+
     if (context->effect_changed) {
         pixel_rain_index = random8_max(NUM_LEDS);
         pixel_rain_wait = timer_read();
@@ -181,33 +218,36 @@ static void rgb_render_digital_rain(const rgb_animated_context_t *context) {
     const uint8_t decay_ticks =
         max_intensity ? (0xff / max_intensity) : 0xff;
 
-    if (context->effect_changed) {
-        digital_rain_build_columns();
-        memset(digital_rain_state, 0, sizeof(digital_rain_state));
-        digital_rain_drop = 0;
-        digital_rain_decay = 0;
-    }
+    if (context->led_start == 0) {
+        if (context->effect_changed) {
+            digital_rain_build_columns();
+            memset(digital_rain_state, 0, sizeof(digital_rain_state));
+            digital_rain_drop = 0;
+            digital_rain_decay = 0;
+        }
 
-    digital_rain_decay++;
-    if (digital_rain_drop == 0) {
-        for (uint8_t c = 0; c < digital_rain_col_count; c++) {
-            if (random8_max(24) != 0) continue;
-
-            uint8_t top = 0xff;
-            uint8_t top_y = 0xff;
-            for (uint8_t i = 0; i < NUM_LEDS; i++) {
-                if (digital_rain_led_col[i] != c) continue;
-                uint8_t y = rgb_coord_y_at(i);
-                if (y < top_y) {
-                    top_y = y;
-                    top = i;
+        digital_rain_decay++;
+        if (digital_rain_drop == 0) {
+            for (uint8_t c = 0; c < digital_rain_col_count; c++) {
+                if (random8_max(24) != 0) continue;
+
+                uint8_t top = 0xff;
+                uint8_t top_y = 0xff;
+                for (uint8_t j = digital_rain_col_start[c];
+                     j < digital_rain_col_start[c + 1]; j++) {
+                    uint8_t i = digital_rain_col_leds[j];
+                    uint8_t y = rgb_coord_y_at(i);
+                    if (y < top_y || (y == top_y && i < top)) {
+                        top_y = y;
+                        top = i;
+                    }
                 }
+                if (top != 0xff) digital_rain_state[top] = max_intensity;
             }
-            if (top != 0xff) digital_rain_state[top] = max_intensity;
         }
     }
 
-    for (uint8_t i = 0; i < NUM_LEDS; i++) {
+    for (uint8_t i = context->led_start; i < context->led_end; i++) {
         if (digital_rain_state[i] > 0 && digital_rain_state[i] < max_intensity) {
             if (digital_rain_decay >= decay_ticks) digital_rain_state[i]--;
         }
@@ -229,27 +269,17 @@ static void rgb_render_digital_rain(const rgb_animated_context_t *context) {
         }
     }
 
+    // Drops only fall once the whole frame has been drawn
+    if (context->led_end < NUM_LEDS) return;
+
     if (digital_rain_decay >= decay_ticks) digital_rain_decay = 0;
     if (++digital_rain_drop <= drop_ticks) return;
 
     digital_rain_drop = 0;
     for (uint8_t c = 0; c < digital_rain_col_count; c++) {
-        uint8_t col_leds[NUM_LEDS];
-        uint8_t count = 0;
-
-        for (uint8_t i = 0; i < NUM_LEDS; i++) {
-            if (digital_rain_led_col[i] == c) col_leds[count++] = i;
-        }
-
-        for (uint8_t a = 0; a < count; a++) {
-            for (uint8_t b = a + 1; b < count; b++) {
-                if (rgb_coord_y_at(col_leds[a]) < rgb_coord_y_at(col_leds[b])) {
-                    uint8_t temp = col_leds[a];
-                    col_leds[a] = col_leds[b];
-                    col_leds[b] = temp;
-                }
-            }
-        }
+        const uint8_t *col_leds = &digital_rain_col_leds[digital_rain_col_start[c]];
+        const uint8_t count =
+            digital_rain_col_start[c + 1] - digital_rain_col_start[c];
 
         if (count > 0 && digital_rain_state[col_leds[0]] == max_intensity) {
             digital_rain_state[col_leds[0]]--;
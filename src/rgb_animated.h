@@ -9,6 +9,9 @@ typedef struct {
     uint8_t effective_brightness;
     uint8_t effect_speed;
     bool effect_changed;
+    // LEDs [led_start, led_end) are rendered by this call
+    uint8_t led_start;
+    uint8_t led_end;
 } rgb_animated_context_t;
 
 void rgb_animated_reset(void);
@@ -0,0 +1,382 @@
+/*
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "hardware/rgb_api.h"
+
+#if defined(RGB_ENABLED) && defined(RGB_DRIVER_I2C_MATRIX)
+
+#include "hardware/hardware.h"
+
+// LEDs driven by IS31FL3733/IS31FL3737-style matrix controllers on an I2C bus.
+// The driver keeps a shadow of the PWM registers of each controller, and only
+// writes the register ranges whose values have changed since the last frame.
+// The writes of a frame are queued on the bus as one batch, so the frame is
+// sent by the I2C interrupts while the main loop keeps scanning.
+
+#if !defined(NUM_LEDS)
+#define NUM_LEDS NUM_KEYS
+#endif
+
+#if !defined(RGB_I2C_MATRIX_BUS)
+#define RGB_I2C_MATRIX_BUS 0
+#endif
+
+#if RGB_I2C_MATRIX_BUS >= I2C_NUM_BUSES
+#error "RGB_I2C_MATRIX_BUS is not an enabled I2C bus"
+#endif
+
+#if !defined(RGB_I2C_MATRIX_FREQUENCY_HZ)
+#define RGB_I2C_MATRIX_FREQUENCY_HZ 400000
+#endif
+
+#if !defined(RGB_I2C_MATRIX_ADDRESSES)
+#error "RGB_I2C_MATRIX_ADDRESSES is not defined"
+#endif
+
+#if !defined(RGB_I2C_MATRIX_LED_MAP)
+#error "RGB_I2C_MATRIX_LED_MAP is not defined"
+#endif
+
+#if !defined(RGB_I2C_MATRIX_GLOBAL_CURRENT)
+// Global current control, scaling the output current of every LED
+#define RGB_I2C_MATRIX_GLOBAL_CURRENT 0xFF
+#endif
+
+#if !defined(RGB_I2C_MATRIX_MAX_RANGES)
+// Register ranges written to a device per frame. Further changes are merged
+// into the last range.
+#define RGB_I2C_MATRIX_MAX_RANGES 8
+#endif
+
+//--------------------------------------------------------------------+
+// Device Registers
+//--------------------------------------------------------------------+
+
+// The command register selects the page of the other registers, and must be
+// unlocked before every write
+#define IS31_REG_COMMAND 0xFD
+#define IS31_REG_COMMAND_WRITE_LOCK 0xFE
+#define IS31_COMMAND_WRITE_LOCK_MAGIC 0xC5
+
+#define IS31_PAGE_LED_CONTROL 0x00
+#define IS31_PAGE_PWM 0x01
+#define IS31_PAGE_FUNCTION 0x03
+
+// Function page registers
+#define IS31_REG_CONFIGURATION 0x00
+#define IS31_REG_GLOBAL_CURRENT 0x01
+// Reading the reset register resets every register to its default value
+#define IS31_REG_RESET 0x11
+
+// Normal operation rather than software shutdown
+#define IS31_CONFIGURATION_NORMAL 0x01
+
+// One bit per PWM register in the LED control page
+#define IS31_LED_CONTROL_SIZE 24
+#define IS31_PWM_SIZE 192
+
+// Each separate write costs the address and register bytes, so changed ranges
+// separated by at most this many unchanged registers are written as one
+#define RGB_I2C_MATRIX_RANGE_OVERHEAD 2
+
+_Static_assert(IS31_PWM_SIZE + 1 <= I2C_MAX_TRANSFER_SIZE,
+               "The PWM page does not fit in a single I2C write");
+
+//--------------------------------------------------------------------+
+// Configuration
+//--------------------------------------------------------------------+
+
+typedef struct {
+  uint8_t device;
+  // PWM registers of the red, green and blue channels
+  uint8_t r;
+  uint8_t g;
+  uint8_t b;
+} rgb_i2c_matrix_led_t;
+
+static const uint8_t rgb_i2c_matrix_addresses[] = RGB_I2C_MATRIX_ADDRESSES;
+
+#define RGB_I2C_MATRIX_NUM_DEVICES M_ARRAY_SIZE(rgb_i2c_matrix_addresses)
+
+static const rgb_i2c_matrix_led_t rgb_i2c_matrix_leds[] =
+    RGB_I2C_MATRIX_LED_MAP;
+
+_Static_assert(M_ARRAY_SIZE(rgb_i2c_matrix_leds) == NUM_LEDS,
+               "Invalid number of LEDs in RGB_I2C_MATRIX_LED_MAP");
+
+static const i2c_bus_config_t rgb_i2c_matrix_config = {
+    .bus = RGB_I2C_MATRIX_BUS,
+    .frequency_hz = RGB_I2C_MATRIX_FREQUENCY_HZ,
+};
+
+//--------------------------------------------------------------------+
+// Device State
+//--------------------------------------------------------------------+
+
+// Transactions of a device per frame: the changed ranges, plus the unlock and
+// page selection when the device is resynchronized
+#define RGB_I2C_MATRIX_MAX_TRANSACTIONS (RGB_I2C_MATRIX_MAX_RANGES + 2)
+// Bytes of a device per frame: the register address of each range, the PWM
+// page, and the unlock and page selection writes
+#define RGB_I2C_MATRIX_STAGING_SIZE                                            \
+  (RGB_I2C_MATRIX_MAX_RANGES + IS31_PWM_SIZE + 4)
+
+typedef struct {
+  // Set if the device has been initialized
+  bool present;
+  // Set if the PWM registers of the device are unknown, after a failed write
+  volatile bool resync;
+  // PWM registers of the latest frame
+  uint8_t target[IS31_PWM_SIZE];
+  // PWM registers of the device as of the last batch
+  uint8_t shadow[IS31_PWM_SIZE];
+  // Writes of the batch in flight, which must stay valid until it completes
+  i2c_transaction_t transactions[RGB_I2C_MATRIX_MAX_TRANSACTIONS];
+  uint8_t staging[RGB_I2C_MATRIX_STAGING_SIZE];
+} rgb_i2c_matrix_device_t;
+
+static rgb_i2c_matrix_device_t
+    rgb_i2c_matrix_devices[RGB_I2C_MATRIX_NUM_DEVICES];
+
+// Set when a frame has been written, or a write has failed, since the last
+// batch
+static volatile bool rgb_i2c_matrix_pending;
+// Last transaction of the batch in flight, if any. The queue runs the
+// transactions in order, so the batch is done once it has completed.
+static i2c_transaction_t *rgb_i2c_matrix_last;
+static bool rgb_driver_initialized = false;
+
+//--------------------------------------------------------------------+
+// Initialization
+//--------------------------------------------------------------------+
+
+static bool rgb_i2c_matrix_select_page(uint8_t address, uint8_t page) {
+  const uint8_t unlock = IS31_COMMAND_WRITE_LOCK_MAGIC;
+
+  return i2c_bus_write_register(&rgb_i2c_matrix_config, address,
+                                IS31_REG_COMMAND_WRITE_LOCK, I2C_REGISTER_8BIT,
+                                &unlock, 1) &&
+         i2c_bus_write_register(&rgb_i2c_matrix_config, address,
+                                IS31_REG_COMMAND, I2C_REGISTER_8BIT, &page, 1);
+}
+
+static bool rgb_i2c_matrix_write(uint8_t address, uint8_t reg, uint8_t value) {
+  return i2c_bus_write_register(&rgb_i2c_matrix_config, address, reg,
+                                I2C_REGISTER_8BIT, &value, 1);
+}
+
+static bool rgb_i2c_matrix_init_device(uint8_t device) {
+  const uint8_t address = rgb_i2c_matrix_addresses[device];
+  uint8_t led_control[IS31_LED_CONTROL_SIZE] = {0};
+  uint8_t reset;
+
+  // Enable the LEDs of the map only, so the other PWM registers never light up
+  // anything
+  for (uint16_t i = 0; i < NUM_LEDS; i++) {
+    const rgb_i2c_matrix_led_t *led = &rgb_i2c_matrix_leds[i];
+
+    if (led->device != device)
+      continue;
+    led_control[led->r / 8] |= (uint8_t)(1u << (led->r % 8));
+    led_control[led->g / 8] |= (uint8_t)(1u << (led->g % 8));
+    led_control[led->b / 8] |= (uint8_t)(1u << (led->b % 8));
+  }
+
+  // The reset clears the PWM registers, which matches the initial shadow. The
+  // PWM page is left selected, so the frames only write PWM registers.
+  return rgb_i2c_matrix_select_page(address, IS31_PAGE_FUNCTION) &&
+         i2c_bus_read_register(&rgb_i2c_matrix_config, address, IS31_REG_RESET,
+                               I2C_REGISTER_8BIT, &reset, 1) &&
+         rgb_i2c_matrix_select_page(address, IS31_PAGE_LED_CONTROL) &&
+         i2c_bus_write_register(&rgb_i2c_matrix_config, address, 0x00,
+                                I2C_REGISTER_8BIT, led_control,
+                                sizeof(led_control)) &&
+         rgb_i2c_matrix_select_page(address, IS31_PAGE_FUNCTION) &&
+         rgb_i2c_matrix_write(address, IS31_REG_GLOBAL_CURRENT,
+                              RGB_I2C_MATRIX_GLOBAL_CURRENT) &&
+         rgb_i2c_matrix_write(address, IS31_REG_CONFIGURATION,
+                              IS31_CONFIGURATION_NORMAL) &&
+         rgb_i2c_matrix_select_page(address, IS31_PAGE_PWM);
+}
+
+void rgb_driver_init(void) {
+  if (rgb_driver_initialized)
+    return;
+
+  i2c_bus_init();
+  for (uint8_t i = 0; i < RGB_I2C_MATRIX_NUM_DEVICES; i++) {
+    rgb_i2c_matrix_device_t *device = &rgb_i2c_matrix_devices[i];
+
+    memset(device->target, 0, sizeof(device->target));
+    memset(device->shadow, 0, sizeof(device->shadow));
+    device->resync = false;
+    // Missing devices are skipped rather than retried every frame
+    device->present = rgb_i2c_matrix_init_device(i);
+  }
+  rgb_i2c_matrix_pending = false;
+  rgb_i2c_matrix_last = NULL;
+  rgb_driver_initialized = true;
+}
+
+//--------------------------------------------------------------------+
+// Frame Updates
+//--------------------------------------------------------------------+
+
+static void rgb_i2c_matrix_write_done(i2c_transaction_t *transaction,
+                                      bool success) {
+  rgb_i2c_matrix_device_t *device = transaction->user_data;
+
+  // The writes of the batch may have been partially applied, so the whole
+  // page is written again after the batch
+  if (!success) {
+    device->resync = true;
+    rgb_i2c_matrix_pending = true;
+  }
+}
+
+typedef struct {
+  rgb_i2c_matrix_device_t *device;
+  uint8_t address;
+  uint8_t num_transactions;
+  uint16_t staging_len;
+} rgb_i2c_matrix_batch_t;
+
+static void rgb_i2c_matrix_add_write(rgb_i2c_matrix_batch_t *batch,
+                                     uint8_t reg, const uint8_t *data,
+                                     uint16_t len) {
+  rgb_i2c_matrix_device_t *device = batch->device;
+  i2c_transaction_t *transaction =
+      &device->transactions[batch->num_transactions++];
+  uint8_t *tx = &device->staging[batch->staging_len];
+
+  tx[0] = reg;
+  memcpy(&tx[1], data, len);
+  batch->staging_len += (uint16_t)(len + 1u);
+
+  transaction->config = &rgb_i2c_matrix_config;
+  transaction->address = batch->address;
+  transaction->tx = tx;
+  transaction->len = (size_t)len + 1u;
+  transaction->callback = rgb_i2c_matrix_write_done;
+  transaction->user_data = device;
+}
+
+/**
+ * @brief Queue the writes of the changed PWM registers of a device
+ *
+ * Changed registers are grouped into ranges, merging the ranges separated by
+ * fewer unchanged registers than the cost of a separate write. The shadow is
+ * updated as if the writes had succeeded, and a failed write resynchronizes
+ * the whole page on the next frame.
+ *
+ * @param index Index of the device
+ *
+ * @return None
+ */
+static void rgb_i2c_matrix_update_device(uint8_t index) {
+  rgb_i2c_matrix_device_t *device = &rgb_i2c_matrix_devices[index];
+  rgb_i2c_matrix_batch_t batch = {
+      .device = device,
+      .address = rgb_i2c_matrix_addresses[index],
+  };
+
+  if (!device->present)
+    return;
+
+  if (device->resync) {
+    const uint8_t unlock = IS31_COMMAND_WRITE_LOCK_MAGIC;
+    const uint8_t page = IS31_PAGE_PWM;
+
+    device->resync = false;
+    rgb_i2c_matrix_add_write(&batch, IS31_REG_COMMAND_WRITE_LOCK, &unlock, 1);
+    rgb_i2c_matrix_add_write(&batch, IS31_REG_COMMAND, &page, 1);
+    rgb_i2c_matrix_add_write(&batch, 0x00, device->target, IS31_PWM_SIZE);
+  } else {
+    uint16_t start = 0;
+    uint16_t end = 0;
+    bool open = false;
+
+    for (uint16_t reg = 0; reg < IS31_PWM_SIZE; reg++) {
+      if (device->target[reg] == device->shadow[reg])
+        continue;
+
+      if (open && (reg - end <= RGB_I2C_MATRIX_RANGE_OVERHEAD ||
+                   batch.num_transactions == RGB_I2C_MATRIX_MAX_RANGES - 1)) {
+        // Extend the current range over the unchanged registers
+        end = (uint16_t)(reg + 1u);
+        continue;
+      }
+      if (open)
+        rgb_i2c_matrix_add_write(&batch, (uint8_t)start,
+                                 &device->target[start],
+                                 (uint16_t)(end - start));
+      start = reg;
+      end = (uint16_t)(reg + 1u);
+      open = true;
+    }
+    if (open)
+      rgb_i2c_matrix_add_write(&batch, (uint8_t)start, &device->target[start],
+                               (uint16_t)(end - start));
+  }
+
+  memcpy(device->shadow, device->target, sizeof(device->shadow));
+  for (uint8_t i = 0; i < batch.num_transactions; i++) {
+    if (i2c_bus_submit(&device->transactions[i])) {
+      rgb_i2c_matrix_last = &device->transactions[i];
+    } else {
+      device->resync = true;
+      rgb_i2c_matrix_pending = true;
+    }
+  }
+}
+
+static bool rgb_i2c_matrix_in_flight(void) {
+  return rgb_i2c_matrix_last != NULL &&
+         (rgb_i2c_matrix_last->state == I2C_TRANSACTION_QUEUED ||
+          rgb_i2c_matrix_last->state == I2C_TRANSACTION_ACTIVE);
+}
+
+void rgb_driver_task(void) {
+  // The staging buffers belong to the batch in flight, and the latest frame
+  // is sent once it has completed
+  if (!rgb_driver_initialized || !rgb_i2c_matrix_pending ||
+      rgb_i2c_matrix_in_flight())
+    return;
+
+  rgb_i2c_matrix_pending = false;
+  rgb_i2c_matrix_last = NULL;
+  for (uint8_t i = 0; i < RGB_I2C_MATRIX_NUM_DEVICES; i++)
+    rgb_i2c_matrix_update_device(i);
+}
+
+void rgb_driver_write(const uint8_t *grb_data, uint16_t byte_count) {
+  if (!rgb_driver_initialized)
+    rgb_driver_init();
+
+  // Only the target registers are updated, so frames written while a batch is
+  // in flight replace each other until it completes
+  for (uint16_t i = 0; i < NUM_LEDS && (uint32_t)i * 3u + 2u < byte_count;
+       i++) {
+    const rgb_i2c_matrix_led_t *led = &rgb_i2c_matrix_leds[i];
+    uint8_t *target = rgb_i2c_matrix_devices[led->device].target;
+
+    target[led->g] = grb_data[i * 3u];
+    target[led->r] = grb_data[i * 3u + 1u];
+    target[led->b] = grb_data[i * 3u + 2u];
+  }
+  rgb_i2c_matrix_pending = true;
+}
+
+#endif
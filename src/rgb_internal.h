@@ -6,6 +6,14 @@
 
 uint8_t rgb_coord_x_at(uint8_t led);
 uint8_t rgb_coord_y_at(uint8_t led);
+uint8_t rgb_led_distance_at(uint8_t led);
+uint8_t rgb_led_angle_at(uint8_t led);
 bool rgb_led_is_mod_at(uint8_t led);
-uint8_t rgb_key_to_led_at(uint8_t key);
+uint8_t rgb_key_to_led_at(key_index_t key);
 uint8_t rgb_reactive_clip_at(uint8_t source_led, uint8_t target_led);
+void rgb_set_range_color(uint8_t led_start, uint8_t led_end, uint8_t r,
+                         uint8_t g, uint8_t b);
+// Fully saturated color of `hue` at the brightness of the current frame
+rgb_color_t rgb_hue_color(uint8_t hue);
+// Fully saturated color of `hue` at `value`
+rgb_color_t rgb_hue_color_value(uint8_t hue, uint8_t value);
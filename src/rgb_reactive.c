@@ -220,7 +220,7 @@ void rgb_reactive_decay_heatmap(uint32_t current_tick) {
   heatmap_tick = current_tick;
 }
 
-void rgb_reactive_record_keypress(uint8_t index) {
+void rgb_reactive_record_keypress(key_index_t index) {
   if (index >= NUM_KEYS) {
     return;
   }
@@ -271,8 +271,9 @@ void rgb_reactive_record_keypress(uint8_t index) {
   }
 }
 
-void rgb_reactive_render_heatmap(uint8_t effective_brightness) {
-  for (uint8_t i = 0; i < NUM_LEDS; i++) {
+void rgb_reactive_render_heatmap(uint8_t effective_brightness,
+                                 uint8_t led_start, uint8_t led_end) {
+  for (uint8_t i = led_start; i < led_end; i++) {
     const uint8_t temp = rgb_heatmap[i];
     if (temp == 0u) {
       rgb_set_color(i, 0, 0, 0);
@@ -283,15 +284,15 @@ void rgb_reactive_render_heatmap(uint8_t effective_brightness) {
     const uint8_t hue = (170u > sub) ? (uint8_t)(170u - sub) : 0u;
     const uint8_t heat = qsub8(qadd8(170u, temp), 170u);
     const uint8_t v = scale8((uint8_t)(heat * 3u), effective_brightness);
-    const hsv_t hsv = {.h = hue, .s = 255, .v = v};
-    const rgb_color_t color = hsv_to_rgb(hsv);
+    const rgb_color_t color = rgb_hue_color_value(hue, v);
     rgb_set_color(i, color.r, color.g, color.b);
   }
 }
 
 void rgb_reactive_render_effect(uint8_t effect, uint8_t base_hue,
-                                uint8_t effective_brightness, uint8_t speed) {
-  for (uint8_t i = 0; i < NUM_LEDS; i++) {
+                                uint8_t effective_brightness, uint8_t speed,
+                                uint8_t led_start, uint8_t led_end) {
+  for (uint8_t i = led_start; i < led_end; i++) {
     const uint8_t intensity = compute_reactive_intensity(i, effect, speed);
     hsv_t hsv = {.h = base_hue, .s = 255, .v = effective_brightness};
     if (effect == RGB_EFFECT_SOLID_REACTIVE_SIMPLE) {
@@ -308,21 +309,22 @@ void rgb_reactive_render_effect(uint8_t effect, uint8_t base_hue,
       hsv.v = qadd8(hsv.v, (uint8_t)(255u - intensity));
     }
 
-    const rgb_color_t color = hsv_to_rgb(hsv);
+    const rgb_color_t color = rgb_hue_color_value(hsv.h, hsv.v);
     rgb_set_color(i, color.r, color.g, color.b);
   }
 }
 
 void rgb_reactive_render_splash(uint8_t effect, uint8_t base_hue,
-                                uint8_t effective_brightness, uint8_t speed) {
-  for (uint8_t i = 0; i < NUM_LEDS; i++) {
+                                uint8_t effective_brightness, uint8_t speed,
+                                uint8_t led_start, uint8_t led_end) {
+  for (uint8_t i = led_start; i < led_end; i++) {
     const uint8_t intensity = compute_splash_intensity(i, effect, speed);
     hsv_t hsv = {.h = base_hue, .s = 255, .v = effective_brightness};
     if (effect == RGB_EFFECT_SPLASH || effect == RGB_EFFECT_MULTISPLASH) {
       hsv.h = (uint8_t)(hsv.h + intensity);
     }
     hsv.v = qadd8(hsv.v, (uint8_t)(255u - intensity));
-    const rgb_color_t color = hsv_to_rgb(hsv);
+    const rgb_color_t color = rgb_hue_color_value(hsv.h, hsv.v);
     rgb_set_color(i, color.r, color.g, color.b);
   }
 }
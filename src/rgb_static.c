@@ -57,22 +57,9 @@ static uint8_t rgb_static_distance(int16_t dx, int16_t dy) {
   return (uint8_t)usqrt32(dx_sq + dy_sq);
 }
 
-static uint8_t rgb_static_led_distance(uint8_t led) {
-  const int16_t dx = rgb_static_centered_x(led);
-  const int16_t dy = rgb_static_centered_y(led);
-  return rgb_static_distance(dx, dy);
-}
-
-static uint8_t rgb_static_led_angle(uint8_t led) {
-  const int16_t dx = rgb_static_centered_x(led);
-  const int16_t dy = rgb_static_centered_y(led);
-  return (uint8_t)(((atan2((double)dy, (double)dx) + M_PI) * 255.0) /
-                   (2.0 * M_PI));
-}
-
 static void rgb_static_render_band_axis(const rgb_static_context_t *context,
                                         bool saturate) {
-  for (uint8_t i = 0; i < NUM_LEDS; i++) {
+  for (uint8_t i = context->led_start; i < context->led_end; i++) {
     const uint8_t x = rgb_coord_x_at(i);
     int16_t dist = (int16_t)x + 28 - (int16_t)(context->scaled_timer >> 8);
     if (dist < 0) {
@@ -84,15 +71,15 @@ static void rgb_static_render_band_axis(const rgb_static_context_t *context,
       value = 0;
     }
 
-    hsv_t hsv = {
-        .h = context->base_hue,
-        .s = saturate ? (uint8_t)value : 255u,
-        .v = saturate ? context->effective_brightness
-                      : (uint8_t)(((uint32_t)(uint16_t)value *
-                                   context->effective_brightness) /
-                                  255u),
-    };
-    const rgb_color_t color = hsv_to_rgb(hsv);
+    const rgb_color_t color =
+        saturate ? hsv_to_rgb((hsv_t){
+                       .h = context->base_hue,
+                       .s = (uint8_t)value,
+                       .v = context->effective_brightness,
+                   })
+                 : rgb_hue_color_value(
+                       context->base_hue,
+                       scale8((uint8_t)value, context->effective_brightness));
     rgb_set_color(i, color.r, color.g, color.b);
   }
 }
@@ -105,9 +92,9 @@ static void rgb_static_render_band_polar(const rgb_static_context_t *context,
   const bool saturate = effect == RGB_EFFECT_BAND_PINWHEEL_SAT ||
                         effect == RGB_EFFECT_BAND_SPIRAL_SAT;
 
-  for (uint8_t i = 0; i < NUM_LEDS; i++) {
-    const uint8_t dist = rgb_static_led_distance(i);
-    uint8_t offset = rgb_static_led_angle(i);
+  for (uint8_t i = context->led_start; i < context->led_end; i++) {
+    const uint8_t dist = rgb_led_distance_at(i);
+    uint8_t offset = rgb_led_angle_at(i);
     if (spiral) {
       offset = (uint8_t)(offset + dist);
     }
@@ -117,15 +104,15 @@ static void rgb_static_render_band_polar(const rgb_static_context_t *context,
       value = 0;
     }
 
-    hsv_t hsv = {
-        .h = context->base_hue,
-        .s = saturate ? (uint8_t)value : 255u,
-        .v = saturate ? context->effective_brightness
-                      : (uint8_t)(((uint32_t)(uint16_t)value *
-                                   context->effective_brightness) /
-                                  255u),
-    };
-    const rgb_color_t color = hsv_to_rgb(hsv);
+    const rgb_color_t color =
+        saturate ? hsv_to_rgb((hsv_t){
+                       .h = context->base_hue,
+                       .s = (uint8_t)value,
+                       .v = context->effective_brightness,
+                   })
+                 : rgb_hue_color_value(
+                       context->base_hue,
+                       scale8((uint8_t)value, context->effective_brightness));
     rgb_set_color(i, color.r, color.g, color.b);
   }
 }
@@ -134,17 +121,13 @@ static void rgb_static_render_gradient(const rgb_static_context_t *context,
                                        bool vertical) {
   const uint8_t scale = scale8(64u, context->config->effect_speed);
 
-  for (uint8_t i = 0; i < NUM_LEDS; i++) {
+  for (uint8_t i = context->led_start; i < context->led_end; i++) {
     const uint8_t coord = vertical ? rgb_coord_y_at(i) : rgb_coord_x_at(i);
     const uint8_t hue =
         vertical ? (uint8_t)(context->base_hue + scale * (coord >> 4))
                  : (uint8_t)(context->base_hue +
                              (((uint16_t)scale * coord) >> 5));
-    const rgb_color_t color = hsv_to_rgb((hsv_t){
-        .h = hue,
-        .s = 255u,
-        .v = context->effective_brightness,
-    });
+    const rgb_color_t color = rgb_hue_color(hue);
     rgb_set_color(i, color.r, color.g, color.b);
   }
 }
@@ -153,13 +136,9 @@ static void rgb_static_render_axis_cycle(const rgb_static_context_t *context,
                                          bool vertical) {
   const uint8_t time = (uint8_t)(context->scaled_timer >> 8);
 
-  for (uint8_t i = 0; i < NUM_LEDS; i++) {
+  for (uint8_t i = context->led_start; i < context->led_end; i++) {
     const uint8_t coord = vertical ? rgb_coord_y_at(i) : rgb_coord_x_at(i);
-    const rgb_color_t color = hsv_to_rgb((hsv_t){
-        .h = (uint8_t)(coord - time),
-        .s = 255u,
-        .v = context->effective_brightness,
-    });
+    const rgb_color_t color = rgb_hue_color((uint8_t)(coord - time));
     rgb_set_color(i, color.r, color.g, color.b);
   }
 }
@@ -168,7 +147,7 @@ static void rgb_static_render_cycle_out_in(const rgb_static_context_t *context,
                                            bool dual) {
   const uint8_t time = (uint8_t)(context->scaled_timer >> 8);
 
-  for (uint8_t i = 0; i < NUM_LEDS; i++) {
+  for (uint8_t i = context->led_start; i < context->led_end; i++) {
     uint8_t hue;
 
     if (dual) {
@@ -179,15 +158,11 @@ static void rgb_static_render_cycle_out_in(const rgb_static_context_t *context,
       const uint8_t ring_hue = (uint8_t)(3u * dist + time);
       hue = (ring_hue & 0x80u) ? context->secondary_hue : ring_hue;
     } else {
-      const uint8_t dist = rgb_static_led_distance(i);
+      const uint8_t dist = rgb_led_distance_at(i);
       hue = (uint8_t)((3u * dist / 2u) + time);
     }
 
-    const rgb_color_t color = hsv_to_rgb((hsv_t){
-        .h = hue,
-        .s = 255u,
-        .v = context->effective_brightness,
-    });
+    const rgb_color_t color = rgb_hue_color(hue);
     rgb_set_color(i, color.r, color.g, color.b);
   }
 }
@@ -196,16 +171,12 @@ static void rgb_static_render_cycle_polar(const rgb_static_context_t *context,
                                           bool spiral) {
   const uint8_t time = (uint8_t)(context->scaled_timer >> 8);
 
-  for (uint8_t i = 0; i < NUM_LEDS; i++) {
-    const uint8_t angle = rgb_static_led_angle(i);
-    const uint8_t dist = rgb_static_led_distance(i);
+  for (uint8_t i = context->led_start; i < context->led_end; i++) {
+    const uint8_t angle = rgb_led_angle_at(i);
+    const uint8_t dist = rgb_led_distance_at(i);
     const uint8_t hue =
         spiral ? (uint8_t)(dist - time - angle) : (uint8_t)(angle + time);
-    const rgb_color_t color = hsv_to_rgb((hsv_t){
-        .h = hue,
-        .s = 255u,
-        .v = context->effective_brightness,
-    });
+    const rgb_color_t color = rgb_hue_color(hue);
     rgb_set_color(i, color.r, color.g, color.b);
   }
 }
@@ -218,7 +189,8 @@ static void rgb_static_render_starlight_family(
       (uint8_t)(abs8((int16_t)sin8(time) - 128) << 1),
       context->effective_brightness);
 
-  if ((context->tick % 5u != 0u) || context->tick == context->prev_tick) {
+  if ((context->tick % 5u != 0u) || context->tick == context->prev_tick ||
+      context->led_start != 0u) {
     return;
   }
 
@@ -240,14 +212,15 @@ void rgb_static_reset(void) { random_state = 0x12345678u; }
 bool rgb_static_render(rgb_effect_t effect, const rgb_static_context_t *context) {
   switch (effect) {
   case RGB_EFFECT_OFF:
-    rgb_set_all_color(0u, 0u, 0u);
+    rgb_set_range_color(context->led_start, context->led_end, 0u, 0u, 0u);
     return true;
 
   case RGB_EFFECT_SOLID_COLOR: {
     const rgb_color_t color =
         rgb_static_scale_color(context->config->solid_color,
                                context->effective_brightness);
-    rgb_set_all_color(color.r, color.g, color.b);
+    rgb_set_range_color(context->led_start, context->led_end, color.r,
+                        color.g, color.b);
     return true;
   }
 
@@ -259,7 +232,7 @@ bool rgb_static_render(rgb_effect_t effect, const rgb_static_context_t *context)
         rgb_static_scale_color(context->config->secondary_color,
                                context->effective_brightness);
 
-    for (uint8_t i = 0; i < NUM_LEDS; i++) {
+    for (uint8_t i = context->led_start; i < context->led_end; i++) {
       const rgb_color_t color = rgb_led_is_mod_at(i) ? mod : base;
       rgb_set_color(i, color.r, color.g, color.b);
     }
@@ -294,22 +267,16 @@ bool rgb_static_render(rgb_effect_t effect, const rgb_static_context_t *context)
     const uint8_t pulse =
         (uint8_t)(abs8((int16_t)sin8(time >> 1) - 128) << 1);
     const uint8_t value = scale8(pulse, context->effective_brightness);
-    const rgb_color_t color = hsv_to_rgb((hsv_t){
-        .h = context->base_hue,
-        .s = 255u,
-        .v = value,
-    });
-    rgb_set_all_color(color.r, color.g, color.b);
+    const rgb_color_t color = rgb_hue_color_value(context->base_hue, value);
+    rgb_set_range_color(context->led_start, context->led_end, color.r,
+                        color.g, color.b);
     return true;
   }
 
   case RGB_EFFECT_CYCLE_ALL: {
-    const rgb_color_t color = hsv_to_rgb((hsv_t){
-        .h = (uint8_t)(context->scaled_timer >> 8),
-        .s = 255u,
-        .v = context->effective_brightness,
-    });
-    rgb_set_all_color(color.r, color.g, color.b);
+    const rgb_color_t color = rgb_hue_color((uint8_t)(context->scaled_timer >> 8));
+    rgb_set_range_color(context->led_start, context->led_end, color.r,
+                        color.g, color.b);
     return true;
   }
 
@@ -331,15 +298,11 @@ bool rgb_static_render(rgb_effect_t effect, const rgb_static_context_t *context)
 
   case RGB_EFFECT_RAINBOW_MOVING_CHEVRON: {
     const uint8_t time = (uint8_t)(context->scaled_timer >> 8);
-    for (uint8_t i = 0; i < NUM_LEDS; i++) {
+    for (uint8_t i = context->led_start; i < context->led_end; i++) {
       const uint8_t hue = (uint8_t)(context->base_hue +
                                     abs8((int16_t)rgb_coord_y_at(i) - 127) +
                                     (rgb_coord_x_at(i) - time));
-      const rgb_color_t color = hsv_to_rgb((hsv_t){
-          .h = hue,
-          .s = 255u,
-          .v = context->effective_brightness,
-      });
+      const rgb_color_t color = rgb_hue_color(hue);
       rgb_set_color(i, color.r, color.g, color.b);
     }
     return true;
@@ -350,15 +313,11 @@ bool rgb_static_render(rgb_effect_t effect, const rgb_static_context_t *context)
     const int16_t sn = (int16_t)sin8(time) - 128;
     const int16_t cs = (int16_t)cos8(time) - 128;
 
-    for (uint8_t i = 0; i < NUM_LEDS; i++) {
+    for (uint8_t i = context->led_start; i < context->led_end; i++) {
       const int16_t dx = rgb_static_centered_x(i);
       const int16_t dy = rgb_static_centered_y(i);
       const int16_t proj = (dy * cs + dx * sn) / 128;
-      const rgb_color_t color = hsv_to_rgb((hsv_t){
-          .h = (uint8_t)(context->base_hue + proj),
-          .s = 255u,
-          .v = context->effective_brightness,
-      });
+      const rgb_color_t color = rgb_hue_color((uint8_t)(context->base_hue + proj));
       rgb_set_color(i, color.r, color.g, color.b);
     }
     return true;
@@ -377,15 +336,11 @@ bool rgb_static_render(rgb_effect_t effect, const rgb_static_context_t *context)
     const int16_t sn = (int16_t)sin8(time) - 128;
     const int16_t cs = (int16_t)cos8(time) - 128;
 
-    for (uint8_t i = 0; i < NUM_LEDS; i++) {
+    for (uint8_t i = context->led_start; i < context->led_end; i++) {
       const int16_t dx = rgb_static_centered_x(i);
       const int16_t dy = rgb_static_centered_y(i);
       const int16_t delta = (dy * 2 * cs + dx * 2 * sn) / 128;
-      const rgb_color_t color = hsv_to_rgb((hsv_t){
-          .h = (uint8_t)(time + delta),
-          .s = 255u,
-          .v = context->effective_brightness,
-      });
+      const rgb_color_t color = rgb_hue_color((uint8_t)(time + delta));
       rgb_set_color(i, color.r, color.g, color.b);
     }
     return true;
@@ -396,16 +351,12 @@ bool rgb_static_render(rgb_effect_t effect, const rgb_static_context_t *context)
     const int16_t sn = (int16_t)sin8(time) - 128;
     const int16_t cs = (int16_t)cos8(time) - 128;
 
-    for (uint8_t i = 0; i < NUM_LEDS; i++) {
+    for (uint8_t i = context->led_start; i < context->led_end; i++) {
       const int16_t dx = rgb_static_centered_x(i);
       const int16_t dy = rgb_static_centered_y(i);
       const int16_t adx = dx < 0 ? (int16_t)(-dx) : dx;
       const int16_t delta = (dy * 3 * cs + (56 - adx) * 3 * sn) / 128;
-      const rgb_color_t color = hsv_to_rgb((hsv_t){
-          .h = (uint8_t)(time + delta),
-          .s = 255u,
-          .v = context->effective_brightness,
-      });
+      const rgb_color_t color = rgb_hue_color((uint8_t)(time + delta));
       rgb_set_color(i, color.r, color.g, color.b);
     }
     return true;
@@ -414,21 +365,14 @@ bool rgb_static_render(rgb_effect_t effect, const rgb_static_context_t *context)
   case RGB_EFFECT_FLOWER_BLOOMING: {
     const uint8_t phase = (uint8_t)((context->anim_timer / 4u) % 255u);
 
-    for (uint8_t i = 0; i < NUM_LEDS; i++) {
-      const uint8_t dist = rgb_static_led_distance(i);
-      const double wave =
-          sin((((double)((int16_t)phase - (int16_t)dist)) * M_PI) / 64.0);
-      uint16_t value = (uint16_t)(127.0 + 127.0 * wave);
-      if (value > 255u) {
-        value = 255u;
-      }
-
-      const rgb_color_t color = hsv_to_rgb((hsv_t){
-          .h = (uint8_t)(context->base_hue + dist),
-          .s = 255u,
-          .v = (uint8_t)(((uint32_t)value * context->effective_brightness) /
-                         255u),
-      });
+    for (uint8_t i = context->led_start; i < context->led_end; i++) {
+      const uint8_t dist = rgb_led_distance_at(i);
+      // One sin8() period spans 128 phase steps, matching the original
+      // sin(pi * (phase - dist) / 64) wave
+      const uint8_t value = sin8((uint8_t)((uint8_t)(phase - dist) << 1));
+      const rgb_color_t color = rgb_hue_color_value(
+          (uint8_t)(context->base_hue + dist),
+          scale8(value, context->effective_brightness));
       rgb_set_color(i, color.r, color.g, color.b);
     }
     return true;
@@ -439,7 +383,8 @@ bool rgb_static_render(rgb_effect_t effect, const rgb_static_context_t *context)
     return true;
 
   case RGB_EFFECT_RAINDROPS:
-    if ((context->tick % 10u == 0u) && context->tick != context->prev_tick) {
+    if ((context->tick % 10u == 0u) && context->tick != context->prev_tick &&
+        context->led_start == 0u) {
       const uint8_t rand_idx = random8_max(NUM_LEDS);
       hsv_t hsv = {
           .h = context->base_hue,
@@ -457,7 +402,8 @@ bool rgb_static_render(rgb_effect_t effect, const rgb_static_context_t *context)
     return true;
 
   case RGB_EFFECT_JELLYBEAN_RAINDROPS:
-    if ((context->tick % 5u == 0u) && context->tick != context->prev_tick) {
+    if ((context->tick % 5u == 0u) && context->tick != context->prev_tick &&
+        context->led_start == 0u) {
       const uint8_t rand_idx = random8_max(NUM_LEDS);
       const rgb_color_t color = hsv_to_rgb((hsv_t){
           .h = random8(),
@@ -478,27 +424,20 @@ bool rgb_static_render(rgb_effect_t effect, const rgb_static_context_t *context)
     const uint8_t time = (uint8_t)(context->scaled_timer >> 8);
     const uint8_t delta = scale8(
         (uint8_t)(abs8((int16_t)sin8(time >> 1) - 128) << 1), 12u);
-    const rgb_color_t color = hsv_to_rgb((hsv_t){
-        .h = (uint8_t)(context->base_hue + delta),
-        .s = 255u,
-        .v = context->effective_brightness,
-    });
-    rgb_set_all_color(color.r, color.g, color.b);
+    const rgb_color_t color = rgb_hue_color((uint8_t)(context->base_hue + delta));
+    rgb_set_range_color(context->led_start, context->led_end, color.r,
+                        color.g, color.b);
     return true;
   }
 
   case RGB_EFFECT_HUE_PENDULUM: {
-    for (uint8_t i = 0; i < NUM_LEDS; i++) {
+    for (uint8_t i = context->led_start; i < context->led_end; i++) {
       const uint8_t delta = scale8(
           (uint8_t)(abs8((int16_t)sin8((uint8_t)(context->scaled_timer >> 8)) +
                          rgb_coord_x_at(i) - 128) <<
                     1),
           12u);
-      const rgb_color_t color = hsv_to_rgb((hsv_t){
-          .h = (uint8_t)(context->base_hue + delta),
-          .s = 255u,
-          .v = context->effective_brightness,
-      });
+      const rgb_color_t color = rgb_hue_color((uint8_t)(context->base_hue + delta));
       rgb_set_color(i, color.r, color.g, color.b);
     }
     return true;
@@ -506,13 +445,10 @@ bool rgb_static_render(rgb_effect_t effect, const rgb_static_context_t *context)
 
   case RGB_EFFECT_HUE_WAVE: {
     const uint8_t time = (uint8_t)(context->scaled_timer >> 8);
-    for (uint8_t i = 0; i < NUM_LEDS; i++) {
-      const rgb_color_t color = hsv_to_rgb((hsv_t){
-          .h = (uint8_t)(context->base_hue +
-                         scale8(abs8((int16_t)rgb_coord_x_at(i) - time), 24u)),
-          .s = 255u,
-          .v = context->effective_brightness,
-      });
+    for (uint8_t i = context->led_start; i < context->led_end; i++) {
+      const rgb_color_t color = rgb_hue_color((uint8_t)(
+          context->base_hue +
+          scale8(abs8((int16_t)rgb_coord_x_at(i) - time), 24u)));
       rgb_set_color(i, color.r, color.g, color.b);
     }
     return true;
@@ -520,16 +456,12 @@ bool rgb_static_render(rgb_effect_t effect, const rgb_static_context_t *context)
 
   case RGB_EFFECT_RIVERFLOW: {
     const uint8_t time = (uint8_t)(context->scaled_timer >> 8);
-    for (uint8_t i = 0; i < NUM_LEDS; i++) {
+    for (uint8_t i = context->led_start; i < context->led_end; i++) {
       const uint8_t t = (uint8_t)(time + (i * 315u));
       const uint8_t value = scale8(
           (uint8_t)(abs8((int16_t)sin8(t) - 128) << 1),
           context->effective_brightness);
-      const rgb_color_t color = hsv_to_rgb((hsv_t){
-          .h = context->base_hue,
-          .s = 255u,
-          .v = value,
-      });
+      const rgb_color_t color = rgb_hue_color_value(context->base_hue, value);
       rgb_set_color(i, color.r, color.g, color.b);
     }
     return true;
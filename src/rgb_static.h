@@ -15,6 +15,9 @@ typedef struct {
   uint16_t scaled_timer;
   uint16_t tick;
   uint16_t prev_tick;
+  // LEDs [led_start, led_end) are rendered by this call
+  uint8_t led_start;
+  uint8_t led_end;
 } rgb_static_context_t;
 
 void rgb_static_reset(void);
@@ -0,0 +1,216 @@
+/*
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "rgb_stream.h"
+
+#if defined(RGB_ENABLED)
+
+#if defined(NUM_LEDS)
+#else
+#define NUM_LEDS NUM_KEYS
+#endif
+
+#include "hardware/hardware.h"
+
+// The host decodes into the back buffer while the renderer reads the front
+// buffer. A presented frame waits in the ready buffer until the next frame
+// starts, so a frame being rendered in slices never changes underneath it.
+static rgb_color_t rgb_stream_frames[3][NUM_LEDS];
+static uint8_t rgb_stream_front;
+static uint8_t rgb_stream_ready;
+static uint8_t rgb_stream_back;
+static bool rgb_stream_ready_pending;
+static rgb_color_t rgb_stream_palette[RGB_STREAM_PALETTE_SIZE];
+
+static bool rgb_stream_running;
+// Whether the back buffer holds a partial frame of `rgb_stream_back_sequence`
+static bool rgb_stream_building;
+static uint16_t rgb_stream_back_sequence;
+static uint32_t rgb_stream_last_packet;
+static rgb_stream_status_t rgb_stream_status;
+
+void rgb_stream_reset(void) {
+  memset(rgb_stream_frames, 0, sizeof(rgb_stream_frames));
+  memset(rgb_stream_palette, 0, sizeof(rgb_stream_palette));
+  rgb_stream_front = 0;
+  rgb_stream_ready = 1;
+  rgb_stream_back = 2;
+  rgb_stream_ready_pending = false;
+  rgb_stream_running = false;
+  rgb_stream_building = false;
+  rgb_stream_back_sequence = 0;
+  rgb_stream_last_packet = 0;
+  memset(&rgb_stream_status, 0, sizeof(rgb_stream_status));
+}
+
+// Number of LEDs a packet covers, or 0 if it does not fit in the frame
+static uint16_t rgb_stream_led_count(uint8_t encoding, uint8_t offset,
+                                     const uint8_t *data, uint8_t len) {
+  uint16_t count = 0;
+
+  switch (encoding) {
+  case RGB_STREAM_ENCODING_RAW:
+    if (len % 3u != 0)
+      return 0;
+    count = len / 3u;
+    break;
+
+  case RGB_STREAM_ENCODING_RLE:
+    if (len % 4u != 0)
+      return 0;
+    for (uint8_t i = 0; i < len; i += 4u) {
+      if (data[i] == 0)
+        return 0;
+      count += data[i];
+    }
+    break;
+
+  case RGB_STREAM_ENCODING_PALETTE:
+    // Indices past the last LED pad the final byte and are ignored
+    count = M_MIN((uint16_t)(len * 2u), (uint16_t)(NUM_LEDS - offset));
+    break;
+
+  default:
+    return 0;
+  }
+
+  return (uint16_t)offset + count <= NUM_LEDS ? count : 0;
+}
+
+static void rgb_stream_decode(uint8_t encoding, uint8_t offset,
+                              const uint8_t *data, uint8_t len,
+                              uint16_t count) {
+  rgb_color_t *frame = &rgb_stream_frames[rgb_stream_back][offset];
+
+  switch (encoding) {
+  case RGB_STREAM_ENCODING_RAW:
+    for (uint16_t i = 0; i < count; i++, data += 3)
+      frame[i] = (rgb_color_t){.r = data[0], .g = data[1], .b = data[2]};
+    break;
+
+  case RGB_STREAM_ENCODING_RLE:
+    for (uint8_t i = 0; i < len; i += 4u) {
+      const rgb_color_t color = {
+          .r = data[i + 1u], .g = data[i + 2u], .b = data[i + 3u]};
+      for (uint8_t j = 0; j < data[i]; j++)
+        *frame++ = color;
+    }
+    break;
+
+  case RGB_STREAM_ENCODING_PALETTE:
+    for (uint16_t i = 0; i < count; i++) {
+      const uint8_t packed = data[i >> 1];
+      const uint8_t index = (i & 1u) ? (uint8_t)(packed >> 4) : packed & 0x0Fu;
+      frame[i] = rgb_stream_palette[index];
+    }
+    break;
+
+  default:
+    break;
+  }
+}
+
+bool rgb_stream_write(uint16_t sequence, uint8_t flags, uint8_t encoding,
+                      uint8_t offset, const uint8_t *data, uint8_t len) {
+  if (flags & RGB_STREAM_FLAG_STOP) {
+    rgb_stream_running = false;
+    rgb_stream_building = false;
+    rgb_stream_ready_pending = false;
+    return true;
+  }
+
+  if (encoding >= RGB_STREAM_ENCODING_COUNT)
+    return false;
+
+  uint16_t count = 0;
+  if (encoding == RGB_STREAM_ENCODING_SET_PALETTE) {
+    if (len % 3u != 0 || offset + len / 3u > RGB_STREAM_PALETTE_SIZE)
+      return false;
+  } else if (len > 0) {
+    count = rgb_stream_led_count(encoding, offset, data, len);
+    if (count == 0)
+      return false;
+  }
+
+  rgb_stream_last_packet = timer_read();
+
+  // Ignore late packets of frames that are already presented or superseded
+  if (rgb_stream_running &&
+      (int16_t)(sequence - rgb_stream_status.presented_sequence) <= 0)
+    return true;
+
+  if (encoding == RGB_STREAM_ENCODING_SET_PALETTE) {
+    for (uint8_t i = 0; i < len / 3u; i++)
+      rgb_stream_palette[offset + i] = (rgb_color_t){
+          .r = data[i * 3u], .g = data[i * 3u + 1u], .b = data[i * 3u + 2u]};
+  }
+
+  if (!rgb_stream_building || sequence != rgb_stream_back_sequence) {
+    if (rgb_stream_building)
+      rgb_stream_status.dropped_frames++;
+    // A frame starts from the newest complete frame so the host only has to
+    // send the LEDs that changed
+    const uint8_t latest =
+        rgb_stream_ready_pending ? rgb_stream_ready : rgb_stream_front;
+    memcpy(rgb_stream_frames[rgb_stream_back], rgb_stream_frames[latest],
+           sizeof(rgb_stream_frames[0]));
+    rgb_stream_building = true;
+    rgb_stream_back_sequence = sequence;
+  }
+
+  if (count > 0)
+    rgb_stream_decode(encoding, offset, data, len, count);
+
+  if (flags & RGB_STREAM_FLAG_PRESENT) {
+    const uint8_t ready = rgb_stream_ready;
+
+    if (rgb_stream_ready_pending)
+      rgb_stream_status.dropped_frames++;
+    rgb_stream_ready = rgb_stream_back;
+    rgb_stream_back = ready;
+    rgb_stream_ready_pending = true;
+    rgb_stream_building = false;
+    rgb_stream_running = true;
+    rgb_stream_status.presented_sequence = sequence;
+  }
+
+  return true;
+}
+
+rgb_stream_status_t rgb_stream_get_status(void) { return rgb_stream_status; }
+
+const rgb_color_t *rgb_stream_begin_frame(void) {
+  if (!rgb_stream_running)
+    return NULL;
+
+  if (timer_elapsed(rgb_stream_last_packet) >= RGB_STREAM_TIMEOUT_MS) {
+    rgb_stream_running = false;
+    rgb_stream_building = false;
+    rgb_stream_ready_pending = false;
+    return NULL;
+  }
+
+  if (rgb_stream_ready_pending) {
+    const uint8_t front = rgb_stream_front;
+
+    rgb_stream_front = rgb_stream_ready;
+    rgb_stream_ready = front;
+    rgb_stream_ready_pending = false;
+  }
+
+  return rgb_stream_frames[rgb_stream_front];
+}
+
+#endif
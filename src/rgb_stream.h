@@ -0,0 +1,13 @@
+#pragma once
+
+#include "rgb.h"
+
+#if !defined(RGB_STREAM_TIMEOUT_MS)
+// Time without any stream packet after which the stored effect is restored
+#define RGB_STREAM_TIMEOUT_MS 500
+#endif
+
+void rgb_stream_reset(void);
+// Latch the newest presented frame for the frame about to be rendered. Returns
+// NULL when no stream is running, in which case the stored effect is rendered.
+const rgb_color_t *rgb_stream_begin_frame(void);
@@ -0,0 +1,187 @@
+/*
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "spi_queue.h"
+
+static bool spi_queue_is_pending(const spi_transaction_t *transaction) {
+  return transaction->state == SPI_TRANSACTION_QUEUED ||
+         transaction->state == SPI_TRANSACTION_ACTIVE;
+}
+
+#if SPI_NUM_BUSES > 0
+typedef struct {
+  // Transactions of the bus in order. The first one is in progress while
+  // `running` is set.
+  spi_transaction_t *volatile head;
+  spi_transaction_t *tail;
+  // Set while the queue is being advanced or a transfer is pending
+  volatile bool running;
+  // Chip select kept asserted by the last transaction
+  const spi_chip_select_t *held_chip_select;
+} spi_queue_t;
+
+static spi_queue_t spi_queues[SPI_NUM_BUSES];
+
+static void spi_queue_append(spi_queue_t *queue,
+                             spi_transaction_t *transaction) {
+  transaction->queue_next = NULL;
+  transaction->state = SPI_TRANSACTION_QUEUED;
+  if (queue->tail != NULL)
+    queue->tail->queue_next = transaction;
+  else
+    queue->head = transaction;
+  queue->tail = transaction;
+}
+
+/**
+ * @brief Remove the first transaction of a bus and report its result
+ *
+ * @param queue Queue of the bus
+ * @param success true if the transfer was successful, false otherwise
+ *
+ * @return None
+ */
+static void spi_queue_finish(spi_queue_t *queue, bool success) {
+  spi_transaction_t *transaction = queue->head;
+
+  queue->head = transaction->queue_next;
+  if (queue->head == NULL)
+    queue->tail = NULL;
+
+  if (transaction->chip_select != NULL) {
+    if (success && transaction->keep_selected) {
+      queue->held_chip_select = transaction->chip_select;
+    } else {
+      spi_cs_deselect(transaction->chip_select);
+      queue->held_chip_select = NULL;
+    }
+  }
+
+  transaction->state =
+      success ? SPI_TRANSACTION_DONE : SPI_TRANSACTION_FAILED;
+  if (transaction->callback != NULL)
+    transaction->callback(transaction, success);
+  // The callback may have cleared the chain or submitted it already
+  if (success && transaction->chain != NULL &&
+      !spi_queue_is_pending(transaction->chain))
+    spi_queue_append(queue, transaction->chain);
+}
+
+/**
+ * @brief Start the transactions of a bus until one is pending
+ *
+ * Transfers done before `spi_driver_start()` returns are finished in this
+ * loop rather than recursively, so polled buses run any number of chained
+ * transactions in constant stack space.
+ *
+ * @param bus Bus to advance
+ *
+ * @return None
+ */
+static void spi_queue_advance(uint8_t bus) {
+  spi_queue_t *queue = &spi_queues[bus];
+
+  queue->running = true;
+  while (queue->head != NULL) {
+    spi_transaction_t *transaction = queue->head;
+    spi_driver_status_t status = SPI_DRIVER_ERROR;
+
+    if (queue->held_chip_select != NULL &&
+        queue->held_chip_select != transaction->chip_select) {
+      spi_cs_deselect(queue->held_chip_select);
+      queue->held_chip_select = NULL;
+    }
+
+    transaction->state = SPI_TRANSACTION_ACTIVE;
+    if (spi_bus_acquire(transaction->config)) {
+      if (transaction->chip_select != NULL)
+        spi_cs_select(transaction->chip_select);
+      status = spi_driver_start(bus, transaction);
+    }
+    if (status == SPI_DRIVER_PENDING)
+      // `spi_queue_complete()` continues from here
+      return;
+
+    spi_queue_finish(queue, status == SPI_DRIVER_DONE);
+  }
+  queue->running = false;
+}
+#endif
+
+bool spi_bus_submit(spi_transaction_t *transaction) {
+#if SPI_NUM_BUSES > 0
+  if (transaction == NULL || transaction->config == NULL ||
+      transaction->config->bus >= SPI_NUM_BUSES || transaction->len == 0 ||
+      transaction->len > SPI_MAX_TRANSFER_SIZE ||
+      spi_queue_is_pending(transaction))
+    return false;
+
+  const uint8_t bus = transaction->config->bus;
+  spi_queue_t *queue = &spi_queues[bus];
+
+  spi_driver_mask_irq(bus, true);
+  spi_queue_append(queue, transaction);
+  if (!queue->running)
+    spi_queue_advance(bus);
+  spi_driver_mask_irq(bus, false);
+
+  return true;
+#else
+  (void)transaction;
+  return false;
+#endif
+}
+
+bool spi_bus_busy(uint8_t bus) {
+#if SPI_NUM_BUSES > 0
+  return bus < SPI_NUM_BUSES && spi_queues[bus].head != NULL;
+#else
+  (void)bus;
+  return false;
+#endif
+}
+
+bool spi_bus_transfer(const spi_bus_config_t *config, const uint8_t *tx,
+                      uint8_t *rx, size_t len) {
+  spi_transaction_t transaction = {
+      .config = config,
+      .tx = tx,
+      .rx = rx,
+      .len = len,
+  };
+
+  if (len == 0)
+    return true;
+  if (!spi_bus_submit(&transaction))
+    return false;
+
+  while (spi_queue_is_pending(&transaction))
+    ;
+
+  return transaction.state == SPI_TRANSACTION_DONE;
+}
+
+void spi_queue_complete(uint8_t bus, bool success) {
+#if SPI_NUM_BUSES > 0
+  if (bus >= SPI_NUM_BUSES || spi_queues[bus].head == NULL)
+    return;
+
+  spi_queue_finish(&spi_queues[bus], success);
+  spi_queue_advance(bus);
+#else
+  (void)bus;
+  (void)success;
+#endif
+}
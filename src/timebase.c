@@ -0,0 +1,61 @@
+/*
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "timebase.h"
+
+#include "hardware/hardware.h"
+
+// Number of cycle counter wraps seen by `timebase_update()`
+static volatile uint32_t timebase_wraps;
+// Cycle count at the last update
+static volatile uint32_t timebase_last_cycles;
+
+void timebase_init(void) {
+  timebase_wraps = 0;
+  timebase_last_cycles = board_cycle_count();
+}
+
+void timebase_update(void) {
+  const uint32_t cycles = board_cycle_count();
+
+  if (cycles < timebase_last_cycles)
+    timebase_wraps++;
+  timebase_last_cycles = cycles;
+}
+
+uint64_t timebase_read_cycles(void) {
+  uint32_t wraps;
+  uint32_t last_cycles;
+  uint32_t cycles;
+
+  // Read again if an update interrupted the reads, so that the cycle count is
+  // read after the update it is compared against
+  do {
+    wraps = timebase_wraps;
+    last_cycles = timebase_last_cycles;
+    cycles = board_cycle_count();
+  } while (wraps != timebase_wraps || last_cycles != timebase_last_cycles);
+
+  // The counter has wrapped since the last update
+  if (cycles < last_cycles)
+    wraps++;
+
+  return (uint64_t)wraps << 32 | cycles;
+}
+
+uint64_t timebase_read_us(void) {
+  return timebase_read_cycles() / TIMEBASE_CYCLES_PER_US;
+}
@@ -15,9 +15,11 @@
 
 #include "usb_runtime.h"
 
+#include "eeconfig.h"
 #include "hardware/timer_api.h"
 #include "hid.h"
 #include "tusb.h"
+#include "wear_leveling.h"
 #include "xinput.h"
 
 #define USB_RESUME_RECOVERY_THRESHOLD_MS 5000u
@@ -28,6 +30,7 @@ typedef struct {
   bool recovery_attempted;
   bool reconnect_pending;
   bool disconnected;
+  bool flush_pending;
   uint32_t suspend_start_ms;
   uint32_t disconnect_start_ms;
 } usb_runtime_state_t;
@@ -54,9 +57,19 @@ void usb_runtime_init(void) {
   usb_runtime_state.recovery_attempted = false;
   usb_runtime_state.reconnect_pending = false;
   usb_runtime_state.disconnected = false;
+  usb_runtime_state.flush_pending = false;
 }
 
 void usb_runtime_task(void) {
+  if (usb_runtime_state.flush_pending) {
+    // The host may remove the power while suspended, so persist the settings
+    // held in the wear leveling cache, including a profile switch that has
+    // not been saved yet
+    usb_runtime_state.flush_pending = false;
+    (void)eeconfig_save_current_profile();
+    (void)wear_leveling_flush();
+  }
+
   usb_runtime_schedule_reconnect_if_needed();
 
   if (usb_runtime_state.suspend_observed && !tud_suspended()) {
@@ -97,6 +110,7 @@ void usb_runtime_mount(void) {
 void usb_runtime_suspend(void) {
   usb_runtime_state.suspend_observed = true;
   usb_runtime_state.recovery_attempted = false;
+  usb_runtime_state.flush_pending = true;
   usb_runtime_state.suspend_start_ms = timer_read();
 }
 
@@ -18,220 +18,1039 @@
 #include "crc32.h"
 #include "hardware/hardware.h"
 
+#if !defined(WL_CONSOLIDATE_WORDS_PER_STEP)
+// Maximum number of words programmed or compared per consolidation step
+#define WL_CONSOLIDATE_WORDS_PER_STEP 32
+#endif
+
+_Static_assert(WL_CONSOLIDATE_WORDS_PER_STEP > 0,
+               "WL_CONSOLIDATE_WORDS_PER_STEP must be positive.");
+
+#if !defined(WL_VERIFY_BYTES_PER_STEP)
+// Maximum number of bytes of the active bank checked per verification step
+#define WL_VERIFY_BYTES_PER_STEP 256
+#endif
+
+_Static_assert(WL_VERIFY_BYTES_PER_STEP > 0 &&
+                   WL_VERIFY_BYTES_PER_STEP % 4 == 0,
+               "WL_VERIFY_BYTES_PER_STEP must be a positive number of words.");
+
+// Banks written before `WL_LOG_FORMAT` was introduced have no format word, and
+// their write log of `wl_legacy_log_entry_t` entries starts in its place
+#define WL_LEGACY_WRITE_LOG_START (WL_HEADER_FORMAT)
+
+// Stores written before the banks were introduced consist of a single bank at
+// the end of the flash, whose header is only the CRC32 checksum of the data
+#define WL_SINGLE_BANK_HEADER_CHECKSUM (WL_VIRTUAL_SIZE)
+#define WL_SINGLE_BANK_WRITE_LOG_START (WL_VIRTUAL_SIZE + 4)
+
 typedef enum {
   WL_STATUS_FAILED = 0,
   WL_STATUS_OK,
-  // Same as WL_STATUS_OK, but the backing store was consolidated while
-  // performing the operation
+  // Same as WL_STATUS_OK, but the write log is full and a consolidation has
+  // been started which persists the rest of the operation from the cache
   WL_STATUS_CONSOLIDATED,
 } wear_leveling_status_t;
 
-uint8_t wl_cache[WL_VIRTUAL_SIZE];
+typedef enum {
+  // The consolidated data of the active bank is known to match its checksum
+  WL_VERIFY_NONE = 0,
+  // The cache was loaded from the active bank, which has no checkpoint yet
+  WL_VERIFY_LOADED,
+  // The active bank has just been committed from the cache
+  WL_VERIFY_COMMITTED,
+} wear_leveling_verify_state_t;
+
+typedef enum {
+  WL_CONSOLIDATE_IDLE = 0,
+  // Erasing one sector of the idle bank per step
+  WL_CONSOLIDATE_ERASE,
+  // Programming the cache a few words per step, then committing the bank
+  WL_CONSOLIDATE_PROGRAM,
+  // Logging the cache bytes that changed behind the programming cursor
+  WL_CONSOLIDATE_RECONCILE,
+} wear_leveling_consolidate_state_t;
+
+uint8_t wl_cache[WL_CACHE_SIZE];
+#if defined(WL_XIP_ENABLED)
+// A consolidation is started once fewer overlay pages than this are free
+#define WL_OVERLAY_LOW_PAGES (WL_OVERLAY_NUM_PAGES / 4 + 1)
+
+// Pages past the cache written since the active bank was committed
+static uint8_t wl_overlay[WL_OVERLAY_NUM_PAGES][WL_OVERLAY_PAGE_SIZE];
+// Virtual address of the page held by each overlay slot, or `WL_VIRTUAL_SIZE`
+// if the slot is free
+static uint32_t wl_overlay_pages[WL_OVERLAY_NUM_PAGES];
+static uint32_t wl_overlay_free;
+// Consolidated data of the active bank, or NULL if the virtual storage has
+// been cleared since it was committed
+static const uint8_t *wl_image;
+// A page of flash empty values, read in place of a cleared virtual storage
+static uint32_t wl_empty_page[WL_OVERLAY_PAGE_SIZE / 4];
+// Whether the write log being replayed covers more pages than the overlay
+static bool wl_replay_overflow;
+#else
+// CRC32 of the cache, kept up to date as it changes once valid
+static uint32_t wl_cache_checksum;
+static bool wl_cache_checksum_valid;
+#endif
 
-static uint32_t starting_sector;
-static uint32_t base_address;
+static struct {
+  // First flash sector of the bank
+  uint32_t sector;
+  // Flash address of the bank
+  uint32_t address;
+} wl_banks[WL_NUM_BANKS];
+
+// Bank holding the consolidated data and the write log
+static uint32_t active_bank;
+// Sequence number of the active bank, or 0 if no bank has been committed
+static uint32_t active_sequence;
+// Checksum in the header of the active bank
+static uint32_t active_checksum;
+static wear_leveling_verify_state_t verify_state;
 static uint32_t write_address;
+// Whether the virtual storage has been reloaded since the last task call
+static bool wl_reloaded;
+
+static struct {
+  // Next virtual address of the active bank to check
+  uint32_t next;
+  // CRC32 of the data checked so far, followed by zeros up to the end of the
+  // virtual storage
+  uint32_t checksum;
+  // Whether the data could be mapped so far
+  bool readable;
+} wl_verify;
+
+static struct {
+  wear_leveling_consolidate_state_t state;
+  // Next sector to erase, or next virtual address to program or reconcile
+  uint32_t next;
+  // Whether a write changed an already programmed part of the cache
+  bool held;
+  // CRC32 of the data being programmed: the cache when the programming
+  // started, with the changes made since then ahead of the cursor
+  uint32_t checksum;
+} wl_consolidation;
+
+static struct {
+  // Byte ranges [start, end) of the cache that have not been logged yet. They
+  // neither overlap nor touch each other.
+  struct {
+    uint32_t start;
+    uint32_t end;
+  } ranges[WL_WRITE_BACK_MAX_RANGES];
+  uint32_t num_ranges;
+  // Time of the last write
+  uint32_t last_write;
+} wl_write_back;
+
+__attribute__((always_inline)) static inline bool
+wear_leveling_flash_read(uint32_t addr, void *buf, uint32_t len) {
+  return flash_read(wl_banks[active_bank].address + addr, buf, len);
+}
+
+__attribute__((always_inline)) static inline bool
+wear_leveling_flash_write(uint32_t addr, const void *buf, uint32_t len) {
+  return flash_write(wl_banks[active_bank].address + addr, buf, len);
+}
+
+__attribute__((always_inline)) static inline uint32_t
+wear_leveling_idle_bank(void) {
+  return (active_bank + 1) % WL_NUM_BANKS;
+}
+
+__attribute__((always_inline)) static inline uint32_t
+wear_leveling_bank_end_sector(uint32_t bank) {
+  return bank + 1 < WL_NUM_BANKS ? wl_banks[bank + 1].sector
+                                 : FLASH_NUM_SECTORS;
+}
+
+__attribute__((always_inline)) static inline bool
+wear_leveling_sequence_newer(uint32_t a, uint32_t b) {
+  // Serial number arithmetic so the sequence number can wrap around
+  return (int32_t)(a - b) > 0;
+}
+
+#if defined(WL_XIP_ENABLED)
+static void wear_leveling_overlay_clear(void) {
+  for (uint32_t i = 0; i < WL_OVERLAY_NUM_PAGES; i++)
+    wl_overlay_pages[i] = WL_VIRTUAL_SIZE;
+  wl_overlay_free = WL_OVERLAY_NUM_PAGES;
+}
+
+/**
+ * @brief Get the consolidated data of a page
+ *
+ * @param page Virtual address of the page
+ *
+ * @return Pointer to the `WL_OVERLAY_PAGE_SIZE` bytes of the page
+ */
+static const uint8_t *wear_leveling_image_page(uint32_t page) {
+  return wl_image != NULL ? wl_image + page : (const uint8_t *)wl_empty_page;
+}
 
 /**
- * @brief Erase the flash memory used by the wear leveling module
+ * @brief Get the RAM copy of a page, loading it into the overlay if needed
+ *
+ * @param page Virtual address of the page
+ * @param load Whether to load the page if it is not in RAM
  *
- * @return true if the erase was successful, false otherwise
+ * @return Pointer to the copy, or NULL if the page is not in RAM and cannot be
+ * loaded
  */
-__attribute__((always_inline)) static inline bool
-wear_leveling_flash_erase(void) {
-  for (uint32_t i = starting_sector; i < FLASH_NUM_SECTORS; i++) {
-    if (!flash_erase(i))
-      return false;
+static uint8_t *wear_leveling_ram_page(uint32_t page, bool load) {
+  if (page < WL_CACHE_SIZE)
+    return wl_cache + page;
+
+  uint32_t free_slot = WL_OVERLAY_NUM_PAGES;
+  for (uint32_t i = 0; i < WL_OVERLAY_NUM_PAGES; i++) {
+    if (wl_overlay_pages[i] == page)
+      return wl_overlay[i];
+    if (wl_overlay_pages[i] == WL_VIRTUAL_SIZE)
+      free_slot = i;
   }
+  if (!load || free_slot == WL_OVERLAY_NUM_PAGES)
+    return NULL;
 
-  return true;
+  wl_overlay_pages[free_slot] = page;
+  wl_overlay_free--;
+  memcpy(wl_overlay[free_slot], wear_leveling_image_page(page),
+         WL_OVERLAY_PAGE_SIZE);
+  return wl_overlay[free_slot];
 }
 
-__attribute__((always_inline)) static inline bool
-wear_leveling_flash_read(uint32_t addr, void *buf, uint32_t len) {
-  return flash_read(base_address + addr, buf, len);
+/**
+ * @brief Get the current data of the virtual storage at an address
+ *
+ * @param addr Address to get the data of
+ *
+ * @return Pointer to the data, valid up to the end of the page
+ */
+static const uint8_t *wear_leveling_data(uint32_t addr) {
+  const uint32_t offset = addr % WL_OVERLAY_PAGE_SIZE;
+  const uint8_t *ram = wear_leveling_ram_page(addr - offset, false);
+
+  return (ram != NULL ? ram : wear_leveling_image_page(addr - offset)) + offset;
 }
 
-__attribute__((always_inline)) static inline bool
-wear_leveling_flash_write(uint32_t addr, const void *buf, uint32_t len) {
-  return flash_write(base_address + addr, buf, len);
+/**
+ * @brief Copy the current data of the virtual storage, page by page
+ *
+ * @param addr Address to copy from
+ * @param buf Buffer to copy into
+ * @param len Length of the data in bytes
+ *
+ * @return None
+ */
+static void wear_leveling_copy(uint32_t addr, void *buf, uint32_t len) {
+  uint8_t *buf8 = buf;
+
+  while (len > 0) {
+    const uint32_t n = M_MIN(len, WL_OVERLAY_PAGE_SIZE -
+                                      addr % WL_OVERLAY_PAGE_SIZE);
+
+    memcpy(buf8, wear_leveling_data(addr), n);
+    addr += n;
+    buf8 += n;
+    len -= n;
+  }
 }
 
+// Current byte of the virtual storage at an address
+#define WL_CURRENT_BYTE(addr) (*wear_leveling_data(addr))
+#else
+#define WL_CURRENT_BYTE(addr) (wl_cache[addr])
+#endif
+
 static void wear_leveling_clear_cache(void) {
   // Fill the cache with flash empty values
   uint32_t *wl_cache32 = (uint32_t *)wl_cache;
-  for (uint32_t i = 0; i < WL_VIRTUAL_SIZE / 4; i++)
+  for (uint32_t i = 0; i < WL_CACHE_SIZE / 4; i++)
     wl_cache32[i] = FLASH_EMPTY_VAL;
-  // Skip the first 4 bytes reserved for CRC32 checksum of the consolidated data
-  write_address = WL_VIRTUAL_SIZE + 4;
+#if defined(WL_XIP_ENABLED)
+  // The rest of the virtual storage reads as empty until a bank is committed
+  wl_image = NULL;
+  wear_leveling_overlay_clear();
+#else
+  wl_cache_checksum_valid = false;
+#endif
+}
+
+#if defined(WL_XIP_ENABLED)
+static bool wear_leveling_flush_overlay(void);
+#endif
+
+/**
+ * @brief Copy data into the cache and update its checksum
+ *
+ * With execute-in-place, the pages past the cache are loaded into the overlay
+ * instead. If it is full, the virtual storage is consolidated first.
+ *
+ * @param addr Address to copy to
+ * @param buf Buffer to copy from
+ * @param len Length of the data in bytes
+ *
+ * @return true if successful, false otherwise
+ */
+static bool wear_leveling_update_cache(uint32_t addr, const void *buf,
+                                       uint32_t len) {
+#if defined(WL_XIP_ENABLED)
+  const uint8_t *buf8 = buf;
+
+  while (len > 0) {
+    const uint32_t offset = addr % WL_OVERLAY_PAGE_SIZE;
+    const uint32_t n = M_MIN(len, WL_OVERLAY_PAGE_SIZE - offset);
+    uint8_t *ram = wear_leveling_ram_page(addr - offset, true);
+
+    if (ram == NULL &&
+        (!wear_leveling_flush_overlay() ||
+         (ram = wear_leveling_ram_page(addr - offset, true)) == NULL))
+      return false;
+    memcpy(ram + offset, buf8, n);
+    addr += n;
+    buf8 += n;
+    len -= n;
+  }
+#else
+  if (wl_cache_checksum_valid)
+    wl_cache_checksum = crc32_update_range(wl_cache_checksum, WL_VIRTUAL_SIZE,
+                                           addr, wl_cache + addr, buf, len);
+  memcpy(wl_cache + addr, buf, len);
+#endif
+
+  return true;
+}
+
+/**
+ * @brief Compute the checksum of the consolidated data of a bank
+ *
+ * The sequence number is folded into the CRC32 checksum so a partially
+ * programmed sequence number does not commit the bank.
+ *
+ * @param bank Bank to compute the checksum of
+ * @param sequence Sequence number of the bank
+ * @param checksum Output checksum
+ *
+ * @return true if successful, false otherwise
+ */
+static bool wear_leveling_bank_checksum(uint32_t bank, uint32_t sequence,
+                                        uint32_t *checksum) {
+  const void *image = flash_map(wl_banks[bank].address, WL_VIRTUAL_SIZE / 4);
+  if (image == NULL)
+    return false;
+
+  *checksum = crc32_compute(image, WL_VIRTUAL_SIZE, 0) ^ sequence;
+  return true;
+}
+
+/**
+ * @brief Get the sequence number of a committed bank
+ *
+ * The consolidated data of a bank in the current format is not checked
+ * against the checksum here. Since the sequence number is programmed last, the
+ * bank has been fully programmed, and its data is checked by
+ * `wear_leveling_verify()` later. Banks in an older format are checked right
+ * away, which also tells them apart from a single-bank store. So are retired
+ * banks, which are only fallen back to once the newer data is corrupted.
+ *
+ * @param bank Bank to check
+ * @param retired Whether to look for a retired bank instead
+ * @param sequence Output sequence number
+ *
+ * @return true if the bank is committed, retired as requested and, unless it
+ * is in the current format and not retired, intact, false otherwise
+ */
+static bool wear_leveling_bank_sequence(uint32_t bank, bool retired,
+                                        uint32_t *sequence) {
+  uint32_t header[4];
+  uint32_t checksum;
+
+  if (!flash_read(wl_banks[bank].address + WL_HEADER_SEQUENCE, header, 4))
+    return false;
+
+  const uint32_t seq = header[0];
+  if (seq == 0 || seq == FLASH_EMPTY_VAL ||
+      (header[2] != FLASH_EMPTY_VAL) != retired)
+    return false;
+
+  if ((retired || header[3] != WL_LOG_FORMAT) &&
+      (!wear_leveling_bank_checksum(bank, seq, &checksum) ||
+       checksum != header[1]))
+    return false;
+
+  *sequence = seq;
+  return true;
+}
+
+/**
+ * @brief Start checking the consolidated data of the active bank
+ *
+ * @param state Verification state
+ *
+ * @return None
+ */
+static void wear_leveling_verify_begin(wear_leveling_verify_state_t state) {
+  verify_state = state;
+  wl_verify.next = 0;
+  wl_verify.checksum = crc32_compute_zeros(WL_VIRTUAL_SIZE, 0);
+  wl_verify.readable = true;
 }
 
 /**
  * @brief Update the cache with the consolidated data
  *
- * This function clears the cache if the consolidated data is corrupted.
+ * The newest committed bank becomes the active bank, and its data remains to
+ * be verified. If there is none, the newest intact retired bank is fallen back
+ * to, and then a single-bank store is accepted with an active sequence number
+ * of 0 once verified. This function clears the cache if no bank holds
+ * consolidated data.
+ *
+ * @param log_start Output address of the first write log entry, which is
+ * `WL_WRITE_LOG_START` unless the store has to be migrated
  *
  * @return Wear leveling status
  */
-static wear_leveling_status_t wear_leveling_read_consolidated(void) {
-  wear_leveling_status_t status = WL_STATUS_OK;
+static wear_leveling_status_t
+wear_leveling_read_consolidated(uint32_t *log_start) {
+  bool found = false, retired = false;
+
+  active_bank = WL_NUM_BANKS - 1;
+  active_sequence = 0;
+  // Retired banks are only looked for if there is no committed bank
+  for (uint32_t pass = 0; pass < 2 && !found; pass++) {
+    retired = pass > 0;
+    for (uint32_t i = 0; i < WL_NUM_BANKS; i++) {
+      uint32_t sequence;
+      if (!wear_leveling_bank_sequence(i, retired, &sequence))
+        continue;
 
-  // Read the consolidated data from flash
-  if (!wear_leveling_flash_read(0, wl_cache, WL_VIRTUAL_SIZE / 4))
-    status = WL_STATUS_FAILED;
+      if (!found || wear_leveling_sequence_newer(sequence, active_sequence)) {
+        active_bank = i;
+        active_sequence = sequence;
+      }
+      found = true;
+    }
+  }
 
-  if (status != WL_STATUS_FAILED) {
-    // Check the CRC32 checksum
-    const uint32_t expected = crc32_compute(wl_cache, WL_VIRTUAL_SIZE, 0);
-    uint32_t actual;
+  // The checksum is reused as the checksum of the cache
+  uint32_t checksum;
+  if (found) {
+    uint32_t format;
 
-    if (!wear_leveling_flash_read(WL_VIRTUAL_SIZE, &actual, 1) ||
-        actual != expected)
-      status = WL_STATUS_FAILED;
+    found = wear_leveling_flash_read(WL_HEADER_CHECKSUM, &active_checksum, 1) &&
+            wear_leveling_flash_read(WL_HEADER_FORMAT, &format, 1);
+    checksum = active_checksum ^ active_sequence;
+    if (format == WL_LOG_FORMAT) {
+      if (!retired)
+        wear_leveling_verify_begin(WL_VERIFY_LOADED);
+      *log_start = WL_WRITE_LOG_START;
+    } else
+      *log_start = WL_LEGACY_WRITE_LOG_START;
+  } else {
+    const void *image =
+        flash_map(wl_banks[active_bank].address, WL_VIRTUAL_SIZE / 4);
+
+    found = image != NULL &&
+            wear_leveling_flash_read(WL_SINGLE_BANK_HEADER_CHECKSUM, &checksum,
+                                     1) &&
+            checksum == crc32_compute(image, WL_VIRTUAL_SIZE, 0);
+    *log_start = WL_SINGLE_BANK_WRITE_LOG_START;
   }
 
-  if (status == WL_STATUS_FAILED)
-    // Clear the cache if the consolidated data is corrupted
-    wear_leveling_clear_cache();
+#if defined(WL_XIP_ENABLED)
+  // The rest of the consolidated data is read in place
+  wear_leveling_overlay_clear();
+  wl_image = found ? flash_map(wl_banks[active_bank].address,
+                               WL_VIRTUAL_SIZE / 4)
+                   : NULL;
+  if (wl_image != NULL) {
+    memcpy(wl_cache, wl_image, WL_CACHE_SIZE);
+    return WL_STATUS_OK;
+  }
+#else
+  if (found && wear_leveling_flash_read(0, wl_cache, WL_VIRTUAL_SIZE / 4)) {
+    wl_cache_checksum = checksum;
+    wl_cache_checksum_valid = true;
+    return WL_STATUS_OK;
+  }
+#endif
 
-  return status;
+  // Clear the cache if the consolidated data is corrupted
+  wear_leveling_clear_cache();
+  verify_state = WL_VERIFY_NONE;
+  return WL_STATUS_FAILED;
 }
 
 /**
- * @brief Consolidate the cache with the flash memory
+ * @brief Append a checkpoint for the active bank to the write log
  *
- * This function writes the cache to flash and updates the CRC32 checksum.
- * The flash memory must be erased before calling this function.
+ * The next boots skip the verification of the bank. Nothing is appended if
+ * the write log is full.
  *
- * @return Wear leveling status
+ * @return None
+ */
+static void wear_leveling_append_checkpoint(void) {
+  const uint32_t checkpoint[WL_LOG_CHECKPOINT_NUM_WORDS] = {WL_LOG_CHECKPOINT,
+                                                            active_checksum};
+
+  if (write_address + sizeof(checkpoint) > WL_BACKING_STORE_SIZE)
+    return;
+
+  if (wear_leveling_flash_write(write_address, checkpoint,
+                                WL_LOG_CHECKPOINT_NUM_WORDS))
+    write_address += sizeof(checkpoint);
+  else
+    // Do not append anything after a partially programmed checkpoint
+    write_address = WL_BACKING_STORE_SIZE;
+}
+
+static void wear_leveling_consolidate_start(void);
+
+static void wear_leveling_load(void);
+
+/**
+ * @brief Check the next `WL_VERIFY_BYTES_PER_STEP` bytes of the consolidated
+ * data of the active bank
+ *
+ * The CRC32 computed so far is updated as if the bytes changed from zeros, so
+ * the data is checked in bounded steps even with a CRC unit that cannot
+ * continue a previous computation.
+ *
+ * @return true if the whole data has been checked, false otherwise
+ */
+static bool wear_leveling_verify_step(void) {
+  static const uint8_t zeros[WL_VERIFY_BYTES_PER_STEP] = {0};
+
+  if (wl_verify.next >= WL_VIRTUAL_SIZE)
+    return true;
+
+  const uint32_t len =
+      M_MIN(WL_VIRTUAL_SIZE - wl_verify.next, WL_VERIFY_BYTES_PER_STEP);
+  const void *data =
+      flash_map(wl_banks[active_bank].address + wl_verify.next, len / 4);
+  if (data != NULL)
+    wl_verify.checksum =
+        crc32_update_range(wl_verify.checksum, WL_VIRTUAL_SIZE, wl_verify.next,
+                           zeros, data, len);
+  else
+    wl_verify.readable = false;
+  wl_verify.next += len;
+
+  return wl_verify.next >= WL_VIRTUAL_SIZE;
+}
+
+/**
+ * @brief Finish checking the consolidated data of the active bank against its
+ * checksum and recover if it is corrupted
+ *
+ * A bank committed from the cache is programmed again. A bank loaded at boot
+ * is retired, and the virtual storage is loaded again in place from the newest
+ * intact data: the other bank, even if retired, or a cleared store.
+ *
+ * @return true if the data matches the checksum, false otherwise
  */
-static wear_leveling_status_t wear_leveling_write_consolidated(void) {
-  wear_leveling_status_t status = WL_STATUS_CONSOLIDATED;
+static bool wear_leveling_verify(void) {
+  const wear_leveling_verify_state_t state = verify_state;
 
-  // Write the cache to flash
-  if (!wear_leveling_flash_write(0, wl_cache, WL_VIRTUAL_SIZE / 4))
-    status = WL_STATUS_FAILED;
+  while (!wear_leveling_verify_step())
+    ;
 
-  if (status != WL_STATUS_FAILED) {
-    // Write the CRC32 checksum
-    const uint32_t checksum = crc32_compute(wl_cache, WL_VIRTUAL_SIZE, 0);
+  verify_state = WL_VERIFY_NONE;
+  if (wl_verify.readable &&
+      (wl_verify.checksum ^ active_sequence) == active_checksum)
+    return true;
 
-    if (!wear_leveling_flash_write(WL_VIRTUAL_SIZE, &checksum, 1))
-      status = WL_STATUS_FAILED;
+  if (state == WL_VERIFY_COMMITTED) {
+    // The cache still holds the data, so program it again
+    wear_leveling_consolidate_start();
+    return false;
   }
 
-  return status;
+  const uint32_t retired = 0;
+  (void)wear_leveling_flash_write(WL_HEADER_RETIRED, &retired, 1);
+  wear_leveling_load();
+  wl_reloaded = true;
+  return false;
 }
 
-static wear_leveling_status_t wear_leveling_consolidate_force(void) {
-  if (!wear_leveling_flash_erase())
-    return WL_STATUS_FAILED;
+static void wear_leveling_consolidate_start(void) {
+  while (verify_state == WL_VERIFY_LOADED)
+    // Make sure the cache does not hold corrupted data before programming it.
+    // Each failure retires a bank, until intact data or a cleared store.
+    (void)wear_leveling_verify();
+  // The active bank is superseded anyway
+  verify_state = WL_VERIFY_NONE;
 
-  const wear_leveling_status_t status = wear_leveling_write_consolidated();
-  write_address = WL_VIRTUAL_SIZE + 4;
+  if (wl_consolidation.state == WL_CONSOLIDATE_ERASE)
+    // Nothing has been programmed yet so the erase can simply go on
+    return;
 
-  return status;
+  wl_consolidation.state = WL_CONSOLIDATE_ERASE;
+  wl_consolidation.next = wl_banks[wear_leveling_idle_bank()].sector;
+  wl_consolidation.held = false;
+  // The whole cache is programmed, including the changes not logged yet
+  wl_write_back.num_ranges = 0;
 }
 
-static wear_leveling_status_t wear_leveling_consolidate_if_needed(void) {
-  if (write_address >= WL_BACKING_STORE_SIZE)
-    // Consolidate the cache if the write log is full
-    return wear_leveling_consolidate_force();
+/**
+ * @brief Commit the idle bank and make it the active bank
+ *
+ * The checksum and the write log format are programmed first and the sequence
+ * number last, so the bank is committed by a single word. The previous bank
+ * stays intact until then and is only retired afterwards.
+ *
+ * @return Wear leveling status
+ */
+static wear_leveling_status_t wear_leveling_commit(void) {
+  const uint32_t bank = wear_leveling_idle_bank();
+  const uint32_t previous_bank = active_bank;
+  const bool retire = active_sequence != 0;
+  const uint32_t format = WL_LOG_FORMAT;
+  uint32_t sequence = active_sequence + 1;
+
+  if (sequence == 0 || sequence == FLASH_EMPTY_VAL)
+    sequence = 1;
+
+  // The checksum covers the data as programmed, which may already be older
+  // than the cache if writes were held in the meantime
+  const uint32_t checksum = wl_consolidation.checksum ^ sequence;
+  if (!flash_write(wl_banks[bank].address + WL_HEADER_CHECKSUM, &checksum,
+                   1) ||
+      !flash_write(wl_banks[bank].address + WL_HEADER_FORMAT, &format, 1) ||
+      !flash_write(wl_banks[bank].address + WL_HEADER_SEQUENCE, &sequence, 1))
+    return WL_STATUS_FAILED;
+
+  active_bank = bank;
+  active_sequence = sequence;
+  active_checksum = checksum;
+#if defined(WL_XIP_ENABLED)
+  // The data has been checked as it was programmed
+  verify_state = WL_VERIFY_NONE;
+  wl_image = flash_map(wl_banks[bank].address, WL_VIRTUAL_SIZE / 4);
+#else
+  wear_leveling_verify_begin(WL_VERIFY_COMMITTED);
+#endif
+  write_address = WL_WRITE_LOG_START;
 
+  const uint32_t retired = 0;
+  if (retire && !flash_write(wl_banks[previous_bank].address +
+                                 WL_HEADER_RETIRED,
+                             &retired, 1))
+    return WL_STATUS_FAILED;
+
+#if defined(WL_XIP_ENABLED)
+  wear_leveling_append_checkpoint();
+#endif
   return WL_STATUS_OK;
 }
 
+static wear_leveling_status_t
+wear_leveling_write_raw(uint32_t addr, const void *buf, uint32_t len);
+
 /**
- * @brief Replay the write log
+ * @brief Perform one bounded step of the consolidation
  *
- * This function replays the write log to update the cache with the latest
- * changes. The cache must be consolidated before calling this function.
+ * The consolidation erases the idle bank one sector at a time, programs the
+ * cache into it a few words at a time, commits it, and finally logs whatever
+ * changed in the cache after it was programmed. Writes made in the meantime
+ * only update the cache.
  *
  * @return Wear leveling status
  */
-static wear_leveling_status_t wear_leveling_replay_log(void) {
-  wear_leveling_status_t status = WL_STATUS_OK;
-  uint32_t addr = WL_VIRTUAL_SIZE + 4;
+static wear_leveling_status_t wear_leveling_consolidate_step(void) {
+  switch (wl_consolidation.state) {
+  case WL_CONSOLIDATE_ERASE:
+    if (!flash_erase(wl_consolidation.next))
+      return WL_STATUS_FAILED;
+
+    if (++wl_consolidation.next >=
+        wear_leveling_bank_end_sector(wear_leveling_idle_bank())) {
+      wl_consolidation.state = WL_CONSOLIDATE_PROGRAM;
+      wl_consolidation.next = 0;
+#if !defined(WL_XIP_ENABLED)
+      if (!wl_cache_checksum_valid) {
+        wl_cache_checksum = crc32_compute(wl_cache, WL_VIRTUAL_SIZE, 0);
+        wl_cache_checksum_valid = true;
+      }
+      wl_consolidation.checksum = wl_cache_checksum;
+#endif
+    }
+    break;
+
+  case WL_CONSOLIDATE_PROGRAM: {
+    const uint32_t bank = wear_leveling_idle_bank();
 
-  while (addr < WL_BACKING_STORE_SIZE) {
-    uint32_t value;
+    if (wl_consolidation.next < WL_VIRTUAL_SIZE) {
+      const uint32_t addr = wl_banks[bank].address + wl_consolidation.next;
+      const uint32_t len = M_MIN(WL_VIRTUAL_SIZE - wl_consolidation.next,
+                                 WL_CONSOLIDATE_WORDS_PER_STEP * 4);
 
-    if (!wear_leveling_flash_read(addr, &value, 1)) {
-      status = WL_STATUS_FAILED;
+#if defined(WL_XIP_ENABLED)
+      // No checksum of the virtual storage is kept, so the data is checked as
+      // it is programmed instead
+      uint32_t data[WL_CONSOLIDATE_WORDS_PER_STEP];
+      wear_leveling_copy(wl_consolidation.next, data, len);
+      const void *programmed = flash_map(addr, len / 4);
+      if (programmed == NULL || !flash_write(addr, data, len / 4) ||
+          memcmp(programmed, data, len) != 0)
+        return WL_STATUS_FAILED;
+#else
+      if (!flash_write(addr, wl_cache + wl_consolidation.next, len / 4))
+        return WL_STATUS_FAILED;
+#endif
+      wl_consolidation.next += len;
       break;
     }
-    if (value == FLASH_EMPTY_VAL)
+
+#if defined(WL_XIP_ENABLED)
+    if (!wear_leveling_bank_checksum(bank, 0, &wl_consolidation.checksum))
+      return WL_STATUS_FAILED;
+#endif
+    const wear_leveling_status_t status = wear_leveling_commit();
+    if (status != WL_STATUS_OK)
+      return status;
+
+#if defined(WL_XIP_ENABLED)
+    // The overlay is always reconciled, which frees the pages that match the
+    // committed data
+    wl_consolidation.state = WL_CONSOLIDATE_RECONCILE;
+#else
+    wl_consolidation.state = wl_consolidation.held ? WL_CONSOLIDATE_RECONCILE
+                                                   : WL_CONSOLIDATE_IDLE;
+#endif
+    wl_consolidation.next = 0;
+    wl_consolidation.held = false;
+    break;
+  }
+
+  case WL_CONSOLIDATE_RECONCILE: {
+    uint32_t addr = wl_consolidation.next;
+    uint32_t len = M_MIN(WL_CACHE_SIZE - M_MIN(addr, WL_CACHE_SIZE),
+                         WL_CONSOLIDATE_WORDS_PER_STEP * 4);
+    const uint8_t *ram = wl_cache + addr;
+#if defined(WL_XIP_ENABLED)
+    // The cache is reconciled first, then one overlay page per step
+    const uint32_t slot = addr - WL_CACHE_SIZE;
+    if (len > 0)
+      wl_consolidation.next += len;
+    else {
+      addr = wl_overlay_pages[slot];
+      len = addr < WL_VIRTUAL_SIZE ? WL_OVERLAY_PAGE_SIZE : 0;
+      ram = wl_overlay[slot];
+      wl_consolidation.next++;
+    }
+    if (wl_consolidation.next >= WL_CACHE_SIZE + WL_OVERLAY_NUM_PAGES)
+      wl_consolidation.state = WL_CONSOLIDATE_IDLE;
+    if (len == 0)
+      // The overlay slot is free
+      break;
+#else
+    wl_consolidation.next += len;
+    if (wl_consolidation.next >= WL_VIRTUAL_SIZE)
+      wl_consolidation.state = WL_CONSOLIDATE_IDLE;
+#endif
+    const uint8_t *image =
+        flash_map(wl_banks[active_bank].address + addr, len / 4);
+    if (image == NULL)
+      return WL_STATUS_FAILED;
+
+    // Log each run of bytes that differs from the programmed data
+    bool differs = false;
+    for (uint32_t i = 0; i < len;) {
+      if (image[i] == ram[i]) {
+        i++;
+        continue;
+      }
+
+      uint32_t j = i + 1;
+      while (j < len && image[j] != ram[j])
+        j++;
+
+      const wear_leveling_status_t status =
+          wear_leveling_write_raw(addr + i, ram + i, j - i);
+      if (status != WL_STATUS_OK)
+        return status;
+      differs = true;
+      i = j;
+    }
+
+#if defined(WL_XIP_ENABLED)
+    if (!differs && addr >= WL_CACHE_SIZE) {
+      // The page is read in place from now on
+      wl_overlay_pages[slot] = WL_VIRTUAL_SIZE;
+      wl_overlay_free++;
+    }
+#else
+    (void)differs;
+#endif
+    break;
+  }
+
+  default:
+    break;
+  }
+
+  return WL_STATUS_OK;
+}
+
+static void wear_leveling_consolidate_abort(void) {
+  // Start over on the next write. The cache still holds every change, and a
+  // full write log makes the next write consolidate all of it.
+  wl_consolidation.state = WL_CONSOLIDATE_IDLE;
+  write_address = WL_BACKING_STORE_SIZE;
+}
+
+static wear_leveling_status_t wear_leveling_consolidate_force(void) {
+  wear_leveling_consolidate_start();
+
+  return wear_leveling_flush() ? WL_STATUS_CONSOLIDATED : WL_STATUS_FAILED;
+}
+
+// Applies a write log entry of `len` bytes at `addr`
+typedef void (*wear_leveling_apply_t)(uint32_t addr, const uint8_t *data,
+                                      uint32_t len);
+
+/**
+ * @brief Walk the write log of the active bank
+ *
+ * The write log is read through a single mapping of the flash. Checkpoints
+ * are skipped, and end the pending verification of the bank if they match it.
+ *
+ * @param addr Address of the first write log entry. Set to the address past
+ * the last valid entry.
+ * @param legacy Whether the entries are `wl_legacy_log_entry_t`
+ * @param apply Function applying each valid entry
+ *
+ * @return WL_STATUS_OK if the end of the write log has been reached,
+ * WL_STATUS_FAILED if an invalid entry has been found
+ */
+static wear_leveling_status_t
+wear_leveling_walk_log(uint32_t *addr, bool legacy,
+                       wear_leveling_apply_t apply) {
+  const uint32_t start = *addr;
+  const uint32_t *log = flash_map(wl_banks[active_bank].address + start,
+                                  (WL_BACKING_STORE_SIZE - start) / 4);
+  if (log == NULL)
+    return WL_STATUS_FAILED;
+
+  while (*addr < WL_BACKING_STORE_SIZE) {
+    const uint32_t *words = log + (*addr - start) / 4;
+    union {
+      wl_log_entry_t current;
+      wl_legacy_log_entry_t legacy;
+    } entry;
+
+    entry.current.raw[0] = words[0];
+    if (entry.current.raw[0] == FLASH_EMPTY_VAL)
       // No more entries in the write log
       break;
-    addr += 4;
 
-    wl_log_entry_t entry;
-    entry.raw[0] = value;
+    if (!legacy && entry.current.raw[0] == WL_LOG_CHECKPOINT) {
+      if (*addr + WL_LOG_CHECKPOINT_NUM_WORDS * 4 > WL_BACKING_STORE_SIZE)
+        return WL_STATUS_FAILED;
 
-    if (entry.fields.addr + entry.fields.len > WL_VIRTUAL_SIZE) {
+      if (words[1] == active_checksum && verify_state == WL_VERIFY_LOADED)
+        // The bank has been verified on a previous boot
+        verify_state = WL_VERIFY_NONE;
+      *addr += WL_LOG_CHECKPOINT_NUM_WORDS * 4;
+      continue;
+    }
+
+    uint32_t entry_addr, len, num_words;
+    const uint8_t *data;
+    if (legacy) {
+      entry_addr = entry.legacy.fields.addr;
+      len = entry.legacy.fields.len;
+      num_words = len > 2 ? 2 : 1;
+      data = entry.legacy.fields.data;
+    } else {
+      entry_addr = entry.current.fields.addr;
+      len = entry.current.fields.len + 1u;
+      num_words = WL_LOG_ENTRY_NUM_WORDS(len);
+      data = entry.current.fields.data;
+    }
+
+    if (entry_addr + len > WL_VIRTUAL_SIZE ||
+        *addr + num_words * 4 > WL_BACKING_STORE_SIZE)
       // The entry is invalid
-      status = WL_STATUS_FAILED;
+      return WL_STATUS_FAILED;
+
+    // Copy the rest of the data
+    memcpy(&entry.current.raw[1], words + 1, (num_words - 1) * 4);
+    *addr += num_words * 4;
+    apply(entry_addr, data, len);
+  }
+
+  return WL_STATUS_OK;
+}
+
+static void wear_leveling_replay_entry(uint32_t addr, const uint8_t *data,
+                                       uint32_t len) {
+#if defined(WL_XIP_ENABLED)
+  while (len > 0 && !wl_replay_overflow) {
+    const uint32_t offset = addr % WL_OVERLAY_PAGE_SIZE;
+    const uint32_t n = M_MIN(len, WL_OVERLAY_PAGE_SIZE - offset);
+    uint8_t *ram = wear_leveling_ram_page(addr - offset, true);
+
+    if (ram == NULL) {
+      wl_replay_overflow = true;
       break;
     }
+    memcpy(ram + offset, data, n);
+    addr += n;
+    data += n;
+    len -= n;
+  }
+#else
+  // The checksum of the cache is computed once needed rather than updated for
+  // each entry
+  memcpy(wl_cache + addr, data, len);
+  wl_cache_checksum_valid = false;
+#endif
+}
 
-    if (entry.fields.len > 2) {
-      // More data in the second word
-      if (!wear_leveling_flash_read(addr, &entry.raw[1], 1)) {
-        status = WL_STATUS_FAILED;
-        break;
-      }
-      addr += 4;
-    }
+#if defined(WL_XIP_ENABLED)
+// Chunk of the virtual storage composed by `wear_leveling_rebuild()`, in the
+// memory of the overlay
+#define WL_REBUILD_CHUNK_SIZE sizeof(wl_overlay)
+
+static uint32_t wl_rebuild_start;
+
+static void wear_leveling_rebuild_entry(uint32_t addr, const uint8_t *data,
+                                        uint32_t len) {
+  const uint32_t start = M_MAX(addr, wl_rebuild_start);
+  const uint32_t end =
+      M_MIN(addr + len, wl_rebuild_start + WL_REBUILD_CHUNK_SIZE);
+
+  if (start < end)
+    memcpy((uint8_t *)wl_overlay + (start - wl_rebuild_start),
+           data + (start - addr), end - start);
+}
+
+/**
+ * @brief Consolidate the write log without holding the virtual storage in RAM
+ *
+ * This is needed when the write log covers more pages than the overlay holds,
+ * such as a write log of a firmware without execute-in-place. The idle bank
+ * is erased, and each chunk of the virtual storage is composed from the
+ * consolidated data and the entries of the whole write log that cover it, then
+ * programmed. This function blocks until the bank has been committed.
+ *
+ * @param log_start Address of the first write log entry
+ * @param legacy Whether the entries are `wl_legacy_log_entry_t`
+ *
+ * @return Wear leveling status
+ */
+static wear_leveling_status_t wear_leveling_rebuild(uint32_t log_start,
+                                                    bool legacy) {
+  const uint32_t bank = wear_leveling_idle_bank();
+  uint8_t *chunk = (uint8_t *)wl_overlay;
+
+  if (verify_state == WL_VERIFY_LOADED && !wear_leveling_verify())
+    // The virtual storage has been loaded again from intact data instead
+    return WL_STATUS_CONSOLIDATED;
+
+  wear_leveling_overlay_clear();
+  for (uint32_t i = wl_banks[bank].sector;
+       i < wear_leveling_bank_end_sector(bank); i++)
+    if (!flash_erase(i))
+      return WL_STATUS_FAILED;
+
+  for (wl_rebuild_start = 0; wl_rebuild_start < WL_VIRTUAL_SIZE;
+       wl_rebuild_start += WL_REBUILD_CHUNK_SIZE) {
+    const uint32_t addr = wl_banks[bank].address + wl_rebuild_start;
+    const uint32_t len =
+        M_MIN(WL_VIRTUAL_SIZE - wl_rebuild_start, WL_REBUILD_CHUNK_SIZE);
+    uint32_t log_addr = log_start;
 
-    // Update the cache with the entry
-    memcpy(wl_cache + entry.fields.addr, entry.fields.data, entry.fields.len);
+    for (uint32_t i = 0; i < len; i += WL_OVERLAY_PAGE_SIZE)
+      memcpy(chunk + i, wear_leveling_image_page(wl_rebuild_start + i),
+             WL_OVERLAY_PAGE_SIZE);
+    // The entries up to an invalid one are kept, as in a replay
+    (void)wear_leveling_walk_log(&log_addr, legacy,
+                                 wear_leveling_rebuild_entry);
+
+    const void *programmed = flash_map(addr, len / 4);
+    if (programmed == NULL || !flash_write(addr, chunk, len / 4) ||
+        memcmp(programmed, chunk, len) != 0)
+      return WL_STATUS_FAILED;
   }
 
+  if (!wear_leveling_bank_checksum(bank, 0, &wl_consolidation.checksum))
+    return WL_STATUS_FAILED;
+  const wear_leveling_status_t status = wear_leveling_commit();
+  if (status != WL_STATUS_OK)
+    return status;
+
+  wear_leveling_overlay_clear();
+  memcpy(wl_cache, wl_image, WL_CACHE_SIZE);
+  return WL_STATUS_CONSOLIDATED;
+}
+#endif
+
+/**
+ * @brief Replay the write log
+ *
+ * This function replays the write log to update the cache with the latest
+ * changes. The cache must be consolidated before calling this function. With
+ * execute-in-place, the write log is consolidated right away if it covers more
+ * pages than the overlay holds.
+ *
+ * @param addr Address of the first write log entry
+ * @param legacy Whether the entries are `wl_legacy_log_entry_t`
+ *
+ * @return Wear leveling status
+ */
+static wear_leveling_status_t wear_leveling_replay_log(uint32_t addr,
+                                                       bool legacy) {
+#if defined(WL_XIP_ENABLED)
+  const uint32_t start = addr;
+#endif
+  wear_leveling_status_t status =
+      wear_leveling_walk_log(&addr, legacy, wear_leveling_replay_entry);
+
   write_address = addr;
+#if defined(WL_XIP_ENABLED)
+  if (wl_replay_overflow) {
+    wl_replay_overflow = false;
+    return wear_leveling_rebuild(start, legacy);
+  }
+#endif
   if (status == WL_STATUS_FAILED)
     // If the replay failed, we stick with the current cache
     status = wear_leveling_consolidate_force();
-  else
-    // Otherwise, we consolidate the cache if needed
-    status = wear_leveling_consolidate_if_needed();
 
   return status;
 }
 
-static wear_leveling_status_t wear_leveling_append(uint32_t value) {
-  // Append the value to the write log
-  if (!wear_leveling_flash_write(write_address, &value, 1))
-    return WL_STATUS_FAILED;
-  write_address += 4;
-
-  return wear_leveling_consolidate_if_needed();
-}
-
 static wear_leveling_status_t
 wear_leveling_write_raw(uint32_t addr, const void *buf, uint32_t len) {
   const uint8_t *buf8 = buf;
 
   while (len > 0) {
     const uint32_t write_len = M_MIN(len, WL_MAX_BYTES_PER_ENTRY);
-    wl_log_entry_t entry = {0};
+    const uint32_t num_words = WL_LOG_ENTRY_NUM_WORDS(write_len);
+    wl_log_entry_t entry;
 
+    if (write_address + num_words * 4 > WL_BACKING_STORE_SIZE) {
+      // The cache already holds the data, so the consolidation persists the
+      // rest of the write operation
+      wear_leveling_consolidate_start();
+      return WL_STATUS_CONSOLIDATED;
+    }
+
+    // Leave the unused bytes of the last word erased
+    memset(&entry, 0xFF, sizeof(entry));
     entry.fields.addr = addr;
-    entry.fields.len = write_len;
+    entry.fields.len = write_len - 1;
     memcpy(entry.fields.data, buf8, write_len);
 
-    wear_leveling_status_t status = wear_leveling_append(entry.raw[0]);
-    if (status != WL_STATUS_OK)
-      // If we consolidate the cache, the changes have been applied to the
-      // consolidated data so no need to continue the write operation.
-      return status;
-
-    if (write_len > 2) {
-      // More data in the second word
-      status = wear_leveling_append(entry.raw[1]);
-      if (status != WL_STATUS_OK)
-        // Same as above
-        return status;
-    }
+    // Append the entry to the write log
+    if (!wear_leveling_flash_write(write_address, entry.raw, num_words))
+      return WL_STATUS_FAILED;
+    write_address += num_words * 4;
 
     addr += write_len;
     buf8 += write_len;
@@ -242,41 +1061,225 @@ wear_leveling_write_raw(uint32_t addr, const void *buf, uint32_t len) {
 }
 
 void wear_leveling_init(void) {
-  // Find the first sector from the end of the flash that is large enough to
-  // hold the backing store
+  // Reserve the fewest sectors from the end of the flash that are large enough
+  // to hold each bank, the last bank being at the end
   uint32_t reserved_size = 0;
-  for (uint32_t i = FLASH_NUM_SECTORS; i-- > 0;) {
-    reserved_size += flash_sector_size(i);
-    if (reserved_size >= WL_BACKING_STORE_SIZE) {
-      starting_sector = i;
-      break;
-    }
+  uint32_t sector = FLASH_NUM_SECTORS;
+  for (uint32_t i = WL_NUM_BANKS; i-- > 0;) {
+    uint32_t bank_size = 0;
+    while (bank_size < WL_BACKING_STORE_SIZE && sector > 0)
+      bank_size += flash_sector_size(--sector);
+
+    reserved_size += bank_size;
+    wl_banks[i].sector = sector;
+    wl_banks[i].address = FLASH_SIZE - reserved_size;
   }
-  base_address = FLASH_SIZE - reserved_size;
-  wear_leveling_clear_cache();
+#if defined(WL_XIP_ENABLED)
+  for (uint32_t i = 0; i < WL_OVERLAY_PAGE_SIZE / 4; i++)
+    wl_empty_page[i] = FLASH_EMPTY_VAL;
+#endif
 
-  wear_leveling_status_t status = wear_leveling_read_consolidated();
-  if (status != WL_STATUS_FAILED)
-    status = wear_leveling_replay_log();
-  else
-    // If the consolidated data is corrupted, we clear the virtual storage
-    status = wear_leveling_erase();
+  wear_leveling_load();
+}
+
+/**
+ * @brief Load the virtual storage from the banks
+ *
+ * Any pending write and consolidation is dropped.
+ *
+ * @return None
+ */
+static void wear_leveling_load(void) {
+  wl_consolidation.state = WL_CONSOLIDATE_IDLE;
+  wl_write_back.num_ranges = 0;
+  verify_state = WL_VERIFY_NONE;
+#if defined(WL_XIP_ENABLED)
+  wl_replay_overflow = false;
+#endif
+
+  uint32_t log_start;
+  wear_leveling_status_t status = wear_leveling_read_consolidated(&log_start);
+  if (status == WL_STATUS_FAILED)
+    // If no bank holds intact consolidated data, we clear the virtual storage.
+    // The cache has already been cleared.
+    status = wear_leveling_consolidate_force();
+  else if (log_start == WL_WRITE_LOG_START)
+    status = wear_leveling_replay_log(log_start, false);
+  else {
+    // Migrate a store of an older format into a bank of the current format. It
+    // stays readable until then.
+    status = wear_leveling_replay_log(log_start, true);
+    if (status == WL_STATUS_OK)
+      status = wear_leveling_consolidate_force();
+  }
 
   if (status == WL_STATUS_FAILED)
     board_error_handler();
 }
 
+/**
+ * @brief Log the changed byte ranges of the cache
+ *
+ * If the write log fills up, the consolidation started in its place persists
+ * the remaining ranges. If the write log cannot be programmed, a consolidation
+ * is started to persist them instead.
+ *
+ * @return WL_STATUS_CONSOLIDATED if a consolidation persists the ranges,
+ * WL_STATUS_FAILED if they could not be persisted, WL_STATUS_OK otherwise
+ */
+static wear_leveling_status_t wear_leveling_write_back(void) {
+  while (wl_write_back.num_ranges > 0) {
+    const uint32_t i = wl_write_back.num_ranges - 1;
+    const uint32_t start = wl_write_back.ranges[i].start;
+    const uint32_t end = wl_write_back.ranges[i].end;
+
+#if defined(WL_XIP_ENABLED)
+    // The range is logged from the current data, an entry at a time
+    uint8_t data[WL_MAX_BYTES_PER_ENTRY];
+    wear_leveling_status_t status = WL_STATUS_OK;
+    for (uint32_t addr = start; status == WL_STATUS_OK && addr < end;
+         addr += sizeof(data)) {
+      const uint32_t len = M_MIN(end - addr, sizeof(data));
+
+      wear_leveling_copy(addr, data, len);
+      status = wear_leveling_write_raw(addr, data, len);
+    }
+#else
+    const wear_leveling_status_t status =
+        wear_leveling_write_raw(start, wl_cache + start, end - start);
+#endif
+    if (status == WL_STATUS_FAILED) {
+      // The write is only lost if the consolidation could not be started
+      wear_leveling_consolidate_start();
+      return wl_consolidation.state == WL_CONSOLIDATE_ERASE
+                 ? WL_STATUS_CONSOLIDATED
+                 : WL_STATUS_FAILED;
+    }
+    if (status == WL_STATUS_CONSOLIDATED)
+      return status;
+    wl_write_back.num_ranges = i;
+  }
+
+  return WL_STATUS_OK;
+}
+
+/**
+ * @brief Record a changed byte range of the cache
+ *
+ * The range is merged with every range it overlaps or touches, so repeated
+ * writes to the same bytes are logged once.
+ *
+ * @param addr Address of the range
+ * @param len Length of the range in bytes
+ *
+ * @return Wear leveling status
+ */
+static wear_leveling_status_t wear_leveling_mark_dirty(uint32_t addr,
+                                                       uint32_t len) {
+  uint32_t start = addr, end = addr + len;
+
+  for (uint32_t i = 0; i < wl_write_back.num_ranges;) {
+    if (wl_write_back.ranges[i].start > end ||
+        wl_write_back.ranges[i].end < start) {
+      i++;
+      continue;
+    }
+
+    start = M_MIN(start, wl_write_back.ranges[i].start);
+    end = M_MAX(end, wl_write_back.ranges[i].end);
+    wl_write_back.ranges[i] = wl_write_back.ranges[--wl_write_back.num_ranges];
+  }
+
+  wear_leveling_status_t status = WL_STATUS_OK;
+  if (wl_write_back.num_ranges == WL_WRITE_BACK_MAX_RANGES) {
+    // Make room by logging the ranges held so far
+    status = wear_leveling_write_back();
+    if (status != WL_STATUS_OK)
+      // A consolidation, if any, persists this range as well
+      return status;
+  }
+
+  wl_write_back.ranges[wl_write_back.num_ranges].start = start;
+  wl_write_back.ranges[wl_write_back.num_ranges].end = end;
+  wl_write_back.num_ranges++;
+  wl_write_back.last_write = timer_read();
+
+  return status;
+}
+
 bool wear_leveling_erase(void) {
   wear_leveling_clear_cache();
+  // The data of the active bank is not needed anymore
+  verify_state = WL_VERIFY_NONE;
+  // Restart the consolidation even if one is in progress since the data it
+  // has programmed so far is stale. The active bank keeps the previous data
+  // until the cleared storage is committed.
+  wl_consolidation.state = WL_CONSOLIDATE_IDLE;
+  wear_leveling_consolidate_start();
 
-  return wear_leveling_consolidate_force() != WL_STATUS_FAILED;
+  return true;
+}
+
+bool wear_leveling_task(void) {
+  if (wl_consolidation.state != WL_CONSOLIDATE_IDLE) {
+    if (wear_leveling_consolidate_step() == WL_STATUS_FAILED)
+      wear_leveling_consolidate_abort();
+  }
+#if WL_WRITE_BACK_DELAY_MS > 0
+  // The changes are logged even while the active bank is being verified, so
+  // that they do not pile up into a long write back
+  else if (wl_write_back.num_ranges > 0 &&
+           timer_elapsed(wl_write_back.last_write) >= WL_WRITE_BACK_DELAY_MS)
+    (void)wear_leveling_write_back();
+#endif
+  else if (verify_state != WL_VERIFY_NONE) {
+    if (wear_leveling_verify_step() && wear_leveling_verify())
+      wear_leveling_append_checkpoint();
+  }
+
+  const bool reloaded = wl_reloaded;
+  wl_reloaded = false;
+  return reloaded;
+}
+
+#if defined(WL_XIP_ENABLED)
+/**
+ * @brief Consolidate the virtual storage to free the overlay
+ *
+ * Without writes in between, every overlay page matches the committed data,
+ * and is freed once reconciled.
+ *
+ * @return true if successful, false otherwise
+ */
+static bool wear_leveling_flush_overlay(void) {
+  wear_leveling_consolidate_start();
+  return wear_leveling_flush();
+}
+#endif
+
+bool wear_leveling_flush(void) {
+  // If the write back fails, the consolidation it starts persists the changes
+  (void)wear_leveling_write_back();
+
+  while (wl_consolidation.state != WL_CONSOLIDATE_IDLE) {
+    if (wear_leveling_consolidate_step() == WL_STATUS_FAILED) {
+      wear_leveling_consolidate_abort();
+      return false;
+    }
+  }
+
+  return true;
 }
 
 bool wear_leveling_read(uint32_t addr, void *buf, uint32_t len) {
   if (addr + len > WL_VIRTUAL_SIZE)
     return false;
 
+#if defined(WL_XIP_ENABLED)
+  wear_leveling_copy(addr, buf, len);
+#else
   memcpy(buf, wl_cache + addr, len);
+#endif
 
   return true;
 }
@@ -288,25 +1291,60 @@ bool wear_leveling_write(uint32_t addr, const void *buf, uint32_t len) {
   const uint8_t *buf8 = buf;
 
   // Trim the start and end of the buffer
-  while (len > 0 && *buf8 == wl_cache[addr]) {
+  while (len > 0 && *buf8 == WL_CURRENT_BYTE(addr)) {
     buf8++;
     addr++;
     len--;
   }
-  while (len > 0 && buf8[len - 1] == wl_cache[addr + len - 1])
+  while (len > 0 && buf8[len - 1] == WL_CURRENT_BYTE(addr + len - 1))
     len--;
 
   if (len == 0)
     // No need to write anything
     return true;
 
+#if !defined(WL_XIP_ENABLED)
+  if (wl_consolidation.state == WL_CONSOLIDATE_PROGRAM &&
+      addr + len > wl_consolidation.next) {
+    // The part ahead of the programming cursor is programmed with the change
+    const uint32_t start = M_MAX(addr, wl_consolidation.next);
+    wl_consolidation.checksum = crc32_update_range(
+        wl_consolidation.checksum, WL_VIRTUAL_SIZE, start, wl_cache + start,
+        buf8 + (start - addr), addr + len - start);
+  }
+#endif
+
   // Update the cache first so if the cache is consolidated, we don't need to
   // continue the write operation
-  memcpy(wl_cache + addr, buf8, len);
+  if (!wear_leveling_update_cache(addr, buf8, len))
+    return false;
+
+#if defined(WL_XIP_ENABLED)
+  if (wl_consolidation.state == WL_CONSOLIDATE_IDLE &&
+      wl_overlay_free < WL_OVERLAY_LOW_PAGES)
+    // Free the overlay in the background before it fills up
+    wear_leveling_consolidate_start();
+#endif
+
+  switch (wl_consolidation.state) {
+  case WL_CONSOLIDATE_ERASE:
+    // The write is held in the cache and programmed later
+    return true;
 
-  wear_leveling_status_t status = wear_leveling_write_raw(addr, buf8, len);
-  if (status == WL_STATUS_OK)
-    status = wear_leveling_consolidate_if_needed();
+  case WL_CONSOLIDATE_PROGRAM:
+    if (addr < wl_consolidation.next)
+      // Part of the write has already been programmed with the old data, so it
+      // must be logged once the consolidation is done
+      wl_consolidation.held = true;
+    return true;
+
+  default:
+    break;
+  }
+
+  if (wear_leveling_mark_dirty(addr, len) == WL_STATUS_FAILED)
+    return false;
 
-  return status != WL_STATUS_FAILED;
+  return WL_WRITE_BACK_DELAY_MS > 0 ||
+         wear_leveling_write_back() != WL_STATUS_FAILED;
 }
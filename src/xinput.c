@@ -165,7 +165,7 @@ static uint8_t endpoint_out;
 // layout processing is disabled for some keys.
 static bitmap_t key_press_states[BITMAP_SIZE(NUM_KEYS)] = {0};
 static uint16_t button_report;
-static uint32_t button_press_times[16];
+static uint64_t button_press_times[16];
 // Track maximum analog values for analog buttons
 // (2 joysticks * 4 directions + 2 triggers)
 static uint16_t analog_states[10];
@@ -314,7 +314,7 @@ void xinput_reset_runtime_state(void) {
   xinput_sync_key_press_states();
 }
 
-void xinput_process(uint8_t key) {
+void xinput_process(key_index_t key) {
   const key_state_t *k = &key_matrix[key];
   const uint8_t keycode = CURRENT_PROFILE.gamepad_buttons[key];
 
@@ -11,6 +11,8 @@
 key_state_t key_matrix[NUM_KEYS];
 eeconfig_t mock_eeconfig;
 const eeconfig_t *eeconfig = &mock_eeconfig;
+eeconfig_profile_t mock_profile;
+const eeconfig_profile_t *eeconfig_profile = &mock_profile;
 uint32_t mock_timer = 0;
 static uint8_t last_registered_key;
 static uint8_t last_registered_keycode;
@@ -28,19 +30,25 @@ static uint8_t pushed_action_count;
 static uint8_t rt_keys[8];
 static bool rt_disabled[8];
 static uint8_t rt_call_count;
+static bool keyboard_report_clock;
 
-void matrix_disable_rapid_trigger(uint8_t key, bool disable) {
+void matrix_disable_rapid_trigger(key_index_t key, bool disable) {
     if (rt_call_count < 8) {
         rt_keys[rt_call_count] = key;
         rt_disabled[rt_call_count] = disable;
         rt_call_count++;
     }
 }
+void hid_set_keyboard_report_clock(bool enabled) {
+    keyboard_report_clock = enabled;
+}
 uint32_t timer_read(void) { return mock_timer; }
 uint32_t timer_elapsed(uint32_t last) { return mock_timer - last; }
+uint64_t timer_read_us(void) { return (uint64_t)mock_timer * 1000u; }
 // --- Tests ---
 void setUp(void) {
     memset(&mock_eeconfig, 0, sizeof(eeconfig_t));
+    memset(&mock_profile, 0, sizeof(eeconfig_profile_t));
     memset(key_matrix, 0, sizeof(key_matrix));
     memset(processed_keys, 0, sizeof(processed_keys));
     memset(processed_pressed, 0, sizeof(processed_pressed));
@@ -59,13 +67,14 @@ void setUp(void) {
     memset(rt_keys, 0, sizeof(rt_keys));
     memset(rt_disabled, 0, sizeof(rt_disabled));
     rt_call_count = 0;
+    keyboard_report_clock = true;
     advanced_key_clear();
 }
 
 void tearDown(void) {
 }
 
-void layout_register(uint8_t key, uint8_t keycode) {
+void layout_register(key_index_t key, uint8_t keycode) {
     last_registered_key = key;
     last_registered_keycode = keycode;
     if (layout_event_count < 8) {
@@ -75,7 +84,7 @@ void layout_register(uint8_t key, uint8_t keycode) {
         layout_event_count++;
     }
 }
-void layout_unregister(uint8_t key, uint8_t keycode) {
+void layout_unregister(key_index_t key, uint8_t keycode) {
     last_unregistered_key = key;
     last_unregistered_keycode = keycode;
     if (layout_event_count < 8) {
@@ -92,7 +101,7 @@ bool deferred_action_push(const deferred_action_t *action) {
     return true;
 }
 uint8_t layout_get_current_layer(void) { return 0; }
-bool layout_process_key(uint8_t key, bool pressed) {
+bool layout_process_key(key_index_t key, bool pressed) {
     if (processed_count < 8) {
         processed_keys[processed_count] = key;
         processed_pressed[processed_count] = pressed;
@@ -103,21 +112,21 @@ bool layout_process_key(uint8_t key, bool pressed) {
 
 void test_advanced_keys_combo(void) {
     // Setup a Combo mapped to layer 0, keys 1 and 2, outputting 0x04 (KC_A)
-    mock_eeconfig.profiles[0].advanced_keys[0].type = AK_TYPE_COMBO;
-    mock_eeconfig.profiles[0].advanced_keys[0].layer = 0;
-    mock_eeconfig.profiles[0].advanced_keys[0].combo.keys[0] = 1;
-    mock_eeconfig.profiles[0].advanced_keys[0].combo.keys[1] = 2;
-    mock_eeconfig.profiles[0].advanced_keys[0].combo.keys[2] = 255;
-    mock_eeconfig.profiles[0].advanced_keys[0].combo.keys[3] = 255;
-    mock_eeconfig.profiles[0].advanced_keys[0].combo.term = 50;
-    mock_eeconfig.profiles[0].advanced_keys[0].combo.output_keycode = 0x04;
+    mock_profile.advanced_keys[0].type = AK_TYPE_COMBO;
+    mock_profile.advanced_keys[0].layer = 0;
+    mock_profile.advanced_keys[0].combo.keys[0] = 1;
+    mock_profile.advanced_keys[0].combo.keys[1] = 2;
+    mock_profile.advanced_keys[0].combo.keys[2] = KEY_INDEX_NONE;
+    mock_profile.advanced_keys[0].combo.keys[3] = KEY_INDEX_NONE;
+    mock_profile.advanced_keys[0].combo.term = 50;
+    mock_profile.advanced_keys[0].combo.output_keycode = 0x04;
     
     advanced_key_combo_invalidate_cache();
     
     // Press key 1
-    bool consumed1 = advanced_key_combo_process(1, true, 100);
-    // Press key 2 within combo term (50ms)
-    bool consumed2 = advanced_key_combo_process(2, true, 110);
+    bool consumed1 = advanced_key_combo_process(1, true, 100000);
+    // Press key 2 within combo term (50ms), with times in microseconds
+    bool consumed2 = advanced_key_combo_process(2, true, 110000);
     
     advanced_key_combo_task();
     
@@ -128,19 +137,19 @@ void test_advanced_keys_combo(void) {
 }
 
 void test_advanced_keys_combo_release_before_match_flushes_press_and_release(void) {
-    mock_eeconfig.profiles[0].advanced_keys[0].type = AK_TYPE_COMBO;
-    mock_eeconfig.profiles[0].advanced_keys[0].layer = 0;
-    mock_eeconfig.profiles[0].advanced_keys[0].combo.keys[0] = 1;
-    mock_eeconfig.profiles[0].advanced_keys[0].combo.keys[1] = 2;
-    mock_eeconfig.profiles[0].advanced_keys[0].combo.keys[2] = 255;
-    mock_eeconfig.profiles[0].advanced_keys[0].combo.keys[3] = 255;
-    mock_eeconfig.profiles[0].advanced_keys[0].combo.term = 50;
-    mock_eeconfig.profiles[0].advanced_keys[0].combo.output_keycode = 0x04;
+    mock_profile.advanced_keys[0].type = AK_TYPE_COMBO;
+    mock_profile.advanced_keys[0].layer = 0;
+    mock_profile.advanced_keys[0].combo.keys[0] = 1;
+    mock_profile.advanced_keys[0].combo.keys[1] = 2;
+    mock_profile.advanced_keys[0].combo.keys[2] = KEY_INDEX_NONE;
+    mock_profile.advanced_keys[0].combo.keys[3] = KEY_INDEX_NONE;
+    mock_profile.advanced_keys[0].combo.term = 50;
+    mock_profile.advanced_keys[0].combo.output_keycode = 0x04;
 
     advanced_key_combo_invalidate_cache();
 
-    bool consumed_press = advanced_key_combo_process(1, true, 100);
-    bool consumed_release = advanced_key_combo_process(1, false, 120);
+    bool consumed_press = advanced_key_combo_process(1, true, 100000);
+    bool consumed_release = advanced_key_combo_process(1, false, 120000);
 
     TEST_ASSERT_TRUE(consumed_press);
     TEST_ASSERT_TRUE(consumed_release);
@@ -159,10 +168,10 @@ void test_advanced_keys_init(void) {
 }
 
 void test_advanced_keys_null_bind_primary_transfers_to_secondary_on_release(void) {
-    mock_eeconfig.profiles[0].advanced_keys[0].type = AK_TYPE_NULL_BIND;
-    mock_eeconfig.profiles[0].advanced_keys[0].key = 1;
-    mock_eeconfig.profiles[0].advanced_keys[0].null_bind.secondary_key = 2;
-    mock_eeconfig.profiles[0].advanced_keys[0].null_bind.behavior = NB_BEHAVIOR_PRIMARY;
+    mock_profile.advanced_keys[0].type = AK_TYPE_NULL_BIND;
+    mock_profile.advanced_keys[0].key = 1;
+    mock_profile.advanced_keys[0].null_bind.secondary_key = 2;
+    mock_profile.advanced_keys[0].null_bind.behavior = NB_BEHAVIOR_PRIMARY;
 
     advanced_key_event_t primary_press = {
         .type = AK_EVENT_TYPE_PRESS,
@@ -200,10 +209,10 @@ void test_advanced_keys_null_bind_primary_transfers_to_secondary_on_release(void
 }
 
 void test_advanced_keys_null_bind_distance_prefers_farther_press(void) {
-    mock_eeconfig.profiles[0].advanced_keys[0].type = AK_TYPE_NULL_BIND;
-    mock_eeconfig.profiles[0].advanced_keys[0].key = 1;
-    mock_eeconfig.profiles[0].advanced_keys[0].null_bind.secondary_key = 2;
-    mock_eeconfig.profiles[0].advanced_keys[0].null_bind.behavior = NB_BEHAVIOR_DISTANCE;
+    mock_profile.advanced_keys[0].type = AK_TYPE_NULL_BIND;
+    mock_profile.advanced_keys[0].key = 1;
+    mock_profile.advanced_keys[0].null_bind.secondary_key = 2;
+    mock_profile.advanced_keys[0].null_bind.behavior = NB_BEHAVIOR_DISTANCE;
     key_matrix[1].distance = 40;
     key_matrix[2].distance = 80;
 
@@ -236,9 +245,9 @@ void test_advanced_keys_null_bind_distance_prefers_farther_press(void) {
 }
 
 void test_advanced_keys_toggle_second_press_turns_key_off_on_release(void) {
-    mock_eeconfig.profiles[0].advanced_keys[0].type = AK_TYPE_TOGGLE;
-    mock_eeconfig.profiles[0].advanced_keys[0].toggle.keycode = KC_E;
-    mock_eeconfig.profiles[0].advanced_keys[0].toggle.tapping_term = 100;
+    mock_profile.advanced_keys[0].type = AK_TYPE_TOGGLE;
+    mock_profile.advanced_keys[0].toggle.keycode = KC_E;
+    mock_profile.advanced_keys[0].toggle.tapping_term = 100;
 
     advanced_key_event_t press = {
         .type = AK_EVENT_TYPE_PRESS,
@@ -269,9 +278,9 @@ void test_advanced_keys_toggle_second_press_turns_key_off_on_release(void) {
 }
 
 void test_advanced_keys_toggle_hold_past_tapping_term_falls_back_to_momentary(void) {
-    mock_eeconfig.profiles[0].advanced_keys[0].type = AK_TYPE_TOGGLE;
-    mock_eeconfig.profiles[0].advanced_keys[0].toggle.keycode = KC_F;
-    mock_eeconfig.profiles[0].advanced_keys[0].toggle.tapping_term = 100;
+    mock_profile.advanced_keys[0].type = AK_TYPE_TOGGLE;
+    mock_profile.advanced_keys[0].toggle.keycode = KC_F;
+    mock_profile.advanced_keys[0].toggle.tapping_term = 100;
 
     advanced_key_event_t press = {
         .type = AK_EVENT_TYPE_PRESS,
@@ -299,11 +308,11 @@ void test_advanced_keys_toggle_hold_past_tapping_term_falls_back_to_momentary(vo
 }
 
 void test_advanced_keys_dynamic_keystroke_press_enqueues_press_and_disables_rt(void) {
-    mock_eeconfig.profiles[0].advanced_keys[0].type = AK_TYPE_DYNAMIC_KEYSTROKE;
-    mock_eeconfig.profiles[0].advanced_keys[0].dynamic_keystroke.keycodes[0] = KC_A;
-    mock_eeconfig.profiles[0].advanced_keys[0].dynamic_keystroke.bitmap[0] =
+    mock_profile.advanced_keys[0].type = AK_TYPE_DYNAMIC_KEYSTROKE;
+    mock_profile.advanced_keys[0].dynamic_keystroke.keycodes[0] = KC_A;
+    mock_profile.advanced_keys[0].dynamic_keystroke.bitmap[0] =
         DKS_ACTION_PRESS;
-    mock_eeconfig.profiles[0].advanced_keys[0].dynamic_keystroke.bottom_out_point = 1;
+    mock_profile.advanced_keys[0].dynamic_keystroke.bottom_out_point = 1;
 
     advanced_key_event_t event = {
         .type = AK_EVENT_TYPE_PRESS,
@@ -323,11 +332,11 @@ void test_advanced_keys_dynamic_keystroke_press_enqueues_press_and_disables_rt(v
 }
 
 void test_advanced_keys_dynamic_keystroke_bottom_out_uses_bottom_out_action(void) {
-    mock_eeconfig.profiles[0].advanced_keys[0].type = AK_TYPE_DYNAMIC_KEYSTROKE;
-    mock_eeconfig.profiles[0].advanced_keys[0].dynamic_keystroke.keycodes[0] = KC_B;
-    mock_eeconfig.profiles[0].advanced_keys[0].dynamic_keystroke.bitmap[0] =
+    mock_profile.advanced_keys[0].type = AK_TYPE_DYNAMIC_KEYSTROKE;
+    mock_profile.advanced_keys[0].dynamic_keystroke.keycodes[0] = KC_B;
+    mock_profile.advanced_keys[0].dynamic_keystroke.bitmap[0] =
         (uint8_t)(DKS_ACTION_TAP << 2);
-    mock_eeconfig.profiles[0].advanced_keys[0].dynamic_keystroke.bottom_out_point = 50;
+    mock_profile.advanced_keys[0].dynamic_keystroke.bottom_out_point = 50;
     key_matrix[4].distance = 60;
 
     advanced_key_event_t event = {
@@ -345,11 +354,11 @@ void test_advanced_keys_dynamic_keystroke_bottom_out_uses_bottom_out_action(void
 }
 
 void test_advanced_keys_dynamic_keystroke_release_action_unregisters_pressed_key(void) {
-    mock_eeconfig.profiles[0].advanced_keys[0].type = AK_TYPE_DYNAMIC_KEYSTROKE;
-    mock_eeconfig.profiles[0].advanced_keys[0].dynamic_keystroke.keycodes[0] = KC_C;
-    mock_eeconfig.profiles[0].advanced_keys[0].dynamic_keystroke.bitmap[0] =
+    mock_profile.advanced_keys[0].type = AK_TYPE_DYNAMIC_KEYSTROKE;
+    mock_profile.advanced_keys[0].dynamic_keystroke.keycodes[0] = KC_C;
+    mock_profile.advanced_keys[0].dynamic_keystroke.bitmap[0] =
         (uint8_t)(DKS_ACTION_PRESS | (DKS_ACTION_RELEASE << 6));
-    mock_eeconfig.profiles[0].advanced_keys[0].dynamic_keystroke.bottom_out_point = 1;
+    mock_profile.advanced_keys[0].dynamic_keystroke.bottom_out_point = 1;
 
     advanced_key_event_t press = {
         .type = AK_EVENT_TYPE_PRESS,
@@ -372,11 +381,11 @@ void test_advanced_keys_dynamic_keystroke_release_action_unregisters_pressed_key
 }
 
 void test_advanced_keys_clear_re_enables_dynamic_keystroke_rapid_trigger(void) {
-    mock_eeconfig.profiles[0].advanced_keys[0].type = AK_TYPE_DYNAMIC_KEYSTROKE;
-    mock_eeconfig.profiles[0].advanced_keys[0].dynamic_keystroke.keycodes[0] = KC_D;
-    mock_eeconfig.profiles[0].advanced_keys[0].dynamic_keystroke.bitmap[0] =
+    mock_profile.advanced_keys[0].type = AK_TYPE_DYNAMIC_KEYSTROKE;
+    mock_profile.advanced_keys[0].dynamic_keystroke.keycodes[0] = KC_D;
+    mock_profile.advanced_keys[0].dynamic_keystroke.bitmap[0] =
         DKS_ACTION_PRESS;
-    mock_eeconfig.profiles[0].advanced_keys[0].dynamic_keystroke.bottom_out_point = 1;
+    mock_profile.advanced_keys[0].dynamic_keystroke.bottom_out_point = 1;
 
     advanced_key_event_t event = {
         .type = AK_EVENT_TYPE_PRESS,
@@ -395,15 +404,15 @@ void test_advanced_keys_clear_re_enables_dynamic_keystroke_rapid_trigger(void) {
 }
 
 void test_advanced_keys_clear_drops_buffered_combo_events(void) {
-    mock_eeconfig.profiles[0].advanced_keys[0].type = AK_TYPE_COMBO;
-    mock_eeconfig.profiles[0].advanced_keys[0].layer = 0;
-    mock_eeconfig.profiles[0].advanced_keys[0].combo.keys[0] = 1;
-    mock_eeconfig.profiles[0].advanced_keys[0].combo.keys[1] = 2;
-    mock_eeconfig.profiles[0].advanced_keys[0].combo.keys[2] = 255;
-    mock_eeconfig.profiles[0].advanced_keys[0].combo.keys[3] = 255;
-    mock_eeconfig.profiles[0].advanced_keys[0].combo.term = 50;
+    mock_profile.advanced_keys[0].type = AK_TYPE_COMBO;
+    mock_profile.advanced_keys[0].layer = 0;
+    mock_profile.advanced_keys[0].combo.keys[0] = 1;
+    mock_profile.advanced_keys[0].combo.keys[1] = 2;
+    mock_profile.advanced_keys[0].combo.keys[2] = KEY_INDEX_NONE;
+    mock_profile.advanced_keys[0].combo.keys[3] = KEY_INDEX_NONE;
+    mock_profile.advanced_keys[0].combo.term = 50;
 
-    TEST_ASSERT_TRUE(advanced_key_combo_process(1, true, 100));
+    TEST_ASSERT_TRUE(advanced_key_combo_process(1, true, 100000));
 
     advanced_key_clear();
 
@@ -412,11 +421,11 @@ void test_advanced_keys_clear_drops_buffered_combo_events(void) {
 }
 
 void test_advanced_keys_macro_tap_presses_and_releases_virtual_key(void) {
-    mock_eeconfig.profiles[0].advanced_keys[0].type = AK_TYPE_MACRO;
-    mock_eeconfig.profiles[0].advanced_keys[0].macro_key.macro_index = 0;
-    mock_eeconfig.profiles[0].macros[0].events[0] =
+    mock_profile.advanced_keys[0].type = AK_TYPE_MACRO;
+    mock_profile.advanced_keys[0].macro_key.macro_index = 0;
+    mock_profile.macros[0].events[0] =
         (macro_event_t){.keycode = KC_A, .action = MACRO_ACTION_TAP};
-    mock_eeconfig.profiles[0].macros[0].events[1] =
+    mock_profile.macros[0].events[1] =
         (macro_event_t){.keycode = KC_NO, .action = MACRO_ACTION_END};
 
     advanced_key_event_t event = {
@@ -445,11 +454,11 @@ void test_advanced_keys_macro_tap_presses_and_releases_virtual_key(void) {
 }
 
 void test_advanced_keys_abort_macros_releases_tapping_key(void) {
-    mock_eeconfig.profiles[0].advanced_keys[0].type = AK_TYPE_MACRO;
-    mock_eeconfig.profiles[0].advanced_keys[0].macro_key.macro_index = 0;
-    mock_eeconfig.profiles[0].macros[0].events[0] =
+    mock_profile.advanced_keys[0].type = AK_TYPE_MACRO;
+    mock_profile.advanced_keys[0].macro_key.macro_index = 0;
+    mock_profile.macros[0].events[0] =
         (macro_event_t){.keycode = KC_B, .action = MACRO_ACTION_TAP};
-    mock_eeconfig.profiles[0].macros[0].events[1] =
+    mock_profile.macros[0].events[1] =
         (macro_event_t){.keycode = KC_NO, .action = MACRO_ACTION_END};
 
     advanced_key_event_t event = {
@@ -470,12 +479,12 @@ void test_advanced_keys_abort_macros_releases_tapping_key(void) {
 }
 
 void test_advanced_keys_tap_hold_hold_registers_and_releases_hold_key(void) {
-    mock_eeconfig.profiles[0].advanced_keys[0].type = AK_TYPE_TAP_HOLD;
-    mock_eeconfig.profiles[0].advanced_keys[0].key = 6;
-    mock_eeconfig.profiles[0].advanced_keys[0].tap_hold.tap_keycode = KC_A;
-    mock_eeconfig.profiles[0].advanced_keys[0].tap_hold.hold_keycode = KC_B;
-    mock_eeconfig.profiles[0].advanced_keys[0].tap_hold.tapping_term = 100;
-    mock_eeconfig.profiles[0].advanced_keys[0].tap_hold.flags =
+    mock_profile.advanced_keys[0].type = AK_TYPE_TAP_HOLD;
+    mock_profile.advanced_keys[0].key = 6;
+    mock_profile.advanced_keys[0].tap_hold.tap_keycode = KC_A;
+    mock_profile.advanced_keys[0].tap_hold.hold_keycode = KC_B;
+    mock_profile.advanced_keys[0].tap_hold.tapping_term = 100;
+    mock_profile.advanced_keys[0].tap_hold.flags =
         TH_MAKE_FLAGS(TAP_HOLD_FLAVOR_HOLD_PREFERRED, false, false);
 
     advanced_key_event_t press = {
@@ -507,12 +516,12 @@ void test_advanced_keys_tap_hold_hold_registers_and_releases_hold_key(void) {
 }
 
 void test_advanced_keys_tap_hold_hwu_tap_unregisters_hold_then_registers_tap(void) {
-    mock_eeconfig.profiles[0].advanced_keys[0].type = AK_TYPE_TAP_HOLD;
-    mock_eeconfig.profiles[0].advanced_keys[0].key = 7;
-    mock_eeconfig.profiles[0].advanced_keys[0].tap_hold.tap_keycode = KC_C;
-    mock_eeconfig.profiles[0].advanced_keys[0].tap_hold.hold_keycode = KC_D;
-    mock_eeconfig.profiles[0].advanced_keys[0].tap_hold.tapping_term = 100;
-    mock_eeconfig.profiles[0].advanced_keys[0].tap_hold.flags =
+    mock_profile.advanced_keys[0].type = AK_TYPE_TAP_HOLD;
+    mock_profile.advanced_keys[0].key = 7;
+    mock_profile.advanced_keys[0].tap_hold.tap_keycode = KC_C;
+    mock_profile.advanced_keys[0].tap_hold.hold_keycode = KC_D;
+    mock_profile.advanced_keys[0].tap_hold.tapping_term = 100;
+    mock_profile.advanced_keys[0].tap_hold.flags =
         TH_MAKE_FLAGS(TAP_HOLD_FLAVOR_TAP_PREFERRED, false, true);
 
     advanced_key_event_t press = {
@@ -542,13 +551,13 @@ void test_advanced_keys_tap_hold_hwu_tap_unregisters_hold_then_registers_tap(voi
 }
 
 void test_advanced_keys_tap_hold_double_tap_wait_timeout_emits_tap(void) {
-    mock_eeconfig.profiles[0].advanced_keys[0].type = AK_TYPE_TAP_HOLD;
-    mock_eeconfig.profiles[0].advanced_keys[0].key = 8;
-    mock_eeconfig.profiles[0].advanced_keys[0].tap_hold.tap_keycode = KC_E;
-    mock_eeconfig.profiles[0].advanced_keys[0].tap_hold.hold_keycode = KC_F;
-    mock_eeconfig.profiles[0].advanced_keys[0].tap_hold.double_tap_keycode = KC_G;
-    mock_eeconfig.profiles[0].advanced_keys[0].tap_hold.tapping_term = 100;
-    mock_eeconfig.profiles[0].advanced_keys[0].tap_hold.flags =
+    mock_profile.advanced_keys[0].type = AK_TYPE_TAP_HOLD;
+    mock_profile.advanced_keys[0].key = 8;
+    mock_profile.advanced_keys[0].tap_hold.tap_keycode = KC_E;
+    mock_profile.advanced_keys[0].tap_hold.hold_keycode = KC_F;
+    mock_profile.advanced_keys[0].tap_hold.double_tap_keycode = KC_G;
+    mock_profile.advanced_keys[0].tap_hold.tapping_term = 100;
+    mock_profile.advanced_keys[0].tap_hold.flags =
         TH_MAKE_FLAGS(TAP_HOLD_FLAVOR_TAP_PREFERRED, false, false);
 
     advanced_key_event_t press = {
@@ -577,6 +586,40 @@ void test_advanced_keys_tap_hold_double_tap_wait_timeout_emits_tap(void) {
     TEST_ASSERT_EQUAL_UINT8(KC_E, layout_event_keycodes[0]);
 }
 
+void test_advanced_keys_rapid_fire_toggles_on_report_completions(void) {
+    mock_profile.advanced_keys[0].type = AK_TYPE_RAPID_FIRE;
+    mock_profile.advanced_keys[0].key = 4;
+    mock_profile.advanced_keys[0].rapid_fire.keycode = KC_B;
+    mock_profile.advanced_keys[0].rapid_fire.press_reports = 1;
+    mock_profile.advanced_keys[0].rapid_fire.release_reports = 2;
+    TEST_ASSERT_FALSE(keyboard_report_clock);
+
+    advanced_key_event_t press = {
+        .type = AK_EVENT_TYPE_PRESS, .key = 4, .ak_index = 0};
+    advanced_key_process(&press);
+    TEST_ASSERT_TRUE(keyboard_report_clock);
+
+    // Released after 1 report, pressed again after 2 more
+    for (uint32_t i = 0; i < 3; i++)
+        advanced_key_keyboard_report_complete();
+
+    TEST_ASSERT_EQUAL_UINT8(3, layout_event_count);
+    TEST_ASSERT_TRUE(layout_event_pressed[0]);
+    TEST_ASSERT_FALSE(layout_event_pressed[1]);
+    TEST_ASSERT_TRUE(layout_event_pressed[2]);
+    TEST_ASSERT_EQUAL_UINT8(4, layout_event_keys[1]);
+    TEST_ASSERT_EQUAL_UINT8(KC_B, layout_event_keycodes[2]);
+
+    advanced_key_event_t release = {
+        .type = AK_EVENT_TYPE_RELEASE, .key = 4, .ak_index = 0};
+    advanced_key_process(&release);
+    TEST_ASSERT_FALSE(keyboard_report_clock);
+    TEST_ASSERT_EQUAL_UINT8(KC_B, last_unregistered_keycode);
+
+    advanced_key_keyboard_report_complete();
+    TEST_ASSERT_EQUAL_UINT8(4, layout_event_count);
+}
+
 int main(int argc, char **argv) {
     UNITY_BEGIN();
     RUN_TEST(test_advanced_keys_init);
@@ -596,6 +639,7 @@ int main(int argc, char **argv) {
     RUN_TEST(test_advanced_keys_tap_hold_hold_registers_and_releases_hold_key);
     RUN_TEST(test_advanced_keys_tap_hold_hwu_tap_unregisters_hold_then_registers_tap);
     RUN_TEST(test_advanced_keys_tap_hold_double_tap_wait_timeout_emits_tap);
+    RUN_TEST(test_advanced_keys_rapid_fire_toggles_on_report_completions);
     UNITY_END();
     return 0;
 }
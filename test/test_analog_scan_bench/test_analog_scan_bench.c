@@ -0,0 +1,108 @@
+#include <stdio.h>
+#include <time.h>
+#include <unity.h>
+
+#include "analog_scan.h"
+
+// Compares the generic sample store, which looks up the key of each input in
+// the tables, with the store generated for the tables of the keyboard, over
+// full sweeps of all the mux channels.
+
+#if ADC_NUM_MUX_INPUTS > 0
+#define BENCH_NUM_STEPS (1 << ADC_NUM_MUX_SELECT_PINS)
+#else
+#define BENCH_NUM_STEPS 1
+#endif
+#define BENCH_NUM_INPUTS (ADC_NUM_MUX_INPUTS + ADC_NUM_RAW_INPUTS)
+#define BENCH_SWEEPS 10000u
+// Each measurement is repeated this many times and the fastest run is kept,
+// which filters out host scheduling noise
+#define BENCH_REPEATS 20
+
+static uint16_t samples[BENCH_NUM_STEPS][BENCH_NUM_INPUTS];
+static volatile uint16_t generic_key_values[NUM_KEYS];
+#if ADC_NUM_RAW_INPUTS > 0
+static volatile uint16_t generic_raw_values[ADC_NUM_RAW_INPUTS];
+#endif
+
+static uint64_t host_time_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// The store with the table lookups of `analog_scan.c` without a generated
+// kernel. It is not inlined, like the store of `analog_scan.c` called from
+// another file.
+__attribute__((noinline)) static void
+generic_store_samples(const volatile uint16_t *samples, uint8_t mux_channel) {
+#if ADC_NUM_MUX_INPUTS > 0
+  for (uint32_t i = 0; i < ADC_NUM_MUX_INPUTS; i++) {
+    const uint16_t key = analog_mux_input_matrix[mux_channel][i];
+    if (key != 0 && key <= NUM_KEYS) {
+      generic_key_values[key - 1] = samples[i];
+    }
+  }
+#else
+  (void)mux_channel;
+#endif
+
+#if ADC_NUM_RAW_INPUTS > 0
+  for (uint32_t i = 0; i < ADC_NUM_RAW_INPUTS; i++) {
+    const uint16_t sample = samples[ADC_NUM_MUX_INPUTS + i];
+    const uint16_t key = analog_raw_input_vector[i];
+
+    generic_raw_values[i] = sample;
+    if (key != 0 && key <= NUM_KEYS) {
+      generic_key_values[key - 1] = sample;
+    }
+  }
+#endif
+}
+
+void setUp(void) {
+  for (uint32_t c = 0; c < BENCH_NUM_STEPS; c++)
+    for (uint32_t i = 0; i < BENCH_NUM_INPUTS; i++)
+      samples[c][i] = (uint16_t)(c * 100u + i + 1u);
+  analog_scan_reset();
+}
+
+void tearDown(void) {}
+
+void test_analog_scan_bench_full_sweeps(void) {
+  uint64_t generic_ns = UINT64_MAX, generated_ns = UINT64_MAX;
+
+  for (uint32_t repeat = 0; repeat < BENCH_REPEATS; repeat++) {
+    uint64_t start = host_time_ns();
+    for (uint32_t sweep = 0; sweep < BENCH_SWEEPS; sweep++)
+      for (uint32_t c = 0; c < BENCH_NUM_STEPS; c++)
+        generic_store_samples(samples[c], (uint8_t)c);
+    generic_ns = M_MIN(generic_ns, host_time_ns() - start);
+
+    start = host_time_ns();
+    for (uint32_t sweep = 0; sweep < BENCH_SWEEPS; sweep++)
+      for (uint32_t c = 0; c < BENCH_NUM_STEPS; c++)
+        analog_scan_store_samples(samples[c], (uint8_t)c);
+    generated_ns = M_MIN(generated_ns, host_time_ns() - start);
+  }
+
+  printf("%u sweeps of %u keys: generic %llu ns, generated %llu ns\n",
+         BENCH_SWEEPS, (unsigned)NUM_KEYS, (unsigned long long)generic_ns,
+         (unsigned long long)generated_ns);
+
+  // Both stores leave the same values
+  for (uint32_t i = 0; i < NUM_KEYS; i++)
+    TEST_ASSERT_EQUAL_UINT16(generic_key_values[i],
+                             analog_scan_read_key((key_index_t)i));
+#if ADC_NUM_RAW_INPUTS > 0
+  for (uint32_t i = 0; i < ADC_NUM_RAW_INPUTS; i++)
+    TEST_ASSERT_EQUAL_UINT16(generic_raw_values[i],
+                             analog_scan_read_raw((uint8_t)i));
+#endif
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_analog_scan_bench_full_sweeps);
+  return UNITY_END();
+}
@@ -0,0 +1,276 @@
+#include <string.h>
+#include <unity.h>
+
+#include "analog_scan.h"
+#include "spi_queue.h"
+
+// Simulated ADCs behind a fake DMA backend. Each transfer takes as long as
+// its bits at the bus frequency, and the simulated time advances whenever the
+// code under test reads the timer or the test runs the bus. The devices check
+// the commands they receive, convert the channel they select with the
+// pipeline latency of the real parts, and return the result tagged with its
+// channel address.
+
+#define SIM_NUM_CHANNELS 16
+
+#if defined(SPI_ADC_DEVICE_ADS7953)
+// Manual mode results come out two frames after the command
+#define SIM_LATENCY 2
+#define SIM_MODE SPI_BUS_MODE_0
+#elif defined(SPI_ADC_DEVICE_AD7490)
+#define SIM_LATENCY 1
+#define SIM_MODE SPI_BUS_MODE_2
+#endif
+
+typedef struct {
+  // Channels selected by the last commands, the oldest first
+  uint8_t pipeline[SIM_LATENCY];
+  uint32_t frames;
+  uint32_t conversions[SIM_NUM_CHANNELS];
+  uint16_t values[SIM_NUM_CHANNELS];
+  uint32_t bad_commands;
+} sim_device_t;
+
+static sim_device_t sim_devices[SPI_ADC_NUM_DEVICES];
+static int sim_selected = -1;
+static uint64_t sim_time_ns;
+static const spi_transaction_t *sim_active;
+static uint64_t sim_active_done_ns;
+static uint32_t sim_frequency_hz;
+static uint32_t sim_bad_configs;
+static uint32_t sim_overlapping_selects;
+static uint32_t sim_fail_next;
+
+static uint16_t sim_value(uint8_t device, uint8_t channel) {
+  return (uint16_t)(100 + device * 1000 + channel * 10);
+}
+
+// Decode the command of a frame, and return the channel it selects
+static uint8_t sim_command(sim_device_t *device, uint16_t word) {
+  const uint8_t last = device->pipeline[SIM_LATENCY - 1];
+
+#if defined(SPI_ADC_DEVICE_ADS7953)
+  // Manual mode, channel address output and 0V to VREF range
+  if ((word & 0xF87Fu) != 0x1800u) {
+    device->bad_commands++;
+    return last;
+  }
+  return (uint8_t)((word >> 7) & 0x0F);
+#elif defined(SPI_ADC_DEVICE_AD7490)
+  // DIN is kept high during the first two conversions
+  if (device->frames < 2) {
+    device->bad_commands += word != 0xFFFFu;
+    return last;
+  }
+  // Control register write, no sequencer, normal power, 0V to REFIN range and
+  // straight binary
+  if ((word & 0xC3F0u) != 0x8330u) {
+    device->bad_commands++;
+    return last;
+  }
+  return (uint8_t)((word >> 10) & 0x0F);
+#endif
+}
+
+static void sim_frame(uint8_t index, const uint8_t *tx, uint8_t *rx) {
+  sim_device_t *device = &sim_devices[index];
+  const uint8_t channel = device->pipeline[0];
+  const uint16_t result = (uint16_t)(channel << 12 | device->values[channel]);
+
+  device->conversions[channel]++;
+  rx[0] = (uint8_t)(result >> 8);
+  rx[1] = (uint8_t)result;
+
+  memmove(&device->pipeline[0], &device->pipeline[1], SIM_LATENCY - 1);
+  device->pipeline[SIM_LATENCY - 1] =
+      sim_command(device, (uint16_t)(tx[0] << 8 | tx[1]));
+  device->frames++;
+}
+
+// Run the bus until the given time, completing the transfers as the DMA
+// interrupt would
+static void sim_run_until(uint64_t time_ns) {
+  while (sim_active != NULL && sim_active_done_ns <= time_ns) {
+    const spi_transaction_t *transaction = sim_active;
+    bool success = true;
+
+    sim_time_ns = sim_active_done_ns;
+    sim_active = NULL;
+    if (sim_fail_next > 0) {
+      sim_fail_next--;
+      success = false;
+    } else {
+      TEST_ASSERT_TRUE(sim_selected >= 0);
+      TEST_ASSERT_EQUAL_UINT32(2, transaction->len);
+      sim_frame((uint8_t)sim_selected, transaction->tx, transaction->rx);
+    }
+    spi_queue_complete(transaction->config->bus, success);
+  }
+  if (time_ns > sim_time_ns)
+    sim_time_ns = time_ns;
+}
+
+static void sim_run_us(uint32_t us) {
+  sim_run_until(sim_time_ns + (uint64_t)us * 1000u);
+}
+
+uint32_t timer_read(void) {
+  sim_run_us(10);
+  return (uint32_t)(sim_time_ns / 1000000u);
+}
+
+void spi_bus_init(void) {}
+
+bool spi_bus_acquire(const spi_bus_config_t *config) {
+  sim_bad_configs += config->bus != SPI_ADC_BUS || config->mode != SIM_MODE ||
+                     config->lsb_first;
+  sim_frequency_hz = config->frequency_hz;
+  return true;
+}
+
+void spi_cs_init(const spi_chip_select_t *chip_select) { (void)chip_select; }
+
+// The chip selects of the devices are pins 1, 2, ...
+void spi_cs_select(const spi_chip_select_t *chip_select) {
+  TEST_ASSERT_TRUE(chip_select->active_low);
+  sim_overlapping_selects += sim_selected >= 0;
+  sim_selected = (int)chip_select->pin - 1;
+}
+
+void spi_cs_deselect(const spi_chip_select_t *chip_select) {
+  TEST_ASSERT_EQUAL_INT((int)chip_select->pin - 1, sim_selected);
+  sim_selected = -1;
+}
+
+spi_driver_status_t spi_driver_start(uint8_t bus,
+                                     const spi_transaction_t *transaction) {
+  TEST_ASSERT_EQUAL_UINT8(SPI_ADC_BUS, bus);
+  TEST_ASSERT_NULL(sim_active);
+  sim_active = transaction;
+  sim_active_done_ns =
+      sim_time_ns + transaction->len * 8u * 1000000000ull / sim_frequency_hz;
+  return SPI_DRIVER_PENDING;
+}
+
+void spi_driver_mask_irq(uint8_t bus, bool masked) {
+  (void)bus;
+  (void)masked;
+}
+
+// Device channel and key of each raw input
+static const uint8_t raw_input_channels[] = ADC_RAW_INPUT_CHANNELS;
+static const uint16_t raw_input_vector[] = ADC_RAW_INPUT_VECTOR;
+
+// Conversions of the channel of a raw input
+static uint32_t sim_conversions(uint8_t raw) {
+  const uint8_t device = raw_input_channels[raw] / SIM_NUM_CHANNELS;
+  const uint8_t channel = raw_input_channels[raw] % SIM_NUM_CHANNELS;
+
+  return sim_devices[device].conversions[channel];
+}
+
+// Conversions of the channels without a raw input
+static uint32_t sim_unsampled_conversions(void) {
+  uint32_t total = 0;
+
+  for (uint8_t d = 0; d < SPI_ADC_NUM_DEVICES; d++)
+    for (uint8_t c = 0; c < SIM_NUM_CHANNELS; c++)
+      total += sim_devices[d].conversions[c];
+  for (uint8_t i = 0; i < ADC_NUM_RAW_INPUTS; i++)
+    total -= sim_conversions(i);
+
+  return total;
+}
+
+void setUp(void) {
+  static bool initialized = false;
+
+  for (uint8_t d = 0; d < SPI_ADC_NUM_DEVICES; d++)
+    for (uint8_t c = 0; c < SIM_NUM_CHANNELS; c++)
+      sim_devices[d].values[c] = sim_value(d, c);
+  sim_fail_next = 0;
+
+  // The sampling runs for good once started, so the tests share it
+  if (!initialized) {
+    initialized = true;
+    analog_init();
+  }
+}
+
+void tearDown(void) {}
+
+void test_analog_spi_adc_maps_channels_to_keys(void) {
+  for (uint8_t i = 0; i < ADC_NUM_RAW_INPUTS; i++) {
+    const uint8_t device = raw_input_channels[i] / SIM_NUM_CHANNELS;
+    const uint8_t channel = raw_input_channels[i] % SIM_NUM_CHANNELS;
+
+    TEST_ASSERT_EQUAL_UINT16(sim_value(device, channel), analog_read_raw(i));
+    if (raw_input_vector[i] != 0)
+      TEST_ASSERT_EQUAL_UINT16(sim_value(device, channel),
+                               analog_read(raw_input_vector[i] - 1));
+  }
+  for (uint8_t d = 0; d < SPI_ADC_NUM_DEVICES; d++)
+    TEST_ASSERT_EQUAL_UINT32(0, sim_devices[d].bad_commands);
+  TEST_ASSERT_EQUAL_UINT32(0, sim_bad_configs);
+  TEST_ASSERT_EQUAL_UINT32(0, sim_overlapping_selects);
+  // Sampling continues in the background after the initialization
+  TEST_ASSERT_NOT_NULL(sim_active);
+}
+
+void test_analog_spi_adc_sweeps_channels_round_robin(void) {
+  static const uint32_t duration_us = 10000;
+  uint32_t start[ADC_NUM_RAW_INPUTS];
+  const uint32_t unsampled = sim_unsampled_conversions();
+
+  for (uint8_t i = 0; i < ADC_NUM_RAW_INPUTS; i++)
+    start[i] = sim_conversions(i);
+
+  sim_run_us(duration_us);
+
+  // Every frame samples a raw input, so each of them is sampled once per
+  // sweep of ADC_NUM_RAW_INPUTS 16-bit frames
+  const uint32_t expected = (uint32_t)((uint64_t)SPI_ADC_FREQUENCY_HZ *
+                                       duration_us / 1000000u / 16u /
+                                       ADC_NUM_RAW_INPUTS);
+  for (uint8_t i = 0; i < ADC_NUM_RAW_INPUTS; i++)
+    TEST_ASSERT_UINT32_WITHIN(1, expected, sim_conversions(i) - start[i]);
+  // Channels without a raw input are not converted once the pipelines have
+  // been primed
+  TEST_ASSERT_EQUAL_UINT32(unsampled, sim_unsampled_conversions());
+}
+
+void test_analog_spi_adc_updates_keys_within_two_sweeps(void) {
+  const uint8_t raw = ADC_NUM_RAW_INPUTS - 1;
+  const uint8_t device = raw_input_channels[raw] / SIM_NUM_CHANNELS;
+  const uint8_t channel = raw_input_channels[raw] % SIM_NUM_CHANNELS;
+  const uint32_t sweep_ns =
+      (uint32_t)(16ull * ADC_NUM_RAW_INPUTS * 1000000000ull /
+                 SPI_ADC_FREQUENCY_HZ);
+
+  sim_devices[device].values[channel] = 4000;
+  sim_run_until(sim_time_ns + 2u * sweep_ns);
+
+  TEST_ASSERT_EQUAL_UINT16(4000, analog_read_raw(raw));
+  TEST_ASSERT_EQUAL_UINT16(4000, analog_read(raw_input_vector[raw] - 1));
+}
+
+void test_analog_spi_adc_restarts_after_a_failed_transfer(void) {
+  const uint8_t device = raw_input_channels[0] / SIM_NUM_CHANNELS;
+  const uint8_t channel = raw_input_channels[0] % SIM_NUM_CHANNELS;
+
+  sim_fail_next = 3;
+  sim_devices[device].values[channel] = 1234;
+  sim_run_us(1000);
+
+  TEST_ASSERT_NOT_NULL(sim_active);
+  TEST_ASSERT_EQUAL_UINT16(1234, analog_read_raw(0));
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_analog_spi_adc_maps_channels_to_keys);
+  RUN_TEST(test_analog_spi_adc_sweeps_channels_round_robin);
+  RUN_TEST(test_analog_spi_adc_updates_keys_within_two_sweeps);
+  RUN_TEST(test_analog_spi_adc_restarts_after_a_failed_transfer);
+  return UNITY_END();
+}
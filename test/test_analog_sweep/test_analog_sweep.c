@@ -0,0 +1,274 @@
+#include <unity.h>
+
+#include "analog_sweep.h"
+
+// Model of the timer-triggered sweeps. Each step of the simulated timer
+// applies the select pattern written by the overflow DMA, triggers the ADC
+// sequence at the compare tick with the multiplexer channel decoded from the
+// select pins, and has the ADC DMA write the samples to the circular buffer.
+
+#define SIM_CLOCK_HZ F_CPU
+#define SIM_SETTLE_NS (ADC_SAMPLE_DELAY * 1000u)
+#define SIM_CONVERSION_NS 3000u
+
+static const uint16_t select_pins[] = ADC_MUX_SELECT_PINS;
+
+static analog_sweep_timing_t sim_timing;
+static uint32_t sim_patterns[ADC_SWEEP_NUM_STEPS];
+static uint32_t sim_gpio;
+static uint32_t sim_overflows;
+static uint32_t sim_steps;
+static uint16_t sim_buffer[2 * ADC_SWEEP_NUM_SAMPLES];
+static uint32_t sim_dma_remaining;
+static uint32_t sim_cycles;
+// Set when the ADC stops converting, as after an overrun
+static bool sim_stalled;
+
+uint32_t board_cycle_count(void) { return sim_cycles; }
+
+static uint16_t sim_sample(uint32_t sweep, uint32_t mux_channel,
+                           uint32_t input) {
+  return (uint16_t)(1000 + sweep * 100 + mux_channel * 10 + input);
+}
+
+static void sim_write_gpio(uint32_t pattern) {
+  sim_gpio |= pattern & 0xFFFFu;
+  sim_gpio &= ~(pattern >> 16);
+}
+
+static uint32_t sim_mux_channel(void) {
+  uint32_t channel = 0;
+
+  for (uint32_t i = 0; i < ADC_NUM_MUX_SELECT_PINS; i++)
+    if (sim_gpio & select_pins[i])
+      channel |= 1u << i;
+
+  return channel;
+}
+
+static void sim_start(uint32_t sweep_rate_hz) {
+  analog_sweep_compute_timing(SIM_CLOCK_HZ, sweep_rate_hz, SIM_SETTLE_NS,
+                              SIM_CONVERSION_NS, &sim_timing);
+  sim_gpio = 0;
+  sim_write_gpio(analog_sweep_build_mux_patterns(select_pins, sim_patterns));
+  sim_overflows = 0;
+  sim_steps = 0;
+  sim_dma_remaining = 2 * ADC_SWEEP_NUM_SAMPLES;
+  analog_sweep_reset();
+}
+
+// Run the timer for one step
+static void sim_step(void) {
+  const uint32_t sweep = sim_steps / ADC_SWEEP_NUM_STEPS;
+  const uint32_t step = sim_steps % ADC_SWEEP_NUM_STEPS;
+  const uint64_t trigger_ns = (uint64_t)(sim_timing.prescaler + 1) *
+                              sim_timing.trigger * 1000000000u / SIM_CLOCK_HZ;
+  const uint64_t step_ns = (uint64_t)(sim_timing.prescaler + 1) *
+                           (sim_timing.period + 1u) * 1000000000u /
+                           SIM_CLOCK_HZ;
+
+  // The ADC sequence is triggered once the multiplexer has settled, and is
+  // converted before the next overflow
+  TEST_ASSERT_TRUE(trigger_ns >= SIM_SETTLE_NS);
+  TEST_ASSERT_TRUE(step_ns - trigger_ns >= SIM_CONVERSION_NS);
+  TEST_ASSERT_EQUAL_UINT32(step, sim_mux_channel());
+
+  for (uint32_t i = 0; i < ADC_SWEEP_NUM_INPUTS; i++) {
+    sim_buffer[2 * ADC_SWEEP_NUM_SAMPLES - sim_dma_remaining] =
+        sim_sample(sweep, sim_mux_channel(), i);
+    if (--sim_dma_remaining == 0)
+      sim_dma_remaining = 2 * ADC_SWEEP_NUM_SAMPLES;
+  }
+
+  // The overflow at the end of the step selects the next channel
+  sim_write_gpio(sim_patterns[sim_overflows++ % ADC_SWEEP_NUM_STEPS]);
+  sim_steps++;
+}
+
+static bool sim_poll(void) {
+  return analog_sweep_store(sim_buffer, sim_dma_remaining);
+}
+
+// Read by the wait, which polls once per step of the simulated timer
+static uint32_t sim_read_dma_remaining(void) {
+  const uint32_t dma_remaining = sim_dma_remaining;
+
+  sim_cycles += (sim_timing.prescaler + 1u) * (sim_timing.period + 1u);
+  if (!sim_stalled)
+    sim_step();
+
+  return dma_remaining;
+}
+
+static bool sim_wait(uint32_t timeout_cycles) {
+  return analog_sweep_wait(sim_buffer, sim_read_dma_remaining,
+                           timeout_cycles);
+}
+
+void setUp(void) {
+  analog_scan_reset();
+  sim_cycles = 0;
+  sim_stalled = false;
+}
+
+void tearDown(void) {}
+
+void test_analog_sweep_timing_matches_requested_rate(void) {
+  analog_sweep_timing_t timing;
+
+  TEST_ASSERT_TRUE(analog_sweep_compute_timing(
+      SIM_CLOCK_HZ, ADC_SWEEP_RATE_HZ, SIM_SETTLE_NS, SIM_CONVERSION_NS,
+      &timing));
+  TEST_ASSERT_EQUAL_UINT32(ADC_SWEEP_RATE_HZ,
+                           analog_sweep_rate_hz(SIM_CLOCK_HZ, &timing));
+  TEST_ASSERT_EQUAL_UINT16(0, timing.prescaler);
+  TEST_ASSERT_EQUAL_UINT16(
+      SIM_CLOCK_HZ / ADC_SWEEP_RATE_HZ / ADC_SWEEP_NUM_STEPS - 1,
+      timing.period);
+  TEST_ASSERT_EQUAL_UINT16(SIM_CLOCK_HZ / 1000000u * ADC_SAMPLE_DELAY,
+                           timing.trigger);
+}
+
+void test_analog_sweep_timing_divides_slow_rates(void) {
+  analog_sweep_timing_t timing;
+
+  TEST_ASSERT_TRUE(analog_sweep_compute_timing(SIM_CLOCK_HZ, 10, SIM_SETTLE_NS,
+                                               SIM_CONVERSION_NS, &timing));
+  TEST_ASSERT_TRUE(timing.prescaler > 0);
+  TEST_ASSERT_EQUAL_UINT32(10, analog_sweep_rate_hz(SIM_CLOCK_HZ, &timing));
+  TEST_ASSERT_TRUE((uint64_t)(timing.prescaler + 1) * timing.trigger >=
+                   SIM_CLOCK_HZ / 1000000u * ADC_SAMPLE_DELAY);
+}
+
+void test_analog_sweep_timing_stretches_unreachable_rates(void) {
+  analog_sweep_timing_t timing;
+
+  TEST_ASSERT_FALSE(analog_sweep_compute_timing(
+      SIM_CLOCK_HZ, 100000, SIM_SETTLE_NS, SIM_CONVERSION_NS, &timing));
+  // The steps are as short as the settle and conversion times allow
+  TEST_ASSERT_EQUAL_UINT16(
+      (SIM_SETTLE_NS + SIM_CONVERSION_NS) / 1000u * (SIM_CLOCK_HZ / 1000000u) -
+          1,
+      timing.period);
+  TEST_ASSERT_TRUE(analog_sweep_rate_hz(SIM_CLOCK_HZ, &timing) < 100000);
+}
+
+void test_analog_sweep_mux_patterns_select_the_next_channel(void) {
+  uint32_t patterns[ADC_SWEEP_NUM_STEPS];
+  const uint32_t all = (uint32_t)select_pins[0] | select_pins[1];
+  const uint32_t first = analog_sweep_build_mux_patterns(select_pins, patterns);
+
+  // Each pattern drives every select pin, so the previous channel does not
+  // leak into the next one
+  TEST_ASSERT_EQUAL_HEX32(all << 16, first);
+  TEST_ASSERT_EQUAL_HEX32(select_pins[0] | (uint32_t)select_pins[1] << 16,
+                          patterns[0]);
+  TEST_ASSERT_EQUAL_HEX32(select_pins[1] | (uint32_t)select_pins[0] << 16,
+                          patterns[1]);
+  TEST_ASSERT_EQUAL_HEX32(all, patterns[2]);
+  TEST_ASSERT_EQUAL_HEX32(all << 16, patterns[3]);
+}
+
+void test_analog_sweep_stores_each_sweep_once_completed(void) {
+  static const uint16_t mux_matrix[][ADC_NUM_MUX_INPUTS] =
+      ADC_MUX_INPUT_MATRIX;
+  static const uint16_t raw_vector[] = ADC_RAW_INPUT_VECTOR;
+
+  sim_start(ADC_SWEEP_RATE_HZ);
+
+  for (uint32_t sweep = 0; sweep < 5; sweep++) {
+    for (uint32_t step = 0; step < ADC_SWEEP_NUM_STEPS; step++) {
+      // Nothing is stored until the last step of the sweep
+      TEST_ASSERT_FALSE(sim_poll());
+      sim_step();
+    }
+    TEST_ASSERT_TRUE(sim_poll());
+    TEST_ASSERT_FALSE(sim_poll());
+
+    for (uint32_t c = 0; c < ADC_SWEEP_NUM_STEPS; c++)
+      for (uint32_t i = 0; i < ADC_NUM_MUX_INPUTS; i++)
+        TEST_ASSERT_EQUAL_UINT16(sim_sample(sweep, c, i),
+                                 analog_scan_read_key(mux_matrix[c][i] - 1));
+    // Raw inputs are converted at every step, and the last one is kept
+    TEST_ASSERT_EQUAL_UINT16(
+        sim_sample(sweep, ADC_SWEEP_NUM_STEPS - 1, ADC_NUM_MUX_INPUTS),
+        analog_scan_read_key(raw_vector[0] - 1));
+  }
+}
+
+void test_analog_sweep_keeps_up_after_a_late_poll(void) {
+  sim_start(ADC_SWEEP_RATE_HZ);
+
+  // A poll that comes after the next sweep has started still stores the
+  // completed one
+  for (uint32_t i = 0; i < ADC_SWEEP_NUM_STEPS + 2; i++)
+    sim_step();
+  TEST_ASSERT_TRUE(sim_poll());
+  TEST_ASSERT_EQUAL_UINT16(sim_sample(0, 1, 0), analog_scan_read_key(1));
+
+  for (uint32_t i = 2; i < ADC_SWEEP_NUM_STEPS; i++)
+    sim_step();
+  TEST_ASSERT_TRUE(sim_poll());
+  TEST_ASSERT_EQUAL_UINT16(sim_sample(1, 1, 0), analog_scan_read_key(1));
+}
+
+void test_analog_sweep_wait_returns_each_sweep(void) {
+  sim_start(ADC_SWEEP_RATE_HZ);
+  const uint32_t timeout = analog_sweep_timeout_cycles(&sim_timing);
+
+  TEST_ASSERT_EQUAL_UINT32(ADC_SWEEP_TIMEOUT_SWEEPS * F_CPU /
+                               ADC_SWEEP_RATE_HZ,
+                           timeout);
+  for (uint32_t sweep = 0; sweep < 3; sweep++) {
+    TEST_ASSERT_TRUE(sim_wait(timeout));
+    TEST_ASSERT_EQUAL_UINT16(sim_sample(sweep, 1, 0),
+                             analog_scan_read_key(1));
+  }
+}
+
+void test_analog_sweep_wait_times_out_when_the_adc_stops(void) {
+  sim_start(ADC_SWEEP_RATE_HZ);
+  const uint32_t timeout = analog_sweep_timeout_cycles(&sim_timing);
+
+  TEST_ASSERT_TRUE(sim_wait(timeout));
+  sim_stalled = true;
+
+  // The wait gives up after the timeout instead of hanging
+  const uint32_t start = sim_cycles;
+  TEST_ASSERT_FALSE(sim_wait(timeout));
+  TEST_ASSERT_TRUE(sim_cycles - start >= timeout);
+  TEST_ASSERT_TRUE(sim_cycles - start < timeout + timeout / 2);
+  TEST_ASSERT_EQUAL_UINT16(sim_sample(0, 1, 0), analog_scan_read_key(1));
+
+  // The restarted sweeps are stored from the beginning of the buffer
+  sim_start(ADC_SWEEP_RATE_HZ);
+  sim_stalled = false;
+  TEST_ASSERT_TRUE(sim_wait(timeout));
+  TEST_ASSERT_EQUAL_UINT16(sim_sample(0, 1, 0), analog_scan_read_key(1));
+  TEST_ASSERT_TRUE(sim_wait(timeout));
+  TEST_ASSERT_EQUAL_UINT16(sim_sample(1, 1, 0), analog_scan_read_key(1));
+}
+
+void test_analog_sweep_wait_survives_a_counter_wrap(void) {
+  sim_start(ADC_SWEEP_RATE_HZ);
+  const uint32_t timeout = analog_sweep_timeout_cycles(&sim_timing);
+
+  sim_cycles = UINT32_MAX - timeout / 2;
+  TEST_ASSERT_TRUE(sim_wait(timeout));
+  sim_stalled = true;
+  TEST_ASSERT_FALSE(sim_wait(timeout));
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_analog_sweep_timing_matches_requested_rate);
+  RUN_TEST(test_analog_sweep_timing_divides_slow_rates);
+  RUN_TEST(test_analog_sweep_timing_stretches_unreachable_rates);
+  RUN_TEST(test_analog_sweep_mux_patterns_select_the_next_channel);
+  RUN_TEST(test_analog_sweep_stores_each_sweep_once_completed);
+  RUN_TEST(test_analog_sweep_keeps_up_after_a_late_poll);
+  RUN_TEST(test_analog_sweep_wait_returns_each_sweep);
+  RUN_TEST(test_analog_sweep_wait_times_out_when_the_adc_stops);
+  RUN_TEST(test_analog_sweep_wait_survives_a_counter_wrap);
+  return UNITY_END();
+}
@@ -7,19 +7,26 @@
 #include "tusb.h"
 #include "usb_descriptors.h"
 
+void profile_runtime_build(uint8_t profile);
 void profile_runtime_reload_current(void);
 
 key_state_t key_matrix[NUM_KEYS];
 eeconfig_t mock_eeconfig;
 const eeconfig_t *eeconfig = &mock_eeconfig;
+eeconfig_profile_t mock_profile;
+const eeconfig_profile_t *eeconfig_profile = &mock_profile;
 bool is_sniper_active = false;
 
 static bool raw_hid_ready;
 static uint32_t raw_hid_report_count;
 static uint8_t raw_hid_reports[4][RAW_HID_EP_SIZE];
 static uint32_t wear_leveling_write_count;
+static uint32_t wear_leveling_flush_count;
 static uint32_t layout_reset_count;
 static uint32_t profile_reload_count;
+static uint32_t profile_build_count;
+static uint8_t profile_build_last;
+static uint32_t profile_save_count;
 static uint32_t recalibrate_count;
 static uint32_t board_reset_count;
 static uint32_t board_bootloader_count;
@@ -31,6 +38,13 @@ static uint8_t host_time_seconds;
 
 #if defined(RGB_ENABLED)
 static rgb_config_t mock_rgb_config;
+static uint32_t rgb_stream_write_count;
+static uint16_t rgb_stream_sequence;
+static uint8_t rgb_stream_flags;
+static uint8_t rgb_stream_encoding;
+static uint8_t rgb_stream_offset;
+static uint8_t rgb_stream_len;
+static uint8_t rgb_stream_data[64];
 #endif
 
 bool wear_leveling_write(uint32_t addr, const void *buf, uint32_t len) {
@@ -41,15 +55,58 @@ bool wear_leveling_write(uint32_t addr, const void *buf, uint32_t len) {
   return true;
 }
 
+bool wear_leveling_flush(void) {
+  wear_leveling_flush_count++;
+  return true;
+}
+
 bool eeconfig_reset(void) { return true; }
 
+uint8_t eeconfig_get_current_profile(void) {
+  return mock_eeconfig.current_profile;
+}
+
+bool eeconfig_save_current_profile(void) {
+  profile_save_count++;
+  return true;
+}
+
 bool eeconfig_reset_profile(uint8_t profile) {
   (void)profile;
   return true;
 }
 
+bool eeconfig_read_profile(uint8_t profile, uint32_t offset, void *buf,
+                           uint32_t len) {
+  (void)profile;
+  memcpy(buf, (const uint8_t *)&mock_profile + offset, len);
+  return true;
+}
+
+bool eeconfig_write_profile(uint8_t profile, uint32_t offset, const void *buf,
+                            uint32_t len) {
+  (void)profile;
+  (void)offset;
+  (void)buf;
+  (void)len;
+  wear_leveling_write_count++;
+  return true;
+}
+
+bool eeconfig_copy_profile(uint8_t profile, uint8_t src_profile) {
+  (void)profile;
+  (void)src_profile;
+  wear_leveling_write_count++;
+  return true;
+}
+
 void layout_reset_runtime_state(void) { layout_reset_count++; }
 
+void profile_runtime_build(uint8_t profile) {
+  profile_build_count++;
+  profile_build_last = profile;
+}
+
 void profile_runtime_reload_current(void) { profile_reload_count++; }
 
 void matrix_recalibrate(bool reset_bottom_out_threshold) {
@@ -78,6 +135,25 @@ void rgb_set_clock_time(uint8_t hours, uint8_t minutes, uint8_t seconds) {
   host_time_minutes = minutes;
   host_time_seconds = seconds;
 }
+
+bool rgb_stream_write(uint16_t sequence, uint8_t flags, uint8_t encoding,
+                      uint8_t offset, const uint8_t *data, uint8_t len) {
+  rgb_stream_write_count++;
+  rgb_stream_sequence = sequence;
+  rgb_stream_flags = flags;
+  rgb_stream_encoding = encoding;
+  rgb_stream_offset = offset;
+  rgb_stream_len = len;
+  memcpy(rgb_stream_data, data, len);
+  return encoding < RGB_STREAM_ENCODING_COUNT;
+}
+
+rgb_stream_status_t rgb_stream_get_status(void) {
+  return (rgb_stream_status_t){
+      .presented_sequence = 0x1234,
+      .dropped_frames = 7,
+  };
+}
 #endif
 
 bool tud_hid_n_ready(uint8_t instance) {
@@ -109,13 +185,18 @@ static bool buffer_has_nonzero_from(const uint8_t *buffer, uint32_t start) {
 
 void setUp(void) {
   memset(&mock_eeconfig, 0, sizeof(mock_eeconfig));
+  memset(&mock_profile, 0, sizeof(mock_profile));
   memset(key_matrix, 0, sizeof(key_matrix));
   raw_hid_ready = true;
   raw_hid_report_count = 0;
   memset(raw_hid_reports, 0, sizeof(raw_hid_reports));
   wear_leveling_write_count = 0;
+  wear_leveling_flush_count = 0;
   layout_reset_count = 0;
   profile_reload_count = 0;
+  profile_build_count = 0;
+  profile_build_last = 0;
+  profile_save_count = 0;
   recalibrate_count = 0;
   board_reset_count = 0;
   board_bootloader_count = 0;
@@ -126,6 +207,9 @@ void setUp(void) {
   host_time_seconds = 0;
 #if defined(RGB_ENABLED)
   memset(&mock_rgb_config, 0, sizeof(mock_rgb_config));
+  rgb_stream_write_count = 0;
+  rgb_stream_len = 0;
+  memset(rgb_stream_data, 0, sizeof(rgb_stream_data));
 #endif
   command_init();
 }
@@ -242,6 +326,42 @@ void test_command_enqueue_rejects_second_pending_request(void) {
   TEST_ASSERT_EQUAL_UINT32(1, raw_hid_report_count);
 }
 
+void test_command_reboot_and_bootloader_flush_wear_leveling(void) {
+  command_in_buffer_t reboot = {.command_id = COMMAND_REBOOT};
+  command_in_buffer_t bootloader = {.command_id = COMMAND_BOOTLOADER};
+
+  command_send_and_flush(&reboot);
+  TEST_ASSERT_EQUAL_UINT32(1, profile_save_count);
+  TEST_ASSERT_EQUAL_UINT32(1, wear_leveling_flush_count);
+  TEST_ASSERT_EQUAL_UINT32(1, board_reset_count);
+
+  command_send_and_flush(&bootloader);
+  TEST_ASSERT_EQUAL_UINT32(2, profile_save_count);
+  TEST_ASSERT_EQUAL_UINT32(2, wear_leveling_flush_count);
+  TEST_ASSERT_EQUAL_UINT32(1, board_bootloader_count);
+}
+
+void test_command_set_advanced_keys_rebuilds_the_written_profile(void) {
+  command_in_buffer_t set_advanced_keys = {
+      .command_id = COMMAND_SET_ADVANCED_KEYS,
+      .advanced_keys = {.profile = 2, .offset = 0, .len = 1},
+  };
+
+  mock_eeconfig.current_profile = 0;
+
+  // Another profile only has its runtime image rebuilt
+  command_send_and_flush(&set_advanced_keys);
+  TEST_ASSERT_EQUAL_UINT32(1, profile_build_count);
+  TEST_ASSERT_EQUAL_UINT8(2, profile_build_last);
+  TEST_ASSERT_EQUAL_UINT32(0, profile_reload_count);
+
+  // The current profile is also reloaded
+  set_advanced_keys.advanced_keys.profile = 0;
+  command_send_and_flush(&set_advanced_keys);
+  TEST_ASSERT_EQUAL_UINT32(1, profile_build_count);
+  TEST_ASSERT_EQUAL_UINT32(1, profile_reload_count);
+}
+
 #if defined(RGB_ENABLED)
 void test_command_set_host_time_updates_runtime_clock_without_flash_write(void) {
   command_in_buffer_t set_host_time = {
@@ -264,6 +384,61 @@ void test_command_set_host_time_updates_runtime_clock_without_flash_write(void)
   TEST_ASSERT_EQUAL_UINT8(56, host_time_seconds);
   TEST_ASSERT_EQUAL_UINT32(0, wear_leveling_write_count);
 }
+
+void test_command_rgb_stream_forwards_packet_without_flash_write(void) {
+  command_in_buffer_t stream = {
+      .command_id = COMMAND_RGB_STREAM,
+      .rgb_stream =
+          {
+              .sequence = 0x1235,
+              .flags = RGB_STREAM_FLAG_PRESENT,
+              .encoding = RGB_STREAM_ENCODING_RAW,
+              .offset = 4,
+              .len = 6,
+              .data = {1, 2, 3, 4, 5, 6},
+          },
+  };
+
+  command_send_and_flush(&stream);
+
+  TEST_ASSERT_EQUAL_UINT32(1, raw_hid_report_count);
+  TEST_ASSERT_EQUAL_UINT8(COMMAND_RGB_STREAM, raw_hid_reports[0][0]);
+  TEST_ASSERT_EQUAL_UINT32(1, rgb_stream_write_count);
+  TEST_ASSERT_EQUAL_UINT16(0x1235, rgb_stream_sequence);
+  TEST_ASSERT_EQUAL_UINT8(RGB_STREAM_FLAG_PRESENT, rgb_stream_flags);
+  TEST_ASSERT_EQUAL_UINT8(RGB_STREAM_ENCODING_RAW, rgb_stream_encoding);
+  TEST_ASSERT_EQUAL_UINT8(4, rgb_stream_offset);
+  TEST_ASSERT_EQUAL_UINT8(6, rgb_stream_len);
+  TEST_ASSERT_EQUAL_UINT8(6, rgb_stream_data[5]);
+
+  command_out_buffer_t out;
+  memcpy(&out, raw_hid_reports[0], sizeof(out));
+  TEST_ASSERT_EQUAL_UINT16(0x1234, out.rgb_stream.presented_sequence);
+  TEST_ASSERT_EQUAL_UINT16(7, out.rgb_stream.dropped_frames);
+  TEST_ASSERT_EQUAL_UINT32(0, wear_leveling_write_count);
+}
+
+void test_command_rgb_stream_rejects_oversized_and_invalid_packets(void) {
+  command_in_buffer_t stream = {
+      .command_id = COMMAND_RGB_STREAM,
+      .rgb_stream =
+          {
+              .encoding = RGB_STREAM_ENCODING_RAW,
+              .len = sizeof(stream.rgb_stream.data) + 1u,
+          },
+  };
+
+  command_send_and_flush(&stream);
+  TEST_ASSERT_EQUAL_UINT8(COMMAND_UNKNOWN, raw_hid_reports[0][0]);
+  TEST_ASSERT_EQUAL_UINT32(0, rgb_stream_write_count);
+
+  stream.rgb_stream.len = 3;
+  stream.rgb_stream.encoding = RGB_STREAM_ENCODING_COUNT;
+  command_send_and_flush(&stream);
+  TEST_ASSERT_EQUAL_UINT8(COMMAND_UNKNOWN, raw_hid_reports[1][0]);
+  TEST_ASSERT_EQUAL_UINT32(1, rgb_stream_write_count);
+  TEST_ASSERT_FALSE(buffer_has_nonzero_from(raw_hid_reports[1], 1));
+}
 #endif
 
 int main(void) {
@@ -274,8 +449,12 @@ int main(void) {
   RUN_TEST(test_command_task_waits_until_raw_hid_is_ready);
   RUN_TEST(test_command_enqueue_defers_processing_until_task);
   RUN_TEST(test_command_enqueue_rejects_second_pending_request);
+  RUN_TEST(test_command_reboot_and_bootloader_flush_wear_leveling);
+  RUN_TEST(test_command_set_advanced_keys_rebuilds_the_written_profile);
 #if defined(RGB_ENABLED)
   RUN_TEST(test_command_set_host_time_updates_runtime_clock_without_flash_write);
+  RUN_TEST(test_command_rgb_stream_forwards_packet_without_flash_write);
+  RUN_TEST(test_command_rgb_stream_rejects_oversized_and_invalid_packets);
 #endif
   return UNITY_END();
 }
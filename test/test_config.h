@@ -1,14 +1,35 @@
 #pragma once
 
 // Minimal build-time constants for native unit tests.
+#if !defined(NUM_KEYS)
 #define NUM_KEYS 10
+#endif
+#if !defined(NUM_LAYERS)
 #define NUM_LAYERS 4
+#endif
+#if !defined(NUM_PROFILES)
 #define NUM_PROFILES 3
+#endif
+#if !defined(NUM_ADVANCED_KEYS)
 #define NUM_ADVANCED_KEYS 16
+#endif
 
+#if !defined(WL_VIRTUAL_SIZE)
+#if NUM_KEYS > 256
+// Room for the profiles of the 16-bit key index runs
+#define WL_VIRTUAL_SIZE 16384
+#else
 #define WL_VIRTUAL_SIZE 8192
+#endif
+#endif
+
+#if !defined(WL_WRITE_LOG_SIZE)
 #define WL_WRITE_LOG_SIZE 1024
+#endif
+
+#if !defined(FLASH_SIZE)
 #define FLASH_SIZE 65536
+#endif
 
 #if !defined(F_CPU)
 #define F_CPU 216000000
@@ -0,0 +1,191 @@
+#include <string.h>
+#include <unity.h>
+
+#include "crc32.h"
+#include "lib/crc32_word.h"
+
+#define BUF_SIZE 8192u
+
+static uint8_t buf[BUF_SIZE + 8u];
+static uint8_t changed[BUF_SIZE];
+static uint32_t xorshift_state;
+
+static uint32_t xorshift(void) {
+  xorshift_state ^= xorshift_state << 13;
+  xorshift_state ^= xorshift_state >> 17;
+  xorshift_state ^= xorshift_state << 5;
+  return xorshift_state;
+}
+
+static void fill_random(uint8_t *dst, uint32_t len) {
+  for (uint32_t i = 0; i < len; i++)
+    dst[i] = (uint8_t)xorshift();
+}
+
+// The bit-serial implementation the table-driven one replaced. Its values are
+// stored in the flash of existing keyboards.
+static uint32_t reference_crc32(const void *data, uint32_t len, uint32_t crc) {
+  const uint8_t *data8 = data;
+  uint32_t k;
+
+  crc = ~crc;
+  for (uint32_t i = 0; i < (len + 3) / 4; i++) {
+    k = 0;
+    memcpy(&k, data8 + i * 4, M_MIN(len - i * 4, 4u));
+    crc ^= k;
+    for (uint32_t j = 0; j < 32; j++)
+      crc = (crc >> 1) ^ (0xEDB88320 & (uint32_t)(-(int32_t)(crc & 1)));
+  }
+
+  return ~crc;
+}
+
+// CRC-32/MPEG-2, shifting in bytes from the most significant bit
+static uint32_t mpeg2_crc32(const uint8_t *data, uint32_t len) {
+  uint32_t crc = 0xFFFFFFFF;
+
+  for (uint32_t i = 0; i < len; i++) {
+    crc ^= (uint32_t)data[i] << 24;
+    for (uint32_t j = 0; j < 8; j++)
+      crc = (crc << 1) ^ (CRC32_WORD_POLY & (uint32_t)(-(int32_t)(crc >> 31)));
+  }
+
+  return crc;
+}
+
+// `crc32_compute()` of the STM32 and AT32 backends: the CRC unit is reset,
+// then fed the initial value and the buffer in little endian words
+static uint32_t crc_unit_compute(const void *data, uint32_t len, uint32_t crc) {
+  const uint8_t *data8 = data;
+
+  crc = crc32_word_step(0xFFFFFFFF, crc);
+  for (uint32_t i = 0; i < (len + 3) / 4; i++) {
+    uint32_t k = 0;
+    memcpy(&k, data8 + i * 4, M_MIN(len - i * 4, 4u));
+    crc = crc32_word_step(crc, k);
+  }
+
+  return crc;
+}
+
+void setUp(void) { xorshift_state = 0x12345678u; }
+
+void tearDown(void) {}
+
+void test_crc32_known_values(void) {
+  TEST_ASSERT_EQUAL_HEX32(0x00000000, crc32_compute("", 0, 0));
+  // zlib's CRC32 of "12345678"
+  TEST_ASSERT_EQUAL_HEX32(0x9AE0DAAF, crc32_compute("12345678", 8, 0));
+  // The last word is padded with zeros, so this is zlib's CRC32 of
+  // "123456789\0\0\0"
+  TEST_ASSERT_EQUAL_HEX32(0x77D55834, crc32_compute("123456789", 9, 0));
+}
+
+void test_crc32_matches_bit_serial_implementation(void) {
+  fill_random(buf, sizeof(buf));
+
+  // Every alignment and tail length, and chained initial values
+  for (uint32_t offset = 0; offset < 8u; offset++) {
+    for (uint32_t len = 0; len < 80u; len++) {
+      const uint32_t crc = xorshift();
+      TEST_ASSERT_EQUAL_HEX32(reference_crc32(buf + offset, len, crc),
+                              crc32_compute(buf + offset, len, crc));
+    }
+  }
+
+  TEST_ASSERT_EQUAL_HEX32(reference_crc32(buf, BUF_SIZE, 0),
+                          crc32_compute(buf, BUF_SIZE, 0));
+  TEST_ASSERT_EQUAL_HEX32(reference_crc32(buf + 3, BUF_SIZE - 1, 0),
+                          crc32_compute(buf + 3, BUF_SIZE - 1, 0));
+}
+
+void test_crc32_update_range_matches_recomputation(void) {
+  const uint32_t lens[] = {BUF_SIZE, BUF_SIZE - 3u, 37u, 4u, 1u};
+
+  for (uint32_t l = 0; l < M_ARRAY_SIZE(lens); l++) {
+    const uint32_t len = lens[l];
+
+    for (uint32_t i = 0; i < 200u; i++) {
+      fill_random(buf, len);
+      memcpy(changed, buf, len);
+
+      const uint32_t offset = xorshift() % len;
+      const uint32_t range_len = 1u + xorshift() % M_MIN(len - offset, 80u);
+      const uint32_t init = i % 2u ? xorshift() : 0;
+      fill_random(changed + offset, range_len);
+
+      TEST_ASSERT_EQUAL_HEX32(
+          crc32_compute(changed, len, init),
+          crc32_update_range(crc32_compute(buf, len, init), len, offset,
+                             buf + offset, changed + offset, range_len));
+    }
+  }
+}
+
+void test_crc32_compute_zeros_matches_computation(void) {
+  const uint32_t lens[] = {BUF_SIZE, BUF_SIZE - 3u, 37u, 4u, 1u, 0u};
+
+  memset(buf, 0, sizeof(buf));
+  for (uint32_t l = 0; l < M_ARRAY_SIZE(lens); l++) {
+    const uint32_t init = xorshift();
+
+    TEST_ASSERT_EQUAL_HEX32(crc32_compute(buf, lens[l], 0),
+                            crc32_compute_zeros(lens[l], 0));
+    TEST_ASSERT_EQUAL_HEX32(crc32_compute(buf, lens[l], init),
+                            crc32_compute_zeros(lens[l], init));
+    TEST_ASSERT_EQUAL_HEX32(crc_unit_compute(buf, lens[l], init),
+                            crc32_word_compute_zeros(lens[l], init));
+  }
+}
+
+void test_crc32_word_step_matches_crc_unit(void) {
+  // CRC-32/MPEG-2 check value, the algorithm of the CRC unit
+  TEST_ASSERT_EQUAL_HEX32(0x0376E6E7,
+                          mpeg2_crc32((const uint8_t *)"123456789", 9));
+  // The CRC unit right after reset, fed a zero word
+  TEST_ASSERT_EQUAL_HEX32(0xC704DD7B, crc32_word_step(0xFFFFFFFF, 0));
+
+  // A word is shifted in from its most significant byte
+  for (uint32_t i = 0; i < 100u; i++) {
+    const uint32_t word = xorshift();
+    const uint8_t bytes[] = {(uint8_t)(word >> 24), (uint8_t)(word >> 16),
+                             (uint8_t)(word >> 8), (uint8_t)word};
+    TEST_ASSERT_EQUAL_HEX32(mpeg2_crc32(bytes, sizeof(bytes)),
+                            crc32_word_step(0xFFFFFFFF, word));
+  }
+}
+
+void test_crc32_word_update_range_matches_crc_unit(void) {
+  const uint32_t lens[] = {BUF_SIZE, BUF_SIZE - 3u, 37u, 4u, 1u};
+
+  for (uint32_t l = 0; l < M_ARRAY_SIZE(lens); l++) {
+    const uint32_t len = lens[l];
+
+    for (uint32_t i = 0; i < 200u; i++) {
+      fill_random(buf, len);
+      memcpy(changed, buf, len);
+
+      const uint32_t offset = xorshift() % len;
+      const uint32_t range_len = 1u + xorshift() % M_MIN(len - offset, 80u);
+      const uint32_t init = i % 2u ? xorshift() : 0;
+      fill_random(changed + offset, range_len);
+
+      TEST_ASSERT_EQUAL_HEX32(
+          crc_unit_compute(changed, len, init),
+          crc32_word_update_range(crc_unit_compute(buf, len, init), len,
+                                  offset, buf + offset, changed + offset,
+                                  range_len));
+    }
+  }
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_crc32_known_values);
+  RUN_TEST(test_crc32_matches_bit_serial_implementation);
+  RUN_TEST(test_crc32_update_range_matches_recomputation);
+  RUN_TEST(test_crc32_compute_zeros_matches_computation);
+  RUN_TEST(test_crc32_word_step_matches_crc_unit);
+  RUN_TEST(test_crc32_word_update_range_matches_crc_unit);
+  return UNITY_END();
+}
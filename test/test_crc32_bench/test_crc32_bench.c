@@ -0,0 +1,107 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unity.h>
+
+#include "crc32.h"
+
+// Compares the table-driven CRC32 with the bit-serial implementation it
+// replaced over an 8 KB wear leveling cache, and the incremental update of the
+// cache checksum after a small write with a full recomputation.
+
+#define BENCH_BUF_SIZE 8192u
+// Each measurement is repeated this many times and the fastest run is kept,
+// which filters out host scheduling noise
+#define BENCH_REPEATS 20
+#define BENCH_UPDATES 64u
+
+static uint8_t buf[BENCH_BUF_SIZE];
+static volatile uint32_t sink;
+
+static uint64_t host_time_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static uint32_t bit_serial_crc32(const void *data, uint32_t len, uint32_t crc) {
+  const uint8_t *data8 = data;
+  uint32_t k;
+
+  crc = ~crc;
+  for (uint32_t i = 0; i < len / 4; i++) {
+    memcpy(&k, data8 + i * 4, sizeof(k));
+    crc ^= k;
+    for (uint32_t j = 0; j < 32; j++)
+      crc = (crc >> 1) ^ (0xEDB88320 & (uint32_t)(-(int32_t)(crc & 1)));
+  }
+
+  return ~crc;
+}
+
+void setUp(void) {
+  for (uint32_t i = 0; i < sizeof(buf); i++)
+    buf[i] = (uint8_t)(i * 31u + 7u);
+}
+
+void tearDown(void) {}
+
+void test_crc32_bench_full_buffer(void) {
+  uint64_t bit_serial_ns = UINT64_MAX, sliced_ns = UINT64_MAX;
+
+  for (uint32_t repeat = 0; repeat < BENCH_REPEATS; repeat++) {
+    uint64_t start = host_time_ns();
+    sink = bit_serial_crc32(buf, sizeof(buf), 0);
+    bit_serial_ns = M_MIN(bit_serial_ns, host_time_ns() - start);
+
+    start = host_time_ns();
+    sink = crc32_compute(buf, sizeof(buf), 0);
+    sliced_ns = M_MIN(sliced_ns, host_time_ns() - start);
+  }
+
+  printf("crc32 of %u bytes: bit-serial %llu ns, slicing-by-8 %llu ns\n",
+         (unsigned)sizeof(buf), (unsigned long long)bit_serial_ns,
+         (unsigned long long)sliced_ns);
+  TEST_ASSERT_EQUAL_HEX32(bit_serial_crc32(buf, sizeof(buf), 0),
+                          crc32_compute(buf, sizeof(buf), 0));
+  TEST_ASSERT_TRUE(sliced_ns < bit_serial_ns);
+}
+
+void test_crc32_bench_small_write(void) {
+  uint64_t rescan_ns = UINT64_MAX, update_ns = UINT64_MAX;
+  uint32_t crc = 0;
+
+  for (uint32_t repeat = 0; repeat < BENCH_REPEATS; repeat++) {
+    // Spread 4-byte writes over the buffer
+    uint64_t start = host_time_ns();
+    for (uint32_t i = 0; i < BENCH_UPDATES; i++) {
+      const uint32_t addr = (i * 1237u) % (sizeof(buf) - 4u);
+      buf[addr]++;
+      sink = crc32_compute(buf, sizeof(buf), 0);
+    }
+    rescan_ns = M_MIN(rescan_ns, host_time_ns() - start);
+
+    crc = crc32_compute(buf, sizeof(buf), 0);
+    start = host_time_ns();
+    for (uint32_t i = 0; i < BENCH_UPDATES; i++) {
+      const uint32_t addr = (i * 1237u) % (sizeof(buf) - 4u);
+      const uint8_t value = buf[addr] + 1u;
+      crc = crc32_update_range(crc, sizeof(buf), addr, &buf[addr], &value, 1);
+      buf[addr] = value;
+    }
+    update_ns = M_MIN(update_ns, host_time_ns() - start);
+  }
+
+  printf("%u small writes: rescan %llu ns, incremental update %llu ns\n",
+         (unsigned)BENCH_UPDATES, (unsigned long long)rescan_ns,
+         (unsigned long long)update_ns);
+  TEST_ASSERT_EQUAL_HEX32(crc32_compute(buf, sizeof(buf), 0), crc);
+  TEST_ASSERT_TRUE(update_ns < rescan_ns);
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_crc32_bench_full_buffer);
+  RUN_TEST(test_crc32_bench_small_write);
+  return UNITY_END();
+}
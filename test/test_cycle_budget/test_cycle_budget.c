@@ -0,0 +1,578 @@
+#include <stdio.h>
+#include <time.h>
+#include <unity.h>
+
+#include "loop_profile.h"
+
+// Drives main loop stages through the `LOOP_PROFILE()` hooks with worst case
+// inputs, and compares the longest run of each stage with the cycle budget of
+// the keyboard (`-DCYCLE_BUDGET='{[LOOP_STAGE_...] = cycles, ...}'`). Each
+// section is built on its own:
+// - `CYCLE_BUDGET_HARNESS_INPUT`: `matrix_scan()` and `layout_task()` with all
+//   keys pressed, all advanced keys as combos, and all advanced keys as macros
+// - `CYCLE_BUDGET_HARNESS_RGB`: `rgb_task()` with every effect
+// - `CYCLE_BUDGET_HARNESS_STORAGE`: `wear_leveling_task()` through a full log
+//   consolidation
+// The input and RGB stages run on the host clock scaled to `F_CPU`, so their
+// cycle counts are multiplied by `HARNESS_CYCLE_MARGIN` before the budget
+// check. The storage stage is costed from the simulated flash timings and
+// operation counts, so its cycle counts are checked as they are.
+
+#if !defined(CYCLE_BUDGET)
+#define CYCLE_BUDGET {0}
+#endif
+
+// Each scenario is repeated this many times and the fastest of each run of a
+// stage is kept, which filters out host scheduling noise. The scenarios are
+// deterministic, so the runs line up between the repeats.
+#define HARNESS_REPEATS 5
+#define HARNESS_MAX_RUNS 16384u
+
+// Run a main loop stage within a scenario
+#define HARNESS_RUN(stage, call)                                               \
+  do {                                                                         \
+    loop_profile_reset();                                                      \
+    LOOP_PROFILE(stage, call);                                                 \
+    record_run(stage, loop_profile_max_cycles(stage));                         \
+  } while (0)
+
+#if !defined(HARNESS_CYCLE_MARGIN)
+#if defined(CYCLE_BUDGET_HARNESS_STORAGE)
+// The cycle counts are deterministic
+#define HARNESS_CYCLE_MARGIN 1
+#else
+// A host cycle does more work than an MCU cycle, and the fastest run of a stage
+// still varies by up to 2 times between runs on the host
+#define HARNESS_CYCLE_MARGIN 4
+#endif
+#endif
+
+static const uint32_t stage_budgets[LOOP_STAGE_COUNT] = CYCLE_BUDGET;
+// Fastest cycle count of each run of each stage over the repeats
+static uint32_t run_cycles[LOOP_STAGE_COUNT][HARNESS_MAX_RUNS];
+static uint32_t stage_runs[LOOP_STAGE_COUNT];
+static uint32_t harness_repeat;
+// Longest run of each stage over all the scenarios
+static uint32_t worst_cycles[LOOP_STAGE_COUNT];
+
+static uint64_t host_time_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void record_run(loop_stage_t stage, uint32_t cycles) {
+  const uint32_t run = stage_runs[stage]++;
+
+  TEST_ASSERT_TRUE(run < HARNESS_MAX_RUNS);
+  if (harness_repeat == 0 || cycles < run_cycles[stage][run])
+    run_cycles[stage][run] = cycles;
+}
+
+static void run_scenario(const char *name, void (*scenario)(void)) {
+  for (harness_repeat = 0; harness_repeat < HARNESS_REPEATS;
+       harness_repeat++) {
+    memset(stage_runs, 0, sizeof(stage_runs));
+    scenario();
+  }
+
+  for (uint32_t i = 0; i < LOOP_STAGE_COUNT; i++) {
+    uint32_t max_cycles = 0;
+
+    if (stage_runs[i] == 0)
+      continue;
+    for (uint32_t run = 0; run < stage_runs[i]; run++)
+      max_cycles = M_MAX(max_cycles, run_cycles[i][run]);
+    printf("[cycles] %s: %s %u over %u runs\n", name,
+           loop_profile_stage_name(i), (unsigned)max_cycles,
+           (unsigned)stage_runs[i]);
+    worst_cycles[i] = M_MAX(worst_cycles[i], max_cycles);
+  }
+}
+
+//--------------------------------------------------------------------+
+// Input Stages
+//--------------------------------------------------------------------+
+
+#if defined(CYCLE_BUDGET_HARNESS_INPUT)
+#include "advanced_keys.h"
+#include "deferred_actions.h"
+#include "eeconfig.h"
+#include "keycodes.h"
+#include "layout.h"
+#include "matrix.h"
+#include "profile_runtime.h"
+
+#include "hardware/native/timer_sim.h"
+
+// Main loop period of an 8 kHz scan rate
+#define HARNESS_LOOP_US 125u
+#define HARNESS_REST_ADC 2400u
+#define HARNESS_BOTTOM_OUT_ADC 3050u
+
+eeconfig_t mock_eeconfig;
+const eeconfig_t *eeconfig = &mock_eeconfig;
+eeconfig_profile_t mock_profile;
+const eeconfig_profile_t *eeconfig_profile = &mock_profile;
+
+static uint16_t analog_values[NUM_KEYS];
+// Keycodes sent to the host, to check that the scenarios do something
+static uint32_t hid_events;
+
+uint32_t board_cycle_count(void) {
+  return (uint32_t)(host_time_ns() * (F_CPU / 1000000u) / 1000u);
+}
+
+void board_enter_bootloader(void) {}
+void board_reset(void) {}
+
+void analog_task(void) {}
+
+uint16_t analog_read(key_index_t key) { return analog_values[key]; }
+
+void hid_clear_runtime_state(void) {}
+void hid_keycode_add(uint8_t keycode) { hid_events++; }
+void hid_keycode_remove(uint8_t keycode) { hid_events++; }
+void hid_mouse_move(int8_t x, int8_t y, uint8_t buttons) {}
+void hid_mouse_scroll(int8_t wheel, int8_t pan, uint8_t buttons) {}
+void hid_set_keyboard_report_clock(bool enabled) {}
+void hid_send_reports(void) {}
+
+bool wear_leveling_write(uint32_t address, const void *data, uint32_t len) {
+  return true;
+}
+
+bool wear_leveling_flush(void) { return true; }
+
+bool eeconfig_write_profile(uint8_t profile, uint32_t offset, const void *buf,
+                            uint32_t len) {
+  return true;
+}
+
+uint8_t eeconfig_get_current_profile(void) {
+  return mock_eeconfig.current_profile;
+}
+
+uint8_t eeconfig_get_last_non_default_profile(void) {
+  return mock_eeconfig.last_non_default_profile;
+}
+
+const eeconfig_profile_t *eeconfig_get_profile(uint8_t profile) {
+  return &mock_profile;
+}
+
+bool eeconfig_switch_profile(uint8_t profile) {
+  mock_eeconfig.current_profile = profile;
+  return true;
+}
+
+bool eeconfig_save_current_profile(void) { return true; }
+
+void xinput_process(key_index_t key) {}
+void xinput_reset_runtime_state(void) {}
+
+// All keys at rest with Rapid Trigger, and continuous calibration on
+static void reset_input(void) {
+  memset(&mock_eeconfig, 0, sizeof(mock_eeconfig));
+  memset(&mock_profile, 0, sizeof(mock_profile));
+  mock_eeconfig.calibration.initial_rest_value = HARNESS_REST_ADC;
+  mock_eeconfig.calibration.initial_bottom_out_threshold =
+      HARNESS_BOTTOM_OUT_ADC - HARNESS_REST_ADC;
+  mock_eeconfig.options.continuous_calibration = true;
+  mock_profile.gamepad_options.keyboard_enabled = true;
+  mock_profile.tick_rate = 1;
+
+  for (uint32_t i = 0; i < NUM_KEYS; i++) {
+    analog_values[i] = HARNESS_REST_ADC;
+    mock_profile.keymap[0][i] = (uint8_t)(KC_A + i % (KC_Z - KC_A + 1));
+    mock_profile.actuation_map[i] = (actuation_t){
+        .actuation_point = 128,
+        .rt_down = 20,
+        .rt_up = 20,
+        .continuous = false,
+    };
+  }
+
+  timer_init();
+  memset(key_matrix, 0, sizeof(key_matrix));
+  for (uint32_t i = 0; i < NUM_KEYS; i++) {
+    key_matrix[i].adc_filtered = HARNESS_REST_ADC;
+    key_matrix[i].adc_rest_value = HARNESS_REST_ADC;
+    key_matrix[i].adc_bottom_out_value = HARNESS_BOTTOM_OUT_ADC;
+  }
+  advanced_key_init();
+  deferred_action_init();
+}
+
+static void load_advanced_keys(void) { profile_runtime_reload_current(); }
+
+static void run_loops(uint32_t count) {
+  for (uint32_t i = 0; i < count; i++) {
+    timer_sim_advance_us(HARNESS_LOOP_US);
+    HARNESS_RUN(LOOP_STAGE_MATRIX_SCAN, matrix_scan());
+    HARNESS_RUN(LOOP_STAGE_LAYOUT, layout_task());
+  }
+}
+
+static void run_ms(uint32_t ms) { run_loops(ms * 1000u / HARNESS_LOOP_US); }
+
+static void set_all_keys(uint16_t adc) {
+  for (uint32_t i = 0; i < NUM_KEYS; i++)
+    analog_values[i] = adc;
+}
+
+// Press and release every key at once, a few times
+static void scenario_all_keys_pressed(void) {
+  reset_input();
+  load_advanced_keys();
+
+  for (uint32_t i = 0; i < 8; i++) {
+    set_all_keys(HARNESS_BOTTOM_OUT_ADC);
+    run_ms(20);
+    set_all_keys(HARNESS_REST_ADC);
+    run_ms(20);
+  }
+}
+
+// Every advanced key is a 4-key combo, and every key is pressed at once
+static void scenario_max_combos(void) {
+  reset_input();
+  for (uint32_t i = 0; i < NUM_ADVANCED_KEYS; i++) {
+    advanced_key_t *ak = &mock_profile.advanced_keys[i];
+
+    ak->type = AK_TYPE_COMBO;
+    ak->layer = 0;
+    for (uint32_t j = 0; j < 4; j++)
+      ak->combo.keys[j] = (key_index_t)((i * 4u + j * 3u) % NUM_KEYS);
+    ak->combo.output_keycode = (uint8_t)(KC_A + i % (KC_Z - KC_A + 1));
+    ak->combo.term = 50;
+  }
+  load_advanced_keys();
+
+  for (uint32_t i = 0; i < 4; i++) {
+    set_all_keys(HARNESS_BOTTOM_OUT_ADC);
+    run_ms(80);
+    set_all_keys(HARNESS_REST_ADC);
+    run_ms(80);
+  }
+}
+
+// Every advanced key plays a full macro, and they are all started at once
+static void scenario_macro_playback(void) {
+  reset_input();
+  for (uint32_t i = 0; i < NUM_MACROS; i++) {
+    for (uint32_t j = 0; j < MAX_MACRO_EVENTS - 1; j++)
+      mock_profile.macros[i].events[j] = (macro_event_t){
+          .keycode = (uint8_t)(KC_A + (i + j) % (KC_Z - KC_A + 1)),
+          .action = MACRO_ACTION_TAP,
+      };
+  }
+  for (uint32_t i = 0; i < NUM_ADVANCED_KEYS; i++) {
+    advanced_key_t *ak = &mock_profile.advanced_keys[i];
+
+    ak->type = AK_TYPE_MACRO;
+    ak->layer = 0;
+    ak->key = (key_index_t)(i % NUM_KEYS);
+    ak->macro_key.macro_index = (uint8_t)(i % NUM_MACROS);
+  }
+  load_advanced_keys();
+
+  set_all_keys(HARNESS_BOTTOM_OUT_ADC);
+  run_ms(20);
+  set_all_keys(HARNESS_REST_ADC);
+  // Long enough for the macros to play to the end
+  run_ms(MAX_MACRO_EVENTS * 50u);
+}
+
+void test_cycle_budget_all_keys_pressed(void) {
+  hid_events = 0;
+  run_scenario("all keys pressed", scenario_all_keys_pressed);
+  TEST_ASSERT_TRUE(hid_events > 0);
+}
+
+void test_cycle_budget_max_combos(void) {
+  hid_events = 0;
+  run_scenario("max combos", scenario_max_combos);
+  TEST_ASSERT_TRUE(hid_events > 0);
+}
+
+void test_cycle_budget_macro_playback(void) {
+  hid_events = 0;
+  run_scenario("macro playback", scenario_macro_playback);
+  TEST_ASSERT_TRUE(hid_events > 0);
+}
+#endif
+
+//--------------------------------------------------------------------+
+// RGB Stage
+//--------------------------------------------------------------------+
+
+#if defined(CYCLE_BUDGET_HARNESS_RGB)
+#include "eeconfig.h"
+#include "matrix.h"
+#include "rgb.h"
+
+#define HARNESS_FRAMES 64u
+
+static eeconfig_t mock_eeconfig;
+const eeconfig_t *eeconfig = &mock_eeconfig;
+static eeconfig_profile_t mock_profile;
+const eeconfig_profile_t *eeconfig_profile = &mock_profile;
+key_state_t key_matrix[NUM_KEYS];
+
+static uint32_t mock_time;
+static uint32_t frames_written;
+static uint8_t harness_effect;
+
+uint32_t board_cycle_count(void) {
+  return (uint32_t)(host_time_ns() * (F_CPU / 1000000u) / 1000u);
+}
+
+void rgb_driver_init(void) {}
+void rgb_driver_task(void) {}
+
+void rgb_driver_write(const uint8_t *grb_data, uint16_t byte_count) {
+  frames_written++;
+}
+
+uint32_t timer_read(void) { return mock_time; }
+
+uint32_t matrix_get_idle_time(void) { return 0; }
+
+uint8_t layout_get_current_layer(void) { return 0; }
+
+// Render frames of the effect, with a keypress every few frames for the
+// reactive effects
+static void scenario_effect(void) {
+  rgb_config_t *config = &mock_profile.rgb_config;
+
+  memset(&mock_eeconfig, 0, sizeof(mock_eeconfig));
+  memset(&mock_profile, 0, sizeof(mock_profile));
+  memset(key_matrix, 0, sizeof(key_matrix));
+  config->enabled = 1u;
+  config->global_brightness = 255u;
+  config->effect_speed = 128u;
+  config->current_effect = harness_effect;
+  config->solid_color = (rgb_color_t){.r = 255u, .g = 64u, .b = 0u};
+  config->secondary_color = (rgb_color_t){.r = 0u, .g = 64u, .b = 255u};
+  config->background_color = (rgb_color_t){.r = 8u, .g = 8u, .b = 8u};
+  mock_time = (uint32_t)harness_effect * 100000u;
+  rgb_init();
+  rgb_set_clock_time(12u, 34u, 56u);
+  frames_written = 0;
+
+  for (uint32_t frame = 0; frame < HARNESS_FRAMES; frame++) {
+    const uint32_t written = frames_written;
+
+    mock_time += 16u;
+    if (frame % 4u == 0u)
+      rgb_matrix_record_keypress((key_index_t)(frame % NUM_KEYS));
+    for (uint32_t calls = 0; frames_written == written && calls <= NUM_LEDS;
+         calls++)
+      HARNESS_RUN(LOOP_STAGE_RGB, rgb_task());
+  }
+}
+
+void test_cycle_budget_rgb_effects(void) {
+  char name[16];
+
+  for (uint8_t effect = 0; effect < RGB_EFFECT_MAX; effect++) {
+    harness_effect = effect;
+    snprintf(name, sizeof(name), "effect %u", (unsigned)effect);
+    run_scenario(name, scenario_effect);
+    TEST_ASSERT_EQUAL_UINT32(HARNESS_FRAMES, frames_written);
+  }
+}
+#endif
+
+//--------------------------------------------------------------------+
+// Storage Stage
+//--------------------------------------------------------------------+
+
+#if defined(CYCLE_BUDGET_HARNESS_STORAGE)
+#include "crc32.h"
+#include "hardware/native/flash_sim.h"
+#include "lib/crc32_word.h"
+#include "wear_leveling.h"
+
+// Cost of the work besides programming the flash: copying a word out of the
+// flash, checking a word with the CRC unit, checking a word in software, and
+// shifting a CRC in software, which takes up to 64 multiplications
+#define HARNESS_READ_WORD_CYCLES 4u
+#define HARNESS_CRC_WORD_CYCLES 4u
+#define HARNESS_CRC_SOFT_WORD_CYCLES 200u
+#define HARNESS_CRC_SHIFT_CYCLES 10000u
+
+static uint32_t sim_clock_ms;
+static uint64_t sim_crc_cycles;
+// Longest sector erase, which stalls the CPU within a step and is reported
+// apart from the budget
+static uint32_t max_erase_us;
+
+// The CPU stalls while a word is programmed. Sector erases are left out, and
+// each step erases at most one sector.
+uint32_t board_cycle_count(void) {
+  const flash_sim_stats_t *stats = flash_sim_stats();
+
+  return (uint32_t)((uint64_t)stats->programmed_words *
+                        FLASH_SIM_PROGRAM_WORD_US * (F_CPU / 1000000u) +
+                    (uint64_t)stats->read_words * HARNESS_READ_WORD_CYCLES +
+                    sim_crc_cycles);
+}
+
+// The CRC unit of the MCUs, which cannot continue a previous computation
+uint32_t crc32_compute(const void *buf, uint32_t len, uint32_t crc) {
+  const uint8_t *buf8 = buf;
+
+  crc = crc32_word_step(0xFFFFFFFF, crc);
+  for (uint32_t i = 0; i < (len + 3) / 4; i++) {
+    uint32_t k = 0;
+    memcpy(&k, buf8 + i * 4, M_MIN(len - i * 4, 4u));
+    crc = crc32_word_step(crc, k);
+  }
+  sim_crc_cycles += (uint64_t)(len + 3) / 4 * HARNESS_CRC_WORD_CYCLES;
+
+  return crc;
+}
+
+uint32_t crc32_compute_zeros(uint32_t len, uint32_t crc) {
+  sim_crc_cycles += HARNESS_CRC_SHIFT_CYCLES;
+  return crc32_word_compute_zeros(len, crc);
+}
+
+uint32_t crc32_update_range(uint32_t crc, uint32_t len, uint32_t offset,
+                            const void *old_data, const void *new_data,
+                            uint32_t range_len) {
+  sim_crc_cycles += (uint64_t)(range_len + 3) / 4 *
+                        HARNESS_CRC_SOFT_WORD_CYCLES +
+                    HARNESS_CRC_SHIFT_CYCLES;
+  return crc32_word_update_range(crc, len, offset, old_data, new_data,
+                                 range_len);
+}
+
+void board_error_handler(void) { TEST_FAIL_MESSAGE("board error handler"); }
+
+void board_reset(void) {}
+
+uint32_t timer_read(void) { return sim_clock_ms; }
+
+// Time the flash has spent erasing sectors in microseconds
+static uint64_t erase_us(void) {
+  const flash_sim_stats_t *stats = flash_sim_stats();
+
+  return stats->busy_us -
+         (uint64_t)stats->programmed_words * FLASH_SIM_PROGRAM_WORD_US;
+}
+
+// Run the main loop for `ms` milliseconds, one iteration per millisecond
+static void run_ms(uint32_t ms) {
+  for (uint32_t i = 0; i < ms; i++) {
+    const uint32_t erases = flash_sim_stats()->erases;
+    const uint64_t start_us = erase_us();
+
+    sim_clock_ms++;
+    HARNESS_RUN(LOOP_STAGE_WEAR_LEVELING, wear_leveling_task());
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(erases + 1u, flash_sim_stats()->erases);
+    max_erase_us = M_MAX(max_erase_us, (uint32_t)(erase_us() - start_us));
+  }
+}
+
+// Run the main loop until the flash goes idle
+static void run_until_idle(void) {
+  uint64_t busy_us;
+
+  do {
+    busy_us = flash_sim_stats()->busy_us;
+    run_ms(1);
+  } while (flash_sim_stats()->busy_us != busy_us);
+}
+
+// Log changes all over the virtual storage until the write log is full, and
+// run the main loop until the consolidation is over
+static void scenario_full_log_consolidation(void) {
+  uint8_t data[WL_MAX_BYTES_PER_ENTRY];
+
+  flash_sim_reset();
+  sim_clock_ms = 0;
+  wear_leveling_init();
+  TEST_ASSERT_TRUE(wear_leveling_erase());
+  run_until_idle();
+
+  const uint32_t erases = flash_sim_stats()->erases;
+  for (uint32_t i = 0; flash_sim_stats()->erases == erases; i++) {
+    const uint32_t addr =
+        (i * sizeof(data)) % (WL_VIRTUAL_SIZE - sizeof(data) + 1);
+
+    TEST_ASSERT_TRUE(i < WL_WRITE_LOG_SIZE);
+    memset(data, (int)i, sizeof(data));
+    TEST_ASSERT_TRUE(wear_leveling_write(addr, data, sizeof(data)));
+    // Let the write go idle so that it is logged
+    sim_clock_ms += WL_WRITE_BACK_DELAY_MS;
+    run_ms(1);
+  }
+  run_until_idle();
+}
+
+void test_cycle_budget_full_log_consolidation(void) {
+  max_erase_us = 0;
+  run_scenario("full log consolidation", scenario_full_log_consolidation);
+  TEST_ASSERT_TRUE(flash_sim_stats()->erases > 0);
+  printf("[cycles] full log consolidation: longest sector erase %u us, "
+         "outside the budget\n",
+         (unsigned)max_erase_us);
+}
+#endif
+
+//--------------------------------------------------------------------+
+// Budget Check
+//--------------------------------------------------------------------+
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+void test_cycle_budget_stages_within_budget(void) {
+  char message[80];
+  bool within_budget = true;
+
+  for (uint32_t i = 0; i < LOOP_STAGE_COUNT; i++) {
+    if (worst_cycles[i] == 0)
+      continue;
+
+    if (stage_budgets[i] == 0) {
+      printf("[cycles] %s: %u, no budget\n", loop_profile_stage_name(i),
+             (unsigned)worst_cycles[i]);
+      continue;
+    }
+
+    const uint64_t cycles = (uint64_t)worst_cycles[i] * HARNESS_CYCLE_MARGIN;
+    printf("[cycles] %s: %u x %u of %u\n", loop_profile_stage_name(i),
+           (unsigned)worst_cycles[i], (unsigned)HARNESS_CYCLE_MARGIN,
+           (unsigned)stage_budgets[i]);
+    if (cycles > stage_budgets[i]) {
+      snprintf(message, sizeof(message), "%s exceeds its cycle budget",
+               loop_profile_stage_name(i));
+      TEST_MESSAGE(message);
+      within_budget = false;
+    }
+  }
+
+  TEST_ASSERT_TRUE(within_budget);
+}
+
+int main(void) {
+  UNITY_BEGIN();
+#if defined(CYCLE_BUDGET_HARNESS_INPUT)
+  RUN_TEST(test_cycle_budget_all_keys_pressed);
+  RUN_TEST(test_cycle_budget_max_combos);
+  RUN_TEST(test_cycle_budget_macro_playback);
+#endif
+#if defined(CYCLE_BUDGET_HARNESS_RGB)
+  RUN_TEST(test_cycle_budget_rgb_effects);
+#endif
+#if defined(CYCLE_BUDGET_HARNESS_STORAGE)
+  RUN_TEST(test_cycle_budget_full_log_consolidation);
+#endif
+  RUN_TEST(test_cycle_budget_stages_within_budget);
+  return UNITY_END();
+}
@@ -7,16 +7,18 @@
 
 typedef struct {
   bool pressed;
-  uint8_t key;
+  key_index_t key;
   uint8_t keycode;
 } layout_event_t;
 
 eeconfig_t mock_eeconfig;
 const eeconfig_t *eeconfig = &mock_eeconfig;
+eeconfig_profile_t mock_profile;
+const eeconfig_profile_t *eeconfig_profile = &mock_profile;
 static layout_event_t events[8];
 static uint8_t event_count;
 
-void layout_register(uint8_t key, uint8_t keycode) {
+void layout_register(key_index_t key, uint8_t keycode) {
   if (event_count < 8) {
     events[event_count++] = (layout_event_t){
         .pressed = true,
@@ -26,7 +28,7 @@ void layout_register(uint8_t key, uint8_t keycode) {
   }
 }
 
-void layout_unregister(uint8_t key, uint8_t keycode) {
+void layout_unregister(key_index_t key, uint8_t keycode) {
   if (event_count < 8) {
     events[event_count++] = (layout_event_t){
         .pressed = false,
@@ -38,6 +40,7 @@ void layout_unregister(uint8_t key, uint8_t keycode) {
 
 void setUp(void) {
   memset(&mock_eeconfig, 0, sizeof(mock_eeconfig));
+  memset(&mock_profile, 0, sizeof(mock_profile));
   memset(events, 0, sizeof(events));
   event_count = 0;
   deferred_action_clear();
@@ -0,0 +1,393 @@
+#include <stdio.h>
+#include <unity.h>
+
+#include "eeconfig.h"
+
+// Profiles are stored as delta records against the base profile in the wear
+// leveling cache. Only the current profile is materialised into a RAM view,
+// which a profile switch decodes again.
+
+uint8_t wl_cache[WL_VIRTUAL_SIZE];
+
+static uint32_t write_count;
+static uint32_t bytes_written;
+
+bool wear_leveling_read(uint32_t addr, void *buf, uint32_t len) {
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(sizeof(wl_cache), addr + len);
+
+  memcpy(buf, wl_cache + addr, len);
+  return true;
+}
+
+bool wear_leveling_write(uint32_t addr, const void *buf, uint32_t len) {
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(sizeof(wl_cache), addr + len);
+
+  write_count++;
+  bytes_written += len;
+  memcpy(wl_cache + addr, buf, len);
+  return true;
+}
+
+#if !defined(KEY_INDEX_16BIT)
+bool migration_try_migrate(void) { return false; }
+#endif
+
+// Size of the delta records of all profiles
+static uint32_t profile_storage_used(void) {
+  uint32_t used = 0;
+  for (uint32_t i = 0; i < NUM_PROFILES; i++)
+    used += eeconfig->profile_slots[i].size;
+  return used;
+}
+
+static void customize_profile(eeconfig_profile_t *profile, uint8_t seed) {
+  // Remap up to 10 keys of the second layer
+  for (uint32_t i = 0; i < M_MIN(NUM_KEYS, 10); i++)
+    profile->keymap[1][i] = (uint8_t)(seed + i);
+  profile->actuation_map[seed % NUM_KEYS].actuation_point = seed;
+  profile->advanced_keys[0].type = AK_TYPE_NULL_BIND;
+  profile->advanced_keys[0].layer = seed % NUM_LAYERS;
+  profile->tick_rate = seed;
+#if defined(RGB_ENABLED)
+  profile->rgb_config.solid_color = (rgb_color_t){seed, 0, (uint8_t)~seed};
+#endif
+}
+
+static void write_whole_profile(uint8_t profile, eeconfig_profile_t *expected,
+                                uint8_t seed) {
+  memset(expected, seed, sizeof(*expected));
+  TEST_ASSERT_TRUE(
+      eeconfig_write_profile(profile, 0, expected, sizeof(*expected)));
+}
+
+static void assert_profile_equal(const eeconfig_profile_t *expected,
+                                 uint8_t profile) {
+  eeconfig_profile_t actual;
+
+  TEST_ASSERT_TRUE(eeconfig_read_profile(profile, 0, &actual, sizeof(actual)));
+  TEST_ASSERT_EQUAL_MEMORY(expected, &actual, sizeof(actual));
+}
+
+void setUp(void) {
+  memset(wl_cache, 0, sizeof(wl_cache));
+  eeconfig_init();
+  write_count = 0;
+  bytes_written = 0;
+}
+
+void tearDown(void) {}
+
+void test_eeconfig_reset_stores_default_profiles_without_records(void) {
+  TEST_ASSERT_EQUAL_HEX16(EECONFIG_VERSION, eeconfig->version);
+  TEST_ASSERT_EQUAL_HEX32(EECONFIG_MAGIC_END, eeconfig->magic_end);
+  TEST_ASSERT_EQUAL_UINT8(0, eeconfig->current_profile);
+  TEST_ASSERT_EQUAL_UINT32(0, profile_storage_used());
+  TEST_ASSERT_EQUAL_MEMORY(&eeconfig->base_profile, &CURRENT_PROFILE,
+                           sizeof(eeconfig_profile_t));
+  TEST_ASSERT_EQUAL_UINT8(DEFAULT_TICK_RATE, CURRENT_PROFILE.tick_rate);
+  TEST_ASSERT_EQUAL_UINT8(DEFAULT_ACTUATION_POINT,
+                          CURRENT_PROFILE.actuation_map[0].actuation_point);
+}
+
+void test_eeconfig_write_current_profile_updates_view_and_records(void) {
+  const uint8_t keycodes[3] = {0x04, 0x05, 0x06};
+
+  TEST_ASSERT_TRUE(eeconfig_write_profile(0, offsetof(eeconfig_profile_t, keymap),
+                                          keycodes, sizeof(keycodes)));
+
+  TEST_ASSERT_EQUAL_MEMORY(keycodes, CURRENT_PROFILE.keymap[0],
+                           sizeof(keycodes));
+  // One record with the changed bytes
+  TEST_ASSERT_EQUAL_UINT16(sizeof(eeconfig_delta_header_t) + sizeof(keycodes),
+                           eeconfig->profile_slots[0].size);
+  // The base profile is never rewritten
+  TEST_ASSERT_EQUAL_UINT8(0, eeconfig->base_profile.keymap[0][0]);
+
+  // The records are decoded again after a reboot
+  eeconfig_init();
+  TEST_ASSERT_EQUAL_MEMORY(keycodes, CURRENT_PROFILE.keymap[0],
+                           sizeof(keycodes));
+}
+
+void test_eeconfig_nearby_changes_share_a_record(void) {
+  const uint8_t keycode = 0x04;
+
+  // Two changed bytes with fewer unchanged bytes between them than a header
+  TEST_ASSERT_TRUE(EECONFIG_WRITE_PROFILE(0, keymap[0][0], &keycode));
+  TEST_ASSERT_TRUE(EECONFIG_WRITE_PROFILE(0, keymap[0][3], &keycode));
+  TEST_ASSERT_EQUAL_UINT16(sizeof(eeconfig_delta_header_t) + 4,
+                           eeconfig->profile_slots[0].size);
+
+  // Further apart, a new record is cheaper
+  TEST_ASSERT_TRUE(EECONFIG_WRITE_PROFILE(0, keymap[0][8], &keycode));
+  TEST_ASSERT_EQUAL_UINT16(2 * sizeof(eeconfig_delta_header_t) + 5,
+                           eeconfig->profile_slots[0].size);
+}
+
+void test_eeconfig_switch_materialises_each_profile(void) {
+  static eeconfig_profile_t expected[NUM_PROFILES];
+
+  for (uint32_t i = 0; i < NUM_PROFILES; i++) {
+    expected[i] = CURRENT_PROFILE;
+    customize_profile(&expected[i], (uint8_t)(i + 1));
+    TEST_ASSERT_TRUE(
+        eeconfig_write_profile(i, 0, &expected[i], sizeof(expected[i])));
+  }
+
+  for (uint32_t i = NUM_PROFILES; i-- > 0;) {
+    TEST_ASSERT_TRUE(eeconfig_set_current_profile(i));
+    TEST_ASSERT_EQUAL_UINT8(i, eeconfig->current_profile);
+    TEST_ASSERT_EQUAL_MEMORY(&expected[i], &CURRENT_PROFILE,
+                             sizeof(eeconfig_profile_t));
+  }
+
+  TEST_ASSERT_FALSE(eeconfig_set_current_profile(NUM_PROFILES));
+  TEST_ASSERT_EQUAL_UINT8(0, eeconfig->current_profile);
+}
+
+void test_eeconfig_switch_is_saved_separately(void) {
+  eeconfig_profile_t profile = CURRENT_PROFILE;
+
+  customize_profile(&profile, 7);
+  TEST_ASSERT_TRUE(eeconfig_write_profile(2, 0, &profile, sizeof(profile)));
+
+  write_count = 0;
+  TEST_ASSERT_TRUE(eeconfig_switch_profile(2));
+  TEST_ASSERT_FALSE(eeconfig_switch_profile(NUM_PROFILES));
+
+  // The switch only materialises the profile
+  TEST_ASSERT_EQUAL_UINT32(0, write_count);
+  TEST_ASSERT_EQUAL_UINT8(2, eeconfig_get_current_profile());
+  TEST_ASSERT_EQUAL_UINT8(2, eeconfig_get_last_non_default_profile());
+  TEST_ASSERT_EQUAL_UINT8(0, eeconfig->current_profile);
+  TEST_ASSERT_EQUAL_MEMORY(&profile, &CURRENT_PROFILE, sizeof(profile));
+
+  TEST_ASSERT_TRUE(eeconfig_save_current_profile());
+  TEST_ASSERT_EQUAL_UINT8(2, eeconfig->current_profile);
+  TEST_ASSERT_EQUAL_UINT8(2, eeconfig->last_non_default_profile);
+
+  // Switching back to the default profile keeps the last non-default profile
+  TEST_ASSERT_TRUE(eeconfig_switch_profile(0));
+  TEST_ASSERT_EQUAL_UINT8(2, eeconfig_get_last_non_default_profile());
+  TEST_ASSERT_EQUAL_MEMORY(&eeconfig->base_profile, &CURRENT_PROFILE,
+                           sizeof(eeconfig_profile_t));
+}
+
+void test_eeconfig_customised_profiles_fit_where_whole_copies_do_not(void) {
+  eeconfig_profile_t profile;
+
+  for (uint32_t i = 0; i < NUM_PROFILES; i++) {
+    profile = eeconfig->base_profile;
+    customize_profile(&profile, (uint8_t)(i + 1));
+    TEST_ASSERT_TRUE(eeconfig_write_profile(i, 0, &profile, sizeof(profile)));
+  }
+
+  const uint32_t whole_copies_size =
+      EECONFIG_GLOBAL_SIZE + NUM_PROFILES * sizeof(eeconfig_profile_t) + 4;
+  const uint32_t used = profile_storage_used();
+  printf("%u profiles of %u bytes: %u bytes of records, %u bytes as whole "
+         "copies, %u bytes of storage\n",
+         (unsigned)NUM_PROFILES, (unsigned)sizeof(eeconfig_profile_t),
+         (unsigned)used, (unsigned)(NUM_PROFILES * sizeof(eeconfig_profile_t)),
+         (unsigned)WL_VIRTUAL_SIZE);
+  TEST_ASSERT_GREATER_THAN_UINT32(WL_VIRTUAL_SIZE, whole_copies_size);
+  TEST_ASSERT_LESS_THAN_UINT32(EECONFIG_PROFILE_DELTAS_SIZE / 4, used);
+}
+
+void test_eeconfig_unrelated_profile_is_stored_as_a_whole(void) {
+  eeconfig_profile_t expected;
+
+  write_whole_profile(1, &expected, 0x5A);
+
+  TEST_ASSERT_EQUAL_UINT16(sizeof(eeconfig_profile_t),
+                           eeconfig->profile_slots[1].size);
+  assert_profile_equal(&expected, 1);
+  // The current profile is left alone
+  TEST_ASSERT_EQUAL_MEMORY(&eeconfig->base_profile, &CURRENT_PROFILE,
+                           sizeof(eeconfig_profile_t));
+}
+
+void test_eeconfig_compacts_records_when_the_delta_area_is_full(void) {
+  static eeconfig_profile_t expected[NUM_PROFILES];
+  const uint32_t capacity =
+      EECONFIG_PROFILE_DELTAS_SIZE / sizeof(eeconfig_profile_t);
+  TEST_ASSERT_LESS_THAN_UINT32(NUM_PROFILES - 1, capacity);
+
+  for (uint32_t i = 1; i <= capacity; i++)
+    write_whole_profile(i, &expected[i], (uint8_t)(0xA0 + i));
+
+  // No room left for another whole profile
+  memset(&expected[capacity + 1], 0x11, sizeof(eeconfig_profile_t));
+  TEST_ASSERT_FALSE(eeconfig_write_profile(capacity + 1, 0,
+                                           &expected[capacity + 1],
+                                           sizeof(eeconfig_profile_t)));
+  TEST_ASSERT_EQUAL_UINT16(0, eeconfig->profile_slots[capacity + 1].size);
+  assert_profile_equal(&eeconfig->base_profile, capacity + 1);
+
+  // Resetting the first profile leaves a hole that is reclaimed
+  TEST_ASSERT_TRUE(eeconfig_reset_profile(1));
+  write_whole_profile(capacity + 1, &expected[capacity + 1], 0x11);
+
+  for (uint32_t i = 2; i <= capacity + 1; i++)
+    assert_profile_equal(&expected[i], i);
+  assert_profile_equal(&eeconfig->base_profile, 1);
+}
+
+void test_eeconfig_failed_write_keeps_current_view_in_sync(void) {
+  eeconfig_profile_t expected;
+  const uint32_t capacity =
+      EECONFIG_PROFILE_DELTAS_SIZE / sizeof(eeconfig_profile_t);
+
+  for (uint32_t i = 1; i <= capacity; i++)
+    write_whole_profile(i, &expected, (uint8_t)i);
+
+  memset(&expected, 0x77, sizeof(expected));
+  TEST_ASSERT_FALSE(eeconfig_write_profile(0, 0, &expected, sizeof(expected)));
+  TEST_ASSERT_EQUAL_MEMORY(&eeconfig->base_profile, &CURRENT_PROFILE,
+                           sizeof(eeconfig_profile_t));
+}
+
+void test_eeconfig_write_that_does_not_fit_keeps_the_records(void) {
+  static eeconfig_profile_t expected[NUM_PROFILES];
+  const uint32_t capacity =
+      EECONFIG_PROFILE_DELTAS_SIZE / sizeof(eeconfig_profile_t);
+  const uint8_t tick_rate = 99;
+
+  TEST_ASSERT_TRUE(EECONFIG_WRITE_PROFILE(1, tick_rate, &tick_rate));
+  for (uint32_t i = 2; i <= capacity + 1; i++)
+    write_whole_profile(i, &expected[i], (uint8_t)(0xB0 + i));
+
+  // The profile does not fit even once the records are compacted, so none of
+  // them is moved over its records
+  const eeconfig_profile_slot_t slot = eeconfig->profile_slots[1];
+  const uint32_t writes = write_count;
+  memset(&expected[1], 0x22, sizeof(eeconfig_profile_t));
+  TEST_ASSERT_FALSE(eeconfig_write_profile(1, 0, &expected[1],
+                                           sizeof(eeconfig_profile_t)));
+  TEST_ASSERT_EQUAL_UINT32(writes, write_count);
+  TEST_ASSERT_EQUAL_MEMORY(&slot, &eeconfig->profile_slots[1], sizeof(slot));
+
+  eeconfig_init();
+  TEST_ASSERT_TRUE(eeconfig_set_current_profile(1));
+  TEST_ASSERT_EQUAL_UINT8(tick_rate, CURRENT_PROFILE.tick_rate);
+  for (uint32_t i = 2; i <= capacity + 1; i++)
+    assert_profile_equal(&expected[i], i);
+}
+
+void test_eeconfig_copy_and_reset_profile(void) {
+  eeconfig_profile_t expected = eeconfig->base_profile;
+
+  customize_profile(&expected, 42);
+  TEST_ASSERT_TRUE(eeconfig_write_profile(3, 0, &expected, sizeof(expected)));
+
+  TEST_ASSERT_TRUE(eeconfig_copy_profile(0, 3));
+  TEST_ASSERT_EQUAL_MEMORY(&expected, &CURRENT_PROFILE,
+                           sizeof(eeconfig_profile_t));
+  TEST_ASSERT_EQUAL_UINT16(eeconfig->profile_slots[3].size,
+                           eeconfig->profile_slots[0].size);
+
+  TEST_ASSERT_TRUE(eeconfig_reset_profile(0));
+  TEST_ASSERT_EQUAL_UINT16(0, eeconfig->profile_slots[0].size);
+  TEST_ASSERT_EQUAL_MEMORY(&eeconfig->base_profile, &CURRENT_PROFILE,
+                           sizeof(eeconfig_profile_t));
+  assert_profile_equal(&expected, 3);
+}
+
+void test_eeconfig_rejects_out_of_range_access(void) {
+  uint8_t value = 0;
+
+  TEST_ASSERT_FALSE(eeconfig_read_profile(NUM_PROFILES, 0, &value, 1));
+  TEST_ASSERT_FALSE(
+      eeconfig_read_profile(0, sizeof(eeconfig_profile_t), &value, 1));
+  TEST_ASSERT_FALSE(
+      eeconfig_write_profile(0, sizeof(eeconfig_profile_t) - 1, &value, 2));
+  TEST_ASSERT_FALSE(eeconfig_copy_profile(0, NUM_PROFILES));
+  TEST_ASSERT_EQUAL_UINT32(0, write_count);
+}
+
+void test_eeconfig_ignores_records_past_the_delta_area(void) {
+  const eeconfig_profile_slot_t slot = {
+      .offset = EECONFIG_PROFILE_DELTAS_SIZE - 2,
+      .size = 4,
+  };
+  uint8_t value = 0xFF;
+
+  wear_leveling_write(offsetof(eeconfig_t, profile_slots) + sizeof(slot), &slot,
+                      sizeof(slot));
+  eeconfig_init();
+
+  TEST_ASSERT_TRUE(eeconfig_set_current_profile(1));
+  TEST_ASSERT_EQUAL_MEMORY(&eeconfig->base_profile, &CURRENT_PROFILE,
+                           sizeof(eeconfig_profile_t));
+  TEST_ASSERT_TRUE(EECONFIG_WRITE_PROFILE(1, tick_rate, &value));
+  TEST_ASSERT_EQUAL_UINT8(0xFF, CURRENT_PROFILE.tick_rate);
+}
+
+#if defined(KEY_INDEX_16BIT)
+// Built with more than 255 keys and linked with the migrations
+void test_eeconfig_wide_build_resets_an_earlier_configuration(void) {
+  static uint8_t reset_image[sizeof(eeconfig_t)];
+  const uint32_t magic_start = EECONFIG_MAGIC_START;
+  // Configuration written by a firmware with 8-bit key indices
+  const uint16_t earlier_version = EECONFIG_VERSION - 1;
+  eeconfig_profile_t expected;
+
+  memset(wl_cache, 0xA5, sizeof(wl_cache));
+  memcpy(&wl_cache[offsetof(eeconfig_t, magic_start)], &magic_start,
+         sizeof(magic_start));
+  memcpy(&wl_cache[offsetof(eeconfig_t, version)], &earlier_version,
+         sizeof(earlier_version));
+  eeconfig_init();
+
+  TEST_ASSERT_EQUAL_HEX16(EECONFIG_VERSION, eeconfig->version);
+  TEST_ASSERT_EQUAL_HEX32(EECONFIG_MAGIC_END, eeconfig->magic_end);
+  TEST_ASSERT_EQUAL_UINT8(0, eeconfig->current_profile);
+  TEST_ASSERT_EQUAL_UINT32(0, profile_storage_used());
+  TEST_ASSERT_EQUAL_UINT8(
+      DEFAULT_ACTUATION_POINT,
+      CURRENT_PROFILE.actuation_map[NUM_KEYS - 1].actuation_point);
+
+  // The reset image is read back as it is after a reboot
+  memcpy(reset_image, wl_cache, sizeof(reset_image));
+  write_count = 0;
+  eeconfig_init();
+  TEST_ASSERT_EQUAL_UINT32(0, write_count);
+  TEST_ASSERT_EQUAL_MEMORY(reset_image, wl_cache, sizeof(reset_image));
+  TEST_ASSERT_EQUAL_MEMORY(&eeconfig->base_profile, &CURRENT_PROFILE,
+                           sizeof(eeconfig_profile_t));
+
+  // Keys past 255 round-trip through the records
+  expected = CURRENT_PROFILE;
+  expected.keymap[0][NUM_KEYS - 1] = 0x04;
+  expected.actuation_map[NUM_KEYS - 1].actuation_point = 200;
+  expected.advanced_keys[0].type = AK_TYPE_NULL_BIND;
+  expected.advanced_keys[0].key = NUM_KEYS - 1;
+  expected.advanced_keys[0].null_bind.secondary_key = 256;
+  TEST_ASSERT_TRUE(eeconfig_write_profile(0, 0, &expected, sizeof(expected)));
+  eeconfig_init();
+  TEST_ASSERT_EQUAL_HEX16(EECONFIG_VERSION, eeconfig->version);
+  TEST_ASSERT_EQUAL_MEMORY(&expected, &CURRENT_PROFILE, sizeof(expected));
+  assert_profile_equal(&expected, 0);
+}
+#endif
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_eeconfig_reset_stores_default_profiles_without_records);
+  RUN_TEST(test_eeconfig_write_current_profile_updates_view_and_records);
+  RUN_TEST(test_eeconfig_nearby_changes_share_a_record);
+  RUN_TEST(test_eeconfig_switch_materialises_each_profile);
+  RUN_TEST(test_eeconfig_switch_is_saved_separately);
+  RUN_TEST(test_eeconfig_customised_profiles_fit_where_whole_copies_do_not);
+  RUN_TEST(test_eeconfig_unrelated_profile_is_stored_as_a_whole);
+  RUN_TEST(test_eeconfig_compacts_records_when_the_delta_area_is_full);
+  RUN_TEST(test_eeconfig_failed_write_keeps_current_view_in_sync);
+  RUN_TEST(test_eeconfig_write_that_does_not_fit_keeps_the_records);
+  RUN_TEST(test_eeconfig_copy_and_reset_profile);
+  RUN_TEST(test_eeconfig_rejects_out_of_range_access);
+  RUN_TEST(test_eeconfig_ignores_records_past_the_delta_area);
+#if defined(KEY_INDEX_16BIT)
+  RUN_TEST(test_eeconfig_wide_build_resets_an_earlier_configuration);
+#endif
+  return UNITY_END();
+}
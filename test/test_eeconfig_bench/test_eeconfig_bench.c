@@ -0,0 +1,106 @@
+#include <stdio.h>
+#include <time.h>
+#include <unity.h>
+
+#include "eeconfig.h"
+
+// Measures how long a profile switch takes to point `CURRENT_PROFILE` at the
+// view of the profile, for a profile equal to the base profile, a customised
+// profile, and a profile stored as a whole. The views are materialised from
+// the delta records when they are loaded or written, so the switch does not
+// depend on how the profile is stored. Copying a whole profile is the
+// reference, since that is what a switch into a single RAM view costs.
+
+// Each measurement is repeated this many times and the fastest run is kept,
+// which filters out host scheduling noise
+#define BENCH_REPEATS 200
+// Generous bound for a switch on the host, far above the measured cost
+#define BENCH_MAX_SWITCH_NS 100000u
+
+uint8_t wl_cache[WL_VIRTUAL_SIZE];
+
+static eeconfig_profile_t reference;
+static volatile uint8_t sink;
+
+bool wear_leveling_read(uint32_t addr, void *buf, uint32_t len) {
+  memcpy(buf, wl_cache + addr, len);
+  return true;
+}
+
+bool wear_leveling_write(uint32_t addr, const void *buf, uint32_t len) {
+  memcpy(wl_cache + addr, buf, len);
+  return true;
+}
+
+bool migration_try_migrate(void) { return false; }
+
+static uint64_t host_time_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t bench_switch_ns(uint8_t profile) {
+  uint64_t best_ns = UINT64_MAX;
+
+  for (uint32_t repeat = 0; repeat < BENCH_REPEATS; repeat++) {
+    TEST_ASSERT_TRUE(eeconfig_switch_profile(0));
+    const uint64_t start = host_time_ns();
+    TEST_ASSERT_TRUE(eeconfig_switch_profile(profile));
+    best_ns = M_MIN(best_ns, host_time_ns() - start);
+    sink = CURRENT_PROFILE.tick_rate;
+  }
+
+  return best_ns;
+}
+
+void setUp(void) {
+  memset(wl_cache, 0, sizeof(wl_cache));
+  eeconfig_init();
+}
+
+void tearDown(void) {}
+
+void test_eeconfig_bench_profile_switch(void) {
+  eeconfig_profile_t profile = eeconfig->base_profile;
+
+  // A remapped layer and a few settings
+  for (uint32_t i = 0; i < NUM_KEYS; i++)
+    profile.keymap[1][i] = (uint8_t)(0x04 + i);
+  profile.tick_rate = 10;
+#if defined(RGB_ENABLED)
+  profile.rgb_config.solid_color = (rgb_color_t){0, 255, 0};
+#endif
+  TEST_ASSERT_TRUE(eeconfig_write_profile(2, 0, &profile, sizeof(profile)));
+
+  memset(&profile, 0x5A, sizeof(profile));
+  TEST_ASSERT_TRUE(eeconfig_write_profile(3, 0, &profile, sizeof(profile)));
+
+  uint64_t copy_ns = UINT64_MAX;
+  for (uint32_t repeat = 0; repeat < BENCH_REPEATS; repeat++) {
+    const uint64_t start = host_time_ns();
+    memcpy(&reference, &profile, sizeof(reference));
+    copy_ns = M_MIN(copy_ns, host_time_ns() - start);
+    sink = reference.tick_rate;
+  }
+
+  const uint64_t base_ns = bench_switch_ns(1);
+  const uint64_t delta_ns = bench_switch_ns(2);
+  const uint64_t whole_ns = bench_switch_ns(3);
+
+  printf("profile switch (%u bytes): base %llu ns, %u bytes of records %llu "
+         "ns, whole %llu ns, copy %llu ns\n",
+         (unsigned)sizeof(eeconfig_profile_t), (unsigned long long)base_ns,
+         (unsigned)eeconfig->profile_slots[2].size,
+         (unsigned long long)delta_ns, (unsigned long long)whole_ns,
+         (unsigned long long)copy_ns);
+  TEST_ASSERT_TRUE(base_ns < BENCH_MAX_SWITCH_NS);
+  TEST_ASSERT_TRUE(delta_ns < BENCH_MAX_SWITCH_NS);
+  TEST_ASSERT_TRUE(whole_ns < BENCH_MAX_SWITCH_NS);
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_eeconfig_bench_profile_switch);
+  return UNITY_END();
+}
@@ -36,7 +36,7 @@ void HAL_GPIO_Init(GPIO_TypeDef *port, GPIO_InitTypeDef *init) {
   gpio_init_count++;
 }
 
-bool layout_process_key(uint8_t key, bool pressed) {
+bool layout_process_key(key_index_t key, bool pressed) {
   if (process_count < M_ARRAY_SIZE(processed_keys)) {
     processed_keys[process_count] = key;
     processed_pressed[process_count] = pressed;
@@ -7,12 +7,16 @@
 #include "keycodes.h"
 #include "layout.h"
 #include "matrix.h"
+#include "profile_runtime.h"
+
+#include "hardware/native/timer_sim.h"
 
 key_state_t key_matrix[NUM_KEYS];
 eeconfig_t mock_eeconfig;
 const eeconfig_t *eeconfig = &mock_eeconfig;
+eeconfig_profile_t mock_profile;
+const eeconfig_profile_t *eeconfig_profile = &mock_profile;
 
-static uint32_t mock_timer;
 static uint8_t hid_added[16];
 static uint8_t hid_removed[16];
 static uint8_t hid_add_count;
@@ -26,23 +30,31 @@ static void reset_hid_log(void) {
 }
 
 static void prepare_pipeline(void) {
-  layout_load_advanced_keys();
-  layout_reset_runtime_state();
+  profile_runtime_reload_current();
   reset_hid_log();
 }
 
-static void set_key_state(uint8_t key, bool pressed, uint32_t event_time,
-                          uint8_t distance) {
+static void set_key_state_us(key_index_t key, bool pressed,
+                             uint64_t event_time_us, uint8_t distance) {
   key_matrix[key].is_pressed = pressed;
-  key_matrix[key].event_time = event_time;
+  key_matrix[key].event_time = event_time_us;
   key_matrix[key].distance = distance;
 }
 
-static void run_layout_at(uint32_t time) {
-  mock_timer = time;
+static void set_key_state(key_index_t key, bool pressed, uint32_t event_time,
+                          uint8_t distance) {
+  set_key_state_us(key, pressed, (uint64_t)event_time * 1000u, distance);
+}
+
+static void run_layout_at_us(uint64_t time_us) {
+  timer_sim_set_us(time_us);
   layout_task();
 }
 
+static void run_layout_at(uint32_t time) {
+  run_layout_at_us((uint64_t)time * 1000u);
+}
+
 void board_enter_bootloader(void) {}
 void board_reset(void) {}
 
@@ -60,30 +72,54 @@ void hid_keycode_remove(uint8_t keycode) {
 
 void hid_mouse_move(int8_t x, int8_t y, uint8_t buttons) {}
 void hid_mouse_scroll(int8_t wheel, int8_t pan, uint8_t buttons) {}
+void hid_set_keyboard_report_clock(bool enabled) {}
 void hid_send_reports(void) {}
 
-void matrix_disable_rapid_trigger(uint8_t key, bool disable) {}
+void matrix_disable_rapid_trigger(key_index_t key, bool disable) {}
 
-void profile_runtime_apply_current(void) {}
-void profile_runtime_reload_current(void) {}
+bool wear_leveling_write(uint32_t address, const void *data, uint32_t len) {
+  return true;
+}
+
+bool eeconfig_write_profile(uint8_t profile, uint32_t offset, const void *buf,
+                            uint32_t len) {
+  return true;
+}
 
-uint32_t timer_read(void) { return mock_timer; }
-uint32_t timer_elapsed(uint32_t last) { return mock_timer - last; }
+uint8_t eeconfig_get_current_profile(void) {
+  return mock_eeconfig.current_profile;
+}
 
-bool wear_leveling_write(uint32_t address, const void *data, uint32_t len) {
+uint8_t eeconfig_get_last_non_default_profile(void) {
+  return mock_eeconfig.last_non_default_profile;
+}
+
+const eeconfig_profile_t *eeconfig_get_profile(uint8_t profile) {
+  return &mock_profile;
+}
+
+bool eeconfig_switch_profile(uint8_t profile) {
+  mock_eeconfig.current_profile = profile;
   return true;
 }
 
-void xinput_process(uint8_t key) {}
+bool eeconfig_save_current_profile(void) { return true; }
+
+bool wear_leveling_flush(void) { return true; }
+
+uint32_t matrix_get_idle_time(void) { return 0; }
+
+void xinput_process(key_index_t key) {}
 void xinput_reset_runtime_state(void) {}
 
 void setUp(void) {
   memset(&mock_eeconfig, 0, sizeof(mock_eeconfig));
+  memset(&mock_profile, 0, sizeof(mock_profile));
   memset(key_matrix, 0, sizeof(key_matrix));
-  mock_timer = 0;
+  timer_init();
   mock_eeconfig.current_profile = 0;
-  mock_eeconfig.profiles[0].gamepad_options.keyboard_enabled = true;
-  mock_eeconfig.profiles[0].tick_rate = 1;
+  mock_profile.gamepad_options.keyboard_enabled = true;
+  mock_profile.tick_rate = 1;
   advanced_key_init();
   deferred_action_init();
   prepare_pipeline();
@@ -92,8 +128,8 @@ void setUp(void) {
 void tearDown(void) {}
 
 void test_event_pipeline_sorts_simultaneous_press_order_by_distance(void) {
-  mock_eeconfig.profiles[0].keymap[0][1] = KC_B;
-  mock_eeconfig.profiles[0].keymap[0][2] = KC_A;
+  mock_profile.keymap[0][1] = KC_B;
+  mock_profile.keymap[0][2] = KC_A;
   prepare_pipeline();
 
   set_key_state(1, true, 10, 120);
@@ -106,8 +142,25 @@ void test_event_pipeline_sorts_simultaneous_press_order_by_distance(void) {
   TEST_ASSERT_EQUAL_UINT8(KC_B, hid_added[1]);
 }
 
+void test_event_pipeline_orders_presses_within_the_same_millisecond(void) {
+  mock_profile.keymap[0][1] = KC_B;
+  mock_profile.keymap[0][2] = KC_A;
+  prepare_pipeline();
+
+  // Consecutive scans of an 8 kHz scan loop are ordered by time, even though
+  // the second press has the larger distance
+  set_key_state_us(1, true, 10000, 120);
+  set_key_state_us(2, true, 10125, 200);
+
+  run_layout_at_us(10250);
+
+  TEST_ASSERT_EQUAL_UINT8(2, hid_add_count);
+  TEST_ASSERT_EQUAL_UINT8(KC_B, hid_added[0]);
+  TEST_ASSERT_EQUAL_UINT8(KC_A, hid_added[1]);
+}
+
 void test_event_pipeline_buffers_non_tap_hold_press_until_hold_resolves(void) {
-  advanced_key_t *tap_hold = &mock_eeconfig.profiles[0].advanced_keys[0];
+  advanced_key_t *tap_hold = &mock_profile.advanced_keys[0];
 
   tap_hold->type = AK_TYPE_TAP_HOLD;
   tap_hold->layer = 0;
@@ -117,7 +170,7 @@ void test_event_pipeline_buffers_non_tap_hold_press_until_hold_resolves(void) {
   tap_hold->tap_hold.tapping_term = 100;
   tap_hold->tap_hold.flags =
       TH_MAKE_FLAGS(TAP_HOLD_FLAVOR_HOLD_PREFERRED, false, false);
-  mock_eeconfig.profiles[0].keymap[0][1] = KC_A;
+  mock_profile.keymap[0][1] = KC_A;
   prepare_pipeline();
 
   set_key_state(0, true, 10, 180);
@@ -134,7 +187,7 @@ void test_event_pipeline_buffers_non_tap_hold_press_until_hold_resolves(void) {
 }
 
 void test_event_pipeline_keeps_pending_press_and_release_paired(void) {
-  advanced_key_t *tap_hold = &mock_eeconfig.profiles[0].advanced_keys[0];
+  advanced_key_t *tap_hold = &mock_profile.advanced_keys[0];
 
   tap_hold->type = AK_TYPE_TAP_HOLD;
   tap_hold->layer = 0;
@@ -144,7 +197,7 @@ void test_event_pipeline_keeps_pending_press_and_release_paired(void) {
   tap_hold->tap_hold.tapping_term = 100;
   tap_hold->tap_hold.flags =
       TH_MAKE_FLAGS(TAP_HOLD_FLAVOR_TAP_PREFERRED, false, false);
-  mock_eeconfig.profiles[0].keymap[0][1] = KC_A;
+  mock_profile.keymap[0][1] = KC_A;
   prepare_pipeline();
 
   set_key_state(0, true, 10, 180);
@@ -177,18 +230,18 @@ void test_event_pipeline_keeps_pending_press_and_release_paired(void) {
 }
 
 void test_event_pipeline_flushes_unmatched_combo_as_normal_input(void) {
-  advanced_key_t *combo = &mock_eeconfig.profiles[0].advanced_keys[0];
+  advanced_key_t *combo = &mock_profile.advanced_keys[0];
 
   combo->type = AK_TYPE_COMBO;
   combo->layer = 0;
   combo->combo.keys[0] = 1;
   combo->combo.keys[1] = 2;
-  combo->combo.keys[2] = 255;
-  combo->combo.keys[3] = 255;
+  combo->combo.keys[2] = KEY_INDEX_NONE;
+  combo->combo.keys[3] = KEY_INDEX_NONE;
   combo->combo.term = 50;
   combo->combo.output_keycode = KC_C;
-  mock_eeconfig.profiles[0].keymap[0][1] = KC_A;
-  mock_eeconfig.profiles[0].keymap[0][2] = KC_B;
+  mock_profile.keymap[0][1] = KC_A;
+  mock_profile.keymap[0][2] = KC_B;
   prepare_pipeline();
 
   set_key_state(1, true, 10, 180);
@@ -209,6 +262,7 @@ void test_event_pipeline_flushes_unmatched_combo_as_normal_input(void) {
 int main(void) {
   UNITY_BEGIN();
   RUN_TEST(test_event_pipeline_sorts_simultaneous_press_order_by_distance);
+  RUN_TEST(test_event_pipeline_orders_presses_within_the_same_millisecond);
   RUN_TEST(test_event_pipeline_buffers_non_tap_hold_press_until_hold_resolves);
   RUN_TEST(test_event_pipeline_keeps_pending_press_and_release_paired);
   RUN_TEST(test_event_pipeline_flushes_unmatched_combo_as_normal_input);
@@ -0,0 +1,286 @@
+#include <stdio.h>
+#include <unity.h>
+
+#include "eeconfig.h"
+#include "hardware/native/flash_sim.h"
+#include "wear_leveling.h"
+
+// Replays scripted configurator sessions through `eeconfig` and the wear
+// leveling module onto the simulated flash of the board under test, and
+// reports the flash work they cause: bytes programmed, sector erases, the
+// longest stall of a configuration command and of a main loop iteration, and
+// how long the most erased sector lasts at that pace.
+
+// Sessions are replayed until the most erased sector has been through this
+// many erase cycles, so the projection covers several consolidations
+#define BENCH_MIN_SECTOR_ERASES 4u
+#define BENCH_MAX_SESSIONS 20000u
+// Sessions a day of a user who keeps tweaking their keyboard, for the lifetime
+// projection
+#define BENCH_SESSIONS_PER_DAY 10u
+// The flash must outlast this many years at that pace
+#define BENCH_MIN_LIFETIME_YEARS 10u
+// Words a main loop iteration may program besides erasing a sector: a
+// consolidation step and the entries of a full range list
+#define BENCH_MAX_STEP_WORDS                                                   \
+  (32u + WL_WRITE_BACK_MAX_RANGES * WL_LOG_ENTRY_MAX_SIZE / 4u)
+
+static uint32_t sim_clock_ms;
+static uint32_t sim_reload_count;
+
+static struct {
+  // Longest stall of a configuration command and of a main loop iteration
+  uint32_t max_command_us;
+  uint32_t max_task_us;
+  // Configuration commands that erased a sector
+  uint32_t erasing_commands;
+  uint32_t commands;
+} bench;
+
+void board_error_handler(void) { TEST_FAIL_MESSAGE("board error handler"); }
+
+uint32_t timer_read(void) { return sim_clock_ms; }
+
+// Run the wear leveling task as the main loop does, counting the times the
+// virtual storage has been loaded again
+static void run_task(void) {
+  if (wear_leveling_task())
+    sim_reload_count++;
+}
+
+bool migration_try_migrate(void) { return false; }
+
+// Run the main loop for `ms` milliseconds, one iteration per millisecond
+static void run_ms(uint32_t ms) {
+  for (uint32_t i = 0; i < ms; i++) {
+    const uint64_t start = flash_sim_stats()->busy_us;
+
+    sim_clock_ms++;
+    run_task();
+    bench.max_task_us = M_MAX(bench.max_task_us,
+                              (uint32_t)(flash_sim_stats()->busy_us - start));
+  }
+}
+
+// Account for a configuration command, which `status` is the result of. The
+// command started when the flash had been busy for `start` microseconds and
+// had erased `erases` sectors.
+static void end_command(bool status, uint64_t start, uint32_t erases) {
+  TEST_ASSERT_TRUE(status);
+  bench.max_command_us = M_MAX(bench.max_command_us,
+                               (uint32_t)(flash_sim_stats()->busy_us - start));
+  bench.erasing_commands += flash_sim_stats()->erases != erases;
+  bench.commands++;
+}
+
+#define COMMAND(call)                                                          \
+  do {                                                                         \
+    const uint64_t _start = flash_sim_stats()->busy_us;                        \
+    const uint32_t _erases = flash_sim_stats()->erases;                        \
+    end_command(call, _start, _erases);                                        \
+  } while (0)
+
+static void power_cycle(void) {
+  memset(wl_cache, 0, WL_CACHE_SIZE);
+  wear_leveling_init();
+  eeconfig_init();
+  run_ms(1);
+}
+
+//--------------------------------------------------------------------+
+// Configurator Sessions
+//--------------------------------------------------------------------+
+
+// Remap a few keys of a layer, one key per command
+static void keymap_session(uint32_t session, uint8_t profile) {
+  const uint8_t layer = (uint8_t)(1 + session % (NUM_LAYERS - 1));
+
+  for (uint32_t i = 0; i < 6; i++) {
+    const uint32_t key = (session + i * 3) % NUM_KEYS;
+    const uint8_t keycode = (uint8_t)(0x04 + (session * 7 + i) % 0x60);
+
+    COMMAND(eeconfig_write_profile(
+        profile, offsetof(eeconfig_profile_t, keymap[layer][key]), &keycode,
+        sizeof(keycode)));
+    run_ms(400);
+  }
+}
+
+// Drag the actuation point slider, which sets every key at once
+static void actuation_session(uint32_t session, uint8_t profile) {
+  actuation_t actuation_map[NUM_KEYS];
+
+  COMMAND(eeconfig_read_profile(profile,
+                                offsetof(eeconfig_profile_t, actuation_map),
+                                actuation_map, sizeof(actuation_map)));
+  for (uint32_t i = 0; i < 30; i++) {
+    for (uint32_t key = 0; key < NUM_KEYS; key++)
+      actuation_map[key].actuation_point = (uint8_t)(40 + (session + i) % 160);
+
+    COMMAND(EECONFIG_WRITE_PROFILE(profile, actuation_map, actuation_map));
+    run_ms(30);
+  }
+}
+
+// Drag the brightness slider and pick a color
+static void rgb_session(uint32_t session, uint8_t profile) {
+  for (uint32_t i = 0; i < 60; i++) {
+    const uint8_t brightness = (uint8_t)(session * 3 + i * 4);
+
+    COMMAND(EECONFIG_WRITE_PROFILE(profile, rgb_config.global_brightness,
+                                   &brightness));
+    run_ms(20);
+  }
+
+  const rgb_color_t color = {(uint8_t)session, 128, (uint8_t)(255 - session)};
+  COMMAND(EECONFIG_WRITE_PROFILE(profile, rgb_config.solid_color, &color));
+  run_ms(500);
+}
+
+// Toggle an option and save the bottom-out thresholds learned while typing
+static void global_session(uint32_t session) {
+  eeconfig_options_t options = eeconfig->options;
+  uint16_t bottom_out_threshold[NUM_KEYS];
+
+  options.continuous_calibration = session & 1;
+  COMMAND(EECONFIG_WRITE(options, &options));
+  for (uint32_t i = 0; i < NUM_KEYS; i++)
+    bottom_out_threshold[i] = (uint16_t)(600 + (session * 13 + i) % 100);
+  COMMAND(EECONFIG_WRITE(bottom_out_threshold, bottom_out_threshold));
+  run_ms(200);
+}
+
+// A configurator session: switch to a profile, edit it, and switch back
+static void configurator_session(uint32_t session) {
+  const uint8_t profile = (uint8_t)(1 + session % (NUM_PROFILES - 1));
+
+  COMMAND(eeconfig_set_current_profile(profile));
+  run_ms(1000);
+  keymap_session(session, profile);
+  actuation_session(session, profile);
+  rgb_session(session, profile);
+  global_session(session);
+  COMMAND(eeconfig_set_current_profile(0));
+  // The configurator is closed and the keyboard is used for a while
+  run_ms(WL_WRITE_BACK_DELAY_MS + 5000);
+}
+
+void setUp(void) {
+  flash_sim_reset();
+  memset(&bench, 0, sizeof(bench));
+  sim_clock_ms = 0;
+  sim_reload_count = 0;
+  wear_leveling_init();
+  eeconfig_init();
+  TEST_ASSERT_TRUE(eeconfig_reset());
+  TEST_ASSERT_TRUE(wear_leveling_flush());
+  run_ms(1);
+  // Only the sessions are measured, not formatting the store
+  flash_sim_clear_stats();
+}
+
+void tearDown(void) {}
+
+void test_flash_wear_bench_configurator_sessions(void) {
+  static eeconfig_profile_t expected[NUM_PROFILES];
+
+  uint32_t sessions = 0;
+  while (flash_sim_max_sector_erases() < BENCH_MIN_SECTOR_ERASES &&
+         sessions < BENCH_MAX_SESSIONS)
+    configurator_session(sessions++);
+
+  const flash_sim_stats_t *stats = flash_sim_stats();
+  const uint32_t max_erases = flash_sim_max_sector_erases();
+  uint32_t bank_sectors = 0, max_sector_size = 0;
+  for (uint32_t i = 0; i < FLASH_NUM_SECTORS; i++) {
+    if (stats->sector_erases[i] == 0)
+      continue;
+    bank_sectors++;
+    max_sector_size = M_MAX(max_sector_size, flash_sector_size(i));
+  }
+
+  printf("%u sessions, %u commands: %llu bytes programmed (%llu per "
+         "session), %u erases over %u sectors of up to %u bytes\n",
+         (unsigned)sessions, (unsigned)bench.commands,
+         (unsigned long long)stats->programmed_words * 4,
+         (unsigned long long)stats->programmed_words * 4 / sessions,
+         (unsigned)stats->erases, (unsigned)bank_sectors,
+         (unsigned)max_sector_size);
+  printf("longest stall: command %u us, main loop iteration %u us\n",
+         (unsigned)bench.max_command_us, (unsigned)bench.max_task_us);
+
+  TEST_ASSERT_TRUE(max_erases >= BENCH_MIN_SECTOR_ERASES);
+  const uint64_t lifetime_sessions =
+      (uint64_t)FLASH_SIM_ENDURANCE_CYCLES * sessions / max_erases;
+  const uint64_t lifetime_days = lifetime_sessions / BENCH_SESSIONS_PER_DAY;
+  printf("most erased sector: %u erases, %u cycles rated: %llu sessions, "
+         "%llu years at %u sessions a day\n",
+         (unsigned)max_erases, (unsigned)FLASH_SIM_ENDURANCE_CYCLES,
+         (unsigned long long)lifetime_sessions,
+         (unsigned long long)(lifetime_days / 365),
+         (unsigned)BENCH_SESSIONS_PER_DAY);
+
+  // Configuration commands never erase, and a main loop iteration erases at
+  // most one sector besides a consolidation step and a few log entries
+  TEST_ASSERT_EQUAL_UINT32(0, bench.erasing_commands);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(
+      max_sector_size / 1024 * FLASH_SIM_ERASE_US_PER_KB +
+          BENCH_MAX_STEP_WORDS * FLASH_SIM_PROGRAM_WORD_US,
+      bench.max_task_us);
+  TEST_ASSERT_EQUAL_UINT32(0, stats->program_violations);
+  TEST_ASSERT_TRUE(lifetime_days >= BENCH_MIN_LIFETIME_YEARS * 365u);
+
+  // Everything the sessions wrote survives a power cycle
+  for (uint8_t p = 0; p < NUM_PROFILES; p++)
+    TEST_ASSERT_TRUE(
+        eeconfig_read_profile(p, 0, &expected[p], sizeof(expected[p])));
+  TEST_ASSERT_TRUE(wear_leveling_flush());
+  power_cycle();
+  for (uint8_t p = 0; p < NUM_PROFILES; p++) {
+    eeconfig_profile_t actual;
+    TEST_ASSERT_TRUE(eeconfig_read_profile(p, 0, &actual, sizeof(actual)));
+    TEST_ASSERT_EQUAL_MEMORY(&expected[p], &actual, sizeof(actual));
+  }
+  TEST_ASSERT_EQUAL_UINT32(0, sim_reload_count);
+}
+
+void test_flash_wear_bench_power_loss_during_sessions(void) {
+  eeconfig_profile_t default_profile, actual;
+  uint32_t cuts = 0;
+
+  TEST_ASSERT_TRUE(eeconfig_read_profile(0, 0, &default_profile,
+                                         sizeof(default_profile)));
+
+  // Every few sessions, cut the power somewhere into the session, until the
+  // store has gone through a consolidation
+  for (uint32_t session = 0; flash_sim_stats()->erases == 0; session++) {
+    TEST_ASSERT_TRUE(session < BENCH_MAX_SESSIONS);
+    if (session % 8 == 7)
+      flash_sim_cut_power_after(session * 13u % 64u);
+    configurator_session(session);
+    if (!flash_sim_power_lost()) {
+      flash_sim_restore_power();
+      continue;
+    }
+
+    cuts++;
+    flash_sim_restore_power();
+    power_cycle();
+    // The store boots from an intact bank, and the profile no session edits
+    // is still there
+    TEST_ASSERT_EQUAL_UINT32(0, sim_reload_count);
+    TEST_ASSERT_TRUE(eeconfig_read_profile(0, 0, &actual, sizeof(actual)));
+    TEST_ASSERT_EQUAL_MEMORY(&default_profile, &actual, sizeof(actual));
+  }
+
+  printf("power loss: %u cuts before the first consolidation was done\n",
+         (unsigned)cuts);
+  TEST_ASSERT_GREATER_THAN_UINT32(0, cuts);
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_flash_wear_bench_configurator_sessions);
+  RUN_TEST(test_flash_wear_bench_power_loss_during_sessions);
+  return UNITY_END();
+}
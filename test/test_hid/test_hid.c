@@ -33,6 +33,7 @@ static uint8_t raw_hid_reports[8][RAW_HID_EP_SIZE];
 static uint8_t raw_hid_report_count;
 static uint8_t last_command_packet[RAW_HID_EP_SIZE];
 static uint16_t last_command_packet_len;
+static uint32_t keyboard_report_complete_count;
 
 const uint16_t keycode_to_hid[256] = {
     [KC_A] = 0x0004,
@@ -57,6 +58,10 @@ void command_process(const uint8_t *buffer) {
   (void)buffer;
 }
 
+void advanced_key_keyboard_report_complete(void) {
+  keyboard_report_complete_count++;
+}
+
 uint32_t timer_read(void) { return mock_timer++; }
 
 uint32_t board_cycle_count(void) {
@@ -143,6 +148,7 @@ static void reset_observations(void) {
   raw_hid_report_count = 0;
   memset(last_command_packet, 0, sizeof(last_command_packet));
   last_command_packet_len = 0;
+  keyboard_report_complete_count = 0;
 }
 
 void setUp(void) {
@@ -260,6 +266,46 @@ void test_hid_replays_release_after_keyboard_recovers(void) {
   TEST_ASSERT_BITS_LOW(1u << 4, keyboard_reports[1].bitmap[0]);
 }
 
+void test_hid_keyboard_report_clock_resends_last_report(void) {
+  hid_keycode_add(KC_A);
+  hid_send_reports();
+  TEST_ASSERT_EQUAL_UINT32(1, report_count);
+
+  // Nothing changed, so the keyboard interface goes idle
+  tud_hid_report_complete_cb(USB_ITF_KEYBOARD,
+                             (const uint8_t *)&keyboard_reports[0],
+                             sizeof(hid_nkro_kb_report_t));
+  TEST_ASSERT_EQUAL_UINT32(1, report_count);
+  TEST_ASSERT_EQUAL_UINT32(1, keyboard_report_complete_count);
+
+  hid_set_keyboard_report_clock(true);
+  hid_send_reports();
+  tud_hid_report_complete_cb(USB_ITF_KEYBOARD,
+                             (const uint8_t *)&keyboard_reports[1],
+                             sizeof(hid_nkro_kb_report_t));
+  TEST_ASSERT_EQUAL_UINT32(3, report_count);
+  TEST_ASSERT_EQUAL_UINT8(3, keyboard_report_count);
+  TEST_ASSERT_EQUAL_MEMORY(&keyboard_reports[0], &keyboard_reports[1],
+                           sizeof(hid_nkro_kb_report_t));
+  TEST_ASSERT_EQUAL_MEMORY(&keyboard_reports[0], &keyboard_reports[2],
+                           sizeof(hid_nkro_kb_report_t));
+
+  // A change is sent instead of the last report
+  hid_keycode_remove(KC_A);
+  tud_hid_report_complete_cb(USB_ITF_KEYBOARD,
+                             (const uint8_t *)&keyboard_reports[2],
+                             sizeof(hid_nkro_kb_report_t));
+  TEST_ASSERT_EQUAL_UINT8(4, keyboard_report_count);
+  TEST_ASSERT_BITS_LOW(1u << 4, keyboard_reports[3].bitmap[0]);
+
+  hid_set_keyboard_report_clock(false);
+  tud_hid_report_complete_cb(USB_ITF_KEYBOARD,
+                             (const uint8_t *)&keyboard_reports[3],
+                             sizeof(hid_nkro_kb_report_t));
+  TEST_ASSERT_EQUAL_UINT32(4, report_count);
+  TEST_ASSERT_EQUAL_UINT32(4, keyboard_report_complete_count);
+}
+
 void test_hid_sends_repeated_mouse_motion_reports(void) {
   hid_mouse_move(3, -2, 0);
   hid_send_reports();
@@ -397,6 +443,7 @@ int main(void) {
   RUN_TEST(test_hid_send_reports_is_non_blocking_per_interface);
   RUN_TEST(test_hid_preserves_transient_keyboard_taps_while_interface_busy);
   RUN_TEST(test_hid_replays_release_after_keyboard_recovers);
+  RUN_TEST(test_hid_keyboard_report_clock_resends_last_report);
   RUN_TEST(test_hid_sends_repeated_mouse_motion_reports);
   RUN_TEST(test_hid_accumulates_mouse_motion_while_interface_busy);
   RUN_TEST(test_hid_accumulates_mouse_scroll_while_interface_busy);
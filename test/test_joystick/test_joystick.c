@@ -7,6 +7,8 @@
 
 static eeconfig_t mock_eeconfig;
 const eeconfig_t *eeconfig = &mock_eeconfig;
+static eeconfig_profile_t mock_profile;
+const eeconfig_profile_t *eeconfig_profile = &mock_profile;
 
 static uint16_t analog_raw_values[2];
 static uint32_t mock_time = 0;
@@ -73,8 +75,14 @@ void hid_mouse_scroll(int8_t wheel, int8_t pan, uint8_t buttons) {
 void hid_clear_runtime_state(void) {}
 void hid_send_reports(void) {}
 
-bool wear_leveling_write(uint32_t addr, const void *buf, uint32_t len) {
-  (void)addr;
+uint8_t eeconfig_get_current_profile(void) {
+  return mock_eeconfig.current_profile;
+}
+
+bool eeconfig_write_profile(uint8_t profile, uint32_t offset, const void *buf,
+                            uint32_t len) {
+  (void)profile;
+  (void)offset;
   (void)buf;
   (void)len;
   return true;
@@ -129,6 +137,7 @@ static void reset_reports(void) {
 
 void setUp(void) {
   memset(&mock_eeconfig, 0, sizeof(mock_eeconfig));
+  memset(&mock_profile, 0, sizeof(mock_profile));
   analog_raw_values[0] = 2048;
   analog_raw_values[1] = 2048;
   mock_sw_pin_state = GPIO_PIN_SET;
@@ -138,7 +147,7 @@ void setUp(void) {
 
   mock_eeconfig.current_profile = 0;
   mock_eeconfig.options.sniper_mode_multiplier = 128;
-  mock_eeconfig.profiles[0].joystick_config =
+  mock_profile.joystick_config =
       joystick_test_config(JOYSTICK_MODE_MOUSE);
   joystick_init();
 }
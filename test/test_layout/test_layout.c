@@ -18,9 +18,18 @@
 key_state_t key_matrix[NUM_KEYS];
 eeconfig_t mock_eeconfig;
 const eeconfig_t *eeconfig = &mock_eeconfig;
+eeconfig_profile_t mock_profile;
+const eeconfig_profile_t *eeconfig_profile = &mock_profile;
 uint32_t mock_timer = 0;
 uint32_t board_reset_count = 0;
 uint32_t wear_leveling_write_count = 0;
+uint32_t wear_leveling_flush_count = 0;
+uint32_t profile_write_count = 0;
+uint32_t switch_profile_count = 0;
+uint32_t save_current_profile_count = 0;
+uint8_t mock_current_profile = 0;
+uint8_t mock_last_non_default_profile = 0;
+uint32_t mock_idle_time = 0;
 uint32_t last_write_address = 0;
 uint32_t last_write_len = 0;
 uint32_t last_write_u32 = 0;
@@ -39,10 +48,10 @@ void advanced_key_init(void) {}
 void advanced_key_clear(void) {}
 void advanced_key_process(const advanced_key_event_t *event) {}
 void advanced_key_tick(bool has_non_tap_hold_press, bool has_non_tap_hold_release) {}
-bool advanced_key_combo_process(uint8_t key, bool pressed, uint32_t time) { return false; }
+bool advanced_key_combo_process(key_index_t key, bool pressed, uint64_t time) { return false; }
 bool advanced_key_combo_task(void) { return false; }
 void advanced_key_combo_invalidate_cache(void) {}
-void advanced_key_update_last_key_time(uint32_t time) {}
+void advanced_key_update_last_key_time(uint64_t time) {}
 bool advanced_key_has_undecided(void) { return false; }
 void advanced_key_abort_macros(void) {}
 
@@ -53,12 +62,52 @@ void deferred_action_clear(void) { deferred_action_clear_count++; }
 void board_enter_bootloader(void) {}
 void board_reset(void) { board_reset_count++; }
 uint32_t timer_read(void) { return mock_timer; }
-bool wear_leveling_write(uint32_t address, const void *data, uint32_t len) {
-    wear_leveling_write_count++;
+uint64_t timer_read_us(void) { return (uint64_t)mock_timer * 1000u; }
+static void record_write(uint32_t address, const void *data, uint32_t len) {
     last_write_address = address;
     last_write_len = len;
     last_write_u32 = 0;
     memcpy(&last_write_u32, data, len > sizeof(last_write_u32) ? sizeof(last_write_u32) : len);
+}
+bool wear_leveling_write(uint32_t address, const void *data, uint32_t len) {
+    wear_leveling_write_count++;
+    record_write(address, data, len);
+    return true;
+}
+bool eeconfig_write_profile(uint8_t profile, uint32_t offset, const void *buf,
+                            uint32_t len) {
+    TEST_ASSERT_EQUAL_UINT8(mock_current_profile, profile);
+    profile_write_count++;
+    record_write(offset, buf, len);
+    return true;
+}
+uint8_t eeconfig_get_current_profile(void) { return mock_current_profile; }
+uint8_t eeconfig_get_last_non_default_profile(void) {
+    return mock_last_non_default_profile;
+}
+const eeconfig_profile_t *eeconfig_get_profile(uint8_t profile) {
+    return &mock_profile;
+}
+bool eeconfig_switch_profile(uint8_t profile) {
+    if (profile >= NUM_PROFILES) {
+        return false;
+    }
+    switch_profile_count++;
+    mock_current_profile = profile;
+    if (profile != 0) {
+        mock_last_non_default_profile = profile;
+    }
+    return true;
+}
+bool eeconfig_save_current_profile(void) {
+    save_current_profile_count++;
+    mock_eeconfig.current_profile = mock_current_profile;
+    mock_eeconfig.last_non_default_profile = mock_last_non_default_profile;
+    return true;
+}
+uint32_t matrix_get_idle_time(void) { return mock_idle_time; }
+bool wear_leveling_flush(void) {
+    wear_leveling_flush_count++;
     return true;
 }
 
@@ -75,7 +124,7 @@ void hid_keycode_remove(uint8_t keycode) {
 void hid_send_reports(void) {}
 void hid_clear_runtime_state(void) { hid_clear_runtime_state_count++; }
 
-void xinput_process(uint8_t key) {
+void xinput_process(key_index_t key) {
     if (xinput_process_count < 8) {
         xinput_processed[xinput_process_count++] = key;
     }
@@ -114,10 +163,18 @@ void joystick_set_config(joystick_config_t config) { mock_joystick_config = conf
 // --- Tests ---
 void setUp(void) {
     memset(&mock_eeconfig, 0, sizeof(eeconfig_t));
+    memset(&mock_profile, 0, sizeof(eeconfig_profile_t));
     memset(key_matrix, 0, sizeof(key_matrix));
     mock_timer = 0;
     board_reset_count = 0;
     wear_leveling_write_count = 0;
+    wear_leveling_flush_count = 0;
+    profile_write_count = 0;
+    switch_profile_count = 0;
+    save_current_profile_count = 0;
+    mock_current_profile = 0;
+    mock_last_non_default_profile = 0;
+    mock_idle_time = 0;
     last_write_address = 0;
     last_write_len = 0;
     last_write_u32 = 0;
@@ -131,11 +188,11 @@ void setUp(void) {
     hid_remove_count = 0;
     memset(xinput_processed, 0, sizeof(xinput_processed));
     xinput_process_count = 0;
-    mock_eeconfig.profiles[0].gamepad_options.keyboard_enabled = true;
+    mock_profile.gamepad_options.keyboard_enabled = true;
 #if defined(RGB_ENABLED)
     memset(&mock_rgb_config, 0, sizeof(mock_rgb_config));
-    mock_eeconfig.profiles[0].rgb_config.enabled = 1;
-    mock_eeconfig.profiles[0].rgb_config.current_effect = RGB_EFFECT_SOLID_COLOR;
+    mock_profile.rgb_config.enabled = 1;
+    mock_profile.rgb_config.current_effect = RGB_EFFECT_SOLID_COLOR;
 #endif
 #if defined(JOYSTICK_ENABLED)
     joystick_init_default_config(&mock_joystick_config);
@@ -148,7 +205,7 @@ void tearDown(void) {
 
 void test_layout_process_key(void) {
     // Basic test: Register a normal key and see if layout processing goes through
-    mock_eeconfig.profiles[0].keymap[0][1] = 0x04; // KC_A
+    mock_profile.keymap[0][1] = 0x04; // KC_A
     bool has_press = layout_process_key(1, true); // press key index 1
     
     // As it is KC_A (0x04) which is a regular key, not tap-hold
@@ -156,7 +213,7 @@ void test_layout_process_key(void) {
 }
 
 void test_layout_process_key_release_counts_as_non_tap_hold_event(void) {
-    mock_eeconfig.profiles[0].keymap[0][1] = KC_A;
+    mock_profile.keymap[0][1] = KC_A;
 
     TEST_ASSERT_TRUE(layout_process_key(1, true));
     TEST_ASSERT_TRUE(layout_process_key(1, false));
@@ -171,6 +228,7 @@ void test_poll_rate_toggle_persists_options_and_resets(void) {
     TEST_ASSERT_EQUAL_UINT32(1, wear_leveling_write_count);
     TEST_ASSERT_EQUAL_UINT32(offsetof(eeconfig_t, options), last_write_address);
     TEST_ASSERT_EQUAL_UINT32(sizeof(eeconfig_options_t), last_write_len);
+    TEST_ASSERT_EQUAL_UINT32(1, wear_leveling_flush_count);
     TEST_ASSERT_EQUAL_UINT32(1, board_reset_count);
 
     eeconfig_options_t written_options = {.raw = last_write_u32};
@@ -182,15 +240,39 @@ void test_poll_rate_toggle_persists_options_and_resets(void) {
 void test_profile_switch_resets_runtime_state(void) {
     layout_register(INPUT_ROUTING_VIRTUAL_KEY, PF(1));
 
-    TEST_ASSERT_EQUAL_UINT32(2, wear_leveling_write_count);
+    TEST_ASSERT_EQUAL_UINT32(1, switch_profile_count);
+    TEST_ASSERT_EQUAL_UINT8(1, mock_current_profile);
+    TEST_ASSERT_EQUAL_UINT8(1, mock_last_non_default_profile);
+    // The switch itself does not write to the storage
+    TEST_ASSERT_EQUAL_UINT32(0, save_current_profile_count);
+    TEST_ASSERT_EQUAL_UINT32(0, wear_leveling_write_count);
     TEST_ASSERT_EQUAL_UINT32(1, deferred_action_clear_count);
     TEST_ASSERT_EQUAL_UINT32(1, hid_clear_runtime_state_count);
     TEST_ASSERT_EQUAL_UINT32(1, xinput_reset_runtime_state_count);
 }
 
+void test_profile_switch_is_saved_once_idle(void) {
+    layout_register(INPUT_ROUTING_VIRTUAL_KEY, PF(2));
+
+    mock_idle_time = 100;
+    layout_task();
+    TEST_ASSERT_EQUAL_UINT32(0, save_current_profile_count);
+    TEST_ASSERT_EQUAL_UINT8(0, mock_eeconfig.current_profile);
+
+    mock_idle_time = 3000;
+    layout_task();
+    TEST_ASSERT_EQUAL_UINT32(1, save_current_profile_count);
+    TEST_ASSERT_EQUAL_UINT8(2, mock_eeconfig.current_profile);
+    TEST_ASSERT_EQUAL_UINT8(2, mock_eeconfig.last_non_default_profile);
+
+    // Nothing is left to save
+    layout_task();
+    TEST_ASSERT_EQUAL_UINT32(1, save_current_profile_count);
+}
+
 void test_layout_sorts_same_timestamp_presses_by_distance(void) {
-    mock_eeconfig.profiles[0].keymap[0][1] = KC_B;
-    mock_eeconfig.profiles[0].keymap[0][2] = KC_A;
+    mock_profile.keymap[0][1] = KC_B;
+    mock_profile.keymap[0][2] = KC_A;
 
     key_matrix[1].is_pressed = true;
     key_matrix[1].event_time = 10;
@@ -209,10 +291,11 @@ void test_layout_sorts_same_timestamp_presses_by_distance(void) {
 
 void test_layout_processes_gamepad_keys_when_xinput_disabled(void) {
     mock_eeconfig.options.xinput_enabled = false;
-    mock_eeconfig.profiles[0].keymap[0][1] = KC_A;
-    mock_eeconfig.profiles[0].gamepad_buttons[1] = GP_BUTTON_A;
-    mock_eeconfig.profiles[0].gamepad_options.keyboard_enabled = false;
-    mock_eeconfig.profiles[0].gamepad_options.gamepad_override = true;
+    mock_profile.keymap[0][1] = KC_A;
+    mock_profile.gamepad_buttons[1] = GP_BUTTON_A;
+    mock_profile.gamepad_options.keyboard_enabled = false;
+    mock_profile.gamepad_options.gamepad_override = true;
+    layout_init();
 
     key_matrix[1].is_pressed = true;
     key_matrix[1].event_time = 5;
@@ -226,19 +309,17 @@ void test_layout_processes_gamepad_keys_when_xinput_disabled(void) {
 
 #if defined(RGB_ENABLED)
 void test_rgb_effect_next_persists_and_updates_live_config(void) {
-    mock_eeconfig.profiles[0].rgb_config.current_effect = RGB_EFFECT_SOLID_COLOR;
+    mock_profile.rgb_config.current_effect = RGB_EFFECT_SOLID_COLOR;
     layout_init();
-    wear_leveling_write_count = 0;
+    profile_write_count = 0;
     rgb_apply_config_count = 0;
 
     layout_register(INPUT_ROUTING_VIRTUAL_KEY, SP_RGB_EFFECT_NEXT);
 
-    TEST_ASSERT_EQUAL_UINT32(1, wear_leveling_write_count);
-    TEST_ASSERT_EQUAL_UINT32(
-        offsetof(eeconfig_t, profiles) +
-            offsetof(eeconfig_profile_t, rgb_config) +
-            offsetof(rgb_config_t, current_effect),
-        last_write_address);
+    TEST_ASSERT_EQUAL_UINT32(1, profile_write_count);
+    TEST_ASSERT_EQUAL_UINT32(offsetof(eeconfig_profile_t, rgb_config) +
+                                 offsetof(rgb_config_t, current_effect),
+                             last_write_address);
     TEST_ASSERT_EQUAL_UINT32(sizeof(uint8_t), last_write_len);
     TEST_ASSERT_EQUAL_UINT8(RGB_EFFECT_ALPHAS_MODS, last_write_u32);
     TEST_ASSERT_EQUAL_UINT8(RGB_EFFECT_ALPHAS_MODS, mock_rgb_config.current_effect);
@@ -246,7 +327,7 @@ void test_rgb_effect_next_persists_and_updates_live_config(void) {
 }
 
 void test_rgb_effect_prev_wraps_without_hitting_off(void) {
-    mock_eeconfig.profiles[0].rgb_config.current_effect = RGB_EFFECT_SOLID_COLOR;
+    mock_profile.rgb_config.current_effect = RGB_EFFECT_SOLID_COLOR;
     layout_init();
     wear_leveling_write_count = 0;
     rgb_apply_config_count = 0;
@@ -306,6 +387,7 @@ int main(int argc, char **argv) {
     RUN_TEST(test_layout_process_key_release_counts_as_non_tap_hold_event);
     RUN_TEST(test_poll_rate_toggle_persists_options_and_resets);
     RUN_TEST(test_profile_switch_resets_runtime_state);
+    RUN_TEST(test_profile_switch_is_saved_once_idle);
     RUN_TEST(test_layout_sorts_same_timestamp_presses_by_distance);
     RUN_TEST(test_layout_processes_gamepad_keys_when_xinput_disabled);
 #if defined(RGB_ENABLED)
@@ -0,0 +1,254 @@
+#include <stdio.h>
+#include <time.h>
+#include <unity.h>
+
+#include "advanced_keys.h"
+#include "deferred_actions.h"
+#include "eeconfig.h"
+#include "keycodes.h"
+#include "layout.h"
+#include "matrix.h"
+#include "profile_runtime.h"
+
+#include "hardware/native/timer_sim.h"
+
+// Compares the cost of a press and release of a plain key on a profile without
+// advanced keys, and on a profile with every advanced key slot bound to other
+// keys, so that only the checks of the unused subsystems differ. Also measures
+// the scan that switches profiles with a profile key, against rebuilding the
+// runtime image of the profile in that scan.
+
+// Main loop period of an 8 kHz scan rate
+#define BENCH_LOOP_US 125u
+#define BENCH_PRESSES 20000u
+// Each measurement is repeated this many times and the fastest run is kept,
+// which filters out host scheduling noise
+#define BENCH_REPEATS 40
+
+key_state_t key_matrix[NUM_KEYS];
+eeconfig_t mock_eeconfig;
+const eeconfig_t *eeconfig = &mock_eeconfig;
+eeconfig_profile_t mock_profiles[NUM_PROFILES];
+const eeconfig_profile_t *eeconfig_profile = &mock_profiles[0];
+
+// Keycodes sent to the host, to check that the presses are reported
+static uint32_t hid_events;
+static uint8_t hid_last_keycode;
+
+static uint64_t host_time_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+void board_enter_bootloader(void) {}
+void board_reset(void) {}
+
+void hid_clear_runtime_state(void) {}
+void hid_keycode_add(uint8_t keycode) {
+  hid_events++;
+  hid_last_keycode = keycode;
+}
+void hid_keycode_remove(uint8_t keycode) { hid_events++; }
+void hid_mouse_move(int8_t x, int8_t y, uint8_t buttons) {}
+void hid_mouse_scroll(int8_t wheel, int8_t pan, uint8_t buttons) {}
+void hid_set_keyboard_report_clock(bool enabled) {}
+void hid_send_reports(void) {}
+
+void matrix_disable_rapid_trigger(key_index_t key, bool disable) {}
+uint32_t matrix_get_idle_time(void) { return 0; }
+
+bool wear_leveling_write(uint32_t address, const void *data, uint32_t len) {
+  return true;
+}
+
+bool wear_leveling_flush(void) { return true; }
+
+bool eeconfig_write_profile(uint8_t profile, uint32_t offset, const void *buf,
+                            uint32_t len) {
+  return true;
+}
+
+uint8_t eeconfig_get_current_profile(void) {
+  return mock_eeconfig.current_profile;
+}
+
+uint8_t eeconfig_get_last_non_default_profile(void) {
+  return mock_eeconfig.last_non_default_profile;
+}
+
+const eeconfig_profile_t *eeconfig_get_profile(uint8_t profile) {
+  return &mock_profiles[profile];
+}
+
+bool eeconfig_switch_profile(uint8_t profile) {
+  mock_eeconfig.current_profile = profile;
+  eeconfig_profile = &mock_profiles[profile];
+  return true;
+}
+
+bool eeconfig_save_current_profile(void) { return true; }
+
+void xinput_process(key_index_t key) {}
+void xinput_reset_runtime_state(void) {}
+
+void setUp(void) {
+  memset(&mock_eeconfig, 0, sizeof(mock_eeconfig));
+  memset(mock_profiles, 0, sizeof(mock_profiles));
+  memset(key_matrix, 0, sizeof(key_matrix));
+  eeconfig_profile = &mock_profiles[0];
+  for (uint32_t p = 0; p < NUM_PROFILES; p++) {
+    eeconfig_profile_t *profile = &mock_profiles[p];
+
+    profile->gamepad_options.keyboard_enabled = true;
+    profile->tick_rate = 1;
+    for (uint32_t i = 0; i < NUM_KEYS; i++)
+      profile->keymap[0][i] =
+          (uint8_t)(KC_A + (i + p) % (KC_Z - KC_A + 1));
+  }
+
+  timer_init();
+  advanced_key_init();
+  deferred_action_init();
+  layout_init();
+}
+
+void tearDown(void) {}
+
+// Bind every advanced key slot to the keys after the first two: a quarter each
+// of Tap-Hold, Toggle, Macro and Combo
+static void bind_advanced_keys(eeconfig_profile_t *profile) {
+  for (uint32_t i = 0; i < NUM_ADVANCED_KEYS; i++) {
+    advanced_key_t *ak = &profile->advanced_keys[i];
+    const key_index_t key = (key_index_t)(2u + i % (NUM_KEYS - 2u));
+
+    ak->layer = 0;
+    ak->key = key;
+    switch (i % 4) {
+    case 0:
+      ak->type = AK_TYPE_TAP_HOLD;
+      ak->tap_hold.tap_keycode = KC_A;
+      ak->tap_hold.hold_keycode = KC_LEFT_SHIFT;
+      ak->tap_hold.tapping_term = 200;
+      break;
+
+    case 1:
+      ak->type = AK_TYPE_TOGGLE;
+      ak->toggle.keycode = KC_B;
+      ak->toggle.tapping_term = 200;
+      break;
+
+    case 2:
+      ak->type = AK_TYPE_MACRO;
+      ak->macro_key.macro_index = (uint8_t)(i % NUM_MACROS);
+      break;
+
+    default:
+      ak->type = AK_TYPE_COMBO;
+      ak->combo.keys[0] = key;
+      ak->combo.keys[1] = (key_index_t)(2u + (i + 1u) % (NUM_KEYS - 2u));
+      ak->combo.keys[2] = KEY_INDEX_NONE;
+      ak->combo.keys[3] = KEY_INDEX_NONE;
+      ak->combo.output_keycode = KC_C;
+      ak->combo.term = 50;
+      break;
+    }
+  }
+}
+
+static void run_loop(void) {
+  timer_sim_advance_us(BENCH_LOOP_US);
+  layout_task();
+}
+
+// Time the presses and releases of the first key, one main loop each
+static uint64_t bench_presses(void) {
+  uint64_t fastest_ns = UINT64_MAX;
+
+  profile_runtime_reload_current();
+  hid_events = 0;
+  for (uint32_t repeat = 0; repeat < BENCH_REPEATS; repeat++) {
+    const uint64_t start = host_time_ns();
+    for (uint32_t i = 0; i < BENCH_PRESSES; i++) {
+      key_matrix[0].is_pressed = true;
+      run_loop();
+      key_matrix[0].is_pressed = false;
+      run_loop();
+    }
+    fastest_ns = M_MIN(fastest_ns, host_time_ns() - start);
+  }
+
+  return fastest_ns;
+}
+
+void test_layout_bench_plain_key_press(void) {
+  const uint64_t plain_ns = bench_presses();
+  TEST_ASSERT_EQUAL_UINT32(2u * BENCH_PRESSES * BENCH_REPEATS, hid_events);
+
+  bind_advanced_keys(&mock_profiles[0]);
+  const uint64_t advanced_ns = bench_presses();
+  TEST_ASSERT_EQUAL_UINT32(2u * BENCH_PRESSES * BENCH_REPEATS, hid_events);
+
+  printf("%u presses: plain profile %llu ns, %u advanced keys %llu ns\n",
+         BENCH_PRESSES, (unsigned long long)plain_ns,
+         (unsigned)NUM_ADVANCED_KEYS, (unsigned long long)advanced_ns);
+}
+
+// Press the profile key, and return how long the scan took
+static uint64_t bench_profile_key(void) {
+  key_matrix[1].is_pressed = true;
+  timer_sim_advance_us(BENCH_LOOP_US);
+  const uint64_t start = host_time_ns();
+  layout_task();
+  const uint64_t elapsed_ns = host_time_ns() - start;
+
+  key_matrix[1].is_pressed = false;
+  run_loop();
+  return elapsed_ns;
+}
+
+void test_layout_bench_profile_switch(void) {
+  uint64_t switch_ns = UINT64_MAX, rebuild_ns = UINT64_MAX;
+
+  // The second key switches between the first two profiles, which both have
+  // every advanced key slot bound
+  mock_profiles[0].keymap[0][1] = PF(1);
+  mock_profiles[1].keymap[0][1] = PF(0);
+  bind_advanced_keys(&mock_profiles[0]);
+  bind_advanced_keys(&mock_profiles[1]);
+  layout_init();
+
+  for (uint32_t repeat = 0; repeat < BENCH_REPEATS; repeat++) {
+    for (uint8_t profile = 1; profile <= 2; profile++) {
+      const uint64_t elapsed_ns = bench_profile_key();
+      switch_ns = M_MIN(switch_ns, elapsed_ns);
+      TEST_ASSERT_EQUAL_UINT8(profile % 2, eeconfig_get_current_profile());
+
+      // The next scan already uses the keymap of the new profile
+      key_matrix[0].is_pressed = true;
+      run_loop();
+      TEST_ASSERT_EQUAL_UINT8(KC_A + profile % 2, hid_last_keycode);
+      key_matrix[0].is_pressed = false;
+      run_loop();
+    }
+
+    // The work of a switch that rebuilds the runtime image of the profile
+    const uint64_t start = host_time_ns();
+    profile_runtime_reload_current();
+    rebuild_ns = M_MIN(rebuild_ns, host_time_ns() - start);
+  }
+
+  printf("profile switch scan %llu ns (%llu.%02llu%% of a %u us scan), "
+         "rebuilding the image %llu ns\n",
+         (unsigned long long)switch_ns,
+         (unsigned long long)(switch_ns / (BENCH_LOOP_US * 10u)),
+         (unsigned long long)(switch_ns * 10u / BENCH_LOOP_US % 100u),
+         BENCH_LOOP_US, (unsigned long long)rebuild_ns);
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_layout_bench_plain_key_press);
+  RUN_TEST(test_layout_bench_profile_switch);
+  return UNITY_END();
+}
@@ -5,15 +5,18 @@
 
 eeconfig_t mock_eeconfig;
 const eeconfig_t *eeconfig = &mock_eeconfig;
+eeconfig_profile_t mock_profile;
+const eeconfig_profile_t *eeconfig_profile = &mock_profile;
 
 static uint16_t analog_values[NUM_KEYS];
 static uint32_t mock_timer;
 
 void analog_task(void) {}
 
-uint16_t analog_read(uint8_t key) { return analog_values[key]; }
+uint16_t analog_read(key_index_t key) { return analog_values[key]; }
 
 uint32_t timer_read(void) { return mock_timer++; }
+uint64_t timer_read_us(void) { return (uint64_t)mock_timer * 1000u; }
 
 bool wear_leveling_write(uint32_t address, const void *data, uint32_t len) {
   (void)address;
@@ -22,7 +25,7 @@ bool wear_leveling_write(uint32_t address, const void *data, uint32_t len) {
   return true;
 }
 
-static void init_key_state(uint8_t key) {
+static void init_key_state(key_index_t key) {
   key_matrix[key].adc_filtered = 2400;
   key_matrix[key].adc_rest_value = 2400;
   key_matrix[key].adc_bottom_out_value = 3050;
@@ -34,7 +37,7 @@ static void init_key_state(uint8_t key) {
   key_matrix[key].event_time = 0;
   analog_values[key] = 2400;
 
-  mock_eeconfig.profiles[0].actuation_map[key] = (actuation_t){
+  mock_profile.actuation_map[key] = (actuation_t){
       .actuation_point = 128,
       .rt_down = 20,
       .rt_up = 20,
@@ -44,6 +47,7 @@ static void init_key_state(uint8_t key) {
 
 void setUp(void) {
   memset(&mock_eeconfig, 0, sizeof(mock_eeconfig));
+  memset(&mock_profile, 0, sizeof(mock_profile));
   memset(key_matrix, 0, sizeof(key_matrix));
   memset(analog_values, 0, sizeof(analog_values));
   mock_timer = 0;
@@ -54,7 +58,7 @@ void setUp(void) {
   mock_eeconfig.options.continuous_calibration = false;
   mock_eeconfig.options.save_bottom_out_threshold = false;
 
-  for (uint8_t i = 0; i < NUM_KEYS; i++) {
+  for (uint32_t i = 0; i < NUM_KEYS; i++) {
     init_key_state(i);
   }
 }
@@ -5,12 +5,15 @@
 
 static uint8_t legacy_config[sizeof(eeconfig_t)];
 static eeconfig_t written_config;
-static uint32_t write_addr;
-static uint32_t write_len;
 static uint32_t write_count;
+static uint32_t max_write_len;
+static uint32_t max_write_end;
 
 const eeconfig_t *eeconfig = (const eeconfig_t *)legacy_config;
 
+// The legacy layouts have 8-bit key indices, so they are only built for
+// keyboards with at most 256 keys
+#if !defined(KEY_INDEX_16BIT)
 static void write_u8(uint8_t **dst, uint8_t value) { *(*dst)++ = value; }
 
 static void write_u16(uint8_t **dst, uint16_t value) {
@@ -419,20 +422,54 @@ static void assert_mouse_presets_match_active(const joystick_config_t *config) {
   }
 }
 
+#endif
+
+// The legacy configuration stands in for the wear leveling cache, which the
+// migration converts in place.
+bool wear_leveling_read(uint32_t addr, void *buf, uint32_t len) {
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(sizeof(legacy_config), addr + len);
+
+  memcpy(buf, legacy_config + addr, len);
+  return true;
+}
+
 bool wear_leveling_write(uint32_t addr, const void *buf, uint32_t len) {
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(sizeof(legacy_config), addr + len);
+
   write_count++;
-  write_addr = addr;
-  write_len = len;
-  memcpy(&written_config, buf, M_MIN((uint32_t)sizeof(written_config), len));
+  max_write_len = M_MAX(max_write_len, len);
+  max_write_end = M_MAX(max_write_end, addr + len);
+  memcpy(legacy_config + addr, buf, len);
+  memcpy(&written_config, legacy_config, sizeof(written_config));
   return true;
 }
 
+#if !defined(KEY_INDEX_16BIT)
+// Profiles are kept in place by the migration: the first profile becomes the
+// base profile, and the others are stored as a whole in the delta area.
+static const eeconfig_profile_t *migrated_profile(uint32_t profile) {
+  const eeconfig_profile_slot_t *slot = &written_config.profile_slots[profile];
+
+  if (profile == 0) {
+    TEST_ASSERT_EQUAL_UINT16(0, slot->size);
+    return &written_config.base_profile;
+  }
+
+  TEST_ASSERT_EQUAL_UINT16((profile - 1) * sizeof(eeconfig_profile_t),
+                           slot->offset);
+  TEST_ASSERT_EQUAL_UINT16(sizeof(eeconfig_profile_t), slot->size);
+  return (const eeconfig_profile_t *)(written_config.profile_deltas +
+                                      slot->offset);
+}
+
+#endif
+
 void setUp(void) {
   memset(legacy_config, 0, sizeof(legacy_config));
   memset(&written_config, 0, sizeof(written_config));
-  write_addr = 0;
-  write_len = 0;
   write_count = 0;
+  max_write_len = 0;
+  max_write_end = 0;
 }
 
 void tearDown(void) {}
@@ -444,31 +481,51 @@ void test_migration_rejects_invalid_magic(void) {
   TEST_ASSERT_EQUAL_UINT32(0, write_count);
 }
 
+#if defined(KEY_INDEX_16BIT)
+void test_migration_resets_earlier_versions_with_16bit_key_indices(void) {
+  eeconfig_t *config = (eeconfig_t *)legacy_config;
+
+  config->magic_start = EECONFIG_MAGIC_START;
+  config->version = 0x0112;
+
+  TEST_ASSERT_FALSE(migration_try_migrate());
+  TEST_ASSERT_EQUAL_UINT32(0, write_count);
+}
+#else
+void test_migration_rejects_unknown_version_without_writing(void) {
+  build_legacy_config_v1_0();
+  legacy_config[offsetof(eeconfig_t, version)] = 0xFF;
+  legacy_config[offsetof(eeconfig_t, version) + 1] = 0x00;
+
+  TEST_ASSERT_FALSE(migration_try_migrate());
+  TEST_ASSERT_EQUAL_UINT32(0, write_count);
+}
+
 void test_migration_v1_0_reaches_current_and_preserves_profile_data(void) {
   build_legacy_config_v1_0();
 
   TEST_ASSERT_TRUE(migration_try_migrate());
-  TEST_ASSERT_EQUAL_UINT32(1, write_count);
-  TEST_ASSERT_EQUAL_UINT32(0, write_addr);
-  TEST_ASSERT_EQUAL_UINT32(sizeof(eeconfig_t), write_len);
+  // The configuration is streamed through a small window up to its end
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(WL_MAX_BYTES_PER_ENTRY, max_write_len);
+  TEST_ASSERT_EQUAL_UINT32(sizeof(eeconfig_t), max_write_end);
   TEST_ASSERT_EQUAL_HEX16(EECONFIG_VERSION, written_config.version);
   TEST_ASSERT_EQUAL_HEX32(EECONFIG_MAGIC_START, written_config.magic_start);
   TEST_ASSERT_EQUAL_HEX32(EECONFIG_MAGIC_END, written_config.magic_end);
   TEST_ASSERT_EQUAL_UINT8(1, written_config.current_profile);
   TEST_ASSERT_EQUAL_UINT8(2, written_config.last_non_default_profile);
 
-  TEST_ASSERT_EQUAL_UINT8(0x76, written_config.profiles[0].keymap[0][0]);
-  TEST_ASSERT_EQUAL_UINT8(0x7B, written_config.profiles[0].keymap[0][1]);
-  TEST_ASSERT_EQUAL_UINT8(30, written_config.profiles[0].tick_rate);
-  TEST_ASSERT_TRUE(written_config.profiles[0].gamepad_options.keyboard_enabled);
-  TEST_ASSERT_TRUE(written_config.profiles[0].gamepad_options.snappy_joystick);
-  TEST_ASSERT_EQUAL_UINT8(0, written_config.profiles[0].macros[0].events[0].keycode);
+  TEST_ASSERT_EQUAL_UINT8(0x76, migrated_profile(0)->keymap[0][0]);
+  TEST_ASSERT_EQUAL_UINT8(0x7B, migrated_profile(0)->keymap[0][1]);
+  TEST_ASSERT_EQUAL_UINT8(30, migrated_profile(0)->tick_rate);
+  TEST_ASSERT_TRUE(migrated_profile(0)->gamepad_options.keyboard_enabled);
+  TEST_ASSERT_TRUE(migrated_profile(0)->gamepad_options.snappy_joystick);
+  TEST_ASSERT_EQUAL_UINT8(0, migrated_profile(0)->macros[0].events[0].keycode);
   TEST_ASSERT_EQUAL_UINT8(MACRO_ACTION_END,
-                          written_config.profiles[0].macros[0].events[0].action);
-  TEST_ASSERT_EQUAL_UINT8(255, written_config.profiles[0].rgb_config.secondary_color.r);
-  TEST_ASSERT_EQUAL_UINT8(255, written_config.profiles[0].rgb_config.secondary_color.g);
-  TEST_ASSERT_EQUAL_UINT8(255, written_config.profiles[0].rgb_config.secondary_color.b);
-  assert_background_matches_secondary(&written_config.profiles[0].rgb_config);
+                          migrated_profile(0)->macros[0].events[0].action);
+  TEST_ASSERT_EQUAL_UINT8(255, migrated_profile(0)->rgb_config.secondary_color.r);
+  TEST_ASSERT_EQUAL_UINT8(255, migrated_profile(0)->rgb_config.secondary_color.g);
+  TEST_ASSERT_EQUAL_UINT8(255, migrated_profile(0)->rgb_config.secondary_color.b);
+  assert_background_matches_secondary(&migrated_profile(0)->rgb_config);
 }
 
 void test_migration_v1_8_null_migration_preserves_rgb_and_joystick_blocks(void) {
@@ -479,7 +536,7 @@ void test_migration_v1_8_null_migration_preserves_rgb_and_joystick_blocks(void)
   TEST_ASSERT_EQUAL_UINT8(2, written_config.current_profile);
   TEST_ASSERT_EQUAL_UINT8(1, written_config.last_non_default_profile);
 
-  const eeconfig_profile_t *profile = &written_config.profiles[1];
+  const eeconfig_profile_t *profile = migrated_profile(1);
   TEST_ASSERT_EQUAL_UINT8(40, profile->tick_rate);
   TEST_ASSERT_EQUAL_UINT8(56, profile->rgb_config.global_brightness);
   TEST_ASSERT_EQUAL_UINT8(RGB_EFFECT_PIXEL_FLOW,
@@ -516,23 +573,23 @@ void test_migration_v1_9_preserves_rgb_base_fields_and_per_key_colors(void) {
   TEST_ASSERT_TRUE(migration_try_migrate());
   TEST_ASSERT_EQUAL_HEX16(EECONFIG_VERSION, written_config.version);
 
-  TEST_ASSERT_EQUAL_UINT8(1, written_config.profiles[0].rgb_config.enabled);
-  TEST_ASSERT_EQUAL_UINT8(40, written_config.profiles[0].rgb_config.global_brightness);
+  TEST_ASSERT_EQUAL_UINT8(1, migrated_profile(0)->rgb_config.enabled);
+  TEST_ASSERT_EQUAL_UINT8(40, migrated_profile(0)->rgb_config.global_brightness);
   TEST_ASSERT_EQUAL_UINT8(RGB_EFFECT_ALPHAS_MODS,
-                          written_config.profiles[0].rgb_config.current_effect);
-  TEST_ASSERT_EQUAL_UINT8(10, written_config.profiles[0].rgb_config.solid_color.r);
-  TEST_ASSERT_EQUAL_UINT8(20, written_config.profiles[0].rgb_config.solid_color.g);
-  TEST_ASSERT_EQUAL_UINT8(30, written_config.profiles[0].rgb_config.solid_color.b);
-  TEST_ASSERT_EQUAL_UINT8(255, written_config.profiles[0].rgb_config.secondary_color.r);
-  TEST_ASSERT_EQUAL_UINT8(255, written_config.profiles[0].rgb_config.secondary_color.g);
-  TEST_ASSERT_EQUAL_UINT8(255, written_config.profiles[0].rgb_config.secondary_color.b);
-  assert_background_matches_secondary(&written_config.profiles[0].rgb_config);
-  TEST_ASSERT_EQUAL_UINT8(90, written_config.profiles[0].rgb_config.effect_speed);
-  TEST_ASSERT_EQUAL_UINT8(0, written_config.profiles[0].rgb_config.sleep_timeout);
-  TEST_ASSERT_EQUAL_UINT8(0, written_config.profiles[0].rgb_config.layer_indicator_mode);
-  TEST_ASSERT_EQUAL_UINT8(0, written_config.profiles[0].rgb_config.layer_indicator_key);
-  assert_rgb_per_key_color(&written_config.profiles[0].rgb_config, 0, 0);
-  assert_rgb_per_key_color(&written_config.profiles[0].rgb_config, 0, 9);
+                          migrated_profile(0)->rgb_config.current_effect);
+  TEST_ASSERT_EQUAL_UINT8(10, migrated_profile(0)->rgb_config.solid_color.r);
+  TEST_ASSERT_EQUAL_UINT8(20, migrated_profile(0)->rgb_config.solid_color.g);
+  TEST_ASSERT_EQUAL_UINT8(30, migrated_profile(0)->rgb_config.solid_color.b);
+  TEST_ASSERT_EQUAL_UINT8(255, migrated_profile(0)->rgb_config.secondary_color.r);
+  TEST_ASSERT_EQUAL_UINT8(255, migrated_profile(0)->rgb_config.secondary_color.g);
+  TEST_ASSERT_EQUAL_UINT8(255, migrated_profile(0)->rgb_config.secondary_color.b);
+  assert_background_matches_secondary(&migrated_profile(0)->rgb_config);
+  TEST_ASSERT_EQUAL_UINT8(90, migrated_profile(0)->rgb_config.effect_speed);
+  TEST_ASSERT_EQUAL_UINT8(0, migrated_profile(0)->rgb_config.sleep_timeout);
+  TEST_ASSERT_EQUAL_UINT8(0, migrated_profile(0)->rgb_config.layer_indicator_mode);
+  TEST_ASSERT_EQUAL_UINT8(0, migrated_profile(0)->rgb_config.layer_indicator_key);
+  assert_rgb_per_key_color(&migrated_profile(0)->rgb_config, 0, 0);
+  assert_rgb_per_key_color(&migrated_profile(0)->rgb_config, 0, 9);
 }
 
 void test_migration_v1_B_promotes_options_and_preserves_layer_colors(void) {
@@ -542,7 +599,7 @@ void test_migration_v1_B_promotes_options_and_preserves_layer_colors(void) {
   TEST_ASSERT_EQUAL_HEX16(EECONFIG_VERSION, written_config.version);
   TEST_ASSERT_EQUAL_HEX32(0x00000A55, written_config.options.raw);
 
-  const eeconfig_profile_t *profile = &written_config.profiles[2];
+  const eeconfig_profile_t *profile = migrated_profile(2);
   TEST_ASSERT_EQUAL_UINT8(102, profile->rgb_config.layer_colors[0].r);
   TEST_ASSERT_EQUAL_UINT8(103, profile->rgb_config.layer_colors[0].g);
   TEST_ASSERT_EQUAL_UINT8(104, profile->rgb_config.layer_colors[0].b);
@@ -567,7 +624,7 @@ void test_migration_v1_D_initializes_joystick_debounce_without_clobbering_other_
   TEST_ASSERT_EQUAL_HEX16(EECONFIG_VERSION, written_config.version);
   TEST_ASSERT_EQUAL_HEX32(0x00001234, written_config.options.raw);
 
-  const eeconfig_profile_t *profile = &written_config.profiles[0];
+  const eeconfig_profile_t *profile = migrated_profile(0);
   TEST_ASSERT_EQUAL_UINT8(70, profile->rgb_config.secondary_color.r);
   TEST_ASSERT_EQUAL_UINT8(80, profile->rgb_config.secondary_color.g);
   TEST_ASSERT_EQUAL_UINT8(90, profile->rgb_config.secondary_color.b);
@@ -587,7 +644,7 @@ void test_migration_v1_10_appends_trigger_state_colors_without_clobbering_profil
   TEST_ASSERT_EQUAL_HEX16(EECONFIG_VERSION, written_config.version);
   TEST_ASSERT_EQUAL_HEX32(0x12345678u, written_config.options.raw);
 
-  const eeconfig_profile_t *profile = &written_config.profiles[1];
+  const eeconfig_profile_t *profile = migrated_profile(1);
   TEST_ASSERT_EQUAL_UINT8(91, profile->rgb_config.secondary_color.r);
   TEST_ASSERT_EQUAL_UINT8(101, profile->rgb_config.secondary_color.g);
   TEST_ASSERT_EQUAL_UINT8(111, profile->rgb_config.secondary_color.b);
@@ -603,9 +660,15 @@ void test_migration_v1_10_appends_trigger_state_colors_without_clobbering_profil
                           profile->joystick_config.mouse_presets[2].mouse_acceleration);
 }
 
+#endif
+
 int main(void) {
   UNITY_BEGIN();
   RUN_TEST(test_migration_rejects_invalid_magic);
+#if defined(KEY_INDEX_16BIT)
+  RUN_TEST(test_migration_resets_earlier_versions_with_16bit_key_indices);
+#else
+  RUN_TEST(test_migration_rejects_unknown_version_without_writing);
   RUN_TEST(test_migration_v1_0_reaches_current_and_preserves_profile_data);
   RUN_TEST(test_migration_v1_8_null_migration_preserves_rgb_and_joystick_blocks);
   RUN_TEST(test_migration_v1_9_preserves_rgb_base_fields_and_per_key_colors);
@@ -614,5 +677,6 @@ int main(void) {
       test_migration_v1_D_initializes_joystick_debounce_without_clobbering_other_fields);
   RUN_TEST(
       test_migration_v1_10_appends_trigger_state_colors_without_clobbering_profile_data);
+#endif
   return UNITY_END();
 }
@@ -0,0 +1,218 @@
+#include <unity.h>
+
+#include "advanced_keys.h"
+#include "deferred_actions.h"
+#include "eeconfig.h"
+#include "hid.h"
+#include "keycodes.h"
+#include "layout.h"
+#include "matrix.h"
+#include "tusb.h"
+#include "usb_descriptors.h"
+
+#define RAPID_FIRE_KEY 3
+#define SIMULATED_SECONDS 1u
+
+// --- Mocks ---
+key_state_t key_matrix[NUM_KEYS];
+eeconfig_t mock_eeconfig;
+const eeconfig_t *eeconfig = &mock_eeconfig;
+eeconfig_profile_t mock_profile;
+const eeconfig_profile_t *eeconfig_profile = &mock_profile;
+
+const uint16_t keycode_to_hid[256] = {
+    [KC_A] = 0x0004,
+};
+
+// Whether a keyboard report is waiting to be read by the host
+static bool keyboard_in_flight;
+static bool last_report_pressed;
+static uint32_t keyboard_report_count;
+static uint32_t press_count;
+static uint32_t release_count;
+
+void tud_hid_report_complete_cb(uint8_t instance, const uint8_t *report,
+                                uint16_t len);
+
+bool command_enqueue(const uint8_t *buffer, uint16_t len) { return true; }
+uint32_t timer_read(void) { return 0; }
+uint32_t timer_elapsed(uint32_t last) { return 0; }
+uint64_t timer_read_us(void) { return 0; }
+uint32_t board_cycle_count(void) { return 0; }
+void tud_task(void) {}
+
+bool tud_hid_n_report(uint8_t instance, uint8_t report_id, const void *report,
+                      uint16_t len) {
+  if (instance != USB_ITF_KEYBOARD)
+    return true;
+
+  const hid_nkro_kb_report_t *kb_report = report;
+  const bool pressed = (kb_report->bitmap[0] & (1u << 4)) != 0;
+
+  keyboard_in_flight = true;
+  keyboard_report_count++;
+  if (pressed && !last_report_pressed)
+    press_count++;
+  else if (!pressed && last_report_pressed)
+    release_count++;
+  last_report_pressed = pressed;
+  return true;
+}
+
+bool tud_hid_n_ready(uint8_t instance) {
+  return instance != USB_ITF_KEYBOARD || !keyboard_in_flight;
+}
+bool tud_suspended(void) { return false; }
+void tud_remote_wakeup(void) {}
+
+void layout_register(key_index_t key, uint8_t keycode) {
+  hid_keycode_add(keycode);
+}
+void layout_unregister(key_index_t key, uint8_t keycode) {
+  hid_keycode_remove(keycode);
+}
+bool deferred_action_push(const deferred_action_t *action) { return true; }
+uint8_t layout_get_current_layer(void) { return 0; }
+bool layout_process_key(key_index_t key, bool pressed) { return true; }
+void matrix_disable_rapid_trigger(key_index_t key, bool disable) {}
+
+// --- Host ---
+
+/**
+ * @brief Poll the keyboard interface once
+ *
+ * The host reads the keyboard report in flight, if any, and the firmware then
+ * sends its reports from the main loop.
+ */
+static void host_poll(void) {
+  if (keyboard_in_flight) {
+    keyboard_in_flight = false;
+    tud_hid_report_complete_cb(USB_ITF_KEYBOARD, NULL,
+                               sizeof(hid_nkro_kb_report_t));
+  }
+  hid_send_reports();
+}
+
+static void rapid_fire_event(uint8_t type) {
+  const advanced_key_event_t event = {
+      .type = type,
+      .key = RAPID_FIRE_KEY,
+      .ak_index = 0,
+  };
+  advanced_key_process(&event);
+}
+
+static void rapid_fire_setup(uint8_t press_reports, uint8_t release_reports,
+                             uint8_t bottom_out_release_reports) {
+  mock_profile.advanced_keys[0].type = AK_TYPE_RAPID_FIRE;
+  mock_profile.advanced_keys[0].key = RAPID_FIRE_KEY;
+  mock_profile.advanced_keys[0].rapid_fire.keycode = KC_A;
+  mock_profile.advanced_keys[0].rapid_fire.press_reports = press_reports;
+  mock_profile.advanced_keys[0].rapid_fire.release_reports = release_reports;
+  mock_profile.advanced_keys[0].rapid_fire.bottom_out_release_reports =
+      bottom_out_release_reports;
+}
+
+/**
+ * @brief Hold the Rapid Fire key for the simulated seconds
+ *
+ * @param poll_rate Polling rate of the host in Hz
+ *
+ * @return Number of press/release pairs sent per second
+ */
+static uint32_t rapid_fire_pairs_per_second(uint32_t poll_rate) {
+  rapid_fire_event(AK_EVENT_TYPE_PRESS);
+  for (uint32_t i = 0; i < poll_rate * SIMULATED_SECONDS; i++)
+    host_poll();
+  const uint32_t pairs = release_count;
+
+  TEST_ASSERT_EQUAL_UINT32(poll_rate * SIMULATED_SECONDS,
+                           keyboard_report_count);
+  TEST_ASSERT_UINT32_WITHIN(1, pairs, press_count);
+
+  rapid_fire_event(AK_EVENT_TYPE_RELEASE);
+  return pairs / SIMULATED_SECONDS;
+}
+
+// --- Tests ---
+void setUp(void) {
+  memset(&mock_eeconfig, 0, sizeof(mock_eeconfig));
+  memset(&mock_profile, 0, sizeof(mock_profile));
+  memset(key_matrix, 0, sizeof(key_matrix));
+  hid_init();
+  advanced_key_clear();
+  keyboard_in_flight = false;
+  last_report_pressed = false;
+  keyboard_report_count = 0;
+  press_count = 0;
+  release_count = 0;
+}
+
+void tearDown(void) {}
+
+void test_rapid_fire_rate_at_1khz(void) {
+  rapid_fire_setup(1, 1, 0);
+  TEST_ASSERT_EQUAL_UINT32(500, rapid_fire_pairs_per_second(1000));
+
+  setUp();
+  rapid_fire_setup(2, 3, 0);
+  TEST_ASSERT_EQUAL_UINT32(200, rapid_fire_pairs_per_second(1000));
+}
+
+void test_rapid_fire_rate_at_8khz(void) {
+  rapid_fire_setup(1, 1, 0);
+  TEST_ASSERT_EQUAL_UINT32(4000, rapid_fire_pairs_per_second(8000));
+
+  setUp();
+  rapid_fire_setup(2, 3, 0);
+  TEST_ASSERT_EQUAL_UINT32(1600, rapid_fire_pairs_per_second(8000));
+}
+
+void test_rapid_fire_zero_reports_count_as_one(void) {
+  rapid_fire_setup(0, 0, 0);
+  TEST_ASSERT_EQUAL_UINT32(500, rapid_fire_pairs_per_second(1000));
+}
+
+void test_rapid_fire_rate_modulated_by_distance(void) {
+  // 1 report pressed, then from 7 reports released at rest to 1 at full travel
+  rapid_fire_setup(1, 7, 1);
+  key_matrix[RAPID_FIRE_KEY].distance = 0;
+  TEST_ASSERT_EQUAL_UINT32(125, rapid_fire_pairs_per_second(1000));
+
+  setUp();
+  rapid_fire_setup(1, 7, 1);
+  key_matrix[RAPID_FIRE_KEY].distance = 128;
+  TEST_ASSERT_EQUAL_UINT32(200, rapid_fire_pairs_per_second(1000));
+
+  setUp();
+  rapid_fire_setup(1, 7, 1);
+  key_matrix[RAPID_FIRE_KEY].distance = 255;
+  TEST_ASSERT_EQUAL_UINT32(500, rapid_fire_pairs_per_second(8000) / 8u);
+}
+
+void test_rapid_fire_stops_after_release(void) {
+  rapid_fire_setup(1, 1, 0);
+  rapid_fire_event(AK_EVENT_TYPE_PRESS);
+  for (uint32_t i = 0; i < 9; i++)
+    host_poll();
+  TEST_ASSERT_TRUE(last_report_pressed);
+
+  rapid_fire_event(AK_EVENT_TYPE_RELEASE);
+  for (uint32_t i = 0; i < 100; i++)
+    host_poll();
+
+  // The release is sent, then the keyboard interface goes idle
+  TEST_ASSERT_FALSE(last_report_pressed);
+  TEST_ASSERT_EQUAL_UINT32(10, keyboard_report_count);
+  TEST_ASSERT_EQUAL_UINT32(press_count, release_count);
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_rapid_fire_rate_at_1khz);
+  RUN_TEST(test_rapid_fire_rate_at_8khz);
+  RUN_TEST(test_rapid_fire_zero_reports_count_as_one);
+  RUN_TEST(test_rapid_fire_rate_modulated_by_distance);
+  RUN_TEST(test_rapid_fire_stops_after_release);
+  return UNITY_END();
+}
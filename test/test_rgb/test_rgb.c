@@ -6,15 +6,21 @@
 #include "rgb.h"
 #include "rgb_animated.h"
 #include "rgb_internal.h"
+#include "rgb_math.h"
 #include "rgb_static.h"
+#include "rgb_stream.h"
 
 static eeconfig_t mock_eeconfig;
 const eeconfig_t *eeconfig = &mock_eeconfig;
+static eeconfig_profile_t mock_profile;
+const eeconfig_profile_t *eeconfig_profile = &mock_profile;
 key_state_t key_matrix[NUM_KEYS];
 
 static uint8_t last_grb_frame[NUM_LEDS * 3];
 static uint16_t last_grb_frame_len;
 static uint32_t mock_time;
+static uint32_t mock_cycle_count;
+static uint32_t mock_cycle_step;
 
 void rgb_driver_init(void) {}
 void rgb_driver_task(void) {}
@@ -26,6 +32,11 @@ void rgb_driver_write(const uint8_t *grb_data, uint16_t byte_count) {
 
 uint32_t timer_read(void) { return mock_time; }
 
+uint32_t board_cycle_count(void) {
+  mock_cycle_count += mock_cycle_step;
+  return mock_cycle_count;
+}
+
 uint32_t matrix_get_idle_time(void) { return 0; }
 
 uint8_t layout_get_current_layer(void) { return 0; }
@@ -42,9 +53,10 @@ void rgb_static_reset(void) {}
 bool rgb_static_render(rgb_effect_t effect, const rgb_static_context_t *context) {
   if (effect == RGB_EFFECT_SOLID_COLOR) {
     const rgb_color_t color = context->config->solid_color;
-    rgb_set_all_color((uint8_t)(((uint32_t)color.r * context->effective_brightness) / 255u),
-                      (uint8_t)(((uint32_t)color.g * context->effective_brightness) / 255u),
-                      (uint8_t)(((uint32_t)color.b * context->effective_brightness) / 255u));
+    rgb_set_range_color(context->led_start, context->led_end,
+                        (uint8_t)(((uint32_t)color.r * context->effective_brightness) / 255u),
+                        (uint8_t)(((uint32_t)color.g * context->effective_brightness) / 255u),
+                        (uint8_t)(((uint32_t)color.b * context->effective_brightness) / 255u));
     return true;
   }
 
@@ -57,24 +69,42 @@ void rgb_reactive_decay_heatmap(uint32_t current_tick) {
 
 void rgb_reactive_record_keypress(uint8_t index) { (void)index; }
 
-void rgb_reactive_render_heatmap(uint8_t effective_brightness) {
+void rgb_reactive_render_heatmap(uint8_t effective_brightness,
+                                 uint8_t led_start, uint8_t led_end) {
   (void)effective_brightness;
+  (void)led_start;
+  (void)led_end;
 }
 
 void rgb_reactive_render_effect(uint8_t effect, uint8_t base_hue,
-                                uint8_t effective_brightness, uint8_t speed) {
+                                uint8_t effective_brightness, uint8_t speed,
+                                uint8_t led_start, uint8_t led_end) {
   (void)effect;
   (void)base_hue;
   (void)effective_brightness;
   (void)speed;
+  (void)led_start;
+  (void)led_end;
 }
 
 void rgb_reactive_render_splash(uint8_t effect, uint8_t base_hue,
-                                uint8_t effective_brightness, uint8_t speed) {
+                                uint8_t effective_brightness, uint8_t speed,
+                                uint8_t led_start, uint8_t led_end) {
   (void)effect;
   (void)base_hue;
   (void)effective_brightness;
   (void)speed;
+  (void)led_start;
+  (void)led_end;
+}
+
+static rgb_color_t mock_stream_frame[NUM_LEDS];
+static bool mock_stream_running;
+
+void rgb_stream_reset(void) {}
+
+const rgb_color_t *rgb_stream_begin_frame(void) {
+  return mock_stream_running ? mock_stream_frame : NULL;
 }
 
 static rgb_color_t driver_rgb_at(uint8_t led_index) {
@@ -94,21 +124,25 @@ static rgb_color_t driver_rgb_for_key(uint8_t key_index) {
 
 void setUp(void) {
   memset(&mock_eeconfig, 0, sizeof(mock_eeconfig));
+  memset(&mock_profile, 0, sizeof(mock_profile));
   memset(key_matrix, 0, sizeof(key_matrix));
   memset(last_grb_frame, 0, sizeof(last_grb_frame));
   last_grb_frame_len = 0;
   mock_time = 0;
-
-  mock_eeconfig.profiles[0].rgb_config.enabled = 1u;
-  mock_eeconfig.profiles[0].rgb_config.global_brightness = 255u;
-  mock_eeconfig.profiles[0].rgb_config.current_effect = RGB_EFFECT_TRIGGER_STATE;
-  mock_eeconfig.profiles[0].rgb_config.trigger_state_colors[RGB_TRIGGER_STATE_IDLE] =
+  mock_cycle_count = 0;
+  mock_cycle_step = 0;
+  mock_stream_running = false;
+
+  mock_profile.rgb_config.enabled = 1u;
+  mock_profile.rgb_config.global_brightness = 255u;
+  mock_profile.rgb_config.current_effect = RGB_EFFECT_TRIGGER_STATE;
+  mock_profile.rgb_config.trigger_state_colors[RGB_TRIGGER_STATE_IDLE] =
       (rgb_color_t){.r = 1u, .g = 2u, .b = 3u};
-  mock_eeconfig.profiles[0].rgb_config.trigger_state_colors[RGB_TRIGGER_STATE_RELEASE] =
+  mock_profile.rgb_config.trigger_state_colors[RGB_TRIGGER_STATE_RELEASE] =
       (rgb_color_t){.r = 4u, .g = 5u, .b = 6u};
-  mock_eeconfig.profiles[0].rgb_config.trigger_state_colors[RGB_TRIGGER_STATE_PRESS] =
+  mock_profile.rgb_config.trigger_state_colors[RGB_TRIGGER_STATE_PRESS] =
       (rgb_color_t){.r = 7u, .g = 8u, .b = 9u};
-  mock_eeconfig.profiles[0].rgb_config.trigger_state_colors[RGB_TRIGGER_STATE_HOLD] =
+  mock_profile.rgb_config.trigger_state_colors[RGB_TRIGGER_STATE_HOLD] =
       (rgb_color_t){.r = 10u, .g = 11u, .b = 12u};
 
   rgb_init();
@@ -166,6 +200,60 @@ void test_rgb_solid_color_scales_global_brightness(void) {
   TEST_ASSERT_EQUAL_UINT8((uint8_t)((25u * 128u) / 255u), solid.b);
 }
 
+void test_rgb_hue_colors_follow_frame_brightness(void) {
+  rgb_config_t *config = rgb_get_config();
+  config->current_effect = RGB_EFFECT_SOLID_COLOR;
+  config->global_brightness = 128u;
+
+  const rgb_color_t gray = hsv_to_rgb((hsv_t){.h = 42u, .s = 0u, .v = 77u});
+  TEST_ASSERT_EQUAL_UINT8(77u, gray.r);
+  TEST_ASSERT_EQUAL_UINT8(77u, gray.g);
+  TEST_ASSERT_EQUAL_UINT8(77u, gray.b);
+
+  const rgb_color_t red = hsv_to_rgb((hsv_t){.h = 0u, .s = 255u, .v = 255u});
+  TEST_ASSERT_EQUAL_UINT8(255u, red.r);
+  TEST_ASSERT_EQUAL_UINT8(0u, red.g);
+  TEST_ASSERT_EQUAL_UINT8(0u, red.b);
+
+  mock_time = 4000u;
+  rgb_task();
+
+  for (uint16_t hue = 0; hue < 256u; hue++) {
+    const rgb_color_t expected =
+        hsv_to_rgb((hsv_t){.h = (uint8_t)hue, .s = 255u, .v = 128u});
+    const rgb_color_t frame = rgb_hue_color((uint8_t)hue);
+    const rgb_color_t value = rgb_hue_color_value((uint8_t)hue, 128u);
+    TEST_ASSERT_EQUAL_MEMORY(&expected, &frame, sizeof(expected));
+    TEST_ASSERT_EQUAL_MEMORY(&expected, &value, sizeof(expected));
+  }
+}
+
+void test_rgb_host_stream_replaces_effect_and_follows_brightness(void) {
+  rgb_config_t *config = rgb_get_config();
+  config->current_effect = RGB_EFFECT_SOLID_COLOR;
+  config->global_brightness = 128u;
+  config->solid_color = (rgb_color_t){.r = 255u, .g = 255u, .b = 255u};
+  for (uint8_t i = 0; i < NUM_LEDS; i++)
+    mock_stream_frame[i] = (rgb_color_t){.r = i, .g = 200u, .b = 0u};
+  mock_stream_running = true;
+
+  mock_time = 5000u;
+  rgb_task();
+
+  for (uint8_t i = 0; i < NUM_LEDS; i++) {
+    const rgb_color_t color = driver_rgb_at(i);
+    TEST_ASSERT_EQUAL_UINT8(scale8(i, 128u), color.r);
+    TEST_ASSERT_EQUAL_UINT8(scale8(200u, 128u), color.g);
+    TEST_ASSERT_EQUAL_UINT8(0u, color.b);
+  }
+
+  // Without a running stream the stored effect is back on the next frame
+  mock_stream_running = false;
+  mock_time = 5016u;
+  rgb_task();
+  TEST_ASSERT_EQUAL_UINT8((uint8_t)((255u * 128u) / 255u), driver_rgb_at(0u).g);
+}
+
 void test_rgb_binary_clock_renders_time_digits_and_seconds_progress(void) {
   rgb_config_t *config = rgb_get_config();
   config->current_effect = RGB_EFFECT_BINARY_CLOCK;
@@ -235,10 +323,69 @@ void test_rgb_binary_clock_renders_time_digits_and_seconds_progress(void) {
   }
 }
 
+void test_rgb_frame_is_rendered_in_bounded_slices(void) {
+  const uint32_t expected_calls =
+      (NUM_LEDS + RGB_RENDER_CHUNK_LEDS - 1u) / RGB_RENDER_CHUNK_LEDS;
+  rgb_config_t *config = rgb_get_config();
+  config->current_effect = RGB_EFFECT_SOLID_COLOR;
+  config->solid_color = (rgb_color_t){.r = 30u, .g = 60u, .b = 90u};
+
+  // Every call exhausts its cycle budget after the first slice
+  mock_cycle_step = UINT32_MAX / 4u;
+  last_grb_frame_len = 0;
+  mock_time = 2000u;
+
+  for (uint32_t i = 0; i + 1u < expected_calls; i++) {
+    rgb_task();
+    TEST_ASSERT_EQUAL_UINT16(0u, last_grb_frame_len);
+  }
+
+  rgb_task();
+  TEST_ASSERT_EQUAL_UINT16(NUM_LEDS * 3u, last_grb_frame_len);
+  for (uint8_t i = 0; i < NUM_LEDS; i++) {
+    const rgb_color_t color = driver_rgb_at(i);
+    TEST_ASSERT_EQUAL_UINT8(30u, color.r);
+    TEST_ASSERT_EQUAL_UINT8(60u, color.g);
+    TEST_ASSERT_EQUAL_UINT8(90u, color.b);
+  }
+
+  // The next frame does not start before the frame interval has elapsed
+  last_grb_frame_len = 0;
+  rgb_task();
+  TEST_ASSERT_EQUAL_UINT16(0u, last_grb_frame_len);
+}
+
+void test_rgb_update_supersedes_frame_in_progress(void) {
+  rgb_config_t *config = rgb_get_config();
+  config->current_effect = RGB_EFFECT_SOLID_COLOR;
+  config->solid_color = (rgb_color_t){.r = 30u, .g = 60u, .b = 90u};
+
+  mock_cycle_step = UINT32_MAX / 4u;
+  mock_time = 3000u;
+  rgb_task();
+
+  config->enabled = 0u;
+  rgb_apply_config();
+  TEST_ASSERT_EQUAL_UINT16(NUM_LEDS * 3u, last_grb_frame_len);
+  for (uint16_t i = 0; i < NUM_LEDS * 3u; i++)
+    TEST_ASSERT_EQUAL_UINT8(0u, last_grb_frame[i]);
+
+  // The abandoned frame is not resumed once RGB is enabled again
+  config->enabled = 1u;
+  last_grb_frame_len = 0;
+  for (uint8_t i = 0; i < NUM_LEDS; i++)
+    rgb_task();
+  TEST_ASSERT_EQUAL_UINT16(0u, last_grb_frame_len);
+}
+
 int main(void) {
   UNITY_BEGIN();
   RUN_TEST(test_rgb_trigger_state_uses_configured_color_for_each_state);
   RUN_TEST(test_rgb_solid_color_scales_global_brightness);
+  RUN_TEST(test_rgb_hue_colors_follow_frame_brightness);
+  RUN_TEST(test_rgb_host_stream_replaces_effect_and_follows_brightness);
   RUN_TEST(test_rgb_binary_clock_renders_time_digits_and_seconds_progress);
+  RUN_TEST(test_rgb_frame_is_rendered_in_bounded_slices);
+  RUN_TEST(test_rgb_update_supersedes_frame_in_progress);
   return UNITY_END();
 }
@@ -9,6 +9,10 @@
 #define WL_WRITE_LOG_SIZE 1024
 #define FLASH_SIZE 65536
 
+#if !defined(RGB_RENDER_CHUNK_LEDS)
+#define RGB_RENDER_CHUNK_LEDS 8
+#endif
+
 #if !defined(F_CPU)
 #define F_CPU 216000000
 #endif
@@ -11,6 +11,8 @@ static rgb_animated_context_t pixel_flow_context(bool effect_changed) {
       .effective_brightness = 128,
       .effect_speed = 96,
       .effect_changed = effect_changed,
+      .led_start = 0,
+      .led_end = NUM_LEDS,
   };
   return context;
 }
@@ -33,7 +35,7 @@ rgb_color_t hsv_to_rgb(hsv_t hsv) {
 
 uint8_t rgb_coord_x_at(uint8_t led) { return (uint8_t)(led * 16u); }
 uint8_t rgb_coord_y_at(uint8_t led) { return (uint8_t)(led * 8u); }
-uint8_t rgb_key_to_led_at(uint8_t key) { return key; }
+uint8_t rgb_key_to_led_at(key_index_t key) { return (uint8_t)key; }
 uint8_t rgb_reactive_clip_at(uint8_t source_led, uint8_t target_led) {
   (void)source_led;
   (void)target_led;
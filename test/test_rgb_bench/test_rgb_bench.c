@@ -0,0 +1,146 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unity.h>
+
+#include "eeconfig.h"
+#include "matrix.h"
+#include "rgb.h"
+
+// Measures the cost of the worst single `rgb_task()` call and of the worst
+// whole frame (all of its calls) for every effect.
+// The cycle budget is disabled (`-DRGB_RENDER_CYCLE_BUDGET=0`) so every call
+// renders exactly one slice regardless of the host speed. Build with
+// `-DRGB_RENDER_CHUNK_LEDS=NUM_LEDS` to measure whole-frame rendering for
+// comparison.
+
+#define BENCH_FRAMES 128
+// Each call is timed this many times and the fastest run is kept, which
+// filters out host scheduling noise
+#define BENCH_REPEATS 5
+#define BENCH_MAX_CALLS (NUM_LEDS + 1u)
+
+static eeconfig_t mock_eeconfig;
+const eeconfig_t *eeconfig = &mock_eeconfig;
+static eeconfig_profile_t mock_profile;
+const eeconfig_profile_t *eeconfig_profile = &mock_profile;
+key_state_t key_matrix[NUM_KEYS];
+
+static uint32_t mock_time;
+static uint32_t frames_written;
+static uint64_t call_ns[BENCH_FRAMES][BENCH_MAX_CALLS];
+static uint32_t frame_calls[BENCH_FRAMES];
+
+static uint64_t host_time_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+void rgb_driver_init(void) {}
+void rgb_driver_task(void) {}
+
+void rgb_driver_write(const uint8_t *grb_data, uint16_t byte_count) {
+  (void)grb_data;
+  (void)byte_count;
+  frames_written++;
+}
+
+uint32_t timer_read(void) { return mock_time; }
+
+uint32_t board_cycle_count(void) { return 0; }
+
+uint32_t matrix_get_idle_time(void) { return 0; }
+
+uint8_t layout_get_current_layer(void) { return 0; }
+
+void setUp(void) {
+  memset(&mock_eeconfig, 0, sizeof(mock_eeconfig));
+  memset(&mock_profile, 0, sizeof(mock_profile));
+  memset(key_matrix, 0, sizeof(key_matrix));
+  frames_written = 0;
+
+  rgb_config_t *config = &mock_profile.rgb_config;
+  config->enabled = 1u;
+  config->global_brightness = 255u;
+  config->effect_speed = 128u;
+  config->solid_color = (rgb_color_t){.r = 255u, .g = 64u, .b = 0u};
+  config->secondary_color = (rgb_color_t){.r = 0u, .g = 64u, .b = 255u};
+  config->background_color = (rgb_color_t){.r = 8u, .g = 8u, .b = 8u};
+}
+
+void tearDown(void) {}
+
+static void bench_run_effect(uint8_t effect, uint32_t repeat) {
+  mock_profile.rgb_config.current_effect = effect;
+  // Replay the same frame ticks on every repeat
+  mock_time = (uint32_t)effect * 100000u;
+  rgb_init();
+  rgb_set_clock_time(12u, 34u, 56u);
+  frames_written = 0;
+
+  for (uint32_t frame = 0; frame < BENCH_FRAMES; frame++) {
+    const uint32_t written = frames_written;
+    uint32_t calls = 0;
+
+    mock_time += 16u;
+    if (frame % 8u == 0u)
+      rgb_matrix_record_keypress((key_index_t)(frame % NUM_KEYS));
+
+    while (frames_written == written && calls < BENCH_MAX_CALLS) {
+      const uint64_t start = host_time_ns();
+      rgb_task();
+      const uint64_t elapsed = host_time_ns() - start;
+      if (repeat == 0 || elapsed < call_ns[frame][calls])
+        call_ns[frame][calls] = elapsed;
+      calls++;
+    }
+
+    frame_calls[frame] = calls;
+  }
+}
+
+void test_rgb_bench_max_task_cost_per_effect(void) {
+  const uint32_t max_calls_per_frame =
+      (NUM_LEDS + RGB_RENDER_CHUNK_LEDS - 1u) / RGB_RENDER_CHUNK_LEDS;
+  char line[112];
+
+  for (uint8_t effect = 0; effect < RGB_EFFECT_MAX; effect++) {
+    uint64_t max_call_ns = 0;
+    uint64_t max_frame_ns = 0;
+    uint32_t max_calls = 0;
+
+    for (uint32_t repeat = 0; repeat < BENCH_REPEATS; repeat++) {
+      bench_run_effect(effect, repeat);
+      TEST_ASSERT_EQUAL_UINT32(BENCH_FRAMES, frames_written);
+    }
+
+    for (uint32_t frame = 0; frame < BENCH_FRAMES; frame++) {
+      uint64_t frame_ns = 0;
+      for (uint32_t call = 0; call < frame_calls[frame]; call++) {
+        if (call_ns[frame][call] > max_call_ns)
+          max_call_ns = call_ns[frame][call];
+        frame_ns += call_ns[frame][call];
+      }
+      if (frame_ns > max_frame_ns)
+        max_frame_ns = frame_ns;
+      if (frame_calls[frame] > max_calls)
+        max_calls = frame_calls[frame];
+    }
+
+    snprintf(line, sizeof(line),
+             "effect %2u: max rgb_task %6llu ns, max frame %6llu ns, "
+             "%2lu calls/frame",
+             (unsigned int)effect, (unsigned long long)max_call_ns,
+             (unsigned long long)max_frame_ns, (unsigned long)max_calls);
+    TEST_MESSAGE(line);
+
+    TEST_ASSERT_TRUE(max_calls <= max_calls_per_frame);
+  }
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_rgb_bench_max_task_cost_per_effect);
+  return UNITY_END();
+}
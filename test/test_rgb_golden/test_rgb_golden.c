@@ -0,0 +1,181 @@
+#include <stdio.h>
+#include <string.h>
+#include <unity.h>
+
+#include "eeconfig.h"
+#include "matrix.h"
+#include "rgb.h"
+
+// Golden images of every effect. Each effect renders a fixed scenario (key
+// presses, analog travel and a layer switch) at a slow and a fast effect
+// speed, and the GRB frames sent to the driver are folded into one FNV-1a
+// hash per effect. The effects run back to
+// back in enum order, so a hash also covers the timer and reactive state
+// carried over from the previous effects. When an effect is changed on
+// purpose, update its entry with the hash printed by the failing assertion.
+
+#define GOLDEN_FRAMES 128
+
+// The slow speed keeps overlapping reactive hits alive, the fast one lets the
+// slower animations go through several steps
+static const uint8_t golden_speeds[] = {16u, 255u};
+
+static eeconfig_t mock_eeconfig;
+const eeconfig_t *eeconfig = &mock_eeconfig;
+static eeconfig_profile_t mock_profile;
+const eeconfig_profile_t *eeconfig_profile = &mock_profile;
+key_state_t key_matrix[NUM_KEYS];
+
+static uint32_t mock_time;
+static uint32_t frames_written;
+static uint32_t frame_hash;
+static uint8_t mock_layer;
+
+static const uint32_t golden_hashes[RGB_EFFECT_MAX] = {
+    [RGB_EFFECT_OFF] = 0x7bd7dd64u,
+    [RGB_EFFECT_SOLID_COLOR] = 0x9f4c9e69u,
+    [RGB_EFFECT_ALPHAS_MODS] = 0x96a823bdu,
+    [RGB_EFFECT_GRADIENT_UP_DOWN] = 0x8b0ef006u,
+    [RGB_EFFECT_GRADIENT_LEFT_RIGHT] = 0x42964deau,
+    [RGB_EFFECT_BREATHING] = 0x3cfec637u,
+    [RGB_EFFECT_BAND_SAT] = 0x24e06c65u,
+    [RGB_EFFECT_BAND_VAL] = 0x8bbbb8fau,
+    [RGB_EFFECT_BAND_PINWHEEL_SAT] = 0x8ed3a3c5u,
+    [RGB_EFFECT_BAND_PINWHEEL_VAL] = 0xd1fc5b18u,
+    [RGB_EFFECT_BAND_SPIRAL_SAT] = 0x5e134562u,
+    [RGB_EFFECT_BAND_SPIRAL_VAL] = 0x635e847du,
+    [RGB_EFFECT_CYCLE_ALL] = 0x0dbf77e9u,
+    [RGB_EFFECT_CYCLE_LEFT_RIGHT] = 0xbe348cdfu,
+    [RGB_EFFECT_CYCLE_UP_DOWN] = 0x3c676b53u,
+    [RGB_EFFECT_CYCLE_OUT_IN] = 0x495fc83bu,
+    [RGB_EFFECT_CYCLE_OUT_IN_DUAL] = 0xfa300780u,
+    [RGB_EFFECT_RAINBOW_MOVING_CHEVRON] = 0xff78af49u,
+    [RGB_EFFECT_CYCLE_PINWHEEL] = 0x9349cc43u,
+    [RGB_EFFECT_CYCLE_SPIRAL] = 0xa35dd1dbu,
+    [RGB_EFFECT_DUAL_BEACON] = 0xc79dd805u,
+    [RGB_EFFECT_RAINBOW_BEACON] = 0xdbea22cbu,
+    [RGB_EFFECT_RAINBOW_PINWHEELS] = 0xf9cf55a2u,
+    [RGB_EFFECT_FLOWER_BLOOMING] = 0x15151b5eu,
+    [RGB_EFFECT_RAINDROPS] = 0xf3d3d08du,
+    [RGB_EFFECT_JELLYBEAN_RAINDROPS] = 0x7e646644u,
+    [RGB_EFFECT_HUE_BREATHING] = 0x9b4c6e08u,
+    [RGB_EFFECT_HUE_PENDULUM] = 0x60ac8537u,
+    [RGB_EFFECT_HUE_WAVE] = 0xadd95071u,
+    [RGB_EFFECT_PIXEL_FRACTAL] = 0xfe6414a6u,
+    [RGB_EFFECT_PIXEL_FLOW] = 0x32e434feu,
+    [RGB_EFFECT_PIXEL_RAIN] = 0xafd816e5u,
+    [RGB_EFFECT_TYPING_HEATMAP] = 0x71242602u,
+    [RGB_EFFECT_DIGITAL_RAIN] = 0xcb5fec17u,
+    [RGB_EFFECT_SOLID_REACTIVE_SIMPLE] = 0x15f8bccbu,
+    [RGB_EFFECT_SOLID_REACTIVE] = 0x21e57d7cu,
+    [RGB_EFFECT_SOLID_REACTIVE_WIDE] = 0x725a8e89u,
+    [RGB_EFFECT_SOLID_REACTIVE_MULTIWIDE] = 0xf7bbe2b3u,
+    [RGB_EFFECT_SOLID_REACTIVE_CROSS] = 0xdf6285c0u,
+    [RGB_EFFECT_SOLID_REACTIVE_MULTICROSS] = 0x9c4a7e93u,
+    [RGB_EFFECT_SOLID_REACTIVE_NEXUS] = 0x22a54827u,
+    [RGB_EFFECT_SOLID_REACTIVE_MULTINEXUS] = 0x7239fbebu,
+    [RGB_EFFECT_SPLASH] = 0x5128c079u,
+    [RGB_EFFECT_MULTISPLASH] = 0x8c42d2e7u,
+    [RGB_EFFECT_SOLID_SPLASH] = 0x899e5c6au,
+    [RGB_EFFECT_SOLID_MULTISPLASH] = 0xccd6eff8u,
+    [RGB_EFFECT_STARLIGHT] = 0x0b3d7a29u,
+    [RGB_EFFECT_STARLIGHT_SMOOTH] = 0xd3165a8cu,
+    [RGB_EFFECT_STARLIGHT_DUAL_HUE] = 0x4f91bcf2u,
+    [RGB_EFFECT_STARLIGHT_DUAL_SAT] = 0x7aa1c481u,
+    [RGB_EFFECT_RIVERFLOW] = 0x204f2f20u,
+    [RGB_EFFECT_ANALOG] = 0xbcf278a9u,
+    [RGB_EFFECT_PER_KEY] = 0x54ab3ca8u,
+    [RGB_EFFECT_TRIGGER_STATE] = 0x4916ad3du,
+    [RGB_EFFECT_BINARY_CLOCK] = 0x11a48c15u,
+};
+
+void rgb_driver_init(void) {}
+void rgb_driver_task(void) {}
+
+void rgb_driver_write(const uint8_t *grb_data, uint16_t byte_count) {
+  for (uint16_t i = 0; i < byte_count; i++) {
+    frame_hash ^= grb_data[i];
+    frame_hash *= 16777619u;
+  }
+  frames_written++;
+}
+
+uint32_t timer_read(void) { return mock_time; }
+
+uint32_t board_cycle_count(void) { return 0; }
+
+uint32_t matrix_get_idle_time(void) { return 0; }
+
+uint8_t layout_get_current_layer(void) { return mock_layer; }
+
+void setUp(void) {
+  memset(&mock_eeconfig, 0, sizeof(mock_eeconfig));
+  memset(&mock_profile, 0, sizeof(mock_profile));
+  memset(key_matrix, 0, sizeof(key_matrix));
+  mock_time = 0;
+  mock_layer = 0;
+
+  rgb_config_t *config = &mock_profile.rgb_config;
+  config->enabled = 1u;
+  config->global_brightness = 200u;
+  config->solid_color = (rgb_color_t){.r = 200u, .g = 40u, .b = 10u};
+  config->secondary_color = (rgb_color_t){.r = 10u, .g = 90u, .b = 30u};
+  config->background_color = (rgb_color_t){.r = 5u, .g = 6u, .b = 7u};
+  config->layer_colors[1] = (rgb_color_t){.r = 1u, .g = 2u, .b = 3u};
+  config->layer_indicator_mode = 2u;
+  config->layer_indicator_key = 3u;
+  for (uint32_t i = 0; i < NUM_KEYS; i++)
+    config->per_key_colors[i] =
+        (rgb_color_t){.r = i, .g = (uint8_t)(2u * i), .b = (uint8_t)(3u * i)};
+  for (uint8_t i = 0; i < 4; i++)
+    config->trigger_state_colors[i] =
+        (rgb_color_t){.r = (uint8_t)(10u * i), .g = 20u, .b = 30u};
+}
+
+void tearDown(void) {}
+
+static void golden_render(uint8_t effect, uint8_t speed) {
+  mock_profile.rgb_config.current_effect = effect;
+  mock_profile.rgb_config.effect_speed = speed;
+  mock_time += 100000u;
+  rgb_init();
+  rgb_set_clock_time(12u, 34u, 56u);
+
+  frames_written = 0;
+  for (uint32_t frame = 0; frame < GOLDEN_FRAMES; frame++) {
+    const uint32_t written = frames_written;
+
+    mock_time += 16u;
+    if (frame % 3u == 0u)
+      rgb_matrix_record_keypress((key_index_t)(frame % NUM_KEYS));
+    key_matrix[frame % NUM_KEYS].distance = (uint8_t)(frame * 7u);
+    key_matrix[frame % NUM_KEYS].is_pressed = (frame & 1u) != 0u;
+    mock_layer = (uint8_t)((frame / 24u) & 1u);
+
+    for (uint32_t calls = 0; calls < NUM_LEDS && frames_written == written;
+         calls++)
+      rgb_task();
+    TEST_ASSERT_EQUAL_UINT32(written + 1u, frames_written);
+  }
+}
+
+void test_rgb_golden_every_effect(void) {
+  char line[48];
+
+  for (uint8_t effect = 0; effect < RGB_EFFECT_MAX; effect++) {
+    frame_hash = 2166136261u;
+    for (uint8_t i = 0; i < M_ARRAY_SIZE(golden_speeds); i++)
+      golden_render(effect, golden_speeds[i]);
+
+    const uint32_t hash = frame_hash;
+    snprintf(line, sizeof(line), "effect %u: 0x%08lxu", (unsigned int)effect,
+             (unsigned long)hash);
+    TEST_ASSERT_EQUAL_HEX32_MESSAGE(golden_hashes[effect], hash, line);
+  }
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_rgb_golden_every_effect);
+  return UNITY_END();
+}
@@ -0,0 +1,351 @@
+#include <string.h>
+#include <unity.h>
+
+#include "hardware/rgb_api.h"
+#include "i2c_queue.h"
+
+// Simulated IS31FL3733-style controllers behind a fake interrupt-driven I2C
+// bus. The controllers model the command register lock and the register
+// pages, and the bus counts the bytes on the wire, including the address byte
+// of every transfer. Queued transfers stay pending until the test runs the
+// bus, as they would while the DMA sends them.
+
+#define SIM_NUM_DEVICES 2
+#define SIM_NUM_PAGES 4
+#define SIM_PAGE_SIZE 256
+#define SIM_PWM_SIZE 192
+
+// Bytes of a write of `len` registers: address, register and data
+#define WRITE_BYTES(len) (2u + (len))
+
+typedef struct {
+  uint8_t address;
+  bool unlocked;
+  uint8_t page;
+  uint8_t regs[SIM_NUM_PAGES][SIM_PAGE_SIZE];
+  uint32_t locked_page_writes;
+  uint32_t resets;
+} sim_device_t;
+
+static sim_device_t sim_devices[SIM_NUM_DEVICES];
+static uint32_t sim_wire_bytes;
+static uint32_t sim_transfers;
+static const i2c_transaction_t *sim_pending[64];
+static uint32_t sim_num_pending;
+static uint32_t sim_fail_next;
+
+static sim_device_t *sim_device(uint8_t address) {
+  for (uint8_t i = 0; i < SIM_NUM_DEVICES; i++)
+    if (sim_devices[i].address == address)
+      return &sim_devices[i];
+  return NULL;
+}
+
+static bool sim_write(uint8_t address, const uint8_t *tx, size_t len) {
+  sim_device_t *device = sim_device(address);
+
+  sim_wire_bytes += 1u + (uint32_t)len;
+  sim_transfers++;
+  if (device == NULL || len < 2)
+    return false;
+
+  const uint8_t reg = tx[0];
+
+  if (reg == 0xFE) {
+    device->unlocked = tx[1] == 0xC5;
+  } else if (reg == 0xFD) {
+    if (device->unlocked)
+      device->page = tx[1];
+    else
+      device->locked_page_writes++;
+    device->unlocked = false;
+  } else {
+    // The register address auto-increments within the page
+    for (size_t i = 1; i < len; i++)
+      device->regs[device->page][(reg + i - 1) % SIM_PAGE_SIZE] = tx[i];
+  }
+
+  return true;
+}
+
+void i2c_bus_init(void) {}
+
+bool i2c_bus_acquire(const i2c_bus_config_t *config) {
+  TEST_ASSERT_EQUAL_UINT8(RGB_I2C_MATRIX_BUS, config->bus);
+  return true;
+}
+
+void i2c_bus_release(const i2c_bus_config_t *config) { (void)config; }
+
+bool i2c_bus_write_register(const i2c_bus_config_t *config, uint8_t address,
+                            uint16_t reg, i2c_register_width_t register_width,
+                            const uint8_t *tx, size_t len) {
+  uint8_t buffer[SIM_PAGE_SIZE + 1];
+
+  TEST_ASSERT_EQUAL(I2C_REGISTER_8BIT, register_width);
+  TEST_ASSERT_FALSE(i2c_bus_busy(config->bus));
+  buffer[0] = (uint8_t)reg;
+  memcpy(&buffer[1], tx, len);
+  return sim_write(address, buffer, len + 1);
+}
+
+bool i2c_bus_read_register(const i2c_bus_config_t *config, uint8_t address,
+                           uint16_t reg, i2c_register_width_t register_width,
+                           uint8_t *rx, size_t len) {
+  sim_device_t *device = sim_device(address);
+
+  (void)config;
+  (void)register_width;
+  sim_wire_bytes += 3u + (uint32_t)len;
+  if (device == NULL)
+    return false;
+
+  memset(rx, 0, len);
+  if (device->page == 0x03 && reg == 0x11) {
+    memset(device->regs, 0, sizeof(device->regs));
+    device->resets++;
+  }
+  return true;
+}
+
+i2c_driver_status_t i2c_driver_start(uint8_t bus,
+                                     const i2c_transaction_t *transaction) {
+  TEST_ASSERT_EQUAL_UINT8(RGB_I2C_MATRIX_BUS, bus);
+  TEST_ASSERT_EQUAL_UINT32(0, sim_num_pending);
+  sim_pending[sim_num_pending++] = transaction;
+  return I2C_DRIVER_PENDING;
+}
+
+void i2c_driver_mask_irq(uint8_t bus, bool masked) {
+  (void)bus;
+  (void)masked;
+}
+
+// Complete the queued transfers as the I2C interrupts would
+static void sim_run_bus(void) {
+  while (sim_num_pending > 0) {
+    const i2c_transaction_t *transaction = sim_pending[0];
+    bool success;
+
+    sim_num_pending = 0;
+    if (sim_fail_next > 0) {
+      // NACK of the address byte
+      sim_fail_next--;
+      sim_wire_bytes += 1u;
+      success = false;
+    } else {
+      success = sim_write(transaction->address, transaction->tx,
+                          transaction->len);
+    }
+    i2c_queue_complete(RGB_I2C_MATRIX_BUS, success);
+  }
+}
+
+//--------------------------------------------------------------------+
+// Frames
+//--------------------------------------------------------------------+
+
+typedef struct {
+  uint8_t device;
+  uint8_t r;
+  uint8_t g;
+  uint8_t b;
+} led_t;
+
+static const uint8_t addresses[] = RGB_I2C_MATRIX_ADDRESSES;
+static const led_t leds[] = RGB_I2C_MATRIX_LED_MAP;
+
+static uint8_t frame[NUM_LEDS * 3];
+
+static void set_led(uint8_t led, uint8_t r, uint8_t g, uint8_t b) {
+  frame[led * 3] = g;
+  frame[led * 3 + 1] = r;
+  frame[led * 3 + 2] = b;
+}
+
+static void fill(uint8_t value) {
+  for (uint8_t i = 0; i < NUM_LEDS; i++)
+    set_led(i, value, (uint8_t)(value + 1), (uint8_t)(value + 2));
+}
+
+// Write the frame, and return the bytes on the wire until it is displayed
+static uint32_t send_frame(void) {
+  const uint32_t start = sim_wire_bytes;
+
+  rgb_driver_write(frame, sizeof(frame));
+  rgb_driver_task();
+  sim_run_bus();
+  rgb_driver_task();
+  sim_run_bus();
+
+  return sim_wire_bytes - start;
+}
+
+static void assert_frame_displayed(void) {
+  for (uint8_t i = 0; i < NUM_LEDS; i++) {
+    const uint8_t *pwm = sim_devices[leds[i].device].regs[0x01];
+
+    TEST_ASSERT_EQUAL_UINT8(frame[i * 3], pwm[leds[i].g]);
+    TEST_ASSERT_EQUAL_UINT8(frame[i * 3 + 1], pwm[leds[i].r]);
+    TEST_ASSERT_EQUAL_UINT8(frame[i * 3 + 2], pwm[leds[i].b]);
+  }
+}
+
+void setUp(void) {
+  static bool initialized = false;
+
+  if (!initialized) {
+    initialized = true;
+    for (uint8_t i = 0; i < SIM_NUM_DEVICES; i++)
+      sim_devices[i].address = addresses[i];
+    rgb_driver_init();
+  }
+
+  // Every test starts from a dark frame on the devices
+  sim_fail_next = 0;
+  memset(frame, 0, sizeof(frame));
+  send_frame();
+  assert_frame_displayed();
+}
+
+void tearDown(void) {}
+
+void test_rgb_i2c_matrix_initializes_devices(void) {
+  for (uint8_t d = 0; d < SIM_NUM_DEVICES; d++) {
+    const sim_device_t *device = &sim_devices[d];
+    uint8_t led_control[24] = {0};
+
+    for (uint8_t i = 0; i < NUM_LEDS; i++) {
+      if (leds[i].device != d)
+        continue;
+      led_control[leds[i].r / 8] |= (uint8_t)(1u << (leds[i].r % 8));
+      led_control[leds[i].g / 8] |= (uint8_t)(1u << (leds[i].g % 8));
+      led_control[leds[i].b / 8] |= (uint8_t)(1u << (leds[i].b % 8));
+    }
+
+    TEST_ASSERT_EQUAL_UINT32(1, device->resets);
+    TEST_ASSERT_EQUAL_UINT32(0, device->locked_page_writes);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(led_control, device->regs[0x00], 24);
+    TEST_ASSERT_EQUAL_HEX8(0x01, device->regs[0x03][0x00]);
+    TEST_ASSERT_EQUAL_HEX8(RGB_I2C_MATRIX_GLOBAL_CURRENT,
+                           device->regs[0x03][0x01]);
+    // The frames write the PWM page directly
+    TEST_ASSERT_EQUAL_HEX8(0x01, device->page);
+  }
+}
+
+void test_rgb_i2c_matrix_skips_unchanged_frames(void) {
+  fill(10);
+  TEST_ASSERT_NOT_EQUAL(0, send_frame());
+  assert_frame_displayed();
+
+  const uint32_t transfers = sim_transfers;
+  TEST_ASSERT_EQUAL_UINT32(0, send_frame());
+  TEST_ASSERT_EQUAL_UINT32(transfers, sim_transfers);
+}
+
+void test_rgb_i2c_matrix_writes_only_changed_registers(void) {
+  // The channels of an LED are on separate rows of the matrix
+  set_led(1, 1, 2, 3);
+  TEST_ASSERT_EQUAL_UINT32(3 * WRITE_BYTES(1), send_frame());
+  assert_frame_displayed();
+
+  // A single changed channel is a single one-register write
+  set_led(1, 1, 20, 3);
+  TEST_ASSERT_EQUAL_UINT32(WRITE_BYTES(1), send_frame());
+  assert_frame_displayed();
+}
+
+void test_rgb_i2c_matrix_merges_nearby_ranges(void) {
+  // Columns 0 and 2 are written with column 1 in between, which is cheaper
+  // than a second write
+  set_led(0, 5, 5, 5);
+  set_led(2, 5, 5, 5);
+  TEST_ASSERT_EQUAL_UINT32(3 * WRITE_BYTES(3), send_frame());
+  assert_frame_displayed();
+
+}
+
+void test_rgb_i2c_matrix_splits_distant_ranges(void) {
+  // Columns 0 and 6 are cheaper to write separately than together
+  set_led(0, 0, 7, 0);
+  set_led(3, 0, 7, 0);
+  TEST_ASSERT_EQUAL_UINT32(2 * WRITE_BYTES(1), send_frame());
+  assert_frame_displayed();
+}
+
+void test_rgb_i2c_matrix_full_frame_is_far_below_full_pages(void) {
+  fill(50);
+  const uint32_t bytes = send_frame();
+  assert_frame_displayed();
+
+  // Each color is on its own row, in columns 0, 1, 2 and 6 of the first device
+  // and in columns 5 and 6 of the second one
+  TEST_ASSERT_EQUAL_UINT32(3 * (WRITE_BYTES(3) + WRITE_BYTES(1)) +
+                               3 * WRITE_BYTES(2),
+                           bytes);
+  TEST_ASSERT_TRUE(bytes < SIM_NUM_DEVICES * WRITE_BYTES(SIM_PWM_SIZE) / 8);
+}
+
+void test_rgb_i2c_matrix_does_not_block_and_sends_the_latest_frame(void) {
+  fill(20);
+  rgb_driver_write(frame, sizeof(frame));
+  rgb_driver_task();
+  // The writes are queued on the bus rather than waited for
+  TEST_ASSERT_EQUAL_UINT32(1, sim_num_pending);
+  TEST_ASSERT_TRUE(i2c_bus_busy(RGB_I2C_MATRIX_BUS));
+
+  // Frames written while the batch is in flight replace each other
+  fill(30);
+  rgb_driver_write(frame, sizeof(frame));
+  rgb_driver_task();
+  fill(40);
+  rgb_driver_write(frame, sizeof(frame));
+  rgb_driver_task();
+  TEST_ASSERT_EQUAL_UINT32(1, sim_num_pending);
+
+  const uint32_t transfers = sim_transfers;
+  sim_run_bus();
+  // Only the first frame has been sent so far
+  TEST_ASSERT_EQUAL_UINT32(9, sim_transfers - transfers);
+  TEST_ASSERT_EQUAL_UINT8(21, sim_devices[0].regs[0x01][leds[0].g]);
+
+  rgb_driver_task();
+  sim_run_bus();
+  TEST_ASSERT_EQUAL_UINT32(18, sim_transfers - transfers);
+  assert_frame_displayed();
+}
+
+void test_rgb_i2c_matrix_resynchronizes_after_a_failed_write(void) {
+  fill(60);
+  sim_fail_next = 1;
+  rgb_driver_write(frame, sizeof(frame));
+  rgb_driver_task();
+  sim_run_bus();
+
+  // The failed device gets its page selected and all of its PWM registers
+  // written again, without a new frame
+  const uint32_t start = sim_wire_bytes;
+  rgb_driver_task();
+  sim_run_bus();
+  TEST_ASSERT_EQUAL_UINT32(2 * WRITE_BYTES(1) + WRITE_BYTES(SIM_PWM_SIZE),
+                           sim_wire_bytes - start);
+  assert_frame_displayed();
+  TEST_ASSERT_EQUAL_UINT32(0, sim_devices[0].locked_page_writes);
+
+  // Back to differential updates
+  TEST_ASSERT_EQUAL_UINT32(0, send_frame());
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_rgb_i2c_matrix_initializes_devices);
+  RUN_TEST(test_rgb_i2c_matrix_skips_unchanged_frames);
+  RUN_TEST(test_rgb_i2c_matrix_writes_only_changed_registers);
+  RUN_TEST(test_rgb_i2c_matrix_merges_nearby_ranges);
+  RUN_TEST(test_rgb_i2c_matrix_splits_distant_ranges);
+  RUN_TEST(test_rgb_i2c_matrix_full_frame_is_far_below_full_pages);
+  RUN_TEST(test_rgb_i2c_matrix_does_not_block_and_sends_the_latest_frame);
+  RUN_TEST(test_rgb_i2c_matrix_resynchronizes_after_a_failed_write);
+  return UNITY_END();
+}
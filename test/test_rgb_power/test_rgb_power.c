@@ -0,0 +1,146 @@
+#include <string.h>
+#include <unity.h>
+
+#include "eeconfig.h"
+#include "matrix.h"
+#include "rgb.h"
+
+// Built with `RGB_GAMMA=2.2f`, `RGB_WHITE_BALANCE={255, 200, 180}`,
+// `RGB_MAX_CURRENT_MA=500` and `RGB_LED_CHANNEL_CURRENT_MA=20`.
+
+#define POWER_FRAMES 128
+
+static eeconfig_t mock_eeconfig;
+const eeconfig_t *eeconfig = &mock_eeconfig;
+static eeconfig_profile_t mock_profile;
+const eeconfig_profile_t *eeconfig_profile = &mock_profile;
+key_state_t key_matrix[NUM_KEYS];
+
+static uint8_t last_grb_frame[NUM_LEDS * 3];
+static uint32_t frames_written;
+static uint32_t mock_time;
+static uint8_t mock_layer;
+
+void rgb_driver_init(void) {}
+void rgb_driver_task(void) {}
+
+void rgb_driver_write(const uint8_t *grb_data, uint16_t byte_count) {
+  memcpy(last_grb_frame, grb_data, byte_count);
+  frames_written++;
+}
+
+uint32_t timer_read(void) { return mock_time; }
+
+uint32_t board_cycle_count(void) { return 0; }
+
+uint32_t matrix_get_idle_time(void) { return 0; }
+
+uint8_t layout_get_current_layer(void) { return mock_layer; }
+
+// Estimated current of the last frame sent to the driver, in microamps
+static uint32_t last_frame_current_ua(void) {
+  uint32_t sum = 0;
+  for (uint16_t i = 0; i < sizeof(last_grb_frame); i++)
+    sum += last_grb_frame[i];
+  return sum * RGB_LED_CHANNEL_CURRENT_MA * 1000u / 255u;
+}
+
+void setUp(void) {
+  memset(&mock_eeconfig, 0, sizeof(mock_eeconfig));
+  memset(&mock_profile, 0, sizeof(mock_profile));
+  memset(key_matrix, 0, sizeof(key_matrix));
+  mock_layer = 0;
+
+  const rgb_color_t white = {.r = 255u, .g = 255u, .b = 255u};
+  rgb_config_t *config = &mock_profile.rgb_config;
+  config->enabled = 1u;
+  config->global_brightness = 255u;
+  config->effect_speed = 128u;
+  config->solid_color = white;
+  config->secondary_color = white;
+  config->background_color = white;
+  config->layer_colors[1] = white;
+  for (uint32_t i = 0; i < NUM_KEYS; i++)
+    config->per_key_colors[i] = white;
+  for (uint8_t i = 0; i < 4; i++)
+    config->trigger_state_colors[i] = white;
+}
+
+void tearDown(void) {}
+
+void test_rgb_power_applies_gamma_and_white_balance(void) {
+  rgb_config_t *config = &mock_profile.rgb_config;
+  config->current_effect = RGB_EFFECT_SOLID_COLOR;
+  config->solid_color = (rgb_color_t){.r = 128u, .g = 128u, .b = 128u};
+  rgb_init();
+
+  mock_time += 1000u;
+  rgb_task();
+
+  // 255 * (128 / 255)^2.2 scaled by the white balance of each channel
+  TEST_ASSERT_EQUAL_UINT8(44u, last_grb_frame[0]);
+  TEST_ASSERT_EQUAL_UINT8(56u, last_grb_frame[1]);
+  TEST_ASSERT_EQUAL_UINT8(40u, last_grb_frame[2]);
+  TEST_ASSERT_TRUE(last_frame_current_ua() <= RGB_MAX_CURRENT_MA * 1000u);
+}
+
+void test_rgb_power_scales_full_white_to_budget(void) {
+  mock_profile.rgb_config.current_effect = RGB_EFFECT_SOLID_COLOR;
+  rgb_init();
+
+  mock_time += 1000u;
+  rgb_task();
+
+  // Full white would draw about 2 A, so the whole frame is scaled by 64/256
+  for (uint8_t i = 0; i < NUM_LEDS; i++) {
+    TEST_ASSERT_EQUAL_UINT8(50u, last_grb_frame[i * 3u + 0u]);
+    TEST_ASSERT_EQUAL_UINT8(63u, last_grb_frame[i * 3u + 1u]);
+    TEST_ASSERT_EQUAL_UINT8(45u, last_grb_frame[i * 3u + 2u]);
+  }
+  TEST_ASSERT_TRUE(last_frame_current_ua() <= RGB_MAX_CURRENT_MA * 1000u);
+}
+
+void test_rgb_power_budget_holds_for_every_effect(void) {
+  uint32_t max_current_ua = 0;
+
+  for (uint8_t effect = 0; effect < RGB_EFFECT_MAX; effect++) {
+    mock_profile.rgb_config.current_effect = effect;
+    mock_time += 100000u;
+    rgb_init();
+    rgb_set_clock_time(12u, 34u, 56u);
+    TEST_ASSERT_TRUE(last_frame_current_ua() <= RGB_MAX_CURRENT_MA * 1000u);
+
+    frames_written = 0;
+    for (uint32_t frame = 0; frame < POWER_FRAMES; frame++) {
+      const uint32_t written = frames_written;
+
+      mock_time += 16u;
+      if (frame % 3u == 0u)
+        rgb_matrix_record_keypress((key_index_t)(frame % NUM_KEYS));
+      key_matrix[frame % NUM_KEYS].distance = 255u;
+      key_matrix[frame % NUM_KEYS].is_pressed = true;
+      mock_layer = (uint8_t)((frame / 32u) & 1u);
+
+      for (uint32_t calls = 0; calls < NUM_LEDS && frames_written == written;
+           calls++)
+        rgb_task();
+      TEST_ASSERT_EQUAL_UINT32(written + 1u, frames_written);
+
+      const uint32_t current_ua = last_frame_current_ua();
+      TEST_ASSERT_TRUE(current_ua <= RGB_MAX_CURRENT_MA * 1000u);
+      if (current_ua > max_current_ua)
+        max_current_ua = current_ua;
+    }
+  }
+
+  // The limiter must actually have been engaged, not merely never needed
+  TEST_ASSERT_TRUE(max_current_ua > RGB_MAX_CURRENT_MA * 950u);
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_rgb_power_applies_gamma_and_white_balance);
+  RUN_TEST(test_rgb_power_scales_full_white_to_budget);
+  RUN_TEST(test_rgb_power_budget_holds_for_every_effect);
+  return UNITY_END();
+}
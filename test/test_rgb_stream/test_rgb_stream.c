@@ -0,0 +1,274 @@
+#include <string.h>
+#include <unity.h>
+
+#include "rgb.h"
+#include "rgb_stream.h"
+
+static uint32_t mock_time;
+
+uint32_t timer_read(void) { return mock_time; }
+
+void setUp(void) {
+  mock_time = 1000u;
+  rgb_stream_reset();
+}
+
+void tearDown(void) {}
+
+static void assert_color(const rgb_color_t *frame, uint8_t led, uint8_t r,
+                         uint8_t g, uint8_t b) {
+  TEST_ASSERT_EQUAL_UINT8(r, frame[led].r);
+  TEST_ASSERT_EQUAL_UINT8(g, frame[led].g);
+  TEST_ASSERT_EQUAL_UINT8(b, frame[led].b);
+}
+
+void test_rgb_stream_is_inactive_until_a_frame_is_presented(void) {
+  static const uint8_t raw[] = {1, 2, 3};
+
+  TEST_ASSERT_NULL(rgb_stream_begin_frame());
+  TEST_ASSERT_TRUE(
+      rgb_stream_write(1u, 0u, RGB_STREAM_ENCODING_RAW, 0u, raw, sizeof(raw)));
+  TEST_ASSERT_NULL(rgb_stream_begin_frame());
+}
+
+void test_rgb_stream_decodes_raw_frame(void) {
+  static const uint8_t raw[] = {10, 20, 30, 40, 50, 60};
+
+  TEST_ASSERT_TRUE(rgb_stream_write(1u, RGB_STREAM_FLAG_PRESENT,
+                                    RGB_STREAM_ENCODING_RAW, 3u, raw,
+                                    sizeof(raw)));
+
+  const rgb_color_t *frame = rgb_stream_begin_frame();
+  TEST_ASSERT_NOT_NULL(frame);
+  assert_color(frame, 2u, 0u, 0u, 0u);
+  assert_color(frame, 3u, 10u, 20u, 30u);
+  assert_color(frame, 4u, 40u, 50u, 60u);
+  assert_color(frame, 5u, 0u, 0u, 0u);
+  TEST_ASSERT_EQUAL_UINT16(1u, rgb_stream_get_status().presented_sequence);
+}
+
+void test_rgb_stream_decodes_run_length_frame(void) {
+  // A whole frame in one packet: three runs covering every LED
+  const uint8_t rle[] = {
+      10, 255, 0, 0, 20, 0, 255, 0, (uint8_t)(NUM_LEDS - 30), 0, 0, 255,
+  };
+
+  TEST_ASSERT_TRUE(rgb_stream_write(7u, RGB_STREAM_FLAG_PRESENT,
+                                    RGB_STREAM_ENCODING_RLE, 0u, rle,
+                                    sizeof(rle)));
+
+  const rgb_color_t *frame = rgb_stream_begin_frame();
+  TEST_ASSERT_NOT_NULL(frame);
+  assert_color(frame, 0u, 255u, 0u, 0u);
+  assert_color(frame, 9u, 255u, 0u, 0u);
+  assert_color(frame, 10u, 0u, 255u, 0u);
+  assert_color(frame, 29u, 0u, 255u, 0u);
+  assert_color(frame, 30u, 0u, 0u, 255u);
+  assert_color(frame, NUM_LEDS - 1u, 0u, 0u, 255u);
+}
+
+void test_rgb_stream_decodes_palette_frame(void) {
+  static const uint8_t palette[] = {0, 0, 0, 1, 2, 3, 4, 5, 6};
+  // LEDs 0..4 use palette entries 1, 2, 0, 2, 1
+  static const uint8_t indices[] = {0x21, 0x20, 0x01};
+
+  TEST_ASSERT_TRUE(rgb_stream_write(2u, 0u, RGB_STREAM_ENCODING_SET_PALETTE,
+                                    0u, palette, sizeof(palette)));
+  TEST_ASSERT_TRUE(rgb_stream_write(2u, RGB_STREAM_FLAG_PRESENT,
+                                    RGB_STREAM_ENCODING_PALETTE, 0u, indices,
+                                    sizeof(indices)));
+
+  const rgb_color_t *frame = rgb_stream_begin_frame();
+  TEST_ASSERT_NOT_NULL(frame);
+  assert_color(frame, 0u, 1u, 2u, 3u);
+  assert_color(frame, 1u, 4u, 5u, 6u);
+  assert_color(frame, 2u, 0u, 0u, 0u);
+  assert_color(frame, 3u, 4u, 5u, 6u);
+  assert_color(frame, 4u, 1u, 2u, 3u);
+  // The upper nibble of the last byte covers LED 5 with entry 0
+  assert_color(frame, 5u, 0u, 0u, 0u);
+}
+
+void test_rgb_stream_frame_spans_multiple_packets(void) {
+  static const uint8_t first[] = {1, 1, 1};
+  static const uint8_t second[] = {2, 2, 2};
+
+  TEST_ASSERT_TRUE(rgb_stream_write(3u, 0u, RGB_STREAM_ENCODING_RAW, 0u,
+                                    first, sizeof(first)));
+  TEST_ASSERT_TRUE(rgb_stream_write(3u, RGB_STREAM_FLAG_PRESENT,
+                                    RGB_STREAM_ENCODING_RAW, NUM_LEDS - 1u,
+                                    second, sizeof(second)));
+
+  const rgb_color_t *frame = rgb_stream_begin_frame();
+  assert_color(frame, 0u, 1u, 1u, 1u);
+  assert_color(frame, NUM_LEDS - 1u, 2u, 2u, 2u);
+}
+
+void test_rgb_stream_new_frame_starts_from_previous_frame(void) {
+  static const uint8_t full[] = {9, 9, 9, 9, 9, 9};
+  static const uint8_t update[] = {5, 6, 7};
+
+  rgb_stream_write(1u, RGB_STREAM_FLAG_PRESENT, RGB_STREAM_ENCODING_RAW, 0u,
+                   full, sizeof(full));
+  rgb_stream_begin_frame();
+  rgb_stream_write(2u, RGB_STREAM_FLAG_PRESENT, RGB_STREAM_ENCODING_RAW, 1u,
+                   update, sizeof(update));
+
+  const rgb_color_t *frame = rgb_stream_begin_frame();
+  assert_color(frame, 0u, 9u, 9u, 9u);
+  assert_color(frame, 1u, 5u, 6u, 7u);
+}
+
+void test_rgb_stream_front_buffer_only_changes_at_frame_start(void) {
+  static const uint8_t red[] = {255, 0, 0};
+  static const uint8_t green[] = {0, 255, 0};
+
+  rgb_stream_write(1u, RGB_STREAM_FLAG_PRESENT, RGB_STREAM_ENCODING_RAW, 0u,
+                   red, sizeof(red));
+  const rgb_color_t *frame = rgb_stream_begin_frame();
+
+  // A frame decoded and presented while the previous one is being rendered
+  rgb_stream_write(2u, 0u, RGB_STREAM_ENCODING_RAW, 0u, green, sizeof(green));
+  assert_color(frame, 0u, 255u, 0u, 0u);
+  rgb_stream_write(2u, RGB_STREAM_FLAG_PRESENT, RGB_STREAM_ENCODING_RAW, 0u,
+                   green, sizeof(green));
+  assert_color(frame, 0u, 255u, 0u, 0u);
+
+  frame = rgb_stream_begin_frame();
+  assert_color(frame, 0u, 0u, 255u, 0u);
+}
+
+void test_rgb_stream_ignores_stale_sequence(void) {
+  static const uint8_t red[] = {255, 0, 0};
+  static const uint8_t blue[] = {0, 0, 255};
+
+  rgb_stream_write(10u, RGB_STREAM_FLAG_PRESENT, RGB_STREAM_ENCODING_RAW, 0u,
+                   red, sizeof(red));
+  TEST_ASSERT_TRUE(rgb_stream_write(9u, RGB_STREAM_FLAG_PRESENT,
+                                    RGB_STREAM_ENCODING_RAW, 0u, blue,
+                                    sizeof(blue)));
+  TEST_ASSERT_TRUE(rgb_stream_write(10u, RGB_STREAM_FLAG_PRESENT,
+                                    RGB_STREAM_ENCODING_RAW, 0u, blue,
+                                    sizeof(blue)));
+
+  const rgb_color_t *frame = rgb_stream_begin_frame();
+  assert_color(frame, 0u, 255u, 0u, 0u);
+  TEST_ASSERT_EQUAL_UINT16(10u, rgb_stream_get_status().presented_sequence);
+}
+
+void test_rgb_stream_sequence_wraps_around(void) {
+  static const uint8_t red[] = {255, 0, 0};
+  static const uint8_t blue[] = {0, 0, 255};
+
+  rgb_stream_write(0xFFFFu, RGB_STREAM_FLAG_PRESENT, RGB_STREAM_ENCODING_RAW,
+                   0u, red, sizeof(red));
+  rgb_stream_write(0u, RGB_STREAM_FLAG_PRESENT, RGB_STREAM_ENCODING_RAW, 0u,
+                   blue, sizeof(blue));
+
+  const rgb_color_t *frame = rgb_stream_begin_frame();
+  assert_color(frame, 0u, 0u, 0u, 255u);
+}
+
+void test_rgb_stream_counts_dropped_frames(void) {
+  static const uint8_t raw[] = {1, 2, 3};
+
+  // Frame 1 is never completed, frame 2 is presented but superseded by frame
+  // 3 before any frame starts
+  rgb_stream_write(1u, 0u, RGB_STREAM_ENCODING_RAW, 0u, raw, sizeof(raw));
+  rgb_stream_write(2u, RGB_STREAM_FLAG_PRESENT, RGB_STREAM_ENCODING_RAW, 0u,
+                   raw, sizeof(raw));
+  rgb_stream_write(3u, RGB_STREAM_FLAG_PRESENT, RGB_STREAM_ENCODING_RAW, 0u,
+                   raw, sizeof(raw));
+
+  const rgb_stream_status_t status = rgb_stream_get_status();
+  TEST_ASSERT_EQUAL_UINT16(3u, status.presented_sequence);
+  TEST_ASSERT_EQUAL_UINT16(2u, status.dropped_frames);
+}
+
+void test_rgb_stream_rejects_malformed_packets_without_applying(void) {
+  static const uint8_t red[] = {255, 0, 0};
+  static const uint8_t partial[] = {1, 2};
+  static const uint8_t zero_run[] = {0, 1, 2, 3};
+  const uint8_t long_run[] = {NUM_LEDS, 1, 2, 3};
+  const uint8_t indices[] = {0x11};
+  const uint8_t palette[] = {1, 2, 3};
+
+  rgb_stream_write(1u, RGB_STREAM_FLAG_PRESENT, RGB_STREAM_ENCODING_RAW, 0u,
+                   red, sizeof(red));
+  rgb_stream_begin_frame();
+
+  TEST_ASSERT_FALSE(rgb_stream_write(2u, RGB_STREAM_FLAG_PRESENT,
+                                     RGB_STREAM_ENCODING_RAW, 0u, partial,
+                                     sizeof(partial)));
+  TEST_ASSERT_FALSE(rgb_stream_write(2u, RGB_STREAM_FLAG_PRESENT,
+                                     RGB_STREAM_ENCODING_RAW, NUM_LEDS, red,
+                                     sizeof(red)));
+  TEST_ASSERT_FALSE(rgb_stream_write(2u, RGB_STREAM_FLAG_PRESENT,
+                                     RGB_STREAM_ENCODING_RLE, 0u, zero_run,
+                                     sizeof(zero_run)));
+  TEST_ASSERT_FALSE(rgb_stream_write(2u, RGB_STREAM_FLAG_PRESENT,
+                                     RGB_STREAM_ENCODING_RLE, 1u, long_run,
+                                     sizeof(long_run)));
+  TEST_ASSERT_FALSE(rgb_stream_write(2u, RGB_STREAM_FLAG_PRESENT,
+                                     RGB_STREAM_ENCODING_PALETTE, NUM_LEDS,
+                                     indices, sizeof(indices)));
+  TEST_ASSERT_FALSE(rgb_stream_write(2u, RGB_STREAM_FLAG_PRESENT,
+                                     RGB_STREAM_ENCODING_SET_PALETTE,
+                                     RGB_STREAM_PALETTE_SIZE, palette,
+                                     sizeof(palette)));
+  TEST_ASSERT_FALSE(rgb_stream_write(2u, RGB_STREAM_FLAG_PRESENT,
+                                     RGB_STREAM_ENCODING_COUNT, 0u, red,
+                                     sizeof(red)));
+
+  const rgb_color_t *frame = rgb_stream_begin_frame();
+  assert_color(frame, 0u, 255u, 0u, 0u);
+  TEST_ASSERT_EQUAL_UINT16(1u, rgb_stream_get_status().presented_sequence);
+}
+
+void test_rgb_stream_falls_back_after_timeout(void) {
+  static const uint8_t raw[] = {1, 2, 3};
+
+  rgb_stream_write(1u, RGB_STREAM_FLAG_PRESENT, RGB_STREAM_ENCODING_RAW, 0u,
+                   raw, sizeof(raw));
+  mock_time += RGB_STREAM_TIMEOUT_MS - 1u;
+  TEST_ASSERT_NOT_NULL(rgb_stream_begin_frame());
+
+  mock_time += 1u;
+  TEST_ASSERT_NULL(rgb_stream_begin_frame());
+
+  // A restarted stream may begin from any sequence
+  TEST_ASSERT_TRUE(rgb_stream_write(0u, RGB_STREAM_FLAG_PRESENT,
+                                    RGB_STREAM_ENCODING_RAW, 0u, raw,
+                                    sizeof(raw)));
+  TEST_ASSERT_NOT_NULL(rgb_stream_begin_frame());
+}
+
+void test_rgb_stream_stop_flag_restores_stored_effect(void) {
+  static const uint8_t raw[] = {1, 2, 3};
+
+  rgb_stream_write(1u, RGB_STREAM_FLAG_PRESENT, RGB_STREAM_ENCODING_RAW, 0u,
+                   raw, sizeof(raw));
+  TEST_ASSERT_NOT_NULL(rgb_stream_begin_frame());
+
+  TEST_ASSERT_TRUE(rgb_stream_write(2u, RGB_STREAM_FLAG_STOP, 0u, 0u, NULL,
+                                    0u));
+  TEST_ASSERT_NULL(rgb_stream_begin_frame());
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_rgb_stream_is_inactive_until_a_frame_is_presented);
+  RUN_TEST(test_rgb_stream_decodes_raw_frame);
+  RUN_TEST(test_rgb_stream_decodes_run_length_frame);
+  RUN_TEST(test_rgb_stream_decodes_palette_frame);
+  RUN_TEST(test_rgb_stream_frame_spans_multiple_packets);
+  RUN_TEST(test_rgb_stream_new_frame_starts_from_previous_frame);
+  RUN_TEST(test_rgb_stream_front_buffer_only_changes_at_frame_start);
+  RUN_TEST(test_rgb_stream_ignores_stale_sequence);
+  RUN_TEST(test_rgb_stream_sequence_wraps_around);
+  RUN_TEST(test_rgb_stream_counts_dropped_frames);
+  RUN_TEST(test_rgb_stream_rejects_malformed_packets_without_applying);
+  RUN_TEST(test_rgb_stream_falls_back_after_timeout);
+  RUN_TEST(test_rgb_stream_stop_flag_restores_stored_effect);
+  return UNITY_END();
+}
@@ -0,0 +1,314 @@
+#include <string.h>
+#include <unity.h>
+
+#include "spi_queue.h"
+
+// Fake backend: bus 0 transfers through a fake DMA that completes when the
+// test says so, bus 1 is polled. Both loop the transmitted bytes back.
+
+#define FAKE_MAX_EVENTS 32
+
+typedef enum {
+  FAKE_SELECT,
+  FAKE_DESELECT,
+  FAKE_START,
+} fake_event_type_t;
+
+typedef struct {
+  fake_event_type_t type;
+  const void *target;
+} fake_event_t;
+
+static fake_event_t fake_events[FAKE_MAX_EVENTS];
+static uint32_t fake_num_events;
+static const spi_transaction_t *fake_dma_active;
+static spi_driver_status_t fake_polled_status;
+static bool fake_acquire_result;
+static int fake_mask_depth[SPI_NUM_BUSES];
+static uint32_t fake_masked_starts;
+
+static void fake_record(fake_event_type_t type, const void *target) {
+  TEST_ASSERT_LESS_THAN_UINT32(FAKE_MAX_EVENTS, fake_num_events);
+  fake_events[fake_num_events++] = (fake_event_t){type, target};
+}
+
+static void fake_loopback(const spi_transaction_t *transaction) {
+  for (size_t i = 0; i < transaction->len; i++) {
+    if (transaction->rx != NULL)
+      transaction->rx[i] =
+          transaction->tx != NULL ? transaction->tx[i] : (uint8_t)0xFF;
+  }
+}
+
+bool spi_bus_acquire(const spi_bus_config_t *config) {
+  (void)config;
+  return fake_acquire_result;
+}
+
+void spi_cs_select(const spi_chip_select_t *chip_select) {
+  fake_record(FAKE_SELECT, chip_select);
+}
+
+void spi_cs_deselect(const spi_chip_select_t *chip_select) {
+  fake_record(FAKE_DESELECT, chip_select);
+}
+
+spi_driver_status_t spi_driver_start(uint8_t bus,
+                                     const spi_transaction_t *transaction) {
+  fake_record(FAKE_START, transaction);
+  fake_masked_starts += fake_mask_depth[bus] > 0;
+  if (bus == 1) {
+    if (fake_polled_status == SPI_DRIVER_DONE)
+      fake_loopback(transaction);
+    return fake_polled_status;
+  }
+
+  TEST_ASSERT_NULL(fake_dma_active);
+  fake_dma_active = transaction;
+  return SPI_DRIVER_PENDING;
+}
+
+void spi_driver_mask_irq(uint8_t bus, bool masked) {
+  fake_mask_depth[bus] += masked ? 1 : -1;
+}
+
+// Complete the fake DMA transfer of bus 0, as its interrupt would
+static void fake_dma_complete(bool success) {
+  const spi_transaction_t *transaction = fake_dma_active;
+
+  TEST_ASSERT_NOT_NULL(transaction);
+  // Interrupts are not taken while the queue is updated
+  TEST_ASSERT_EQUAL_INT(0, fake_mask_depth[0]);
+  if (success)
+    fake_loopback(transaction);
+  fake_dma_active = NULL;
+  spi_queue_complete(0, success);
+}
+
+static const spi_bus_config_t dma_bus = {.bus = 0, .frequency_hz = 1000000};
+static const spi_bus_config_t polled_bus = {.bus = 1, .frequency_hz = 1000000};
+static const spi_chip_select_t cs_a = {.active_low = true};
+static const spi_chip_select_t cs_b = {.active_low = true};
+
+static uint32_t callback_count;
+static bool callback_success[8];
+static spi_transaction_t *callback_order[8];
+
+static void record_callback(spi_transaction_t *transaction, bool success) {
+  if (callback_count < M_ARRAY_SIZE(callback_order)) {
+    callback_order[callback_count] = transaction;
+    callback_success[callback_count] = success;
+  }
+  callback_count++;
+}
+
+void setUp(void) {
+  memset(fake_events, 0, sizeof(fake_events));
+  fake_num_events = 0;
+  fake_dma_active = NULL;
+  fake_polled_status = SPI_DRIVER_DONE;
+  fake_acquire_result = true;
+  memset(fake_mask_depth, 0, sizeof(fake_mask_depth));
+  fake_masked_starts = 0;
+  callback_count = 0;
+  memset(callback_success, 0, sizeof(callback_success));
+  memset(callback_order, 0, sizeof(callback_order));
+}
+
+void tearDown(void) {
+  // Leave the queues empty for the next test
+  while (fake_dma_active != NULL)
+    fake_dma_complete(false);
+  TEST_ASSERT_FALSE(spi_bus_busy(0));
+  TEST_ASSERT_FALSE(spi_bus_busy(1));
+}
+
+void test_spi_queue_runs_transactions_in_order(void) {
+  uint8_t tx[2][3] = {{1, 2, 3}, {4, 5, 6}};
+  uint8_t rx[2][3] = {{0}};
+  spi_transaction_t transactions[2] = {
+      {.config = &dma_bus, .tx = tx[0], .rx = rx[0], .len = 3,
+       .callback = record_callback},
+      {.config = &dma_bus, .tx = tx[1], .rx = rx[1], .len = 3,
+       .callback = record_callback},
+  };
+
+  TEST_ASSERT_TRUE(spi_bus_submit(&transactions[0]));
+  TEST_ASSERT_TRUE(spi_bus_submit(&transactions[1]));
+  // The second transaction waits for the first one
+  TEST_ASSERT_TRUE(spi_bus_busy(0));
+  TEST_ASSERT_EQUAL_PTR(&transactions[0], fake_dma_active);
+  TEST_ASSERT_EQUAL(SPI_TRANSACTION_ACTIVE, transactions[0].state);
+  TEST_ASSERT_EQUAL(SPI_TRANSACTION_QUEUED, transactions[1].state);
+  TEST_ASSERT_EQUAL_UINT32(0, callback_count);
+
+  fake_dma_complete(true);
+  TEST_ASSERT_EQUAL(SPI_TRANSACTION_DONE, transactions[0].state);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(tx[0], rx[0], 3);
+  TEST_ASSERT_EQUAL_PTR(&transactions[1], fake_dma_active);
+
+  fake_dma_complete(true);
+  TEST_ASSERT_EQUAL(SPI_TRANSACTION_DONE, transactions[1].state);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(tx[1], rx[1], 3);
+  TEST_ASSERT_FALSE(spi_bus_busy(0));
+
+  TEST_ASSERT_EQUAL_UINT32(2, callback_count);
+  TEST_ASSERT_EQUAL_PTR(&transactions[0], callback_order[0]);
+  TEST_ASSERT_EQUAL_PTR(&transactions[1], callback_order[1]);
+  TEST_ASSERT_TRUE(callback_success[0] && callback_success[1]);
+  // Only the first transfer was started outside the completion interrupt, and
+  // with it masked
+  TEST_ASSERT_EQUAL_UINT32(1, fake_masked_starts);
+}
+
+void test_spi_queue_asserts_chip_select_around_transfer(void) {
+  uint8_t data[2] = {0xAA, 0x55};
+  spi_transaction_t command = {.config = &dma_bus, .chip_select = &cs_a,
+                               .tx = data, .len = 1, .keep_selected = true};
+  spi_transaction_t payload = {.config = &dma_bus, .chip_select = &cs_a,
+                               .tx = &data[1], .len = 1};
+  spi_transaction_t other = {.config = &dma_bus, .chip_select = &cs_b,
+                             .tx = data, .len = 2, .keep_selected = true};
+  spi_transaction_t last = {.config = &dma_bus, .tx = data, .len = 2};
+
+  TEST_ASSERT_TRUE(spi_bus_submit(&command));
+  TEST_ASSERT_TRUE(spi_bus_submit(&payload));
+  TEST_ASSERT_TRUE(spi_bus_submit(&other));
+  TEST_ASSERT_TRUE(spi_bus_submit(&last));
+  for (uint32_t i = 0; i < 4; i++)
+    fake_dma_complete(true);
+
+  const fake_event_t expected[] = {
+      // The command keeps the chip select for the payload
+      {FAKE_SELECT, &cs_a},   {FAKE_START, &command},
+      {FAKE_SELECT, &cs_a},   {FAKE_START, &payload},
+      {FAKE_DESELECT, &cs_a},
+      // A transaction on another device releases the held chip select
+      {FAKE_SELECT, &cs_b},   {FAKE_START, &other},
+      {FAKE_DESELECT, &cs_b}, {FAKE_START, &last},
+  };
+  TEST_ASSERT_EQUAL_UINT32(M_ARRAY_SIZE(expected), fake_num_events);
+  for (uint32_t i = 0; i < M_ARRAY_SIZE(expected); i++) {
+    TEST_ASSERT_EQUAL_MESSAGE(expected[i].type, fake_events[i].type,
+                              "event type");
+    TEST_ASSERT_EQUAL_PTR(expected[i].target, fake_events[i].target);
+  }
+}
+
+void test_spi_queue_blocking_transfer_on_polled_bus(void) {
+  const uint8_t tx[4] = {9, 8, 7, 6};
+  uint8_t rx[4] = {0};
+
+  TEST_ASSERT_TRUE(spi_bus_transfer(&polled_bus, tx, rx, sizeof(tx)));
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(tx, rx, sizeof(tx));
+  TEST_ASSERT_TRUE(spi_bus_transfer(&polled_bus, tx, NULL, 0));
+
+  fake_polled_status = SPI_DRIVER_ERROR;
+  TEST_ASSERT_FALSE(spi_bus_transfer(&polled_bus, tx, rx, sizeof(tx)));
+  fake_polled_status = SPI_DRIVER_DONE;
+  fake_acquire_result = false;
+  TEST_ASSERT_FALSE(spi_bus_transfer(&polled_bus, tx, rx, sizeof(tx)));
+}
+
+// Stops the chain after a few samples
+static uint32_t chain_samples;
+
+static void chain_callback(spi_transaction_t *transaction, bool success) {
+  TEST_ASSERT_TRUE(success);
+  if (++chain_samples == 5)
+    transaction->chain = NULL;
+}
+
+void test_spi_queue_chain_samples_until_stopped(void) {
+  uint8_t rx[2];
+  spi_transaction_t sample = {.config = &dma_bus, .chip_select = &cs_a,
+                              .rx = rx, .len = sizeof(rx),
+                              .callback = chain_callback};
+  spi_transaction_t other = {.config = &dma_bus, .len = 1,
+                             .callback = record_callback};
+
+  sample.chain = &sample;
+  chain_samples = 0;
+  TEST_ASSERT_TRUE(spi_bus_submit(&sample));
+  // Another transaction queued meanwhile runs between two samples
+  TEST_ASSERT_TRUE(spi_bus_submit(&other));
+  fake_dma_complete(true);
+  TEST_ASSERT_EQUAL_PTR(&other, fake_dma_active);
+  fake_dma_complete(true);
+  TEST_ASSERT_EQUAL_UINT32(1, callback_count);
+
+  while (fake_dma_active != NULL)
+    fake_dma_complete(true);
+  TEST_ASSERT_EQUAL_UINT32(5, chain_samples);
+  TEST_ASSERT_EQUAL(SPI_TRANSACTION_DONE, sample.state);
+  TEST_ASSERT_EQUAL_HEX8(0xFF, rx[0]);
+
+  // The chain also runs back to back on a polled bus, in constant stack space
+  sample.config = &polled_bus;
+  sample.chain = &sample;
+  chain_samples = 0;
+  TEST_ASSERT_TRUE(spi_bus_submit(&sample));
+  TEST_ASSERT_EQUAL_UINT32(5, chain_samples);
+  TEST_ASSERT_FALSE(spi_bus_busy(1));
+}
+
+void test_spi_queue_failure_reports_and_breaks_chain(void) {
+  uint8_t tx = 0x42;
+  spi_transaction_t failing = {.config = &dma_bus, .chip_select = &cs_a,
+                               .tx = &tx, .len = 1, .keep_selected = true,
+                               .callback = record_callback};
+  spi_transaction_t next = {.config = &dma_bus, .tx = &tx, .len = 1,
+                            .callback = record_callback};
+
+  failing.chain = &failing;
+  TEST_ASSERT_TRUE(spi_bus_submit(&failing));
+  TEST_ASSERT_TRUE(spi_bus_submit(&next));
+  fake_dma_complete(false);
+
+  TEST_ASSERT_EQUAL(SPI_TRANSACTION_FAILED, failing.state);
+  TEST_ASSERT_FALSE(callback_success[0]);
+  // The chip select is released despite `keep_selected`, and the queue moves
+  // on without following the chain
+  TEST_ASSERT_EQUAL(FAKE_DESELECT, fake_events[2].type);
+  TEST_ASSERT_EQUAL_PTR(&next, fake_dma_active);
+  fake_dma_complete(true);
+  TEST_ASSERT_EQUAL_UINT32(2, callback_count);
+  TEST_ASSERT_TRUE(callback_success[1]);
+  TEST_ASSERT_FALSE(spi_bus_busy(0));
+}
+
+void test_spi_queue_rejects_invalid_transactions(void) {
+  static const spi_bus_config_t missing_bus = {.bus = SPI_NUM_BUSES};
+  uint8_t tx = 0;
+  spi_transaction_t transaction = {.config = &dma_bus, .tx = &tx, .len = 1};
+  spi_transaction_t empty = {.config = &dma_bus, .tx = &tx, .len = 0};
+  spi_transaction_t too_long = {.config = &dma_bus,
+                                .len = SPI_MAX_TRANSFER_SIZE + 1};
+  spi_transaction_t no_bus = {.config = &missing_bus, .len = 1};
+  spi_transaction_t no_config = {.len = 1};
+
+  TEST_ASSERT_FALSE(spi_bus_submit(NULL));
+  TEST_ASSERT_FALSE(spi_bus_submit(&empty));
+  TEST_ASSERT_FALSE(spi_bus_submit(&too_long));
+  TEST_ASSERT_FALSE(spi_bus_submit(&no_bus));
+  TEST_ASSERT_FALSE(spi_bus_submit(&no_config));
+  TEST_ASSERT_FALSE(spi_bus_busy(SPI_NUM_BUSES));
+
+  // A transaction cannot be queued twice
+  TEST_ASSERT_TRUE(spi_bus_submit(&transaction));
+  TEST_ASSERT_FALSE(spi_bus_submit(&transaction));
+  fake_dma_complete(true);
+  TEST_ASSERT_TRUE(spi_bus_submit(&transaction));
+  fake_dma_complete(true);
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_spi_queue_runs_transactions_in_order);
+  RUN_TEST(test_spi_queue_asserts_chip_select_around_transfer);
+  RUN_TEST(test_spi_queue_blocking_transfer_on_polled_bus);
+  RUN_TEST(test_spi_queue_chain_samples_until_stopped);
+  RUN_TEST(test_spi_queue_failure_reports_and_breaks_chain);
+  RUN_TEST(test_spi_queue_rejects_invalid_transactions);
+  return UNITY_END();
+}
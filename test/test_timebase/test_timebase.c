@@ -0,0 +1,67 @@
+#include <unity.h>
+
+#include "timebase.h"
+
+// Simulated 32-bit cycle counter
+static uint32_t sim_cycles;
+
+uint32_t board_cycle_count(void) { return sim_cycles; }
+
+void setUp(void) {
+  sim_cycles = 0;
+  timebase_init();
+}
+
+void tearDown(void) {}
+
+void test_timebase_converts_cycles_to_microseconds(void) {
+  sim_cycles = TIMEBASE_CYCLES_PER_US * 1500 + TIMEBASE_CYCLES_PER_US - 1;
+
+  TEST_ASSERT_EQUAL_UINT64(TIMEBASE_CYCLES_PER_US * 1500 +
+                               TIMEBASE_CYCLES_PER_US - 1,
+                           timebase_read_cycles());
+  TEST_ASSERT_EQUAL_UINT64(1500, timebase_read_us());
+}
+
+void test_timebase_extends_a_wrap_before_the_update(void) {
+  sim_cycles = UINT32_MAX - 99;
+  timebase_update();
+
+  // The counter wraps, and is read before the timer interrupt sees the wrap
+  sim_cycles = 100;
+  TEST_ASSERT_EQUAL_UINT64((1ull << 32) + 100, timebase_read_cycles());
+
+  // Reading again after the update gives the same time
+  timebase_update();
+  TEST_ASSERT_EQUAL_UINT64((1ull << 32) + 100, timebase_read_cycles());
+}
+
+void test_timebase_counts_wraps_across_updates(void) {
+  // About 1 ms per update at 216 MHz, across several wraps
+  const uint32_t step = TIMEBASE_CYCLES_PER_US * 1000u + 7u;
+  uint64_t expected = 0;
+  uint64_t last_us = 0;
+
+  for (uint32_t i = 0; i < 50000; i++) {
+    sim_cycles += step;
+    expected += step;
+    timebase_update();
+
+    const uint64_t us = timebase_read_us();
+    TEST_ASSERT_EQUAL_UINT64(expected, timebase_read_cycles());
+    TEST_ASSERT_TRUE(us >= last_us);
+    last_us = us;
+  }
+
+  TEST_ASSERT_TRUE(expected > 2ull << 32);
+  TEST_ASSERT_EQUAL_UINT64(expected / TIMEBASE_CYCLES_PER_US,
+                           timebase_read_us());
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_timebase_converts_cycles_to_microseconds);
+  RUN_TEST(test_timebase_extends_a_wrap_before_the_update);
+  RUN_TEST(test_timebase_counts_wraps_across_updates);
+  return UNITY_END();
+}
@@ -8,6 +8,8 @@ static uint32_t xinput_runtime_clear_count;
 static uint32_t usb_disconnect_count;
 static uint32_t usb_connect_count;
 static bool mock_usb_suspended;
+static uint32_t wear_leveling_flush_count;
+static uint32_t profile_save_count;
 
 uint32_t timer_read(void) { return mock_timer; }
 
@@ -27,6 +29,16 @@ bool tud_connect(void) {
 
 bool tud_suspended(void) { return mock_usb_suspended; }
 
+bool wear_leveling_flush(void) {
+  wear_leveling_flush_count++;
+  return true;
+}
+
+bool eeconfig_save_current_profile(void) {
+  profile_save_count++;
+  return true;
+}
+
 void setUp(void) {
   mock_timer = 0;
   hid_runtime_clear_count = 0;
@@ -34,6 +46,8 @@ void setUp(void) {
   usb_disconnect_count = 0;
   usb_connect_count = 0;
   mock_usb_suspended = false;
+  wear_leveling_flush_count = 0;
+  profile_save_count = 0;
   usb_runtime_init();
 }
 
@@ -142,6 +156,26 @@ void test_usb_runtime_task_recovers_during_long_suspend_without_resume_callback(
   TEST_ASSERT_EQUAL_UINT32(1, usb_connect_count);
 }
 
+void test_usb_runtime_suspend_flushes_wear_leveling_once(void) {
+  mock_usb_suspended = true;
+  usb_runtime_suspend();
+
+  TEST_ASSERT_EQUAL_UINT32(0, wear_leveling_flush_count);
+
+  usb_runtime_task();
+  usb_runtime_task();
+
+  TEST_ASSERT_EQUAL_UINT32(1, wear_leveling_flush_count);
+  // A pending profile switch is saved before the flush
+  TEST_ASSERT_EQUAL_UINT32(1, profile_save_count);
+
+  mock_usb_suspended = false;
+  usb_runtime_task();
+  usb_runtime_task();
+
+  TEST_ASSERT_EQUAL_UINT32(1, wear_leveling_flush_count);
+}
+
 int main(void) {
   UNITY_BEGIN();
   RUN_TEST(test_usb_runtime_mount_resyncs_state);
@@ -149,5 +183,6 @@ int main(void) {
   RUN_TEST(test_usb_runtime_long_suspend_reconnects_after_delay);
   RUN_TEST(test_usb_runtime_mount_clears_pending_reconnect);
   RUN_TEST(test_usb_runtime_task_recovers_during_long_suspend_without_resume_callback);
+  RUN_TEST(test_usb_runtime_suspend_flushes_wear_leveling_once);
   return UNITY_END();
 }
@@ -0,0 +1,837 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unity.h>
+
+#include "crc32.h"
+#include "hardware/native/flash_sim.h"
+#include "lib/crc32_word.h"
+#include "wear_leveling.h"
+
+// Built with `FLASH_SECTOR_SIZE=4096`. Each of the two banks spans the fewest
+// sectors that hold it, at the end of the flash.
+#define BANK_NUM_SECTORS                                                       \
+  ((WL_BACKING_STORE_SIZE + FLASH_SECTOR_SIZE - 1) / FLASH_SECTOR_SIZE)
+#define FIRST_BANK_SECTOR (FLASH_NUM_SECTORS - 2u * BANK_NUM_SECTORS)
+
+// Simulated flash timings in microseconds
+#define SIM_ERASE_SECTOR_US                                                    \
+  (FLASH_SIM_ERASE_US_PER_KB * FLASH_SECTOR_SIZE / 1024u)
+#define SIM_PROGRAM_WORD_US FLASH_SIM_PROGRAM_WORD_US
+// Simulated boot work in nanoseconds: copying a word out of the flash, and
+// checking a word with the CRC unit
+#define SIM_READ_WORD_NS 30u
+#define SIM_CRC_WORD_NS 60u
+
+// Longest a single call may stall the main loop: one sector erase, or one
+// step of programmed words plus a few log entries
+#define MAX_STEP_STALL_US (SIM_ERASE_SECTOR_US)
+
+static uint8_t expected_store[WL_VIRTUAL_SIZE];
+static uint8_t actual_store[WL_VIRTUAL_SIZE];
+static uint32_t sim_clock_ms;
+
+void board_error_handler(void) { TEST_FAIL_MESSAGE("board error handler"); }
+
+// The CRC unit of the MCUs, which cannot continue a previous computation
+static uint32_t sim_crc_words;
+
+uint32_t crc32_compute(const void *buf, uint32_t len, uint32_t crc) {
+  const uint8_t *buf8 = buf;
+
+  crc = crc32_word_step(0xFFFFFFFF, crc);
+  for (uint32_t i = 0; i < (len + 3) / 4; i++) {
+    uint32_t k = 0;
+    memcpy(&k, buf8 + i * 4, M_MIN(len - i * 4, 4u));
+    crc = crc32_word_step(crc, k);
+  }
+  sim_crc_words += (len + 3) / 4;
+
+  return crc;
+}
+
+uint32_t crc32_compute_zeros(uint32_t len, uint32_t crc) {
+  return crc32_word_compute_zeros(len, crc);
+}
+
+uint32_t crc32_update_range(uint32_t crc, uint32_t len, uint32_t offset,
+                            const void *old_data, const void *new_data,
+                            uint32_t range_len) {
+  sim_crc_words += (range_len + 3) / 4;
+  return crc32_word_update_range(crc, len, offset, old_data, new_data,
+                                 range_len);
+}
+
+uint32_t timer_read(void) { return sim_clock_ms; }
+
+static uint32_t sim_reload_count;
+
+// Run the wear leveling task as the main loop does, counting the times the
+// virtual storage has been loaded again
+static void run_task(void) {
+  if (wear_leveling_task())
+    sim_reload_count++;
+}
+
+// Let the writes go idle so the changes held in the cache are logged
+static void idle(void) {
+  sim_clock_ms += WL_WRITE_BACK_DELAY_MS;
+  run_task();
+}
+
+static uint32_t stall_of_write(uint32_t addr, const void *buf, uint32_t len) {
+  const uint64_t start = flash_sim_stats()->busy_us;
+
+  TEST_ASSERT_TRUE(wear_leveling_write(addr, buf, len));
+  return (uint32_t)(flash_sim_stats()->busy_us - start);
+}
+
+static uint32_t stall_of_logged_write(uint32_t addr, const void *buf,
+                                      uint32_t len) {
+  const uint64_t start = flash_sim_stats()->busy_us;
+
+  TEST_ASSERT_TRUE(wear_leveling_write(addr, buf, len));
+  idle();
+  return (uint32_t)(flash_sim_stats()->busy_us - start);
+}
+
+static uint32_t stall_of_task(void) {
+  const uint64_t start = flash_sim_stats()->busy_us;
+
+  run_task();
+  return (uint32_t)(flash_sim_stats()->busy_us - start);
+}
+
+// Run the main loop until the task neither checks nor programs anything
+static void settle(void) {
+  uint32_t crc_words;
+
+  do
+    crc_words = sim_crc_words;
+  while (stall_of_task() > 0 || sim_crc_words != crc_words);
+}
+
+// Write and log a changing value until the write log is full and a
+// consolidation has started, which is the first write that does not program
+// the log
+static uint32_t fill_write_log(uint32_t addr) {
+  uint32_t value = 0;
+
+  // Log the changes made so far and finish any verification
+  sim_clock_ms += WL_WRITE_BACK_DELAY_MS;
+  settle();
+
+  for (uint32_t i = 0; i < WL_WRITE_LOG_SIZE; i++) {
+    const uint32_t programmed = flash_sim_stats()->programmed_words;
+
+    value++;
+    TEST_ASSERT_TRUE(stall_of_logged_write(addr, &value, sizeof(value)) <=
+                     2u * SIM_PROGRAM_WORD_US);
+    if (flash_sim_stats()->programmed_words == programmed)
+      return value;
+  }
+
+  TEST_FAIL_MESSAGE("write log never filled");
+  return 0;
+}
+
+static void assert_value_at(uint32_t addr, uint32_t expected) {
+  uint32_t actual = 0;
+
+  TEST_ASSERT_TRUE(wear_leveling_read(addr, &actual, sizeof(actual)));
+  TEST_ASSERT_EQUAL_HEX32(expected, actual);
+}
+
+// Simulate a power cycle: nothing survives but the flash contents
+static void power_cycle(void) {
+  flash_sim_restore_power();
+  memset(wl_cache, 0, WL_VIRTUAL_SIZE);
+  wear_leveling_init();
+}
+
+// Simulate a reset, before which the firmware flushes the cache
+static void reboot(void) {
+  TEST_ASSERT_TRUE(wear_leveling_flush());
+  power_cycle();
+}
+
+void setUp(void) {
+  flash_sim_reset();
+  sim_clock_ms = 0;
+  sim_reload_count = 0;
+  sim_crc_words = 0;
+  wear_leveling_init();
+  // The first iterations of the main loop verify the new store
+  settle();
+}
+
+void tearDown(void) {
+  TEST_ASSERT_EQUAL_UINT32(0, flash_sim_stats()->program_violations);
+}
+
+void test_wear_leveling_write_survives_reboot(void) {
+  const uint32_t value = 0x12345678u;
+
+  TEST_ASSERT_TRUE(wear_leveling_write(100, &value, sizeof(value)));
+  reboot();
+
+  assert_value_at(100, value);
+}
+
+void test_wear_leveling_full_log_never_erases_inside_write(void) {
+  const uint32_t erases = flash_sim_stats()->erases;
+  const uint32_t last = fill_write_log(16);
+
+  // The consolidation has started but nothing has been erased yet
+  TEST_ASSERT_EQUAL_UINT32(erases, flash_sim_stats()->erases);
+  assert_value_at(16, last);
+
+  TEST_ASSERT_TRUE(wear_leveling_flush());
+  TEST_ASSERT_EQUAL_UINT32(erases + BANK_NUM_SECTORS,
+                           flash_sim_stats()->erases);
+  reboot();
+  assert_value_at(16, last);
+}
+
+void test_wear_leveling_consolidation_steps_are_bounded(void) {
+  uint32_t max_stall_us = 0;
+  uint32_t total_stall_us = 0;
+  uint32_t steps = 0;
+  uint32_t value = fill_write_log(64);
+
+  for (uint32_t i = 0; i < 1000u; i++) {
+    const uint32_t stall_us = stall_of_task();
+
+    if (stall_us == 0)
+      break;
+    steps++;
+    total_stall_us += stall_us;
+    if (stall_us > max_stall_us)
+      max_stall_us = stall_us;
+
+    // Keep the application writing while the consolidation runs
+    value++;
+    TEST_ASSERT_TRUE(stall_of_write(64, &value, sizeof(value)) <=
+                     2u * SIM_PROGRAM_WORD_US);
+  }
+
+  printf("consolidation: %u steps, max stall %u us, total %u us\n",
+         (unsigned)steps, (unsigned)max_stall_us, (unsigned)total_stall_us);
+  TEST_ASSERT_TRUE(steps > 3u);
+  TEST_ASSERT_TRUE(max_stall_us <= MAX_STEP_STALL_US);
+  // A blocking consolidation would have stalled for all of it at once
+  TEST_ASSERT_TRUE(total_stall_us > 3u * SIM_ERASE_SECTOR_US);
+
+  TEST_ASSERT_TRUE(wear_leveling_flush());
+  reboot();
+  assert_value_at(64, value);
+}
+
+void test_wear_leveling_writes_during_consolidation_survive(void) {
+  const uint32_t behind = 8, ahead = WL_VIRTUAL_SIZE - 8;
+  const uint32_t old_value = 0x11111111u, new_value = 0x22222222u;
+
+  TEST_ASSERT_TRUE(wear_leveling_write(behind, &old_value, sizeof(old_value)));
+  TEST_ASSERT_TRUE(wear_leveling_write(ahead, &old_value, sizeof(old_value)));
+  fill_write_log(512);
+
+  // Step until part of the cache has been programmed
+  for (uint32_t i = 0; i < 8u; i++)
+    run_task();
+
+  TEST_ASSERT_TRUE(wear_leveling_write(behind, &new_value, sizeof(new_value)));
+  TEST_ASSERT_TRUE(wear_leveling_write(ahead, &new_value, sizeof(new_value)));
+  assert_value_at(behind, new_value);
+
+  TEST_ASSERT_TRUE(wear_leveling_flush());
+  reboot();
+  assert_value_at(behind, new_value);
+  assert_value_at(ahead, new_value);
+}
+
+void test_wear_leveling_write_across_programming_cursor_commits(void) {
+  static uint8_t pattern[WL_VIRTUAL_SIZE];
+
+  for (uint32_t i = 0; i < sizeof(pattern); i++)
+    pattern[i] = (uint8_t)(i * 13u + 5u);
+  fill_write_log(512);
+
+  // Erase the idle bank and program part of it
+  for (uint32_t i = 0; i < BANK_NUM_SECTORS + 2u; i++)
+    run_task();
+
+  // The committed checksum must cover the old data behind the cursor and the
+  // new data ahead of it, or the bank is rejected after the power cycle
+  TEST_ASSERT_TRUE(wear_leveling_write(0, pattern, sizeof(pattern)));
+  TEST_ASSERT_TRUE(wear_leveling_flush());
+  power_cycle();
+
+  TEST_ASSERT_TRUE(wear_leveling_read(0, actual_store, sizeof(actual_store)));
+  TEST_ASSERT_EQUAL_MEMORY(pattern, actual_store, sizeof(pattern));
+}
+
+void test_wear_leveling_erase_runs_in_background(void) {
+  const uint32_t value = 0xCAFEF00Du;
+
+  TEST_ASSERT_TRUE(wear_leveling_write(200, &value, sizeof(value)));
+
+  const uint64_t start = flash_sim_stats()->busy_us;
+  TEST_ASSERT_TRUE(wear_leveling_erase());
+  TEST_ASSERT_TRUE(flash_sim_stats()->busy_us == start);
+  assert_value_at(200, FLASH_EMPTY_VAL);
+
+  // Defaults written right after the erase are held until it is done
+  const uint32_t defaults = 0x00C0FFEEu;
+  TEST_ASSERT_TRUE(wear_leveling_write(300, &defaults, sizeof(defaults)));
+
+  while (stall_of_task() > 0)
+    ;
+  reboot();
+  assert_value_at(200, FLASH_EMPTY_VAL);
+  assert_value_at(300, defaults);
+}
+
+void test_wear_leveling_consolidations_alternate_banks(void) {
+  flash_sim_clear_stats();
+
+  for (uint32_t i = 0; i < 4u; i++) {
+    fill_write_log(32);
+    TEST_ASSERT_TRUE(wear_leveling_flush());
+  }
+
+  // Each consolidation erases only the idle bank, so each sector is erased
+  // every other consolidation
+  for (uint32_t i = 0; i < FLASH_NUM_SECTORS; i++)
+    TEST_ASSERT_EQUAL_UINT32(i >= FIRST_BANK_SECTOR ? 2u : 0u,
+                             flash_sim_stats()->sector_erases[i]);
+}
+
+void test_wear_leveling_legacy_store_is_moved_into_a_bank(void) {
+  // A single-bank store at the end of the flash: the data, its checksum and a
+  // write log entry
+  uint8_t *legacy =
+      flash_sim_memory() + FLASH_SIZE - BANK_NUM_SECTORS * FLASH_SECTOR_SIZE;
+  const uint32_t value = 0x01234567u;
+  wl_legacy_log_entry_t entry = {0};
+
+  flash_sim_reset();
+  memcpy(legacy + 40, &value, sizeof(value));
+  const uint32_t checksum = crc32_compute(legacy, WL_VIRTUAL_SIZE, 0);
+  memcpy(legacy + WL_VIRTUAL_SIZE, &checksum, sizeof(checksum));
+  entry.fields.addr = 80;
+  entry.fields.len = 2;
+  entry.fields.data[0] = 0xAB;
+  entry.fields.data[1] = 0xCD;
+  memcpy(legacy + WL_VIRTUAL_SIZE + 4, entry.raw, 4);
+
+  reboot();
+  assert_value_at(40, value);
+  assert_value_at(80, 0xFFFFCDABu);
+
+  fill_write_log(32);
+  TEST_ASSERT_TRUE(wear_leveling_flush());
+  reboot();
+  assert_value_at(40, value);
+  assert_value_at(80, 0xFFFFCDABu);
+}
+
+void test_wear_leveling_legacy_log_format_is_migrated(void) {
+  // A committed bank whose write log has no format word and holds
+  // `wl_legacy_log_entry_t` entries
+  uint8_t *bank = flash_sim_memory() + FIRST_BANK_SECTOR * FLASH_SECTOR_SIZE;
+  const uint32_t value = 0x89ABCDEFu, sequence = 7;
+  wl_legacy_log_entry_t entry = {0};
+
+  flash_sim_reset();
+  memcpy(bank + 40, &value, sizeof(value));
+  const uint32_t checksum = crc32_compute(bank, WL_VIRTUAL_SIZE, 0) ^ sequence;
+  memcpy(bank + WL_HEADER_SEQUENCE, &sequence, sizeof(sequence));
+  memcpy(bank + WL_HEADER_CHECKSUM, &checksum, sizeof(checksum));
+  entry.fields.addr = 80;
+  entry.fields.len = 5;
+  memcpy(entry.fields.data, "\x01\x02\x03\x04\x05", 5);
+  memcpy(bank + WL_HEADER_FORMAT, entry.raw, sizeof(entry.raw));
+
+  reboot();
+  assert_value_at(40, value);
+  assert_value_at(80, 0x04030201u);
+  assert_value_at(84, 0xFFFFFF05u);
+
+  // The store has been moved into the other bank in the current format
+  uint32_t format;
+  memcpy(&format,
+         bank + BANK_NUM_SECTORS * FLASH_SECTOR_SIZE + WL_HEADER_FORMAT,
+         sizeof(format));
+  TEST_ASSERT_EQUAL_HEX32(WL_LOG_FORMAT, format);
+
+  fill_write_log(32);
+  TEST_ASSERT_TRUE(wear_leveling_flush());
+  reboot();
+  assert_value_at(40, value);
+  assert_value_at(80, 0x04030201u);
+}
+
+void test_wear_leveling_bulk_write_takes_few_log_words(void) {
+  uint8_t buf[WL_MAX_BYTES_PER_ENTRY], actual[WL_MAX_BYTES_PER_ENTRY];
+  const uint32_t addr = WL_VIRTUAL_SIZE - sizeof(buf);
+
+  for (uint32_t i = 0; i < sizeof(buf); i++)
+    buf[i] = (uint8_t)(i * 7u + 1u);
+
+  const uint32_t programmed = flash_sim_stats()->programmed_words;
+  TEST_ASSERT_TRUE(wear_leveling_write(addr, buf, sizeof(buf)));
+  idle();
+  // One word for the header and the first byte, and 16 for the rest, where
+  // the 6-byte entries of the legacy format took 22 words
+  TEST_ASSERT_EQUAL_UINT32(17u,
+                           flash_sim_stats()->programmed_words - programmed);
+
+  reboot();
+  TEST_ASSERT_TRUE(wear_leveling_read(addr, actual, sizeof(actual)));
+  TEST_ASSERT_EQUAL_MEMORY(buf, actual, sizeof(buf));
+}
+
+void test_wear_leveling_writes_are_held_until_idle(void) {
+  const uint32_t value = 0xCAFEF00Du;
+  const uint32_t programmed = flash_sim_stats()->programmed_words;
+
+  TEST_ASSERT_TRUE(wear_leveling_write(40, &value, sizeof(value)));
+  sim_clock_ms += WL_WRITE_BACK_DELAY_MS - 1;
+  run_task();
+  TEST_ASSERT_EQUAL_UINT32(programmed, flash_sim_stats()->programmed_words);
+  assert_value_at(40, value);
+
+  sim_clock_ms++;
+  run_task();
+  TEST_ASSERT_EQUAL_UINT32(WL_LOG_ENTRY_NUM_WORDS(sizeof(value)),
+                           flash_sim_stats()->programmed_words - programmed);
+
+  power_cycle();
+  assert_value_at(40, value);
+}
+
+void test_wear_leveling_overlapping_writes_are_logged_once(void) {
+  const uint8_t a[] = {1, 2, 3, 4}, b[] = {5, 6, 7, 8}, c[] = {9, 10};
+  const uint8_t expected[] = {1, 2, 5, 6, 7, 8, 9, 10};
+  uint8_t actual[sizeof(expected)];
+  const uint32_t programmed = flash_sim_stats()->programmed_words;
+
+  // Overlapping, then touching ranges merge into one entry of 8 bytes
+  TEST_ASSERT_TRUE(wear_leveling_write(100, a, sizeof(a)));
+  TEST_ASSERT_TRUE(wear_leveling_write(102, b, sizeof(b)));
+  TEST_ASSERT_TRUE(wear_leveling_write(106, c, sizeof(c)));
+  idle();
+  TEST_ASSERT_EQUAL_UINT32(WL_LOG_ENTRY_NUM_WORDS(sizeof(expected)),
+                           flash_sim_stats()->programmed_words - programmed);
+
+  power_cycle();
+  TEST_ASSERT_TRUE(wear_leveling_read(100, actual, sizeof(actual)));
+  TEST_ASSERT_EQUAL_MEMORY(expected, actual, sizeof(expected));
+}
+
+void test_wear_leveling_full_range_list_is_logged_early(void) {
+  const uint32_t programmed = flash_sim_stats()->programmed_words;
+
+  for (uint32_t i = 0; i < WL_WRITE_BACK_MAX_RANGES; i++) {
+    const uint8_t value = (uint8_t)(i + 1);
+    TEST_ASSERT_TRUE(wear_leveling_write(i * 8u, &value, 1));
+  }
+  TEST_ASSERT_EQUAL_UINT32(programmed, flash_sim_stats()->programmed_words);
+
+  // One more disjoint range logs the ones held so far without waiting
+  const uint8_t value = 0xAA;
+  TEST_ASSERT_TRUE(
+      wear_leveling_write(WL_WRITE_BACK_MAX_RANGES * 8u, &value, 1));
+  TEST_ASSERT_EQUAL_UINT32(WL_WRITE_BACK_MAX_RANGES * WL_LOG_ENTRY_NUM_WORDS(1),
+                           flash_sim_stats()->programmed_words - programmed);
+
+  reboot();
+  for (uint32_t i = 0; i <= WL_WRITE_BACK_MAX_RANGES; i++) {
+    uint8_t actual = 0;
+    TEST_ASSERT_TRUE(wear_leveling_read(i * 8u, &actual, 1));
+    TEST_ASSERT_EQUAL_UINT8(i < WL_WRITE_BACK_MAX_RANGES ? i + 1 : 0xAA,
+                            actual);
+  }
+}
+
+void test_wear_leveling_failed_write_back_is_consolidated(void) {
+  for (uint32_t i = 0; i < WL_WRITE_BACK_MAX_RANGES; i++) {
+    const uint8_t value = (uint8_t)(i + 1);
+    TEST_ASSERT_TRUE(wear_leveling_write(i * 8u, &value, 1));
+  }
+
+  // The write log cannot be programmed, so logging the held ranges fails and
+  // a consolidation persists them along with the new range
+  for (uint32_t i = 0; i < 2u * BANK_NUM_SECTORS; i++)
+    flash_sim_set_sector_failed(FIRST_BANK_SECTOR + i, true);
+  const uint8_t value = 0xAA;
+  TEST_ASSERT_TRUE(
+      wear_leveling_write(WL_WRITE_BACK_MAX_RANGES * 8u, &value, 1));
+
+  for (uint32_t i = 0; i < 2u * BANK_NUM_SECTORS; i++)
+    flash_sim_set_sector_failed(FIRST_BANK_SECTOR + i, false);
+  while (stall_of_task() > 0)
+    ;
+
+  power_cycle();
+  for (uint32_t i = 0; i <= WL_WRITE_BACK_MAX_RANGES; i++) {
+    uint8_t actual = 0;
+    TEST_ASSERT_TRUE(wear_leveling_read(i * 8u, &actual, 1));
+    TEST_ASSERT_EQUAL_UINT8(i < WL_WRITE_BACK_MAX_RANGES ? i + 1 : 0xAA,
+                            actual);
+  }
+}
+
+#define SESSION_NUM_CHANGES 100u
+#define SESSION_CHANGE_INTERVAL_MS 50u
+#define SESSION_BRIGHTNESS_ADDR 300u
+
+// Drag a brightness slider through `SESSION_NUM_CHANGES` values, with the main
+// loop running in between. Each change is flushed right away if `flush`.
+static void brightness_session(bool flush) {
+  for (uint32_t i = 0; i < SESSION_NUM_CHANGES; i++) {
+    const uint8_t brightness = (uint8_t)(i * 2u + 1u);
+
+    TEST_ASSERT_TRUE(
+        wear_leveling_write(SESSION_BRIGHTNESS_ADDR, &brightness, 1));
+    if (flush)
+      TEST_ASSERT_TRUE(wear_leveling_flush());
+    sim_clock_ms += SESSION_CHANGE_INTERVAL_MS;
+    run_task();
+  }
+  idle();
+}
+
+void test_wear_leveling_write_back_coalesces_a_session(void) {
+  const flash_sim_stats_t *stats = flash_sim_stats();
+  uint32_t programmed = stats->programmed_words, erased = stats->erases;
+  brightness_session(true);
+  const uint32_t through_words = stats->programmed_words - programmed;
+  const uint32_t through_erases = stats->erases - erased;
+
+  setUp();
+  programmed = stats->programmed_words, erased = stats->erases;
+  brightness_session(false);
+  const uint32_t back_words = stats->programmed_words - programmed;
+  const uint32_t back_erases = stats->erases - erased;
+
+  printf("%u brightness changes: write-through %u log words, %u erases; "
+         "write-back %u log words, %u erases\n",
+         (unsigned)SESSION_NUM_CHANGES, (unsigned)through_words,
+         (unsigned)through_erases, (unsigned)back_words,
+         (unsigned)back_erases);
+  TEST_ASSERT_EQUAL_UINT32(WL_LOG_ENTRY_NUM_WORDS(1), back_words);
+  TEST_ASSERT_EQUAL_UINT32(0, back_erases);
+  TEST_ASSERT_TRUE(back_words * 10u <= through_words);
+
+  power_cycle();
+  uint8_t actual = 0;
+  TEST_ASSERT_TRUE(wear_leveling_read(SESSION_BRIGHTNESS_ADDR, &actual, 1));
+  TEST_ASSERT_EQUAL_UINT8((SESSION_NUM_CHANGES - 1u) * 2u + 1u, actual);
+}
+
+// Consolidated data of the bank that is committed and not retired
+static uint8_t *active_bank_data(void) {
+  for (uint32_t i = 0; i < WL_NUM_BANKS; i++) {
+    uint8_t *bank =
+        flash_sim_memory() + (FIRST_BANK_SECTOR + i * BANK_NUM_SECTORS) *
+                        FLASH_SECTOR_SIZE;
+    uint32_t header[3];
+
+    memcpy(header, bank + WL_HEADER_SEQUENCE, sizeof(header));
+    if (header[0] != FLASH_EMPTY_VAL && header[2] == FLASH_EMPTY_VAL)
+      return bank;
+  }
+
+  TEST_FAIL_MESSAGE("no active bank");
+  return NULL;
+}
+
+void test_wear_leveling_bank_is_verified_once_per_commit(void) {
+  const uint32_t value = 0x600DF00Du;
+
+  // The store was verified once formatted, so booting checks nothing
+  sim_crc_words = 0;
+  power_cycle();
+  run_task();
+  TEST_ASSERT_EQUAL_UINT32(0, sim_crc_words);
+
+  // A power cut right after a commit leaves the new bank without checkpoint
+  TEST_ASSERT_TRUE(wear_leveling_write(40, &value, sizeof(value)));
+  fill_write_log(64);
+  TEST_ASSERT_TRUE(wear_leveling_flush());
+  sim_crc_words = 0;
+  power_cycle();
+  TEST_ASSERT_EQUAL_UINT32(0, sim_crc_words);
+  assert_value_at(40, value);
+
+  // It is verified by the main loop instead, once, a part per iteration
+  run_task();
+  TEST_ASSERT_GREATER_THAN_UINT32(0, sim_crc_words);
+  TEST_ASSERT_LESS_THAN_UINT32(WL_VIRTUAL_SIZE / 4, sim_crc_words);
+  assert_value_at(40, value);
+  settle();
+  TEST_ASSERT_EQUAL_UINT32(WL_VIRTUAL_SIZE / 4, sim_crc_words);
+  power_cycle();
+  settle();
+  TEST_ASSERT_EQUAL_UINT32(WL_VIRTUAL_SIZE / 4, sim_crc_words);
+  TEST_ASSERT_EQUAL_UINT32(0, sim_reload_count);
+}
+
+void test_wear_leveling_corrupted_bank_is_retired(void) {
+  const uint32_t value = 0x600DF00Du;
+
+  TEST_ASSERT_TRUE(wear_leveling_write(40, &value, sizeof(value)));
+  const uint32_t last = fill_write_log(64);
+  TEST_ASSERT_TRUE(wear_leveling_flush());
+
+  // The new bank gets corrupted before it has been verified
+  active_bank_data()[100] &= 0x0F;
+  power_cycle();
+  assert_value_at(64, last);
+  settle();
+  TEST_ASSERT_EQUAL_UINT32(1, sim_reload_count);
+
+  // The previous bank and its write log, retired by the commit but intact,
+  // are loaded in place without the value only held in the cache back then
+  assert_value_at(40, value);
+  assert_value_at(64, last - 1u);
+  power_cycle();
+  settle();
+  TEST_ASSERT_EQUAL_UINT32(1, sim_reload_count);
+  assert_value_at(40, value);
+  assert_value_at(64, last - 1u);
+
+  // The store keeps working from there
+  TEST_ASSERT_TRUE(wear_leveling_write(64, &value, sizeof(value)));
+  reboot();
+  settle();
+  TEST_ASSERT_EQUAL_UINT32(1, sim_reload_count);
+  assert_value_at(64, value);
+}
+
+void test_wear_leveling_corrupted_commit_is_programmed_again(void) {
+  const uint32_t value = 0x600DF00Du;
+
+  TEST_ASSERT_TRUE(wear_leveling_write(40, &value, sizeof(value)));
+  fill_write_log(64);
+  TEST_ASSERT_TRUE(wear_leveling_flush());
+
+  // The programmed data does not match the cache it was programmed from
+  active_bank_data()[100] &= 0x0F;
+  settle();
+
+  power_cycle();
+  settle();
+  TEST_ASSERT_EQUAL_UINT32(0, sim_reload_count);
+  assert_value_at(40, value);
+}
+
+#define BOOT_FILL_STEPS 4u
+
+static uint64_t host_time_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+void test_wear_leveling_boot_time_against_log_fill(void) {
+  // Each logged 4-byte write takes 2 words
+  const uint32_t max_entries = (WL_WRITE_LOG_SIZE - 16u) / 8u - 2u;
+  uint32_t logged = 0, boot_ns[BOOT_FILL_STEPS + 1];
+
+  TEST_ASSERT_TRUE(wear_leveling_write(64, &logged, sizeof(logged)));
+  idle();
+
+  for (uint32_t step = 0; step <= BOOT_FILL_STEPS; step++) {
+    const uint32_t entries = max_entries * step / BOOT_FILL_STEPS;
+    for (uint32_t value = 0; logged < entries; logged++) {
+      value = logged + 1u;
+      TEST_ASSERT_TRUE(wear_leveling_write(64, &value, sizeof(value)));
+      idle();
+    }
+
+    const uint32_t read_words = flash_sim_stats()->read_words;
+    sim_crc_words = 0;
+    const uint64_t start = host_time_ns();
+    power_cycle();
+    const uint64_t host_ns = host_time_ns() - start;
+
+    boot_ns[step] =
+        (flash_sim_stats()->read_words - read_words) * SIM_READ_WORD_NS +
+        sim_crc_words * SIM_CRC_WORD_NS;
+    printf("boot with the write log %3u%% full: %u ns simulated, %llu ns on "
+           "the host\n",
+           (unsigned)(step * 100u / BOOT_FILL_STEPS), (unsigned)boot_ns[step],
+           (unsigned long long)host_ns);
+
+    // Nothing is checked before the main loop runs, and the log is mapped
+    TEST_ASSERT_EQUAL_UINT32(0, sim_crc_words);
+    TEST_ASSERT_EQUAL_UINT32(boot_ns[0], boot_ns[step]);
+    assert_value_at(64, logged);
+  }
+
+  // Copying the consolidated data is all that is left
+  TEST_ASSERT_TRUE(boot_ns[0] <
+                   (WL_VIRTUAL_SIZE / 4u + 16u) * SIM_READ_WORD_NS);
+}
+
+static uint32_t xorshift_state;
+
+static uint32_t xorshift(void) {
+  xorshift_state ^= xorshift_state << 13;
+  xorshift_state ^= xorshift_state >> 17;
+  xorshift_state ^= xorshift_state << 5;
+  return xorshift_state;
+}
+
+
+static void assert_store_equals_expected(void) {
+  TEST_ASSERT_TRUE(wear_leveling_read(0, actual_store, WL_VIRTUAL_SIZE));
+  TEST_ASSERT_EQUAL_MEMORY(expected_store, actual_store, WL_VIRTUAL_SIZE);
+}
+
+void test_wear_leveling_random_writes_survive_replay_and_consolidation(void) {
+  const uint32_t consolidations =
+      flash_sim_stats()->erases / BANK_NUM_SECTORS;
+
+  xorshift_state = 0x12345678u;
+  memset(expected_store, 0xFF, sizeof(expected_store));
+  for (uint32_t i = 0; i < 2000u; i++) {
+    uint8_t buf[100];
+    const uint32_t len = 1u + xorshift() % sizeof(buf);
+    const uint32_t addr = xorshift() % (WL_VIRTUAL_SIZE - len + 1u);
+
+    for (uint32_t j = 0; j < len; j++)
+      buf[j] = (uint8_t)xorshift();
+    memcpy(expected_store + addr, buf, len);
+    TEST_ASSERT_TRUE(wear_leveling_write(addr, buf, len));
+    run_task();
+
+    if (i % 500u == 499u) {
+      TEST_ASSERT_TRUE(wear_leveling_flush());
+      reboot();
+      assert_store_equals_expected();
+    }
+  }
+
+  // The write log has been consolidated several times
+  TEST_ASSERT_TRUE(flash_sim_stats()->erases / BANK_NUM_SECTORS >
+                   consolidations + 2u);
+  TEST_ASSERT_TRUE(wear_leveling_flush());
+  reboot();
+  assert_store_equals_expected();
+}
+
+// Values written before the consolidation, which must survive any power cut
+static const uint32_t config_addrs[] = {0, 1000, 4096, WL_VIRTUAL_SIZE - 4};
+#define CONFIG_HOT_ADDR 2048u
+
+static uint32_t config_value(uint32_t round, uint32_t i) {
+  return 0xA5000000u | (round << 8) | i;
+}
+
+// Build a store that went through `rounds` consolidations, then fill the write
+// log so the next one has started. Returns the last value written to the hot
+// address, which is only held in the cache.
+static uint32_t prepare_consolidation(uint32_t rounds) {
+  setUp();
+  for (uint32_t round = 0; round < rounds; round++) {
+    for (uint32_t i = 0; i < M_ARRAY_SIZE(config_addrs); i++) {
+      const uint32_t value = config_value(round, i);
+      TEST_ASSERT_TRUE(
+          wear_leveling_write(config_addrs[i], &value, sizeof(value)));
+    }
+    if (round + 1 < rounds) {
+      fill_write_log(CONFIG_HOT_ADDR);
+      TEST_ASSERT_TRUE(wear_leveling_flush());
+    }
+  }
+
+  return fill_write_log(CONFIG_HOT_ADDR);
+}
+
+// Stores larger than 8 KB are cut at every operation around the erases and
+// the commit, and at a stride in between to bound the quadratic run time
+#define POWER_LOSS_STRIDE                                                      \
+  M_MAX(1u, (WL_VIRTUAL_SIZE / 8192u) * (WL_VIRTUAL_SIZE / 8192u))
+#define POWER_LOSS_EDGE 64u
+
+static void power_loss_at_every_operation(uint32_t rounds) {
+  prepare_consolidation(rounds);
+  const uint32_t start = flash_sim_stats()->operations;
+  TEST_ASSERT_TRUE(wear_leveling_flush());
+  const uint32_t num_operations = flash_sim_stats()->operations - start;
+
+  for (uint32_t cut = 0; cut < num_operations; cut++) {
+    if (cut > POWER_LOSS_EDGE && cut + POWER_LOSS_EDGE < num_operations &&
+        cut % POWER_LOSS_STRIDE != 0)
+      continue;
+
+    const uint32_t last = prepare_consolidation(rounds);
+
+    flash_sim_cut_power_after(cut);
+    wear_leveling_flush();
+    TEST_ASSERT_TRUE(flash_sim_power_lost());
+    power_cycle();
+    // The bank chosen at boot is intact
+    settle();
+    TEST_ASSERT_EQUAL_UINT32(0, sim_reload_count);
+
+    for (uint32_t i = 0; i < M_ARRAY_SIZE(config_addrs); i++)
+      assert_value_at(config_addrs[i], config_value(rounds - 1, i));
+
+    // Either the last logged value or the one held in the cache
+    uint32_t hot = 0;
+    TEST_ASSERT_TRUE(wear_leveling_read(CONFIG_HOT_ADDR, &hot, sizeof(hot)));
+    TEST_ASSERT_TRUE(hot == last - 1u || hot == last);
+
+    // The store keeps working after the power cut
+    const uint32_t value = 0x5A5A5A5Au;
+    TEST_ASSERT_TRUE(
+        wear_leveling_write(CONFIG_HOT_ADDR, &value, sizeof(value)));
+    TEST_ASSERT_TRUE(wear_leveling_flush());
+    reboot();
+    assert_value_at(CONFIG_HOT_ADDR, value);
+    assert_value_at(config_addrs[0], config_value(rounds - 1, 0));
+  }
+
+  printf("power loss: %u cut points after %u consolidations\n",
+         (unsigned)num_operations, (unsigned)rounds);
+}
+
+void test_wear_leveling_power_loss_during_first_consolidation(void) {
+  power_loss_at_every_operation(1);
+}
+
+void test_wear_leveling_power_loss_during_later_consolidation(void) {
+  // The bank being overwritten has been committed and retired before
+  power_loss_at_every_operation(2);
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_wear_leveling_write_survives_reboot);
+  RUN_TEST(test_wear_leveling_full_log_never_erases_inside_write);
+  RUN_TEST(test_wear_leveling_consolidation_steps_are_bounded);
+  RUN_TEST(test_wear_leveling_writes_during_consolidation_survive);
+  RUN_TEST(test_wear_leveling_write_across_programming_cursor_commits);
+  RUN_TEST(test_wear_leveling_erase_runs_in_background);
+  RUN_TEST(test_wear_leveling_consolidations_alternate_banks);
+  RUN_TEST(test_wear_leveling_legacy_store_is_moved_into_a_bank);
+  RUN_TEST(test_wear_leveling_legacy_log_format_is_migrated);
+  RUN_TEST(test_wear_leveling_bulk_write_takes_few_log_words);
+  RUN_TEST(test_wear_leveling_writes_are_held_until_idle);
+  RUN_TEST(test_wear_leveling_overlapping_writes_are_logged_once);
+  RUN_TEST(test_wear_leveling_full_range_list_is_logged_early);
+  RUN_TEST(test_wear_leveling_failed_write_back_is_consolidated);
+  RUN_TEST(test_wear_leveling_write_back_coalesces_a_session);
+  RUN_TEST(test_wear_leveling_bank_is_verified_once_per_commit);
+  RUN_TEST(test_wear_leveling_corrupted_bank_is_retired);
+  RUN_TEST(test_wear_leveling_corrupted_commit_is_programmed_again);
+  RUN_TEST(test_wear_leveling_boot_time_against_log_fill);
+  RUN_TEST(test_wear_leveling_random_writes_survive_replay_and_consolidation);
+  RUN_TEST(test_wear_leveling_power_loss_during_first_consolidation);
+  RUN_TEST(test_wear_leveling_power_loss_during_later_consolidation);
+  return UNITY_END();
+}
@@ -0,0 +1,321 @@
+#include <stdio.h>
+#include <string.h>
+#include <unity.h>
+
+#include "eeconfig.h"
+#include "hardware/native/flash_sim.h"
+#include "wear_leveling.h"
+
+// Built with `WL_XIP_ENABLED`: only the first `WL_CACHE_SIZE` bytes of the
+// virtual storage are kept in RAM, the rest is read in place from the flash
+// with the pages written since the last consolidation held in the overlay.
+// Every read must return the last write, whatever the consolidation is doing.
+
+// Built with `FLASH_SECTOR_SIZE=4096`. Each of the two banks spans the fewest
+// sectors that hold it, at the end of the flash.
+#define BANK_NUM_SECTORS                                                       \
+  ((WL_BACKING_STORE_SIZE + FLASH_SECTOR_SIZE - 1) / FLASH_SECTOR_SIZE)
+#define FIRST_BANK_SECTOR (FLASH_NUM_SECTORS - 2u * BANK_NUM_SECTORS)
+
+// Pages past the cache, which go through the overlay
+#define NUM_OVERLAY_ADDRESSABLE_PAGES                                          \
+  ((WL_VIRTUAL_SIZE - WL_CACHE_SIZE) / WL_OVERLAY_PAGE_SIZE)
+
+_Static_assert(WL_CACHE_SIZE < WL_VIRTUAL_SIZE,
+               "The test needs a virtual storage larger than the cache.");
+
+static uint8_t expected_store[WL_VIRTUAL_SIZE];
+static uint8_t actual_store[WL_VIRTUAL_SIZE];
+static uint32_t sim_clock_ms;
+static uint32_t sim_reload_count;
+
+void board_error_handler(void) { TEST_FAIL_MESSAGE("board error handler"); }
+
+uint32_t timer_read(void) { return sim_clock_ms; }
+
+// Run the wear leveling task as the main loop does, counting the times the
+// virtual storage has been loaded again
+static void run_task(void) {
+  if (wear_leveling_task())
+    sim_reload_count++;
+}
+
+bool migration_try_migrate(void) { return false; }
+
+static uint32_t xorshift_state;
+
+static uint32_t xorshift(void) {
+  xorshift_state ^= xorshift_state << 13;
+  xorshift_state ^= xorshift_state >> 17;
+  xorshift_state ^= xorshift_state << 5;
+  return xorshift_state;
+}
+
+// Simulate a power cycle: nothing survives but the flash contents
+static void power_cycle(void) {
+  flash_sim_restore_power();
+  memset(wl_cache, 0, WL_CACHE_SIZE);
+  wear_leveling_init();
+}
+
+// Simulate a reset, before which the firmware flushes the cache
+static void reboot(void) {
+  TEST_ASSERT_TRUE(wear_leveling_flush());
+  power_cycle();
+}
+
+static void write_expected(uint32_t addr, const void *buf, uint32_t len) {
+  memcpy(expected_store + addr, buf, len);
+  TEST_ASSERT_TRUE(wear_leveling_write(addr, buf, len));
+}
+
+// Write random bytes at a random address, which may span several pages
+static void write_random(uint32_t max_len) {
+  uint8_t buf[WL_OVERLAY_PAGE_SIZE * 3];
+  const uint32_t len = 1u + xorshift() % M_MIN(max_len, sizeof(buf));
+  const uint32_t addr = xorshift() % (WL_VIRTUAL_SIZE - len + 1u);
+
+  for (uint32_t i = 0; i < len; i++)
+    buf[i] = (uint8_t)xorshift();
+  write_expected(addr, buf, len);
+}
+
+// Read back the bytes around a random address
+static void assert_random_read(void) {
+  uint8_t buf[WL_OVERLAY_PAGE_SIZE * 2];
+  const uint32_t len = 1u + xorshift() % sizeof(buf);
+  const uint32_t addr = xorshift() % (WL_VIRTUAL_SIZE - len + 1u);
+
+  TEST_ASSERT_TRUE(wear_leveling_read(addr, buf, len));
+  TEST_ASSERT_EQUAL_MEMORY(expected_store + addr, buf, len);
+}
+
+static void assert_store_equals_expected(void) {
+  TEST_ASSERT_TRUE(wear_leveling_read(0, actual_store, WL_VIRTUAL_SIZE));
+  TEST_ASSERT_EQUAL_MEMORY(expected_store, actual_store, WL_VIRTUAL_SIZE);
+  // The cache is the start of the virtual storage
+  TEST_ASSERT_EQUAL_MEMORY(expected_store, wl_cache, WL_CACHE_SIZE);
+}
+
+static uint32_t consolidations(void) {
+  return flash_sim_stats()->erases / BANK_NUM_SECTORS;
+}
+
+void setUp(void) {
+  flash_sim_reset();
+  sim_clock_ms = 0;
+  sim_reload_count = 0;
+  xorshift_state = 0x2545F491u;
+  wear_leveling_init();
+  run_task();
+  memset(expected_store, 0xFF, sizeof(expected_store));
+}
+
+void tearDown(void) {
+  TEST_ASSERT_EQUAL_UINT32(0, flash_sim_stats()->program_violations);
+  TEST_ASSERT_EQUAL_UINT32(0, sim_reload_count);
+}
+
+void test_wear_leveling_xip_reads_return_the_last_write(void) {
+  const uint32_t start = consolidations();
+
+  for (uint32_t i = 0; i < 3000u; i++) {
+    write_random(WL_OVERLAY_PAGE_SIZE * 3);
+    assert_random_read();
+
+    // The main loop runs a few iterations between writes
+    const uint32_t iterations = xorshift() % 4u;
+    for (uint32_t j = 0; j < iterations; j++) {
+      sim_clock_ms++;
+      run_task();
+      assert_random_read();
+    }
+    if (i % 100u == 99u)
+      assert_store_equals_expected();
+    if (i % 1000u == 999u) {
+      reboot();
+      assert_store_equals_expected();
+    }
+  }
+
+  // The overlay has been consolidated many times to free its pages
+  TEST_ASSERT_GREATER_THAN_UINT32(start + 10u, consolidations());
+  reboot();
+  assert_store_equals_expected();
+}
+
+void test_wear_leveling_xip_writes_during_consolidation_read_back(void) {
+  // Writes to more pages than the overlay holds start a consolidation
+  for (uint32_t i = 0; i < WL_OVERLAY_NUM_PAGES; i++) {
+    const uint32_t value = 0xA5000000u | i;
+    write_expected(WL_CACHE_SIZE + i * WL_OVERLAY_PAGE_SIZE + 8u, &value,
+                   sizeof(value));
+  }
+
+  // Keep writing and reading at every step of the consolidation, on both
+  // sides of the programming cursor
+  for (uint32_t step = 0; step < 2000u; step++) {
+    write_random(8);
+    assert_random_read();
+    sim_clock_ms++;
+    run_task();
+    assert_random_read();
+  }
+  assert_store_equals_expected();
+
+  reboot();
+  assert_store_equals_expected();
+}
+
+void test_wear_leveling_xip_full_overlay_consolidates_in_the_write(void) {
+  const uint32_t start = consolidations();
+
+  // Without the main loop running, the background consolidation never
+  // frees a page, so the write that finds the overlay full consolidates
+  for (uint32_t i = 0; i < 3u * WL_OVERLAY_NUM_PAGES; i++) {
+    const uint32_t page =
+        WL_CACHE_SIZE + i * 7u % NUM_OVERLAY_ADDRESSABLE_PAGES *
+                            WL_OVERLAY_PAGE_SIZE;
+    const uint32_t value = ~i;
+
+    write_expected(page + 4u, &value, sizeof(value));
+    assert_random_read();
+  }
+
+  TEST_ASSERT_GREATER_THAN_UINT32(start, consolidations());
+  assert_store_equals_expected();
+  reboot();
+  assert_store_equals_expected();
+}
+
+// Append write log entries to the active bank behind the module's back, as a
+// firmware keeping the whole virtual storage in RAM would have written them
+static void append_log_entries(uint32_t num_pages) {
+  uint8_t *bank = NULL;
+  for (uint32_t i = 0; i < WL_NUM_BANKS; i++) {
+    uint8_t *candidate =
+        flash_sim_memory() +
+        (FIRST_BANK_SECTOR + i * BANK_NUM_SECTORS) * FLASH_SECTOR_SIZE;
+    uint32_t header[3];
+
+    memcpy(header, candidate + WL_HEADER_SEQUENCE, sizeof(header));
+    if (header[0] != FLASH_EMPTY_VAL && header[2] == FLASH_EMPTY_VAL)
+      bank = candidate;
+  }
+  TEST_ASSERT_NOT_NULL(bank);
+
+  uint32_t addr = WL_WRITE_LOG_START;
+  while (addr < WL_BACKING_STORE_SIZE &&
+         *(const uint32_t *)(bank + addr) != FLASH_EMPTY_VAL)
+    addr += 4;
+
+  for (uint32_t i = 0; i < num_pages; i++) {
+    const uint32_t page = WL_CACHE_SIZE + i % NUM_OVERLAY_ADDRESSABLE_PAGES *
+                                              WL_OVERLAY_PAGE_SIZE;
+    wl_log_entry_t entry;
+
+    memset(&entry, 0xFF, sizeof(entry));
+    entry.fields.addr = page;
+    entry.fields.len = 4 - 1;
+    memcpy(entry.fields.data, &i, sizeof(i));
+    memcpy(expected_store + page, &i, sizeof(i));
+
+    const uint32_t num_words = WL_LOG_ENTRY_NUM_WORDS(4);
+    TEST_ASSERT_TRUE(addr + num_words * 4 <= WL_BACKING_STORE_SIZE);
+    memcpy(bank + addr, entry.raw, num_words * 4);
+    addr += num_words * 4;
+  }
+}
+
+void test_wear_leveling_xip_log_beyond_the_overlay_is_consolidated(void) {
+  const uint32_t value = 0x11223344u;
+
+  write_expected(4, &value, sizeof(value));
+  reboot();
+
+  // The write log covers more pages than the overlay holds, so the boot
+  // consolidates it instead of replaying it into RAM
+  append_log_entries(WL_OVERLAY_NUM_PAGES + 4u);
+  const uint32_t start = consolidations();
+  power_cycle();
+  TEST_ASSERT_EQUAL_UINT32(start + 1u, consolidations());
+  assert_store_equals_expected();
+
+  // A log the overlay holds is replayed without consolidating
+  append_log_entries(WL_OVERLAY_NUM_PAGES / 2u);
+  power_cycle();
+  TEST_ASSERT_EQUAL_UINT32(start + 1u, consolidations());
+  assert_store_equals_expected();
+
+  reboot();
+  assert_store_equals_expected();
+}
+
+void test_wear_leveling_xip_erase_reads_empty(void) {
+  for (uint32_t i = 0; i < 200u; i++)
+    write_random(WL_OVERLAY_PAGE_SIZE);
+  reboot();
+  assert_store_equals_expected();
+
+  TEST_ASSERT_TRUE(wear_leveling_erase());
+  memset(expected_store, 0xFF, sizeof(expected_store));
+  assert_store_equals_expected();
+
+  // Writes made while the cleared storage is being committed are kept
+  for (uint32_t i = 0; i < 50u; i++) {
+    write_random(16);
+    run_task();
+    assert_random_read();
+  }
+  reboot();
+  assert_store_equals_expected();
+}
+
+void test_wear_leveling_xip_profiles_read_back_through_eeconfig(void) {
+  static eeconfig_profile_t expected[NUM_PROFILES];
+
+  eeconfig_init();
+  TEST_ASSERT_TRUE(eeconfig_reset());
+  for (uint8_t p = 0; p < NUM_PROFILES; p++)
+    TEST_ASSERT_TRUE(
+        eeconfig_read_profile(p, 0, &expected[p], sizeof(expected[p])));
+
+  for (uint32_t i = 0; i < 400u; i++) {
+    const uint8_t profile = (uint8_t)(xorshift() % NUM_PROFILES);
+    const uint32_t offset = xorshift() % sizeof(eeconfig_profile_t);
+    const uint32_t len =
+        1u + xorshift() % M_MIN(16u, sizeof(eeconfig_profile_t) - offset);
+    uint8_t buf[16];
+
+    for (uint32_t j = 0; j < len; j++)
+      buf[j] = (uint8_t)xorshift();
+    memcpy((uint8_t *)&expected[profile] + offset, buf, len);
+    TEST_ASSERT_TRUE(eeconfig_write_profile(profile, offset, buf, len));
+    if (i % 8u == 0)
+      TEST_ASSERT_TRUE(eeconfig_set_current_profile(profile));
+    run_task();
+
+    TEST_ASSERT_EQUAL_MEMORY(&expected[eeconfig->current_profile],
+                             &CURRENT_PROFILE, sizeof(eeconfig_profile_t));
+  }
+
+  TEST_ASSERT_TRUE(wear_leveling_flush());
+  power_cycle();
+  eeconfig_init();
+  for (uint8_t p = 0; p < NUM_PROFILES; p++) {
+    eeconfig_profile_t actual;
+    TEST_ASSERT_TRUE(eeconfig_read_profile(p, 0, &actual, sizeof(actual)));
+    TEST_ASSERT_EQUAL_MEMORY(&expected[p], &actual, sizeof(actual));
+  }
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_wear_leveling_xip_reads_return_the_last_write);
+  RUN_TEST(test_wear_leveling_xip_writes_during_consolidation_read_back);
+  RUN_TEST(test_wear_leveling_xip_full_overlay_consolidates_in_the_write);
+  RUN_TEST(test_wear_leveling_xip_log_beyond_the_overlay_is_consolidated);
+  RUN_TEST(test_wear_leveling_xip_erase_reads_empty);
+  RUN_TEST(test_wear_leveling_xip_profiles_read_back_through_eeconfig);
+  return UNITY_END();
+}
@@ -10,6 +10,8 @@
 key_state_t key_matrix[NUM_KEYS];
 eeconfig_t mock_eeconfig;
 const eeconfig_t *eeconfig = &mock_eeconfig;
+eeconfig_profile_t mock_profile;
+const eeconfig_profile_t *eeconfig_profile = &mock_profile;
 bool is_sniper_active = false;
 
 static joystick_state_t mock_joystick_state;
@@ -57,6 +59,7 @@ bool usbd_edpt_release(uint8_t rhport, uint8_t ep_addr) { return true; }
 
 void setUp(void) {
   memset(&mock_eeconfig, 0, sizeof(mock_eeconfig));
+  memset(&mock_profile, 0, sizeof(mock_profile));
   memset(key_matrix, 0, sizeof(key_matrix));
   memset(&mock_joystick_state, 0, sizeof(mock_joystick_state));
   memset(&mock_joystick_config, 0, sizeof(mock_joystick_config));
@@ -89,7 +92,7 @@ void test_xinput_hid_gamepad_clears_physical_stick_button_on_release(void) {
 
 void test_xinput_hid_gamepad_preserves_transient_button_tap_while_busy(void) {
   mock_eeconfig.options.xinput_enabled = false;
-  mock_eeconfig.profiles[0].gamepad_buttons[1] = GP_BUTTON_A;
+  mock_profile.gamepad_buttons[1] = GP_BUTTON_A;
   mock_hid_ready = false;
 
   key_matrix[1].is_pressed = true;
@@ -129,7 +132,7 @@ void test_xinput_hid_gamepad_does_not_double_circularize_physical_stick(void) {
 
 void test_xinput_hid_gamepad_maps_key_stick_up_to_negative_y(void) {
   mock_eeconfig.options.xinput_enabled = false;
-  mock_eeconfig.profiles[0].gamepad_buttons[1] = GP_BUTTON_LS_UP;
+  mock_profile.gamepad_buttons[1] = GP_BUTTON_LS_UP;
   key_matrix[1].distance = 255;
 
   xinput_process(1);
@@ -141,8 +144,8 @@ void test_xinput_hid_gamepad_maps_key_stick_up_to_negative_y(void) {
 
 void test_xinput_hid_gamepad_uses_unsigned_opposite_axis_delta(void) {
   mock_eeconfig.options.xinput_enabled = false;
-  mock_eeconfig.profiles[0].gamepad_buttons[1] = GP_BUTTON_LS_LEFT;
-  mock_eeconfig.profiles[0].gamepad_buttons[2] = GP_BUTTON_LS_RIGHT;
+  mock_profile.gamepad_buttons[1] = GP_BUTTON_LS_LEFT;
+  mock_profile.gamepad_buttons[2] = GP_BUTTON_LS_RIGHT;
   key_matrix[1].distance = 200;
   key_matrix[2].distance = 50;
 